@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Logger.h"
+#include "Sketches.h"
+
+namespace gwatch
+{
+	// Aggregates accesses instead of printing them (--mode=stats). Per variable: read and
+	// write counts per thread, a histogram of the time between two accesses, and sketches of
+	// the values seen (new value for writes): distinct count, most frequent values and
+	// quantiles. Memory is bounded: at most kMaxVariables variables (the rest are merged into
+	// "<other>") and kMaxThreads threads per variable (the rest are counted as "other").
+	// Thread-safe: the logging thread records while another one dumps.
+	class AccessStats
+	{
+	public:
+		static constexpr std::size_t kMaxVariables = 256;
+		static constexpr std::size_t kMaxThreads = 64;
+		static constexpr std::size_t kTopValues = 5;
+
+		AccessStats();
+		~AccessStats();
+
+		AccessStats(const AccessStats&) = delete;
+		AccessStats& operator=(const AccessStats&) = delete;
+
+		// id: dense index of the variable (the Logger's symbol index), name recorded on first use.
+		// An unknown value (Logger::log_access) is counted and timed but left out of the sketches.
+		void record(std::uint32_t id, std::string_view name, AccessKind kind, std::optional<std::uint64_t> value, std::uint32_t tid, std::uint64_t timestamp_ns);
+
+		// Prints one "stats:" block, cumulative since the start.
+		void dump(std::FILE* out) const;
+		std::string report() const;
+
+		std::uint64_t accesses() const;
+
+	private:
+		struct Variable;
+
+		mutable std::mutex m_mutex;
+		std::vector<std::unique_ptr<Variable>> m_variables; // by id, last one is "<other>"
+		std::uint64_t m_startNs = 0;
+		std::uint64_t m_accesses = 0;
+
+		Variable& variable(std::uint32_t id, std::string_view name);
+	};
+
+#ifdef __linux__
+
+	// Dumps stats to stdout on every SIGUSR1 for as long as it lives. The handler only posts
+	// a semaphore; a background thread does the formatting.
+	class StatsSignalDumper
+	{
+	public:
+		explicit StatsSignalDumper(const AccessStats& stats);
+		~StatsSignalDumper();
+
+		StatsSignalDumper(const StatsSignalDumper&) = delete;
+		StatsSignalDumper& operator=(const StatsSignalDumper&) = delete;
+
+		std::uint64_t dumps() const;
+
+	private:
+		struct State;
+		std::unique_ptr<State> m_state;
+	};
+
+#endif
+}
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "ArgumentsParser.h"
 #include "MemoryWatcher.h"
@@ -20,16 +23,32 @@ namespace gwatch
 		int execute();
 
 	private:
+		template <typename Watcher>
 		class DebugLoopSink;
 
+		// Runs the target to completion with the watcher bound statically, returns its exit code.
+		template <typename Watcher>
+		std::optional<std::uint32_t> run_with();
+
 		CliArgs m_args;
 		std::unique_ptr<IProcessLauncher> m_processLauncher;
 		std::unique_ptr<IMemoryWatcher> m_memoryWatcher;
-		std::optional<ResolvedSymbol> m_symbol;
+		std::vector<ResolvedSymbol> m_symbols;
+		std::vector<ResolvedSymbol> m_globals; // names the changes inside the regions of --engine dirty
 		void* m_hProc;
+#ifdef __linux__
+		CodeModule m_mainImage;                // symbolizes the hot sites when the exit was not observed
+		std::vector<CodeModule> m_codeModules; // images mapped when the target exited (--hot-sites)
+#endif
 
 		void start_process();
-		void resolve_symbol(const CreateProcessInfo& cpInfo);
+		void resolve_symbols(const CreateProcessInfo& cpInfo);
 		void setup_memory_watcher();
+		void capture_code_modules();
+		void report_rotation(const WatchRotation& rotation) const;
+		void report_hot_sites(const HotSiteTable& table) const;
+#ifdef __linux__
+		void report_polling(const LinuxPollMemoryWatcher& watcher) const;
+#endif
 	};
 }
@@ -1,19 +1,69 @@
 #pragma once
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <span>
+#include <utility>
+
+#include "Logger.h"
 
 namespace gwatch
 {
+	// Upper bound of a watch plan; how many are actually covered depends on their layout.
+	inline constexpr std::size_t kMaxWatchedSymbols = 64;
+
+	// How accesses are detected, see MemoryWatcher.h.
+	enum class WatchEngine : std::uint8_t
+	{
+		Breakpoints, // hardware debug registers: 4-8 byte variables, reads and writes, exact values
+		Pages,       // write-protected pages: objects of any size, writes only (Linux)
+		Dirty,       // periodic soft-dirty page scans: whole regions, writes only, never stops the target (Linux)
+		Poll,        // polling thread: 1-8 byte variables, writes only, never stops the target (Linux)
+		Hybrid,      // trapping writes plus kernel-counted reads: 4-8 byte variables, 2 slots (Linux)
+		Perf         // sampled hardware breakpoints: never stops the target, values only from plain moves (Linux)
+	};
+
+	// What is made of the accesses.
+	enum class OutputMode : std::uint8_t
+	{
+		Log,  // one record per access, see Logger
+		Stats // bounded per-variable aggregates printed at exit and on SIGUSR1, see AccessStats
+	};
+
 	struct CliArgs
 	{
-		std::string symbol;                  // --var
+		std::vector<std::string> symbols;    // --var a[,b,...]
 		std::string execPath;                // --exec
 		std::vector<std::string> targetArgs; // args after separtor --
 		bool showHelp = false;               // -h / --help
+		bool asyncLog = false;               // --async-log, also set by --overflow and --queue-size
+		LogFormat format = LogFormat::Text;  // --format=text|binary|columnar
+		std::uint32_t rotateMs = 0;          // --rotate <ms>, 0 = variables that do not fit are not watched (Linux: --engine perf only)
+		WatchEngine engine = WatchEngine::Breakpoints; // --engine=breakpoints|pages|dirty|poll|hybrid|perf
+		std::optional<std::uint32_t> intervalUs;       // --interval <n>[us|ms|s] between two scans, reads or read summaries, unset = engine default
+		std::uint32_t hotSites = 0;                    // --hot-sites <n>, most hit access sites reported at exit, 0 = none
+		OutputMode mode = OutputMode::Log;             // --mode=log|stats
+		Coalescing coalesce = Coalescing::Off;         // --coalesce=thread|global
+		std::optional<std::uint32_t> coalesceWindowUs; // --coalesce-window <n>[us|ms|s], unset = Logger default, 0 = no bound
+		std::vector<std::pair<std::string, LogPolicy>> policies; // --rate-limit / --sample [<var>=]<n>, "" = every variable
+		std::optional<OverflowPolicy> overflow;        // --overflow block|drop-newest|drop-oldest|spill:<path>
+		std::string spillPath;                         // path of --overflow spill:<path>
+		std::optional<std::uint32_t> queueSize;        // --queue-size <records>
+		std::string traceFile;                         // --trace-file <path>, empty = stdout
+		std::optional<std::uint64_t> traceSegmentBytes; // --trace-segment <n>[K|M|G], unset = Logger default
+		std::uint32_t traceRotateUs = 0;               // --trace-rotate <time>, 0 = when a segment is full only
+		std::uint32_t traceKeep = 0;                   // --trace-keep <n>, 0 = keep every segment
+		TraceBackend traceIo = TraceBackend::Mmap;     // --trace-io mmap|uring
+		std::optional<std::uint64_t> traceBlockBytes;  // --trace-block <n>[K|M], unset = Logger default
+		std::optional<std::uint32_t> traceDepth;       // --trace-depth <n>, unset = Logger default
+		bool traceDirect = false;                      // --trace-direct
+		std::optional<compress::Codec> compress;       // --compress lz|zstd|auto, unset = plain stdout
+		std::optional<std::uint64_t> compressBlockBytes; // --compress-block <n>[K|M], unset = Logger default
+		std::optional<std::uint32_t> rowGroupRows;     // --row-group <n>[K|M], unset = Logger default
 	};
 
 	class ParseError final : public std::runtime_error
@@ -32,6 +82,23 @@ namespace gwatch
 
 	private:
 		static void ensure_not_duplicate(bool seen, std::string_view opt);
-		static std::string next_value(const std::span<const char*>& args, int idx, std::string_view optName);
+		static std::string next_value(const std::span<const char*>& args, std::size_t idx, std::string_view optName);
+		static LogFormat parse_format(std::string_view value);
+		static std::vector<std::string> parse_symbols(std::string_view value);
+		static std::uint32_t parse_quantum(std::string_view value);
+		static WatchEngine parse_engine(std::string_view value);
+		static std::uint32_t parse_duration(std::string_view value, std::string_view optName);
+		static std::uint32_t parse_hot_sites(std::string_view value);
+		static OutputMode parse_mode(std::string_view value);
+		static Coalescing parse_coalesce(std::string_view value);
+		static void parse_overflow(std::string_view value, CliArgs& out);
+		static std::uint32_t parse_queue_size(std::string_view value);
+		static std::uint64_t parse_size(std::string_view value, std::string_view optName, std::uint64_t min, std::uint64_t max, std::uint64_t multipleOf, std::string_view expected);
+		static std::uint64_t parse_segment_size(std::string_view value);
+		static std::uint32_t parse_trace_keep(std::string_view value);
+		static TraceBackend parse_trace_io(std::string_view value);
+		static std::uint32_t parse_trace_depth(std::string_view value);
+		static compress::Codec parse_compress(std::string_view value);
+		static void parse_policies(std::string_view value, std::string_view optName, std::uint32_t LogPolicy::* field, CliArgs& out);
 	};
 }
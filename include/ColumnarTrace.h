@@ -0,0 +1,290 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "Logger.h"
+#include "TraceFormat.h"
+
+namespace gwatch::columnar
+{
+	// Columnar trace layout (--format=columnar). Integers are little-endian; every section
+	// starts on a 64-byte boundary of the file, so a mapped file can be read in place:
+	//
+	//   file     header  group*
+	//   header   "GWCL" u32:version u32:column_count u32:0, zero-padded to 64 bytes
+	//   group    "GWCG" u32:rows u64:group_bytes u32:symbol_count u32:0
+	//            { u64:offset u64:min u64:max }*column_count     (offset from the group start)
+	//            { u32:id u32:size u32:name_len name }*symbol_count
+	//            zero padding, then each column as a plain array of rows values
+	//
+	// group_bytes covers the whole group, padding included: the next group (if any) starts
+	// there. A zero word where a group should start ends the file, like the zero fill of a
+	// trace file segment left behind by a crash. Each group defines the symbols (variables)
+	// that appeared since the previous group, so a group may use ids defined before it.
+	// min and max hold the range of a column over the group, for readers to skip groups.
+	inline constexpr char kMagic[4] = {'G', 'W', 'C', 'L'};
+	inline constexpr char kGroupMagic[4] = {'G', 'W', 'C', 'G'};
+	inline constexpr std::uint32_t kVersion = 1;
+	inline constexpr std::size_t kAlignment = 64;
+	inline constexpr std::uint32_t kDefaultRows = 65'536;
+
+	// In file order.
+	enum class Column : std::uint8_t
+	{
+		Timestamp, // u64 steady clock ns
+		Tid,       // u32
+		Var,       // u32 symbol id
+		Kind,      // u8 bit 0: 0 = read, 1 = write; kUnknownValues: Old and New are unknown (0)
+		Old,       // u64 value before a write; the value read for a read
+		New,       // u64 value after a write; the value read for a read
+		Ip,        // u64 address of the instruction that made the access, 0 = unknown
+		Count      // u32 accesses the row stands for (coalesced runs), 1 otherwise
+	};
+	inline constexpr std::size_t kColumns = 8;
+	inline constexpr std::array<std::size_t, kColumns> kWidths = {8, 4, 4, 1, 8, 8, 8, 4};
+	inline constexpr std::size_t kRowBytes = 45; // sum of kWidths
+	inline constexpr std::uint8_t kKindBits = 0x01;
+	inline constexpr std::uint8_t kUnknownValues = 0x02; // Logger::log_access
+
+	class ColumnarError final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	struct ColumnStats
+	{
+		std::uint64_t min = 0;
+		std::uint64_t max = 0;
+	};
+
+	// Buffers records column by column and renders them as row groups.
+	class Writer
+	{
+	public:
+		explicit Writer(std::uint32_t rows = kDefaultRows);
+
+		// Rows per group from the next group on; at least 1.
+		void set_rows(std::uint32_t rows);
+		std::uint32_t group_rows() const { return m_groupRows; }
+
+		// Buffers record; returns true once the group is full and should be rendered.
+		bool add(const LogRecord& record);
+		std::size_t buffered() const { return m_time.size(); }
+
+		// Bytes the next render() appends.
+		std::size_t render_size(std::span<const trace::SymbolView> symbols) const;
+		// Appends the buffered rows as one group, preceded by the file header at the start of
+		// a stream, and empties the buffer. symbols must cover every buffered symbol id.
+		void render(std::span<const trace::SymbolView> symbols, std::vector<char>& out);
+		// The next group starts a new stream (file header, every symbol defined again).
+		// Buffered rows stay.
+		void restart();
+		// restart() and drops the buffered rows.
+		void reset();
+
+	private:
+		std::uint32_t m_groupRows;
+		bool m_headerWritten = false;
+		std::size_t m_symbolsWritten = 0;
+		std::vector<std::uint64_t> m_time;
+		std::vector<std::uint32_t> m_tid;
+		std::vector<std::uint32_t> m_var;
+		std::vector<std::uint8_t> m_kind;
+		std::vector<std::uint64_t> m_old;
+		std::vector<std::uint64_t> m_new;
+		std::vector<std::uint64_t> m_ip;
+		std::vector<std::uint32_t> m_count;
+
+		std::size_t header_size(std::span<const trace::SymbolView> symbols) const;
+	};
+
+	// A row group of a mapped file: the columns point into the file.
+	class RowGroup
+	{
+	public:
+		std::uint32_t rows() const { return m_rows; }
+		std::uint64_t offset() const { return m_offset; } // of the group in the file
+		const ColumnStats& stats(const Column column) const { return m_stats[static_cast<std::size_t>(column)]; }
+
+		std::span<const std::uint64_t> timestamps() const { return column<std::uint64_t>(Column::Timestamp); }
+		std::span<const std::uint32_t> tids() const { return column<std::uint32_t>(Column::Tid); }
+		std::span<const std::uint32_t> vars() const { return column<std::uint32_t>(Column::Var); }
+		std::span<const std::uint8_t> kinds() const { return column<std::uint8_t>(Column::Kind); }
+		std::span<const std::uint64_t> old_values() const { return column<std::uint64_t>(Column::Old); }
+		std::span<const std::uint64_t> new_values() const { return column<std::uint64_t>(Column::New); }
+		std::span<const std::uint64_t> ips() const { return column<std::uint64_t>(Column::Ip); }
+		std::span<const std::uint32_t> counts() const { return column<std::uint32_t>(Column::Count); }
+
+		// Row i as a record (symbol = the var column).
+		LogRecord record(std::uint32_t i) const;
+		// rows rows from row first on, as a group of their own. The statistics stay those of
+		// the whole group, a superset of the slice's.
+		RowGroup slice(std::uint32_t first, std::uint32_t rows) const;
+
+	private:
+		friend class Reader;
+
+		std::uint32_t m_rows = 0;
+		std::uint64_t m_offset = 0;
+		std::array<const char*, kColumns> m_columns{};
+		std::array<ColumnStats, kColumns> m_stats{};
+
+		template<typename T>
+		std::span<const T> column(const Column c) const
+		{
+			return {reinterpret_cast<const T*>(m_columns[static_cast<std::size_t>(c)]), m_rows};
+		}
+	};
+
+	// Reads a columnar trace in place, typically a mapped file (MappedFile.h). data must stay
+	// valid while the reader is used and start on an 8-byte boundary (mappings start on a page).
+	class Reader
+	{
+	public:
+		// Walks the group headers; throws ColumnarError on a bad header or a group that does
+		// not fit in data. A group cut short (crash) ends the walk.
+		explicit Reader(std::span<const char> data);
+
+		const std::vector<RowGroup>& groups() const { return m_groups; }
+		// By id; names of ids no group defined stay empty.
+		const std::vector<trace::SymbolDef>& symbols() const { return m_symbols; }
+		std::optional<std::uint32_t> find_symbol(std::string_view name) const;
+		std::uint64_t rows() const { return m_rows; }
+
+	private:
+		std::vector<RowGroup> m_groups;
+		std::vector<trace::SymbolDef> m_symbols;
+		std::uint64_t m_rows = 0;
+	};
+
+	// Scan kernels over one column. The loops are plain indexed loops without early exits or
+	// data-dependent branches, so compilers vectorize them; selections are built 256 rows at
+	// a time from a match mask, then compacted without branching.
+	template<typename T>
+	ColumnStats min_max(const std::span<const T> values)
+	{
+		T lo = std::numeric_limits<T>::max();
+		T hi = 0;
+		for (std::size_t i = 0; i < values.size(); ++i)
+		{
+			lo = std::min(lo, values[i]);
+			hi = std::max(hi, values[i]);
+		}
+		return values.empty() ? ColumnStats{} : ColumnStats{lo, hi};
+	}
+
+	template<typename T>
+	std::size_t count_in_range(const std::span<const T> values, const T lo, const T hi)
+	{
+		std::size_t count = 0;
+		for (std::size_t i = 0; i < values.size(); ++i)
+			count += static_cast<std::size_t>(static_cast<T>(values[i] - lo) <= static_cast<T>(hi - lo));
+		return count;
+	}
+
+	// Appends to rows the index of every value in [lo, hi]; returns how many were added.
+	template<typename T>
+	std::size_t select_range(const std::span<const T> values, const T lo, const T hi, std::vector<std::uint32_t>& rows)
+	{
+		constexpr std::size_t kChunk = 256;
+		const std::size_t before = rows.size();
+		std::uint8_t mask[kChunk];
+		for (std::size_t base = 0; base < values.size(); base += kChunk)
+		{
+			const std::size_t n = std::min(kChunk, values.size() - base);
+			for (std::size_t i = 0; i < n; ++i)
+				mask[i] = static_cast<T>(values[base + i] - lo) <= static_cast<T>(hi - lo);
+			const std::size_t used = rows.size();
+			rows.resize(used + n);
+			std::uint32_t* out = rows.data() + used;
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				out[kept] = static_cast<std::uint32_t>(base + i);
+				kept += mask[i];
+			}
+			rows.resize(used + kept);
+		}
+		return rows.size() - before;
+	}
+
+	// Keeps the rows whose value is in [lo, hi].
+	template<typename T>
+	void refine_range(const std::span<const T> values, const T lo, const T hi, std::vector<std::uint32_t>& rows)
+	{
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < rows.size(); ++i)
+		{
+			const std::uint32_t row = rows[i];
+			rows[kept] = row;
+			kept += static_cast<T>(values[row] - lo) <= static_cast<T>(hi - lo);
+		}
+		rows.resize(kept);
+	}
+
+	// Appends to rows the index of every value whose masked bits equal want; returns how many
+	// were added.
+	template<typename T>
+	std::size_t select_masked(const std::span<const T> values, const T mask, const T want, std::vector<std::uint32_t>& rows)
+	{
+		constexpr std::size_t kChunk = 256;
+		const std::size_t before = rows.size();
+		std::uint8_t match[kChunk];
+		for (std::size_t base = 0; base < values.size(); base += kChunk)
+		{
+			const std::size_t n = std::min(kChunk, values.size() - base);
+			for (std::size_t i = 0; i < n; ++i)
+				match[i] = static_cast<T>(values[base + i] & mask) == want;
+			const std::size_t used = rows.size();
+			rows.resize(used + n);
+			std::uint32_t* out = rows.data() + used;
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				out[kept] = static_cast<std::uint32_t>(base + i);
+				kept += match[i];
+			}
+			rows.resize(used + kept);
+		}
+		return rows.size() - before;
+	}
+
+	// Keeps the rows whose masked bits equal want.
+	template<typename T>
+	void refine_masked(const std::span<const T> values, const T mask, const T want, std::vector<std::uint32_t>& rows)
+	{
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < rows.size(); ++i)
+		{
+			const std::uint32_t row = rows[i];
+			rows[kept] = row;
+			kept += static_cast<T>(values[row] & mask) == want;
+		}
+		rows.resize(kept);
+	}
+
+	// Conditions on the rows to keep; unset ones keep every row.
+	struct Filter
+	{
+		std::optional<std::uint32_t> var{};
+		std::optional<std::uint32_t> tid{};
+		std::optional<AccessKind> kind{};
+		std::optional<std::uint64_t> value{}; // the new value (the value read, for a read); never matches unknown values
+		std::uint64_t fromNs = 0;
+		std::uint64_t toNs = UINT64_MAX;      // inclusive
+	};
+
+	// False when the group statistics show that no row of group matches.
+	bool may_match(const RowGroup& group, const Filter& filter);
+	// Replaces rows with the matching rows of group, in order.
+	void select(const RowGroup& group, const Filter& filter, std::vector<std::uint32_t>& rows);
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace gwatch::compress
+{
+	// Compressed stream layout (integers are little-endian):
+	//
+	//   header   "GWZ1" u8:codec u8:version u16:0
+	//   block    u32:stored_size  u32:raw_size  payload          (repeated)
+	//   end      u32:0 u32:0
+	//   index    u64:count { u64:block_offset }*count  u64:index_offset  "GWZI"
+	//
+	// Every block is compressed on its own, so blocks can be decoded in any order and in
+	// parallel; the index (block header offsets) lets a reader find them without scanning.
+	// Blocks end on a write boundary: in a text stream every block holds whole lines.
+	// The top bit of stored_size marks a block stored as is because it did not compress.
+	// A stream cut short (crash) has no end or index: readers scan the block headers instead.
+	inline constexpr char kMagic[4] = {'G', 'W', 'Z', '1'};
+	inline constexpr char kIndexMagic[4] = {'G', 'W', 'Z', 'I'};
+	inline constexpr std::uint8_t kVersion = 1;
+	inline constexpr std::uint32_t kStoredRaw = 0x80000000u;
+
+	enum class Codec : std::uint8_t
+	{
+		Lz = 1,  // built-in byte-oriented LZ77, always available
+		Zstd = 2 // libzstd, when found at configure time
+	};
+
+	class CompressError final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	bool available(Codec codec);
+	// Zstd when available, Lz otherwise.
+	Codec default_codec();
+	std::string_view codec_name(Codec codec);
+
+	// Appends the compressed form of in to out (the payload only, without block header).
+	void compress_block(Codec codec, std::span<const char> in, std::vector<char>& out);
+	// Decodes a payload into exactly out.size() bytes; throws CompressError on corrupt input.
+	void decompress_block(Codec codec, std::span<const char> in, std::span<char> out);
+
+	struct Block
+	{
+		std::uint64_t offset = 0;    // of the payload in the stream
+		std::uint64_t rawOffset = 0; // of the decoded bytes in the decoded stream
+		std::uint32_t storedSize = 0;
+		std::uint32_t rawSize = 0;
+		bool raw = false;            // payload stored as is
+	};
+
+	struct Index
+	{
+		Codec codec = Codec::Lz;
+		std::vector<Block> blocks;
+		std::uint64_t rawSize = 0;
+	};
+
+	bool is_compressed(std::span<const char> stream);
+	// Locates the blocks from the trailing index, or by walking the block headers when the
+	// stream has none; a block cut short ends the walk. Throws CompressError on a bad header
+	// or an unknown codec.
+	Index read_index(std::span<const char> stream);
+	// Decodes the whole stream, the blocks spread over up to threads threads.
+	std::vector<char> decompress(std::span<const char> stream, unsigned threads);
+
+	// Compression stage: write() copies into the block being filled; full blocks are handed to
+	// a worker thread that compresses them and passes header and payload to the sink. write()
+	// only waits when kQueued blocks are already waiting for the worker. Thread-safe.
+	class StreamCompressor
+	{
+	public:
+		// Bytes to pass on; returns false once the output failed (the rest is then dropped).
+		using Sink = std::function<bool(const char* data, std::size_t size)>;
+
+		struct Stats
+		{
+			std::uint64_t blocks = 0;
+			std::uint64_t rawBytes = 0;
+			std::uint64_t compressedBytes = 0; // headers and index included
+			std::uint64_t compressNs = 0;      // worker time spent in the codec
+		};
+
+		static constexpr std::size_t kQueued = 4;
+
+		// Throws std::invalid_argument for a codec this build does not have or a zero block size.
+		StreamCompressor(Codec codec, std::size_t blockBytes, Sink sink);
+		// close()
+		~StreamCompressor();
+
+		StreamCompressor(const StreamCompressor&) = delete;
+		StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+		void write(const char* data, std::size_t size);
+		// Compresses what is buffered, writes the end marker and the index, stops the worker.
+		void close();
+		// Complete once close() returned.
+		Stats stats() const;
+
+	private:
+		Codec m_codec;
+		std::size_t m_blockBytes;
+		Sink m_sink;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_ready; // a block is queued, or closing
+		std::condition_variable m_space; // a queued block was taken
+		std::vector<char> m_filling;
+		std::vector<std::vector<char>> m_queue;
+		std::vector<std::vector<char>> m_free;
+		bool m_closing = false;
+		bool m_closed = false;
+		Stats m_stats;
+		std::thread m_worker;
+
+		// Queues m_filling; caller holds the lock.
+		void ship(std::unique_lock<std::mutex>& lock);
+		void run();
+	};
+}
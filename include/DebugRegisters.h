@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace gwatch::dr
+{
+	// x86/x64 hardware breakpoints: DR0..DR3 hold addresses, DR7 enables and configures them,
+	// DR6 reports which of them fired.
+	inline constexpr std::size_t kSlotCount = 4;
+
+	enum class Trigger : std::uint8_t
+	{
+		Execute = 0b00,
+		Write = 0b01,
+		ReadWrite = 0b11
+	};
+
+	struct Slot
+	{
+		std::uint64_t address = 0;
+		std::uint32_t size = 0; // 1, 2, 4 or 8 bytes
+		Trigger trigger = Trigger::ReadWrite;
+	};
+
+	// LEN field of DR7 for a breakpoint of size bytes. Throws std::invalid_argument otherwise.
+	std::uint64_t length_bits(std::uint32_t size);
+
+	// Returns current with slots[i] programmed in slot i (local enable, RW, LEN) and every
+	// other slot disabled. Bits outside the slot fields are preserved.
+	std::uint64_t encode_dr7(std::uint64_t current, std::span<const Slot> slots);
+
+	// B0..B3 of DR6: bit i is set when slot i triggered the last debug exception.
+	constexpr std::uint32_t triggered_slots(const std::uint64_t dr6)
+	{
+		return static_cast<std::uint32_t>(dr6 & 0xF);
+	}
+
+	// DR6 is sticky: the status bits must be cleared by the debugger after each trap.
+	constexpr std::uint64_t clear_triggered(const std::uint64_t dr6)
+	{
+		return dr6 & ~0xFull;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "InstructionDecoder.h"
+#include "Logger.h"
+#include "SymbolResolver.h"
+
+namespace gwatch
+{
+	// One access site: an instruction and what it did, with how often it did it.
+	struct HotSite
+	{
+		std::uint64_t ip = 0;        // first byte of the instruction
+		std::uint64_t count = 0;
+		std::uint64_t variables = 0; // bit i: watched variable i was accessed from here
+		std::uint32_t tid = 0;       // first thread seen at this site
+		AccessKind kind = AccessKind::Read;
+		bool otherThreads = false;   // hit by more than one thread
+	};
+
+	// Fixed-capacity open-addressed table (linear probing) of the access sites, keyed by
+	// (instruction, kind). It never grows: once 3/4 full, hits at new sites are only counted
+	// in overflow(), so memory stays at capacity entries however long the target runs. Hits
+	// whose instruction is unknown (ip 0, see x86::access_site) are only counted in undecoded().
+	// Not thread-safe: it belongs to the thread that sees the accesses.
+	class HotSiteTable
+	{
+	public:
+		static constexpr std::size_t kDefaultCapacity = 4096;
+
+		// capacity is rounded up to a power of two.
+		explicit HotSiteTable(std::size_t capacity = kDefaultCapacity);
+
+		void record(std::uint64_t ip, AccessKind kind, std::uint32_t tid, std::uint64_t variables);
+
+		// The n most hit sites, by decreasing count then address.
+		std::vector<HotSite> top(std::size_t n) const;
+
+		std::uint64_t total() const { return m_total; }       // every hit, overflow included
+		std::uint64_t overflow() const { return m_overflow; } // hits at sites that found the table full
+		std::uint64_t undecoded() const { return m_undecoded; } // hits with no known instruction
+		std::size_t size() const { return m_size; }
+		std::size_t capacity() const { return m_entries.size(); }
+
+	private:
+		std::vector<HotSite> m_entries; // count == 0: free
+		std::size_t m_size = 0;
+		std::size_t m_limit = 0;
+		std::uint64_t m_total = 0;
+		std::uint64_t m_overflow = 0;
+		std::uint64_t m_undecoded = 0;
+	};
+
+	// Sorted address-interval tables of the target's code: modules, functions and line rows.
+	// Each lookup is a binary search; names are demangled on output.
+	class SiteSymbolizer
+	{
+	public:
+		// [begin, end) of one mapped image; functions and lines at runtime addresses.
+		void add_module(std::string name, std::uint64_t begin, std::uint64_t end, std::vector<CodeSymbol> functions, const LineTable& lines);
+
+		// "function+0x1a (file.cpp:12)", "module+0x1a40" outside every function, "0x7f..." outside every module.
+		std::string describe(std::uint64_t ip) const;
+
+	private:
+		struct Module
+		{
+			std::uint64_t begin = 0;
+			std::uint64_t end = 0;
+			std::string name;
+		};
+
+		std::vector<Module> m_modules;
+		std::vector<CodeSymbol> m_functions;
+		std::vector<std::string> m_files;
+		std::vector<LineTable::Row> m_rows;
+	};
+
+#ifdef __linux__
+
+	// File-backed image mapped in the target with code in it.
+	struct CodeModule
+	{
+		std::string path;
+		std::uint64_t begin = 0; // lowest mapping, the image's load base
+		std::uint64_t end = 0;
+	};
+
+	// Images mapped executable in /proc/<pid>/maps, in address order.
+	std::vector<CodeModule> read_code_modules(std::uint32_t pid);
+
+	// Functions of the images mapped in a target, from their symbol tables: where the
+	// instruction decoder may start (InstructionDecoder.h). Images are indexed on demand: an
+	// address outside every indexed image reads /proc/<pid>/maps again and indexes the image
+	// holding it. Addresses in no image (JIT code) or between functions find nothing.
+	class FunctionIndex
+	{
+	public:
+		explicit FunctionIndex(std::uint32_t pid) : m_pid(pid) {}
+
+		// Function holding address, std::nullopt when unknown.
+		std::optional<x86::CodeRange> find(std::uint64_t address);
+		// Indexes every image mapped now, so that find() on their code never parses an image.
+		void index_mapped();
+
+	private:
+		std::uint32_t m_pid;
+		std::vector<CodeModule> m_modules;   // indexed so far
+		std::vector<CodeSymbol> m_functions; // of those modules, sorted by address
+
+		void index_module_at(std::uint64_t address);
+		void index(CodeModule module);
+		const CodeSymbol* lookup(std::uint64_t address) const;
+	};
+
+#endif
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace gwatch::x86
+{
+	// Longest valid x86 instruction.
+	inline constexpr std::size_t kMaxInstructionLength = 15;
+
+	// What an instruction does to its memory operand.
+	enum class Access : std::uint8_t
+	{
+		Unknown,        // not decoded, or no single answer (movs, xsave, x87 environment, ...)
+		None,           // register operands only, or an address computation (lea, prefetch, nop)
+		Load,
+		Store,
+		ReadModifyWrite // add/inc/xchg/cmpxchg/xadd/bts/... on memory
+	};
+
+	// General-purpose registers by encoding: rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8..r15.
+	inline constexpr std::size_t kRegisters = 16;
+	inline constexpr std::int8_t kNoRegister = -1;
+
+	// The memory operand as base + index * scale + disp, plus the IP after the instruction when
+	// RIP-relative. known is false when it cannot be rebuilt from the registers the instruction
+	// left behind: it overwrote its base or index, or it uses FS/GS, VSIB, 16-bit addressing or
+	// no ModRM (string instructions, moffs).
+	struct Address
+	{
+		bool known = false;
+		bool ripRelative = false;
+		bool truncated = false;        // 32-bit address size
+		std::int8_t base = kNoRegister;
+		std::int8_t index = kNoRegister;
+		std::uint8_t scale = 1;
+		std::int64_t disp = 0;
+	};
+
+	// Where a plain move (mov, movzx, movsx, movsxd) leaves the value it moved once it retired:
+	// the register it stored from or loaded into, or its immediate. Loads into a register that
+	// also addresses the operand still hold the value; nothing else is tracked.
+	struct MovedValue
+	{
+		bool known = false;
+		std::int8_t reg = kNoRegister; // kNoRegister: the immediate
+		bool highByte = false;         // AH..BH: bits 8-15 of reg
+		std::uint64_t immediate = 0;
+	};
+
+	struct Instruction
+	{
+		std::uint8_t length = 0;       // 0: could not be decoded
+		Access access = Access::Unknown;
+		std::uint16_t width = 0;       // bytes of the memory operand, 0 when unknown
+		bool locked = false;           // lock prefix, or xchg with memory which always is
+		Address address;
+		MovedValue value;
+	};
+
+	// Decodes the instruction at the start of code (legacy, REX, 0F/0F38/0F3A, VEX and EVEX
+	// encodings). x64 selects 64-bit mode, where 40-4F are REX prefixes.
+	Instruction decode(std::span<const std::uint8_t> code, bool x64 = true);
+
+	// Address of insn's memory operand, from the registers once it retired and the IP that
+	// follows it (a data breakpoint's trap IP); std::nullopt unless insn.address.known.
+	std::optional<std::uint64_t> effective_address(const Instruction& insn, std::uint64_t ip, std::span<const std::uint64_t, kRegisters> registers);
+
+	// Value insn loaded or stored, from the registers once it retired, cut to insn.width;
+	// std::nullopt unless insn.value.known.
+	std::optional<std::uint64_t> moved_value(const Instruction& insn, std::span<const std::uint64_t, kRegisters> registers);
+
+	// First byte of the instruction a data breakpoint trapped after, 0 (unknown) when the
+	// forward decode did not find it: the trap IP is the next instruction, never the site.
+	inline std::uint64_t access_site(const Instruction& insn, const std::uint64_t trapIp)
+	{
+		return insn.length > 0 ? trapIp - insn.length : 0;
+	}
+
+	// First byte and size of a function: a known instruction boundary to decode from.
+	struct CodeRange
+	{
+		std::uint64_t begin = 0;
+		std::uint64_t size = 0;
+	};
+
+	// Longest function decoded; traps in larger ones stay unclassified.
+	inline constexpr std::uint64_t kMaxFunctionBytes = 1u << 20;
+
+	// Hardware data breakpoints are traps: the IP they report is the one after the access, and
+	// x86 code cannot be decoded backwards. The function holding that IP is decoded forward
+	// from its first byte instead, once, and every memory instruction of it is memoized under
+	// the IP that follows it: a trap costs one hash lookup. A trap with no known function, or
+	// where no instruction of the forward decode ends, is unclassified (Instruction{}).
+	// Code is assumed not to change under a given IP.
+	class DecodeCache
+	{
+	public:
+		explicit DecodeCache(const bool x64 = sizeof(void*) == 8) : m_x64(x64) {}
+
+		// locate(address) returns the CodeRange of the function holding address, or
+		// std::nullopt. read(address, out, size) copies size bytes of target code at address
+		// into out and returns false when they cannot be read. Both are only called until a
+		// read of the function holding ip succeeds.
+		template <class Locate, class Read>
+		Instruction classify(const std::uint64_t ip, Locate&& locate, Read&& read)
+		{
+			if (const auto it = m_entries.find(ip); it != m_entries.end())
+			{
+				++m_hits;
+				return it->second;
+			}
+			if (const std::optional<CodeRange> function = ip > 0 ? locate(ip - 1) : std::nullopt;
+				function && function->size <= kMaxFunctionBytes && !m_decoded.contains(function->begin))
+			{
+				// A failed read is not memoized: the next trap in the function reads it again.
+				std::vector<std::uint8_t> code(static_cast<std::size_t>(function->size));
+				if (!read(function->begin, code.data(), code.size()))
+					return Instruction{};
+				m_decoded.insert(function->begin);
+				decode_function(function->begin, code);
+				if (const auto it = m_entries.find(ip); it != m_entries.end())
+					return it->second;
+			}
+			return m_entries.emplace(ip, Instruction{}).first->second;
+		}
+
+		// Faults (a write to a protected page) stop before the instruction runs: the IP is its
+		// first byte, decoded in place and memoized under it. read is as for classify; a failed
+		// read is not memoized.
+		template <class Read>
+		Instruction classify_fault(const std::uint64_t ip, Read&& read)
+		{
+			if (const auto it = m_faults.find(ip); it != m_faults.end())
+			{
+				++m_hits;
+				return it->second;
+			}
+			std::array<std::uint8_t, kMaxInstructionLength> code{};
+			if (!read(ip, code.data(), code.size()))
+				return Instruction{};
+			return m_faults.emplace(ip, decode(code, m_x64)).first->second;
+		}
+
+		std::uint64_t hits() const { return m_hits; }
+		std::size_t size() const { return m_entries.size() + m_faults.size(); }
+
+	private:
+		bool m_x64;
+		std::unordered_map<std::uint64_t, Instruction> m_entries; // by the IP after the instruction
+		std::unordered_map<std::uint64_t, Instruction> m_faults;  // by the IP of the instruction
+		std::unordered_set<std::uint64_t> m_decoded;              // function starts
+		std::uint64_t m_hits = 0;
+
+		void decode_function(std::uint64_t begin, std::span<const std::uint8_t> code);
+	};
+}
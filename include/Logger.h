@@ -1,18 +1,216 @@
 #pragma once
 #include <cstdint>
+#include <string>
 #include <string_view>
 #include <cstdio>
 
+#include "Compression.h"
+
 namespace gwatch
 {
+	class AccessStats;
+
+	enum class AccessKind : std::uint8_t
+	{
+		Read,
+		Write
+	};
+
+	enum class LogFormat : std::uint8_t
+	{
+		Text,    // one line per access, see Logger
+		Binary,  // varint/delta encoded stream, see TraceFormat.h
+		Columnar // fixed-width columns in row groups, see ColumnarTrace.h
+	};
+
+	// Which identical consecutive accesses are merged into one record, see Logger.
+	enum class Coalescing : std::uint8_t
+	{
+		Off,
+		PerThread, // runs are tracked per thread: other threads' accesses do not end them
+		Global     // any different access ends the run
+	};
+
+	// What the asynchronous writer does with new records once its queue is full.
+	enum class OverflowPolicy : std::uint8_t
+	{
+		Block,      // the logging thread waits for room (the target waits with it)
+		DropNewest, // new records are dropped
+		DropOldest, // the oldest records not formatted yet are dropped
+		Spill       // records go to a file and are copied to stdout once it drains
+	};
+
+	struct AsyncOptions
+	{
+		std::size_t capacity = 1u << 16; // records, rounded up to a power of two
+		OverflowPolicy overflow = OverflowPolicy::Block;
+		std::string spillPath; // OverflowPolicy::Spill only; removed by stop_async()
+	};
+
+	// How trace file segments reach the disk.
+	enum class TraceBackend : std::uint8_t
+	{
+		Mmap, // preallocated shared mappings, see TraceFile
+		Uring // block writes through an io_uring, see UringTraceFile
+	};
+
+	// Trace files (--trace-file), see TraceFile.h and UringTraceFile.h.
+	struct TraceFileOptions
+	{
+		std::string path;                         // segments are <path>.0, <path>.1, ...
+		std::uint64_t segmentBytes = 64ull << 20; // size of a segment
+		std::uint64_t rotateNs = 0;               // also start a new segment after this long, 0 = when full only
+		std::size_t keep = 0;                     // segments kept on disk, the oldest are removed; 0 = all
+		TraceBackend backend = TraceBackend::Mmap;
+		std::size_t blockBytes = 1u << 20;        // Uring: size of a write, a multiple of 4 KiB
+		std::uint32_t queueDepth = 4;             // Uring: writes in flight
+		bool direct = false;                      // Uring: O_DIRECT, bypassing the page cache
+	};
+
+	// Compression stage of stdout (--compress), see Compression.h.
+	struct CompressionOptions
+	{
+		compress::Codec codec = compress::Codec::Lz;
+		std::size_t blockBytes = 1u << 20; // raw bytes per independently decodable block
+	};
+
+	// Output queue counters of the asynchronous mode.
+	struct QueueStats
+	{
+		std::size_t capacity = 0; // records the queue holds before the policy applies
+		std::size_t peak = 0;     // highest number of records waiting to be formatted
+		std::uint64_t dropped = 0;
+		std::uint64_t spilledBytes = 0;
+	};
+
+	// Limits on the accesses of a variable that reach the output; 0 = no limit.
+	struct LogPolicy
+	{
+		std::uint32_t ratePerSecond = 0; // token bucket holding up to one second of accesses
+		std::uint32_t sampleEvery = 0;   // keep the first access of every N
+	};
+
+	// Accesses kept out of the output by the policies.
+	struct LogDrops
+	{
+		std::uint64_t reads = 0;
+		std::uint64_t writes = 0;
+	};
+
+	// Fixed-size access record, as queued by the asynchronous mode.
+	struct LogRecord
+	{
+		std::uint64_t timestamp_ns = 0; // steady clock; the first access of a coalesced run
+		std::uint64_t old_value = 0;
+		std::uint64_t new_value = 0;
+		std::uint32_t tid = 0;
+		std::uint32_t symbol = 0; // index in the Logger symbol table
+		AccessKind kind = AccessKind::Read;
+		bool exact = true;        // false: the values are unknown, only the kind is (see log_access)
+		std::uint32_t repeat = 1; // identical accesses this record stands for
+		std::uint64_t ip = 0;     // instruction that made the access, 0 = unknown
+	};
+
 	// Interface for emitting access logs.
 	// Format (space-separated, decimal, no leading zeros):
 	//   <symbol> read  <value>
 	//   <symbol> write <old> -> <new>
+	//   <symbol> read  ?              (log_access: the engine saw the access, not its values)
+	//   <symbol> write ?
+	//
+	// By default each line is printed synchronously. In asynchronous mode the caller only
+	// pushes a LogRecord into a bounded single-producer ring; a writer thread formats the
+	// records and flushes them to stdout in large batches. The bytes are identical.
+	// Unless the overflow policy is Block, the writer never waits on stdout (Linux: through
+	// a non-blocking descriptor of its own for pipes and sockets); when stdout stalls,
+	// records queue up to the capacity and the policy decides what happens to the next ones.
+	//
+	// In binary format the same records are written as a trace (TraceFormat.h) that
+	// gwatch-dump turns back into the text above. tid and timestamp_ns are only kept there;
+	// a zero timestamp is replaced by the current steady clock time. Columnar format
+	// (ColumnarTrace.h) keeps them too, with ip, and holds records back until a row group is
+	// full or end_stream().
+	//
+	// With coalescing, a run of identical accesses (same thread, variable, kind and values)
+	// becomes one record with a count, printed as `<symbol> read <value> x<count>`. A run ends
+	// on a different access (of the same thread, or of any thread with Coalescing::Global),
+	// when it is older than the time window, and on flush(). Per-thread runs are printed when
+	// they end, so their lines may follow later accesses of other threads.
+	//
+	// Policies (set_policy) sample and rate-limit the accesses of a variable before coalescing.
+	// Dropped accesses are counted per variable and kind, and reported on stderr at most once
+	// a second while they happen (`drop: <symbol> reads=<n> writes=<n>`, since the previous
+	// line) and by report_drops(). Watchers see every access, so the old value of the next
+	// printed write is still the right one.
+	//
+	// While an AccessStats is attached (--mode=stats), accesses only update it: nothing is printed.
 	class Logger
 	{
 	public:
-		static void log_read(std::string_view symbol, std::uint64_t value);
-		static void log_write(std::string_view symbol, std::uint64_t old_value, std::uint64_t new_value);
+		static void log_read(std::string_view symbol, std::uint64_t value, std::uint32_t tid = 0, std::uint64_t timestamp_ns = 0, std::uint64_t ip = 0);
+		static void log_write(std::string_view symbol, std::uint64_t old_value, std::uint64_t new_value, std::uint32_t tid = 0, std::uint64_t timestamp_ns = 0, std::uint64_t ip = 0);
+		// An access whose values the engine does not know (never made up from a later read).
+		static void log_access(std::string_view symbol, AccessKind kind, std::uint32_t tid = 0, std::uint64_t timestamp_ns = 0, std::uint64_t ip = 0);
+
+		// Declares a symbol (and its size in bytes) ahead of its first access so that the
+		// binary header can describe it. Returns its index in the symbol table.
+		static std::uint32_t register_symbol(std::string_view symbol, std::uint32_t size);
+
+		// Selects the output format and starts a new stream. Call before logging.
+		static void set_format(LogFormat format);
+		static LogFormat output_format();
+		// Rows per columnar row group (default 65536). With a trace file, groups are capped to
+		// fit twice in a segment.
+		static void set_row_group(std::uint32_t rows);
+		// Writes what the format holds back (the last, partial columnar row group) to the
+		// current output. The next record starts a new stream. Call with the asynchronous mode
+		// stopped; set_format, close_trace_file and stop_compression call it.
+		static void end_stream();
+
+		// Switches to asynchronous mode. capacity is rounded up to a power of two.
+		// Only one thread may log while the asynchronous mode is active.
+		static void start_async(std::size_t capacity = 1u << 16);
+		static void start_async(const AsyncOptions& options);
+		// Flushes every queued record and returns to synchronous mode.
+		static void stop_async();
+		// Blocks until every record logged so far has reached stdout.
+		static void flush();
+		static bool async_active();
+		// Counters of the current asynchronous mode, or of the last one once stopped.
+		static QueueStats queue_stats();
+
+		// Sends the output to segment files instead of stdout (Linux only; throws
+		// std::runtime_error elsewhere or when the first segment cannot be created). Records are
+		// never split across segments, and in binary format every segment is a trace of its own.
+		static void open_trace_file(const TraceFileOptions& options);
+		// Completes the current segment and goes back to stdout.
+		static void close_trace_file();
+
+		// Compresses stdout on a worker thread of its own until stop_compression(); throws
+		// std::invalid_argument for a codec this build does not have.
+		static void start_compression(const CompressionOptions& options);
+		// Compresses what is left, writes the block index and goes back to plain stdout.
+		static void stop_compression();
+
+		// Starts merging identical consecutive accesses (Coalescing::Off: flushes the pending
+		// runs and stops). window_ns bounds how long a run is held back, 0 = until it ends.
+		static void set_coalescing(Coalescing coalescing, std::uint64_t window_ns = 100'000'000);
+
+		// Sets the policy of a variable; an empty symbol sets the default of the variables
+		// without their own. A policy field left at 0 falls back to the default one.
+		static void set_policy(std::string_view symbol, const LogPolicy& policy);
+		// Removes every policy and forgets the drop counts; other threads may be logging meanwhile.
+		static void clear_policies();
+		// Prints the drops not reported yet and a `drop: total` line when anything was dropped.
+		static void report_drops();
+		static LogDrops dropped();
+
+		// Routes every access to stats instead of the output (nullptr: back to the output).
+		static void set_stats(AccessStats* stats);
+
+		// Formats one record as a text line. Returns the length written;
+		// out must hold at least max_line_length(symbol) bytes.
+		static std::size_t format_text(const LogRecord& record, std::string_view symbol, char* out);
+		static constexpr std::size_t max_line_length(const std::size_t symbolLength) { return symbolLength + 64; }
 	};
 }
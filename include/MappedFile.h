@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace gwatch
+{
+	// A whole file mapped read-only (Linux), or read into memory elsewhere. The bytes are at
+	// least 8-byte aligned (page-aligned when mapped) and stay valid while the object lives.
+	class MappedFile
+	{
+	public:
+		// Throws std::runtime_error when the file cannot be opened or mapped.
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		std::span<const char> bytes() const { return {m_data, m_size}; }
+		const std::string& path() const { return m_path; }
+
+	private:
+		std::string m_path;
+		const char* m_data = nullptr;
+		std::size_t m_size = 0;
+		std::vector<char> m_copy; // without mmap
+		bool m_mapped = false;
+
+		void release();
+	};
+}
@@ -1,11 +1,28 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
 #include <unordered_set>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+
+#include "HotSites.h"
+#include "InstructionDecoder.h"
 #include "ProcessLauncher.h"
 #include "SymbolResolver.h"
+#include "WatchPlan.h"
+#include "WatchRotation.h"
 
 namespace gwatch
 {
@@ -24,33 +41,617 @@ namespace gwatch
 
 #ifdef _WIN32
 
-	// Windows implementation using per-thread hardware data breakpoints (DR0).
-	// On each access (read or write), a SINGLE_STEP exception is delivered.
-	// We read the current value in the target and compare with the previous;
-	// if changed => write "<old> -> <new>", otherwise => read "<val>".
+	// Windows implementation using per-thread hardware data breakpoints.
+	// The watch plan (WatchPlan.h) maps the variables onto DR0..DR3 on every thread; on each
+	// access (read or write), a SINGLE_STEP exception is delivered and DR6 tells which slots
+	// fired. All watched values are read in one go, then each variable of those slots is
+	// compared with its own previous value: if changed => write "<old> -> <new>", otherwise => read "<val>".
+	// On a shared slot the address of the access, rebuilt from the thread's registers, names
+	// the variable; failing that, the variables that changed do (unattributed() otherwise).
 	class WindowsMemoryWatcher final : public IMemoryWatcher
 	{
 	public:
+		// rotateQuantumMs > 0 makes variables that do not fit the slots take turns (WatchRotation.h):
+		// a background thread re-arms every thread with the next group each quantum.
+		// hotSites aggregates the accessing instructions (hot_sites()).
+		WindowsMemoryWatcher(void* hProcess, std::vector<ResolvedSymbol> resolvedSymbols, bool enableHardwareBreakpoints = true, std::uint32_t rotateQuantumMs = 0, bool hotSites = false);
 		WindowsMemoryWatcher(void* hProcess, const ResolvedSymbol& resolvedSymbol, bool enableHardwareBreakpoints = true);
 
-		~WindowsMemoryWatcher() override = default;
+		~WindowsMemoryWatcher() override;
+
+		WindowsMemoryWatcher(const WindowsMemoryWatcher&) = delete;
+		WindowsMemoryWatcher& operator=(const WindowsMemoryWatcher&) = delete;
 
 		ContinueStatus on_event(const DebugEvent& ev) override;
 
+		// Plan armed first. Without rotation, the variables it does not cover are never watched.
+		const WatchPlan& plan() const { return m_rotation.current(); }
+		// Exposes the per-variable estimates once stopped.
+		const WatchRotation& rotation() const { return m_rotation; }
+		bool rotating() const { return m_rotateQuantumMs > 0 && m_rotation.group_count() > 1; }
+		// Sites of the accesses handled so far (null unless enabled).
+		const HotSiteTable* hot_sites() const { return m_hotSites ? &*m_hotSites : nullptr; }
+		// Accesses to a shared slot that changed nothing and whose address could not be rebuilt.
+		std::uint64_t unattributed() const { return m_unattributed; }
+
 	private:
+		struct Watched
+		{
+			ResolvedSymbol symbol;
+			std::optional<std::uint64_t> lastValue;
+			std::uint64_t current = 0; // filled by read_values()
+		};
+
 		void* m_hProcess{};
-		ResolvedSymbol m_resolvedSymbol{};
+		std::vector<Watched> m_watched;
+		WatchRotation m_rotation;
 		bool m_enableHardwareBreakpoints{true};
+		std::uint32_t m_rotateQuantumMs = 0;
+
+		std::mutex m_mutex;
+		std::condition_variable m_rotationWake;
+		bool m_stopRotation = false;
+		std::thread m_rotationThread;
+
+		// A thread and the group of the rotation in its debug registers. A trap can still be
+		// waiting to be reported when the rotation re-arms the thread: its slots are decoded
+		// against the group they fired under and kept in pending until then.
+		struct ArmedThread
+		{
+			static constexpr std::size_t kNoGroup = static_cast<std::size_t>(-1);
+
+			void* handle = nullptr;        // kept open while armed (null when breakpoints are disabled)
+			std::size_t group = kNoGroup;  // group whose plan is in DR0-DR3
+			std::uint64_t pending = 0;     // variables whose slots fired under a group since replaced
+		};
+		std::unordered_map<std::uint32_t, ArmedThread> m_armedThreads;
 
-		std::optional<std::uint64_t> m_lastValue{};
-		std::unordered_set<std::uint32_t> m_armedThreads;
+		// Watched variables closer than kMaxBatchSpan are fetched with a single ReadProcessMemory.
+		std::uint64_t m_spanBase = 0;
+		std::size_t m_spanSize = 0;
+		std::vector<std::byte> m_spanBuffer;
+
+		std::uint64_t m_unattributed = 0;
+		x86::DecodeCache m_decodeCache;
+		// Function ranges of each module (its .pdata), keyed by image base; empty when it has none.
+		std::unordered_map<std::uint64_t, std::vector<x86::CodeRange>> m_functionTables;
+		std::optional<HotSiteTable> m_hotSites;
 
 		static std::uint64_t mask_for_size(std::uint32_t size);
-		static std::uint64_t len_encoding_for_size(std::uint32_t size);
 
 		void install_on_thread(std::uint32_t tid);
-		std::uint64_t read_value() const;
-		ContinueStatus handle_single_step(std::uint32_t tid);
+		void arm_thread(std::uint32_t tid, ArmedThread& thread, std::size_t group);
+		void release_thread(std::uint32_t tid);
+		void rotation_loop();
+		void stop_rotation();
+		// Variables whose slots fired on tid since the last call, cleared in its DR6.
+		std::uint64_t take_triggered(std::uint32_t tid);
+		// Address the access trapping tid at ip was to, rebuilt from its registers.
+		std::optional<std::uint64_t> trap_address(std::uint32_t tid, const x86::Instruction& insn, std::uint64_t ip) const;
+		bool read_values();
+		std::optional<x86::CodeRange> function_at(std::uint64_t address);
+		x86::Instruction classify(std::uint64_t ip);
+		ContinueStatus handle_single_step(std::uint32_t tid, std::uint64_t ip);
+	};
+
+#endif
+#ifdef __linux__
+
+	// Default Linux implementation: ptrace hardware data breakpoints that stop the target.
+	// The watch plan (WatchPlan.h) maps the variables onto DR0..DR3 (RW=11) on every thread as
+	// it appears; each access traps once it has retired and DR6 tells which slots fired. While
+	// the thread is stopped the watched values are read in one go, so they are the ones the
+	// access left: the decoded instruction makes it a write "<old> -> <new>" (stores and
+	// read-modify-writes, even of the same value) or a read "<val>"; an undecoded access is a
+	// write when the value changed. On a shared slot the address of the access, rebuilt from
+	// the thread's registers, names the variable; failing that, the variables that changed do
+	// (unattributed() otherwise).
+	class LinuxMemoryWatcher final : public IMemoryWatcher
+	{
+	public:
+		// hotSites aggregates the accessing instructions (hot_sites()).
+		LinuxMemoryWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, bool hotSites = false);
+
+		~LinuxMemoryWatcher() override = default;
+
+		LinuxMemoryWatcher(const LinuxMemoryWatcher&) = delete;
+		LinuxMemoryWatcher& operator=(const LinuxMemoryWatcher&) = delete;
+		LinuxMemoryWatcher(LinuxMemoryWatcher&&) = delete;
+		LinuxMemoryWatcher& operator=(LinuxMemoryWatcher&&) = delete;
+
+		// Arms every thread as it appears and handles the traps. Must run on the tracing thread.
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		// The variables it does not cover are never watched.
+		const WatchPlan& plan() const { return m_plan; }
+		// Sites of the accesses handled so far (null unless enabled).
+		const HotSiteTable* hot_sites() const { return m_hotSites ? &*m_hotSites : nullptr; }
+		// Accesses to a shared slot that changed nothing and whose address could not be rebuilt.
+		std::uint64_t unattributed() const { return m_unattributed; }
+
+	private:
+		struct Watched
+		{
+			ResolvedSymbol symbol;
+			std::uint64_t lastValue = 0;
+		};
+
+		std::uint32_t m_pid{};
+		std::vector<Watched> m_watched;
+		WatchPlan m_plan;
+		std::vector<std::uint64_t> m_values; // process_vm_readv destination, one per variable
+		std::uint64_t m_unattributed = 0;
+		x86::DecodeCache m_decodeCache;
+		FunctionIndex m_functions; // where the decoder starts
+		std::optional<HotSiteTable> m_hotSites;
+
+		void arm_thread(std::uint32_t tid);
+		ContinueStatus on_trap(std::uint32_t tid, std::uint64_t ip);
+		void read_values();
+		x86::Instruction classify(std::uint64_t ip);
+		// Address the access trapping tid at ip was to, rebuilt from its registers.
+		std::optional<std::uint64_t> trap_address(std::uint32_t tid, const x86::Instruction& insn, std::uint64_t ip) const;
+	};
+
+	struct PerfWatchOptions
+	{
+		bool writes_only = false;         // HW_BREAKPOINT_W instead of HW_BREAKPOINT_RW
+		std::uint32_t ring_pages = 64;    // data pages per CPU ring buffer (power of two)
+		std::uint32_t wakeup_events = 0;  // wake the drain thread every N samples (0 -> use the byte watermark)
+		std::uint32_t wakeup_bytes = 16 * 1024;
+		int poll_timeout_ms = 10;         // upper bound on drain latency when the watermark is not reached
+		std::uint32_t rotate_quantum_ms = 0; // variables that do not fit the slots take turns every N ms (0 -> never armed)
+		bool hot_sites = false;           // aggregate the accessing instructions (hot_sites())
+	};
+
+	// Linux implementation built on perf_event_open hardware breakpoints.
+	// The target is never stopped: every access is sampled (IP, TID, time, user registers) by
+	// the kernel into per-CPU mmap ring buffers, which a drain thread merges by timestamp and
+	// feeds to the Logger. The variables are mapped onto the four per-thread hardware slots by
+	// the watch plan (WatchPlan.h); there is one breakpoint, hence one ring, per slot and CPU.
+	// The kernel cannot capture memory contents at sample time, and a value read later is not
+	// the one the access saw. Each sample is classified instead by decoding forward from the
+	// start of the function holding its IP (cached per IP; unclassified when no symbol gives
+	// that start): a plain move of the whole variable left its value in the sampled registers
+	// (or its immediate), giving a read "<val>" or a write "<old> -> <new>" once the previous
+	// value is known, even when it did not change. Every other access (read-modify-writes,
+	// partial or undecoded ones) is logged by its kind only, "read ?" / "write ?" (see
+	// Logger::log_access), and leaves the old value of the next write unknown; an undecoded
+	// access is a write when the value changed since the last known one.
+	// On a shared slot, the memory operand rebuilt from the sampled registers names the
+	// variable; a sample whose address cannot be rebuilt is counted in unattributed() rather
+	// than reported for each variable. The decoded instruction is also where the access
+	// happened: with hot_sites, every sample is counted per (instruction, kind) in a bounded
+	// HotSiteTable.
+	class LinuxPerfMemoryWatcher final : public IMemoryWatcher
+	{
+	public:
+		LinuxPerfMemoryWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const PerfWatchOptions& options = {});
+		LinuxPerfMemoryWatcher(std::uint32_t pid, const ResolvedSymbol& resolvedSymbol, const PerfWatchOptions& options = {});
+
+		~LinuxPerfMemoryWatcher() override;
+
+		LinuxPerfMemoryWatcher(const LinuxPerfMemoryWatcher&) = delete;
+		LinuxPerfMemoryWatcher& operator=(const LinuxPerfMemoryWatcher&) = delete;
+		LinuxPerfMemoryWatcher(LinuxPerfMemoryWatcher&&) = delete;
+		LinuxPerfMemoryWatcher& operator=(LinuxPerfMemoryWatcher&&) = delete;
+
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		// Arms the breakpoints on every CPU and starts the drain thread.
+		void start();
+		// Disarms, drains what is left in the rings and joins the drain thread.
+		void stop();
+
+		std::uint64_t samples() const { return m_samples.load(std::memory_order_relaxed); }
+		std::uint64_t lost() const { return m_lost.load(std::memory_order_relaxed); }
+		// Samples on a shared slot whose address could not be rebuilt, hence not logged.
+		std::uint64_t unattributed() const { return m_unattributed.load(std::memory_order_relaxed); }
+
+		// Plan armed first. Without rotation, the variables it does not cover are never watched.
+		const WatchPlan& plan() const { return m_rotation.current(); }
+		// Exposes the per-variable estimates once stopped.
+		const WatchRotation& rotation() const { return m_rotation; }
+		bool rotating() const { return m_options.rotate_quantum_ms > 0 && m_rotation.group_count() > 1; }
+		// Sites of the samples drained so far (null unless enabled); read it once stopped.
+		const HotSiteTable* hot_sites() const { return m_hotSites ? &*m_hotSites : nullptr; }
+
+	private:
+		struct Ring
+		{
+			int fd = -1;
+			void* base = nullptr;
+			std::size_t mapSize = 0;
+			std::uint32_t slot = 0; // index in the slots of the current plan
+		};
+
+		struct Sample
+		{
+			std::uint64_t time = 0;
+			std::uint64_t ip = 0;
+			std::uint32_t tid = 0;
+			std::uint32_t slot = 0;
+			bool hasRegisters = false;
+			std::array<std::uint64_t, x86::kRegisters> registers{}; // once the access retired, by x86 encoding
+		};
+
+		struct Watched
+		{
+			ResolvedSymbol symbol;
+			std::optional<std::uint64_t> lastValue;
+			std::optional<std::uint64_t> current; // filled by read_values()
+		};
+
+		std::uint32_t m_pid{};
+		std::vector<Watched> m_watched;
+		WatchRotation m_rotation;
+		PerfWatchOptions m_options{};
+		std::vector<std::uint64_t> m_values; // process_vm_readv destination, one per variable
+
+		std::vector<Ring> m_rings;
+		std::vector<Sample> m_batch;
+		x86::DecodeCache m_decodeCache;
+		FunctionIndex m_functions; // where the decoder starts
+		std::optional<HotSiteTable> m_hotSites;
+
+		std::thread m_drainThread;
+		std::atomic<bool> m_stopRequested{false};
+		std::atomic<std::uint64_t> m_samples{0};
+		std::atomic<std::uint64_t> m_lost{0};
+		std::atomic<std::uint64_t> m_unattributed{0};
+
+		void open_rings();
+		void close_rings();
+		void drain_loop();
+		void drain_once();
+		void rotate();
+		void program_rings(const WatchPlan& plan);
+		std::uint64_t read_ring(Ring& ring);
+		void read_values();
+		x86::Instruction classify(std::uint64_t ip);
+	};
+
+	// Software engine for objects of any size (ring buffers, lookup tables). The pages covering
+	// them are made read-only with mprotect calls injected into the target through ptrace, so
+	// a store raises SIGSEGV whose address gives the exact element. The page is made writable
+	// again for a single step of the faulting thread, then protected again, and the element is
+	// logged as "<symbol>[<index>] write <old> -> <new>"; in elements larger than 8 bytes
+	// (structs) the bytes the faulting instruction stored are logged as "<symbol>[<index>]+<offset>".
+	// Stores to other data sharing those pages fault as well: they are filtered with one lookup and counted as false sharing.
+	// Limits: reads are not observed, stores made by the kernel on the target's behalf (read(2)
+	// into a watched buffer) fail with EFAULT instead of faulting, and the other threads keep
+	// running while a page is open for a step. Must run on the tracing thread.
+	class LinuxPageMemoryWatcher final : public IMemoryWatcher
+	{
+	public:
+		LinuxPageMemoryWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols);
+
+		~LinuxPageMemoryWatcher() override = default;
+
+		LinuxPageMemoryWatcher(const LinuxPageMemoryWatcher&) = delete;
+		LinuxPageMemoryWatcher& operator=(const LinuxPageMemoryWatcher&) = delete;
+		LinuxPageMemoryWatcher(LinuxPageMemoryWatcher&&) = delete;
+		LinuxPageMemoryWatcher& operator=(LinuxPageMemoryWatcher&&) = delete;
+
+		// Protects the pages at the first _CreateProcess, then handles faults and steps.
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		std::uint64_t hits() const { return m_hits; }
+		std::uint64_t false_sharing() const { return m_falseSharing; }
+		std::size_t protected_pages() const;
+
+	private:
+		// Page-aligned [begin, end) and the protection it had before being armed.
+		struct Range
+		{
+			std::uint64_t begin = 0;
+			std::uint64_t end = 0;
+			int prot = 0;
+		};
+
+		// Single step in progress on one thread.
+		struct Step
+		{
+			static constexpr std::size_t kMaxPages = 4;
+
+			std::array<std::uint64_t, kMaxPages> pages{};
+			std::size_t pageCount = 0;
+			std::int32_t object = -1; // watched object that faulted, -1 for false sharing
+			std::uint64_t offset = 0;
+			std::uint32_t width = 0;  // bytes the faulting instruction stores, 0 when unknown
+			std::uint64_t old = 0;
+			std::uint64_t startNs = 0;
+		};
+
+		std::uint32_t m_pid{};
+		std::vector<ResolvedSymbol> m_objects; // sorted by address
+		std::vector<Range> m_ranges;           // sorted, disjoint
+		std::uint64_t m_pageSize = 4096;
+		std::uint64_t m_syscall = 0;           // address of a syscall instruction in the target
+		bool m_armed = false;
+
+		std::unordered_map<std::uint64_t, std::uint32_t> m_openPages; // page -> threads stepping on it
+		std::unordered_map<std::uint32_t, Step> m_steps;              // tid -> step in progress
+		std::vector<std::uint64_t> m_staleOpen; // open pages whose stepping thread exited
+		std::vector<int> m_deferredSignals;     // caught while a syscall was injected
+		x86::DecodeCache m_decodeCache;
+		std::string m_name;
+
+		std::uint64_t m_hits = 0;
+		std::uint64_t m_falseSharing = 0;
+
+		void arm(std::uint32_t tid);
+		ContinueStatus on_fault(std::uint32_t tid, std::uint64_t ip);
+		std::uint32_t store_width(std::uint64_t ip);
+		void finish_step(std::uint32_t tid, bool executed);
+		void open_page(std::uint32_t tid, std::uint64_t page);
+		void close_page(std::uint32_t tid, std::uint64_t page);
+		void protect(std::uint32_t tid, std::uint64_t begin, std::uint64_t length, int prot);
+		const Range* range_of(std::uint64_t page) const;
+		std::int32_t object_at(std::uint64_t address) const;
+		std::uint64_t read_value(std::uint64_t address, std::uint32_t width) const;
+	};
+
+	struct DirtyWatchOptions
+	{
+		std::uint32_t interval_us = 10'000; // time between two scans (0 -> scan back to back)
+	};
+
+	// Software engine for whole regions (a section such as ".bss", large tables). The target is
+	// never stopped: a scan thread wakes up every interval, reads which pages were written since
+	// the previous scan from the soft-dirty bit of /proc/<pid>/pagemap (then clears the bits
+	// through /proc/<pid>/clear_refs), fetches only those pages with one batched process_vm_readv
+	// and diffs them against a shadow copy. Each changed global (from the symbol table, bytes
+	// outside any global are reported as "<region>+<offset>") is logged once per scan as
+	// "<name> write <old> -> <new>" with tid 0. Several stores between two scans collapse into one
+	// and a store racing with the clear is reported with the next store to its page, or by the
+	// final scan at exit, which diffs every page. Without CONFIG_MEM_SOFT_DIRTY
+	// (soft_dirty() == false) every page is diffed on each scan.
+	class LinuxDirtyPageWatcher final : public IMemoryWatcher
+	{
+	public:
+		// globals names the changes inside the regions; they need not cover them.
+		LinuxDirtyPageWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> regions, std::vector<ResolvedSymbol> globals = {}, const DirtyWatchOptions& options = {});
+
+		~LinuxDirtyPageWatcher() override;
+
+		LinuxDirtyPageWatcher(const LinuxDirtyPageWatcher&) = delete;
+		LinuxDirtyPageWatcher& operator=(const LinuxDirtyPageWatcher&) = delete;
+		LinuxDirtyPageWatcher(LinuxDirtyPageWatcher&&) = delete;
+		LinuxDirtyPageWatcher& operator=(LinuxDirtyPageWatcher&&) = delete;
+
+		// Takes the shadow copy at the first _CreateProcess, runs a last scan at ExitProcess.
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		// Snapshots the regions and starts the scan thread.
+		void start();
+		// Joins the scan thread and scans one last time.
+		void stop();
+
+		bool soft_dirty() const { return m_softDirty; }
+		std::size_t watched_pages() const { return m_pages.size(); }
+		std::uint64_t scans() const { return m_scans.load(std::memory_order_relaxed); }
+		std::uint64_t pages_diffed() const { return m_diffed.load(std::memory_order_relaxed); }
+		std::uint64_t changes() const { return m_changed.load(std::memory_order_relaxed); }
+
+		// Whether this kernel tracks soft-dirty bits (probed once on a page of our own).
+		static bool soft_dirty_supported();
+
+	private:
+		// Element that changed during a scan, its value before the scan.
+		struct Change
+		{
+			const ResolvedSymbol* owner = nullptr;
+			ElementSpan span;
+			std::uint64_t old = 0;
+		};
+
+		std::uint32_t m_pid{};
+		std::vector<ResolvedSymbol> m_regions; // sorted by address
+		std::vector<ResolvedSymbol> m_globals; // sorted by address
+		DirtyWatchOptions m_options{};
+		std::uint64_t m_pageSize = 4096;
+		bool m_softDirty = false;
+
+		std::vector<std::uint64_t> m_pages; // sorted page addresses covering the regions
+		std::vector<std::byte> m_shadow;    // one page per entry of m_pages
+		std::vector<std::byte> m_fresh;     // dirty pages of the current scan, in order
+		std::vector<std::uint64_t> m_entries; // pagemap entries of the current scan
+		std::vector<std::uint32_t> m_dirty;   // indices in m_pages of the current scan
+		std::vector<Change> m_changes;
+		std::string m_name;
+		int m_pagemapFd = -1;
+		int m_clearRefsFd = -1;
+
+		std::thread m_scanThread;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_stopRequested = false;
+		bool m_started = false;
+		std::atomic<std::uint64_t> m_scans{0};
+		std::atomic<std::uint64_t> m_diffed{0};
+		std::atomic<std::uint64_t> m_changed{0};
+
+		void scan_loop();
+		void scan(bool full);
+		void collect_dirty(bool full);
+		void read_pages(const std::vector<std::uint32_t>& pages, std::vector<std::byte>& out) const;
+		void diff_page(std::uint32_t page, const std::byte* fresh);
+		const ResolvedSymbol* owner_of(std::uint64_t address) const;
+		std::uint64_t shadow_value(std::uint64_t address, std::uint32_t width) const;
+		void close_files();
+	};
+
+	struct PollWatchOptions
+	{
+		std::uint32_t interval_us = 100; // time between two reads (0 -> busy poll)
+	};
+
+	// Change counts of one polled variable.
+	struct PollStats
+	{
+		std::uint64_t changes = 0;
+		// Intermediate values the variable must have taken between two reads, counted when it
+		// moves by a multiple of the smallest step it was seen to take (counters, indices).
+		// Arbitrary jumps give no estimate, so this is a lower bound.
+		std::uint64_t missed = 0;
+		std::uint64_t step = 0;
+	};
+
+	// Software engine that never perturbs the target: a polling thread reads every watched
+	// variable with one vectored process_vm_readv per tick, every interval or back to back,
+	// and logs "<symbol> write <old> -> <new>" with the time of the read and tid 0 whenever a
+	// value differs from the previous tick. Reads are not observed, and several stores within
+	// one tick collapse into one change, counted as missed when the step gives it away.
+	class LinuxPollMemoryWatcher final : public IMemoryWatcher
+	{
+	public:
+		LinuxPollMemoryWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const PollWatchOptions& options = {});
+
+		~LinuxPollMemoryWatcher() override;
+
+		LinuxPollMemoryWatcher(const LinuxPollMemoryWatcher&) = delete;
+		LinuxPollMemoryWatcher& operator=(const LinuxPollMemoryWatcher&) = delete;
+		LinuxPollMemoryWatcher(LinuxPollMemoryWatcher&&) = delete;
+		LinuxPollMemoryWatcher& operator=(LinuxPollMemoryWatcher&&) = delete;
+
+		// Reads the initial values at the first _CreateProcess, polls one last time at ExitProcess.
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		// Reads the initial values and starts the polling thread.
+		void start();
+		// Joins the polling thread and reads one last time.
+		void stop();
+
+		std::uint64_t ticks() const { return m_ticks.load(std::memory_order_relaxed); }
+		// Ticks that started later than scheduled (the thread was descheduled).
+		std::uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+		// One entry per variable, in the order given, once stopped.
+		const std::vector<PollStats>& poll_stats() const { return m_stats; }
+		const ResolvedSymbol& symbol(const std::size_t variable) const { return m_symbols[variable]; }
+		std::uint64_t elapsed_ns() const { return m_elapsedNs; }
+
+	private:
+		std::uint32_t m_pid{};
+		std::vector<ResolvedSymbol> m_symbols;
+		PollWatchOptions m_options{};
+		std::vector<iovec> m_local;  // one per variable, into m_values
+		std::vector<iovec> m_remote; // one per variable
+		std::vector<std::uint64_t> m_values;
+		std::vector<std::uint64_t> m_last;
+		std::vector<PollStats> m_stats;
+		std::uint64_t m_startNs = 0;
+		std::uint64_t m_elapsedNs = 0;
+
+		std::thread m_pollThread;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::atomic<bool> m_stopRequested{false};
+		bool m_started = false;
+		std::atomic<std::uint64_t> m_ticks{0};
+		std::atomic<std::uint64_t> m_overruns{0};
+
+		void poll_loop();
+		bool poll_once(std::uint64_t timestamp);
+	};
+
+	struct HybridWatchOptions
+	{
+		std::uint32_t summary_interval_ms = 1'000; // per-thread read counts every N ms (0 -> only at exit)
+		bool hot_sites = false;                    // aggregate the storing instructions (hot_sites())
+	};
+
+	// Hybrid engine for read-heavy variables: writes stop the target, reads never do. Every
+	// thread gets write-only hardware breakpoints (RW=01) through ptrace from the watch plan, so
+	// a store traps once it has retired and is logged exactly as "<symbol> write <old> -> <new>"
+	// with its thread. On a shared slot the address of the store, rebuilt from the trapping
+	// thread's registers, names the variable; failing that, the variables that changed do, and a
+	// store of the same value is counted in unattributed(). Reads are counted by the kernel:
+	// one non-sampling perf breakpoint counter (RW) per thread and slot, whose debug exceptions
+	// are handled without a stop; a slot's reads are its count minus its trapped writes. A write
+	// breakpoint and its counter take two of the four debug registers, so the plan has two
+	// slots. A summary thread prints the read counts per thread on stderr every interval, and
+	// once more at exit. Only writes have a site (the trapping instruction, for hot_sites): the
+	// kernel counts reads without an IP.
+	class LinuxHybridMemoryWatcher final : public IMemoryWatcher
+	{
+	public:
+		static constexpr std::size_t kSlots = 2;
+
+		// Reads and writes of one thread, per slot of the plan.
+		struct ThreadCounts
+		{
+			std::uint32_t tid = 0;
+			std::array<std::uint64_t, kSlots> reads{};
+			std::array<std::uint64_t, kSlots> writes{};
+		};
+
+		LinuxHybridMemoryWatcher(std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const HybridWatchOptions& options = {});
+
+		~LinuxHybridMemoryWatcher() override;
+
+		LinuxHybridMemoryWatcher(const LinuxHybridMemoryWatcher&) = delete;
+		LinuxHybridMemoryWatcher& operator=(const LinuxHybridMemoryWatcher&) = delete;
+		LinuxHybridMemoryWatcher(LinuxHybridMemoryWatcher&&) = delete;
+		LinuxHybridMemoryWatcher& operator=(LinuxHybridMemoryWatcher&&) = delete;
+
+		// Arms every thread as it appears and handles the write traps. Must run on the tracing thread.
+		ContinueStatus on_event(const DebugEvent& ev) override;
+
+		// The variables it does not cover are never watched.
+		const WatchPlan& plan() const { return m_plan; }
+		// Variables of a slot joined by ',', as the summaries name them.
+		const std::string& slot_name(std::size_t slot) const { return m_slotNames[slot]; }
+		// Every thread seen so far, in creation order (final once the target has exited).
+		std::vector<ThreadCounts> counts() const;
+		// Sites of the trapped writes (null unless enabled).
+		const HotSiteTable* hot_sites() const { return m_hotSites ? &*m_hotSites : nullptr; }
+		// Same-value stores on a shared slot whose address could not be rebuilt, hence not logged.
+		std::uint64_t unattributed() const { return m_unattributed; }
+
+	private:
+		struct Watched
+		{
+			ResolvedSymbol symbol;
+			std::uint64_t lastValue = 0;
+		};
+
+		struct Thread
+		{
+			ThreadCounts counts;
+			std::array<int, kSlots> counters{-1, -1}; // perf RW counters, -1 once the thread exited
+			std::array<std::uint64_t, kSlots> reported{}; // reads in the previous summary
+		};
+
+		std::uint32_t m_pid{};
+		std::vector<Watched> m_watched;
+		WatchPlan m_plan;
+		std::vector<std::string> m_slotNames;
+		HybridWatchOptions m_options{};
+		std::vector<std::uint64_t> m_values; // process_vm_readv destination, one per variable
+		std::uint64_t m_startNs = 0;
+		std::uint64_t m_unattributed = 0;
+		x86::DecodeCache m_decodeCache;
+		FunctionIndex m_functions; // where the decoder starts
+		std::optional<HotSiteTable> m_hotSites;
+
+		mutable std::mutex m_mutex;   // guards m_threads against the summary thread
+		std::vector<Thread> m_threads;
+		std::condition_variable m_wake;
+		bool m_stopRequested = false;
+		std::thread m_summaryThread;
+
+		void arm_thread(std::uint32_t tid);
+		void release_thread(std::uint32_t tid);
+		ContinueStatus on_trap(std::uint32_t tid, std::uint64_t ip);
+		void read_values();
+		x86::Instruction classify(std::uint64_t ip);
+		// Address the store trapping tid at ip wrote, rebuilt from its registers.
+		std::optional<std::uint64_t> trap_address(std::uint32_t tid, const x86::Instruction& insn, std::uint64_t ip) const;
+		void refresh_reads(Thread& thread) const;
+		void summary_loop();
+		void print_summary(bool final);
+		void stop();
 	};
 
 #endif
@@ -1,12 +1,17 @@
 #pragma once
+#include <concepts>
 #include <cstdint>
 #include <string>
+#include <type_traits>
+#include <unordered_set>
 #include <string_view>
 #include <vector>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 
+#include "StringTable.h"
+
 namespace gwatch
 {
 	class ProcessError final : public std::runtime_error
@@ -51,7 +56,7 @@ namespace gwatch
 	{
 		std::uint64_t image_base = 0;   // base address of the image (module)
 		std::uint64_t entry_point = 0;  // entry-point address
-		std::string image_path;         // best-effort resolved path (may be empty)
+		StringId image_path = kEmptyString; // best-effort resolved path, see IProcessLauncher::strings()
 	};
 
 	struct ExitProcessInfo
@@ -71,8 +76,8 @@ namespace gwatch
 
 	struct LoadDllInfo
 	{
-		std::uint64_t base = 0;      // base address of the loaded module
-		std::string path;            // best-effort resolved path (may be empty)
+		std::uint64_t base = 0;          // base address of the loaded module
+		StringId path = kEmptyString;    // best-effort resolved path, see IProcessLauncher::strings()
 	};
 
 	struct UnloadDllInfo
@@ -82,7 +87,7 @@ namespace gwatch
 
 	struct OutputDebugStringInfo
 	{
-		std::string message;
+		StringId message = kEmptyString;
 	};
 
 	struct RipInfo
@@ -92,6 +97,8 @@ namespace gwatch
 	};
 
 	// Generic event container passed to the client sink.
+	// Every payload is a POD (strings are StringIds), so building, copying and dispatching an
+	// event never touches the heap.
 	struct DebugEvent
 	{
 		DebugEventType type{};
@@ -111,11 +118,15 @@ namespace gwatch
 		> payload;
 	};
 
+	static_assert(std::is_trivially_copyable_v<DebugEvent>, "DebugEvent must stay allocation-free");
+
 	// What the client asks the loop to do after an event.
 	// - Default: let the launcher decide sensible defaults (e.g., swallow breakpoints).
 	// - Continue: force DBG_CONTINUE (Windows).
 	// - NotHandled: force DBG_EXCEPTION_NOT_HANDLED (Windows).
-	enum class ContinueStatus { Default, Continue, NotHandled };
+	// - SingleStep: like Continue, but the thread stops again after one instruction
+	//   (trap flag on Windows, PTRACE_SINGLESTEP on Linux).
+	enum class ContinueStatus { Default, Continue, NotHandled, SingleStep };
 
 	// Event sink implemented by the watcher to observe and steer the debug loop.
 	class IDebugEventSink
@@ -128,6 +139,13 @@ namespace gwatch
 		virtual ContinueStatus on_event(const DebugEvent& ev) = 0;
 	};
 
+	// Anything with a matching on_event can be bound to a launcher at compile time.
+	template <typename T>
+	concept DebugEventHandler = requires(T& sink, const DebugEvent& ev)
+	{
+		{ sink.on_event(ev) } -> std::same_as<ContinueStatus>;
+	};
+
 	class IProcessLauncher
 	{
 	public:
@@ -139,8 +157,25 @@ namespace gwatch
 
 		virtual std::uint32_t pid() const = 0;
 		virtual bool running() const = 0;
+
+		// Resolves the StringIds carried by this launcher's events.
+		virtual const StringTable& strings() const = 0;
 	};
 
+	// Debug loop with a statically bound sink. Launcher is a concrete launcher exposing
+	// next_event/complete_event/exit_code; when Sink (and what it forwards to) is final, the
+	// whole dispatch is direct calls. run_debug_loop(IDebugEventSink&) is this with Sink = the interface.
+	template <typename Launcher, DebugEventHandler Sink>
+	std::optional<std::uint32_t> drive_debug_loop(Launcher& launcher, Sink& sink)
+	{
+		DebugEvent ev{};
+		while (launcher.next_event(ev))
+		{
+			launcher.complete_event(ev, sink.on_event(ev));
+		}
+		return launcher.exit_code();
+	}
+
 #ifdef _WIN32
 
 	class WindowsProcessLauncher final : public IProcessLauncher
@@ -158,19 +193,29 @@ namespace gwatch
 		std::optional<std::uint32_t> run_debug_loop(IDebugEventSink& sink) override;
 		void stop() override;
 
+		// Step-wise loop for drive_debug_loop: next_event waits for the next event to report
+		// (returns false once the process is gone), complete_event resumes the target.
+		bool next_event(DebugEvent& ev);
+		void complete_event(const DebugEvent& ev, ContinueStatus sinkDecision);
+		std::optional<std::uint32_t> exit_code() const { return m_exitCode; }
+
 		void* native_process_handle() const;
 		std::uint32_t pid() const override { return m_pid; }
 		bool running() const override { return m_running; }
+		const StringTable& strings() const override { return m_strings; }
 
 	private:
 		void* m_hProcess = nullptr;
 		void* m_hThread = nullptr;
 		std::uint32_t m_pid = 0;
 		std::uint32_t m_tid = 0;
+		StringTable m_strings;
 
 		bool m_launched = false;
 		bool m_running = false;
 		bool m_requestStop = false;
+		std::optional<std::uint32_t> m_exitCode;
+		std::int64_t m_handleStartNs = 0; // GWATCH_PROFILE only, kept unconditional for a stable layout
 
 		static std::wstring to_wstring(std::string_view s);
 		static std::string utf8_from_wstring(std::wstring_view ws);
@@ -180,5 +225,63 @@ namespace gwatch
 		static std::uint32_t map_continue_code(ContinueStatus sinkDecision, const DebugEvent& ev);
 	};
 
+#endif
+#ifdef __linux__
+
+	// Linux implementation on top of ptrace.
+	// The target is started with clone(CLONE_VM | CLONE_VFORK) + PTRACE_TRACEME + execv (no
+	// page-table copy of the parent, so startup does not grow with the debugger's RSS) and
+	// traced with PTRACE_O_TRACECLONE | TRACEEXEC | TRACEEXIT | EXITKILL. waitpid stops are translated:
+	//   exec stop          -> _CreateProcess
+	//   new thread stop    -> CreateThread
+	//   PTRACE_EVENT_EXIT  -> ExitThread, or ExitProcess for the last thread (memory still readable)
+	//   signal-delivery    -> Exception (code = signal number, address = instruction pointer)
+	// Job control is left to the target: stop signals are delivered, the threads that enter the
+	// group-stop are kept stopped and only resumed once the process is continued (SIGCONT).
+	class LinuxProcessLauncher final : public IProcessLauncher
+	{
+	public:
+		LinuxProcessLauncher();
+		~LinuxProcessLauncher() override;
+
+		LinuxProcessLauncher(const LinuxProcessLauncher&) = delete;
+		LinuxProcessLauncher& operator=(const LinuxProcessLauncher&) = delete;
+		LinuxProcessLauncher(LinuxProcessLauncher&&) = delete;
+		LinuxProcessLauncher& operator=(LinuxProcessLauncher&&) = delete;
+
+		void launch(const LaunchConfig& cfg) override;
+		std::optional<std::uint32_t> run_debug_loop(IDebugEventSink& sink) override;
+		void stop() override;
+
+		// Step-wise loop for drive_debug_loop: next_event waits for the next event to report
+		// (returns false once the process is gone), complete_event resumes the stopped thread.
+		bool next_event(DebugEvent& ev);
+		void complete_event(const DebugEvent& ev, ContinueStatus sinkDecision);
+		std::optional<std::uint32_t> exit_code() const { return m_exitCode; }
+
+		std::uint32_t pid() const override { return static_cast<std::uint32_t>(m_pid); }
+		bool running() const override { return m_running; }
+		const StringTable& strings() const override { return m_strings; }
+
+	private:
+		int m_pid = 0;
+		std::string m_exePath;
+		std::unordered_set<int> m_threads;
+		std::unordered_set<int> m_groupStopped; // held in a group-stop until WIFCONTINUED
+		StringTable m_strings;
+
+		bool m_launched = false;
+		bool m_running = false;
+		bool m_requestStop = false;
+		bool m_pendingCreate = false;
+		std::optional<std::uint32_t> m_exitCode;
+		std::int64_t m_handleStartNs = 0; // GWATCH_PROFILE only, kept unconditional for a stable layout
+
+		CreateProcessInfo describe_image();
+		void resume(int tid, int signal, bool singleStep = false);
+		static std::uint64_t instruction_pointer(int tid);
+		static int map_continue_signal(ContinueStatus sinkDecision, const DebugEvent& ev);
+	};
+
 #endif
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string_view>
 
 #ifdef GWATCH_PROFILE
 #include <chrono>
@@ -29,11 +30,45 @@ namespace gwatch::profiling
 
 	// Program phases and loop timings
 	void add_process_launch_duration(std::uint64_t nanoseconds);
+	void add_launch_to_first_event_duration(std::uint64_t nanoseconds);
 	void add_symbol_resolve_duration(std::uint64_t nanoseconds);
 	void add_setup_watcher_duration(std::uint64_t nanoseconds);
 	void add_loop_wait_duration(std::uint64_t nanoseconds);
 	void add_loop_handle_duration(std::uint64_t nanoseconds);
 	void inc_loop_iteration();
+
+	// Non-stopping perf watcher (ring buffer drains)
+	void add_perf_drain(std::uint64_t samples, std::uint64_t lost, std::uint64_t nanoseconds);
+
+	// Watch rotation: how long a variable was armed out of the whole run
+	void add_watch_coverage(std::string_view name, std::uint64_t armedNs, std::uint64_t totalNs, std::uint64_t observed);
+
+	// Page-protection watcher: one call per fault, from the fault to the page protected again
+	void add_page_fault(bool falseSharing, std::uint64_t nanoseconds);
+
+	// Soft-dirty watcher: one call per scan (pagemap read + clear, then fetch + diff of the dirty pages)
+	void add_dirty_scan(std::uint64_t pages, std::uint64_t dirtyPages, std::uint64_t scanNanoseconds, std::uint64_t diffNanoseconds);
+
+	// Polling watcher: one call per run, its reads, the late ones and how long it polled
+	void add_poll_run(std::uint64_t ticks, std::uint64_t overruns, std::uint64_t nanoseconds);
+
+	// Asynchronous logger writer thread (one call per writev batch)
+	void add_async_log_batch(std::uint64_t records, std::uint64_t bytes, std::uint64_t nanoseconds);
+
+	// Logger policies: one call per access kept out of the output
+	void add_log_drop(bool write, bool sampled);
+
+	// Asynchronous output queue, once stopped: highest occupancy and what overflowed
+	void add_output_queue(std::uint64_t peak, std::uint64_t dropped, std::uint64_t spilledBytes);
+
+	// io_uring trace storage: one call per completed write (writes in flight when it was
+	// submitted, itself included), then the time writes were in flight once the file is closed
+	void add_trace_write(std::uint64_t bytes, std::uint64_t inFlight, std::uint64_t latencyNs);
+	void add_trace_io_busy(std::uint64_t nanoseconds);
+
+	// Compression stage, once stopped: raw and compressed bytes (headers and index included)
+	// and the worker time spent in the codec
+	void add_compression(std::uint64_t blocks, std::uint64_t rawBytes, std::uint64_t compressedBytes, std::uint64_t nanoseconds);
 #else
 	class EventTimer
 	{
@@ -44,10 +79,22 @@ namespace gwatch::profiling
 	inline void add_read_duration(std::uint64_t) {}
 	inline void add_log_duration(std::uint64_t) {}
     inline void add_process_launch_duration(std::uint64_t) {}
+    inline void add_launch_to_first_event_duration(std::uint64_t) {}
     inline void add_symbol_resolve_duration(std::uint64_t) {}
     inline void add_setup_watcher_duration(std::uint64_t) {}
     inline void add_loop_wait_duration(std::uint64_t) {}
     inline void add_loop_handle_duration(std::uint64_t) {}
     inline void inc_loop_iteration() {}
+    inline void add_perf_drain(std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_watch_coverage(std::string_view, std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_page_fault(bool, std::uint64_t) {}
+    inline void add_dirty_scan(std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_poll_run(std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_async_log_batch(std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_log_drop(bool, bool) {}
+    inline void add_output_queue(std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_trace_write(std::uint64_t, std::uint64_t, std::uint64_t) {}
+    inline void add_trace_io_busy(std::uint64_t) {}
+    inline void add_compression(std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t) {}
 #endif
 }
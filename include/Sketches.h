@@ -0,0 +1,100 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gwatch
+{
+	// Fixed-size summaries of unbounded streams, for --mode=stats (AccessStats.h). Each one
+	// takes the same memory after a billion values as after the first.
+
+	// Counts of values per power-of-two bucket: bucket b holds [2^(b-1), 2^b), bucket 0 holds 0.
+	class Log2Histogram
+	{
+	public:
+		static constexpr std::size_t kBuckets = 65;
+
+		void add(std::uint64_t value);
+
+		std::uint64_t count() const { return m_count; }
+		std::uint64_t bucket(std::size_t b) const { return m_buckets[b]; }
+		// Smallest value of bucket b.
+		static std::uint64_t lower_bound(std::size_t b) { return b == 0 ? 0 : 1ull << (b - 1); }
+
+	private:
+		std::array<std::uint64_t, kBuckets> m_buckets{};
+		std::uint64_t m_count = 0;
+	};
+
+	// HyperLogLog distinct count: 2^precision one-byte registers, standard error 1.04/sqrt(2^precision)
+	// (1.6% at the default 12), exact-ish below a few thousand values through linear counting.
+	class HyperLogLog
+	{
+	public:
+		explicit HyperLogLog(unsigned precision = 12);
+
+		void add(std::uint64_t value);
+		double estimate() const;
+
+	private:
+		unsigned m_precision;
+		std::vector<std::uint8_t> m_registers;
+	};
+
+	// Space-saving heavy hitters (Metwally et al.): k counters; a new value takes over the
+	// smallest one and inherits its count as error. Every value more frequent than n/k is kept,
+	// and a kept value's true count lies in [count - error, count].
+	class SpaceSaving
+	{
+	public:
+		struct Counter
+		{
+			std::uint64_t value = 0;
+			std::uint64_t count = 0;
+			std::uint64_t error = 0;
+		};
+
+		explicit SpaceSaving(std::size_t capacity = 32);
+
+		void add(std::uint64_t value);
+		// The n largest counters, by decreasing count then value.
+		std::vector<Counter> top(std::size_t n) const;
+
+	private:
+		std::size_t m_capacity;
+		std::vector<Counter> m_counters;
+	};
+
+	// Merging t-digest (Dunning): values are buffered, then merged into at most ~compression
+	// centroids sized by the arcsine scale function, so the tails stay accurate.
+	class TDigest
+	{
+	public:
+		explicit TDigest(double compression = 100.0);
+
+		void add(double value);
+		// Interpolated value at quantile q in [0, 1]; 0 when empty.
+		double quantile(double q) const;
+
+		std::uint64_t count() const { return m_count; }
+		std::size_t centroids() const;
+
+	private:
+		struct Centroid
+		{
+			double mean = 0;
+			double weight = 0;
+		};
+
+		double m_compression;
+		// Merged lazily: quantile() is logically const.
+		mutable std::vector<Centroid> m_centroids;
+		mutable std::vector<Centroid> m_buffer;
+		std::uint64_t m_count = 0;
+		double m_min = 0;
+		double m_max = 0;
+
+		void merge() const;
+	};
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace gwatch
+{
+	using StringId = std::uint32_t;
+
+	// Id of the empty string, always present.
+	inline constexpr StringId kEmptyString = 0;
+
+	// Append-only table of interned strings backed by an arena: nothing is ever removed, so
+	// every distinct string stays for the lifetime of the table. Equal strings share one id,
+	// ids and views stay valid as long as the table. Debug events carry StringIds so they stay
+	// trivially copyable; the launcher that produced them owns the table. It only takes image
+	// paths (one per module loaded), never per-access data, which would grow it without bound.
+	class StringTable
+	{
+	public:
+		StringTable();
+
+		StringTable(const StringTable&) = delete;
+		StringTable& operator=(const StringTable&) = delete;
+
+		StringId intern(std::string_view s);
+		// Unknown ids map to the empty string.
+		std::string_view view(StringId id) const;
+		std::size_t size() const { return m_strings.size(); }
+
+	private:
+		static constexpr std::size_t kChunkSize = 16 * 1024;
+
+		std::vector<std::unique_ptr<char[]>> m_chunks;
+		std::vector<std::unique_ptr<char[]>> m_large;
+		std::size_t m_chunkUsed = kChunkSize;
+		std::vector<std::string_view> m_strings;
+		std::unordered_map<std::string_view, StringId> m_index;
+
+		std::string_view store(std::string_view s);
+	};
+}
@@ -1,10 +1,14 @@
 #pragma once
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <optional>
+#include <span>
 #include <unordered_map>
+#include <vector>
 
 namespace gwatch
 {
@@ -14,6 +18,43 @@ namespace gwatch
 		std::string module;    // module base as hex string
 		std::uint64_t address; // virtual address in the target process
 		std::uint64_t size;    // size in bytes
+		std::uint64_t element = 0; // array element size in bytes (0 -> not an array, or unknown)
+	};
+
+	// Part of an object that is reported as one value: an array element (name[i]) up to 8 bytes,
+	// otherwise bytes of the object (name+offset) or of its element (name[i]+offset): those an
+	// access of known width touched (at most 8), or the aligned 8-byte word holding offset.
+	struct ElementSpan
+	{
+		std::uint64_t start = 0; // offset of the first byte in the object
+		std::uint32_t width = 0; // 1..8 bytes
+	};
+
+	// Span holding the byte at offset in object; name receives its display name. width is the
+	// size of the access that started at offset, 0 when unknown.
+	ElementSpan element_at(const ResolvedSymbol& object, std::uint64_t offset, std::string& name, std::uint32_t width = 0);
+
+	// Function of the target, [address, address + size) at runtime.
+	struct CodeSymbol
+	{
+		std::uint64_t address = 0;
+		std::uint64_t size = 0;
+		std::string name; // as in the symbol table (mangled)
+	};
+
+	// Rows of the DWARF line programs, sorted by runtime address. A row covers the addresses
+	// up to the next one; a row of line 0 ends a sequence (no line information after it).
+	struct LineTable
+	{
+		struct Row
+		{
+			std::uint64_t address = 0;
+			std::uint32_t line = 0;
+			std::uint32_t file = 0; // index in files
+		};
+
+		std::vector<std::string> files;
+		std::vector<Row> rows;
 	};
 
 	class SymbolError final : public std::runtime_error
@@ -60,5 +101,105 @@ namespace gwatch
 		static std::string last_error_as_string();
 	};
 
+#endif
+#ifdef __linux__
+
+	// ELF implementation. The image is memory-mapped once and every section is accessed
+	// zero-copy through string_views. Names are looked up through .gnu.hash (.dynsym) first,
+	// then .symtab (linear scan on first use, hash index built lazily on the next one).
+	// The size comes from st_size; DWARF .debug_info is only consulted when the symbol table
+	// does not carry it, and then only the compile unit that .debug_names, .debug_pubnames or
+	// .debug_aranges names is decoded (every unit, once, when none of them does).
+	// By default only 4-8 byte variables are accepted; with anySize, objects of any size are
+	// and the DWARF type also gives the element size of arrays (ResolvedSymbol::element).
+	// anySize also resolves allocated section names (".data", ".bss") as whole regions.
+	// functions() and line_table() describe code instead, for the hot-site report (HotSites.h).
+	class ElfSymbolResolver final : public ISymbolResolver
+	{
+	public:
+		// loadBase: runtime address of the lowest PT_LOAD segment (0 -> link-time addresses).
+		explicit ElfSymbolResolver(const std::string& imagePath, std::uint64_t loadBase = 0, bool anySize = false);
+
+		~ElfSymbolResolver() override;
+
+		ElfSymbolResolver(const ElfSymbolResolver&) = delete;
+		ElfSymbolResolver& operator=(const ElfSymbolResolver&) = delete;
+		ElfSymbolResolver(ElfSymbolResolver&&) = delete;
+		ElfSymbolResolver& operator=(ElfSymbolResolver&&) = delete;
+
+		ResolvedSymbol resolve(std::string_view symbol) override;
+
+		// Sized data objects of the symbol table overlapping [address, address + size) (runtime
+		// addresses), sorted by address, one per address. Of aliases, the global one is named
+		// (then weak, then local; ties broken by name). The element size is not looked up.
+		std::vector<ResolvedSymbol> objects_in(std::uint64_t address, std::uint64_t size) const;
+
+		// Sized functions of the symbol table (.symtab, else .dynsym), sorted by address, one per
+		// address, aliases picked as in objects_in().
+		std::vector<CodeSymbol> functions() const;
+		// Every line program of .debug_line (DWARF 2-5), empty without line information.
+		LineTable line_table() const;
+
+	private:
+		struct DwarfIndex;
+
+		struct AllocSection
+		{
+			std::string_view name;
+			std::uint64_t address = 0;
+			std::uint64_t size = 0;
+		};
+
+		struct SymbolEntry
+		{
+			std::uint64_t value = 0;
+			std::uint64_t size = 0;
+			std::string_view name;
+		};
+
+		struct SymbolTable
+		{
+			std::string_view symbols; // raw Elf64_Sym array
+			std::string_view strings;
+		};
+
+		std::string m_imagePath;
+		std::string m_imageStem;
+		void* m_map = nullptr;
+		std::size_t m_mapSize = 0;
+		std::string_view m_image;
+		std::uint64_t m_loadBase = 0;
+		std::uint64_t m_loadBias = 0;
+		bool m_anySize = false;
+
+		std::vector<AllocSection> m_sections;
+		SymbolTable m_dynsym;
+		SymbolTable m_symtab;
+		std::string_view m_gnuHash;
+		std::string_view m_debugInfo;
+		std::string_view m_debugAbbrev;
+		std::string_view m_debugNames;
+		std::string_view m_debugPubnames;
+		std::string_view m_debugGnuPubnames;
+		std::string_view m_debugAranges;
+		std::string_view m_debugLine;
+		std::string_view m_debugLineStr;
+		std::string_view m_debugStr;
+
+		std::unordered_map<std::string_view, std::uint32_t> m_symtabIndex;
+		std::uint32_t m_symtabScans = 0;
+		std::unique_ptr<DwarfIndex> m_dwarf; // built on the first DWARF lookup
+
+		void map_sections();
+		std::optional<SymbolEntry> find_gnu_hash(std::string_view name) const;
+		std::optional<SymbolEntry> find_symtab(std::string_view name);
+		DwarfIndex* dwarf();
+		std::optional<std::uint64_t> dwarf_type_size(std::uint64_t linkAddress, std::span<const std::string_view> names);
+		std::uint64_t dwarf_element_size(std::uint64_t linkAddress, std::span<const std::string_view> names);
+
+		static SymbolEntry entry_at(const SymbolTable& table, std::uint32_t index);
+		static std::string mangle_qualified(std::string_view name);
+	};
+
 #endif
 }
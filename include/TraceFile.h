@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Logger.h"
+
+namespace gwatch
+{
+#ifdef __linux__
+
+	// Storage of a --trace-file: appends go to the current segment file, rotate() starts the
+	// next one. Not thread-safe.
+	class ITraceStorage
+	{
+	public:
+		virtual ~ITraceStorage() = default;
+
+		// Whether size more bytes fit in the current segment before it is due for rotation.
+		virtual bool has_room(std::size_t size) const = 0;
+		// Appends to the current segment; call has_room() first (records are never split).
+		virtual void append(const char* data, std::size_t size) = 0;
+		// Completes the current segment, starts the next one and removes the segments beyond
+		// the retention cap.
+		virtual void rotate() = 0;
+		// Segments started so far; the current one is segments() - 1.
+		virtual std::uint64_t segments() const = 0;
+	};
+
+	std::string trace_segment_path(const std::string& path, std::uint64_t index);
+	// Removes the segment that falls out of the retention cap once segment `started` exists.
+	void remove_expired_segment(const TraceFileOptions& options, std::uint64_t started);
+
+	// Creates the storage of options.backend.
+	std::unique_ptr<ITraceStorage> open_trace_storage(const TraceFileOptions& options);
+
+	// Output of --trace-file: a series of segment files `<path>.<n>` (n from 0), each
+	// preallocated to its full size with fallocate and mapped shared. Appending is a memcpy
+	// into the mapping, with no system call until the segment is full or due for rotation.
+	// A completed segment is dropped from memory (MADV_DONTNEED), truncated to its data and
+	// closed. Since the mapped pages belong to the file, every appended byte is in the file
+	// even if gwatch crashes; the segment being written is then left zero-padded up to its size.
+	class TraceFile final : public ITraceStorage
+	{
+	public:
+		// Creates the first segment; throws std::runtime_error when it cannot.
+		explicit TraceFile(TraceFileOptions options);
+		~TraceFile() override;
+
+		TraceFile(const TraceFile&) = delete;
+		TraceFile& operator=(const TraceFile&) = delete;
+
+		bool has_room(std::size_t size) const override;
+		void append(const char* data, std::size_t size) override;
+		void rotate() override;
+		std::uint64_t segments() const override { return m_index + 1; }
+
+		std::string segment_path(std::uint64_t index) const { return trace_segment_path(m_options.path, index); }
+
+	private:
+		TraceFileOptions m_options;
+		std::uint64_t m_index = 0;
+		int m_fd = -1;
+		char* m_base = nullptr;
+		std::size_t m_used = 0;
+		std::uint64_t m_deadlineNs = 0; // steady clock time of the next time-based rotation, 0 = none
+
+		void open_segment();
+		void close_segment();
+	};
+
+#endif
+}
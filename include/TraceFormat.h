@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Logger.h"
+
+namespace gwatch::trace
+{
+	// Binary trace layout (all integers are LEB128 varints unless noted):
+	//
+	//   header   "GWTR" u8:version  count  { size  name_len  name }*count
+	//   symbol   0x01  id  size  name_len  name          (symbol registered after the header)
+	//   thread   0x02  tid                               (next thread dictionary index)
+	//   event    0x80|flags  zigzag(dt)  [symbol]  [thread_index]  values  [repeat-1]
+	//   padding  0x00                                    (ends the stream)
+	//
+	// Event flags: bit0 write, bit1 symbol id follows, bit2 thread index follows,
+	// bit3 the (old) value equals the previous value of that symbol and is omitted,
+	// bit4 the event stands for a coalesced run and its count follows, bit5 the values are
+	// unknown (Logger::log_access): none follow and the previous value of the symbol is kept.
+	// Values are XOR-deltas: a read stores value ^ previous, a write stores old ^ previous
+	// then new ^ old. dt is relative to the previous event of the stream.
+	// Padding is the zero fill of a trace file segment left behind by a crash (TraceFile.h).
+	inline constexpr char kMagic[4] = {'G', 'W', 'T', 'R'};
+	inline constexpr std::uint8_t kVersion = 1;
+
+	class TraceError final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	struct SymbolView
+	{
+		std::string_view name;
+		std::uint32_t size = 0;
+	};
+
+	struct SymbolDef
+	{
+		std::string name;
+		std::uint32_t size = 0;
+	};
+
+	struct Event
+	{
+		std::uint64_t timestamp_ns = 0;
+		std::uint32_t tid = 0;
+		std::uint32_t symbol = 0;
+		AccessKind kind = AccessKind::Read;
+		std::uint64_t old_value = 0;
+		std::uint64_t new_value = 0;
+		std::uint32_t repeat = 1;
+		bool exact = true; // false: old_value and new_value are unknown (0)
+	};
+
+	class Encoder
+	{
+	public:
+		// Appends the encoding of record to out, preceded by the header on the first call and by
+		// definitions for symbols/threads the stream has not described yet.
+		// symbols must cover record.symbol.
+		void encode(const LogRecord& record, std::span<const SymbolView> symbols, std::vector<char>& out);
+		void reset();
+
+	private:
+		bool m_headerWritten = false;
+		std::size_t m_symbolsWritten = 0;
+		std::uint64_t m_lastTime = 0;
+		std::uint32_t m_lastSymbol = ~0u;
+		std::uint32_t m_lastThread = ~0u;
+		std::unordered_map<std::uint32_t, std::uint32_t> m_threadIndex;
+		std::vector<std::uint64_t> m_lastValues;
+	};
+
+	class Decoder
+	{
+	public:
+		explicit Decoder(std::istream& in);
+
+		// Returns false at the end of the stream; throws TraceError on malformed input.
+		bool next(Event& ev);
+		const std::vector<SymbolDef>& symbols() const { return m_symbols; }
+
+	private:
+		std::istream& m_in;
+		bool m_headerRead = false;
+		std::vector<SymbolDef> m_symbols;
+		std::vector<std::uint32_t> m_threads;
+		std::vector<std::uint64_t> m_lastValues;
+		std::uint64_t m_lastTime = 0;
+		std::uint32_t m_lastSymbol = ~0u;
+		std::uint32_t m_lastThread = ~0u;
+
+		void read_header();
+		void read_symbol(std::uint32_t id);
+		void read_repeat(std::uint8_t tag, Event& ev);
+		std::uint64_t read_varint();
+		std::uint8_t read_byte();
+	};
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ColumnarTrace.h"
+
+namespace gwatch::query
+{
+	// Sidecar index of a columnar trace file (gwatch-query), stored next to it as
+	// <trace>.gwqi. Rows are numbered from 0 across the groups of the trace. Little-endian,
+	// every section 8-byte aligned, read in place from a mapped file:
+	//
+	//   header    "GWQI" u32:version u64:trace_bytes u64:rows u32:groups u32:blocks
+	//             u32:threads u32:keys u32:slots u32:block_rows u64:postings, zero-padded to 64
+	//   blocks    Block*blocks          sparse time index: timestamp range of up to
+	//                                   block_rows rows, never across groups
+	//   threads   ThreadEntry*threads   by tid, each a run of postings: the rows of the thread
+	//   keys      WriteKey*keys         (var, new value) of writes, each a run of postings
+	//   slots     u32*slots             open-addressing hash of the keys (key_hash), linear
+	//                                   probing, UINT32_MAX = empty; padded to 8 bytes
+	//   postings  u32*postings          row numbers, ascending within a run
+	//
+	// trace_bytes, rows and groups identify the trace the index was built from.
+	inline constexpr char kMagic[4] = {'G', 'W', 'Q', 'I'};
+	inline constexpr std::uint32_t kVersion = 1;
+	inline constexpr std::uint32_t kBlockRows = 4096;
+
+	class IndexError final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	struct Block
+	{
+		std::uint32_t group = 0;
+		std::uint32_t row = 0;  // first row, within the group
+		std::uint32_t rows = 0;
+		std::uint32_t reserved = 0;
+		std::uint64_t minNs = 0;
+		std::uint64_t maxNs = 0;
+	};
+
+	struct ThreadEntry
+	{
+		std::uint32_t tid = 0;
+		std::uint32_t count = 0;
+		std::uint64_t begin = 0; // into the postings
+	};
+
+	struct WriteKey
+	{
+		std::uint32_t var = 0;
+		std::uint32_t count = 0;
+		std::uint64_t value = 0;
+		std::uint64_t begin = 0; // into the postings
+	};
+
+	std::uint64_t key_hash(std::uint32_t var, std::uint64_t value);
+
+	// <trace>.gwqi
+	std::string index_path(const std::string& trace);
+
+	// The serialized index of trace, whose file is traceBytes long. Throws IndexError when the
+	// trace has more rows than 32-bit row numbers can hold.
+	std::vector<char> build_index(const columnar::Reader& trace, std::uint64_t traceBytes);
+
+	// An index read in place; data must stay valid while it is used and be 8-byte aligned.
+	class TraceIndex
+	{
+	public:
+		// Throws IndexError on a bad header or sections that do not fit in data.
+		explicit TraceIndex(std::span<const char> data);
+
+		// True when the index was built from trace, a file traceBytes long.
+		bool covers(const columnar::Reader& trace, std::uint64_t traceBytes) const;
+
+		std::uint64_t rows() const { return m_rows; }
+		std::span<const Block> blocks() const { return m_blocks; }
+		std::span<const ThreadEntry> threads() const { return m_threads; }
+		// Rows of thread tid, ascending; empty when it made no access.
+		std::span<const std::uint32_t> thread_rows(std::uint32_t tid) const;
+		// Rows that wrote value into var, ascending.
+		std::span<const std::uint32_t> write_rows(std::uint32_t var, std::uint64_t value) const;
+
+	private:
+		std::uint64_t m_traceBytes = 0;
+		std::uint64_t m_rows = 0;
+		std::uint32_t m_groups = 0;
+		std::span<const Block> m_blocks;
+		std::span<const ThreadEntry> m_threads;
+		std::span<const WriteKey> m_keys;
+		std::span<const std::uint32_t> m_slots;
+		std::span<const std::uint32_t> m_postings;
+	};
+
+	// Builds the index of every trace whose index is missing, unreadable or built from
+	// another trace (all of them with force), on up to threads threads, one trace each.
+	// Returns how many were built. Throws on the first trace that cannot be read or indexed.
+	std::size_t ensure_indexes(std::span<const std::string> traces, unsigned threads, bool force = false);
+
+	// Called for each match; return false to stop.
+	using Visitor = std::function<bool(const columnar::RowGroup& group, std::uint32_t row)>;
+
+	// Calls visit for every row of trace that matches filter, in row order, and returns how
+	// many it was called for. Looks rows up in the posting lists (tid, or the value of a
+	// write) or scans the blocks of the time range, whichever covers fewer rows.
+	std::uint64_t run(const columnar::Reader& trace, const TraceIndex& index, const columnar::Filter& filter, const Visitor& visit);
+}
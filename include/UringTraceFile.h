@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TraceFile.h"
+
+namespace gwatch
+{
+#ifdef __linux__
+
+	// Output of --trace-file with --trace-io uring: the same segment files as TraceFile, written
+	// through an io_uring instead of a mapping. Appends fill fixed-size blocks (registered with
+	// the ring when the memlock limit allows it); a full block is submitted as one write and the
+	// next free block takes over, so the caller only blocks when all queueDepth writes are still
+	// in flight. A block is free again once its completion is reaped. With O_DIRECT the last
+	// block of a segment is written padded to 4 KiB and the file is truncated back to its data.
+	// Unlike TraceFile, bytes not yet written are lost if gwatch crashes.
+	class UringTraceFile final : public ITraceStorage
+	{
+	public:
+		// Sets up the ring and creates the first segment; throws std::runtime_error when it cannot.
+		explicit UringTraceFile(TraceFileOptions options);
+		// Writes what is buffered and waits for every write; failed writes are reported on stderr.
+		~UringTraceFile() override;
+
+		UringTraceFile(const UringTraceFile&) = delete;
+		UringTraceFile& operator=(const UringTraceFile&) = delete;
+
+		bool has_room(std::size_t size) const override;
+		void append(const char* data, std::size_t size) override;
+		void rotate() override;
+		std::uint64_t segments() const override { return m_index + 1; }
+
+		std::string segment_path(std::uint64_t index) const { return trace_segment_path(m_options.path, index); }
+		// Whether the blocks are registered buffers (IORING_OP_WRITE_FIXED).
+		bool registered_buffers() const;
+		// errno of the first write that failed or came back short, 0 if none.
+		int error() const { return m_error; }
+
+	private:
+		struct Ring;
+
+		struct Block
+		{
+			char* data = nullptr;
+			bool busy = false;           // submitted, completion not reaped yet
+			std::uint32_t length = 0;    // bytes submitted
+			std::uint32_t inFlight = 0;  // writes in flight once it was submitted
+			std::uint64_t submittedNs = 0;
+		};
+
+		TraceFileOptions m_options;
+		std::unique_ptr<Ring> m_ring;
+		std::vector<Block> m_blocks;
+		std::size_t m_current = 0;       // block being filled
+		char* m_fill = nullptr;          // next byte of the block being filled
+		char* m_fillEnd = nullptr;
+		std::uint32_t m_inFlight = 0;
+		std::uint64_t m_index = 0;
+		int m_fd = -1;
+		std::uint64_t m_used = 0;        // bytes appended to the segment
+		std::uint64_t m_offset = 0;      // file offset of the block being filled
+		std::uint64_t m_deadlineNs = 0;  // steady clock time of the next time-based rotation, 0 = none
+		std::uint64_t m_busySinceNs = 0; // start of the current stretch with writes in flight
+		std::uint64_t m_busyNs = 0;
+		int m_error = 0;
+
+		void open_segment();
+		void close_segment();
+		// Submits the block being filled, if it holds anything, and moves to the next free one.
+		void submit_current();
+		// Reaps the available completions; with wait, blocks until there is at least one.
+		void reap(bool wait);
+	};
+
+#endif
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "DebugRegisters.h"
+#include "SymbolResolver.h"
+
+namespace gwatch
+{
+	// Variables a plan can describe: slots refer to them through a 64-bit mask.
+	inline constexpr std::size_t kMaxPlannedVariables = 64;
+
+	// One hardware slot: an aligned window of 1, 2, 4 or 8 bytes and the variables it overlaps.
+	struct PlannedSlot
+	{
+		std::uint64_t address = 0;
+		std::uint32_t size = 0;
+		std::uint64_t variables = 0; // bit i = symbols[i]
+	};
+
+	struct WatchPlan
+	{
+		std::vector<PlannedSlot> slots;
+		std::vector<std::uint32_t> covered;   // indices into the planned symbols, in input order
+		std::vector<std::uint32_t> uncovered; // variables no slot was left for
+
+		// Variables of every slot whose bit is set in slotMask.
+		std::uint64_t variables_of(std::uint32_t slotMask) const;
+		std::uint64_t covered_mask() const;
+	};
+
+	// Which of a slot's variables (candidates, bit i = symbol_of(i)) an access was to. A lone
+	// candidate is; on a shared slot the accessed bytes [address, address + width) decide, so an
+	// access to bytes of the window no variable owns is to none. Without an address the access
+	// is to none as well: it is never reported for every variable of the slot.
+	template <class SymbolOf>
+	std::uint64_t attribute_access(const std::uint64_t candidates, const std::optional<std::uint64_t> address, const std::uint64_t width, SymbolOf&& symbol_of)
+	{
+		if (std::has_single_bit(candidates))
+			return candidates;
+		if (!address)
+			return 0;
+		std::uint64_t touched = 0;
+		for (std::uint64_t vars = candidates; vars != 0; vars &= vars - 1)
+		{
+			const auto v = static_cast<std::size_t>(std::countr_zero(vars));
+			const ResolvedSymbol& symbol = symbol_of(v);
+			if (*address < symbol.address + symbol.size && symbol.address < *address + std::max<std::uint64_t>(width, 1))
+				touched |= 1ull << v;
+		}
+		return touched;
+	}
+
+	// Plans how to cover symbols (in priority order) with at most slotBudget hardware slots.
+	// Variables sharing an aligned 8-byte word share a slot and a variable straddling two words
+	// takes one slot per word, so a variable needs one or two slots. Variables are admitted in
+	// order while their words fit in the budget; the rest is reported as uncovered. Slots left
+	// over then split shared words back into per-variable windows where they do not overlap, so
+	// sharing (and its ambiguous hits) only happens when the budget requires it.
+	// Throws std::invalid_argument for more than kMaxPlannedVariables symbols.
+	WatchPlan compile_watch_plan(std::span<const ResolvedSymbol> symbols, std::size_t slotBudget = dr::kSlotCount);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "WatchPlan.h"
+
+namespace gwatch
+{
+	// Time-multiplexes a watch list larger than the hardware slots: the list is cut into groups
+	// that each fit the budget (a WatchPlan per group, in terms of the full list's indices) and
+	// the watcher arms one group per quantum. While a variable is armed its accesses are exact;
+	// its totals are extrapolated from the fraction of the run it was armed for.
+	class WatchRotation
+	{
+	public:
+		struct Estimate
+		{
+			std::uint32_t variable = 0;
+			std::uint64_t observed = 0;   // accesses logged while armed
+			std::uint64_t armed_ns = 0;
+			double coverage = 0.0;        // armed_ns / run time
+			double estimated = 0.0;       // observed / coverage
+			double rate_per_second = 0.0; // observed / armed time
+		};
+
+		WatchRotation() = default;
+		explicit WatchRotation(std::span<const ResolvedSymbol> symbols, std::size_t slotBudget = dr::kSlotCount);
+
+		std::size_t group_count() const { return m_groups.size(); }
+		// Plan of the group currently armed. Its uncovered list holds every other variable.
+		const WatchPlan& current() const { return m_groups[m_current]; }
+		std::size_t current_group() const { return m_current; }
+		const WatchPlan& group(const std::size_t index) const { return m_groups[index]; }
+		// Largest number of slots any group uses.
+		std::size_t max_slots() const;
+
+		// Starts the accounting with the first group armed.
+		void start(std::uint64_t nowNs);
+		// Arms the next group at nowNs and returns its plan.
+		const WatchPlan& advance(std::uint64_t nowNs);
+		void record_hit(std::uint32_t variable) { ++m_observed[variable]; }
+		// Ends the accounting and feeds the coverage to the profiling report.
+		void stop(std::uint64_t nowNs);
+
+		std::vector<Estimate> estimates() const;
+
+	private:
+		std::vector<std::string> m_names;
+		std::vector<WatchPlan> m_groups;
+		std::size_t m_current = 0;
+
+		std::vector<std::uint64_t> m_observed;
+		std::vector<std::uint64_t> m_armedNs;
+		std::uint64_t m_startNs = 0;
+		std::uint64_t m_switchNs = 0;
+		std::uint64_t m_stopNs = 0;
+		bool m_running = false;
+
+		void close_quantum(std::uint64_t nowNs);
+	};
+}
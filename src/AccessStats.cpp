@@ -0,0 +1,247 @@
+#include "../include/AccessStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+
+#ifdef __linux__
+#include <semaphore.h>
+#include <signal.h>
+
+#include <cerrno>
+#include <thread>
+#endif
+
+namespace gwatch
+{
+	namespace
+	{
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// Sketch outputs are approximations of integers: no decimals when they land on one.
+		void put_value(std::ostream& os, const double value)
+		{
+			if (std::abs(value - std::round(value)) < 1e-6 || std::abs(value) >= 1e15)
+				os << std::fixed << std::setprecision(0) << value;
+			else
+				os << std::fixed << std::setprecision(1) << value;
+		}
+	}
+
+	struct AccessStats::Variable
+	{
+		struct Thread
+		{
+			std::uint32_t tid = 0;
+			std::uint64_t reads = 0;
+			std::uint64_t writes = 0;
+		};
+
+		std::string name;
+		std::uint64_t reads = 0;
+		std::uint64_t writes = 0;
+		std::vector<Thread> threads; // first kMaxThreads threads, in order of appearance
+		Thread others;               // the threads after them
+		std::size_t lastThread = 0;  // consecutive accesses mostly come from one thread
+		std::uint64_t lastNs = 0;
+		Log2Histogram intervals;
+		HyperLogLog distinct;
+		SpaceSaving frequent{32};
+		TDigest quantiles;
+	};
+
+	AccessStats::AccessStats() :
+		m_startNs(now_ns())
+	{
+	}
+
+	AccessStats::~AccessStats() = default;
+
+	AccessStats::Variable& AccessStats::variable(const std::uint32_t id, const std::string_view name)
+	{
+		const std::size_t index = std::min<std::size_t>(id, kMaxVariables);
+		if (index >= m_variables.size())
+			m_variables.resize(index + 1);
+		auto& slot = m_variables[index];
+		if (!slot)
+		{
+			slot = std::make_unique<Variable>();
+			slot->name = index == kMaxVariables ? "<other>" : std::string(name);
+		}
+		return *slot;
+	}
+
+	void AccessStats::record(const std::uint32_t id, const std::string_view name, const AccessKind kind, const std::optional<std::uint64_t> value, const std::uint32_t tid, const std::uint64_t timestamp_ns)
+	{
+		const std::lock_guard lock(m_mutex);
+		++m_accesses;
+		Variable& v = variable(id, name);
+		const bool write = kind == AccessKind::Write;
+		(write ? v.writes : v.reads) += 1;
+
+		Variable::Thread* thread = nullptr;
+		if (v.lastThread < v.threads.size() && v.threads[v.lastThread].tid == tid)
+			thread = &v.threads[v.lastThread];
+		else if (const auto it = std::ranges::find(v.threads, tid, &Variable::Thread::tid); it != v.threads.end())
+			thread = &*it;
+		else if (v.threads.size() < kMaxThreads)
+			thread = &v.threads.emplace_back(Variable::Thread{.tid = tid});
+		else
+			thread = &v.others;
+		if (thread != &v.others)
+			v.lastThread = static_cast<std::size_t>(thread - v.threads.data());
+		(write ? thread->writes : thread->reads) += 1;
+
+		// Engines that do not time their accesses are timed here; clocks never go back per variable.
+		const std::uint64_t now = timestamp_ns != 0 ? timestamp_ns : now_ns();
+		if (v.reads + v.writes > 1)
+			v.intervals.add(now > v.lastNs ? now - v.lastNs : 0);
+		v.lastNs = std::max(v.lastNs, now);
+
+		if (!value)
+			return;
+		v.distinct.add(*value);
+		v.frequent.add(*value);
+		v.quantiles.add(static_cast<double>(*value));
+	}
+
+	std::uint64_t AccessStats::accesses() const
+	{
+		const std::lock_guard lock(m_mutex);
+		return m_accesses;
+	}
+
+	std::string AccessStats::report() const
+	{
+		const std::lock_guard lock(m_mutex);
+		std::ostringstream oss;
+		std::size_t variables = 0;
+		for (const auto& v : m_variables)
+			variables += v != nullptr;
+		oss << "stats: elapsed=" << (now_ns() - m_startNs) / 1'000'000 << "ms accesses=" << m_accesses << " variables=" << variables << "\n";
+
+		for (const auto& v : m_variables)
+		{
+			if (!v)
+				continue;
+			const std::string prefix = "stats: " + v->name + " ";
+			oss << prefix << "reads=" << v->reads << " writes=" << v->writes << "\n";
+			for (const auto& t : v->threads)
+				oss << prefix << "tid=" << t.tid << " reads=" << t.reads << " writes=" << t.writes << "\n";
+			if (v->others.reads + v->others.writes > 0)
+				oss << prefix << "tid=other reads=" << v->others.reads << " writes=" << v->others.writes << "\n";
+
+			if (v->intervals.count() > 0)
+			{
+				oss << prefix << "intervals";
+				for (std::size_t b = 0; b < Log2Histogram::kBuckets; ++b)
+				{
+					if (v->intervals.bucket(b) > 0)
+						oss << " >=" << Log2Histogram::lower_bound(b) << "ns:" << v->intervals.bucket(b);
+				}
+				oss << "\n";
+			}
+
+			oss << prefix << "distinct~";
+			put_value(oss, std::round(v->distinct.estimate()));
+			oss << "\n";
+
+			oss << prefix << "top";
+			for (const auto& c : v->frequent.top(kTopValues))
+				oss << " " << c.value << "=" << (c.error > 0 ? "~" : "") << c.count;
+			oss << "\n";
+
+			oss << prefix << "quantiles";
+			for (const auto& [label, q] : {std::pair{"p0", 0.0}, {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p100", 1.0}})
+			{
+				oss << " " << label << "=";
+				put_value(oss, v->quantiles.quantile(q));
+			}
+			oss << "\n";
+		}
+		return oss.str();
+	}
+
+	void AccessStats::dump(std::FILE* out) const
+	{
+		const std::string text = report();
+		std::fwrite(text.data(), 1, text.size(), out);
+		std::fflush(out);
+	}
+
+#ifdef __linux__
+
+	namespace
+	{
+		std::atomic<sem_t*> g_dumpRequests{nullptr};
+
+		void on_dump_signal(int)
+		{
+			// sem_post is async-signal-safe; formatting is not.
+			if (sem_t* requests = g_dumpRequests.load())
+				sem_post(requests);
+		}
+	}
+
+	struct StatsSignalDumper::State
+	{
+		sem_t requests{};
+		std::atomic<bool> stopRequested{false};
+		std::atomic<std::uint64_t> dumps{0};
+		struct sigaction previous{};
+		std::thread thread;
+	};
+
+	StatsSignalDumper::StatsSignalDumper(const AccessStats& stats) :
+		m_state(std::make_unique<State>())
+	{
+		sem_init(&m_state->requests, 0, 0);
+		g_dumpRequests.store(&m_state->requests);
+
+		struct sigaction action{};
+		action.sa_handler = on_dump_signal;
+		sigemptyset(&action.sa_mask);
+		// Interrupted waitpid / reads of the other threads resume on their own.
+		action.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &action, &m_state->previous);
+
+		m_state->thread = std::thread([state = m_state.get(), &stats]
+		{
+			while (true)
+			{
+				while (sem_wait(&state->requests) != 0 && errno == EINTR)
+				{
+				}
+				if (state->stopRequested.load())
+					break;
+				stats.dump(stdout);
+				state->dumps.fetch_add(1);
+			}
+		});
+	}
+
+	std::uint64_t StatsSignalDumper::dumps() const
+	{
+		return m_state->dumps.load();
+	}
+
+	StatsSignalDumper::~StatsSignalDumper()
+	{
+		sigaction(SIGUSR1, &m_state->previous, nullptr);
+		g_dumpRequests.store(nullptr);
+		m_state->stopRequested.store(true);
+		sem_post(&m_state->requests);
+		if (m_state->thread.joinable())
+			m_state->thread.join();
+		sem_destroy(&m_state->requests);
+	}
+
+#endif
+}
@@ -1,9 +1,13 @@
 #include "../include/Application.h"
 
+#include <algorithm>
 #include <string>
 #include <stdexcept>
 #include <variant>
 #include <sstream>
+#include <iomanip>
+#include <type_traits>
+#include <bit>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -14,6 +18,8 @@
 #endif
 #include <iostream>
 
+#include "../include/AccessStats.h"
+#include "../include/Logger.h"
 #include "../include/WinUtil.h"
 
 
@@ -42,6 +48,16 @@ namespace
 
 namespace gwatch
 {
+#ifdef _WIN32
+	using PlatformLauncher = WindowsProcessLauncher;
+	using PlatformWatcher = WindowsMemoryWatcher;
+#elif defined(__linux__)
+	using PlatformLauncher = LinuxProcessLauncher;
+	using PlatformWatcher = LinuxMemoryWatcher;
+#endif
+
+	// Bound to the concrete (final) watcher type so that forwarding an event is a direct call.
+	template <typename Watcher>
 	class Application::DebugLoopSink final : public IDebugEventSink
 	{
 	public:
@@ -49,27 +65,33 @@ namespace gwatch
 
 		ContinueStatus on_event(const DebugEvent& ev) override
 		{
-#ifdef _WIN32
-			if (!m_app.m_memoryWatcher)
+			if (!m_watcher)
 			{
-				if (ev.type == DebugEventType::_CreateProcess)
-				{
-					const auto& cp = std::get<CreateProcessInfo>(ev.payload);
-					m_app.resolve_symbol(cp);
-					m_app.setup_memory_watcher();
-					return m_app.m_memoryWatcher->on_event(ev);
-				}
-				return ContinueStatus::Default;
+				if (ev.type != DebugEventType::_CreateProcess)
+					return ContinueStatus::Default;
+
+				const auto& cp = std::get<CreateProcessInfo>(ev.payload);
+				m_app.resolve_symbols(cp);
+				m_app.setup_memory_watcher();
+				m_watcher = static_cast<Watcher*>(m_app.m_memoryWatcher.get());
 			}
-			return m_app.m_memoryWatcher->on_event(ev);
-#else
-			(void)ev;
-			return ContinueStatus::Default;
-#endif
+			if (ev.type == DebugEventType::ExitProcess)
+			{
+				// Last chance to see the shared libraries the hot sites may be in.
+				m_app.capture_code_modules();
+			}
+			const ContinueStatus status = m_watcher->on_event(ev);
+			if (ev.type == DebugEventType::ExitProcess)
+			{
+				// Everything the target produced must be out before we report its exit code.
+				Logger::flush();
+			}
+			return status;
 		}
 
 	private:
 		Application& m_app;
+		Watcher* m_watcher = nullptr;
 	};
 
 	Application::Application(const CliArgs& args) :
@@ -90,12 +112,180 @@ namespace gwatch
 
 	int Application::execute()
 	{
+		// Drains the asynchronous logger on every exit path, including the error ones below.
+		struct AsyncLogScope
+		{
+			explicit AsyncLogScope(const CliArgs& args) :
+				report(args.overflow.has_value())
+			{
+				if (!args.asyncLog)
+					return;
+				AsyncOptions options{.overflow = args.overflow.value_or(OverflowPolicy::Block), .spillPath = args.spillPath};
+				if (args.queueSize)
+					options.capacity = *args.queueSize;
+				Logger::start_async(options);
+			}
+			~AsyncLogScope()
+			{
+				Logger::stop_async();
+				if (!report)
+					return;
+				const QueueStats queue = Logger::queue_stats();
+				std::cerr << "queue: capacity=" << queue.capacity << " peak=" << queue.peak << " dropped=" << queue.dropped << " spilled=" << queue.spilledBytes << "B\n";
+			}
+
+			bool report;
+		};
+
+		// Completes the last trace file segment once the asynchronous logger has drained.
+		struct TraceFileScope
+		{
+			explicit TraceFileScope(const CliArgs& args)
+			{
+				if (args.traceFile.empty())
+					return;
+				TraceFileOptions options{.path = args.traceFile, .rotateNs = std::uint64_t{args.traceRotateUs} * 1'000, .keep = args.traceKeep};
+				if (args.traceSegmentBytes)
+					options.segmentBytes = *args.traceSegmentBytes;
+				options.backend = args.traceIo;
+				if (args.traceBlockBytes)
+					options.blockBytes = static_cast<std::size_t>(*args.traceBlockBytes);
+				if (args.traceDepth)
+					options.queueDepth = *args.traceDepth;
+				options.direct = args.traceDirect;
+				Logger::open_trace_file(options);
+			}
+			~TraceFileScope() { Logger::close_trace_file(); }
+		};
+
+		// Writes the last compressed blocks and the index once the asynchronous logger has drained.
+		struct CompressionScope
+		{
+			explicit CompressionScope(const CliArgs& args)
+			{
+				if (!args.compress)
+					return;
+				CompressionOptions options{.codec = *args.compress};
+				if (args.compressBlockBytes)
+					options.blockBytes = static_cast<std::size_t>(*args.compressBlockBytes);
+				Logger::start_compression(options);
+			}
+			~CompressionScope() { Logger::stop_compression(); }
+		};
+
+		// Writes the last columnar row group once the asynchronous logger has drained, ahead of
+		// the compression and trace file scopes.
+		struct StreamScope
+		{
+			~StreamScope() { Logger::end_stream(); }
+		};
+
+		// Prints the runs still held back before the asynchronous logger drains.
+		struct CoalescingScope
+		{
+			CoalescingScope(const Coalescing coalescing, const std::optional<std::uint32_t> windowUs)
+			{
+				if (coalescing == Coalescing::Off)
+					return;
+				if (windowUs)
+					Logger::set_coalescing(coalescing, std::uint64_t{*windowUs} * 1'000);
+				else
+					Logger::set_coalescing(coalescing);
+			}
+			~CoalescingScope() { Logger::set_coalescing(Coalescing::Off); }
+		};
+
+		// Reports what the policies dropped once the target is gone.
+		struct PolicyScope
+		{
+			explicit PolicyScope(const std::vector<std::pair<std::string, LogPolicy>>& policies) :
+				enabled(!policies.empty())
+			{
+				for (const auto& [symbol, policy] : policies)
+					Logger::set_policy(symbol, policy);
+			}
+			~PolicyScope()
+			{
+				if (!enabled)
+					return;
+				Logger::report_drops();
+				Logger::clear_policies();
+			}
+
+			bool enabled;
+		};
+
+		// Attaches the stats for the whole run; the final dump follows the target's exit.
+		struct StatsScope
+		{
+			explicit StatsScope(const bool enabled)
+			{
+				if (!enabled)
+					return;
+				stats = std::make_unique<AccessStats>();
+				Logger::set_stats(stats.get());
+#ifdef __linux__
+				dumper = std::make_unique<StatsSignalDumper>(*stats);
+#endif
+			}
+			~StatsScope()
+			{
+				if (!stats)
+					return;
+#ifdef __linux__
+				dumper.reset();
+#endif
+				Logger::set_stats(nullptr);
+				stats->dump(stdout);
+			}
+
+			std::unique_ptr<AccessStats> stats;
+#ifdef __linux__
+			std::unique_ptr<StatsSignalDumper> dumper;
+#endif
+		};
+
+		Logger::set_format(m_args.format);
+		if (m_args.rowGroupRows)
+			Logger::set_row_group(*m_args.rowGroupRows);
+
 		try
 		{
+			// Inside the try: opening the trace or spill file may fail.
+			TraceFileScope traceFile(m_args);
+			CompressionScope compression(m_args);
+			StreamScope stream;
+			AsyncLogScope asyncLog(m_args);
+			CoalescingScope coalescing(m_args.coalesce, m_args.coalesceWindowUs);
+			PolicyScope policies(m_args.policies);
+			StatsScope stats(m_args.mode == OutputMode::Stats);
+
 			start_process();
-			DebugLoopSink sink(*this);
-			const std::optional<std::uint32_t> exitCode = m_processLauncher->run_debug_loop(sink);
-			return exitCode.value_or(0);
+#ifdef __linux__
+			if (m_args.engine == WatchEngine::Pages)
+			{
+				return run_with<LinuxPageMemoryWatcher>().value_or(0);
+			}
+			if (m_args.engine == WatchEngine::Dirty)
+			{
+				return run_with<LinuxDirtyPageWatcher>().value_or(0);
+			}
+			if (m_args.engine == WatchEngine::Poll)
+			{
+				return run_with<LinuxPollMemoryWatcher>().value_or(0);
+			}
+			if (m_args.engine == WatchEngine::Hybrid)
+			{
+				return run_with<LinuxHybridMemoryWatcher>().value_or(0);
+			}
+			if (m_args.engine == WatchEngine::Perf)
+			{
+				return run_with<LinuxPerfMemoryWatcher>().value_or(0);
+			}
+#endif
+#if defined(_WIN32) || defined(__linux__)
+			return run_with<PlatformWatcher>().value_or(0);
+#endif
 		}
 		catch (const SymbolError& e)
 		{
@@ -119,14 +309,155 @@ namespace gwatch
 		}
 	}
 
+	template <typename Watcher>
+	std::optional<std::uint32_t> Application::run_with()
+	{
+#if defined(_WIN32) || defined(__linux__)
+		DebugLoopSink<Watcher> sink(*this);
+		const std::optional<std::uint32_t> exitCode = drive_debug_loop(static_cast<PlatformLauncher&>(*m_processLauncher), sink);
+		if constexpr (requires(const Watcher& w) { w.rotation(); })
+		{
+			if (const auto* watcher = static_cast<const Watcher*>(m_memoryWatcher.get()); watcher && watcher->rotating())
+			{
+				report_rotation(watcher->rotation());
+			}
+		}
+		if constexpr (requires(const Watcher& w) { w.unattributed(); })
+		{
+			if (const auto* watcher = static_cast<const Watcher*>(m_memoryWatcher.get()); watcher && watcher->unattributed() > 0)
+			{
+				std::cerr << "Warning: " << watcher->unattributed() << " accesses to a shared breakpoint slot were not logged: their address could not be rebuilt.\n";
+			}
+		}
+		if constexpr (requires(const Watcher& w) { w.hot_sites(); })
+		{
+			if (const auto* watcher = static_cast<const Watcher*>(m_memoryWatcher.get()); watcher && watcher->hot_sites())
+			{
+				report_hot_sites(*watcher->hot_sites());
+			}
+		}
+#ifdef __linux__
+		if constexpr (std::is_same_v<Watcher, LinuxPollMemoryWatcher>)
+		{
+			if (const auto* watcher = static_cast<const Watcher*>(m_memoryWatcher.get()))
+			{
+				report_polling(*watcher);
+			}
+		}
+#endif
+		return exitCode;
+#else
+		return std::nullopt;
+#endif
+	}
+
+	void Application::report_rotation(const WatchRotation& rotation) const
+	{
+		// Exact counts only cover the quanta a variable was armed for; the totals are scaled up.
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(1);
+		for (const auto& e : rotation.estimates())
+		{
+			oss << "rotation: " << m_symbols[e.variable].name
+				<< " observed=" << e.observed
+				<< " coverage=" << e.coverage * 100.0 << "%"
+				<< " estimated=" << e.estimated
+				<< " rate=" << e.rate_per_second << "/s\n";
+		}
+		std::cerr << oss.str();
+	}
+
+	void Application::capture_code_modules()
+	{
+#ifdef __linux__
+		if (m_args.hotSites > 0 && m_processLauncher)
+		{
+			m_codeModules = read_code_modules(m_processLauncher->pid());
+		}
+#endif
+	}
+
+	void Application::report_hot_sites(const HotSiteTable& table) const
+	{
+		// Only the reported sites are symbolized, each once, and only the images they are in are read.
+		const std::vector<HotSite> sites = table.top(m_args.hotSites);
+		SiteSymbolizer symbolizer;
+#ifdef __linux__
+		for (const auto& module : m_codeModules.empty() ? std::vector{m_mainImage} : m_codeModules)
+		{
+			if (std::ranges::none_of(sites, [&](const HotSite& site) { return site.ip >= module.begin && site.ip < module.end; }))
+				continue;
+			try
+			{
+				const ElfSymbolResolver resolver(module.path, module.begin);
+				symbolizer.add_module(module.path, module.begin, module.end, resolver.functions(), resolver.line_table());
+			}
+			catch (const SymbolError&)
+			{
+				// Unreadable image: its sites are reported as addresses.
+			}
+		}
+#endif
+
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(1);
+		oss << "hot: sites=" << table.size() << " hits=" << table.total();
+		if (table.overflow() > 0)
+			oss << " untracked=" << table.overflow();
+		if (table.undecoded() > 0)
+			oss << " undecoded=" << table.undecoded();
+		oss << "\n";
+		for (const auto& site : sites)
+		{
+			oss << "hot: " << site.count
+				<< " " << 100.0 * static_cast<double>(site.count) / static_cast<double>(table.total()) << "%"
+				<< " " << (site.kind == AccessKind::Write ? "write" : "read")
+				<< " " << symbolizer.describe(site.ip);
+			const char* separator = " ";
+			for (std::uint64_t vars = site.variables; vars != 0; vars &= vars - 1)
+			{
+				oss << separator << m_symbols[static_cast<std::size_t>(std::countr_zero(vars))].name;
+				separator = ",";
+			}
+			oss << " tid=" << site.tid << (site.otherThreads ? "+" : "") << "\n";
+		}
+		std::cerr << oss.str();
+	}
+
+#ifdef __linux__
+	void Application::report_polling(const LinuxPollMemoryWatcher& watcher) const
+	{
+		// Polling sees values, not stores: the stores between two reads are only estimated.
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(1);
+		const auto& stats = watcher.poll_stats();
+		for (std::size_t i = 0; i < stats.size(); ++i)
+		{
+			oss << "poll: " << watcher.symbol(i).name
+				<< " changes=" << stats[i].changes
+				<< " missed>=" << stats[i].missed << "\n";
+		}
+		const double seconds = static_cast<double>(watcher.elapsed_ns()) / 1e9;
+		oss << "poll: ticks=" << watcher.ticks()
+			<< " overruns=" << watcher.overruns()
+			<< " rate=" << (seconds > 0 ? static_cast<double>(watcher.ticks()) / seconds : 0.0) << "/s\n";
+		std::cerr << oss.str();
+	}
+#endif
+
 	void Application::start_process()
 	{
 #ifdef _WIN32
 		m_processLauncher = std::make_unique<WindowsProcessLauncher>();
+#elif defined(__linux__)
+		m_processLauncher = std::make_unique<LinuxProcessLauncher>();
+#else
+		throw ProcessError("Unsupported platform: no process launcher available.");
 #endif
 		const LaunchConfig cfg{
 			.exe_path = m_args.execPath,
 			.args = m_args.targetArgs,
+			.workdir = std::nullopt,
 			.new_console = false,
 			.suspended = false,
 			.debug_children = false,
@@ -141,7 +472,7 @@ namespace gwatch
 		#endif
 	}
 
-	void Application::resolve_symbol(const CreateProcessInfo& cpInfo)
+	void Application::resolve_symbols(const CreateProcessInfo& cpInfo)
 	{
 		if (!m_processLauncher)
 			throw std::runtime_error("You must attach WindowsProcessLauncher before resolving!");
@@ -168,24 +499,62 @@ namespace gwatch
 		WindowsSymbolResolver::ModuleLoadHint hint;
 		hint.image_base = cpInfo.image_base;
 		hint.image_size = 0;
-		const std::string imagePath = !cpInfo.image_path.empty() ? cpInfo.image_path : m_args.execPath;
+		const std::string_view imagePathView = m_processLauncher->strings().view(cpInfo.image_path);
+		const std::string imagePath = !imagePathView.empty() ? std::string(imagePathView) : m_args.execPath;
 		hint.image_path = utf16_from_utf8(imagePath);
 
 		const std::unique_ptr<ISymbolResolver> resolver =
 			std::make_unique<WindowsSymbolResolver>(m_hProc, "", false, &hint);
+		for (const auto& name : m_args.symbols)
+		{
+			try
+			{
+				m_symbols.push_back(resolver->resolve(name));
+			}
+			catch (const SymbolError& inner)
+			{
+				std::ostringstream oss;
+				oss << "Failed to resolve symbol '" << name << "' in target '" << imagePath << "'.\n"
+					<< "Details: " << inner.what() << "\n"
+					<< "Hint: verify the global variable name, that symbols/PDB are available, and that it is a 4–8 byte integer.";
+				throw SymbolError(oss.str());
+			}
+		}
+#elif defined(__linux__)
+		const std::string_view imagePathView = m_processLauncher->strings().view(cpInfo.image_path);
+		const std::string imagePath = !imagePathView.empty() ? std::string(imagePathView) : m_args.execPath;
+		m_mainImage = CodeModule{.path = imagePath, .begin = cpInfo.image_base, .end = ~0ull};
+		std::string_view current = m_args.symbols.empty() ? std::string_view{} : m_args.symbols.front();
+		const bool regions = m_args.engine == WatchEngine::Pages || m_args.engine == WatchEngine::Dirty;
 		try
 		{
-			m_symbol = resolver->resolve(m_args.symbol);
+			ElfSymbolResolver resolver(imagePath, cpInfo.image_base, regions);
+			for (const auto& name : m_args.symbols)
+			{
+				current = name;
+				m_symbols.push_back(resolver.resolve(name));
+				if (m_args.engine == WatchEngine::Dirty)
+				{
+					auto inside = resolver.objects_in(m_symbols.back().address, m_symbols.back().size);
+					m_globals.insert(m_globals.end(), std::make_move_iterator(inside.begin()), std::make_move_iterator(inside.end()));
+				}
+			}
 		}
 		catch (const SymbolError& inner)
 		{
 			std::ostringstream oss;
-			oss << "Failed to resolve symbol '" << m_args.symbol << "' in target '" << imagePath << "'.\n"
+			oss << "Failed to resolve symbol '" << current << "' in target '" << imagePath << "'.\n"
 				<< "Details: " << inner.what() << "\n"
-				<< "Hint: verify the global variable name, that symbols/PDB are available, and that it is a 4–8 byte integer.";
+				<< "Hint: verify the global variable name, that the binary is not stripped"
+				<< (regions ? "." : ", and that it is a 4–8 byte integer (see --engine pages for larger objects).");
 			throw SymbolError(oss.str());
 		}
 #endif
+		// Lets the binary trace header describe the variables before their first access.
+		for (const auto& symbol : m_symbols)
+		{
+			Logger::register_symbol(symbol.name, static_cast<std::uint32_t>(symbol.size));
+		}
 #ifdef GWATCH_PROFILE
 		const auto resolve_end = std::chrono::high_resolution_clock::now();
 		profiling::add_symbol_resolve_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(resolve_end - resolve_start).count());
@@ -196,20 +565,100 @@ namespace gwatch
 	{
 		if (m_memoryWatcher)
 			return;
-		if (!m_hProc || !m_symbol.has_value())
+#ifdef _WIN32
+		const bool attached = m_hProc != nullptr;
+#else
+		const bool attached = m_processLauncher && m_processLauncher->running();
+#endif
+		if (!attached || m_symbols.empty())
 		{
 			throw std::runtime_error("You must attach the process and resolve the symbol before setting up the watcher!");
 		}
 
-#ifdef _WIN32
 		#ifdef GWATCH_PROFILE
 		const auto setup_start = std::chrono::high_resolution_clock::now();
 		#endif
-		m_memoryWatcher = std::make_unique<WindowsMemoryWatcher>(m_hProc, *m_symbol);
+#ifdef _WIN32
+		if (m_args.engine != WatchEngine::Breakpoints)
+		{
+			throw MemoryWatchError("--engine pages, dirty, poll, hybrid and perf are only available on Linux.");
+		}
+		auto watcher = std::make_unique<WindowsMemoryWatcher>(m_hProc, m_symbols, true, m_args.rotateMs, m_args.hotSites > 0);
+		if (const auto& uncovered = watcher->plan().uncovered; !uncovered.empty() && !watcher->rotating())
+		{
+			std::ostringstream oss;
+			oss << "Warning: not enough hardware breakpoint slots (see --rotate), not watching:";
+			for (const std::uint32_t v : uncovered)
+				oss << " " << m_symbols[v].name;
+			std::cerr << oss.str() << "\n";
+		}
+		m_memoryWatcher = std::move(watcher);
+#elif defined(__linux__)
+		if (m_args.engine == WatchEngine::Pages)
+		{
+			m_memoryWatcher = std::make_unique<LinuxPageMemoryWatcher>(m_processLauncher->pid(), m_symbols);
+		}
+		else if (m_args.engine == WatchEngine::Dirty)
+		{
+			DirtyWatchOptions options;
+			if (m_args.intervalUs)
+				options.interval_us = *m_args.intervalUs;
+			m_memoryWatcher = std::make_unique<LinuxDirtyPageWatcher>(m_processLauncher->pid(), m_symbols, m_globals, options);
+		}
+		else if (m_args.engine == WatchEngine::Poll)
+		{
+			PollWatchOptions options;
+			if (m_args.intervalUs)
+				options.interval_us = *m_args.intervalUs;
+			m_memoryWatcher = std::make_unique<LinuxPollMemoryWatcher>(m_processLauncher->pid(), m_symbols, options);
+		}
+		else if (m_args.engine == WatchEngine::Hybrid)
+		{
+			HybridWatchOptions options;
+			if (m_args.intervalUs)
+				options.summary_interval_ms = *m_args.intervalUs / 1'000;
+			options.hot_sites = m_args.hotSites > 0;
+			auto hybrid = std::make_unique<LinuxHybridMemoryWatcher>(m_processLauncher->pid(), m_symbols, options);
+			if (const auto& uncovered = hybrid->plan().uncovered; !uncovered.empty())
+			{
+				std::ostringstream oss;
+				oss << "Warning: --engine hybrid has " << LinuxHybridMemoryWatcher::kSlots << " slots, not watching:";
+				for (const std::uint32_t v : uncovered)
+					oss << " " << m_symbols[v].name;
+				std::cerr << oss.str() << "\n";
+			}
+			m_memoryWatcher = std::move(hybrid);
+		}
+		else if (m_args.engine == WatchEngine::Perf)
+		{
+			auto perf = std::make_unique<LinuxPerfMemoryWatcher>(m_processLauncher->pid(), m_symbols, PerfWatchOptions{.rotate_quantum_ms = m_args.rotateMs, .hot_sites = m_args.hotSites > 0});
+			if (const auto& uncovered = perf->plan().uncovered; !uncovered.empty() && !perf->rotating())
+			{
+				std::ostringstream oss;
+				oss << "Warning: not enough hardware breakpoint slots (see --rotate), not watching:";
+				for (const std::uint32_t v : uncovered)
+					oss << " " << m_symbols[v].name;
+				std::cerr << oss.str() << "\n";
+			}
+			m_memoryWatcher = std::move(perf);
+		}
+		else
+		{
+			auto watcher = std::make_unique<LinuxMemoryWatcher>(m_processLauncher->pid(), m_symbols, m_args.hotSites > 0);
+			if (const auto& uncovered = watcher->plan().uncovered; !uncovered.empty())
+			{
+				std::ostringstream oss;
+				oss << "Warning: not enough hardware breakpoint slots (see --engine perf --rotate), not watching:";
+				for (const std::uint32_t v : uncovered)
+					oss << " " << m_symbols[v].name;
+				std::cerr << oss.str() << "\n";
+			}
+			m_memoryWatcher = std::move(watcher);
+		}
+#endif
 		#ifdef GWATCH_PROFILE
 		const auto setup_end = std::chrono::high_resolution_clock::now();
 		profiling::add_setup_watcher_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(setup_end - setup_start).count());
 		#endif
-#endif
 	}
 }
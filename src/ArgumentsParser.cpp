@@ -1,5 +1,9 @@
 #include "../include/ArgumentsParser.h"
 
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <ranges>
 #include <sstream>
 
 namespace gwatch
@@ -17,15 +21,39 @@ namespace gwatch
 
 		bool seenVar = false;
 		bool seenExec = false;
+		bool seenAsyncLog = false;
+		bool seenFormat = false;
+		bool seenRotate = false;
+		bool seenEngine = false;
+		bool seenInterval = false;
+		bool seenHotSites = false;
+		bool seenMode = false;
+		bool seenCoalesce = false;
+		bool seenCoalesceWindow = false;
+		bool seenRateLimit = false;
+		bool seenSample = false;
+		bool seenOverflow = false;
+		bool seenQueueSize = false;
+		bool seenTraceFile = false;
+		bool seenTraceSegment = false;
+		bool seenTraceRotate = false;
+		bool seenTraceKeep = false;
+		bool seenTraceIo = false;
+		bool seenTraceBlock = false;
+		bool seenTraceDepth = false;
+		bool seenTraceDirect = false;
+		bool seenCompress = false;
+		bool seenCompressBlock = false;
+		bool seenRowGroup = false;
 
-		int i = 1;
+		std::size_t i = 1;
 		while (i < n)
 		{
 			std::string tok = args[i];
 
 			if (tok == "--")
 			{
-				for (int j = i + 1; j < n; j++)
+				for (std::size_t j = i + 1; j < n; j++)
 				{
 					out.targetArgs.emplace_back(args[j]);
 				}
@@ -41,11 +69,7 @@ namespace gwatch
 			if (tok.starts_with("--var="))
 			{
 				ensure_not_duplicate(seenVar, "--var");
-				out.symbol = tok.substr(6);
-				if (out.symbol.empty())
-				{
-					throw ParseError("Empty value for --var");
-				}
+				out.symbols = parse_symbols(std::string_view(tok).substr(6));
 				seenVar = true;
 				i++;
 				continue;
@@ -53,12 +77,7 @@ namespace gwatch
 			if (tok == "--var" || tok == "-v")
 			{
 				ensure_not_duplicate(seenVar, "--var");
-				std::string val = next_value(args, i, "--var");
-				if (val.empty())
-				{
-					throw ParseError("Empty value for --var");
-				}
-				out.symbol = std::move(val);
+				out.symbols = parse_symbols(next_value(args, i, "--var"));
 				seenVar = true;
 				i += 2;
 				continue;
@@ -90,6 +109,406 @@ namespace gwatch
 				continue;
 			}
 
+			if (tok.starts_with("--format="))
+			{
+				ensure_not_duplicate(seenFormat, "--format");
+				out.format = parse_format(std::string_view(tok).substr(9));
+				seenFormat = true;
+				i++;
+				continue;
+			}
+			if (tok == "--format")
+			{
+				ensure_not_duplicate(seenFormat, "--format");
+				out.format = parse_format(next_value(args, i, "--format"));
+				seenFormat = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--rotate="))
+			{
+				ensure_not_duplicate(seenRotate, "--rotate");
+				out.rotateMs = parse_quantum(std::string_view(tok).substr(9));
+				seenRotate = true;
+				i++;
+				continue;
+			}
+			if (tok == "--rotate")
+			{
+				ensure_not_duplicate(seenRotate, "--rotate");
+				out.rotateMs = parse_quantum(next_value(args, i, "--rotate"));
+				seenRotate = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--engine="))
+			{
+				ensure_not_duplicate(seenEngine, "--engine");
+				out.engine = parse_engine(std::string_view(tok).substr(9));
+				seenEngine = true;
+				i++;
+				continue;
+			}
+			if (tok == "--engine")
+			{
+				ensure_not_duplicate(seenEngine, "--engine");
+				out.engine = parse_engine(next_value(args, i, "--engine"));
+				seenEngine = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--interval="))
+			{
+				ensure_not_duplicate(seenInterval, "--interval");
+				out.intervalUs = parse_duration(std::string_view(tok).substr(11), "--interval");
+				seenInterval = true;
+				i++;
+				continue;
+			}
+			if (tok == "--interval")
+			{
+				ensure_not_duplicate(seenInterval, "--interval");
+				out.intervalUs = parse_duration(next_value(args, i, "--interval"), "--interval");
+				seenInterval = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--hot-sites="))
+			{
+				ensure_not_duplicate(seenHotSites, "--hot-sites");
+				out.hotSites = parse_hot_sites(std::string_view(tok).substr(12));
+				seenHotSites = true;
+				i++;
+				continue;
+			}
+			if (tok == "--hot-sites")
+			{
+				ensure_not_duplicate(seenHotSites, "--hot-sites");
+				out.hotSites = parse_hot_sites(next_value(args, i, "--hot-sites"));
+				seenHotSites = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--mode="))
+			{
+				ensure_not_duplicate(seenMode, "--mode");
+				out.mode = parse_mode(std::string_view(tok).substr(7));
+				seenMode = true;
+				i++;
+				continue;
+			}
+			if (tok == "--mode")
+			{
+				ensure_not_duplicate(seenMode, "--mode");
+				out.mode = parse_mode(next_value(args, i, "--mode"));
+				seenMode = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--coalesce="))
+			{
+				ensure_not_duplicate(seenCoalesce, "--coalesce");
+				out.coalesce = parse_coalesce(std::string_view(tok).substr(11));
+				seenCoalesce = true;
+				i++;
+				continue;
+			}
+			if (tok == "--coalesce")
+			{
+				ensure_not_duplicate(seenCoalesce, "--coalesce");
+				out.coalesce = parse_coalesce(next_value(args, i, "--coalesce"));
+				seenCoalesce = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--coalesce-window="))
+			{
+				ensure_not_duplicate(seenCoalesceWindow, "--coalesce-window");
+				out.coalesceWindowUs = parse_duration(std::string_view(tok).substr(18), "--coalesce-window");
+				seenCoalesceWindow = true;
+				i++;
+				continue;
+			}
+			if (tok == "--coalesce-window")
+			{
+				ensure_not_duplicate(seenCoalesceWindow, "--coalesce-window");
+				out.coalesceWindowUs = parse_duration(next_value(args, i, "--coalesce-window"), "--coalesce-window");
+				seenCoalesceWindow = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--rate-limit="))
+			{
+				ensure_not_duplicate(seenRateLimit, "--rate-limit");
+				parse_policies(std::string_view(tok).substr(13), "--rate-limit", &LogPolicy::ratePerSecond, out);
+				seenRateLimit = true;
+				i++;
+				continue;
+			}
+			if (tok == "--rate-limit")
+			{
+				ensure_not_duplicate(seenRateLimit, "--rate-limit");
+				parse_policies(next_value(args, i, "--rate-limit"), "--rate-limit", &LogPolicy::ratePerSecond, out);
+				seenRateLimit = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--sample="))
+			{
+				ensure_not_duplicate(seenSample, "--sample");
+				parse_policies(std::string_view(tok).substr(9), "--sample", &LogPolicy::sampleEvery, out);
+				seenSample = true;
+				i++;
+				continue;
+			}
+			if (tok == "--sample")
+			{
+				ensure_not_duplicate(seenSample, "--sample");
+				parse_policies(next_value(args, i, "--sample"), "--sample", &LogPolicy::sampleEvery, out);
+				seenSample = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--overflow="))
+			{
+				ensure_not_duplicate(seenOverflow, "--overflow");
+				parse_overflow(std::string_view(tok).substr(11), out);
+				seenOverflow = true;
+				i++;
+				continue;
+			}
+			if (tok == "--overflow")
+			{
+				ensure_not_duplicate(seenOverflow, "--overflow");
+				parse_overflow(next_value(args, i, "--overflow"), out);
+				seenOverflow = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--queue-size="))
+			{
+				ensure_not_duplicate(seenQueueSize, "--queue-size");
+				out.queueSize = parse_queue_size(std::string_view(tok).substr(13));
+				seenQueueSize = true;
+				i++;
+				continue;
+			}
+			if (tok == "--queue-size")
+			{
+				ensure_not_duplicate(seenQueueSize, "--queue-size");
+				out.queueSize = parse_queue_size(next_value(args, i, "--queue-size"));
+				seenQueueSize = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-file="))
+			{
+				ensure_not_duplicate(seenTraceFile, "--trace-file");
+				out.traceFile = tok.substr(13);
+				if (out.traceFile.empty())
+				{
+					throw ParseError("Empty value for --trace-file");
+				}
+				seenTraceFile = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-file")
+			{
+				ensure_not_duplicate(seenTraceFile, "--trace-file");
+				out.traceFile = next_value(args, i, "--trace-file");
+				if (out.traceFile.empty())
+				{
+					throw ParseError("Empty value for --trace-file");
+				}
+				seenTraceFile = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-segment="))
+			{
+				ensure_not_duplicate(seenTraceSegment, "--trace-segment");
+				out.traceSegmentBytes = parse_segment_size(std::string_view(tok).substr(16));
+				seenTraceSegment = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-segment")
+			{
+				ensure_not_duplicate(seenTraceSegment, "--trace-segment");
+				out.traceSegmentBytes = parse_segment_size(next_value(args, i, "--trace-segment"));
+				seenTraceSegment = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-rotate="))
+			{
+				ensure_not_duplicate(seenTraceRotate, "--trace-rotate");
+				out.traceRotateUs = parse_duration(std::string_view(tok).substr(15), "--trace-rotate");
+				seenTraceRotate = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-rotate")
+			{
+				ensure_not_duplicate(seenTraceRotate, "--trace-rotate");
+				out.traceRotateUs = parse_duration(next_value(args, i, "--trace-rotate"), "--trace-rotate");
+				seenTraceRotate = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-keep="))
+			{
+				ensure_not_duplicate(seenTraceKeep, "--trace-keep");
+				out.traceKeep = parse_trace_keep(std::string_view(tok).substr(13));
+				seenTraceKeep = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-keep")
+			{
+				ensure_not_duplicate(seenTraceKeep, "--trace-keep");
+				out.traceKeep = parse_trace_keep(next_value(args, i, "--trace-keep"));
+				seenTraceKeep = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-io="))
+			{
+				ensure_not_duplicate(seenTraceIo, "--trace-io");
+				out.traceIo = parse_trace_io(std::string_view(tok).substr(11));
+				seenTraceIo = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-io")
+			{
+				ensure_not_duplicate(seenTraceIo, "--trace-io");
+				out.traceIo = parse_trace_io(next_value(args, i, "--trace-io"));
+				seenTraceIo = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-block="))
+			{
+				ensure_not_duplicate(seenTraceBlock, "--trace-block");
+				out.traceBlockBytes = parse_size(std::string_view(tok).substr(14), "--trace-block", std::uint64_t{4} << 10, std::uint64_t{64} << 20, std::uint64_t{4} << 10, "a multiple of 4K from 4K to 64M such as 1M");
+				seenTraceBlock = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-block")
+			{
+				ensure_not_duplicate(seenTraceBlock, "--trace-block");
+				out.traceBlockBytes = parse_size(next_value(args, i, "--trace-block"), "--trace-block", std::uint64_t{4} << 10, std::uint64_t{64} << 20, std::uint64_t{4} << 10, "a multiple of 4K from 4K to 64M such as 1M");
+				seenTraceBlock = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--trace-depth="))
+			{
+				ensure_not_duplicate(seenTraceDepth, "--trace-depth");
+				out.traceDepth = parse_trace_depth(std::string_view(tok).substr(14));
+				seenTraceDepth = true;
+				i++;
+				continue;
+			}
+			if (tok == "--trace-depth")
+			{
+				ensure_not_duplicate(seenTraceDepth, "--trace-depth");
+				out.traceDepth = parse_trace_depth(next_value(args, i, "--trace-depth"));
+				seenTraceDepth = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok == "--trace-direct")
+			{
+				ensure_not_duplicate(seenTraceDirect, "--trace-direct");
+				out.traceDirect = true;
+				seenTraceDirect = true;
+				i++;
+				continue;
+			}
+
+			if (tok.starts_with("--compress="))
+			{
+				ensure_not_duplicate(seenCompress, "--compress");
+				out.compress = parse_compress(std::string_view(tok).substr(11));
+				seenCompress = true;
+				i++;
+				continue;
+			}
+			if (tok == "--compress")
+			{
+				ensure_not_duplicate(seenCompress, "--compress");
+				out.compress = parse_compress(next_value(args, i, "--compress"));
+				seenCompress = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--row-group="))
+			{
+				ensure_not_duplicate(seenRowGroup, "--row-group");
+				out.rowGroupRows = static_cast<std::uint32_t>(parse_size(std::string_view(tok).substr(12), "--row-group", 1024, 1u << 24, 1, "a number of rows from 1K to 16M such as 64K"));
+				seenRowGroup = true;
+				i++;
+				continue;
+			}
+			if (tok == "--row-group")
+			{
+				ensure_not_duplicate(seenRowGroup, "--row-group");
+				out.rowGroupRows = static_cast<std::uint32_t>(parse_size(next_value(args, i, "--row-group"), "--row-group", 1024, 1u << 24, 1, "a number of rows from 1K to 16M such as 64K"));
+				seenRowGroup = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok.starts_with("--compress-block="))
+			{
+				ensure_not_duplicate(seenCompressBlock, "--compress-block");
+				out.compressBlockBytes = parse_size(std::string_view(tok).substr(17), "--compress-block", std::uint64_t{64} << 10, std::uint64_t{64} << 20, 1, "a size from 64K to 64M such as 1M");
+				seenCompressBlock = true;
+				i++;
+				continue;
+			}
+			if (tok == "--compress-block")
+			{
+				ensure_not_duplicate(seenCompressBlock, "--compress-block");
+				out.compressBlockBytes = parse_size(next_value(args, i, "--compress-block"), "--compress-block", std::uint64_t{64} << 10, std::uint64_t{64} << 20, 1, "a size from 64K to 64M such as 1M");
+				seenCompressBlock = true;
+				i += 2;
+				continue;
+			}
+
+			if (tok == "--async-log")
+			{
+				ensure_not_duplicate(seenAsyncLog, "--async-log");
+				out.asyncLog = true;
+				seenAsyncLog = true;
+				i++;
+				continue;
+			}
+
 			if (!tok.empty() && tok[0] == '-')
 			{
 				std::ostringstream oss;
@@ -103,7 +522,7 @@ namespace gwatch
 			throw ParseError(oss.str());
 		}
 
-		if (!seenVar || out.symbol.empty())
+		if (!seenVar || out.symbols.empty())
 		{
 			throw ParseError("Missing required option: --var <symbol>");
 		}
@@ -111,6 +530,95 @@ namespace gwatch
 		{
 			throw ParseError("Missing required option: --exec <path>");
 		}
+		if (seenInterval && out.engine != WatchEngine::Dirty && out.engine != WatchEngine::Poll && out.engine != WatchEngine::Hybrid)
+		{
+			throw ParseError("--interval only applies to --engine dirty, poll and hybrid");
+		}
+		if (seenHotSites && out.engine != WatchEngine::Breakpoints && out.engine != WatchEngine::Hybrid && out.engine != WatchEngine::Perf)
+		{
+			throw ParseError("--hot-sites only applies to --engine breakpoints, hybrid and perf");
+		}
+#ifdef __linux__
+		// Re-arming debug registers through ptrace needs every thread stopped: only perf rotates.
+		if (seenRotate && out.engine != WatchEngine::Perf)
+		{
+			throw ParseError("--rotate requires --engine perf on Linux");
+		}
+#endif
+		if (out.mode == OutputMode::Stats && (seenFormat || seenAsyncLog))
+		{
+			throw ParseError("--format and --async-log only apply to --mode log");
+		}
+		if (out.mode == OutputMode::Stats && (seenOverflow || seenQueueSize))
+		{
+			throw ParseError("--overflow and --queue-size only apply to --mode log");
+		}
+		// The output queue is the asynchronous logger's.
+		if (seenOverflow || seenQueueSize)
+		{
+			out.asyncLog = true;
+		}
+		if (out.mode == OutputMode::Stats && seenCoalesce)
+		{
+			throw ParseError("--coalesce only applies to --mode log");
+		}
+		if (seenCoalesceWindow && out.coalesce == Coalescing::Off)
+		{
+			throw ParseError("--coalesce-window requires --coalesce");
+		}
+		if (out.mode == OutputMode::Stats && (seenRateLimit || seenSample))
+		{
+			throw ParseError("--rate-limit and --sample only apply to --mode log");
+		}
+		if ((seenTraceSegment || seenTraceRotate || seenTraceKeep) && !seenTraceFile)
+		{
+			throw ParseError("--trace-segment, --trace-rotate and --trace-keep require --trace-file");
+		}
+		if (seenTraceIo && !seenTraceFile)
+		{
+			throw ParseError("--trace-io requires --trace-file");
+		}
+		if ((seenTraceBlock || seenTraceDepth || seenTraceDirect) && out.traceIo != TraceBackend::Uring)
+		{
+			throw ParseError("--trace-block, --trace-depth and --trace-direct only apply to --trace-io uring");
+		}
+		if (out.mode == OutputMode::Stats && seenTraceFile)
+		{
+			throw ParseError("--trace-file only applies to --mode log");
+		}
+		if (seenOverflow && seenTraceFile)
+		{
+			throw ParseError("--overflow only applies to stdout, not to --trace-file");
+		}
+		if (seenRowGroup && out.format != LogFormat::Columnar)
+		{
+			throw ParseError("--row-group requires --format=columnar");
+		}
+		if (seenCompressBlock && !seenCompress)
+		{
+			throw ParseError("--compress-block requires --compress");
+		}
+		if (seenCompress && out.mode == OutputMode::Stats)
+		{
+			throw ParseError("--compress only applies to --mode log");
+		}
+		if (seenCompress && seenTraceFile)
+		{
+			throw ParseError("--compress only applies to stdout, not to --trace-file");
+		}
+		if (seenCompress && seenOverflow)
+		{
+			throw ParseError("--overflow does not apply to --compress");
+		}
+		for (const auto& name : out.policies | std::views::keys)
+		{
+			if (!name.empty() && std::ranges::find(out.symbols, name) == out.symbols.end())
+			{
+				std::ostringstream oss;
+				oss << "Variable not listed in --var: " << name;
+				throw ParseError(oss.str());
+			}
+		}
 
 		return out;
 	}
@@ -119,10 +627,64 @@ namespace gwatch
 	{
 		os <<
 			"Usage:\n"
-			"  " << programName << " --var <symbol> --exec <path> [-- arg1 ... argN]\n\n"
+			"  " << programName << " --var <symbol>[,<symbol>...] --exec <path> [--engine <name>] [--interval <time>] [--rotate <ms>] [--hot-sites <n>] [--mode log|stats] [--coalesce thread|global] [--rate-limit [<var>=]<n>] [--sample [<var>=]<n>] [--async-log] [--overflow <policy>] [--queue-size <n>] [--trace-file <path>] [--trace-io mmap|uring] [--compress lz|zstd|auto] [--format=text|binary|columnar] [-- arg1 ... argN]\n\n"
 			"Options:\n"
-			"  -v, --var <symbol>     Global variable name to watch (required)\n"
+			"  -v, --var <symbols>    Global variable(s) to watch, comma-separated (required)\n"
 			"  -e, --exec <path>      Path to the executable to run (required)\n"
+			"      --engine <name>    breakpoints (default): hardware slots, 4-8 byte variables\n"
+			"                         pages: write-protected pages, objects of any size, writes only (Linux)\n"
+			"                         dirty: soft-dirty page scans of whole regions or sections, writes only (Linux)\n"
+			"                         poll: a thread reads the variables every --interval, writes only (Linux)\n"
+			"                         hybrid: 2 slots, writes trap, reads are only counted per thread (Linux)\n"
+			"                         perf: sampled breakpoints, never stops the target; values only of plain\n"
+			"                         moves, other accesses print '?' (Linux)\n"
+			"      --interval <time>  Time between two dirty scans (default 10ms), poll reads (default 100us)\n"
+			"                         or hybrid read summaries (default 1s): <n>us, <n>ms (default unit) or <n>s,\n"
+			"                         0 = back to back (busy poll) or summary at exit only (hybrid)\n"
+			"      --rotate <ms>      Variables beyond the 4 hardware slots take turns, one group every <ms>\n"
+			"                         (Linux: --engine perf only)\n"
+			"      --hot-sites <n>    At exit, print the <n> instructions that accessed the variables most\n"
+			"                         (breakpoints, hybrid and perf; hybrid only knows where writes happen)\n"
+			"      --mode <mode>      log (default): one line per access\n"
+			"                         stats: no per-access output, per-variable counts, intervals and value\n"
+			"                         sketches in bounded memory, printed at exit and on SIGUSR1 (Linux)\n"
+			"      --coalesce <scope> Merge identical consecutive accesses into one line ending in x<count>:\n"
+			"                         thread: runs per thread, global: any other access ends the run\n"
+			"      --coalesce-window <time>\n"
+			"                         Longest a run is held back (default 100ms, 0 = until it ends)\n"
+			"      --rate-limit <limits>\n"
+			"                         At most <n> accesses per second reach the output, with bursts of up to\n"
+			"                         <n>; comma-separated <var>=<n> entries override a plain <n> per variable\n"
+			"      --sample <rates>   Only 1 access in <n> reaches the output; same syntax as --rate-limit\n"
+			"      --async-log        Queue log lines to a writer thread instead of printing inline\n"
+			"      --overflow <policy>\n"
+			"                         What the --async-log queue does when stdout stalls and it is full:\n"
+			"                         block (default) waits, drop-newest or drop-oldest drops records,\n"
+			"                         spill:<path> stores them in <path> until stdout drains\n"
+			"      --queue-size <n>   Records the --async-log queue holds (default 65536)\n"
+			"      --trace-file <path>\n"
+			"                         Write the output to segments <path>.0, <path>.1, ...\n"
+			"                         instead of stdout (Linux)\n"
+			"      --trace-segment <size>\n"
+			"                         Size of a segment: <n>, <n>K, <n>M (default 64M) or <n>G\n"
+			"      --trace-rotate <time>\n"
+			"                         Also start a new segment after <time> (default: only when full)\n"
+			"      --trace-keep <n>   Keep only the <n> most recent segments on disk\n"
+			"      --trace-io <backend>\n"
+			"                         mmap (default): segments are shared mappings, crash-safe\n"
+			"                         uring: block writes through io_uring, off the logging thread's back\n"
+			"      --trace-block <size>\n"
+			"                         Size of an io_uring write, a multiple of 4K (default 1M)\n"
+			"      --trace-depth <n>  io_uring writes in flight (default 4)\n"
+			"      --trace-direct     Open the io_uring segments with O_DIRECT, bypassing the page cache\n"
+			"      --compress <codec> Compress stdout on a worker thread, in independently decodable blocks\n"
+			"                         (decode with gwatch-dump): lz (built in), zstd (when available) or\n"
+			"                         auto (zstd if available, else lz)\n"
+			"      --compress-block <size>\n"
+			"                         Uncompressed bytes per block: 64K to 64M (default 1M)\n"
+			"      --format <fmt>     Output format: text (default), binary (decode with gwatch-dump) or\n"
+			"                         columnar (fixed-width columns in row groups, for analytics)\n"
+			"      --row-group <n>    Rows per columnar row group: 1K to 16M (default 64K)\n"
 			"      --                 Separator, everything after is passed to the target\n"
 			"  -h, --help             Show this help and exit\n\n"
 			"Notes:\n"
@@ -140,7 +702,299 @@ namespace gwatch
 		}
 	}
 
-	std::string ArgumentsParser::next_value(const std::span<const char*>& args, const int idx, const std::string_view optName)
+	std::vector<std::string> ArgumentsParser::parse_symbols(const std::string_view value)
+	{
+		std::vector<std::string> symbols;
+		std::size_t begin = 0;
+		while (true)
+		{
+			const std::size_t comma = value.find(',', begin);
+			const std::string_view name = value.substr(begin, comma == std::string_view::npos ? std::string_view::npos : comma - begin);
+			if (name.empty())
+			{
+				throw ParseError("Empty value for --var");
+			}
+			if (std::ranges::find(symbols, name) != symbols.end())
+			{
+				std::ostringstream oss;
+				oss << "Variable listed more than once in --var: " << name;
+				throw ParseError(oss.str());
+			}
+			symbols.emplace_back(name);
+			if (comma == std::string_view::npos)
+				break;
+			begin = comma + 1;
+		}
+
+		if (symbols.size() > kMaxWatchedSymbols)
+		{
+			std::ostringstream oss;
+			oss << "Too many variables for --var: " << symbols.size() << " (at most " << kMaxWatchedSymbols << ")";
+			throw ParseError(oss.str());
+		}
+		return symbols;
+	}
+
+	std::uint32_t ArgumentsParser::parse_quantum(const std::string_view value)
+	{
+		std::uint32_t ms = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), ms);
+		if (ec != std::errc{} || ptr != value.data() + value.size() || ms == 0)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --rotate: '" << value << "' (expected a positive number of milliseconds)";
+			throw ParseError(oss.str());
+		}
+		return ms;
+	}
+
+	WatchEngine ArgumentsParser::parse_engine(const std::string_view value)
+	{
+		if (value == "breakpoints")
+			return WatchEngine::Breakpoints;
+		if (value == "pages")
+			return WatchEngine::Pages;
+		if (value == "dirty")
+			return WatchEngine::Dirty;
+		if (value == "poll")
+			return WatchEngine::Poll;
+		if (value == "hybrid")
+			return WatchEngine::Hybrid;
+		if (value == "perf")
+			return WatchEngine::Perf;
+
+		std::ostringstream oss;
+		oss << "Invalid value for --engine: '" << value << "' (expected breakpoints, pages, dirty, poll, hybrid or perf)";
+		throw ParseError(oss.str());
+	}
+
+	std::uint32_t ArgumentsParser::parse_duration(const std::string_view value, const std::string_view optName)
+	{
+		std::uint64_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		const std::string_view unit(ptr, static_cast<std::size_t>(value.data() + value.size() - ptr));
+		std::uint64_t scale = 0;
+		if (unit == "us")
+			scale = 1;
+		else if (unit.empty() || unit == "ms")
+			scale = 1'000;
+		else if (unit == "s")
+			scale = 1'000'000;
+
+		if (ec != std::errc{} || scale == 0 || count > std::numeric_limits<std::uint32_t>::max() / scale)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for " << optName << ": '" << value << "' (expected a duration such as 500us, 10ms or 1s)";
+			throw ParseError(oss.str());
+		}
+		return static_cast<std::uint32_t>(count * scale);
+	}
+
+	std::uint32_t ArgumentsParser::parse_hot_sites(const std::string_view value)
+	{
+		std::uint32_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		if (ec != std::errc{} || ptr != value.data() + value.size() || count == 0)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --hot-sites: '" << value << "' (expected a positive number of sites)";
+			throw ParseError(oss.str());
+		}
+		return count;
+	}
+
+	OutputMode ArgumentsParser::parse_mode(const std::string_view value)
+	{
+		if (value == "log")
+			return OutputMode::Log;
+		if (value == "stats")
+			return OutputMode::Stats;
+
+		std::ostringstream oss;
+		oss << "Invalid value for --mode: '" << value << "' (expected log or stats)";
+		throw ParseError(oss.str());
+	}
+
+	Coalescing ArgumentsParser::parse_coalesce(const std::string_view value)
+	{
+		if (value == "thread")
+			return Coalescing::PerThread;
+		if (value == "global")
+			return Coalescing::Global;
+
+		std::ostringstream oss;
+		oss << "Invalid value for --coalesce: '" << value << "' (expected thread or global)";
+		throw ParseError(oss.str());
+	}
+
+	void ArgumentsParser::parse_overflow(const std::string_view value, CliArgs& out)
+	{
+		if (value == "block")
+			out.overflow = OverflowPolicy::Block;
+		else if (value == "drop-newest")
+			out.overflow = OverflowPolicy::DropNewest;
+		else if (value == "drop-oldest")
+			out.overflow = OverflowPolicy::DropOldest;
+		else if (value.starts_with("spill:") && value.size() > 6)
+		{
+			out.overflow = OverflowPolicy::Spill;
+			out.spillPath = value.substr(6);
+		}
+		else
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --overflow: '" << value << "' (expected block, drop-newest, drop-oldest or spill:<path>)";
+			throw ParseError(oss.str());
+		}
+	}
+
+	std::uint64_t ArgumentsParser::parse_size(const std::string_view value, const std::string_view optName, const std::uint64_t min, const std::uint64_t max, const std::uint64_t multipleOf, const std::string_view expected)
+	{
+		std::uint64_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		const std::string_view unit(ptr, static_cast<std::size_t>(value.data() + value.size() - ptr));
+		unsigned shift = 64;
+		if (unit.empty())
+			shift = 0;
+		else if (unit == "K" || unit == "k")
+			shift = 10;
+		else if (unit == "M" || unit == "m")
+			shift = 20;
+		else if (unit == "G" || unit == "g")
+			shift = 30;
+
+		if (ec != std::errc{} || shift == 64 || count > (max >> shift) || (count << shift) < min || (count << shift) % multipleOf != 0)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for " << optName << ": '" << value << "' (expected " << expected << ")";
+			throw ParseError(oss.str());
+		}
+		return count << shift;
+	}
+
+	std::uint64_t ArgumentsParser::parse_segment_size(const std::string_view value)
+	{
+		return parse_size(value, "--trace-segment", std::uint64_t{64} << 10, std::uint64_t{16} << 30, 1, "a size from 64K to 16G such as 512K or 64M");
+	}
+
+	std::uint32_t ArgumentsParser::parse_trace_keep(const std::string_view value)
+	{
+		std::uint32_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		if (ec != std::errc{} || ptr != value.data() + value.size() || count == 0)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --trace-keep: '" << value << "' (expected a positive number of segments)";
+			throw ParseError(oss.str());
+		}
+		return count;
+	}
+
+	TraceBackend ArgumentsParser::parse_trace_io(const std::string_view value)
+	{
+		if (value == "mmap")
+			return TraceBackend::Mmap;
+		if (value == "uring")
+			return TraceBackend::Uring;
+		std::ostringstream oss;
+		oss << "Invalid value for --trace-io: '" << value << "' (expected mmap or uring)";
+		throw ParseError(oss.str());
+	}
+
+	std::uint32_t ArgumentsParser::parse_trace_depth(const std::string_view value)
+	{
+		std::uint32_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		if (ec != std::errc{} || ptr != value.data() + value.size() || count == 0 || count > 256)
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --trace-depth: '" << value << "' (expected a number of writes from 1 to 256)";
+			throw ParseError(oss.str());
+		}
+		return count;
+	}
+
+	compress::Codec ArgumentsParser::parse_compress(const std::string_view value)
+	{
+		if (value == "auto")
+			return compress::default_codec();
+		if (value == "lz")
+			return compress::Codec::Lz;
+		if (value == "zstd" && compress::available(compress::Codec::Zstd))
+			return compress::Codec::Zstd;
+		std::ostringstream oss;
+		oss << "Invalid value for --compress: '" << value << "' (expected " << (compress::available(compress::Codec::Zstd) ? "lz, zstd or auto)" : "lz or auto; this build has no zstd)");
+		throw ParseError(oss.str());
+	}
+
+	std::uint32_t ArgumentsParser::parse_queue_size(const std::string_view value)
+	{
+		std::uint32_t count = 0;
+		const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+		if (ec != std::errc{} || ptr != value.data() + value.size() || count < 2 || count > (1u << 24))
+		{
+			std::ostringstream oss;
+			oss << "Invalid value for --queue-size: '" << value << "' (expected a number of records from 2 to 16777216)";
+			throw ParseError(oss.str());
+		}
+		return count;
+	}
+
+	void ArgumentsParser::parse_policies(const std::string_view value, const std::string_view optName, std::uint32_t LogPolicy::* const field, CliArgs& out)
+	{
+		std::size_t begin = 0;
+		while (true)
+		{
+			const std::size_t comma = value.find(',', begin);
+			const std::string_view entry = value.substr(begin, comma == std::string_view::npos ? std::string_view::npos : comma - begin);
+			const std::size_t equals = entry.find('=');
+			const std::string_view name = equals == std::string_view::npos ? std::string_view{} : entry.substr(0, equals);
+			const std::string_view number = equals == std::string_view::npos ? entry : entry.substr(equals + 1);
+
+			std::uint32_t n = 0;
+			const auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), n);
+			if (ec != std::errc{} || ptr != number.data() + number.size() || n == 0 || (equals != std::string_view::npos && name.empty()))
+			{
+				std::ostringstream oss;
+				oss << "Invalid value for " << optName << ": '" << entry << "' (expected [<var>=]<n> with a positive <n>)";
+				throw ParseError(oss.str());
+			}
+
+			auto it = std::ranges::find(out.policies, name, &std::pair<std::string, LogPolicy>::first);
+			if (it == out.policies.end())
+			{
+				out.policies.emplace_back(std::string(name), LogPolicy{});
+				it = out.policies.end() - 1;
+			}
+			if (it->second.*field != 0)
+			{
+				std::ostringstream oss;
+				oss << "Variable listed more than once in " << optName << ": " << (name.empty() ? "<default>" : name);
+				throw ParseError(oss.str());
+			}
+			it->second.*field = n;
+
+			if (comma == std::string_view::npos)
+				break;
+			begin = comma + 1;
+		}
+	}
+
+	LogFormat ArgumentsParser::parse_format(const std::string_view value)
+	{
+		if (value == "text")
+			return LogFormat::Text;
+		if (value == "binary")
+			return LogFormat::Binary;
+		if (value == "columnar")
+			return LogFormat::Columnar;
+
+		std::ostringstream oss;
+		oss << "Invalid value for --format: '" << value << "' (expected text, binary or columnar)";
+		throw ParseError(oss.str());
+	}
+
+	std::string ArgumentsParser::next_value(const std::span<const char*>& args, const std::size_t idx, const std::string_view optName)
 	{
 		if (idx + 1 >= args.size())
 		{
@@ -0,0 +1,334 @@
+#include "../include/ColumnarTrace.h"
+
+#include <bit>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+namespace gwatch::columnar
+{
+	static_assert(std::endian::native == std::endian::little, "the columnar layout is little-endian");
+
+	namespace
+	{
+		constexpr std::size_t kFileHeaderSize = kAlignment;
+		constexpr std::size_t kGroupFixedSize = 24;
+		constexpr std::size_t kColumnEntrySize = 24;
+		constexpr std::size_t kSymbolFixedSize = 12;
+
+		std::size_t align_up(const std::size_t n)
+		{
+			return (n + kAlignment - 1) & ~(kAlignment - 1);
+		}
+
+		template<typename T>
+		void store(char* p, const T v)
+		{
+			std::memcpy(p, &v, sizeof(v));
+		}
+
+		template<typename T>
+		T load(const char* p)
+		{
+			T v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		// Column bytes of a group, padding included.
+		std::size_t columns_size(const std::size_t rows)
+		{
+			std::size_t size = 0;
+			for (const std::size_t width : kWidths)
+				size += align_up(width * rows);
+			return size;
+		}
+
+		template<typename T>
+		char* put_column(char* group, std::size_t& offset, char* entry, const std::vector<T>& values)
+		{
+			const ColumnStats stats = min_max(std::span<const T>(values));
+			store<std::uint64_t>(entry, offset);
+			store<std::uint64_t>(entry + 8, stats.min);
+			store<std::uint64_t>(entry + 16, stats.max);
+			if (!values.empty())
+				std::memcpy(group + offset, values.data(), values.size() * sizeof(T));
+			offset += align_up(values.size() * sizeof(T));
+			return entry + kColumnEntrySize;
+		}
+	}
+
+	Writer::Writer(const std::uint32_t rows)
+	{
+		set_rows(rows);
+	}
+
+	void Writer::set_rows(const std::uint32_t rows)
+	{
+		m_groupRows = std::max<std::uint32_t>(rows, 1);
+	}
+
+	bool Writer::add(const LogRecord& record)
+	{
+		m_time.push_back(record.timestamp_ns);
+		m_tid.push_back(record.tid);
+		m_var.push_back(record.symbol);
+		m_kind.push_back(static_cast<std::uint8_t>(static_cast<std::uint8_t>(record.kind) | (record.exact ? 0 : kUnknownValues)));
+		m_old.push_back(record.old_value);
+		m_new.push_back(record.new_value);
+		m_ip.push_back(record.ip);
+		m_count.push_back(record.repeat);
+		return m_time.size() >= m_groupRows;
+	}
+
+	std::size_t Writer::header_size(const std::span<const trace::SymbolView> symbols) const
+	{
+		std::size_t size = kGroupFixedSize + kColumns * kColumnEntrySize;
+		for (std::size_t id = m_symbolsWritten; id < symbols.size(); ++id)
+			size += kSymbolFixedSize + symbols[id].name.size();
+		return align_up(size);
+	}
+
+	std::size_t Writer::render_size(const std::span<const trace::SymbolView> symbols) const
+	{
+		return (m_headerWritten ? 0 : kFileHeaderSize) + header_size(symbols) + columns_size(m_time.size());
+	}
+
+	void Writer::render(const std::span<const trace::SymbolView> symbols, std::vector<char>& out)
+	{
+		const std::size_t used = out.size();
+		out.resize(used + render_size(symbols));
+		char* p = out.data() + used;
+		if (!m_headerWritten)
+		{
+			std::memcpy(p, kMagic, sizeof(kMagic));
+			store<std::uint32_t>(p + 4, kVersion);
+			store<std::uint32_t>(p + 8, static_cast<std::uint32_t>(kColumns));
+			p += kFileHeaderSize;
+			m_headerWritten = true;
+		}
+
+		char* const group = p;
+		const std::size_t headerBytes = header_size(symbols);
+		const std::size_t rows = m_time.size();
+		std::memcpy(group, kGroupMagic, sizeof(kGroupMagic));
+		store<std::uint32_t>(group + 4, static_cast<std::uint32_t>(rows));
+		store<std::uint64_t>(group + 8, headerBytes + columns_size(rows));
+		store<std::uint32_t>(group + 16, static_cast<std::uint32_t>(symbols.size() - std::min(m_symbolsWritten, symbols.size())));
+
+		char* def = group + kGroupFixedSize + kColumns * kColumnEntrySize;
+		for (; m_symbolsWritten < symbols.size(); ++m_symbolsWritten)
+		{
+			const trace::SymbolView& symbol = symbols[m_symbolsWritten];
+			store<std::uint32_t>(def, static_cast<std::uint32_t>(m_symbolsWritten));
+			store<std::uint32_t>(def + 4, symbol.size);
+			store<std::uint32_t>(def + 8, static_cast<std::uint32_t>(symbol.name.size()));
+			std::memcpy(def + kSymbolFixedSize, symbol.name.data(), symbol.name.size());
+			def += kSymbolFixedSize + symbol.name.size();
+		}
+
+		std::size_t offset = headerBytes;
+		char* entry = group + kGroupFixedSize;
+		entry = put_column(group, offset, entry, m_time);
+		entry = put_column(group, offset, entry, m_tid);
+		entry = put_column(group, offset, entry, m_var);
+		entry = put_column(group, offset, entry, m_kind);
+		entry = put_column(group, offset, entry, m_old);
+		entry = put_column(group, offset, entry, m_new);
+		entry = put_column(group, offset, entry, m_ip);
+		put_column(group, offset, entry, m_count);
+
+		m_time.clear();
+		m_tid.clear();
+		m_var.clear();
+		m_kind.clear();
+		m_old.clear();
+		m_new.clear();
+		m_ip.clear();
+		m_count.clear();
+	}
+
+	void Writer::restart()
+	{
+		m_headerWritten = false;
+		m_symbolsWritten = 0;
+	}
+
+	void Writer::reset()
+	{
+		restart();
+		m_time.clear();
+		m_tid.clear();
+		m_var.clear();
+		m_kind.clear();
+		m_old.clear();
+		m_new.clear();
+		m_ip.clear();
+		m_count.clear();
+	}
+
+	LogRecord RowGroup::record(const std::uint32_t i) const
+	{
+		return LogRecord{
+			.timestamp_ns = timestamps()[i],
+			.old_value = old_values()[i],
+			.new_value = new_values()[i],
+			.tid = tids()[i],
+			.symbol = vars()[i],
+			.kind = (kinds()[i] & kKindBits) != 0 ? AccessKind::Write : AccessKind::Read,
+			.exact = (kinds()[i] & kUnknownValues) == 0,
+			.repeat = counts()[i],
+			.ip = ips()[i],
+		};
+	}
+
+	RowGroup RowGroup::slice(const std::uint32_t first, const std::uint32_t rows) const
+	{
+		RowGroup part = *this;
+		part.m_rows = std::min(rows, m_rows - std::min(first, m_rows));
+		for (std::size_t c = 0; c < kColumns; ++c)
+			part.m_columns[c] += kWidths[c] * std::min(first, m_rows);
+		return part;
+	}
+
+	Reader::Reader(const std::span<const char> data)
+	{
+		if (data.size() < kFileHeaderSize || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+			throw ColumnarError("Not a columnar trace");
+		if (reinterpret_cast<std::uintptr_t>(data.data()) % 8 != 0)
+			throw ColumnarError("Columnar trace data must be 8-byte aligned");
+		if (load<std::uint32_t>(data.data() + 4) != kVersion)
+			throw ColumnarError("Unsupported columnar trace version " + std::to_string(load<std::uint32_t>(data.data() + 4)));
+		if (load<std::uint32_t>(data.data() + 8) != kColumns)
+			throw ColumnarError("Unexpected columnar trace column count " + std::to_string(load<std::uint32_t>(data.data() + 8)));
+
+		constexpr std::size_t kDirectory = kGroupFixedSize + kColumns * kColumnEntrySize;
+		std::size_t offset = kFileHeaderSize;
+		while (offset + kDirectory <= data.size() && load<std::uint32_t>(data.data() + offset) != 0)
+		{
+			const char* group = data.data() + offset;
+			if (std::memcmp(group, kGroupMagic, sizeof(kGroupMagic)) != 0)
+				throw ColumnarError("Corrupt columnar trace: bad row group header at offset " + std::to_string(offset));
+			const std::uint32_t rows = load<std::uint32_t>(group + 4);
+			const std::uint64_t bytes = load<std::uint64_t>(group + 8);
+			if (bytes < kDirectory || bytes % kAlignment != 0)
+				throw ColumnarError("Corrupt columnar trace: bad row group size at offset " + std::to_string(offset));
+			if (bytes > data.size() - offset)
+				break;
+
+			RowGroup rowGroup;
+			rowGroup.m_rows = rows;
+			rowGroup.m_offset = offset;
+			std::uint64_t firstColumn = bytes;
+			for (std::size_t c = 0; c < kColumns; ++c)
+			{
+				const char* entry = group + kGroupFixedSize + c * kColumnEntrySize;
+				const std::uint64_t columnOffset = load<std::uint64_t>(entry);
+				if (columnOffset < kDirectory || columnOffset % kAlignment != 0 || columnOffset > bytes || kWidths[c] * rows > bytes - columnOffset)
+					throw ColumnarError("Corrupt columnar trace: column out of its row group at offset " + std::to_string(offset));
+				firstColumn = std::min(firstColumn, columnOffset);
+				rowGroup.m_columns[c] = group + columnOffset;
+				rowGroup.m_stats[c] = {load<std::uint64_t>(entry + 8), load<std::uint64_t>(entry + 16)};
+			}
+
+			const char* def = group + kDirectory;
+			const char* const defsEnd = group + firstColumn;
+			for (std::uint32_t s = load<std::uint32_t>(group + 16); s > 0; --s)
+			{
+				if (static_cast<std::size_t>(defsEnd - def) < kSymbolFixedSize)
+					throw ColumnarError("Corrupt columnar trace: truncated symbol definition");
+				const std::uint32_t id = load<std::uint32_t>(def);
+				const std::uint32_t size = load<std::uint32_t>(def + 4);
+				const std::uint32_t length = load<std::uint32_t>(def + 8);
+				def += kSymbolFixedSize;
+				if (static_cast<std::size_t>(defsEnd - def) < length || id > (1u << 24))
+					throw ColumnarError("Corrupt columnar trace: bad symbol definition");
+				if (id >= m_symbols.size())
+					m_symbols.resize(id + 1);
+				m_symbols[id] = trace::SymbolDef{.name = std::string(def, length), .size = size};
+				def += length;
+			}
+
+			m_groups.push_back(rowGroup);
+			m_rows += rows;
+			offset += bytes;
+		}
+	}
+
+	std::optional<std::uint32_t> Reader::find_symbol(const std::string_view name) const
+	{
+		for (std::size_t id = 0; id < m_symbols.size(); ++id)
+		{
+			if (m_symbols[id].name == name)
+				return static_cast<std::uint32_t>(id);
+		}
+		return std::nullopt;
+	}
+
+	bool may_match(const RowGroup& group, const Filter& filter)
+	{
+		const auto covers = [&group](const Column column, const std::uint64_t lo, const std::uint64_t hi)
+		{
+			const ColumnStats& stats = group.stats(column);
+			return stats.min <= hi && lo <= stats.max;
+		};
+		if (group.rows() == 0)
+			return false;
+		if (filter.var && !covers(Column::Var, *filter.var, *filter.var))
+			return false;
+		if (filter.tid && !covers(Column::Tid, *filter.tid, *filter.tid))
+			return false;
+		// Kind holds flags above the access kind: only a group of a single kind value rules one out.
+		if (const ColumnStats& kinds = group.stats(Column::Kind); filter.kind && kinds.min == kinds.max && (kinds.min & kKindBits) != static_cast<std::uint64_t>(*filter.kind))
+			return false;
+		if (filter.value && !covers(Column::New, *filter.value, *filter.value))
+			return false;
+		return covers(Column::Timestamp, filter.fromNs, filter.toNs);
+	}
+
+	void select(const RowGroup& group, const Filter& filter, std::vector<std::uint32_t>& rows)
+	{
+		rows.clear();
+		if (filter.fromNs > filter.toNs)
+			return;
+		bool first = true;
+		// The first condition selects, the next ones refine the selection.
+		const auto apply = [&rows, &first]<typename T>(const std::span<const T> values, const T lo, const T hi)
+		{
+			if (first)
+				select_range(values, lo, hi, rows);
+			else
+				refine_range(values, lo, hi, rows);
+			first = false;
+		};
+		const auto apply_masked = [&rows, &first]<typename T>(const std::span<const T> values, const T mask, const T want)
+		{
+			if (first)
+				select_masked(values, mask, want, rows);
+			else
+				refine_masked(values, mask, want, rows);
+			first = false;
+		};
+		if (filter.var)
+			apply(group.vars(), *filter.var, *filter.var);
+		if (filter.tid)
+			apply(group.tids(), *filter.tid, *filter.tid);
+		if (filter.kind)
+		{
+			const auto kind = static_cast<std::uint8_t>(*filter.kind);
+			apply_masked(group.kinds(), kKindBits, kind);
+		}
+		if (filter.value)
+		{
+			apply(group.new_values(), *filter.value, *filter.value);
+			refine_masked(group.kinds(), kUnknownValues, std::uint8_t{0}, rows);
+		}
+		if (filter.fromNs != 0 || filter.toNs != UINT64_MAX)
+			apply(group.timestamps(), filter.fromNs, filter.toNs);
+		if (first)
+		{
+			rows.resize(group.rows());
+			std::iota(rows.begin(), rows.end(), 0u);
+		}
+	}
+}
@@ -0,0 +1,502 @@
+#include "../include/Compression.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef GWATCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace gwatch::compress
+{
+	namespace
+	{
+		constexpr std::size_t kHeaderSize = 8;
+		constexpr std::size_t kBlockHeaderSize = 8;
+		constexpr std::size_t kTrailerSize = 12;
+		// Largest block: the size fields keep their top bit for kStoredRaw.
+		constexpr std::size_t kMaxBlock = kStoredRaw - 1;
+
+		// Built-in codec: a sequence is a token (literal count in the high nibble, match
+		// length - 4 in the low one; 15 = more in the following bytes, 255 each until one is
+		// smaller), the literals, then a u16 match offset. The last sequence is literals only.
+		constexpr std::size_t kMinMatch = 4;
+		constexpr unsigned kHashBits = 14;
+		constexpr std::size_t kMaxOffset = 0xFFFF;
+
+		std::uint32_t load32(const char* p)
+		{
+			std::uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		std::uint32_t hash(const std::uint32_t v)
+		{
+			return (v * 2654435761u) >> (32 - kHashBits);
+		}
+
+		void put_length(std::vector<char>& out, std::size_t length)
+		{
+			for (; length >= 255; length -= 255)
+				out.push_back(static_cast<char>(255));
+			out.push_back(static_cast<char>(length));
+		}
+
+		void put_sequence(std::vector<char>& out, const char* literals, const std::size_t literalCount, const std::size_t offset, const std::size_t matchLength)
+		{
+			const std::size_t matchCode = matchLength > 0 ? matchLength - kMinMatch : 0;
+			out.push_back(static_cast<char>((std::min<std::size_t>(literalCount, 15) << 4) | std::min<std::size_t>(matchCode, 15)));
+			if (literalCount >= 15)
+				put_length(out, literalCount - 15);
+			out.insert(out.end(), literals, literals + literalCount);
+			if (matchLength == 0)
+				return;
+			out.push_back(static_cast<char>(offset & 0xFF));
+			out.push_back(static_cast<char>(offset >> 8));
+			if (matchCode >= 15)
+				put_length(out, matchCode - 15);
+		}
+
+		void lz_compress(const std::span<const char> in, std::vector<char>& out)
+		{
+			const char* base = in.data();
+			const std::size_t n = in.size();
+			std::array<std::uint32_t, std::size_t{1} << kHashBits> table{};
+			std::size_t anchor = 0;
+			std::size_t ip = 0;
+			while (ip + kMinMatch <= n)
+			{
+				const std::uint32_t sequence = load32(base + ip);
+				std::uint32_t& slot = table[hash(sequence)];
+				const std::size_t ref = slot;
+				slot = static_cast<std::uint32_t>(ip);
+				if (ref >= ip || ip - ref > kMaxOffset || load32(base + ref) != sequence)
+				{
+					// Incompressible stretches are crossed faster the longer they get.
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+				std::size_t length = kMinMatch;
+				while (ip + length < n && base[ref + length] == base[ip + length])
+					++length;
+				put_sequence(out, base + anchor, ip - anchor, ip - ref, length);
+				ip += length;
+				anchor = ip;
+			}
+			put_sequence(out, base + anchor, n - anchor, 0, 0);
+		}
+
+		std::size_t get_length(const char*& ip, const char* end, std::size_t length)
+		{
+			if (length < 15)
+				return length;
+			while (true)
+			{
+				if (ip == end)
+					throw CompressError("Corrupt compressed block: truncated length");
+				const auto byte = static_cast<std::uint8_t>(*ip++);
+				length += byte;
+				if (byte != 255)
+					return length;
+			}
+		}
+
+		void lz_decompress(const std::span<const char> in, const std::span<char> out)
+		{
+			const char* ip = in.data();
+			const char* const end = ip + in.size();
+			char* op = out.data();
+			char* const outEnd = op + out.size();
+			while (true)
+			{
+				if (ip == end)
+					throw CompressError("Corrupt compressed block: truncated sequence");
+				const auto token = static_cast<std::uint8_t>(*ip++);
+				const std::size_t literals = get_length(ip, end, token >> 4);
+				if (literals > static_cast<std::size_t>(end - ip) || literals > static_cast<std::size_t>(outEnd - op))
+					throw CompressError("Corrupt compressed block: literals out of range");
+				std::memcpy(op, ip, literals);
+				ip += literals;
+				op += literals;
+				if (ip == end)
+					break;
+
+				if (end - ip < 2)
+					throw CompressError("Corrupt compressed block: truncated offset");
+				const std::size_t offset = static_cast<std::uint8_t>(ip[0]) | (static_cast<std::size_t>(static_cast<std::uint8_t>(ip[1])) << 8);
+				ip += 2;
+				const std::size_t length = get_length(ip, end, token & 15) + kMinMatch;
+				if (offset == 0 || offset > static_cast<std::size_t>(op - out.data()) || length > static_cast<std::size_t>(outEnd - op))
+					throw CompressError("Corrupt compressed block: match out of range");
+				const char* match = op - offset;
+				if (offset >= length)
+					std::memcpy(op, match, length);
+				else
+				{
+					// Overlapping: the match repeats the bytes it is producing.
+					for (std::size_t i = 0; i < length; ++i)
+						op[i] = match[i];
+				}
+				op += length;
+			}
+			if (op != outEnd)
+				throw CompressError("Corrupt compressed block: size mismatch");
+		}
+
+		void store_u32(char* p, const std::uint32_t v)
+		{
+			for (int i = 0; i < 4; ++i)
+				p[i] = static_cast<char>(v >> (8 * i));
+		}
+
+		void put_u32(std::vector<char>& out, const std::uint32_t v)
+		{
+			out.resize(out.size() + 4);
+			store_u32(out.data() + out.size() - 4, v);
+		}
+
+		void put_u64(std::vector<char>& out, const std::uint64_t v)
+		{
+			for (int shift = 0; shift < 64; shift += 8)
+				out.push_back(static_cast<char>(v >> shift));
+		}
+
+		std::uint32_t get_u32(const char* p)
+		{
+			std::uint32_t v = 0;
+			for (int i = 3; i >= 0; --i)
+				v = (v << 8) | static_cast<std::uint8_t>(p[i]);
+			return v;
+		}
+
+		std::uint64_t get_u64(const char* p)
+		{
+			std::uint64_t v = 0;
+			for (int i = 7; i >= 0; --i)
+				v = (v << 8) | static_cast<std::uint8_t>(p[i]);
+			return v;
+		}
+
+		// The block whose header starts at offset; false at the end marker or past the data.
+		bool read_block(const std::span<const char> stream, const std::uint64_t offset, Block& block)
+		{
+			if (offset + kBlockHeaderSize > stream.size())
+				return false;
+			const std::uint32_t stored = get_u32(stream.data() + offset);
+			const std::uint32_t rawSize = get_u32(stream.data() + offset + 4);
+			if (stored == 0 && rawSize == 0)
+				return false;
+			block.raw = (stored & kStoredRaw) != 0;
+			block.storedSize = stored & ~kStoredRaw;
+			block.rawSize = rawSize;
+			block.offset = offset + kBlockHeaderSize;
+			if (block.raw && block.storedSize != block.rawSize)
+				throw CompressError("Corrupt compressed stream: stored block size mismatch");
+			return block.offset + block.storedSize <= stream.size();
+		}
+
+#ifdef GWATCH_HAVE_ZSTD
+		constexpr int kZstdLevel = 3;
+#endif
+	}
+
+	bool available(const Codec codec)
+	{
+		if (codec == Codec::Lz)
+			return true;
+#ifdef GWATCH_HAVE_ZSTD
+		return codec == Codec::Zstd;
+#else
+		return false;
+#endif
+	}
+
+	Codec default_codec()
+	{
+		return available(Codec::Zstd) ? Codec::Zstd : Codec::Lz;
+	}
+
+	std::string_view codec_name(const Codec codec)
+	{
+		return codec == Codec::Zstd ? "zstd" : "lz";
+	}
+
+	void compress_block(const Codec codec, const std::span<const char> in, std::vector<char>& out)
+	{
+#ifdef GWATCH_HAVE_ZSTD
+		if (codec == Codec::Zstd)
+		{
+			// One context per thread, reused across blocks.
+			thread_local const std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+			const std::size_t start = out.size();
+			out.resize(start + ZSTD_compressBound(in.size()));
+			const std::size_t n = ZSTD_compressCCtx(context.get(), out.data() + start, out.size() - start, in.data(), in.size(), kZstdLevel);
+			if (ZSTD_isError(n))
+				throw CompressError(std::string("zstd: ") + ZSTD_getErrorName(n));
+			out.resize(start + n);
+			return;
+		}
+#endif
+		(void)codec;
+		lz_compress(in, out);
+	}
+
+	void decompress_block(const Codec codec, const std::span<const char> in, const std::span<char> out)
+	{
+		if (codec == Codec::Lz)
+		{
+			lz_decompress(in, out);
+			return;
+		}
+#ifdef GWATCH_HAVE_ZSTD
+		const std::size_t n = ZSTD_decompress(out.data(), out.size(), in.data(), in.size());
+		if (ZSTD_isError(n) || n != out.size())
+			throw CompressError("Corrupt zstd block");
+#else
+		throw CompressError("This build cannot decode zstd blocks");
+#endif
+	}
+
+	bool is_compressed(const std::span<const char> stream)
+	{
+		return stream.size() >= sizeof(kMagic) && std::memcmp(stream.data(), kMagic, sizeof(kMagic)) == 0;
+	}
+
+	Index read_index(const std::span<const char> stream)
+	{
+		if (!is_compressed(stream) || stream.size() < kHeaderSize)
+			throw CompressError("Not a compressed stream");
+		if (stream[5] != static_cast<char>(kVersion))
+			throw CompressError("Unsupported compressed stream version " + std::to_string(static_cast<std::uint8_t>(stream[5])));
+		Index index;
+		index.codec = static_cast<Codec>(stream[4]);
+		if (index.codec != Codec::Lz && index.codec != Codec::Zstd)
+			throw CompressError("Unknown compression codec " + std::to_string(static_cast<std::uint8_t>(stream[4])));
+
+		const auto add = [&index](Block block)
+		{
+			block.rawOffset = index.rawSize;
+			index.rawSize += block.rawSize;
+			index.blocks.push_back(block);
+		};
+
+		// The index, when it is there and consistent.
+		const bool closed = stream.size() >= kHeaderSize + kTrailerSize && std::memcmp(stream.data() + stream.size() - 4, kIndexMagic, 4) == 0;
+		if (closed)
+		{
+			const std::uint64_t at = get_u64(stream.data() + stream.size() - kTrailerSize);
+			const std::uint64_t entries = at >= kHeaderSize && at + 8 + kTrailerSize <= stream.size() ? (stream.size() - kTrailerSize - at - 8) / 8 : 0;
+			if (entries > 0 && get_u64(stream.data() + at) == entries)
+			{
+				for (std::uint64_t i = 0; i < entries; ++i)
+				{
+					Block block;
+					if (!read_block(stream, get_u64(stream.data() + at + 8 + i * 8), block))
+						throw CompressError("Corrupt compressed stream: bad index entry");
+					add(block);
+				}
+				return index;
+			}
+		}
+
+		Block block;
+		std::uint64_t offset = kHeaderSize;
+		for (; read_block(stream, offset, block); offset = block.offset + block.storedSize)
+			add(block);
+		// A stream that was closed must lead to its end marker; foreign bytes in it (such as
+		// other output sharing the file) would otherwise read as a stream cut short.
+		if (closed && (offset + kBlockHeaderSize > stream.size() || get_u32(stream.data() + offset) != 0 || get_u32(stream.data() + offset + 4) != 0))
+			throw CompressError("Corrupt compressed stream: the blocks do not lead to the index");
+		return index;
+	}
+
+	std::vector<char> decompress(const std::span<const char> stream, const unsigned threads)
+	{
+		const Index index = read_index(stream);
+		std::vector<char> out(index.rawSize);
+		std::atomic<std::size_t> next{0};
+		std::exception_ptr error;
+		std::mutex errorMutex;
+		const auto work = [&]
+		{
+			for (std::size_t i = next++; i < index.blocks.size(); i = next++)
+			{
+				const Block& b = index.blocks[i];
+				const std::span<const char> payload = stream.subspan(b.offset, b.storedSize);
+				const std::span<char> target(out.data() + b.rawOffset, b.rawSize);
+				try
+				{
+					if (b.raw)
+						std::memcpy(target.data(), payload.data(), b.rawSize);
+					else
+						decompress_block(index.codec, payload, target);
+				}
+				catch (...)
+				{
+					const std::lock_guard lock(errorMutex);
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < std::min<std::size_t>(std::max(threads, 1u), index.blocks.size()); ++t)
+			workers.emplace_back(work);
+		work();
+		for (auto& worker : workers)
+			worker.join();
+		if (error)
+			std::rethrow_exception(error);
+		return out;
+	}
+
+	StreamCompressor::StreamCompressor(const Codec codec, const std::size_t blockBytes, Sink sink) :
+		m_codec(codec),
+		m_blockBytes(blockBytes),
+		m_sink(std::move(sink))
+	{
+		if (!available(codec))
+			throw std::invalid_argument("Compression codec not available in this build: " + std::string(codec_name(codec)));
+		if (blockBytes == 0 || blockBytes > kMaxBlock)
+			throw std::invalid_argument("Invalid compression block size");
+		m_filling.reserve(m_blockBytes);
+		m_worker = std::thread([this] { run(); });
+	}
+
+	StreamCompressor::~StreamCompressor()
+	{
+		close();
+	}
+
+	void StreamCompressor::write(const char* data, std::size_t size)
+	{
+		std::unique_lock lock(m_mutex);
+		if (m_closing)
+			return;
+		// Blocks end on a write boundary: a write that does not fit starts the next block.
+		if (!m_filling.empty() && m_filling.size() + size > m_blockBytes)
+			ship(lock);
+		while (size > m_blockBytes)
+		{
+			m_filling.insert(m_filling.end(), data, data + m_blockBytes);
+			data += m_blockBytes;
+			size -= m_blockBytes;
+			ship(lock);
+		}
+		m_filling.insert(m_filling.end(), data, data + size);
+	}
+
+	void StreamCompressor::ship(std::unique_lock<std::mutex>& lock)
+	{
+		m_space.wait(lock, [this] { return m_queue.size() < kQueued; });
+		m_queue.push_back(std::move(m_filling));
+		if (!m_free.empty())
+		{
+			m_filling = std::move(m_free.back());
+			m_free.pop_back();
+		}
+		else
+		{
+			m_filling = {};
+			m_filling.reserve(m_blockBytes);
+		}
+		m_ready.notify_one();
+	}
+
+	void StreamCompressor::close()
+	{
+		{
+			std::unique_lock lock(m_mutex);
+			if (m_closing)
+				return;
+			if (!m_filling.empty())
+				ship(lock);
+			m_closing = true;
+			m_ready.notify_one();
+		}
+		if (m_worker.joinable())
+			m_worker.join();
+	}
+
+	StreamCompressor::Stats StreamCompressor::stats() const
+	{
+		const std::lock_guard lock(m_mutex);
+		return m_stats;
+	}
+
+	void StreamCompressor::run()
+	{
+		std::vector<char> out;
+		out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+		out.push_back(static_cast<char>(m_codec));
+		out.push_back(static_cast<char>(kVersion));
+		out.push_back(0);
+		out.push_back(0);
+		bool ok = m_sink(out.data(), out.size());
+		std::uint64_t offset = out.size();
+		std::vector<std::uint64_t> blockOffsets;
+
+		std::unique_lock lock(m_mutex);
+		while (true)
+		{
+			m_ready.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+			if (m_queue.empty())
+				break;
+			std::vector<char> block = std::move(m_queue.front());
+			m_queue.erase(m_queue.begin());
+			m_space.notify_one();
+			lock.unlock();
+
+			const auto start = std::chrono::steady_clock::now();
+			out.assign(kBlockHeaderSize, 0);
+			compress_block(m_codec, block, out);
+			std::uint32_t stored = static_cast<std::uint32_t>(out.size() - kBlockHeaderSize);
+			if (stored >= block.size())
+			{
+				// Did not compress: keep it as is.
+				out.resize(kBlockHeaderSize);
+				out.insert(out.end(), block.begin(), block.end());
+				stored = static_cast<std::uint32_t>(block.size()) | kStoredRaw;
+			}
+			const auto compressNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			store_u32(out.data(), stored);
+			store_u32(out.data() + 4, static_cast<std::uint32_t>(block.size()));
+			ok = ok && m_sink(out.data(), out.size());
+			blockOffsets.push_back(offset);
+			offset += out.size();
+
+			lock.lock();
+			m_stats.blocks++;
+			m_stats.rawBytes += block.size();
+			m_stats.compressedBytes += out.size();
+			m_stats.compressNs += compressNs;
+			block.clear();
+			m_free.push_back(std::move(block));
+		}
+		lock.unlock();
+
+		out.clear();
+		put_u32(out, 0);
+		put_u32(out, 0);
+		const std::uint64_t indexOffset = offset + out.size();
+		put_u64(out, blockOffsets.size());
+		for (const std::uint64_t blockOffset : blockOffsets)
+			put_u64(out, blockOffset);
+		put_u64(out, indexOffset);
+		out.insert(out.end(), kIndexMagic, kIndexMagic + sizeof(kIndexMagic));
+		if (ok)
+			m_sink(out.data(), out.size());
+
+		lock.lock();
+		m_stats.compressedBytes = offset + out.size();
+	}
+}
@@ -0,0 +1,44 @@
+#include "../include/DebugRegisters.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace gwatch::dr
+{
+	std::uint64_t length_bits(const std::uint32_t size)
+	{
+		switch (size)
+		{
+			case 1:
+				return 0b00;
+			case 2:
+				return 0b01;
+			case 4:
+				return 0b11;
+			case 8:
+				return 0b10;
+			default:
+				throw std::invalid_argument("Unsupported hardware breakpoint size: " + std::to_string(size));
+		}
+	}
+
+	std::uint64_t encode_dr7(std::uint64_t current, const std::span<const Slot> slots)
+	{
+		if (slots.size() > kSlotCount)
+			throw std::invalid_argument("At most " + std::to_string(kSlotCount) + " hardware breakpoints are available.");
+
+		for (std::size_t i = 0; i < kSlotCount; ++i)
+		{
+			// Li (bit 2i), RWi (bits 16+4i..17+4i), LENi (bits 18+4i..19+4i)
+			current &= ~(1ull << (2 * i));
+			current &= ~(0xFull << (16 + 4 * i));
+		}
+		for (std::size_t i = 0; i < slots.size(); ++i)
+		{
+			current |= 1ull << (2 * i);
+			current |= static_cast<std::uint64_t>(slots[i].trigger) << (16 + 4 * i);
+			current |= length_bits(slots[i].size) << (18 + 4 * i);
+		}
+		return current;
+	}
+}
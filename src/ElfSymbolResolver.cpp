@@ -0,0 +1,1455 @@
+#ifdef __linux__
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <span>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include "SymbolResolver.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		std::string to_hex(const uint64_t v)
+		{
+			std::ostringstream oss;
+			oss << "0x" << std::hex << std::uppercase << v;
+			return oss.str();
+		}
+
+		template <typename T>
+		T load(const std::string_view bytes, const std::size_t offset)
+		{
+			T v{};
+			if (offset + sizeof(T) <= bytes.size())
+				std::memcpy(&v, bytes.data() + offset, sizeof(T));
+			return v;
+		}
+
+		std::string_view c_string_at(const std::string_view table, const std::size_t offset)
+		{
+			if (offset >= table.size())
+				return {};
+			const auto end = table.find('\0', offset);
+			return table.substr(offset, end == std::string_view::npos ? std::string_view::npos : end - offset);
+		}
+
+		int binding_rank(const Elf64_Sym& sym)
+		{
+			switch (ELF64_ST_BIND(sym.st_info))
+			{
+			case STB_GLOBAL: return 0;
+			case STB_WEAK: return 1;
+			default: return 2;
+			}
+		}
+
+		// Aliases share an address; the one kept must not depend on symbol-table order, so it is
+		// chosen by rule: global over weak over local, sized over unsized, then by name.
+		std::vector<Elf64_Sym> one_per_address(std::vector<Elf64_Sym> syms, const std::string_view strings)
+		{
+			const auto key = [strings](const Elf64_Sym& sym)
+			{
+				return std::tuple(sym.st_value, binding_rank(sym), sym.st_size == 0, c_string_at(strings, sym.st_name));
+			};
+			std::ranges::stable_sort(syms, [&key](const Elf64_Sym& a, const Elf64_Sym& b) { return key(a) < key(b); });
+			const auto [first, last] = std::ranges::unique(syms, {}, &Elf64_Sym::st_value);
+			syms.erase(first, last);
+			return syms;
+		}
+
+		// DWARF primitive encodings.
+		std::uint64_t uleb(const std::string_view d, std::size_t& p)
+		{
+			std::uint64_t result = 0;
+			unsigned shift = 0;
+			while (p < d.size())
+			{
+				const auto byte = static_cast<std::uint8_t>(d[p++]);
+				if (shift < 64)
+					result |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+				shift += 7;
+				if (!(byte & 0x80))
+					break;
+			}
+			return result;
+		}
+
+		std::int64_t sleb(const std::string_view d, std::size_t& p)
+		{
+			std::int64_t result = 0;
+			unsigned shift = 0;
+			std::uint8_t byte = 0;
+			while (p < d.size())
+			{
+				byte = static_cast<std::uint8_t>(d[p++]);
+				if (shift < 64)
+					result |= static_cast<std::int64_t>(byte & 0x7f) << shift;
+				shift += 7;
+				if (!(byte & 0x80))
+					break;
+			}
+			if (shift < 64 && (byte & 0x40))
+				result |= -(static_cast<std::int64_t>(1) << shift);
+			return result;
+		}
+
+		std::uint64_t fixed(const std::string_view d, std::size_t& p, const std::size_t n)
+		{
+			std::uint64_t v = 0;
+			if (p + n <= d.size())
+				std::memcpy(&v, d.data() + p, n);
+			p += n;
+			return v;
+		}
+
+		// Minimal DWARF (v2-v5, 32/64-bit) reader: just enough to map a variable's address to
+		// the byte size of its type. A lookup first asks the accelerator tables which compile
+		// units hold the variable (.debug_names by hash, .debug_pubnames / .debug_gnu_pubnames
+		// by name, .debug_aranges by address) and decodes only those; every unit is walked once
+		// only when none of them names it. Decoded units keep their header, abbreviation table
+		// (shared by offset) and located variables, which later lookups are served from.
+		class DwarfReader
+		{
+		public:
+			struct Sections
+			{
+				std::string_view info;
+				std::string_view abbrev;
+				std::string_view names;       // .debug_names
+				std::string_view pubnames;    // .debug_pubnames
+				std::string_view gnuPubnames; // .debug_gnu_pubnames (a flags byte after each offset)
+				std::string_view aranges;     // .debug_aranges
+				std::string_view str;         // .debug_str, for the .debug_names strings
+			};
+
+			explicit DwarfReader(const Sections& sections) : m_s(sections) {}
+
+			// names: what the variable may be indexed under (as written, unqualified, linkage name).
+			std::optional<std::uint64_t> type_size_of_variable_at(const std::uint64_t address, const std::span<const std::string_view> names)
+			{
+				return with_variable_type(address, names, [this](const Unit& unit, const std::uint64_t type)
+				{
+					return byte_size_of_type(unit, type);
+				});
+			}
+
+			// Byte size of one element when the variable is an array (innermost element for
+			// multi-dimensional ones).
+			std::optional<std::uint64_t> element_size_of_variable_at(const std::uint64_t address, const std::span<const std::string_view> names)
+			{
+				return with_variable_type(address, names, [this](const Unit& unit, const std::uint64_t type)
+				{
+					return element_size_of_type(unit, type);
+				});
+			}
+
+		private:
+			struct AttrSpec
+			{
+				std::uint64_t name = 0;
+				std::uint64_t form = 0;
+				std::int64_t implicitConst = 0;
+			};
+
+			struct Abbrev
+			{
+				std::uint64_t tag = 0;
+				bool hasChildren = false;
+				std::vector<AttrSpec> attrs;
+			};
+
+			using AbbrevTable = std::unordered_map<std::uint64_t, Abbrev>;
+
+			struct Unit
+			{
+				std::size_t start = 0;
+				std::size_t end = 0;
+				std::size_t firstDie = 0;
+				std::uint16_t version = 0;
+				std::uint8_t addressSize = 8;
+				std::uint8_t offsetSize = 4;
+				bool isCompile = false;
+				bool indexed = false; // its located variables are in m_variables
+				const AbbrevTable* abbrevs = nullptr; // owned by m_abbrevTables
+			};
+
+			// A DW_TAG_variable with a DW_OP_addr location, as found when its unit was indexed.
+			struct Variable
+			{
+				const Unit* unit = nullptr; // owned by m_units
+				std::optional<std::uint64_t> type;
+				std::optional<std::uint64_t> specification;
+			};
+
+			struct Die
+			{
+				std::uint64_t tag = 0;
+				std::optional<std::uint64_t> byteSize;
+				std::optional<std::uint64_t> type;          // absolute .debug_info offset
+				std::optional<std::uint64_t> specification; // absolute .debug_info offset
+				std::optional<std::uint64_t> location;      // DW_OP_addr operand
+			};
+
+			static constexpr std::uint64_t DW_TAG_array_type = 0x01;
+			static constexpr std::uint64_t DW_TAG_variable = 0x34;
+			static constexpr std::uint64_t DW_AT_location = 0x02;
+			static constexpr std::uint64_t DW_AT_byte_size = 0x0b;
+			static constexpr std::uint64_t DW_AT_specification = 0x47;
+			static constexpr std::uint64_t DW_AT_type = 0x49;
+			static constexpr std::uint8_t DW_OP_addr = 0x03;
+			static constexpr std::uint64_t DW_IDX_compile_unit = 1;
+
+			Sections m_s;
+			bool m_indexedAll = false;
+			bool m_headersRead = false;
+			std::map<std::size_t, Unit> m_units; // read so far, by .debug_info offset
+			std::unordered_map<std::uint64_t, AbbrevTable> m_abbrevTables;
+			std::unordered_map<std::uint64_t, std::vector<Variable>> m_variables;
+
+			bool read_unit_header(const std::size_t offset, Unit& unit)
+			{
+				std::size_t p = offset;
+				std::uint64_t length = fixed(m_s.info, p, 4);
+				if (length == 0xffffffff)
+				{
+					length = fixed(m_s.info, p, 8);
+					unit.offsetSize = 8;
+				}
+				unit.start = offset;
+				unit.end = p + length;
+				if (unit.end > m_s.info.size() || unit.end <= p)
+					return false;
+
+				unit.version = static_cast<std::uint16_t>(fixed(m_s.info, p, 2));
+				std::uint64_t abbrevOffset = 0;
+				if (unit.version >= 5)
+				{
+					const auto unitType = static_cast<std::uint8_t>(fixed(m_s.info, p, 1));
+					unit.addressSize = static_cast<std::uint8_t>(fixed(m_s.info, p, 1));
+					abbrevOffset = fixed(m_s.info, p, unit.offsetSize);
+					// DW_UT_compile / DW_UT_partial only; type and skeleton units never define our variables.
+					unit.isCompile = unitType == 0x01 || unitType == 0x03;
+				}
+				else
+				{
+					abbrevOffset = fixed(m_s.info, p, unit.offsetSize);
+					unit.addressSize = static_cast<std::uint8_t>(fixed(m_s.info, p, 1));
+					unit.isCompile = true;
+				}
+				unit.firstDie = p;
+				if (unit.isCompile)
+				{
+					auto [table, added] = m_abbrevTables.try_emplace(abbrevOffset);
+					if (added)
+						parse_abbrevs(abbrevOffset, table->second);
+					unit.abbrevs = &table->second;
+				}
+				return true;
+			}
+
+			void parse_abbrevs(std::size_t p, AbbrevTable& out) const
+			{
+				while (p < m_s.abbrev.size())
+				{
+					const std::uint64_t code = uleb(m_s.abbrev, p);
+					if (code == 0)
+						break;
+					Abbrev a;
+					a.tag = uleb(m_s.abbrev, p);
+					a.hasChildren = p < m_s.abbrev.size() && m_s.abbrev[p++] != 0;
+					while (p < m_s.abbrev.size())
+					{
+						AttrSpec spec;
+						spec.name = uleb(m_s.abbrev, p);
+						spec.form = uleb(m_s.abbrev, p);
+						if (spec.name == 0 && spec.form == 0)
+							break;
+						if (spec.form == 0x21) // DW_FORM_implicit_const
+							spec.implicitConst = sleb(m_s.abbrev, p);
+						a.attrs.push_back(spec);
+					}
+					out.emplace(code, std::move(a));
+				}
+			}
+
+			// Reads (or skips) one attribute value. Returns the integral value for constant,
+			// reference (made absolute) and address forms, the first byte offset for blocks.
+			std::uint64_t read_form(const Unit& unit, std::uint64_t form, const std::int64_t implicitConst, std::size_t& p, std::size_t* blockStart = nullptr, std::size_t* blockLen = nullptr) const
+			{
+				const std::string_view d = m_s.info;
+				const auto block = [&](const std::size_t len) -> std::uint64_t
+				{
+					if (blockStart)
+						*blockStart = p;
+					if (blockLen)
+						*blockLen = len;
+					p += len;
+					return 0;
+				};
+
+				switch (form)
+				{
+				case 0x01: return fixed(d, p, unit.addressSize);                  // addr
+				case 0x03: { const auto n = fixed(d, p, 2); return block(n); }    // block2
+				case 0x04: { const auto n = fixed(d, p, 4); return block(n); }    // block4
+				case 0x05: return fixed(d, p, 2);                                 // data2
+				case 0x06: return fixed(d, p, 4);                                 // data4
+				case 0x07: return fixed(d, p, 8);                                 // data8
+				case 0x08: { const auto e = d.find('\0', p); p = e == std::string_view::npos ? d.size() : e + 1; return 0; } // string
+				case 0x09: { const auto n = uleb(d, p); return block(n); }        // block
+				case 0x0a: { const auto n = fixed(d, p, 1); return block(n); }    // block1
+				case 0x0b: return fixed(d, p, 1);                                 // data1
+				case 0x0c: return fixed(d, p, 1);                                 // flag
+				case 0x0d: return static_cast<std::uint64_t>(sleb(d, p));         // sdata
+				case 0x0e: return fixed(d, p, unit.offsetSize);                   // strp
+				case 0x0f: return uleb(d, p);                                     // udata
+				case 0x10: return fixed(d, p, unit.version <= 2 ? unit.addressSize : unit.offsetSize); // ref_addr (absolute)
+				case 0x11: return unit.start + fixed(d, p, 1);                    // ref1
+				case 0x12: return unit.start + fixed(d, p, 2);                    // ref2
+				case 0x13: return unit.start + fixed(d, p, 4);                    // ref4
+				case 0x14: return unit.start + fixed(d, p, 8);                    // ref8
+				case 0x15: return unit.start + uleb(d, p);                        // ref_udata
+				case 0x16: { const auto f = uleb(d, p); return read_form(unit, f, implicitConst, p, blockStart, blockLen); } // indirect
+				case 0x17: return fixed(d, p, unit.offsetSize);                   // sec_offset
+				case 0x18: { const auto n = uleb(d, p); return block(n); }        // exprloc
+				case 0x19: return 1;                                              // flag_present
+				case 0x1a: return uleb(d, p);                                     // strx
+				case 0x1b: return uleb(d, p);                                     // addrx
+				case 0x1c: return fixed(d, p, 4);                                 // ref_sup4
+				case 0x1d: return fixed(d, p, unit.offsetSize);                   // strp_sup
+				case 0x1e: p += 16; return 0;                                     // data16
+				case 0x1f: return fixed(d, p, unit.offsetSize);                   // line_strp
+				case 0x20: return fixed(d, p, 8);                                 // ref_sig8
+				case 0x21: return static_cast<std::uint64_t>(implicitConst);      // implicit_const
+				case 0x22: return uleb(d, p);                                     // loclistx
+				case 0x23: return uleb(d, p);                                     // rnglistx
+				case 0x24: return fixed(d, p, 8);                                 // ref_sup8
+				case 0x25: case 0x29: return fixed(d, p, 1);                      // strx1 / addrx1
+				case 0x26: case 0x2a: return fixed(d, p, 2);                      // strx2 / addrx2
+				case 0x27: case 0x2b: return fixed(d, p, 3);                      // strx3 / addrx3
+				case 0x28: case 0x2c: return fixed(d, p, 4);                      // strx4 / addrx4
+				default:
+					// Unknown form: the rest of the unit cannot be decoded.
+					p = unit.end;
+					return 0;
+				}
+			}
+
+			// Decodes the DIE at p (advancing p past it). Returns nullptr for a null entry.
+			const Abbrev* read_die(const Unit& unit, std::size_t& p, Die& die) const
+			{
+				const std::uint64_t code = uleb(m_s.info, p);
+				if (code == 0)
+					return nullptr;
+				if (!unit.abbrevs)
+				{
+					p = unit.end;
+					return nullptr;
+				}
+				const auto it = unit.abbrevs->find(code);
+				if (it == unit.abbrevs->end())
+				{
+					p = unit.end;
+					return nullptr;
+				}
+
+				die = Die{};
+				die.tag = it->second.tag;
+				for (const auto& spec : it->second.attrs)
+				{
+					std::size_t blockStart = 0;
+					std::size_t blockLen = 0;
+					const std::uint64_t v = read_form(unit, spec.form, spec.implicitConst, p, &blockStart, &blockLen);
+					switch (spec.name)
+					{
+					case DW_AT_byte_size:
+						die.byteSize = v;
+						break;
+					case DW_AT_type:
+						die.type = v;
+						break;
+					case DW_AT_specification:
+						die.specification = v;
+						break;
+					case DW_AT_location:
+						if ((spec.form == 0x18 || spec.form == 0x0a || spec.form == 0x09) && blockLen == 1u + unit.addressSize
+							&& blockStart + blockLen <= m_s.info.size() && static_cast<std::uint8_t>(m_s.info[blockStart]) == DW_OP_addr)
+						{
+							std::size_t q = blockStart + 1;
+							die.location = fixed(m_s.info, q, unit.addressSize);
+						}
+						break;
+					default:
+						break;
+					}
+				}
+				return &it->second;
+			}
+
+			// Applies query to the type of the variable at address, in the first unit where it answers.
+			template <typename Query>
+			std::optional<std::uint64_t> with_variable_type(const std::uint64_t address, const std::span<const std::string_view> names, const Query& query)
+			{
+				const std::vector<Variable>* variables = variables_at(address, names);
+				if (!variables)
+					return std::nullopt;
+				for (const auto& variable : *variables)
+				{
+					const Unit& unit = *variable.unit;
+					auto type = variable.type;
+					if (!type && variable.specification)
+					{
+						Die decl;
+						if (die_at(unit, *variable.specification, decl))
+							type = decl.type;
+					}
+					if (type)
+					{
+						if (const auto result = query(unit, *type))
+							return result;
+					}
+				}
+				return std::nullopt;
+			}
+
+			// Variables located at address: first in the units the accelerator tables name, then,
+			// when none of them has it, in every unit.
+			const std::vector<Variable>* variables_at(const std::uint64_t address, const std::span<const std::string_view> names)
+			{
+				if (const auto it = m_variables.find(address); it != m_variables.end())
+					return &it->second;
+				if (m_indexedAll)
+					return nullptr;
+
+				std::vector<std::size_t> units;
+				for (const auto name : names)
+				{
+					if (name.empty())
+						continue;
+					name_index_units(name, units);
+					pubnames_units(m_s.pubnames, false, name, units);
+					pubnames_units(m_s.gnuPubnames, true, name, units);
+				}
+				aranges_units(address, units);
+				for (const std::size_t offset : units)
+					index_unit(offset);
+				if (const auto it = m_variables.find(address); it != m_variables.end())
+					return &it->second;
+
+				index_all();
+				const auto it = m_variables.find(address);
+				return it == m_variables.end() ? nullptr : &it->second;
+			}
+
+			// Header of the unit starting at offset, read on first use (nullptr past the end).
+			Unit* unit_at(const std::size_t offset)
+			{
+				if (const auto it = m_units.find(offset); it != m_units.end())
+					return &it->second;
+				Unit unit{};
+				if (offset + 4 > m_s.info.size() || !read_unit_header(offset, unit))
+					return nullptr;
+				return &m_units.emplace(offset, unit).first->second;
+			}
+
+			// Adds the located variables of one compile unit to m_variables.
+			void index_unit(const std::size_t offset)
+			{
+				Unit* unit = unit_at(offset);
+				if (!unit || unit->indexed || !unit->isCompile)
+					return;
+				unit->indexed = true;
+				std::size_t p = unit->firstDie;
+				while (p < unit->end)
+				{
+					Die die;
+					if (!read_die(*unit, p, die))
+						continue;
+					if (die.tag == DW_TAG_variable && die.location)
+					{
+						m_variables[*die.location].push_back(Variable{.unit = unit, .type = die.type, .specification = die.specification});
+					}
+				}
+			}
+
+			// Walks every unit header, indexing the compile units when index is set.
+			void read_all_units(const bool index)
+			{
+				std::size_t offset = 0;
+				while (const Unit* unit = unit_at(offset))
+				{
+					if (index)
+						index_unit(offset);
+					offset = unit->end;
+				}
+				m_headersRead = true;
+			}
+
+			void index_all()
+			{
+				read_all_units(true);
+				m_indexedAll = true;
+			}
+
+			// .debug_names (DWARF 5): appends the units of the variables indexed under name. Each
+			// index is searched through its hash table, or its name table when it has none.
+			void name_index_units(const std::string_view name, std::vector<std::size_t>& units) const
+			{
+				const std::string_view d = m_s.names;
+				std::uint32_t hash = 5381; // DJB over the case-folded name
+				for (const char c : name)
+					hash = hash * 33 + static_cast<std::uint8_t>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+
+				std::size_t offset = 0;
+				while (offset + 4 <= d.size())
+				{
+					std::size_t p = offset;
+					std::uint8_t offsetSize = 4;
+					std::uint64_t length = fixed(d, p, 4);
+					if (length == 0xffffffff)
+					{
+						length = fixed(d, p, 8);
+						offsetSize = 8;
+					}
+					if (length == 0 || length > d.size() - std::min(p, d.size()))
+						return;
+					const std::size_t end = p + length;
+					offset = end;
+
+					const auto version = fixed(d, p, 2);
+					p += 2; // padding
+					const std::uint64_t cuCount = fixed(d, p, 4);
+					const std::uint64_t localTuCount = fixed(d, p, 4);
+					const std::uint64_t foreignTuCount = fixed(d, p, 4);
+					const std::uint64_t bucketCount = fixed(d, p, 4);
+					const std::uint64_t nameCount = fixed(d, p, 4);
+					const std::uint64_t abbrevSize = fixed(d, p, 4);
+					p += fixed(d, p, 4); // augmentation string, padded to 4 bytes
+					if (version != 5)
+						continue;
+					const std::size_t cus = p;
+					p += (cuCount + localTuCount) * offsetSize + foreignTuCount * 8;
+					const std::size_t buckets = p;
+					p += bucketCount * 4;
+					const std::size_t hashes = p;
+					if (bucketCount > 0)
+						p += nameCount * 4;
+					const std::size_t strings = p;
+					p += nameCount * offsetSize;
+					const std::size_t entries = p;
+					p += nameCount * offsetSize;
+					const std::size_t abbrevs = p;
+					const std::size_t pool = p + abbrevSize;
+					if (pool > end)
+						continue;
+
+					const auto at = [d](std::size_t q, const std::size_t n) { return fixed(d, q, n); };
+					const auto matches = [&](const std::uint64_t i)
+					{
+						return c_string_at(m_s.str, at(strings + (i - 1) * offsetSize, offsetSize)) == name;
+					};
+					const auto add_units = [&](const std::uint64_t i)
+					{
+						const std::size_t q = pool + at(entries + (i - 1) * offsetSize, offsetSize);
+						for (const std::uint64_t cu : name_entry_units(d, q, end, abbrevs, pool, cuCount))
+							units.push_back(at(cus + cu * offsetSize, offsetSize));
+					};
+					if (bucketCount == 0)
+					{
+						for (std::uint64_t i = 1; i <= nameCount; ++i)
+						{
+							if (matches(i))
+								add_units(i);
+						}
+						continue;
+					}
+					// Names of a bucket are consecutive, from the (1-based) index it holds.
+					const std::uint64_t bucket = hash % bucketCount;
+					for (std::uint64_t i = at(buckets + bucket * 4, 4); i != 0 && i <= nameCount; ++i)
+					{
+						const auto h = static_cast<std::uint32_t>(at(hashes + (i - 1) * 4, 4));
+						if (h % bucketCount != bucket)
+							break;
+						if (h == hash && matches(i))
+							add_units(i);
+					}
+				}
+			}
+
+			// Compile unit indices of the DW_TAG_variable entries in the series at p.
+			static std::vector<std::uint64_t> name_entry_units(const std::string_view d, std::size_t p, const std::size_t end, const std::size_t abbrevs, const std::size_t abbrevsEnd, const std::uint64_t cuCount)
+			{
+				std::vector<std::uint64_t> out;
+				while (p < end)
+				{
+					const std::uint64_t code = uleb(d, p);
+					if (code == 0)
+						break;
+					// Abbreviations: code, tag, then (index, form) pairs up to (0, 0).
+					std::size_t a = abbrevs;
+					std::uint64_t tag = 0;
+					bool found = false;
+					while (a < abbrevsEnd && !found)
+					{
+						const std::uint64_t c = uleb(d, a);
+						if (c == 0)
+							return out;
+						tag = uleb(d, a);
+						found = c == code;
+						for (std::uint64_t index = 1, form = 1; !found && (index != 0 || form != 0) && a < abbrevsEnd;)
+						{
+							index = uleb(d, a);
+							form = uleb(d, a);
+						}
+					}
+					if (!found)
+						return out;
+
+					std::optional<std::uint64_t> cu;
+					while (a < abbrevsEnd)
+					{
+						const std::uint64_t index = uleb(d, a);
+						const std::uint64_t form = uleb(d, a);
+						if (index == 0 && form == 0)
+							break;
+						std::uint64_t value = 0;
+						switch (form)
+						{
+						case 0x0b: case 0x11: value = fixed(d, p, 1); break; // data1 / ref1
+						case 0x05: case 0x12: value = fixed(d, p, 2); break; // data2 / ref2
+						case 0x06: case 0x13: value = fixed(d, p, 4); break; // data4 / ref4
+						case 0x07: case 0x14: case 0x20: value = fixed(d, p, 8); break; // data8 / ref8 / ref_sig8
+						case 0x0f: case 0x15: value = uleb(d, p); break;     // udata / ref_udata
+						case 0x0d: value = static_cast<std::uint64_t>(sleb(d, p)); break; // sdata
+						case 0x19: break;                                    // flag_present
+						case 0x1e: p += 16; break;                           // data16
+						default: return out; // the rest of the series cannot be decoded
+						}
+						if (index == DW_IDX_compile_unit)
+							cu = value;
+					}
+					// A single-unit index may leave the unit implicit.
+					if (!cu && cuCount == 1)
+						cu = 0;
+					if (tag == DW_TAG_variable && cu && *cu < cuCount)
+						out.push_back(*cu);
+				}
+				return out;
+			}
+
+			// .debug_pubnames / .debug_gnu_pubnames: appends the units that list name.
+			static void pubnames_units(const std::string_view d, const bool gnu, const std::string_view name, std::vector<std::size_t>& units)
+			{
+				std::size_t offset = 0;
+				while (offset + 4 <= d.size())
+				{
+					std::size_t p = offset;
+					std::uint8_t offsetSize = 4;
+					std::uint64_t length = fixed(d, p, 4);
+					if (length == 0xffffffff)
+					{
+						length = fixed(d, p, 8);
+						offsetSize = 8;
+					}
+					if (length == 0 || length > d.size() - std::min(p, d.size()))
+						return;
+					const std::size_t end = p + length;
+					offset = end;
+
+					p += 2; // version
+					const std::uint64_t unit = fixed(d, p, offsetSize);
+					p += offsetSize; // unit length
+					while (p < end)
+					{
+						if (fixed(d, p, offsetSize) == 0)
+							break;
+						if (gnu)
+							p += 1;
+						const std::string_view entry = c_string_at(d, p);
+						p += entry.size() + 1;
+						if (entry == name)
+						{
+							units.push_back(unit);
+							break;
+						}
+					}
+				}
+			}
+
+			// .debug_aranges: appends the unit whose address ranges hold address (producers that
+			// only list code leave variables to the name indexes).
+			void aranges_units(const std::uint64_t address, std::vector<std::size_t>& units) const
+			{
+				const std::string_view d = m_s.aranges;
+				std::size_t offset = 0;
+				while (offset + 4 <= d.size())
+				{
+					const std::size_t start = offset;
+					std::size_t p = offset;
+					std::uint8_t offsetSize = 4;
+					std::uint64_t length = fixed(d, p, 4);
+					if (length == 0xffffffff)
+					{
+						length = fixed(d, p, 8);
+						offsetSize = 8;
+					}
+					if (length == 0 || length > d.size() - std::min(p, d.size()))
+						return;
+					const std::size_t end = p + length;
+					offset = end;
+
+					p += 2; // version
+					const std::uint64_t unit = fixed(d, p, offsetSize);
+					const auto addressSize = static_cast<std::size_t>(fixed(d, p, 1));
+					const auto segmentSize = fixed(d, p, 1);
+					if (addressSize == 0 || addressSize > 8 || segmentSize != 0)
+						continue;
+					// Tuples are aligned on their own size from the start of the set.
+					const std::size_t tuple = 2 * addressSize;
+					p = start + (p - start + tuple - 1) / tuple * tuple;
+					while (p + tuple <= end)
+					{
+						const std::uint64_t begin = fixed(d, p, addressSize);
+						const std::uint64_t size = fixed(d, p, addressSize);
+						if (begin == 0 && size == 0)
+							break;
+						if (address >= begin && address - begin < size)
+						{
+							units.push_back(unit);
+							break;
+						}
+					}
+				}
+			}
+
+			bool die_at(const Unit& current, const std::uint64_t offset, Die& die)
+			{
+				if (offset >= current.firstDie && offset < current.end)
+				{
+					std::size_t p = offset;
+					return read_die(current, p, die) != nullptr;
+				}
+
+				// References may cross units (DW_FORM_ref_addr): locate the owning unit, reading
+				// every unit header the first time one is not known yet.
+				const Unit* unit = unit_containing(offset);
+				if (!unit && !m_headersRead)
+				{
+					read_all_units(false);
+					unit = unit_containing(offset);
+				}
+				if (!unit || !unit->isCompile || offset < unit->firstDie)
+					return false;
+				std::size_t p = offset;
+				return read_die(*unit, p, die) != nullptr;
+			}
+
+			const Unit* unit_containing(const std::uint64_t offset) const
+			{
+				const auto next = m_units.upper_bound(offset);
+				if (next == m_units.begin())
+					return nullptr;
+				const Unit& unit = std::prev(next)->second;
+				return offset < unit.end ? &unit : nullptr;
+			}
+
+			std::optional<std::uint64_t> byte_size_of_type(const Unit& unit, std::uint64_t offset)
+			{
+				// Follow typedef / const / volatile / restrict / atomic chains to a sized type.
+				for (int depth = 0; depth < 16; ++depth)
+				{
+					Die die;
+					if (!die_at(unit, offset, die))
+						return std::nullopt;
+					if (die.byteSize)
+						return die.byteSize;
+					if (!die.type)
+						return std::nullopt;
+					offset = *die.type;
+				}
+				return std::nullopt;
+			}
+
+			std::optional<std::uint64_t> element_size_of_type(const Unit& unit, std::uint64_t offset)
+			{
+				// Same chains as above, down to the array type.
+				for (int depth = 0; depth < 16; ++depth)
+				{
+					Die die;
+					if (!die_at(unit, offset, die) || !die.type)
+						return std::nullopt;
+					if (die.tag == DW_TAG_array_type)
+						return byte_size_of_type(unit, *die.type);
+					if (die.byteSize)
+						return std::nullopt;
+					offset = *die.type;
+				}
+				return std::nullopt;
+			}
+		};
+
+		// DWARF (v2-v5, 32/64-bit) line number programs: the rows of every unit, at link-time
+		// addresses. Only the address -> file:line mapping is kept (no column, no view).
+		class LineProgramReader
+		{
+		public:
+			struct Sections
+			{
+				std::string_view line;
+				std::string_view lineStr; // DW_FORM_line_strp targets (DWARF 5)
+				std::string_view str;     // DW_FORM_strp targets
+			};
+
+			explicit LineProgramReader(const Sections& sections) : m_s(sections) {}
+
+			// Appends the rows of every unit to out; file names are shared between units.
+			void read_all(LineTable& out) const
+			{
+				std::unordered_map<std::string_view, std::uint32_t> fileIndex;
+				std::size_t offset = 0;
+				while (offset < m_s.line.size())
+				{
+					const std::size_t next = read_unit(offset, out, fileIndex);
+					if (next <= offset)
+						break;
+					offset = next;
+				}
+			}
+
+		private:
+			static constexpr std::uint8_t DW_LNS_copy = 0x01;
+			static constexpr std::uint8_t DW_LNS_advance_pc = 0x02;
+			static constexpr std::uint8_t DW_LNS_advance_line = 0x03;
+			static constexpr std::uint8_t DW_LNS_set_file = 0x04;
+			static constexpr std::uint8_t DW_LNS_const_add_pc = 0x08;
+			static constexpr std::uint8_t DW_LNS_fixed_advance_pc = 0x09;
+			static constexpr std::uint8_t DW_LNE_end_sequence = 0x01;
+			static constexpr std::uint8_t DW_LNE_set_address = 0x02;
+			static constexpr std::uint64_t DW_LNCT_path = 0x01;
+
+			Sections m_s;
+
+			// Reads one unit starting at offset, returns the offset of the next one (0: stop).
+			std::size_t read_unit(const std::size_t offset, LineTable& out, std::unordered_map<std::string_view, std::uint32_t>& fileIndex) const
+			{
+				const std::string_view d = m_s.line;
+				std::size_t p = offset;
+				std::uint8_t offsetSize = 4;
+				std::uint64_t length = fixed(d, p, 4);
+				if (length == 0xffffffff)
+				{
+					length = fixed(d, p, 8);
+					offsetSize = 8;
+				}
+				if (length == 0 || length > d.size() - std::min(p, d.size()))
+					return 0;
+				const std::size_t end = p + length;
+
+				const auto version = static_cast<std::uint16_t>(fixed(d, p, 2));
+				if (version < 2 || version > 5)
+					return end;
+				std::uint8_t addressSize = 8;
+				if (version >= 5)
+				{
+					addressSize = static_cast<std::uint8_t>(fixed(d, p, 1));
+					p += 1; // segment_selector_size
+				}
+				const std::uint64_t headerLength = fixed(d, p, offsetSize);
+				if (headerLength > end - std::min(p, end))
+					return end;
+				const std::size_t program = p + headerLength;
+
+				const auto minInstLength = fixed(d, p, 1);
+				if (version >= 4)
+					p += 1; // maximum_operations_per_instruction, VLIW only
+				p += 1;     // default_is_stmt
+				const auto lineBase = static_cast<std::int8_t>(fixed(d, p, 1));
+				const auto lineRange = fixed(d, p, 1);
+				const auto opcodeBase = static_cast<std::uint8_t>(fixed(d, p, 1));
+				std::vector<std::uint8_t> argCounts(opcodeBase, 0);
+				for (std::uint8_t op = 1; op < opcodeBase; ++op)
+					argCounts[op] = static_cast<std::uint8_t>(fixed(d, p, 1));
+				if (lineRange == 0)
+					return end;
+
+				// File numbers of the unit -> indices in out.files (DWARF 5 numbers from 0, older from 1).
+				const auto intern = [&](const std::string_view path)
+				{
+					const std::string_view base = path.substr(path.rfind('/') + 1);
+					const auto [it, inserted] = fileIndex.emplace(base, static_cast<std::uint32_t>(out.files.size()));
+					if (inserted)
+						out.files.emplace_back(base);
+					return it->second;
+				};
+				std::vector<std::uint32_t> files;
+				if (version >= 5)
+				{
+					std::vector<std::string_view> directories;
+					std::vector<std::string_view> paths;
+					if (!read_entries(p, program, offsetSize, directories) || !read_entries(p, program, offsetSize, paths))
+						return end;
+					for (const auto path : paths)
+						files.push_back(intern(path));
+				}
+				else
+				{
+					while (p < program && d[p] != '\0') // include_directories
+						p = std::min(d.find('\0', p), program) + 1;
+					++p;
+					files.push_back(intern("?"));
+					while (p < program && d[p] != '\0')
+					{
+						const std::string_view name = c_string_at(d, p);
+						p += name.size() + 1;
+						uleb(d, p); // directory
+						uleb(d, p); // modification time
+						uleb(d, p); // length
+						files.push_back(intern(name));
+					}
+				}
+				const auto fileAt = [&](const std::uint64_t file) { return file < files.size() ? files[file] : intern("?"); };
+
+				std::vector<LineTable::Row> sequence;
+				std::uint64_t address = 0;
+				std::uint64_t file = 1;
+				std::int64_t line = 1;
+				const auto emit = [&]
+				{
+					sequence.push_back({.address = address, .line = static_cast<std::uint32_t>(std::max<std::int64_t>(line, 0)), .file = fileAt(file)});
+				};
+
+				p = program;
+				while (p < end)
+				{
+					const auto op = static_cast<std::uint8_t>(d[p++]);
+					if (op >= opcodeBase)
+					{
+						const auto adjusted = static_cast<std::uint8_t>(op - opcodeBase);
+						address += adjusted / lineRange * minInstLength;
+						line += lineBase + adjusted % lineRange;
+						emit();
+						continue;
+					}
+					switch (op)
+					{
+					case 0x00:
+					{
+						const std::uint64_t size = uleb(d, p);
+						const std::size_t next = p + size;
+						if (size == 0 || next > end)
+							return end;
+						const auto sub = static_cast<std::uint8_t>(d[p++]);
+						if (sub == DW_LNE_end_sequence)
+						{
+							sequence.push_back({.address = address, .line = 0, .file = 0});
+							// Sequences of functions discarded by the linker are left at address 0.
+							if (sequence.front().address != 0)
+								out.rows.insert(out.rows.end(), sequence.begin(), sequence.end());
+							sequence.clear();
+							address = 0;
+							file = 1;
+							line = 1;
+						}
+						else if (sub == DW_LNE_set_address)
+							address = fixed(d, p, addressSize);
+						p = next;
+						break;
+					}
+					case DW_LNS_copy:
+						emit();
+						break;
+					case DW_LNS_advance_pc:
+						address += uleb(d, p) * minInstLength;
+						break;
+					case DW_LNS_advance_line:
+						line += sleb(d, p);
+						break;
+					case DW_LNS_set_file:
+						file = uleb(d, p);
+						break;
+					case DW_LNS_const_add_pc:
+						address += (255 - opcodeBase) / lineRange * minInstLength;
+						break;
+					case DW_LNS_fixed_advance_pc:
+						address += fixed(d, p, 2);
+						break;
+					default:
+						// set_column, negate_stmt, set_basic_block, ... and opcodes of later versions.
+						for (std::uint8_t i = 0; i < argCounts[op]; ++i)
+							uleb(d, p);
+						break;
+					}
+				}
+				return end;
+			}
+
+			// DWARF 5 directory or file table: entry formats, then entries. Appends the
+			// DW_LNCT_path of each entry to paths; false on a form no producer uses there.
+			bool read_entries(std::size_t& p, const std::size_t end, const std::uint8_t offsetSize, std::vector<std::string_view>& paths) const
+			{
+				const std::string_view d = m_s.line;
+				const auto formatCount = fixed(d, p, 1);
+				std::vector<std::pair<std::uint64_t, std::uint64_t>> formats; // (content type, form)
+				for (std::uint64_t i = 0; i < formatCount && p < end; ++i)
+				{
+					const std::uint64_t type = uleb(d, p);
+					formats.emplace_back(type, uleb(d, p));
+				}
+				const std::uint64_t count = uleb(d, p);
+				for (std::uint64_t i = 0; i < count && p < end; ++i)
+				{
+					std::string_view path = "?";
+					for (const auto& [type, form] : formats)
+					{
+						std::string_view text;
+						switch (form)
+						{
+						case 0x08: text = c_string_at(d, p); p += text.size() + 1; break; // string
+						case 0x1f: text = c_string_at(m_s.lineStr, fixed(d, p, offsetSize)); break; // line_strp
+						case 0x0e: text = c_string_at(m_s.str, fixed(d, p, offsetSize)); break; // strp
+						case 0x0f: uleb(d, p); break;                                     // udata
+						case 0x0b: p += 1; break;                                         // data1
+						case 0x05: p += 2; break;                                         // data2
+						case 0x06: p += 4; break;                                         // data4
+						case 0x07: p += 8; break;                                         // data8
+						case 0x1e: p += 16; break;                                        // data16 (MD5)
+						case 0x09: { const auto n = uleb(d, p); p += n; break; }          // block
+						case 0x25: p += 1; break;                                         // strx1 (no .debug_str_offsets here)
+						case 0x26: p += 2; break;                                         // strx2
+						case 0x27: p += 3; break;                                         // strx3
+						case 0x28: p += 4; break;                                         // strx4
+						case 0x1a: uleb(d, p); break;                                     // strx
+						default: return false;
+						}
+						if (type == DW_LNCT_path && !text.empty())
+							path = text;
+					}
+					paths.push_back(path);
+				}
+				return p <= end;
+			}
+		};
+	}
+
+	ElfSymbolResolver::ElfSymbolResolver(const std::string& imagePath, const std::uint64_t loadBase, const bool anySize) :
+		m_imagePath(imagePath),
+		m_imageStem(std::filesystem::path(imagePath).stem().string()),
+		m_loadBase(loadBase),
+		m_anySize(anySize)
+	{
+		const int fd = open(imagePath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			throw SymbolError("ElfSymbolResolver: cannot open '" + imagePath + "': " + std::strerror(errno));
+		}
+		struct stat st{};
+		if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Elf64_Ehdr)))
+		{
+			close(fd);
+			throw SymbolError("ElfSymbolResolver: '" + imagePath + "' is not an ELF image.");
+		}
+
+		m_mapSize = static_cast<std::size_t>(st.st_size);
+		m_map = mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (m_map == MAP_FAILED)
+		{
+			m_map = nullptr;
+			throw SymbolError("ElfSymbolResolver: mmap failed for '" + imagePath + "': " + std::strerror(errno));
+		}
+		m_image = std::string_view(static_cast<const char*>(m_map), m_mapSize);
+
+		try
+		{
+			map_sections();
+		}
+		catch (...)
+		{
+			munmap(m_map, m_mapSize);
+			m_map = nullptr;
+			throw;
+		}
+	}
+
+	ElfSymbolResolver::~ElfSymbolResolver()
+	{
+		if (m_map)
+			munmap(m_map, m_mapSize);
+	}
+
+	void ElfSymbolResolver::map_sections()
+	{
+		const auto ehdr = load<Elf64_Ehdr>(m_image, 0);
+		if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS64)
+		{
+			throw SymbolError("ElfSymbolResolver: '" + m_imagePath + "' is not a 64-bit ELF image.");
+		}
+
+		// Position-independent images are relocated by the difference between the
+		// runtime base and the lowest PT_LOAD virtual address.
+		if (ehdr.e_type == ET_DYN && m_loadBase != 0)
+		{
+			std::uint64_t lowest = ~0ull;
+			for (std::uint16_t i = 0; i < ehdr.e_phnum; ++i)
+			{
+				const auto ph = load<Elf64_Phdr>(m_image, ehdr.e_phoff + static_cast<std::size_t>(i) * ehdr.e_phentsize);
+				if (ph.p_type == PT_LOAD)
+					lowest = std::min<std::uint64_t>(lowest, ph.p_vaddr & ~0xfffull);
+			}
+			m_loadBias = m_loadBase - (lowest == ~0ull ? 0 : lowest);
+		}
+
+		const auto section = [&](const std::uint16_t index) -> Elf64_Shdr
+		{
+			return load<Elf64_Shdr>(m_image, ehdr.e_shoff + static_cast<std::size_t>(index) * ehdr.e_shentsize);
+		};
+		const auto bytes = [&](const Elf64_Shdr& sh) -> std::string_view
+		{
+			if (sh.sh_type == SHT_NOBITS || sh.sh_offset + sh.sh_size > m_image.size())
+				return {};
+			return m_image.substr(sh.sh_offset, sh.sh_size);
+		};
+
+		if (ehdr.e_shoff == 0 || ehdr.e_shstrndx >= ehdr.e_shnum)
+			return;
+		const std::string_view names = bytes(section(ehdr.e_shstrndx));
+
+		for (std::uint16_t i = 0; i < ehdr.e_shnum; ++i)
+		{
+			const Elf64_Shdr sh = section(i);
+			const std::string_view name = c_string_at(names, sh.sh_name);
+			if ((sh.sh_flags & SHF_ALLOC) && sh.sh_size > 0 && !name.empty())
+				m_sections.push_back(AllocSection{.name = name, .address = sh.sh_addr, .size = sh.sh_size});
+
+			if (sh.sh_type == SHT_SYMTAB || sh.sh_type == SHT_DYNSYM)
+			{
+				SymbolTable& table = sh.sh_type == SHT_SYMTAB ? m_symtab : m_dynsym;
+				table.symbols = bytes(sh);
+				if (sh.sh_link < ehdr.e_shnum)
+					table.strings = bytes(section(static_cast<std::uint16_t>(sh.sh_link)));
+			}
+			else if (sh.sh_type == SHT_GNU_HASH)
+				m_gnuHash = bytes(sh);
+			else if (name == ".debug_info")
+				m_debugInfo = bytes(sh);
+			else if (name == ".debug_abbrev")
+				m_debugAbbrev = bytes(sh);
+			else if (name == ".debug_names")
+				m_debugNames = bytes(sh);
+			else if (name == ".debug_pubnames")
+				m_debugPubnames = bytes(sh);
+			else if (name == ".debug_gnu_pubnames")
+				m_debugGnuPubnames = bytes(sh);
+			else if (name == ".debug_aranges")
+				m_debugAranges = bytes(sh);
+			else if (name == ".debug_line")
+				m_debugLine = bytes(sh);
+			else if (name == ".debug_line_str")
+				m_debugLineStr = bytes(sh);
+			else if (name == ".debug_str")
+				m_debugStr = bytes(sh);
+		}
+	}
+
+	ResolvedSymbol ElfSymbolResolver::resolve(const std::string_view symbol)
+	{
+		std::string_view name = symbol;
+		if (const auto bang = name.find('!'); bang != std::string_view::npos)
+		{
+			if (name.substr(0, bang) != m_imageStem)
+			{
+				throw SymbolError("Module \"" + std::string(name.substr(0, bang)) + "\" does not match image \"" + m_imageStem + "\".");
+			}
+			name = name.substr(bang + 1);
+		}
+
+		if (m_anySize && name.starts_with('.'))
+		{
+			const auto it = std::ranges::find(m_sections, name, &AllocSection::name);
+			if (it == m_sections.end())
+			{
+				throw SymbolError("Section \"" + std::string(name) + "\" not found in '" + m_imagePath + "'.");
+			}
+			return ResolvedSymbol{.name = std::string(name), .module = to_hex(m_loadBase), .address = it->address + m_loadBias, .size = it->size};
+		}
+
+		// C++ qualified names are looked up through their Itanium mangling.
+		const std::string mangled = name.find("::") != std::string_view::npos ? mangle_qualified(name) : std::string{};
+		const std::string_view lookup = mangled.empty() ? name : std::string_view(mangled);
+
+		std::optional<SymbolEntry> entry = find_gnu_hash(lookup);
+		if (!entry)
+			entry = find_symtab(lookup);
+		if (!entry)
+		{
+			throw SymbolError("Symbol \"" + std::string(symbol) + "\" not found in '" + m_imagePath + "'.");
+		}
+
+		// What DWARF may index the variable under: as written, unqualified, and its linkage name.
+		const auto scope = name.rfind("::");
+		const std::array<std::string_view, 3> dwarfNames = {name, scope == std::string_view::npos ? std::string_view{} : name.substr(scope + 2), entry->name};
+
+		std::uint64_t size = entry->size;
+		if (size == 0)
+		{
+			const auto dwarfSize = dwarf_type_size(entry->value, dwarfNames);
+			if (!dwarfSize)
+			{
+				throw SymbolError("Size of \"" + std::string(symbol) + "\" is unknown (no st_size and no DWARF type information).");
+			}
+			size = *dwarfSize;
+		}
+
+		ResolvedSymbol out
+			{
+				.name = std::string(name),
+				.module = to_hex(m_loadBase),
+				.address = entry->value + m_loadBias,
+				.size = size
+			};
+
+		if (m_anySize)
+		{
+			if (out.size > 8)
+				out.element = dwarf_element_size(entry->value, dwarfNames);
+			return out;
+		}
+		if (out.size < 4 || out.size > 8)
+		{
+			std::ostringstream oss;
+			oss << "The symbol \"" << out.name << "\" has a size of " << out.size
+				<< " bytes (outside the range [4..8]).";
+			throw SymbolError(oss.str());
+		}
+
+		return out;
+	}
+
+	std::vector<ResolvedSymbol> ElfSymbolResolver::objects_in(const std::uint64_t address, const std::uint64_t size) const
+	{
+		const SymbolTable& table = m_symtab.symbols.empty() ? m_dynsym : m_symtab;
+		const auto count = static_cast<std::uint32_t>(table.symbols.size() / sizeof(Elf64_Sym));
+		std::vector<Elf64_Sym> inside;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const auto sym = load<Elf64_Sym>(table.symbols, static_cast<std::size_t>(i) * sizeof(Elf64_Sym));
+			if (ELF64_ST_TYPE(sym.st_info) != STT_OBJECT || sym.st_shndx == SHN_UNDEF || sym.st_size == 0)
+				continue;
+			const std::uint64_t runtime = sym.st_value + m_loadBias;
+			if (runtime + sym.st_size <= address || runtime >= address + size)
+				continue;
+			inside.push_back(sym);
+		}
+
+		std::vector<ResolvedSymbol> out;
+		for (const auto& sym : one_per_address(std::move(inside), table.strings))
+		{
+			out.push_back(ResolvedSymbol{
+				.name = std::string(c_string_at(table.strings, sym.st_name)),
+				.module = to_hex(m_loadBase),
+				.address = sym.st_value + m_loadBias,
+				.size = sym.st_size,
+			});
+		}
+		return out;
+	}
+
+	std::vector<CodeSymbol> ElfSymbolResolver::functions() const
+	{
+		const SymbolTable& table = m_symtab.symbols.empty() ? m_dynsym : m_symtab;
+		const auto count = static_cast<std::uint32_t>(table.symbols.size() / sizeof(Elf64_Sym));
+		std::vector<Elf64_Sym> code;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const auto sym = load<Elf64_Sym>(table.symbols, static_cast<std::size_t>(i) * sizeof(Elf64_Sym));
+			if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_shndx == SHN_UNDEF || sym.st_size == 0)
+				continue;
+			code.push_back(sym);
+		}
+
+		std::vector<CodeSymbol> out;
+		for (const auto& sym : one_per_address(std::move(code), table.strings))
+		{
+			out.push_back(CodeSymbol{
+				.address = sym.st_value + m_loadBias,
+				.size = sym.st_size,
+				.name = std::string(c_string_at(table.strings, sym.st_name)),
+			});
+		}
+		return out;
+	}
+
+	LineTable ElfSymbolResolver::line_table() const
+	{
+		LineTable out;
+		if (m_debugLine.empty())
+			return out;
+		LineProgramReader({.line = m_debugLine, .lineStr = m_debugLineStr, .str = m_debugStr}).read_all(out);
+		for (auto& row : out.rows)
+			row.address += m_loadBias;
+		// Where a sequence ends at the address the next one starts, the start must win.
+		std::ranges::stable_sort(out.rows, [](const LineTable::Row& a, const LineTable::Row& b)
+		{
+			return a.address != b.address ? a.address < b.address : a.line == 0 && b.line != 0;
+		});
+		return out;
+	}
+
+	ElfSymbolResolver::SymbolEntry ElfSymbolResolver::entry_at(const SymbolTable& table, const std::uint32_t index)
+	{
+		const auto sym = load<Elf64_Sym>(table.symbols, static_cast<std::size_t>(index) * sizeof(Elf64_Sym));
+		return SymbolEntry{
+			.value = sym.st_value,
+			.size = sym.st_size,
+			.name = c_string_at(table.strings, sym.st_name),
+		};
+	}
+
+	std::optional<ElfSymbolResolver::SymbolEntry> ElfSymbolResolver::find_gnu_hash(const std::string_view name) const
+	{
+		if (m_gnuHash.size() < 16 || m_dynsym.symbols.empty())
+			return std::nullopt;
+
+		const auto nbuckets = load<std::uint32_t>(m_gnuHash, 0);
+		const auto symoffset = load<std::uint32_t>(m_gnuHash, 4);
+		const auto bloomSize = load<std::uint32_t>(m_gnuHash, 8);
+		const auto bloomShift = load<std::uint32_t>(m_gnuHash, 12);
+		if (nbuckets == 0 || bloomSize == 0)
+			return std::nullopt;
+
+		std::uint32_t h = 5381;
+		for (const char c : name)
+			h = h * 33 + static_cast<std::uint8_t>(c);
+
+		// Bloom filter rejects most misses without touching the chains.
+		const std::size_t bloomOffset = 16;
+		const auto word = load<std::uint64_t>(m_gnuHash, bloomOffset + (h / 64 % bloomSize) * 8);
+		const std::uint64_t mask = (1ull << (h % 64)) | (1ull << ((h >> bloomShift) % 64));
+		if ((word & mask) != mask)
+			return std::nullopt;
+
+		const std::size_t bucketsOffset = bloomOffset + static_cast<std::size_t>(bloomSize) * 8;
+		const std::size_t chainOffset = bucketsOffset + static_cast<std::size_t>(nbuckets) * 4;
+		std::uint32_t index = load<std::uint32_t>(m_gnuHash, bucketsOffset + (h % nbuckets) * 4);
+		if (index < symoffset)
+			return std::nullopt;
+
+		for (;; ++index)
+		{
+			const auto chainHash = load<std::uint32_t>(m_gnuHash, chainOffset + static_cast<std::size_t>(index - symoffset) * 4);
+			if ((chainHash | 1) == (h | 1))
+			{
+				if (const SymbolEntry e = entry_at(m_dynsym, index); e.name == name && e.value != 0)
+					return e;
+			}
+			if (chainHash & 1)
+				break;
+		}
+		return std::nullopt;
+	}
+
+	std::optional<ElfSymbolResolver::SymbolEntry> ElfSymbolResolver::find_symtab(const std::string_view name)
+	{
+		const auto count = static_cast<std::uint32_t>(m_symtab.symbols.size() / sizeof(Elf64_Sym));
+		const auto matches = [&](const SymbolEntry& e, const std::uint32_t i)
+		{
+			const auto sym = load<Elf64_Sym>(m_symtab.symbols, static_cast<std::size_t>(i) * sizeof(Elf64_Sym));
+			return e.name == name && ELF64_ST_TYPE(sym.st_info) == STT_OBJECT && sym.st_shndx != SHN_UNDEF;
+		};
+
+		// A single lookup is cheapest as a linear scan; repeated lookups amortise a hash index.
+		if (m_symtabScans++ == 0)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				if (const SymbolEntry e = entry_at(m_symtab, i); matches(e, i))
+					return e;
+			}
+			return std::nullopt;
+		}
+
+		if (m_symtabIndex.empty())
+		{
+			m_symtabIndex.reserve(count);
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				if (const SymbolEntry e = entry_at(m_symtab, i); !e.name.empty())
+					m_symtabIndex.emplace(e.name, i);
+			}
+		}
+		const auto it = m_symtabIndex.find(name);
+		if (it == m_symtabIndex.end())
+			return std::nullopt;
+		const SymbolEntry e = entry_at(m_symtab, it->second);
+		return matches(e, it->second) ? std::optional(e) : std::nullopt;
+	}
+
+	struct ElfSymbolResolver::DwarfIndex
+	{
+		DwarfReader reader;
+	};
+
+	ElfSymbolResolver::DwarfIndex* ElfSymbolResolver::dwarf()
+	{
+		if (m_debugInfo.empty() || m_debugAbbrev.empty())
+			return nullptr;
+		if (!m_dwarf)
+			m_dwarf = std::make_unique<DwarfIndex>(DwarfReader({
+				.info = m_debugInfo,
+				.abbrev = m_debugAbbrev,
+				.names = m_debugNames,
+				.pubnames = m_debugPubnames,
+				.gnuPubnames = m_debugGnuPubnames,
+				.aranges = m_debugAranges,
+				.str = m_debugStr,
+			}));
+		return m_dwarf.get();
+	}
+
+	std::optional<std::uint64_t> ElfSymbolResolver::dwarf_type_size(const std::uint64_t linkAddress, const std::span<const std::string_view> names)
+	{
+		DwarfIndex* index = dwarf();
+		return index ? index->reader.type_size_of_variable_at(linkAddress, names) : std::nullopt;
+	}
+
+	std::uint64_t ElfSymbolResolver::dwarf_element_size(const std::uint64_t linkAddress, const std::span<const std::string_view> names)
+	{
+		DwarfIndex* index = dwarf();
+		return index ? index->reader.element_size_of_variable_at(linkAddress, names).value_or(0) : 0;
+	}
+
+	std::string ElfSymbolResolver::mangle_qualified(const std::string_view name)
+	{
+		// Namespace-qualified variable: a::b::c -> _ZN1a1b1cE
+		std::string out = "_ZN";
+		std::size_t start = 0;
+		while (start <= name.size())
+		{
+			const auto sep = name.find("::", start);
+			const std::string_view part = name.substr(start, sep == std::string_view::npos ? std::string_view::npos : sep - start);
+			out += std::to_string(part.size());
+			out += part;
+			if (sep == std::string_view::npos)
+				break;
+			start = sep + 2;
+		}
+		out += 'E';
+		return out;
+	}
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include "../include/HotSites.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <sstream>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+#ifdef __linux__
+#include <fstream>
+#endif
+
+namespace gwatch
+{
+	namespace
+	{
+		std::string demangle(const std::string& name)
+		{
+#if __has_include(<cxxabi.h>)
+			int status = 0;
+			char* plain = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+			if (status == 0 && plain)
+			{
+				std::string out(plain);
+				std::free(plain);
+				return out;
+			}
+			std::free(plain);
+#endif
+			return name;
+		}
+
+		bool line_order(const LineTable::Row& a, const LineTable::Row& b)
+		{
+			// Where a sequence ends at the address the next one starts, the start must win.
+			return a.address != b.address ? a.address < b.address : a.line == 0 && b.line != 0;
+		}
+	}
+
+	HotSiteTable::HotSiteTable(const std::size_t capacity) :
+		m_entries(std::bit_ceil(std::max<std::size_t>(capacity, 4))),
+		m_limit(m_entries.size() / 4 * 3)
+	{
+	}
+
+	void HotSiteTable::record(const std::uint64_t ip, const AccessKind kind, const std::uint32_t tid, const std::uint64_t variables)
+	{
+		++m_total;
+		if (ip == 0)
+		{
+			++m_undecoded;
+			return;
+		}
+		const std::size_t mask = m_entries.size() - 1;
+		// Fibonacci hashing: the sites of one function are a few bytes apart.
+		const std::uint64_t key = ip << 1 | static_cast<std::uint64_t>(kind);
+		// m_limit < capacity, so the probe always ends at the site or at a free entry.
+		for (std::size_t i = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;; i = (i + 1) & mask)
+		{
+			HotSite& entry = m_entries[i];
+			if (entry.count == 0)
+			{
+				if (m_size >= m_limit)
+				{
+					++m_overflow;
+					return;
+				}
+				entry = HotSite{.ip = ip, .count = 1, .variables = variables, .tid = tid, .kind = kind};
+				++m_size;
+				return;
+			}
+			if (entry.ip == ip && entry.kind == kind)
+			{
+				++entry.count;
+				entry.variables |= variables;
+				entry.otherThreads |= entry.tid != tid;
+				return;
+			}
+		}
+	}
+
+	std::vector<HotSite> HotSiteTable::top(const std::size_t n) const
+	{
+		std::vector<HotSite> out;
+		out.reserve(m_size);
+		for (const auto& entry : m_entries)
+		{
+			if (entry.count != 0)
+				out.push_back(entry);
+		}
+		const auto order = [](const HotSite& a, const HotSite& b)
+		{
+			if (a.count != b.count)
+				return a.count > b.count;
+			return a.ip != b.ip ? a.ip < b.ip : a.kind < b.kind;
+		};
+		const std::size_t kept = std::min(n, out.size());
+		std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(kept), out.end(), order);
+		out.resize(kept);
+		return out;
+	}
+
+	void SiteSymbolizer::add_module(std::string name, const std::uint64_t begin, const std::uint64_t end, std::vector<CodeSymbol> functions, const LineTable& lines)
+	{
+		m_modules.push_back(Module{.begin = begin, .end = end, .name = std::move(name)});
+		std::ranges::sort(m_modules, {}, &Module::begin);
+
+		m_functions.insert(m_functions.end(), std::make_move_iterator(functions.begin()), std::make_move_iterator(functions.end()));
+		std::ranges::sort(m_functions, {}, &CodeSymbol::address);
+
+		const auto fileBase = static_cast<std::uint32_t>(m_files.size());
+		m_files.insert(m_files.end(), lines.files.begin(), lines.files.end());
+		for (auto row : lines.rows)
+		{
+			row.file += fileBase;
+			m_rows.push_back(row);
+		}
+		std::ranges::stable_sort(m_rows, line_order);
+	}
+
+	std::string SiteSymbolizer::describe(const std::uint64_t ip) const
+	{
+		std::ostringstream oss;
+		const auto fn = std::ranges::upper_bound(m_functions, ip, {}, &CodeSymbol::address);
+		const auto module = std::ranges::upper_bound(m_modules, ip, {}, &Module::begin);
+		if (fn != m_functions.begin() && ip - std::prev(fn)->address < std::prev(fn)->size)
+		{
+			oss << demangle(std::prev(fn)->name) << "+0x" << std::hex << ip - std::prev(fn)->address;
+		}
+		else if (module != m_modules.begin() && ip < std::prev(module)->end)
+		{
+			const std::string& path = std::prev(module)->name;
+			oss << path.substr(path.rfind('/') + 1) << "+0x" << std::hex << ip - std::prev(module)->begin;
+		}
+		else
+		{
+			oss << "0x" << std::hex << ip;
+		}
+
+		const auto row = std::ranges::upper_bound(m_rows, LineTable::Row{.address = ip, .line = 1}, line_order);
+		if (row != m_rows.begin() && std::prev(row)->line != 0)
+			oss << " (" << m_files[std::prev(row)->file] << ":" << std::dec << std::prev(row)->line << ")";
+		return oss.str();
+	}
+
+#ifdef __linux__
+
+	std::vector<CodeModule> read_code_modules(const std::uint32_t pid)
+	{
+		std::vector<CodeModule> modules;
+		std::vector<bool> executable;
+		std::ifstream in("/proc/" + std::to_string(pid) + "/maps");
+		std::string line;
+		while (std::getline(in, line))
+		{
+			// begin-end perms offset dev inode [name]
+			std::istringstream fields(line);
+			std::string range;
+			std::string perms;
+			std::string skip;
+			std::string path;
+			fields >> range >> perms >> skip >> skip >> skip;
+			std::getline(fields >> std::ws, path);
+			if (!path.starts_with('/'))
+				continue;
+
+			const auto dash = range.find('-');
+			const std::uint64_t begin = std::stoull(range.substr(0, dash), nullptr, 16);
+			const std::uint64_t end = std::stoull(range.substr(dash + 1), nullptr, 16);
+			auto it = std::ranges::find(modules, path, &CodeModule::path);
+			if (it == modules.end())
+			{
+				modules.push_back(CodeModule{.path = path, .begin = begin, .end = end});
+				executable.push_back(false);
+				it = modules.end() - 1;
+			}
+			it->begin = std::min(it->begin, begin);
+			it->end = std::max(it->end, end);
+			if (perms.size() > 2 && perms[2] == 'x')
+				executable[static_cast<std::size_t>(it - modules.begin())] = true;
+		}
+
+		std::vector<CodeModule> out;
+		for (std::size_t i = 0; i < modules.size(); ++i)
+		{
+			if (executable[i])
+				out.push_back(std::move(modules[i]));
+		}
+		return out;
+	}
+
+	std::optional<x86::CodeRange> FunctionIndex::find(const std::uint64_t address)
+	{
+		const CodeSymbol* function = lookup(address);
+		if (!function && std::ranges::none_of(m_modules, [address](const CodeModule& m) { return address >= m.begin && address < m.end; }))
+		{
+			index_module_at(address);
+			function = lookup(address);
+		}
+		if (!function)
+			return std::nullopt;
+		return x86::CodeRange{.begin = function->address, .size = function->size};
+	}
+
+	void FunctionIndex::index_mapped()
+	{
+		for (auto& module : read_code_modules(m_pid))
+		{
+			if (std::ranges::find(m_modules, module.path, &CodeModule::path) == m_modules.end())
+				index(std::move(module));
+		}
+	}
+
+	void FunctionIndex::index_module_at(const std::uint64_t address)
+	{
+		for (auto& module : read_code_modules(m_pid))
+		{
+			if (address >= module.begin && address < module.end)
+				return index(std::move(module));
+		}
+	}
+
+	void FunctionIndex::index(CodeModule module)
+	{
+		try
+		{
+			const ElfSymbolResolver resolver(module.path, module.begin);
+			auto functions = resolver.functions();
+			m_functions.insert(m_functions.end(), std::make_move_iterator(functions.begin()), std::make_move_iterator(functions.end()));
+			std::ranges::sort(m_functions, {}, &CodeSymbol::address);
+		}
+		catch (const SymbolError&)
+		{
+			// Unreadable image: its code stays unknown.
+		}
+		m_modules.push_back(std::move(module));
+	}
+
+	const CodeSymbol* FunctionIndex::lookup(const std::uint64_t address) const
+	{
+		const auto fn = std::ranges::upper_bound(m_functions, address, {}, &CodeSymbol::address);
+		if (fn == m_functions.begin() || address - std::prev(fn)->address >= std::prev(fn)->size)
+			return nullptr;
+		return &*std::prev(fn);
+	}
+
+#endif
+}
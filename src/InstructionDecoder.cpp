@@ -0,0 +1,893 @@
+#include "../include/InstructionDecoder.h"
+
+namespace gwatch::x86
+{
+	namespace
+	{
+		enum class Map : std::uint8_t
+		{
+			OneByte,
+			Map0F,
+			Map0F38,
+			Map0F3A,
+			Map5, // EVEX only (FP16)
+			Map6
+		};
+
+		struct Context
+		{
+			bool x64 = true;
+			bool opsize = false;   // 66
+			bool addrsize = false; // 67
+			bool rexW = false;
+			std::uint8_t pp = 0;   // mandatory prefix: 0 none, 1 66, 2 F3, 3 F2
+			bool vex = false;      // VEX or EVEX
+			bool evex = false;
+			std::uint16_t vector = 16; // bytes of a full vector operand
+
+			// Operand size of the general-purpose forms.
+			std::uint16_t v() const { return rexW ? 8 : opsize ? 2 : 4; }
+			// Scalar SSE forms read one element, packed ones the whole vector.
+			std::uint16_t scalar() const { return pp == 2 ? 4 : pp == 3 ? 8 : vector; }
+			// Without a prefix the integer forms of the 0F map work on 8-byte MMX registers.
+			std::uint16_t mmx_or_vector() const { return vex || pp != 0 ? vector : 8; }
+			std::uint16_t gpr() const { return rexW ? 8 : 4; }
+		};
+
+		struct Shape
+		{
+			Access access = Access::Unknown;
+			std::uint16_t width = 0;
+		};
+
+		struct Layout
+		{
+			bool modrm = false;
+			std::uint8_t imm = 0;
+			bool valid = true;
+		};
+
+		Layout one_byte_layout(const std::uint8_t op, const Context& ctx)
+		{
+			const std::uint8_t z = ctx.opsize && !ctx.rexW ? 2 : 4;
+			if (op < 0x40)
+			{
+				switch (op & 7)
+				{
+					case 0: case 1: case 2: case 3:
+						return {.modrm = true};
+					case 4:
+						return {.imm = 1};
+					case 5:
+						return {.imm = z};
+					default:
+						// push/pop segment, daa/das/aaa/aas; 0F and the segment prefixes never get here.
+						return {.valid = !ctx.x64};
+				}
+			}
+			if (op < 0x50)
+				return {.valid = !ctx.x64}; // inc/dec in 32-bit mode (REX otherwise)
+			if (op < 0x60)
+				return {};
+			if (op >= 0x70 && op <= 0x7F)
+				return {.imm = 1};
+			if (op >= 0x80 && op <= 0x8F)
+			{
+				if (op == 0x82 && ctx.x64)
+					return {.valid = false};
+				return {.modrm = true, .imm = static_cast<std::uint8_t>(op == 0x81 ? z : op <= 0x83 ? 1 : 0)};
+			}
+			if (op >= 0x90 && op <= 0x9F)
+			{
+				if (op == 0x9A)
+					return {.imm = static_cast<std::uint8_t>(ctx.opsize ? 4 : 6), .valid = !ctx.x64};
+				return {};
+			}
+			if (op >= 0xA0 && op <= 0xA3)
+			{
+				// moffs: an address, not an operand.
+				const std::uint8_t moffs = ctx.x64 ? (ctx.addrsize ? 4 : 8) : (ctx.addrsize ? 2 : 4);
+				return {.imm = moffs};
+			}
+			if (op >= 0xB0 && op <= 0xB7)
+				return {.imm = 1};
+			if (op >= 0xB8 && op <= 0xBF)
+				return {.imm = static_cast<std::uint8_t>(ctx.rexW ? 8 : ctx.opsize ? 2 : 4)};
+			if (op >= 0xD8 && op <= 0xDF)
+				return {.modrm = true};
+			if (op >= 0xE0 && op <= 0xE7)
+				return {.imm = 1};
+
+			switch (op)
+			{
+				case 0x60: case 0x61:
+					return {.valid = !ctx.x64};
+				case 0x62:
+					return {.modrm = true, .valid = !ctx.x64};
+				case 0x63:
+					return {.modrm = true};
+				case 0x68:
+					return {.imm = z};
+				case 0x69:
+					return {.modrm = true, .imm = z};
+				case 0x6A:
+					return {.imm = 1};
+				case 0x6B:
+					return {.modrm = true, .imm = 1};
+				case 0xA8:
+					return {.imm = 1};
+				case 0xA9:
+					return {.imm = z};
+				case 0xC0: case 0xC1: case 0xC6:
+					return {.modrm = true, .imm = 1};
+				case 0xC7:
+					return {.modrm = true, .imm = z};
+				case 0xC2: case 0xCA:
+					return {.imm = 2};
+				case 0xC4: case 0xC5:
+					return {.modrm = true, .valid = !ctx.x64}; // les/lds, VEX is handled before
+				case 0xC8:
+					return {.imm = 3};
+				case 0xCD:
+					return {.imm = 1};
+				case 0xCE:
+					return {.valid = !ctx.x64};
+				case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+					return {.modrm = true};
+				case 0xD4: case 0xD5:
+					return {.imm = 1, .valid = !ctx.x64};
+				case 0xD6:
+					return {.valid = false};
+				case 0xE8: case 0xE9:
+					return {.imm = z};
+				case 0xEA:
+					return {.imm = static_cast<std::uint8_t>(ctx.opsize ? 4 : 6), .valid = !ctx.x64};
+				case 0xEB:
+					return {.imm = 1};
+				case 0xF6: case 0xF7: case 0xFE: case 0xFF:
+					return {.modrm = true}; // F6/F7 test immediates depend on ModRM.reg
+				default:
+					return {};
+			}
+		}
+
+		Layout map0f_layout(const std::uint8_t op, const Context& ctx)
+		{
+			if (op >= 0x80 && op <= 0x8F)
+				return {.imm = static_cast<std::uint8_t>(ctx.opsize && !ctx.rexW ? 2 : 4)};
+			if (op >= 0xC8 && op <= 0xCF)
+				return {};
+			if (op >= 0x30 && op <= 0x37)
+				return {.valid = op != 0x36};
+			switch (op)
+			{
+				case 0x04: case 0x0A: case 0x0C: case 0x39: case 0x3B: case 0x3C: case 0x3D: case 0x3E: case 0x3F:
+				case 0x7A: case 0x7B: case 0xA6: case 0xA7:
+					return {.valid = false};
+				case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0B: case 0x0E:
+				case 0x77: case 0xA0: case 0xA1: case 0xA2: case 0xA8: case 0xA9: case 0xAA:
+					return {};
+				case 0x0F: // 3DNow!: the opcode is the trailing byte
+				case 0x70: case 0x71: case 0x72: case 0x73:
+				case 0xA4: case 0xAC: case 0xBA:
+				case 0xC2: case 0xC4: case 0xC5: case 0xC6:
+					return {.modrm = true, .imm = 1};
+				default:
+					return {.modrm = true};
+			}
+		}
+
+		Layout vex_layout(const Map map, const std::uint8_t op, const bool evex)
+		{
+			switch (map)
+			{
+				case Map::Map0F:
+					if (op == 0x77 && !evex)
+						return {}; // vzeroupper / vzeroall
+					if ((op >= 0x70 && op <= 0x73) || op == 0xC2 || op == 0xC4 || op == 0xC5 || op == 0xC6)
+						return {.modrm = true, .imm = 1};
+					return {.modrm = true};
+				case Map::Map0F3A:
+					return {.modrm = true, .imm = 1};
+				default:
+					return {.modrm = true};
+			}
+		}
+
+		// Instructions a lock prefix is valid on (with a memory destination); #UD otherwise.
+		bool lockable(const Map map, const std::uint8_t op, const std::uint8_t reg)
+		{
+			if (map == Map::OneByte)
+			{
+				if (op < 0x38 && (op & 7) < 2)
+					return true;
+				if (op >= 0x80 && op <= 0x83)
+					return reg != 7;
+				if (op == 0x86 || op == 0x87)
+					return true;
+				if (op == 0xF6 || op == 0xF7)
+					return reg == 2 || reg == 3;
+				if (op == 0xFE || op == 0xFF)
+					return reg <= 1;
+				return false;
+			}
+			if (map == Map::Map0F)
+			{
+				switch (op)
+				{
+					case 0xAB: case 0xB3: case 0xBB: case 0xB0: case 0xB1: case 0xC0: case 0xC1:
+						return true;
+					case 0xBA:
+						return reg >= 5;
+					case 0xC7:
+						return reg == 1;
+					default:
+						return false;
+				}
+			}
+			return false;
+		}
+
+		Shape x87_shape(const std::uint8_t op, const std::uint8_t reg)
+		{
+			switch (op)
+			{
+				case 0xD8: case 0xDA:
+					return {Access::Load, 4};
+				case 0xDC:
+					return {Access::Load, 8};
+				case 0xDE:
+					return {Access::Load, 2};
+				case 0xD9:
+					if (reg == 0)
+						return {Access::Load, 4};
+					if (reg == 2 || reg == 3)
+						return {Access::Store, 4};
+					if (reg == 5)
+						return {Access::Load, 2};
+					if (reg == 7)
+						return {Access::Store, 2};
+					return {};
+				case 0xDB:
+					if (reg == 0)
+						return {Access::Load, 4};
+					if (reg >= 1 && reg <= 3)
+						return {Access::Store, 4};
+					if (reg == 5)
+						return {Access::Load, 10};
+					if (reg == 7)
+						return {Access::Store, 10};
+					return {};
+				case 0xDD:
+					if (reg == 0)
+						return {Access::Load, 8};
+					if (reg >= 1 && reg <= 3)
+						return {Access::Store, 8};
+					if (reg == 7)
+						return {Access::Store, 2};
+					return {};
+				default: // DF
+					if (reg == 0)
+						return {Access::Load, 2};
+					if (reg >= 1 && reg <= 3)
+						return {Access::Store, 2};
+					if (reg == 4)
+						return {Access::Load, 10};
+					if (reg == 5)
+						return {Access::Load, 8};
+					if (reg == 6)
+						return {Access::Store, 10};
+					return {Access::Store, 8};
+			}
+		}
+
+		// Memory forms of the one-byte map (ModRM.mod != 3).
+		Shape one_byte_shape(const std::uint8_t op, const std::uint8_t reg, const Context& ctx)
+		{
+			const std::uint16_t v = ctx.v();
+			if (op < 0x40)
+			{
+				const std::uint16_t width = op & 1 ? v : 1;
+				if (op & 2)
+					return {Access::Load, width};
+				return {(op >> 3) == 7 ? Access::Load : Access::ReadModifyWrite, width};
+			}
+			if (op >= 0x80 && op <= 0x83)
+				return {reg == 7 ? Access::Load : Access::ReadModifyWrite, static_cast<std::uint16_t>(op == 0x81 || op == 0x83 ? v : 1)};
+			if (op >= 0xD8 && op <= 0xDF)
+				return x87_shape(op, reg);
+
+			const std::uint16_t stack = ctx.x64 ? (ctx.opsize ? 2 : 8) : v;
+			switch (op)
+			{
+				case 0x62:
+					return {Access::Load, static_cast<std::uint16_t>(2 * v)};
+				case 0x63:
+					return ctx.x64 ? Shape{Access::Load, 4} : Shape{Access::ReadModifyWrite, 2};
+				case 0x69: case 0x6B:
+					return {Access::Load, v};
+				case 0x84:
+					return {Access::Load, 1};
+				case 0x85:
+					return {Access::Load, v};
+				case 0x86:
+					return {Access::ReadModifyWrite, 1};
+				case 0x87:
+					return {Access::ReadModifyWrite, v};
+				case 0x88:
+					return {Access::Store, 1};
+				case 0x89:
+					return {Access::Store, v};
+				case 0x8A:
+					return {Access::Load, 1};
+				case 0x8B:
+					return {Access::Load, v};
+				case 0x8C:
+					return {Access::Store, 2};
+				case 0x8D:
+					return {Access::None, 0};
+				case 0x8E:
+					return {Access::Load, 2};
+				case 0x8F:
+					return reg == 0 ? Shape{Access::Store, stack} : Shape{};
+				case 0xC0: case 0xD0: case 0xD2:
+					return {Access::ReadModifyWrite, 1};
+				case 0xC1: case 0xD1: case 0xD3:
+					return {Access::ReadModifyWrite, v};
+				case 0xC4: case 0xC5:
+					return {Access::Load, static_cast<std::uint16_t>(v + 2)};
+				case 0xC6:
+					return reg == 0 ? Shape{Access::Store, 1} : Shape{};
+				case 0xC7:
+					return reg == 0 ? Shape{Access::Store, v} : Shape{};
+				case 0xF6: case 0xF7:
+					return {reg == 2 || reg == 3 ? Access::ReadModifyWrite : Access::Load, static_cast<std::uint16_t>(op == 0xF6 ? 1 : v)};
+				case 0xFE:
+					return reg <= 1 ? Shape{Access::ReadModifyWrite, 1} : Shape{};
+				case 0xFF:
+					if (reg <= 1)
+						return {Access::ReadModifyWrite, v};
+					if (reg == 2 || reg == 4 || reg == 6)
+						return {Access::Load, stack};
+					if (reg == 3 || reg == 5)
+						return {Access::Load, static_cast<std::uint16_t>(v + 2)};
+					return {};
+				default:
+					return {};
+			}
+		}
+
+		// Whether the ModRM reg field names a register the instruction writes. Opcode extensions
+		// and source registers do not; vector destinations are counted too, a clash with the
+		// base number only costs the address.
+		bool writes_reg_field(const Map map, const std::uint8_t op, const Access access)
+		{
+			if (access != Access::Load && access != Access::ReadModifyWrite)
+				return false;
+			if (map == Map::OneByte)
+			{
+				if (op < 0x40)
+					return (op & 7) >= 2 && op < 0x38; // "op reg, [m]" forms, cmp excluded
+				return op == 0x63 || op == 0x69 || op == 0x6B || op == 0x86 || op == 0x87 || op == 0x8A || op == 0x8B || op == 0xC4 || op == 0xC5;
+			}
+			if (map == Map::Map0F)
+			{
+				switch (op)
+				{
+					case 0x00: case 0x01: case 0xAE: case 0xBA: case 0xC7:
+					case 0xA3: case 0xAB: case 0xB3: case 0xBB:
+					case 0xA4: case 0xA5: case 0xAC: case 0xAD:
+					case 0xB0: case 0xB1:
+						return false;
+					default:
+						return true;
+				}
+			}
+			return true;
+		}
+
+		// Registers written besides the ModRM reg field, as a mask of encodings.
+		std::uint16_t implicit_writes(const Map map, const std::uint8_t op, const std::uint8_t reg)
+		{
+			constexpr std::uint16_t rax = 1u << 0, rdx = 1u << 2, rsp = 1u << 4;
+			if (map == Map::OneByte && (op == 0xF6 || op == 0xF7) && reg >= 4)
+				return rax | rdx; // mul, imul, div, idiv
+			if (map == Map::OneByte && ((op == 0xFF && reg >= 2 && reg <= 6) || op == 0x8F))
+				return rsp;       // call, push, pop
+			if (map == Map::Map0F && (op == 0xB0 || op == 0xB1))
+				return rax;       // cmpxchg
+			if (map == Map::Map0F && op == 0xC7 && reg == 1)
+				return rax | rdx; // cmpxchg8b/16b
+			return 0;
+		}
+
+		// Register or immediate a plain move of the one-byte or 0F map moved; the value is
+		// only read once the memory operand is known to be the destination or the source.
+		MovedValue moved_value_of(const Map map, const std::uint8_t op, const std::uint8_t reg, const std::uint8_t rex, const std::span<const std::uint8_t> imm)
+		{
+			const std::uint8_t rexR = (rex >> 2) & 1;
+			MovedValue value;
+			if (map == Map::OneByte && (op == 0xC6 || op == 0xC7) && reg == 0)
+			{
+				value.known = true;
+				for (std::size_t i = 0; i < imm.size(); ++i)
+					value.immediate |= static_cast<std::uint64_t>(imm[i]) << (8 * i);
+				if (!imm.empty() && (imm.back() & 0x80) != 0 && imm.size() < 8)
+					value.immediate |= ~std::uint64_t{0} << (8 * imm.size()); // REX.W sign-extends imm32
+				return value;
+			}
+			const bool byteForm = map == Map::OneByte && (op == 0x88 || op == 0x8A);
+			if ((map == Map::OneByte && (op == 0x63 || (op >= 0x88 && op <= 0x8B))) || (map == Map::Map0F && (op == 0xB6 || op == 0xB7 || op == 0xBE || op == 0xBF)))
+			{
+				value.known = true;
+				value.highByte = byteForm && rex == 0 && reg >= 4;
+				value.reg = static_cast<std::int8_t>(value.highByte ? reg - 4 : reg | rexR << 3);
+			}
+			return value;
+		}
+
+		// One-byte instructions that address memory without a ModRM byte.
+		Shape implicit_shape(const std::uint8_t op, const Context& ctx)
+		{
+			const std::uint16_t width = op & 1 ? ctx.v() : 1;
+			switch (op)
+			{
+				case 0xA0: case 0xA1: case 0xA6: case 0xA7: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+					return {Access::Load, width};
+				case 0xA2: case 0xA3: case 0xAA: case 0xAB:
+					return {Access::Store, width};
+				case 0xA4: case 0xA5:
+					return {Access::Unknown, width}; // movs: the trap does not say which side
+				case 0xD7:
+					return {Access::Load, 1};
+				default:
+					return {Access::None, 0};
+			}
+		}
+
+		// Memory forms of the 0F map, legacy SSE and VEX/EVEX map 1 alike.
+		Shape map0f_shape(const std::uint8_t op, const std::uint8_t reg, const Context& ctx)
+		{
+			if (op >= 0x40 && op <= 0x4F)
+				return {Access::Load, ctx.v()};
+			if (op >= 0x90 && op <= 0x9F)
+				return {Access::Store, 1};
+			if (op == 0x0D || (op >= 0x18 && op <= 0x1F))
+				return {Access::None, 0}; // prefetch, hint nops
+			switch (op)
+			{
+				case 0x10:
+					return {Access::Load, ctx.scalar()};
+				case 0x11:
+					return {Access::Store, ctx.scalar()};
+				case 0x12: case 0x16:
+					return {Access::Load, static_cast<std::uint16_t>(ctx.pp == 2 ? ctx.vector : 8)};
+				case 0x13: case 0x17:
+					return {Access::Store, 8};
+				case 0x14: case 0x15: case 0x28:
+					return {Access::Load, ctx.vector};
+				case 0x29: case 0x2B:
+					return {Access::Store, ctx.vector};
+				case 0x2A:
+					return {Access::Load, static_cast<std::uint16_t>(ctx.pp >= 2 ? ctx.gpr() : 8)};
+				case 0x2C: case 0x2D:
+					return {Access::Load, static_cast<std::uint16_t>(ctx.pp == 2 ? 4 : 8)};
+				case 0x2E: case 0x2F:
+					return {Access::Load, static_cast<std::uint16_t>(ctx.pp == 1 ? 8 : 4)};
+				case 0x6E:
+					return {Access::Load, ctx.gpr()};
+				case 0x7E:
+					return ctx.pp == 2 ? Shape{Access::Load, 8} : Shape{Access::Store, ctx.gpr()};
+				case 0x6F:
+					return {Access::Load, ctx.mmx_or_vector()};
+				case 0x7F: case 0xE7:
+					return {Access::Store, ctx.mmx_or_vector()};
+				case 0xA3: case 0xAF: case 0xB8: case 0xBC: case 0xBD:
+					return {Access::Load, ctx.v()};
+				case 0xAB: case 0xB3: case 0xBB:
+				case 0xA4: case 0xA5: case 0xAC: case 0xAD:
+				case 0xB1: case 0xC1:
+					return {Access::ReadModifyWrite, ctx.v()};
+				case 0xB0: case 0xC0:
+					return {Access::ReadModifyWrite, 1};
+				case 0xBA:
+					if (reg == 4)
+						return {Access::Load, ctx.v()};
+					return reg >= 5 ? Shape{Access::ReadModifyWrite, ctx.v()} : Shape{};
+				case 0xAE:
+					switch (reg)
+					{
+						case 0: return {Access::Store, 512}; // fxsave
+						case 1: return {Access::Load, 512};  // fxrstor
+						case 2: return {Access::Load, 4};    // ldmxcsr
+						case 3: return {Access::Store, 4};   // stmxcsr
+						case 7: return {Access::None, 0};    // clflush
+						default: return {};
+					}
+				case 0xB6: case 0xBE:
+					return {Access::Load, 1};
+				case 0xB7: case 0xBF:
+					return {Access::Load, 2};
+				case 0xC2:
+					return {Access::Load, ctx.scalar()};
+				case 0xC3:
+					return {Access::Store, ctx.gpr()};
+				case 0xC4:
+					return {Access::Load, 2};
+				case 0xC6:
+					return {Access::Load, ctx.vector};
+				case 0xC7:
+					return reg == 1 ? Shape{Access::ReadModifyWrite, static_cast<std::uint16_t>(ctx.rexW ? 16 : 8)} : Shape{};
+				case 0xD6:
+					return {Access::Store, 8};
+				default:
+					if (op >= 0x51 && op <= 0x5F)
+						return {Access::Load, ctx.scalar()};
+					if (op >= 0x50)
+						return {Access::Load, ctx.mmx_or_vector()};
+					return {}; // system instructions (0F 00, 0F 01, ...)
+			}
+		}
+
+		Shape map0f38_shape(const std::uint8_t op, const Context& ctx)
+		{
+			if (!ctx.vex)
+			{
+				if (op == 0xF0)
+					return {Access::Load, static_cast<std::uint16_t>(ctx.pp == 3 ? 1 : ctx.v())}; // crc32 m8 / movbe
+				if (op == 0xF1)
+					return ctx.pp == 3 ? Shape{Access::Load, ctx.v()} : Shape{Access::Store, ctx.v()};
+				return {Access::Load, ctx.mmx_or_vector()};
+			}
+			if (op >= 0xF0)
+				return {Access::Load, ctx.gpr()}; // BMI: andn, bzhi, bextr, shlx, ...
+			if (op == 0x2E || op == 0x2F || op == 0x8E)
+				return {Access::Store, ctx.vector}; // vmaskmov
+			if (ctx.evex)
+			{
+				// Down-converting moves, compress and scatter: variable widths.
+				if (ctx.pp == 2 && ((op >= 0x10 && op <= 0x15) || (op >= 0x20 && op <= 0x25) || (op >= 0x30 && op <= 0x35)))
+					return {Access::Store, 0};
+				if (op == 0x8A || op == 0x8B || op == 0x63 || (op >= 0xA0 && op <= 0xA3))
+					return {Access::Store, 0};
+			}
+			return {Access::Load, ctx.vector};
+		}
+
+		Shape map0f3a_shape(const std::uint8_t op, const Context& ctx)
+		{
+			switch (op)
+			{
+				case 0x14:
+					return {Access::Store, 1};
+				case 0x15:
+					return {Access::Store, 2};
+				case 0x16:
+					return {Access::Store, ctx.gpr()};
+				case 0x17:
+					return {Access::Store, 4};
+				case 0x19: case 0x39:
+					return {Access::Store, 16};
+				case 0x1B: case 0x3B:
+					return {Access::Store, 32};
+				case 0x1D:
+					return {Access::Store, static_cast<std::uint16_t>(ctx.vector / 2)};
+				case 0x20:
+					return {Access::Load, 1};
+				case 0x21:
+					return {Access::Load, 4};
+				case 0x22: case 0xF0:
+					return {Access::Load, ctx.gpr()};
+				default:
+					return {Access::Load, ctx.vector};
+			}
+		}
+
+		Shape fp16_shape(const Map map, const std::uint8_t op, const Context& ctx)
+		{
+			if (map == Map::Map5 && (op == 0x11 || op == 0x7E))
+				return {Access::Store, 2};
+			if (map == Map::Map5 && (op == 0x10 || op == 0x6E))
+				return {Access::Load, 2};
+			return {Access::Load, ctx.vector};
+		}
+	}
+
+	Instruction decode(const std::span<const std::uint8_t> code, const bool x64)
+	{
+		const std::size_t limit = std::min(code.size(), kMaxInstructionLength);
+		std::size_t pos = 0;
+		const auto next = [&](std::uint8_t& out)
+		{
+			if (pos >= limit)
+				return false;
+			out = code[pos++];
+			return true;
+		};
+
+		Context ctx{.x64 = x64};
+		bool lock = false;
+		bool segment = false; // FS/GS: the address is relative to a base we cannot read
+		std::uint8_t rep = 0; // last of F2/F3
+		std::uint8_t rex = 0;
+		std::uint8_t op = 0;
+		for (bool prefix = true; prefix;)
+		{
+			if (!next(op))
+				return {};
+			if (x64 && (op & 0xF0) == 0x40)
+			{
+				rex = op; // only effective right before the opcode
+				continue;
+			}
+			switch (op)
+			{
+				case 0xF0:
+					lock = true;
+					break;
+				case 0xF2: case 0xF3:
+					rep = op;
+					break;
+				case 0x66:
+					ctx.opsize = true;
+					break;
+				case 0x67:
+					ctx.addrsize = true;
+					break;
+				case 0x64: case 0x65:
+					segment = true;
+					break;
+				case 0x26: case 0x2E: case 0x36: case 0x3E:
+					break;
+				default:
+					prefix = false;
+					continue;
+			}
+			// A REX followed by another prefix is ignored by the CPU and never emitted.
+			if (rex != 0)
+				return {};
+		}
+
+		ctx.rexW = (rex & 0x08) != 0;
+		std::uint8_t rexR = (rex >> 2) & 1, rexX = (rex >> 1) & 1, rexB = rex & 1;
+		ctx.pp = rep == 0xF3 ? 2 : rep == 0xF2 ? 3 : ctx.opsize ? 1 : 0;
+
+		Map map = Map::OneByte;
+		Layout layout;
+		if (op == 0x0F)
+		{
+			if (!next(op))
+				return {};
+			if (op == 0x38 || op == 0x3A)
+			{
+				map = op == 0x38 ? Map::Map0F38 : Map::Map0F3A;
+				if (!next(op))
+					return {};
+				layout = {.modrm = true, .imm = static_cast<std::uint8_t>(map == Map::Map0F3A ? 1 : 0)};
+			}
+			else
+			{
+				map = Map::Map0F;
+				layout = map0f_layout(op, ctx);
+			}
+		}
+		else if ((op == 0xC4 || op == 0xC5 || op == 0x62) && (x64 || (pos < limit && code[pos] >= 0xC0)))
+		{
+			// VEX (C4 3-byte, C5 2-byte) or EVEX (62, 4-byte); no other prefix may come with them.
+			if (lock || rep != 0 || ctx.opsize || rex != 0)
+				return {};
+			std::uint8_t p0 = 0, p1 = 0, p2 = 0;
+			if (!next(p0))
+				return {};
+			std::uint8_t select = 1;
+			std::uint8_t vectorLength = 0;
+			// R, X and B are stored inverted, and ignored outside 64-bit mode.
+			if (x64)
+				rexR = (~p0 >> 7) & 1;
+			if (op == 0xC5)
+			{
+				vectorLength = (p0 >> 2) & 1;
+				ctx.pp = p0 & 3;
+			}
+			else
+			{
+				if (x64)
+				{
+					rexX = (~p0 >> 6) & 1;
+					rexB = (~p0 >> 5) & 1;
+				}
+				if (!next(p1))
+					return {};
+				ctx.rexW = (p1 & 0x80) != 0;
+				ctx.pp = p1 & 3;
+				if (op == 0xC4)
+				{
+					select = p0 & 0x1F;
+					vectorLength = (p1 >> 2) & 1;
+				}
+				else
+				{
+					if (!next(p2) || (p1 & 0x04) == 0)
+						return {};
+					select = p0 & 0x07;
+					vectorLength = (p2 >> 5) & 3;
+					ctx.evex = true;
+				}
+			}
+			switch (select)
+			{
+				case 1: map = Map::Map0F; break;
+				case 2: map = Map::Map0F38; break;
+				case 3: map = Map::Map0F3A; break;
+				case 5: map = ctx.evex ? Map::Map5 : map; break;
+				case 6: map = ctx.evex ? Map::Map6 : map; break;
+				default: return {};
+			}
+			if (map == Map::OneByte || vectorLength > 2)
+				return {};
+			ctx.vex = true;
+			ctx.opsize = ctx.pp == 1;
+			ctx.vector = static_cast<std::uint16_t>(16u << vectorLength);
+			if (!next(op))
+				return {};
+			layout = vex_layout(map, op, ctx.evex);
+		}
+		else
+		{
+			layout = one_byte_layout(op, ctx);
+		}
+		if (!layout.valid)
+			return {};
+
+		Instruction insn;
+		std::uint8_t reg = 0;
+		bool memory = false;
+		if (layout.modrm)
+		{
+			std::uint8_t modrm = 0;
+			if (!next(modrm))
+				return {};
+			const std::uint8_t mod = modrm >> 6;
+			const std::uint8_t rm = modrm & 7;
+			reg = (modrm >> 3) & 7;
+			memory = mod != 3;
+			std::size_t disp = 0;
+			Address& address = insn.address;
+			if (memory && !x64 && ctx.addrsize)
+			{
+				// 16-bit addressing: no SIB.
+				disp = mod == 1 ? 1 : mod == 2 || (mod == 0 && rm == 6) ? 2 : 0;
+			}
+			else if (memory)
+			{
+				address.known = true;
+				address.truncated = x64 == ctx.addrsize;
+				address.base = static_cast<std::int8_t>(rm | rexB << 3);
+				if (rm == 4)
+				{
+					std::uint8_t sib = 0;
+					if (!next(sib))
+						return {};
+					address.base = static_cast<std::int8_t>((sib & 7) | rexB << 3);
+					address.scale = static_cast<std::uint8_t>(1u << (sib >> 6));
+					if (const std::uint8_t index = ((sib >> 3) & 7) | rexX << 3; index != 4)
+						address.index = static_cast<std::int8_t>(index);
+					if (mod == 0 && (sib & 7) == 5)
+					{
+						disp = 4;
+						address.base = kNoRegister;
+					}
+				}
+				if (mod == 0 && rm == 5)
+				{
+					disp = 4; // RIP-relative in 64-bit mode
+					address.base = kNoRegister;
+					address.ripRelative = x64;
+				}
+				else if (mod == 1)
+					disp = 1;
+				else if (mod == 2)
+					disp = 4;
+			}
+			if (pos + disp > limit)
+				return {};
+			if (disp == 1)
+				address.disp = static_cast<std::int8_t>(code[pos]);
+			else if (disp == 2)
+				address.disp = static_cast<std::int16_t>(code[pos] | code[pos + 1] << 8);
+			else if (disp == 4)
+				address.disp = static_cast<std::int32_t>(code[pos] | code[pos + 1] << 8 | code[pos + 2] << 16 | static_cast<std::uint32_t>(code[pos + 3]) << 24);
+			pos += disp;
+			if (map == Map::OneByte && (op == 0xF6 || op == 0xF7) && reg <= 1)
+				layout.imm = op == 0xF6 ? 1 : ctx.opsize && !ctx.rexW ? 2 : 4;
+		}
+		pos += layout.imm;
+		if (pos > limit || (lock && !(memory && lockable(map, op, reg))))
+			return {};
+		insn.length = static_cast<std::uint8_t>(pos);
+		insn.locked = lock;
+
+		Shape shape;
+		if (!layout.modrm)
+			shape = map == Map::OneByte ? implicit_shape(op, ctx) : Shape{Access::None, 0};
+		else if (!memory)
+			shape = {Access::None, 0};
+		else
+		{
+			switch (map)
+			{
+				case Map::OneByte: shape = one_byte_shape(op, reg, ctx); break;
+				case Map::Map0F: shape = map0f_shape(op, reg, ctx); break;
+				case Map::Map0F38: shape = map0f38_shape(op, ctx); break;
+				case Map::Map0F3A: shape = map0f3a_shape(op, ctx); break;
+				default: shape = fp16_shape(map, op, ctx); break;
+			}
+			if (map == Map::OneByte && (op == 0x86 || op == 0x87))
+				insn.locked = true;
+		}
+		insn.access = shape.access;
+		insn.width = shape.width;
+		if (memory && !ctx.vex && (shape.access == Access::Load || shape.access == Access::Store))
+			insn.value = moved_value_of(map, op, reg, rex, code.subspan(pos - layout.imm, layout.imm));
+		else if (map == Map::OneByte && op >= 0xA0 && op <= 0xA3)
+			insn.value = {.known = true, .reg = 0, .highByte = false, .immediate = 0}; // moffs: al/ax/eax/rax
+
+		// The registers are read once the instruction retired: an address built on one it
+		// wrote is lost. Without REX, reg 4-7 of byte forms are AH..BH, parts of rax..rbx.
+		Address& address = insn.address;
+		const bool vsib = ctx.vex && map == Map::Map0F38 && ((op >= 0x90 && op <= 0x93) || (op >= 0xA0 && op <= 0xA3) || op == 0xC6 || op == 0xC7);
+		std::uint16_t written = memory ? implicit_writes(map, op, reg) : 0;
+		if (memory && writes_reg_field(map, op, shape.access))
+		{
+			written |= static_cast<std::uint16_t>(1u << (reg | rexR << 3));
+			const bool byteForm = map == Map::OneByte ? op == 0x86 || op == 0x8A || (op < 0x40 && (op & 7) == 2) : map == Map::Map0F && op == 0xC0;
+			if (byteForm && rex == 0 && reg >= 4)
+				written |= static_cast<std::uint16_t>(1u << (reg - 4));
+		}
+		const auto overwritten = [written](const std::int8_t r) { return r != kNoRegister && (written >> r & 1) != 0; };
+		if (!memory || segment || vsib || overwritten(address.base) || overwritten(address.index))
+			address.known = false;
+		return insn;
+	}
+
+	std::optional<std::uint64_t> effective_address(const Instruction& insn, const std::uint64_t ip, const std::span<const std::uint64_t, kRegisters> registers)
+	{
+		const Address& a = insn.address;
+		if (!a.known)
+			return std::nullopt;
+		std::uint64_t address = static_cast<std::uint64_t>(a.disp);
+		if (a.ripRelative)
+			address += ip;
+		if (a.base != kNoRegister)
+			address += registers[static_cast<std::size_t>(a.base)];
+		if (a.index != kNoRegister)
+			address += registers[static_cast<std::size_t>(a.index)] * a.scale;
+		return a.truncated ? address & 0xFFFFFFFFu : address;
+	}
+
+	std::optional<std::uint64_t> moved_value(const Instruction& insn, const std::span<const std::uint64_t, kRegisters> registers)
+	{
+		const MovedValue& v = insn.value;
+		if (!v.known || insn.width == 0 || insn.width > 8)
+			return std::nullopt;
+		std::uint64_t value = v.reg == kNoRegister ? v.immediate : registers[static_cast<std::size_t>(v.reg)];
+		if (v.highByte)
+			value >>= 8;
+		return insn.width == 8 ? value : value & ((std::uint64_t{1} << (8 * insn.width)) - 1);
+	}
+
+	void DecodeCache::decode_function(const std::uint64_t begin, const std::span<const std::uint8_t> code)
+	{
+		// A byte that does not decode (data in the text, an encoding this decoder lacks) loses
+		// the boundaries after it: the rest of the function stays unclassified.
+		for (std::size_t pos = 0; pos < code.size();)
+		{
+			const Instruction insn = decode(code.subspan(pos), m_x64);
+			if (insn.length == 0)
+				return;
+			pos += insn.length;
+			if (insn.access != Access::None)
+				m_entries.insert_or_assign(begin + pos, insn);
+		}
+	}
+}
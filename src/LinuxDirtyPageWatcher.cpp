@@ -0,0 +1,345 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "Logger.h"
+#include "Profiling.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		constexpr std::uint64_t kSoftDirty = 1ull << 55; // pagemap entry bit
+		constexpr std::size_t kMaxIov = IOV_MAX;
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		bool probe_soft_dirty()
+		{
+			// A page faulted in is soft-dirty, unless the kernel does not track the bit at all.
+			const long pageSize = sysconf(_SC_PAGESIZE);
+			void* page = mmap(nullptr, static_cast<std::size_t>(pageSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (page == MAP_FAILED)
+				return false;
+			*static_cast<volatile char*>(page) = 1;
+
+			std::uint64_t entry = 0;
+			const int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+			if (fd >= 0)
+			{
+				const auto offset = static_cast<off_t>(reinterpret_cast<std::uintptr_t>(page) / static_cast<std::uintptr_t>(pageSize) * sizeof(entry));
+				if (pread(fd, &entry, sizeof(entry), offset) != static_cast<ssize_t>(sizeof(entry)))
+					entry = 0;
+				::close(fd);
+			}
+			munmap(page, static_cast<std::size_t>(pageSize));
+			return (entry & kSoftDirty) != 0;
+		}
+	}
+
+	LinuxDirtyPageWatcher::LinuxDirtyPageWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> regions, std::vector<ResolvedSymbol> globals, const DirtyWatchOptions& options) :
+		m_pid(pid),
+		m_regions(std::move(regions)),
+		m_globals(std::move(globals)),
+		m_options(options),
+		m_pageSize(static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE)))
+	{
+		if (m_regions.empty())
+		{
+			throw MemoryWatchError("LinuxDirtyPageWatcher: no region to watch.");
+		}
+		for (const auto& region : m_regions)
+		{
+			if (region.size == 0)
+			{
+				throw MemoryWatchError("LinuxDirtyPageWatcher: '" + region.name + "' is empty.");
+			}
+		}
+		std::ranges::sort(m_regions, {}, &ResolvedSymbol::address);
+		std::ranges::sort(m_globals, {}, &ResolvedSymbol::address);
+		// A region that is itself a global names its changes better (it may carry the array element size).
+		std::erase_if(m_globals, [this](const ResolvedSymbol& global)
+		{
+			return std::ranges::any_of(m_regions, [&global](const ResolvedSymbol& region)
+			{
+				return region.address == global.address && region.size == global.size;
+			});
+		});
+
+		for (const auto& region : m_regions)
+		{
+			for (std::uint64_t page = region.address & ~(m_pageSize - 1); page < region.address + region.size; page += m_pageSize)
+				m_pages.push_back(page);
+		}
+		std::ranges::sort(m_pages);
+		m_pages.erase(std::ranges::unique(m_pages).begin(), m_pages.end());
+		m_shadow.resize(m_pages.size() * m_pageSize);
+	}
+
+	LinuxDirtyPageWatcher::~LinuxDirtyPageWatcher()
+	{
+		try { stop(); }
+		catch (...) {}
+		close_files();
+	}
+
+	bool LinuxDirtyPageWatcher::soft_dirty_supported()
+	{
+		static const bool supported = probe_soft_dirty();
+		return supported;
+	}
+
+	ContinueStatus LinuxDirtyPageWatcher::on_event(const DebugEvent& ev)
+	{
+		switch (ev.type)
+		{
+			case DebugEventType::_CreateProcess:
+				start();
+				return ContinueStatus::Default;
+
+			case DebugEventType::ExitProcess:
+				stop();
+				return ContinueStatus::Default;
+
+			default:
+				// The target is never stopped on our behalf.
+				return ContinueStatus::Default;
+		}
+	}
+
+	void LinuxDirtyPageWatcher::start()
+	{
+		if (m_started)
+			return;
+
+		if (soft_dirty_supported())
+		{
+			const std::string proc = "/proc/" + std::to_string(m_pid);
+			m_pagemapFd = open((proc + "/pagemap").c_str(), O_RDONLY | O_CLOEXEC);
+			m_clearRefsFd = open((proc + "/clear_refs").c_str(), O_WRONLY | O_CLOEXEC);
+			// Without access to either file, every page is diffed instead.
+			m_softDirty = m_pagemapFd >= 0 && m_clearRefsFd >= 0;
+			if (!m_softDirty)
+				close_files();
+		}
+		if (m_softDirty && pwrite(m_clearRefsFd, "4", 1, 0) != 1)
+		{
+			const int err = errno;
+			close_files();
+			throw MemoryWatchError("LinuxDirtyPageWatcher: clearing the soft-dirty bits failed: " + std::string(std::strerror(err)));
+		}
+
+		// The target is stopped: the shadow copy is a consistent baseline.
+		m_dirty.resize(m_pages.size());
+		for (std::uint32_t i = 0; i < m_dirty.size(); ++i)
+			m_dirty[i] = i;
+		read_pages(m_dirty, m_shadow);
+
+		m_stopRequested = false;
+		m_started = true;
+		m_scanThread = std::thread([this] { scan_loop(); });
+	}
+
+	void LinuxDirtyPageWatcher::stop()
+	{
+		if (!m_started)
+			return;
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopRequested = true;
+		}
+		m_wake.notify_one();
+		if (m_scanThread.joinable())
+			m_scanThread.join();
+
+		// The exiting target's memory is still mapped: diffing every page also catches the
+		// stores that raced with the last clear.
+		scan(true);
+		m_started = false;
+		close_files();
+	}
+
+	void LinuxDirtyPageWatcher::scan_loop()
+	{
+		std::unique_lock lock(m_mutex);
+		while (!m_wake.wait_for(lock, std::chrono::microseconds(m_options.interval_us), [this] { return m_stopRequested; }))
+		{
+			lock.unlock();
+			scan(false);
+			lock.lock();
+		}
+	}
+
+	void LinuxDirtyPageWatcher::scan(const bool full)
+	{
+		const std::uint64_t start = now_ns();
+		collect_dirty(full);
+		const std::uint64_t scanned = now_ns();
+
+		read_pages(m_dirty, m_fresh);
+		for (std::size_t i = 0; i < m_dirty.size(); ++i)
+			diff_page(m_dirty[i], m_fresh.data() + i * m_pageSize);
+		for (std::size_t i = 0; i < m_dirty.size(); ++i)
+			std::memcpy(m_shadow.data() + m_dirty[i] * m_pageSize, m_fresh.data() + i * m_pageSize, m_pageSize);
+
+		// Old values were taken before the shadow moved on; an element may span two dirty pages.
+		for (const Change& change : m_changes)
+		{
+			element_at(*change.owner, change.span.start, m_name);
+			Logger::log_write(m_name, change.old, shadow_value(change.owner->address + change.span.start, change.span.width));
+		}
+		m_changed.fetch_add(m_changes.size(), std::memory_order_relaxed);
+		m_changes.clear();
+
+		m_scans.fetch_add(1, std::memory_order_relaxed);
+		m_diffed.fetch_add(m_dirty.size(), std::memory_order_relaxed);
+		profiling::add_dirty_scan(m_pages.size(), m_dirty.size(), scanned - start, now_ns() - scanned);
+	}
+
+	void LinuxDirtyPageWatcher::collect_dirty(const bool full)
+	{
+		m_dirty.clear();
+		if (full || !m_softDirty)
+		{
+			for (std::uint32_t i = 0; i < m_pages.size(); ++i)
+				m_dirty.push_back(i);
+			return;
+		}
+
+		// One read per run of contiguous pages; an entry that cannot be read counts as dirty.
+		m_entries.assign(m_pages.size(), kSoftDirty);
+		for (std::size_t first = 0; first < m_pages.size();)
+		{
+			std::size_t last = first;
+			while (last + 1 < m_pages.size() && m_pages[last + 1] == m_pages[last] + m_pageSize)
+				++last;
+			const std::size_t bytes = (last - first + 1) * sizeof(std::uint64_t);
+			const auto offset = static_cast<off_t>(m_pages[first] / m_pageSize * sizeof(std::uint64_t));
+			if (pread(m_pagemapFd, m_entries.data() + first, bytes, offset) != static_cast<ssize_t>(bytes))
+				std::fill(m_entries.begin() + static_cast<std::ptrdiff_t>(first), m_entries.begin() + static_cast<std::ptrdiff_t>(last + 1), kSoftDirty);
+			first = last + 1;
+		}
+		for (std::uint32_t i = 0; i < m_entries.size(); ++i)
+		{
+			if (m_entries[i] & kSoftDirty)
+				m_dirty.push_back(i);
+		}
+
+		// A store landing between the read above and this clear is only seen with the next store
+		// to its page (or the final scan); clearing first would lose every store of the interval.
+		if (pwrite(m_clearRefsFd, "4", 1, 0) != 1)
+		{
+			// The target is gone or the file was revoked: diff everything from now on.
+			m_softDirty = false;
+		}
+	}
+
+	void LinuxDirtyPageWatcher::read_pages(const std::vector<std::uint32_t>& pages, std::vector<std::byte>& out) const
+	{
+		out.resize(pages.size() * m_pageSize);
+		std::vector<iovec> remote(std::min(pages.size(), kMaxIov));
+		for (std::size_t done = 0; done < pages.size();)
+		{
+			const std::size_t count = std::min(pages.size() - done, kMaxIov);
+			for (std::size_t i = 0; i < count; ++i)
+				remote[i] = iovec{.iov_base = reinterpret_cast<void*>(m_pages[pages[done + i]]), .iov_len = m_pageSize};
+			const iovec local{.iov_base = out.data() + done * m_pageSize, .iov_len = count * m_pageSize};
+
+			const ssize_t n = process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, remote.data(), count, 0);
+			const std::size_t full = n > 0 ? static_cast<std::size_t>(n) / m_pageSize : 0;
+			done += full;
+			if (full < count)
+			{
+				// The page was unmapped: keep its previous contents so that it shows no change.
+				if (&out != &m_shadow)
+					std::memcpy(out.data() + done * m_pageSize, m_shadow.data() + pages[done] * m_pageSize, m_pageSize);
+				++done;
+			}
+		}
+	}
+
+	void LinuxDirtyPageWatcher::diff_page(const std::uint32_t page, const std::byte* fresh)
+	{
+		const std::byte* old = m_shadow.data() + page * m_pageSize;
+		for (std::uint64_t word = 0; word < m_pageSize; word += 8)
+		{
+			if (std::memcmp(old + word, fresh + word, 8) == 0)
+				continue;
+			for (std::uint64_t byte = word; byte < word + 8; ++byte)
+			{
+				if (old[byte] == fresh[byte])
+					continue;
+				const std::uint64_t address = m_pages[page] + byte;
+				const ResolvedSymbol* owner = owner_of(address);
+				if (!owner)
+					continue;
+				const ElementSpan span = element_at(*owner, address - owner->address, m_name);
+				if (!m_changes.empty() && m_changes.back().owner == owner && m_changes.back().span.start == span.start)
+					continue;
+				m_changes.push_back(Change{.owner = owner, .span = span, .old = shadow_value(owner->address + span.start, span.width)});
+			}
+		}
+	}
+
+	const ResolvedSymbol* LinuxDirtyPageWatcher::owner_of(const std::uint64_t address) const
+	{
+		const auto after = [address](const std::vector<ResolvedSymbol>& objects) -> const ResolvedSymbol*
+		{
+			const auto it = std::ranges::upper_bound(objects, address, {}, &ResolvedSymbol::address);
+			if (it == objects.begin() || address >= std::prev(it)->address + std::prev(it)->size)
+				return nullptr;
+			return &*std::prev(it);
+		};
+
+		// Bytes of the page outside every region are not watched.
+		const ResolvedSymbol* region = after(m_regions);
+		if (!region)
+			return nullptr;
+		const ResolvedSymbol* global = after(m_globals);
+		return global ? global : region;
+	}
+
+	std::uint64_t LinuxDirtyPageWatcher::shadow_value(const std::uint64_t address, const std::uint32_t width) const
+	{
+		std::byte bytes[8] = {};
+		for (std::uint32_t i = 0; i < width;)
+		{
+			const std::uint64_t at = address + i;
+			const std::uint64_t page = at & ~(m_pageSize - 1);
+			const std::uint64_t chunk = std::min<std::uint64_t>(width - i, page + m_pageSize - at);
+			if (const auto it = std::ranges::lower_bound(m_pages, page); it != m_pages.end() && *it == page)
+			{
+				const auto index = static_cast<std::uint64_t>(it - m_pages.begin());
+				std::memcpy(bytes + i, m_shadow.data() + index * m_pageSize + (at - page), chunk);
+			}
+			i += static_cast<std::uint32_t>(chunk);
+		}
+		std::uint64_t value = 0;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	void LinuxDirtyPageWatcher::close_files()
+	{
+		if (m_pagemapFd >= 0)
+			::close(m_pagemapFd);
+		if (m_clearRefsFd >= 0)
+			::close(m_clearRefsFd);
+		m_pagemapFd = -1;
+		m_clearRefsFd = -1;
+	}
+}
+#endif
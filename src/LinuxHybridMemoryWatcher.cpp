@@ -0,0 +1,399 @@
+#ifdef __linux__
+#include <linux/hw_breakpoint.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "DebugRegisters.h"
+#include "Logger.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		int perf_event_open(perf_event_attr* attr, const pid_t pid, const int cpu)
+		{
+			return static_cast<int>(syscall(SYS_perf_event_open, attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+		}
+
+		// Offset of DR<index> in struct user, as PTRACE_PEEKUSER / PTRACE_POKEUSER expect it.
+		void* debugreg(const std::size_t index)
+		{
+			return reinterpret_cast<void*>(offsetof(struct user, u_debugreg) + index * sizeof(long));
+		}
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		std::string errno_string()
+		{
+			return std::strerror(errno);
+		}
+	}
+
+	LinuxHybridMemoryWatcher::LinuxHybridMemoryWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const HybridWatchOptions& options) :
+		m_pid(pid),
+		m_options(options),
+		m_functions(pid)
+	{
+		if (m_pid == 0)
+		{
+			throw MemoryWatchError("LinuxHybridMemoryWatcher: invalid pid (0).");
+		}
+		if (resolvedSymbols.empty() || resolvedSymbols.size() > kMaxPlannedVariables)
+		{
+			throw MemoryWatchError("LinuxHybridMemoryWatcher: between 1 and " + std::to_string(kMaxPlannedVariables) + " variables can be watched.");
+		}
+		for (const auto& symbol : resolvedSymbols)
+		{
+			if (!(symbol.size == 4 || symbol.size == 8))
+			{
+				throw MemoryWatchError("LinuxHybridMemoryWatcher: size must be 4 or 8 bytes.");
+			}
+		}
+
+		m_plan = compile_watch_plan(resolvedSymbols, kSlots);
+		for (const auto& slot : m_plan.slots)
+		{
+			std::string name;
+			for (std::uint64_t vars = slot.variables; vars != 0; vars &= vars - 1)
+			{
+				if (!name.empty())
+					name += ',';
+				name += resolvedSymbols[static_cast<std::size_t>(std::countr_zero(vars))].name;
+			}
+			m_slotNames.push_back(std::move(name));
+		}
+		for (auto& symbol : resolvedSymbols)
+			m_watched.push_back(Watched{.symbol = std::move(symbol)});
+		m_values.resize(m_watched.size());
+		if (m_options.hot_sites)
+			m_hotSites.emplace();
+	}
+
+	LinuxHybridMemoryWatcher::~LinuxHybridMemoryWatcher()
+	{
+		try { stop(); }
+		catch (...) {}
+	}
+
+	ContinueStatus LinuxHybridMemoryWatcher::on_event(const DebugEvent& ev)
+	{
+		using T = DebugEventType;
+		switch (ev.type)
+		{
+			case T::_CreateProcess:
+				read_values();
+				for (std::size_t i = 0; i < m_watched.size(); ++i)
+					m_watched[i].lastValue = m_values[i];
+				arm_thread(ev.thread_id);
+				m_startNs = now_ns();
+				if (m_options.summary_interval_ms > 0 && !m_summaryThread.joinable())
+					m_summaryThread = std::thread([this] { summary_loop(); });
+				return ContinueStatus::Default;
+
+			case T::CreateThread:
+				// Debug registers set through ptrace are not inherited by clone().
+				arm_thread(ev.thread_id);
+				return ContinueStatus::Default;
+
+			case T::ExitThread:
+				release_thread(ev.thread_id);
+				return ContinueStatus::Default;
+
+			case T::ExitProcess:
+				stop();
+				return ContinueStatus::Default;
+
+			case T::Exception:
+				if (const auto& ex = std::get<ExceptionInfo>(ev.payload); ex.code == SIGTRAP)
+					return on_trap(ev.thread_id, ex.address);
+				return ContinueStatus::Default;
+
+			default:
+				return ContinueStatus::Default;
+		}
+	}
+
+	std::vector<LinuxHybridMemoryWatcher::ThreadCounts> LinuxHybridMemoryWatcher::counts() const
+	{
+		std::lock_guard lock(m_mutex);
+		std::vector<ThreadCounts> out;
+		out.reserve(m_threads.size());
+		for (const auto& thread : m_threads)
+			out.push_back(thread.counts);
+		return out;
+	}
+
+	void LinuxHybridMemoryWatcher::arm_thread(const std::uint32_t tid)
+	{
+		const auto pid = static_cast<pid_t>(tid);
+		std::array<dr::Slot, kSlots> slots{};
+		for (std::size_t i = 0; i < m_plan.slots.size(); ++i)
+		{
+			slots[i] = dr::Slot{.address = m_plan.slots[i].address, .size = m_plan.slots[i].size, .trigger = dr::Trigger::Write};
+			if (ptrace(PTRACE_POKEUSER, pid, debugreg(i), reinterpret_cast<void*>(slots[i].address)) != 0)
+			{
+				throw MemoryWatchError("PTRACE_POKEUSER(DR" + std::to_string(i) + ") failed for thread " + std::to_string(tid) + ": " + errno_string());
+			}
+		}
+		const std::uint64_t dr7 = dr::encode_dr7(0, std::span(slots.data(), m_plan.slots.size()));
+		if (ptrace(PTRACE_POKEUSER, pid, debugreg(7), reinterpret_cast<void*>(dr7)) != 0)
+		{
+			throw MemoryWatchError("PTRACE_POKEUSER(DR7) failed for thread " + std::to_string(tid) + ": " + errno_string());
+		}
+
+		Thread thread;
+		thread.counts.tid = tid;
+		for (std::size_t i = 0; i < m_plan.slots.size(); ++i)
+		{
+			// No sample period: the kernel only counts, the thread is never stopped.
+			perf_event_attr attr{};
+			attr.type = PERF_TYPE_BREAKPOINT;
+			attr.size = sizeof(attr);
+			attr.bp_type = HW_BREAKPOINT_RW;
+			attr.bp_addr = m_plan.slots[i].address;
+			attr.bp_len = m_plan.slots[i].size;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			thread.counters[i] = perf_event_open(&attr, pid, -1);
+			if (thread.counters[i] < 0)
+			{
+				const std::string error = errno_string();
+				for (const int fd : thread.counters)
+				{
+					if (fd >= 0)
+						::close(fd);
+				}
+				throw MemoryWatchError("perf_event_open(read counter) failed for thread " + std::to_string(tid) + ": " + error);
+			}
+		}
+
+		std::lock_guard lock(m_mutex);
+		m_threads.push_back(thread);
+	}
+
+	void LinuxHybridMemoryWatcher::release_thread(const std::uint32_t tid)
+	{
+		std::lock_guard lock(m_mutex);
+		const auto it = std::ranges::find(m_threads, tid, [](const Thread& t) { return t.counts.tid; });
+		if (it == m_threads.end())
+			return;
+		// The exiting thread can still be read: keep its final counts.
+		refresh_reads(*it);
+		for (int& fd : it->counters)
+		{
+			if (fd >= 0)
+				::close(fd);
+			fd = -1;
+		}
+	}
+
+	ContinueStatus LinuxHybridMemoryWatcher::on_trap(const std::uint32_t tid, const std::uint64_t ip)
+	{
+		const auto pid = static_cast<pid_t>(tid);
+		errno = 0;
+		const long dr6 = ptrace(PTRACE_PEEKUSER, pid, debugreg(6), nullptr);
+		const std::uint32_t fired = errno == 0 ? dr::triggered_slots(static_cast<std::uint64_t>(dr6)) & ((1u << m_plan.slots.size()) - 1) : 0;
+		if (fired == 0)
+			return ContinueStatus::Default;
+		ptrace(PTRACE_POKEUSER, pid, debugreg(6), reinterpret_cast<void*>(dr::clear_triggered(static_cast<std::uint64_t>(dr6))));
+
+		read_values();
+		const x86::Instruction insn = classify(ip);
+		const std::uint64_t site = x86::access_site(insn, ip);
+		std::optional<std::uint64_t> address;
+		bool addressRead = false;
+		std::array<std::uint64_t, kSlots> writes{};
+		for (std::uint32_t bits = fired; bits != 0; bits &= bits - 1)
+		{
+			const auto slot = static_cast<std::size_t>(std::countr_zero(bits));
+			++writes[slot];
+
+			// On a shared slot the address of the store names the variable. Without it, the
+			// variables that changed were written: the target stops on every store.
+			const std::uint64_t variables = m_plan.slots[slot].variables;
+			const bool shared = !std::has_single_bit(variables);
+			if (shared && !addressRead)
+			{
+				address = trap_address(tid, insn, ip);
+				addressRead = true;
+			}
+			std::uint64_t targets = attribute_access(variables, address, insn.width, [this](const std::size_t v) -> const ResolvedSymbol& { return m_watched[v].symbol; });
+			if (shared && !address)
+			{
+				for (std::uint64_t vars = variables; vars != 0; vars &= vars - 1)
+				{
+					const auto v = static_cast<std::size_t>(std::countr_zero(vars));
+					if (m_values[v] != m_watched[v].lastValue)
+						targets |= 1ull << v;
+				}
+				if (targets == 0)
+				{
+					++m_unattributed;
+					continue;
+				}
+			}
+			for (std::uint64_t vars = targets; vars != 0; vars &= vars - 1)
+			{
+				const auto v = static_cast<std::size_t>(std::countr_zero(vars));
+				Logger::log_write(m_watched[v].symbol.name, m_watched[v].lastValue, m_values[v], tid, 0, site);
+				m_watched[v].lastValue = m_values[v];
+			}
+			if (m_hotSites && targets != 0)
+				m_hotSites->record(site, AccessKind::Write, tid, targets);
+		}
+
+		std::lock_guard lock(m_mutex);
+		if (const auto it = std::ranges::find(m_threads, tid, [](const Thread& t) { return t.counts.tid; }); it != m_threads.end())
+		{
+			for (std::size_t i = 0; i < kSlots; ++i)
+				it->counts.writes[i] += writes[i];
+		}
+		return ContinueStatus::Continue;
+	}
+
+	x86::Instruction LinuxHybridMemoryWatcher::classify(const std::uint64_t ip)
+	{
+		// The trap IP follows the store; only the first trap in a function reads the target's code.
+		const auto read = [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+		{
+			iovec local{.iov_base = out, .iov_len = size};
+			iovec remote{.iov_base = reinterpret_cast<void*>(address), .iov_len = size};
+			return process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+		};
+		return m_decodeCache.classify(ip, [this](const std::uint64_t address) { return m_functions.find(address); }, read);
+	}
+
+	std::optional<std::uint64_t> LinuxHybridMemoryWatcher::trap_address(const std::uint32_t tid, const x86::Instruction& insn, const std::uint64_t ip) const
+	{
+		user_regs_struct regs{};
+		if (!insn.address.known || ptrace(PTRACE_GETREGS, static_cast<pid_t>(tid), nullptr, &regs) != 0)
+			return std::nullopt;
+		const std::array<std::uint64_t, x86::kRegisters> registers = {
+			regs.rax, regs.rcx, regs.rdx, regs.rbx, regs.rsp, regs.rbp, regs.rsi, regs.rdi,
+			regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15,
+		};
+		return x86::effective_address(insn, ip, registers);
+	}
+
+	void LinuxHybridMemoryWatcher::read_values()
+	{
+		std::vector<iovec> local(m_watched.size());
+		std::vector<iovec> remote(m_watched.size());
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
+		{
+			m_values[i] = 0;
+			local[i] = iovec{.iov_base = &m_values[i], .iov_len = m_watched[i].symbol.size};
+			remote[i] = iovec{.iov_base = reinterpret_cast<void*>(m_watched[i].symbol.address), .iov_len = m_watched[i].symbol.size};
+		}
+		if (process_vm_readv(static_cast<pid_t>(m_pid), local.data(), local.size(), remote.data(), remote.size(), 0) < 0)
+		{
+			throw MemoryWatchError("LinuxHybridMemoryWatcher: process_vm_readv failed: " + errno_string());
+		}
+	}
+
+	void LinuxHybridMemoryWatcher::refresh_reads(Thread& thread) const
+	{
+		for (std::size_t i = 0; i < kSlots; ++i)
+		{
+			std::uint64_t accesses = 0;
+			if (thread.counters[i] < 0 || ::read(thread.counters[i], &accesses, sizeof(accesses)) != sizeof(accesses))
+				continue;
+			// A write is counted as soon as it retires but only known here once its trap was
+			// handled: never let the difference go back down.
+			const std::uint64_t writes = thread.counts.writes[i];
+			thread.counts.reads[i] = std::max(thread.counts.reads[i], accesses > writes ? accesses - writes : 0);
+		}
+	}
+
+	void LinuxHybridMemoryWatcher::summary_loop()
+	{
+		std::unique_lock lock(m_mutex);
+		while (!m_wake.wait_for(lock, std::chrono::milliseconds(m_options.summary_interval_ms), [this] { return m_stopRequested; }))
+		{
+			lock.unlock();
+			print_summary(false);
+			lock.lock();
+		}
+	}
+
+	void LinuxHybridMemoryWatcher::print_summary(const bool final)
+	{
+		std::ostringstream oss;
+		{
+			std::lock_guard lock(m_mutex);
+			const std::uint64_t elapsedMs = (now_ns() - m_startNs) / 1'000'000;
+			for (auto& thread : m_threads)
+			{
+				refresh_reads(thread);
+				if (final)
+				{
+					oss << "reads: total tid=" << thread.counts.tid;
+					for (std::size_t i = 0; i < m_plan.slots.size(); ++i)
+						oss << " " << m_slotNames[i] << "=" << thread.counts.reads[i];
+					oss << "\n";
+					continue;
+				}
+				// Periodic lines only for the threads that read something since the last one.
+				if (std::ranges::equal(thread.counts.reads, thread.reported))
+					continue;
+				oss << "reads: t=" << elapsedMs << "ms tid=" << thread.counts.tid;
+				for (std::size_t i = 0; i < m_plan.slots.size(); ++i)
+					oss << " " << m_slotNames[i] << "=" << thread.counts.reads[i] << " (+" << thread.counts.reads[i] - thread.reported[i] << ")";
+				oss << "\n";
+				thread.reported = thread.counts.reads;
+			}
+		}
+		std::cerr << oss.str();
+	}
+
+	void LinuxHybridMemoryWatcher::stop()
+	{
+		if (m_startNs == 0)
+			return;
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopRequested = true;
+		}
+		m_wake.notify_one();
+		if (m_summaryThread.joinable())
+			m_summaryThread.join();
+
+		print_summary(true);
+		{
+			std::lock_guard lock(m_mutex);
+			for (auto& thread : m_threads)
+			{
+				for (int& fd : thread.counters)
+				{
+					if (fd >= 0)
+						::close(fd);
+					fd = -1;
+				}
+			}
+		}
+		m_startNs = 0;
+	}
+}
+#endif
@@ -0,0 +1,207 @@
+#ifdef __linux__
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "DebugRegisters.h"
+#include "Logger.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		// Offset of DR<index> in struct user, as PTRACE_PEEKUSER / PTRACE_POKEUSER expect it.
+		void* debugreg(const std::size_t index)
+		{
+			return reinterpret_cast<void*>(offsetof(struct user, u_debugreg) + index * sizeof(long));
+		}
+
+		std::string errno_string()
+		{
+			return std::strerror(errno);
+		}
+	}
+
+	LinuxMemoryWatcher::LinuxMemoryWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const bool hotSites) :
+		m_pid(pid),
+		m_functions(pid)
+	{
+		if (m_pid == 0)
+		{
+			throw MemoryWatchError("LinuxMemoryWatcher: invalid pid (0).");
+		}
+		if (resolvedSymbols.empty() || resolvedSymbols.size() > kMaxPlannedVariables)
+		{
+			throw MemoryWatchError("LinuxMemoryWatcher: between 1 and " + std::to_string(kMaxPlannedVariables) + " variables can be watched.");
+		}
+		for (const auto& symbol : resolvedSymbols)
+		{
+			if (!(symbol.size == 4 || symbol.size == 8))
+			{
+				throw MemoryWatchError("LinuxMemoryWatcher: size must be 4 or 8 bytes.");
+			}
+		}
+
+		m_plan = compile_watch_plan(resolvedSymbols, dr::kSlotCount);
+		for (auto& symbol : resolvedSymbols)
+			m_watched.push_back(Watched{.symbol = std::move(symbol)});
+		m_values.resize(m_watched.size());
+		if (hotSites)
+			m_hotSites.emplace();
+	}
+
+	ContinueStatus LinuxMemoryWatcher::on_event(const DebugEvent& ev)
+	{
+		using T = DebugEventType;
+		switch (ev.type)
+		{
+			case T::_CreateProcess:
+				read_values();
+				for (std::size_t i = 0; i < m_watched.size(); ++i)
+					m_watched[i].lastValue = m_values[i];
+				arm_thread(ev.thread_id);
+				return ContinueStatus::Default;
+
+			case T::CreateThread:
+				// Debug registers set through ptrace are not inherited by clone().
+				arm_thread(ev.thread_id);
+				return ContinueStatus::Default;
+
+			case T::Exception:
+				if (const auto& ex = std::get<ExceptionInfo>(ev.payload); ex.code == SIGTRAP)
+					return on_trap(ev.thread_id, ex.address);
+				return ContinueStatus::Default;
+
+			default:
+				return ContinueStatus::Default;
+		}
+	}
+
+	void LinuxMemoryWatcher::arm_thread(const std::uint32_t tid)
+	{
+		const auto pid = static_cast<pid_t>(tid);
+		std::array<dr::Slot, dr::kSlotCount> slots{};
+		for (std::size_t i = 0; i < m_plan.slots.size(); ++i)
+		{
+			slots[i] = dr::Slot{.address = m_plan.slots[i].address, .size = m_plan.slots[i].size, .trigger = dr::Trigger::ReadWrite};
+			if (ptrace(PTRACE_POKEUSER, pid, debugreg(i), reinterpret_cast<void*>(slots[i].address)) != 0)
+			{
+				throw MemoryWatchError("PTRACE_POKEUSER(DR" + std::to_string(i) + ") failed for thread " + std::to_string(tid) + ": " + errno_string());
+			}
+		}
+		const std::uint64_t dr7 = dr::encode_dr7(0, std::span(slots.data(), m_plan.slots.size()));
+		if (ptrace(PTRACE_POKEUSER, pid, debugreg(7), reinterpret_cast<void*>(dr7)) != 0)
+		{
+			throw MemoryWatchError("PTRACE_POKEUSER(DR7) failed for thread " + std::to_string(tid) + ": " + errno_string());
+		}
+	}
+
+	ContinueStatus LinuxMemoryWatcher::on_trap(const std::uint32_t tid, const std::uint64_t ip)
+	{
+		// A trap none of our slots explains (e.g. the target tracing itself) is not ours to log.
+		const auto pid = static_cast<pid_t>(tid);
+		errno = 0;
+		const long dr6 = ptrace(PTRACE_PEEKUSER, pid, debugreg(6), nullptr);
+		const std::uint32_t fired = errno == 0 ? dr::triggered_slots(static_cast<std::uint64_t>(dr6)) & ((1u << m_plan.slots.size()) - 1) : 0;
+		if (fired == 0)
+			return ContinueStatus::Default;
+		ptrace(PTRACE_POKEUSER, pid, debugreg(6), reinterpret_cast<void*>(dr::clear_triggered(static_cast<std::uint64_t>(dr6))));
+
+		read_values();
+
+		// On a shared slot the address of the access names the variable. Without it, the
+		// variables that changed were written: every access traps.
+		const std::uint64_t candidates = m_plan.variables_of(fired);
+		const bool shared = !std::has_single_bit(candidates);
+		std::uint64_t changed = 0;
+		for (std::uint64_t vars = candidates; vars != 0; vars &= vars - 1)
+		{
+			const auto v = static_cast<std::size_t>(std::countr_zero(vars));
+			if (m_values[v] != m_watched[v].lastValue)
+				changed |= 1ull << v;
+		}
+
+		// The trap fires after the access: the instruction that made it says what it was, so a
+		// store of the same value or a read-modify-write netting to zero is still a write.
+		const x86::Instruction insn = classify(ip);
+		const std::optional<std::uint64_t> address = shared ? trap_address(tid, insn, ip) : std::nullopt;
+		std::uint64_t targets = attribute_access(candidates, address, insn.width, [this](const std::size_t v) -> const ResolvedSymbol& { return m_watched[v].symbol; });
+		if (shared && !address)
+			targets = changed;
+		const x86::Access access = insn.access;
+		const bool write = access == x86::Access::Store || access == x86::Access::ReadModifyWrite || (access == x86::Access::Unknown && (changed & targets));
+		const std::uint64_t site = x86::access_site(insn, ip);
+		if (targets == 0 && !address)
+			++m_unattributed;
+		if (m_hotSites && targets != 0)
+			m_hotSites->record(site, write ? AccessKind::Write : AccessKind::Read, tid, targets);
+		for (std::uint64_t vars = targets; vars != 0; vars &= vars - 1)
+		{
+			const auto v = static_cast<std::size_t>(std::countr_zero(vars));
+			auto& w = m_watched[v];
+			if (write)
+				Logger::log_write(w.symbol.name, w.lastValue, m_values[v], tid, 0, site);
+			else
+				Logger::log_read(w.symbol.name, m_values[v], tid, 0, site);
+			w.lastValue = m_values[v];
+		}
+		return ContinueStatus::Continue;
+	}
+
+	x86::Instruction LinuxMemoryWatcher::classify(const std::uint64_t ip)
+	{
+		// The trap IP follows the access; only the first trap in a function reads the target's code.
+		const auto read = [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+		{
+			iovec local{.iov_base = out, .iov_len = size};
+			iovec remote{.iov_base = reinterpret_cast<void*>(address), .iov_len = size};
+			return process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+		};
+		return m_decodeCache.classify(ip, [this](const std::uint64_t address) { return m_functions.find(address); }, read);
+	}
+
+	std::optional<std::uint64_t> LinuxMemoryWatcher::trap_address(const std::uint32_t tid, const x86::Instruction& insn, const std::uint64_t ip) const
+	{
+		user_regs_struct regs{};
+		if (!insn.address.known || ptrace(PTRACE_GETREGS, static_cast<pid_t>(tid), nullptr, &regs) != 0)
+			return std::nullopt;
+		const std::array<std::uint64_t, x86::kRegisters> registers = {
+			regs.rax, regs.rcx, regs.rdx, regs.rbx, regs.rsp, regs.rbp, regs.rsi, regs.rdi,
+			regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15,
+		};
+		return x86::effective_address(insn, ip, registers);
+	}
+
+	void LinuxMemoryWatcher::read_values()
+	{
+		std::array<iovec, kMaxPlannedVariables> local;
+		std::array<iovec, kMaxPlannedVariables> remote;
+		std::size_t bytes = 0;
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
+		{
+			m_values[i] = 0;
+			local[i] = iovec{.iov_base = &m_values[i], .iov_len = m_watched[i].symbol.size};
+			remote[i] = iovec{.iov_base = reinterpret_cast<void*>(m_watched[i].symbol.address), .iov_len = m_watched[i].symbol.size};
+			bytes += m_watched[i].symbol.size;
+		}
+		// A failing remote range ends the transfer early: a short read leaves values unknown.
+		const auto count = static_cast<unsigned long>(m_watched.size());
+		const ssize_t n = process_vm_readv(static_cast<pid_t>(m_pid), local.data(), count, remote.data(), count, 0);
+		if (n != static_cast<ssize_t>(bytes))
+		{
+			throw MemoryWatchError("LinuxMemoryWatcher: process_vm_readv read " + std::to_string(n) + " of " + std::to_string(bytes) + " bytes: " + (n < 0 ? errno_string() : std::string("short read")));
+		}
+	}
+}
+#endif
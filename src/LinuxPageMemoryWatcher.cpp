@@ -0,0 +1,448 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "Logger.h"
+#include "Profiling.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		constexpr std::uint8_t kSyscall[2] = {0x0f, 0x05};
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		std::string errno_string(const int err)
+		{
+			return std::strerror(err) + std::string(" (errno=") + std::to_string(err) + ")";
+		}
+
+		struct Mapping
+		{
+			std::uint64_t begin = 0;
+			std::uint64_t end = 0;
+			int prot = 0;
+			std::string name;
+		};
+
+		std::vector<Mapping> read_maps(const std::uint32_t pid)
+		{
+			std::vector<Mapping> maps;
+			std::ifstream in("/proc/" + std::to_string(pid) + "/maps");
+			std::string line;
+			while (std::getline(in, line))
+			{
+				// begin-end perms offset dev inode [name]
+				std::istringstream fields(line);
+				std::string range;
+				std::string perms;
+				std::string skip;
+				fields >> range >> perms >> skip >> skip >> skip;
+				Mapping m;
+				const auto dash = range.find('-');
+				m.begin = std::stoull(range.substr(0, dash), nullptr, 16);
+				m.end = std::stoull(range.substr(dash + 1), nullptr, 16);
+				m.prot = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) | (perms[2] == 'x' ? PROT_EXEC : 0);
+				std::getline(fields >> std::ws, m.name);
+				maps.push_back(std::move(m));
+			}
+			return maps;
+		}
+
+		// Any existing syscall instruction serves as the entry point of injected calls, so no
+		// code is patched (other threads may be executing the code around the stopped one).
+		// The vDSO and the dynamic loader are mapped from the first instruction on.
+		std::uint64_t find_syscall_instruction(const std::uint32_t pid, const std::vector<Mapping>& maps)
+		{
+			const int fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				return 0;
+
+			std::vector<const Mapping*> code;
+			for (const auto& m : maps)
+			{
+				if (m.prot & PROT_EXEC)
+					code.push_back(&m);
+			}
+			std::ranges::stable_partition(code, [](const Mapping* m) { return m->name == "[vdso]"; });
+
+			std::uint64_t found = 0;
+			std::vector<std::uint8_t> chunk(64 * 1024);
+			for (const Mapping* m : code)
+			{
+				for (std::uint64_t at = m->begin; at < m->end && found == 0; at += chunk.size() - 1)
+				{
+					const auto want = static_cast<std::size_t>(std::min<std::uint64_t>(chunk.size(), m->end - at));
+					const ssize_t n = pread(fd, chunk.data(), want, static_cast<off_t>(at));
+					if (n < 2)
+						break;
+					const auto end = chunk.begin() + n;
+					if (const auto it = std::search(chunk.begin(), end, std::begin(kSyscall), std::end(kSyscall)); it != end)
+						found = at + static_cast<std::uint64_t>(it - chunk.begin());
+				}
+				if (found != 0)
+					break;
+			}
+			close(fd);
+			return found;
+		}
+
+		// Runs syscall nr(a0, a1, a2) in the stopped thread tid and restores its registers.
+		// Signals that show up meanwhile are appended to deferred (re-raised by the caller).
+		// Returns the syscall result (-errno on failure).
+		long remote_syscall(const int tid, const std::uint64_t entry, const long nr, const std::uint64_t a0, const std::uint64_t a1, const std::uint64_t a2, std::vector<int>& deferred)
+		{
+#if defined(__x86_64__)
+			user_regs_struct saved{};
+			if (ptrace(PTRACE_GETREGS, tid, nullptr, &saved) != 0)
+				return -errno;
+
+			user_regs_struct regs = saved;
+			regs.rip = entry;
+			regs.rax = static_cast<std::uint64_t>(nr);
+			regs.orig_rax = ~0ull; // not inside a syscall: no restart logic on the way out
+			regs.rdi = a0;
+			regs.rsi = a1;
+			regs.rdx = a2;
+			if (ptrace(PTRACE_SETREGS, tid, nullptr, &regs) != 0)
+				return -errno;
+
+			long result = -EIO;
+			while (true)
+			{
+				if (ptrace(PTRACE_SINGLESTEP, tid, nullptr, nullptr) != 0)
+				{
+					result = -errno;
+					break;
+				}
+				int status = 0;
+				int r;
+				do
+				{
+					r = waitpid(tid, &status, __WALL);
+				} while (r < 0 && errno == EINTR);
+				// Gone or exiting: the launcher sees the rest through its own waitpid.
+				if (r < 0 || !WIFSTOPPED(status) || (status >> 16) == PTRACE_EVENT_EXIT)
+					return -ESRCH;
+				if (WSTOPSIG(status) == SIGTRAP && (status >> 16) == 0)
+				{
+					ptrace(PTRACE_GETREGS, tid, nullptr, &regs);
+					result = static_cast<long>(regs.rax);
+					break;
+				}
+				// A signal arrived before the instruction ran: keep it for later and step again.
+				deferred.push_back(WSTOPSIG(status));
+			}
+			ptrace(PTRACE_SETREGS, tid, nullptr, &saved);
+			return result;
+#else
+			(void)tid; (void)entry; (void)nr; (void)a0; (void)a1; (void)a2; (void)deferred;
+			return -ENOSYS;
+#endif
+		}
+	}
+
+	LinuxPageMemoryWatcher::LinuxPageMemoryWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols) :
+		IMemoryWatcher(),
+		m_pid(pid),
+		m_objects(std::move(resolvedSymbols))
+	{
+		if (m_pid == 0)
+		{
+			throw MemoryWatchError("LinuxPageMemoryWatcher: invalid pid (0).");
+		}
+		if (m_objects.empty())
+		{
+			throw MemoryWatchError("LinuxPageMemoryWatcher: no object to watch.");
+		}
+		for (const auto& object : m_objects)
+		{
+			if (object.size == 0)
+			{
+				throw MemoryWatchError("LinuxPageMemoryWatcher: \"" + object.name + "\" has a size of 0.");
+			}
+		}
+		std::ranges::sort(m_objects, {}, &ResolvedSymbol::address);
+		m_pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+		// Pages to protect: the union of the objects' pages.
+		for (const auto& object : m_objects)
+		{
+			const std::uint64_t begin = object.address & ~(m_pageSize - 1);
+			const std::uint64_t end = (object.address + object.size + m_pageSize - 1) & ~(m_pageSize - 1);
+			if (!m_ranges.empty() && begin <= m_ranges.back().end)
+				m_ranges.back().end = std::max(m_ranges.back().end, end);
+			else
+				m_ranges.push_back(Range{.begin = begin, .end = end});
+		}
+	}
+
+	std::size_t LinuxPageMemoryWatcher::protected_pages() const
+	{
+		std::size_t pages = 0;
+		for (const auto& range : m_ranges)
+			pages += (range.end - range.begin) / m_pageSize;
+		return m_armed ? pages : 0;
+	}
+
+	ContinueStatus LinuxPageMemoryWatcher::on_event(const DebugEvent& ev)
+	{
+		using T = DebugEventType;
+		switch (ev.type)
+		{
+			case T::_CreateProcess:
+				if (!m_armed)
+					arm(ev.thread_id);
+				return ContinueStatus::Default;
+
+			case T::Exception:
+			{
+				if (!m_armed)
+					return ContinueStatus::Default;
+				const auto& ex = std::get<ExceptionInfo>(ev.payload);
+				if (ex.code == SIGSEGV)
+					return on_fault(ev.thread_id, ex.address);
+				if (!m_steps.contains(ev.thread_id))
+					return ContinueStatus::Default;
+				// The step either ran the instruction (SIGTRAP), or a signal came first: then the
+				// page is closed again and the instruction faults anew once the handler returns.
+				const bool executed = ex.code == SIGTRAP;
+				finish_step(ev.thread_id, executed);
+				return executed ? ContinueStatus::Continue : ContinueStatus::Default;
+			}
+
+			case T::ExitThread:
+				if (const auto it = m_steps.find(ev.thread_id); it != m_steps.end())
+				{
+					// An exiting thread cannot run injected code: the next stopped one closes its pages.
+					for (std::size_t i = 0; i < it->second.pageCount; ++i)
+					{
+						if (--m_openPages[it->second.pages[i]] == 0)
+						{
+							m_openPages.erase(it->second.pages[i]);
+							m_staleOpen.push_back(it->second.pages[i]);
+						}
+					}
+					m_steps.erase(it);
+				}
+				return ContinueStatus::Default;
+
+			case T::ExitProcess:
+				m_armed = false;
+				m_steps.clear();
+				m_openPages.clear();
+				m_staleOpen.clear();
+				return ContinueStatus::Default;
+
+			default:
+				return ContinueStatus::Default;
+		}
+	}
+
+	void LinuxPageMemoryWatcher::arm(const std::uint32_t tid)
+	{
+		const std::vector<Mapping> maps = read_maps(m_pid);
+		m_syscall = find_syscall_instruction(m_pid, maps);
+		if (m_syscall == 0)
+		{
+			throw MemoryWatchError("LinuxPageMemoryWatcher: no syscall instruction found in the target to inject mprotect.");
+		}
+
+		// Split the ranges along the mappings so that each keeps its own original protection.
+		std::vector<Range> split;
+		for (const auto& range : m_ranges)
+		{
+			std::uint64_t at = range.begin;
+			for (const auto& m : maps)
+			{
+				if (m.end <= at || m.begin >= range.end)
+					continue;
+				if (m.begin > at)
+					break;
+				const std::uint64_t end = std::min(m.end, range.end);
+				split.push_back(Range{.begin = at, .end = end, .prot = m.prot});
+				at = end;
+				if (at == range.end)
+					break;
+			}
+			if (at != range.end)
+			{
+				std::ostringstream oss;
+				oss << "LinuxPageMemoryWatcher: 0x" << std::hex << at << " is not mapped in the target.";
+				throw MemoryWatchError(oss.str());
+			}
+		}
+		m_ranges = std::move(split);
+
+		for (const auto& range : m_ranges)
+			protect(tid, range.begin, range.end - range.begin, range.prot & ~PROT_WRITE);
+		m_armed = true;
+	}
+
+	ContinueStatus LinuxPageMemoryWatcher::on_fault(const std::uint32_t tid, const std::uint64_t ip)
+	{
+		siginfo_t si{};
+		if (ptrace(PTRACE_GETSIGINFO, tid, nullptr, &si) != 0 || si.si_code != SEGV_ACCERR)
+			return ContinueStatus::Default;
+		const auto address = reinterpret_cast<std::uint64_t>(si.si_addr);
+		const std::uint64_t page = address & ~(m_pageSize - 1);
+		if (!range_of(page))
+			return ContinueStatus::Default;
+
+		for (const std::uint64_t stale : m_staleOpen)
+			close_page(tid, stale);
+		m_staleOpen.clear();
+
+		// A second fault before the step completes: the instruction also touches another page.
+		const auto [it, fresh] = m_steps.try_emplace(tid);
+		Step& step = it->second;
+		if (fresh)
+			step.startNs = now_ns();
+		if (step.pageCount == Step::kMaxPages)
+		{
+			throw MemoryWatchError("LinuxPageMemoryWatcher: an instruction touches more than " + std::to_string(Step::kMaxPages) + " watched pages.");
+		}
+		step.pages[step.pageCount++] = page;
+		open_page(tid, page);
+
+		if (const std::int32_t object = object_at(address); object >= 0 && step.object < 0)
+		{
+			const ResolvedSymbol& symbol = m_objects[static_cast<std::size_t>(object)];
+			step.object = object;
+			step.offset = address - symbol.address;
+			step.width = store_width(ip);
+			const ElementSpan span = element_at(symbol, step.offset, m_name, step.width);
+			step.old = read_value(symbol.address + span.start, span.width);
+		}
+		else if (object < 0)
+		{
+			++m_falseSharing;
+		}
+		return ContinueStatus::SingleStep;
+	}
+
+	void LinuxPageMemoryWatcher::finish_step(const std::uint32_t tid, const bool executed)
+	{
+		const auto it = m_steps.find(tid);
+		const Step step = it->second;
+		m_steps.erase(it);
+
+		for (std::size_t i = 0; i < step.pageCount; ++i)
+			close_page(tid, step.pages[i]);
+
+		if (executed && step.object >= 0)
+		{
+			const ResolvedSymbol& symbol = m_objects[static_cast<std::size_t>(step.object)];
+			const ElementSpan span = element_at(symbol, step.offset, m_name, step.width);
+			Logger::log_write(m_name, step.old, read_value(symbol.address + span.start, span.width), tid);
+			++m_hits;
+		}
+		profiling::add_page_fault(step.object < 0, now_ns() - step.startNs);
+	}
+
+	std::uint32_t LinuxPageMemoryWatcher::store_width(const std::uint64_t ip)
+	{
+		// The fault names the first byte stored; the instruction says how many follow, so a
+		// field of a struct is logged alone rather than with its neighbours in the same word.
+		const auto read = [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+		{
+			iovec local{.iov_base = out, .iov_len = size};
+			iovec remote{.iov_base = reinterpret_cast<void*>(address), .iov_len = size};
+			return process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+		};
+		return m_decodeCache.classify_fault(ip, read).width;
+	}
+
+	void LinuxPageMemoryWatcher::open_page(const std::uint32_t tid, const std::uint64_t page)
+	{
+		// Another thread stepping on the same page already made it writable.
+		if (m_openPages[page]++ == 0)
+			protect(tid, page, m_pageSize, range_of(page)->prot);
+	}
+
+	void LinuxPageMemoryWatcher::close_page(const std::uint32_t tid, const std::uint64_t page)
+	{
+		const auto it = m_openPages.find(page);
+		if (it != m_openPages.end() && --it->second > 0)
+			return;
+		if (it != m_openPages.end())
+			m_openPages.erase(it);
+		protect(tid, page, m_pageSize, range_of(page)->prot & ~PROT_WRITE);
+	}
+
+	void LinuxPageMemoryWatcher::protect(const std::uint32_t tid, const std::uint64_t begin, const std::uint64_t length, const int prot)
+	{
+		const long r = remote_syscall(static_cast<int>(tid), m_syscall, SYS_mprotect, begin, length, static_cast<std::uint64_t>(prot), m_deferredSignals);
+		for (const int sig : m_deferredSignals)
+			syscall(SYS_tgkill, m_pid, tid, sig);
+		m_deferredSignals.clear();
+
+		// The thread vanished under us (exit_group from another thread): nothing left to protect.
+		if (r == -ESRCH)
+			return;
+		if (r != 0)
+		{
+			std::ostringstream oss;
+			oss << "LinuxPageMemoryWatcher: mprotect(0x" << std::hex << begin << ", 0x" << length << std::dec
+				<< ") failed in the target: " << errno_string(static_cast<int>(-r));
+			throw MemoryWatchError(oss.str());
+		}
+	}
+
+	const LinuxPageMemoryWatcher::Range* LinuxPageMemoryWatcher::range_of(const std::uint64_t page) const
+	{
+		const auto it = std::ranges::upper_bound(m_ranges, page, {}, &Range::begin);
+		if (it == m_ranges.begin() || page >= std::prev(it)->end)
+			return nullptr;
+		return &*std::prev(it);
+	}
+
+	std::int32_t LinuxPageMemoryWatcher::object_at(const std::uint64_t address) const
+	{
+		const auto it = std::ranges::upper_bound(m_objects, address, {}, &ResolvedSymbol::address);
+		if (it == m_objects.begin())
+			return -1;
+		const auto& object = *std::prev(it);
+		if (address >= object.address + object.size)
+			return -1;
+		return static_cast<std::int32_t>(std::prev(it) - m_objects.begin());
+	}
+
+	std::uint64_t LinuxPageMemoryWatcher::read_value(const std::uint64_t address, const std::uint32_t width) const
+	{
+#ifdef GWATCH_PROFILE
+		const auto begin = std::chrono::high_resolution_clock::now();
+#endif
+		std::uint64_t value = 0;
+		const iovec local{.iov_base = &value, .iov_len = width};
+		const iovec remote{.iov_base = reinterpret_cast<void*>(address), .iov_len = width};
+		process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0);
+#ifdef GWATCH_PROFILE
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - begin).count();
+		profiling::add_read_duration(static_cast<std::uint64_t>(elapsed));
+#endif
+		return value;
+	}
+}
+
+#endif
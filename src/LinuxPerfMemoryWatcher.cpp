@@ -0,0 +1,520 @@
+#ifdef __linux__
+#include <asm/perf_regs.h>
+#include <linux/hw_breakpoint.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "MemoryWatcher.h"
+#include "Logger.h"
+#include "Profiling.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		// The general-purpose registers, sampled in perf's order (AX, BX, CX, DX, SI, DI, BP,
+		// SP, R8..R15) and stored by x86 encoding (x86::kRegisters).
+		constexpr std::uint64_t kSampledRegisters =
+			(1ull << PERF_REG_X86_AX) | (1ull << PERF_REG_X86_BX) | (1ull << PERF_REG_X86_CX) | (1ull << PERF_REG_X86_DX) |
+			(1ull << PERF_REG_X86_SI) | (1ull << PERF_REG_X86_DI) | (1ull << PERF_REG_X86_BP) | (1ull << PERF_REG_X86_SP) |
+			(((1ull << 8) - 1) << PERF_REG_X86_R8);
+		constexpr std::array<std::uint8_t, x86::kRegisters> kEncodingOfSampled = {0, 3, 1, 2, 6, 7, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15};
+
+		// Layout of PERF_RECORD_SAMPLE for sample_type = IP | TID | TIME | REGS_USER. The
+		// registers are absent when abi is PERF_SAMPLE_REGS_ABI_NONE.
+		struct SampleRecord
+		{
+			perf_event_header header;
+			std::uint64_t ip;
+			std::uint32_t pid;
+			std::uint32_t tid;
+			std::uint64_t time;
+			std::uint64_t abi;
+			std::uint64_t regs[x86::kRegisters];
+		};
+
+		struct LostRecord
+		{
+			perf_event_header header;
+			std::uint64_t id;
+			std::uint64_t lost;
+		};
+
+		int perf_event_open(perf_event_attr* attr, const pid_t pid, const int cpu)
+		{
+			return static_cast<int>(syscall(SYS_perf_event_open, attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+		}
+
+		std::uint64_t mask_for_size(const std::uint64_t size)
+		{
+			return size >= 8 ? ~0ull : (1ull << (size * 8)) - 1;
+		}
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		perf_event_attr breakpoint_attr(const PerfWatchOptions& options, const PlannedSlot& slot)
+		{
+			perf_event_attr attr{};
+			attr.type = PERF_TYPE_BREAKPOINT;
+			attr.size = sizeof(attr);
+			attr.bp_type = options.writes_only ? HW_BREAKPOINT_W : HW_BREAKPOINT_RW;
+			attr.bp_addr = slot.address;
+			attr.bp_len = slot.size;
+			attr.sample_period = 1;
+			attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_REGS_USER;
+			attr.sample_regs_user = kSampledRegisters;
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.use_clockid = 1;
+			attr.clockid = CLOCK_MONOTONIC;
+			if (options.wakeup_events > 0)
+			{
+				attr.wakeup_events = options.wakeup_events;
+			}
+			else
+			{
+				attr.watermark = 1;
+				attr.wakeup_watermark = options.wakeup_bytes;
+			}
+			return attr;
+		}
+	}
+
+	LinuxPerfMemoryWatcher::LinuxPerfMemoryWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const PerfWatchOptions& options) :
+		IMemoryWatcher(),
+		m_pid(pid),
+		m_options(options),
+		m_functions(pid)
+	{
+		if (m_pid == 0)
+		{
+			throw MemoryWatchError("LinuxPerfMemoryWatcher: invalid pid (0).");
+		}
+		if (resolvedSymbols.empty() || resolvedSymbols.size() > kMaxPlannedVariables)
+		{
+			throw MemoryWatchError("LinuxPerfMemoryWatcher: between 1 and " + std::to_string(kMaxPlannedVariables) + " variables can be watched.");
+		}
+		for (const auto& symbol : resolvedSymbols)
+		{
+			if (!(symbol.size == 4 || symbol.size == 8))
+			{
+				throw MemoryWatchError("LinuxPerfMemoryWatcher: size must be 4 or 8 bytes.");
+			}
+		}
+		m_rotation = WatchRotation(resolvedSymbols);
+		for (auto& symbol : resolvedSymbols)
+			m_watched.push_back(Watched{.symbol = std::move(symbol), .lastValue = std::nullopt, .current = std::nullopt});
+		m_values.resize(m_watched.size());
+
+		if (m_options.ring_pages == 0 || (m_options.ring_pages & (m_options.ring_pages - 1)) != 0)
+		{
+			throw MemoryWatchError("LinuxPerfMemoryWatcher: ring_pages must be a power of two.");
+		}
+		if (m_options.hot_sites)
+			m_hotSites.emplace();
+	}
+
+	LinuxPerfMemoryWatcher::LinuxPerfMemoryWatcher(const std::uint32_t pid, const ResolvedSymbol& resolvedSymbol, const PerfWatchOptions& options) :
+		LinuxPerfMemoryWatcher(pid, std::vector<ResolvedSymbol>{resolvedSymbol}, options)
+	{
+	}
+
+	LinuxPerfMemoryWatcher::~LinuxPerfMemoryWatcher()
+	{
+		try { stop(); }
+		catch (...) {}
+	}
+
+	ContinueStatus LinuxPerfMemoryWatcher::on_event(const DebugEvent& ev)
+	{
+		using T = DebugEventType;
+		switch (ev.type)
+		{
+			case T::_CreateProcess:
+				read_values();
+				for (auto& w : m_watched)
+				{
+					if (!w.lastValue.has_value())
+						w.lastValue = w.current;
+				}
+				// Parsing symbol tables on the first sample would hold up the drain thread.
+				m_functions.index_mapped();
+				start();
+				return ContinueStatus::Default;
+
+			case T::ExitProcess:
+				stop();
+				return ContinueStatus::Default;
+
+			default:
+				// Threads inherit the breakpoints (perf inherit=1), nothing to arm per thread.
+				return ContinueStatus::Default;
+		}
+	}
+
+	void LinuxPerfMemoryWatcher::start()
+	{
+		if (!m_rings.empty())
+			return;
+
+		open_rings();
+		m_rotation.start(now_ns());
+		for (const auto& ring : m_rings)
+		{
+			if (ring.slot < m_rotation.current().slots.size())
+				ioctl(ring.fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+
+		m_stopRequested.store(false, std::memory_order_relaxed);
+		m_drainThread = std::thread([this] { drain_loop(); });
+	}
+
+	void LinuxPerfMemoryWatcher::stop()
+	{
+		if (m_rings.empty())
+			return;
+
+		for (const auto& ring : m_rings)
+			ioctl(ring.fd, PERF_EVENT_IOC_DISABLE, 0);
+
+		m_stopRequested.store(true, std::memory_order_relaxed);
+		if (m_drainThread.joinable())
+			m_drainThread.join();
+
+		drain_once();
+		m_rotation.stop(now_ns());
+		close_rings();
+	}
+
+	void LinuxPerfMemoryWatcher::open_rings()
+	{
+		const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		const std::size_t mapSize = static_cast<std::size_t>(pageSize) * (1 + m_options.ring_pages);
+
+		// One ring per slot any rotation group uses; slots the first group leaves empty stay
+		// disabled (on a placeholder address) until a group needs them.
+		const WatchPlan& plan = m_rotation.current();
+		const std::size_t slotCount = rotating() ? m_rotation.max_slots() : plan.slots.size();
+		for (std::uint32_t slot = 0; slot < slotCount; ++slot)
+		{
+			perf_event_attr attr = breakpoint_attr(m_options, plan.slots[slot < plan.slots.size() ? slot : 0]);
+
+			for (int cpu = 0; cpu < cpus; ++cpu)
+			{
+				const int fd = perf_event_open(&attr, static_cast<pid_t>(m_pid), cpu);
+				if (fd < 0)
+				{
+					// Offline CPUs cannot host an event, every other failure is fatal.
+					if (errno == ENODEV)
+						continue;
+					const int err = errno;
+					close_rings();
+					throw MemoryWatchError("perf_event_open(PERF_TYPE_BREAKPOINT) failed for slot " + std::to_string(slot) + " on CPU " + std::to_string(cpu) + ": " + std::strerror(err));
+				}
+
+				void* base = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (base == MAP_FAILED)
+				{
+					const int err = errno;
+					::close(fd);
+					close_rings();
+					throw MemoryWatchError("mmap of perf ring buffer failed: " + std::string(std::strerror(err)));
+				}
+				m_rings.push_back(Ring{.fd = fd, .base = base, .mapSize = mapSize, .slot = slot});
+			}
+		}
+
+		if (m_rings.empty())
+		{
+			throw MemoryWatchError("perf_event_open: no online CPU accepted the breakpoint.");
+		}
+	}
+
+	void LinuxPerfMemoryWatcher::close_rings()
+	{
+		for (auto& ring : m_rings)
+		{
+			if (ring.base)
+				munmap(ring.base, ring.mapSize);
+			if (ring.fd >= 0)
+				::close(ring.fd);
+		}
+		m_rings.clear();
+	}
+
+	void LinuxPerfMemoryWatcher::drain_loop()
+	{
+		std::vector<pollfd> fds;
+		fds.reserve(m_rings.size());
+		for (const auto& ring : m_rings)
+			fds.push_back(pollfd{.fd = ring.fd, .events = POLLIN, .revents = 0});
+
+		const std::uint64_t quantumNs = static_cast<std::uint64_t>(m_options.rotate_quantum_ms) * 1'000'000;
+		std::uint64_t nextRotation = rotating() ? now_ns() + quantumNs : ~0ull;
+		while (!m_stopRequested.load(std::memory_order_relaxed))
+		{
+			int timeout = m_options.poll_timeout_ms;
+			if (nextRotation != ~0ull)
+			{
+				const std::uint64_t now = now_ns();
+				const std::uint64_t left = nextRotation > now ? (nextRotation - now + 999'999) / 1'000'000 : 0;
+				timeout = static_cast<int>(std::min<std::uint64_t>(left, static_cast<std::uint64_t>(timeout)));
+			}
+			poll(fds.data(), fds.size(), timeout);
+			drain_once();
+
+			if (nextRotation != ~0ull && now_ns() >= nextRotation)
+			{
+				rotate();
+				nextRotation = now_ns() + quantumNs;
+			}
+		}
+	}
+
+	void LinuxPerfMemoryWatcher::rotate()
+	{
+		// Samples still in the rings belong to the outgoing group.
+		for (const auto& ring : m_rings)
+			ioctl(ring.fd, PERF_EVENT_IOC_DISABLE, 0);
+		drain_once();
+
+		const WatchPlan& next = m_rotation.advance(now_ns());
+		// Fresh baselines: a change made while a variable was not armed is not an observed write.
+		read_values();
+		for (const std::uint32_t v : next.covered)
+			m_watched[v].lastValue = m_watched[v].current;
+		program_rings(next);
+	}
+
+	void LinuxPerfMemoryWatcher::program_rings(const WatchPlan& plan)
+	{
+		for (const auto& ring : m_rings)
+		{
+			if (ring.slot >= plan.slots.size())
+				continue;
+			perf_event_attr attr = breakpoint_attr(m_options, plan.slots[ring.slot]);
+			if (ioctl(ring.fd, PERF_EVENT_IOC_MODIFY_ATTRIBUTES, &attr) == 0)
+				ioctl(ring.fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	void LinuxPerfMemoryWatcher::drain_once()
+	{
+#ifdef GWATCH_PROFILE
+		const auto start = std::chrono::high_resolution_clock::now();
+#endif
+
+		m_batch.clear();
+		std::uint64_t lost = 0;
+		for (auto& ring : m_rings)
+			lost += read_ring(ring);
+		if (lost > 0)
+			m_lost.fetch_add(lost, std::memory_order_relaxed);
+		if (m_batch.empty())
+			return;
+
+		// Each ring (one per variable and CPU) is already in time order, merge them into a single stream.
+		std::ranges::stable_sort(m_batch, {}, &Sample::time);
+		m_samples.fetch_add(m_batch.size(), std::memory_order_relaxed);
+
+		// Values come from the sample, never from a later read of the variable: a plain move
+		// that covers the whole variable left the value it loaded or stored in the sampled
+		// registers (or in its immediate). Any other access (read-modify-write, partial,
+		// undecoded) is logged by kind only, and the old value of the next write is unknown.
+		bool valuesRead = false;
+		for (const auto& sample : m_batch)
+		{
+			// On a slot shared by several variables, the address the instruction accessed says
+			// which one it was.
+			const std::uint64_t candidates = m_rotation.current().slots[sample.slot].variables;
+			const x86::Instruction insn = classify(sample.ip);
+			const std::optional<std::uint64_t> address = sample.hasRegisters ? x86::effective_address(insn, sample.ip, sample.registers) : std::nullopt;
+			const std::uint64_t targets = attribute_access(candidates, address, insn.width, [this](const std::size_t v) -> const ResolvedSymbol& { return m_watched[v].symbol; });
+			if (targets == 0)
+			{
+				if (!address)
+					m_unattributed.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			// W breakpoints are always writes. An undecoded access takes its kind from whether
+			// the value moved since the last one known: one remote read per batch, if any.
+			const x86::Access access = m_options.writes_only ? x86::Access::Store : insn.access;
+			std::uint64_t changed = 0;
+			if (access == x86::Access::Unknown)
+			{
+				if (!std::exchange(valuesRead, true))
+					read_values();
+				for (std::size_t i = 0; i < m_watched.size(); ++i)
+				{
+					const Watched& w = m_watched[i];
+					if ((targets & (1ull << i)) && w.current.has_value() && w.lastValue.has_value() && *w.current != *w.lastValue)
+						changed |= 1ull << i;
+				}
+			}
+			const bool write = access == x86::Access::Store || access == x86::Access::ReadModifyWrite || (access == x86::Access::Unknown && changed);
+			const std::uint64_t site = x86::access_site(insn, sample.ip);
+			if (m_hotSites)
+				m_hotSites->record(site, write ? AccessKind::Write : AccessKind::Read, sample.tid, targets);
+			for (std::size_t i = 0; i < m_watched.size(); ++i)
+			{
+				if (!(targets & (1ull << i)))
+					continue;
+
+				Watched& w = m_watched[i];
+				const bool whole = address == w.symbol.address && insn.width == w.symbol.size;
+				const std::optional<std::uint64_t> value = whole && sample.hasRegisters && (insn.access == x86::Access::Load || insn.access == x86::Access::Store)
+					? x86::moved_value(insn, sample.registers)
+					: std::nullopt;
+				if (write)
+				{
+					if (value && w.lastValue)
+						Logger::log_write(w.symbol.name, *w.lastValue, *value, sample.tid, sample.time, site);
+					else
+						Logger::log_access(w.symbol.name, AccessKind::Write, sample.tid, sample.time, site);
+					w.lastValue = value;
+				}
+				else if (value)
+				{
+					Logger::log_read(w.symbol.name, *value, sample.tid, sample.time, site);
+					w.lastValue = value;
+				}
+				else
+					Logger::log_access(w.symbol.name, AccessKind::Read, sample.tid, sample.time, site);
+				m_rotation.record_hit(static_cast<std::uint32_t>(i));
+			}
+		}
+
+#ifdef GWATCH_PROFILE
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		profiling::add_perf_drain(m_batch.size(), lost, static_cast<std::uint64_t>(elapsed));
+#endif
+	}
+
+	std::uint64_t LinuxPerfMemoryWatcher::read_ring(Ring& ring)
+	{
+		auto* meta = static_cast<perf_event_mmap_page*>(ring.base);
+		auto* data = static_cast<std::byte*>(ring.base) + meta->data_offset;
+		const std::uint64_t size = meta->data_size;
+
+		const std::uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+		std::uint64_t tail = meta->data_tail;
+		std::uint64_t lost = 0;
+
+		// Records may straddle the end of the ring, copy each one out before decoding.
+		alignas(8) std::byte record[256];
+		while (tail < head)
+		{
+			perf_event_header header{};
+			const std::uint64_t offset = tail % size;
+			const std::uint64_t first = std::min<std::uint64_t>(sizeof(header), size - offset);
+			std::memcpy(&header, data + offset, first);
+			std::memcpy(reinterpret_cast<std::byte*>(&header) + first, data, sizeof(header) - first);
+			if (header.size == 0)
+				break;
+
+			if (header.size <= sizeof(record))
+			{
+				const std::uint64_t chunk = std::min<std::uint64_t>(header.size, size - offset);
+				std::memcpy(record, data + offset, chunk);
+				std::memcpy(record + chunk, data, header.size - chunk);
+
+				if (header.type == PERF_RECORD_SAMPLE && header.size >= offsetof(SampleRecord, regs))
+				{
+					SampleRecord s{};
+					std::memcpy(&s, record, std::min<std::size_t>(header.size, sizeof(s)));
+					Sample sample{.time = s.time, .ip = s.ip, .tid = s.tid, .slot = ring.slot, .hasRegisters = false, .registers = {}};
+					if (s.abi != PERF_SAMPLE_REGS_ABI_NONE && header.size >= sizeof(SampleRecord))
+					{
+						sample.hasRegisters = true;
+						for (std::size_t i = 0; i < x86::kRegisters; ++i)
+							sample.registers[kEncodingOfSampled[i]] = s.regs[i];
+					}
+					m_batch.push_back(sample);
+				}
+				else if (header.type == PERF_RECORD_LOST && header.size >= sizeof(LostRecord))
+				{
+					LostRecord l{};
+					std::memcpy(&l, record, sizeof(l));
+					lost += l.lost;
+				}
+			}
+			tail += header.size;
+		}
+
+		__atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+		return lost;
+	}
+
+	x86::Instruction LinuxPerfMemoryWatcher::classify(const std::uint64_t ip)
+	{
+		// Only the first sample in a function reads and decodes the target's code.
+		const auto read = [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+		{
+			iovec local{.iov_base = out, .iov_len = size};
+			iovec remote{.iov_base = reinterpret_cast<void*>(address), .iov_len = size};
+			return process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+		};
+		return m_decodeCache.classify(ip, [this](const std::uint64_t address) { return m_functions.find(address); }, read);
+	}
+
+	void LinuxPerfMemoryWatcher::read_values()
+	{
+#ifdef GWATCH_PROFILE
+		const auto start = std::chrono::high_resolution_clock::now();
+#endif
+		iovec local[kMaxPlannedVariables];
+		iovec remote[kMaxPlannedVariables];
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
+		{
+			const ResolvedSymbol& symbol = m_watched[i].symbol;
+			m_values[i] = 0;
+			local[i] = iovec{.iov_base = &m_values[i], .iov_len = symbol.size};
+			remote[i] = iovec{.iov_base = reinterpret_cast<void*>(symbol.address), .iov_len = symbol.size};
+		}
+		const auto count = static_cast<unsigned long>(m_watched.size());
+		const ssize_t n = process_vm_readv(static_cast<pid_t>(m_pid), local, count, remote, count, 0);
+#ifdef GWATCH_PROFILE
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		profiling::add_read_duration(static_cast<std::uint64_t>(elapsed));
+#endif
+		// A failing remote range ends the transfer: only the variables read in full are valid.
+		std::uint64_t left = n > 0 ? static_cast<std::uint64_t>(n) : 0;
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
+		{
+			Watched& w = m_watched[i];
+			if (left >= w.symbol.size)
+			{
+				w.current = m_values[i] & mask_for_size(w.symbol.size);
+				left -= w.symbol.size;
+			}
+			else
+			{
+				w.current.reset();
+				left = 0;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifdef __linux__
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "Logger.h"
+#include "Profiling.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// Distance between two values of a size-byte variable, whichever way it wrapped.
+		std::uint64_t distance(const std::uint64_t a, const std::uint64_t b, const std::uint64_t size)
+		{
+			const std::uint64_t mask = size >= 8 ? ~0ull : (1ull << (size * 8)) - 1;
+			return std::min((a - b) & mask, (b - a) & mask);
+		}
+	}
+
+	LinuxPollMemoryWatcher::LinuxPollMemoryWatcher(const std::uint32_t pid, std::vector<ResolvedSymbol> resolvedSymbols, const PollWatchOptions& options) :
+		m_pid(pid),
+		m_symbols(std::move(resolvedSymbols)),
+		m_options(options)
+	{
+		if (m_symbols.empty())
+		{
+			throw MemoryWatchError("LinuxPollMemoryWatcher: no variable to watch.");
+		}
+		if (m_symbols.size() > IOV_MAX)
+		{
+			throw MemoryWatchError("LinuxPollMemoryWatcher: too many variables for one vectored read.");
+		}
+		for (const auto& symbol : m_symbols)
+		{
+			if (symbol.size == 0 || symbol.size > 8)
+			{
+				throw MemoryWatchError("LinuxPollMemoryWatcher: size must be 1 to 8 bytes.");
+			}
+		}
+
+		m_values.resize(m_symbols.size());
+		m_last.resize(m_symbols.size());
+		m_stats.resize(m_symbols.size());
+		for (std::size_t i = 0; i < m_symbols.size(); ++i)
+		{
+			m_local.push_back(iovec{.iov_base = &m_values[i], .iov_len = m_symbols[i].size});
+			m_remote.push_back(iovec{.iov_base = reinterpret_cast<void*>(m_symbols[i].address), .iov_len = m_symbols[i].size});
+		}
+	}
+
+	LinuxPollMemoryWatcher::~LinuxPollMemoryWatcher()
+	{
+		try { stop(); }
+		catch (...) {}
+	}
+
+	ContinueStatus LinuxPollMemoryWatcher::on_event(const DebugEvent& ev)
+	{
+		switch (ev.type)
+		{
+			case DebugEventType::_CreateProcess:
+				start();
+				return ContinueStatus::Default;
+
+			case DebugEventType::ExitProcess:
+				stop();
+				return ContinueStatus::Default;
+
+			default:
+				// The target is never stopped on our behalf.
+				return ContinueStatus::Default;
+		}
+	}
+
+	void LinuxPollMemoryWatcher::start()
+	{
+		if (m_started)
+			return;
+
+		// The target is stopped: these are the values the first changes start from.
+		if (process_vm_readv(static_cast<pid_t>(m_pid), m_local.data(), m_local.size(), m_remote.data(), m_remote.size(), 0) < 0)
+		{
+			throw MemoryWatchError("LinuxPollMemoryWatcher: process_vm_readv failed: " + std::string(std::strerror(errno)));
+		}
+		m_last = m_values;
+
+		m_startNs = now_ns();
+		m_stopRequested.store(false, std::memory_order_relaxed);
+		m_started = true;
+		m_pollThread = std::thread([this] { poll_loop(); });
+	}
+
+	void LinuxPollMemoryWatcher::stop()
+	{
+		if (!m_started)
+			return;
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopRequested.store(true, std::memory_order_relaxed);
+		}
+		m_wake.notify_one();
+		if (m_pollThread.joinable())
+			m_pollThread.join();
+
+		// The exiting target's memory is still mapped: the last stores are not lost.
+		poll_once(now_ns());
+		m_started = false;
+		m_elapsedNs = now_ns() - m_startNs;
+		profiling::add_poll_run(ticks(), overruns(), m_elapsedNs);
+	}
+
+	void LinuxPollMemoryWatcher::poll_loop()
+	{
+		const std::chrono::microseconds interval(m_options.interval_us);
+		auto next = std::chrono::steady_clock::now();
+		while (!m_stopRequested.load(std::memory_order_relaxed))
+		{
+			if (!poll_once(now_ns()))
+				return;
+			if (interval.count() == 0)
+				continue;
+
+			next += interval;
+			if (const auto now = std::chrono::steady_clock::now(); now >= next)
+			{
+				// Late already: poll right away and keep the period from here.
+				m_overruns.fetch_add(1, std::memory_order_relaxed);
+				next = now;
+				continue;
+			}
+			std::unique_lock lock(m_mutex);
+			m_wake.wait_until(lock, next, [this] { return m_stopRequested.load(std::memory_order_relaxed); });
+		}
+	}
+
+	bool LinuxPollMemoryWatcher::poll_once(const std::uint64_t timestamp)
+	{
+		// A partial read leaves the variables it did not reach at their previous value.
+		if (process_vm_readv(static_cast<pid_t>(m_pid), m_local.data(), m_local.size(), m_remote.data(), m_remote.size(), 0) < 0)
+			return errno != ESRCH;
+		m_ticks.fetch_add(1, std::memory_order_relaxed);
+
+		for (std::size_t i = 0; i < m_values.size(); ++i)
+		{
+			if (m_values[i] == m_last[i])
+				continue;
+			PollStats& stats = m_stats[i];
+			const std::uint64_t d = distance(m_values[i], m_last[i], m_symbols[i].size);
+			stats.step = stats.step == 0 ? d : std::min(stats.step, d);
+			if (d % stats.step == 0)
+				stats.missed += d / stats.step - 1;
+			++stats.changes;
+
+			Logger::log_write(m_symbols[i].name, m_last[i], m_values[i], 0, timestamp);
+			m_last[i] = m_values[i];
+		}
+		return true;
+	}
+}
+#endif
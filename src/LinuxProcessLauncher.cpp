@@ -0,0 +1,426 @@
+#ifdef __linux__
+#include <sched.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <elf.h>
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifdef GWATCH_PROFILE
+#include <chrono>
+#include "../include/Profiling.h"
+#endif
+
+#include "ProcessLauncher.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		constexpr long kTraceOptions = PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC | PTRACE_O_TRACEEXIT | PTRACE_O_EXITKILL;
+
+		std::string errno_string(const int err)
+		{
+			return std::strerror(err) + std::string(" (errno=") + std::to_string(err) + ")";
+		}
+
+		std::uint32_t exit_code_from_status(const int status)
+		{
+			return WIFEXITED(status)
+				       ? static_cast<std::uint32_t>(WEXITSTATUS(status))
+				       : 128u + static_cast<std::uint32_t>(WTERMSIG(status));
+		}
+
+		int wait_tid(const int tid, int& status, const int options = __WALL)
+		{
+			int r;
+			do
+			{
+				r = waitpid(tid, &status, options);
+			} while (r < 0 && errno == EINTR);
+			return r;
+		}
+
+		// What the child needs between clone and execv, prepared by the parent. The child shares
+		// our address space and may only call async-signal-safe functions before execv.
+		struct SpawnRequest
+		{
+			const char* path = nullptr;
+			char* const* argv = nullptr;
+			const char* workdir = nullptr;
+			int error = 0; // errno of the failed step, written by the child
+		};
+
+		constexpr std::size_t kSpawnStackSize = 64 * 1024;
+		constexpr useconds_t kGroupStopPollUs = 10'000;
+
+		int spawn_child(void* arg)
+		{
+			auto* request = static_cast<SpawnRequest*>(arg);
+			if (request->workdir && chdir(request->workdir) != 0)
+			{
+				request->error = errno;
+				_exit(127);
+			}
+			if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+			{
+				request->error = errno;
+				_exit(127);
+			}
+			execv(request->path, request->argv);
+			request->error = errno;
+			_exit(127);
+		}
+
+		bool is_stop_signal(const int sig)
+		{
+			return sig == SIGSTOP || sig == SIGTSTP || sig == SIGTTIN || sig == SIGTTOU;
+		}
+	}
+
+	LinuxProcessLauncher::LinuxProcessLauncher() = default;
+
+	LinuxProcessLauncher::~LinuxProcessLauncher()
+	{
+		// PTRACE_O_EXITKILL only fires when the tracer exits, do not leave a stopped tracee behind.
+		if (m_running && m_pid > 0)
+		{
+			kill(m_pid, SIGKILL);
+			int status = 0;
+			// Reap the leader last: its zombie is only released once every other thread is gone.
+			for (const int tid : m_threads)
+			{
+				if (tid != m_pid)
+					wait_tid(tid, status);
+			}
+			wait_tid(m_pid, status);
+		}
+	}
+
+	void LinuxProcessLauncher::launch(const LaunchConfig& cfg)
+	{
+		if (m_launched)
+		{
+			throw ProcessError("Process already launched with this LinuxProcessLauncher instance.");
+		}
+
+		// Everything the child touches is prepared up front and reached through request: the
+		// child runs spawn_child on a stack of its own while we are suspended (CLONE_VFORK).
+		std::vector<char*> argv;
+		argv.reserve(cfg.args.size() + 2);
+		argv.push_back(const_cast<char*>(cfg.exe_path.c_str()));
+		for (const auto& a : cfg.args)
+			argv.push_back(const_cast<char*>(a.c_str()));
+		argv.push_back(nullptr);
+		SpawnRequest request{
+			.path = cfg.exe_path.c_str(),
+			.argv = argv.data(),
+			.workdir = cfg.workdir ? cfg.workdir->c_str() : nullptr,
+			.error = 0,
+		};
+		std::vector<std::byte> stack(kSpawnStackSize);
+
+#ifdef GWATCH_PROFILE
+		const auto launch_start = std::chrono::high_resolution_clock::now();
+#endif
+		const pid_t child = clone(spawn_child, stack.data() + stack.size(), CLONE_VM | CLONE_VFORK | SIGCHLD, &request);
+		if (child < 0)
+		{
+			throw ProcessError(std::string("Failed to launch '") + cfg.exe_path + "': clone failed: " + errno_string(errno));
+		}
+
+		int status = 0;
+		if (request.error != 0)
+		{
+			const int err = request.error;
+			wait_tid(child, status);
+			throw ProcessError(std::string("Failed to launch '") + cfg.exe_path + "': execv failed: " + errno_string(err));
+		}
+
+		// PTRACE_TRACEME makes the successful execv stop the child with SIGTRAP.
+		if (wait_tid(child, status) < 0 || !WIFSTOPPED(status) || WSTOPSIG(status) != SIGTRAP)
+		{
+			kill(child, SIGKILL);
+			wait_tid(child, status);
+			throw ProcessError(std::string("Failed to launch '") + cfg.exe_path + "': target did not stop after exec.");
+		}
+#ifdef GWATCH_PROFILE
+		const auto first_event = std::chrono::high_resolution_clock::now();
+		profiling::add_launch_to_first_event_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(first_event - launch_start).count());
+#endif
+
+		if (ptrace(PTRACE_SETOPTIONS, child, nullptr, reinterpret_cast<void*>(kTraceOptions)) != 0)
+		{
+			const int err = errno;
+			kill(child, SIGKILL);
+			wait_tid(child, status);
+			throw ProcessError("PTRACE_SETOPTIONS failed: " + errno_string(err));
+		}
+
+		m_pid = child;
+		m_exePath = cfg.exe_path;
+		m_threads.insert(child);
+		m_launched = true;
+		m_running = true;
+		m_pendingCreate = true;
+	}
+
+	std::optional<std::uint32_t> LinuxProcessLauncher::run_debug_loop(IDebugEventSink& sink)
+	{
+		return drive_debug_loop(*this, sink);
+	}
+
+	bool LinuxProcessLauncher::next_event(DebugEvent& ev)
+	{
+		if (!m_launched)
+		{
+			throw ProcessError("run_debug_loop called before launch().");
+		}
+
+		while (!m_requestStop && m_running)
+		{
+			int status = 0;
+			int tid = m_pid;
+			if (m_pendingCreate)
+			{
+				// The exec stop was consumed by launch(), replay it as the first event.
+				status = (SIGTRAP << 8) | 0x7f;
+			}
+			else
+			{
+#ifdef GWATCH_PROFILE
+				const auto wait_start = std::chrono::high_resolution_clock::now();
+#endif
+				tid = wait_tid(-1, status, __WALL | WCONTINUED | (m_groupStopped.empty() ? 0 : WNOHANG));
+				if (tid == 0)
+				{
+					// Threads held in a group-stop never run, so nothing wakes us up when SIGCONT
+					// arrives: WCONTINUED is only found by asking again.
+					usleep(kGroupStopPollUs);
+					continue;
+				}
+				if (tid < 0)
+				{
+					throw ProcessError("waitpid failed: " + errno_string(errno));
+				}
+#ifdef GWATCH_PROFILE
+				const auto wait_end = std::chrono::high_resolution_clock::now();
+				profiling::add_loop_wait_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(wait_end - wait_start).count());
+				m_handleStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(wait_end.time_since_epoch()).count();
+#endif
+			}
+
+			if (WIFCONTINUED(status))
+			{
+				// SIGCONT ended the group-stop: let the threads held in it go.
+				for (const int stopped : m_groupStopped)
+					resume(stopped, 0);
+				m_groupStopped.clear();
+				continue;
+			}
+
+			ev = DebugEvent{};
+			ev.process_id = static_cast<std::uint32_t>(m_pid);
+			ev.thread_id = static_cast<std::uint32_t>(tid);
+
+			if (WIFEXITED(status) || WIFSIGNALED(status))
+			{
+				m_threads.erase(tid);
+				m_groupStopped.erase(tid);
+				if (tid != m_pid)
+					continue;
+
+				m_running = false;
+				// Normally reported at the last PTRACE_EVENT_EXIT; a SIGKILL skips that stop.
+				if (m_exitCode)
+					return false;
+				ev.type = DebugEventType::ExitProcess;
+				ExitProcessInfo xp{};
+				xp.exit_code = exit_code_from_status(status);
+				ev.payload = xp;
+				m_exitCode = xp.exit_code;
+				return true;
+			}
+
+			const int sig = WSTOPSIG(status);
+			const int traceEvent = status >> 16;
+
+			if (m_pendingCreate)
+			{
+				m_pendingCreate = false;
+				ev.type = DebugEventType::_CreateProcess;
+				ev.payload = describe_image();
+			}
+			else if (!m_threads.contains(tid))
+			{
+				// First stop of a thread announced by PTRACE_EVENT_CLONE (its initial SIGSTOP).
+				m_threads.insert(tid);
+				ev.type = DebugEventType::CreateThread;
+				ev.payload = CreateThreadInfo{};
+			}
+			else if (sig == SIGTRAP && traceEvent == PTRACE_EVENT_CLONE)
+			{
+				// The new thread reports itself through its own stop, see above.
+				resume(tid, 0);
+				continue;
+			}
+			else if (sig == SIGTRAP && traceEvent == PTRACE_EVENT_EXEC)
+			{
+				ev.type = DebugEventType::_CreateProcess;
+				ev.payload = describe_image();
+			}
+			else if (sig == SIGTRAP && traceEvent == PTRACE_EVENT_EXIT)
+			{
+				unsigned long code = 0;
+				ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &code);
+				m_threads.erase(tid);
+
+				if (m_threads.empty())
+				{
+					// Last thread leaving: like Windows, the process exit is reported while
+					// its memory can still be read.
+					ev.type = DebugEventType::ExitProcess;
+					ExitProcessInfo xp{};
+					xp.exit_code = exit_code_from_status(static_cast<int>(code));
+					ev.payload = xp;
+					m_exitCode = xp.exit_code;
+				}
+				else if (tid == m_pid)
+				{
+					// The main thread ended first (pthread_exit), the process lives on.
+					resume(tid, 0);
+					continue;
+				}
+				else
+				{
+					ev.type = DebugEventType::ExitThread;
+					ExitThreadInfo xt{};
+					xt.exit_code = exit_code_from_status(static_cast<int>(code));
+					ev.payload = xt;
+				}
+			}
+			else if (siginfo_t info{}; is_stop_signal(sig) && ptrace(PTRACE_GETSIGINFO, tid, nullptr, &info) != 0 && errno == EINVAL)
+			{
+				// Group-stop (the stop signal was delivered): the thread stays stopped like it
+				// would without us, until the process is continued.
+				m_groupStopped.insert(tid);
+				continue;
+			}
+			else
+			{
+				ev.type = DebugEventType::Exception;
+				ExceptionInfo xi{};
+				xi.code = static_cast<std::uint32_t>(sig);
+				xi.address = instruction_pointer(tid);
+				xi.first_chance = true;
+				ev.payload = xi;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void LinuxProcessLauncher::complete_event(const DebugEvent& ev, const ContinueStatus sinkDecision)
+	{
+		// Once the leader is reaped there is nothing left to resume.
+		if (!m_running)
+			return;
+		const int signal = ev.type == DebugEventType::Exception ? map_continue_signal(sinkDecision, ev) : 0;
+		resume(static_cast<int>(ev.thread_id), signal, sinkDecision == ContinueStatus::SingleStep);
+	}
+
+	void LinuxProcessLauncher::resume(const int tid, const int signal, const bool singleStep)
+	{
+		ptrace(singleStep ? PTRACE_SINGLESTEP : PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal)));
+
+#ifdef GWATCH_PROFILE
+		const auto handle_end = std::chrono::high_resolution_clock::now();
+		if (m_handleStartNs != 0)
+			profiling::add_loop_handle_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(handle_end.time_since_epoch()).count() - m_handleStartNs);
+		profiling::inc_loop_iteration();
+#endif
+	}
+
+	void LinuxProcessLauncher::stop()
+	{
+		m_requestStop = true;
+	}
+
+	CreateProcessInfo LinuxProcessLauncher::describe_image()
+	{
+		CreateProcessInfo cp{};
+		const std::string proc = "/proc/" + std::to_string(m_pid);
+
+		std::error_code ec;
+		const auto exe = std::filesystem::read_symlink(proc + "/exe", ec);
+		const std::string imagePath = ec ? m_exePath : exe.string();
+		cp.image_path = m_strings.intern(imagePath);
+
+		// Load base: lowest mapping of the main image (non-zero for PIE executables).
+		std::ifstream maps(proc + "/maps");
+		std::string line;
+		while (std::getline(maps, line))
+		{
+			const auto slash = line.find('/');
+			if (slash == std::string::npos || line.compare(slash, std::string::npos, imagePath) != 0)
+				continue;
+			cp.image_base = std::stoull(line.substr(0, line.find('-')), nullptr, 16);
+			break;
+		}
+
+		// Entry point from the auxiliary vector.
+		if (const int fd = open((proc + "/auxv").c_str(), O_RDONLY | O_CLOEXEC); fd >= 0)
+		{
+			Elf64_auxv_t aux{};
+			while (read(fd, &aux, sizeof(aux)) == sizeof(aux) && aux.a_type != AT_NULL)
+			{
+				if (aux.a_type == AT_ENTRY)
+				{
+					cp.entry_point = aux.a_un.a_val;
+					break;
+				}
+			}
+			close(fd);
+		}
+		return cp;
+	}
+
+	std::uint64_t LinuxProcessLauncher::instruction_pointer(const int tid)
+	{
+#if defined(__x86_64__)
+		user_regs_struct regs{};
+		if (ptrace(PTRACE_GETREGS, tid, nullptr, &regs) != 0)
+			return 0;
+		return regs.rip;
+#else
+		(void)tid;
+		return 0;
+#endif
+	}
+
+	int LinuxProcessLauncher::map_continue_signal(const ContinueStatus sinkDecision, const DebugEvent& ev)
+	{
+		const auto& ex = std::get<ExceptionInfo>(ev.payload);
+		if (sinkDecision == ContinueStatus::Continue || sinkDecision == ContinueStatus::SingleStep)
+			return 0;
+		if (sinkDecision == ContinueStatus::NotHandled)
+			return static_cast<int>(ex.code);
+
+		// Default policy:
+		// - Swallow breakpoints & single-step (SIGTRAP)
+		// - Everything else, SIGSTOP included: deliver the signal to the target. The initial
+		//   SIGSTOP of a new thread never gets here, it is reported as CreateThread.
+		return ex.code == SIGTRAP ? 0 : static_cast<int>(ex.code);
+	}
+}
+
+#endif
@@ -1,35 +1,1429 @@
 #include "../include/Logger.h"
-#ifdef GWATCH_PROFILE
+#include "../include/AccessStats.h"
+#include "../include/ColumnarTrace.h"
 #include "../include/Profiling.h"
+#include "../include/TraceFormat.h"
+#include "../include/TraceFile.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
-#endif
+#include <cerrno>
+#include <climits>
 #include <cinttypes>
 #include <cstdio>
+#include <cstring>
 #include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace gwatch
 {
-	void Logger::log_read(const std::string_view symbol, const std::uint64_t value)
+	namespace
 	{
+		// Output is staged in fixed blocks and written with a single writev per batch.
+		constexpr std::size_t kBlockSize = 16 * 1024;
+		constexpr std::size_t kBlockCount = 16;
+
+#ifdef _WIN32
+		struct iovec
+		{
+			void* iov_base;
+			std::size_t iov_len;
+		};
+#endif
+
+		// Overflow storage of the Spill policy: appended at the end, read back from the front,
+		// emptied once everything was read back.
+		class SpillFile
+		{
+		public:
+			explicit SpillFile(std::string path);
+			~SpillFile();
+
+			SpillFile(const SpillFile&) = delete;
+			SpillFile& operator=(const SpillFile&) = delete;
+
+			bool pending() const { return m_read < m_written; }
+			bool append(const std::vector<char>& bytes);
+			// Appends up to max unread bytes to out.
+			void read(std::vector<char>& out, std::size_t max);
+
+		private:
+			std::string m_path;
+			std::FILE* m_file = nullptr;
+			std::uint64_t m_written = 0;
+			std::uint64_t m_read = 0;
+		};
+
+		// The writer's side of stdout. When it must not block, pipes get a non-blocking
+		// description of their own (O_NONBLOCK on the shared one would also reach the target's
+		// writes) and sockets are written with MSG_DONTWAIT. Files and terminals are written
+		// as they are.
+		class OutputChannel
+		{
+		public:
+			explicit OutputChannel(bool nonBlocking);
+			~OutputChannel();
+
+			OutputChannel(const OutputChannel&) = delete;
+			OutputChannel& operator=(const OutputChannel&) = delete;
+
+			// Bytes written, 0 when stdout is full, -1 once it failed.
+			std::ptrdiff_t write_some(const char* data, std::size_t size);
+			void wait_writable(std::chrono::milliseconds timeout);
+
+		private:
+			int m_fd = 1;
+			bool m_ownFd = false;
+			bool m_socket = false;
+		};
+
+		struct AsyncState
+		{
+			// The overflow writer moves records out of the ring into a queue of its own: the ring
+			// then takes half the capacity, so that both together never hold more.
+			AsyncState(const AsyncOptions& options, const bool overflowWriter) :
+				capacity(std::bit_ceil(std::max<std::size_t>(options.capacity, 2))),
+				ring(overflowWriter ? capacity / 2 : capacity),
+				mask(ring.size() - 1),
+				overflow(options.overflow)
+			{
+				if (overflow == OverflowPolicy::Spill)
+					spill = std::make_unique<SpillFile>(options.spillPath);
+			}
+
+			const std::size_t capacity; // records queued at most, ring and overflow writer's queue
+			std::vector<LogRecord> ring;
+			const std::size_t mask;
+			const OverflowPolicy overflow;
+			std::unique_ptr<SpillFile> spill;
+
+			// Producer and consumer indices live on separate cache lines.
+			alignas(64) std::atomic<std::uint64_t> head{0};
+			alignas(64) std::atomic<std::uint64_t> tail{0};
+			alignas(64) std::atomic<std::uint64_t> written{0};
+			std::atomic<std::uint32_t> writerSleeping{0};
+			std::atomic<bool> stopRequested{false};
+			std::thread writer;
+
+			// Written by the writer, read by Logger::queue_stats().
+			std::atomic<std::size_t> peak{0};
+			std::atomic<std::uint64_t> dropped{0};
+			std::atomic<std::uint64_t> spilledBytes{0};
+		};
+
+		struct SymbolEntry
+		{
+			std::string name;
+			std::uint32_t size = 0;
+			std::array<std::string, 2> prefixes; // "<name> read ", "<name> write " (by AccessKind)
+		};
+
+		// Symbols are never removed: readers keep string_views into this deque.
+		struct SymbolRegistry
+		{
+			std::mutex mutex;
+			std::deque<SymbolEntry> entries;
+
+			// Entry of the per-thread cache of the recently interned symbols (one per watched variable).
+			struct Recent
+			{
+				std::string_view name;
+				std::uint32_t id = 0;
+				std::array<std::string_view, 2> prefixes;
+			};
+		};
+
+		// Per-thread snapshot of the registry, refreshed when an unknown index shows up.
+		class SymbolViews
+		{
+		public:
+			const std::vector<trace::SymbolView>& covering(std::uint32_t id);
+			// Text line prefix of a symbol covered by the last call.
+			std::string_view prefix(const std::uint32_t id, const AccessKind kind) const { return m_prefixes[id][static_cast<std::size_t>(kind)]; }
+
+		private:
+			std::vector<trace::SymbolView> m_views;
+			std::vector<std::array<std::string_view, 2>> m_prefixes;
+		};
+
+		// Runs of identical accesses held back until they end. Every record goes through the
+		// mutex while coalescing is on, so the flusher thread may emit too.
+		struct CoalesceState
+		{
+			// Threads with a run in progress; past this the oldest run is printed early.
+			static constexpr std::size_t kMaxRuns = 64;
+
+			Coalescing coalescing = Coalescing::Off;
+			std::uint64_t windowNs = 0;
+			std::mutex mutex;
+			std::vector<LogRecord> runs; // at most one per thread, one in total with Coalescing::Global
+			std::condition_variable wake;
+			bool stopRequested = false;
+			std::thread flusher;
+		};
+
+		// Per-variable sampling and token buckets, see Logger::set_policy.
+		struct PolicyState
+		{
+			static constexpr std::uint64_t kSummaryPeriodNs = 1'000'000'000;
+
+			struct Variable
+			{
+				bool resolved = false;
+				std::string name;
+				LogPolicy policy;
+				double tokens = 0;
+				std::uint64_t refillNs = 0;
+				std::uint64_t seen = 0;
+				std::array<std::uint64_t, 2> dropped{};  // by AccessKind
+				std::array<std::uint64_t, 2> reported{}; // part of dropped already on stderr
+			};
+
+			std::mutex mutex;
+			LogPolicy fallback;
+			std::vector<std::pair<std::string, LogPolicy>> named;
+			std::vector<Variable> variables; // by symbol index, resolved on first access
+			std::uint64_t summaryNs = 0;
+		};
+
+		std::atomic<AsyncState*> g_async{nullptr};
+		QueueStats g_lastQueueStats;
+		// Never freed: a logging thread may still hold it when clear_policies() runs, which
+		// only empties it. g_policies points to it while any policy is set.
+		PolicyState g_policyState;
+		std::atomic<PolicyState*> g_policies{nullptr};
+		std::atomic<LogFormat> g_format{LogFormat::Text};
+		std::atomic<AccessStats*> g_stats{nullptr};
+		std::atomic<CoalesceState*> g_coalesce{nullptr};
+		SymbolRegistry g_symbols;
+
+		// Binary stream state. Owned by the logging thread in synchronous mode and by the
+		// writer thread while the asynchronous mode is active.
+		trace::Encoder g_encoder;
+		// Columnar stream state, owned the same way.
+		columnar::Writer g_columns;
+		std::uint32_t g_groupRows = columnar::kDefaultRows; // set_row_group()
+		std::uint64_t g_segmentBytes = 0;                   // of the open trace file, 0 = none
+
+#ifdef __linux__
+		// --trace-file output, used instead of stdout while it exists.
+		struct TraceSink
+		{
+			explicit TraceSink(const TraceFileOptions& options) :
+				storage(open_trace_storage(options))
+			{
+			}
+
+			std::mutex mutex; // appends of the logging threads, or of the writer thread
+			std::unique_ptr<ITraceStorage> storage;
+			std::vector<char> scratch;
+			SymbolViews views;
+		};
+#else
+		struct TraceSink; // never created: trace files are Linux only
+#endif
+		std::atomic<TraceSink*> g_trace{nullptr};
+
+		// --compress stage; every stdout write goes through it while it exists.
+		std::atomic<compress::StreamCompressor*> g_compressor{nullptr};
+
+		// Prints the pending runs and stops the writer (flushing it) if the program exits while
+		// coalescing or in asynchronous mode.
+		struct ExitGuard
+		{
+			~ExitGuard()
+			{
+				Logger::set_coalescing(Coalescing::Off);
+				Logger::stop_async();
+				Logger::close_trace_file();
+				Logger::stop_compression();
+				Logger::end_stream();
+			}
+		} g_exitGuard;
+
+		void write_stdout(const char* data, const std::size_t size)
+		{
+			if (auto* compressor = g_compressor.load(std::memory_order_acquire))
+				compressor->write(data, size);
+			else
+				std::fwrite(data, 1, size, stdout);
+		}
+
+		char* append(char* out, const std::string_view text)
+		{
+			std::memcpy(out, text.data(), text.size());
+			return out + text.size();
+		}
+
+		char* append(char* out, const std::uint64_t value)
+		{
+			return std::to_chars(out, out + 20, value).ptr;
+		}
+
+		// Everything after "<symbol> read " / "<symbol> write ", newline included.
+		char* append_values(char* p, const LogRecord& record)
+		{
+			if (!record.exact)
+				*p++ = '?';
+			else if (record.kind == AccessKind::Write)
+			{
+				p = append(p, record.old_value);
+				p = append(p, " -> ");
+			}
+			if (record.exact)
+				p = append(p, record.new_value);
+			if (record.repeat > 1)
+			{
+				p = append(p, " x");
+				p = append(p, std::uint64_t{record.repeat});
+			}
+			*p++ = '\n';
+			return p;
+		}
+
+		std::uint32_t find_or_add(const std::string_view symbol)
+		{
+			const auto it = std::ranges::find(g_symbols.entries, symbol, &SymbolEntry::name);
+			if (it != g_symbols.entries.end())
+				return static_cast<std::uint32_t>(it - g_symbols.entries.begin());
+			g_symbols.entries.emplace_back(SymbolEntry{
+				.name = std::string(symbol),
+				.size = 0,
+				.prefixes = {std::string(symbol) + " read ", std::string(symbol) + " write "},
+			});
+			return static_cast<std::uint32_t>(g_symbols.entries.size() - 1);
+		}
+
+		// The cache slot of a symbol, interning it on a miss. The cache is per thread, so a hit
+		// takes no lock; it only holds views of registry entries. Returned by value: the slot
+		// may be reused by the next miss.
+		SymbolRegistry::Recent intern_recent(const std::string_view symbol)
+		{
+			thread_local std::array<SymbolRegistry::Recent, 4> recent{};
+			thread_local std::size_t nextRecent = 0;
+			for (const auto& cached : recent)
+			{
+				if (!cached.name.empty() && cached.name == symbol)
+					return cached;
+			}
+
+			const std::lock_guard lock(g_symbols.mutex);
+			const std::uint32_t id = find_or_add(symbol);
+			const SymbolEntry& entry = g_symbols.entries[id];
+			auto& slot = recent[nextRecent++ % recent.size()];
+			slot = {.name = entry.name, .id = id, .prefixes = {entry.prefixes[0], entry.prefixes[1]}};
+			return slot;
+		}
+
+		std::uint32_t intern(const std::string_view symbol)
+		{
+			return intern_recent(symbol).id;
+		}
+
+		const std::vector<trace::SymbolView>& SymbolViews::covering(const std::uint32_t id)
+		{
+			if (id >= m_views.size())
+			{
+				const std::lock_guard lock(g_symbols.mutex);
+				m_views.clear();
+				m_prefixes.clear();
+				for (const auto& entry : g_symbols.entries)
+				{
+					m_views.push_back(trace::SymbolView{.name = entry.name, .size = entry.size});
+					m_prefixes.push_back({entry.prefixes[0], entry.prefixes[1]});
+				}
+			}
+			return m_views;
+		}
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		void append_record(std::vector<char>& out, const LogRecord& record, SymbolViews& views, const LogFormat format)
+		{
+			const auto& symbols = views.covering(record.symbol);
+			if (format == LogFormat::Binary)
+			{
+				g_encoder.encode(record, symbols, out);
+				return;
+			}
+			if (format == LogFormat::Columnar)
+			{
+				if (g_columns.add(record))
+					g_columns.render(symbols, out);
+				return;
+			}
+			const std::string_view prefix = views.prefix(record.symbol, record.kind);
+			const std::size_t used = out.size();
+			out.resize(used + Logger::max_line_length(prefix.size()));
+			char* end = append_values(append(out.data() + used, prefix), record);
+			out.resize(static_cast<std::size_t>(end - out.data()));
+		}
+
+		// Rows per columnar group: with a trace file, a group takes at most half a segment.
+		std::uint32_t group_rows()
+		{
+			if (g_segmentBytes == 0)
+				return g_groupRows;
+			return static_cast<std::uint32_t>(std::clamp<std::uint64_t>(g_segmentBytes / 2 / columnar::kRowBytes, 1, g_groupRows));
+		}
+
+		// Appends the buffered columnar rows to the trace file as one group, in a new segment
+		// when it does not fit in the current one. Like a binary segment, every segment is a
+		// file of its own. Caller holds sink.mutex.
+		void append_group_to_trace(TraceSink& sink, const std::span<const trace::SymbolView> symbols, std::vector<char>& scratch)
+		{
+#ifdef __linux__
+			if (!sink.storage->has_room(g_columns.render_size(symbols)))
+			{
+				sink.storage->rotate();
+				g_columns.restart();
+			}
+			scratch.clear();
+			g_columns.render(symbols, scratch);
+			// Only symbol definitions can make a capped group overflow a segment.
+			if (sink.storage->has_room(scratch.size()))
+				sink.storage->append(scratch.data(), scratch.size());
+			else
+				std::fprintf(stderr, "Error: a columnar row group of %zu bytes does not fit in a trace segment, dropped.\n", scratch.size());
+#else
+			(void)sink, (void)symbols, (void)scratch;
+#endif
+		}
+
+		// Appends one record to the trace file, in a new segment when it does not fit in the
+		// current one. A binary segment is a trace of its own: the encoder starts over with a header.
+		// Caller holds sink.mutex.
+		void append_to_trace(TraceSink& sink, const LogRecord& record, std::vector<char>& scratch, SymbolViews& views, const LogFormat format)
+		{
+#ifdef __linux__
+			if (format == LogFormat::Columnar)
+			{
+				if (g_columns.add(record))
+					append_group_to_trace(sink, views.covering(record.symbol), scratch);
+				return;
+			}
+			scratch.clear();
+			append_record(scratch, record, views, format);
+			if (!sink.storage->has_room(scratch.size()))
+			{
+				sink.storage->rotate();
+				if (format == LogFormat::Binary)
+				{
+					g_encoder.reset();
+					scratch.clear();
+					append_record(scratch, record, views, format);
+				}
+			}
+			sink.storage->append(scratch.data(), scratch.size());
+#else
+			(void)sink, (void)record, (void)scratch, (void)views, (void)format;
+#endif
+		}
+
+		// Synchronous output to the trace file, when one is open.
+		bool log_to_trace(const LogRecord& record, const LogFormat format)
+		{
+#ifdef __linux__
+			TraceSink* sink = g_trace.load(std::memory_order_acquire);
+			if (sink == nullptr)
+				return false;
+			const std::lock_guard lock(sink->mutex);
+			append_to_trace(*sink, record, sink->scratch, sink->views, format);
+			return true;
+#else
+			(void)record, (void)format;
+			return false;
+#endif
+		}
+
+		void wake_writer(AsyncState& state)
+		{
+			if (state.writerSleeping.load() != 0)
+			{
+				state.writerSleeping.store(0);
+				state.writerSleeping.notify_one();
+			}
+		}
+
+		void push(AsyncState& state, const LogRecord& record)
+		{
+			const std::uint64_t head = state.head.load(std::memory_order_relaxed);
+			// Bounded ring: the producer waits for the writer rather than dropping records.
+			while (head - state.tail.load(std::memory_order_acquire) >= state.ring.size())
+			{
+				wake_writer(state);
+				std::this_thread::yield();
+			}
+			state.ring[head & state.mask] = record;
+			state.head.store(head + 1);
+			wake_writer(state);
+		}
+
+		bool write_all(std::vector<iovec>& iov)
+		{
+			std::size_t first = 0;
+			while (first < iov.size())
+			{
+#ifdef _WIN32
+				const auto n = _write(1, iov[first].iov_base, static_cast<unsigned>(iov[first].iov_len));
+#else
+				const ssize_t n = writev(STDOUT_FILENO, iov.data() + first, static_cast<int>(std::min<std::size_t>(iov.size() - first, IOV_MAX)));
+#endif
+				if (n < 0)
+				{
+					if (errno == EINTR || errno == EAGAIN)
+						continue;
+					return false;
+				}
+				auto left = static_cast<std::size_t>(n);
+				while (first < iov.size() && left >= iov[first].iov_len)
+					left -= iov[first++].iov_len;
+				if (left > 0)
+				{
+					iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+					iov[first].iov_len -= left;
+				}
+			}
+			return true;
+		}
+
+		void writer_loop(AsyncState& state)
+		{
+			std::vector<std::vector<char>> blocks(kBlockCount);
+			for (auto& b : blocks)
+				b.reserve(kBlockSize);
+			std::vector<iovec> iov;
+			iov.reserve(kBlockCount);
+			std::vector<char> traceScratch;
+			SymbolViews views;
+			bool failed = false;
+
+			while (true)
+			{
+				std::uint64_t tail = state.tail.load(std::memory_order_relaxed);
+				std::uint64_t head = state.head.load();
+				if (tail == head)
+				{
+					if (state.stopRequested.load())
+						break;
+					// Announce the sleep, then re-check: the producer only wakes us when it sees the flag.
+					state.writerSleeping.store(1);
+					if (state.head.load() == tail && !state.stopRequested.load())
+						state.writerSleeping.wait(1);
+					state.writerSleeping.store(0);
+					continue;
+				}
+
+				if (head - tail > state.peak.load(std::memory_order_relaxed))
+					state.peak.store(static_cast<std::size_t>(head - tail), std::memory_order_relaxed);
+#ifdef GWATCH_PROFILE
+				const auto start = std::chrono::high_resolution_clock::now();
+#endif
+				const LogFormat format = g_format.load();
+				std::uint64_t batchRecords = 0;
+				std::size_t block = 0;
+				for (auto& b : blocks)
+					b.clear();
+				// A trace file takes the records one by one, straight into its storage.
+				TraceSink* trace = g_trace.load(std::memory_order_acquire);
+				std::unique_lock<std::mutex> traceLock;
+				if (trace != nullptr)
+					traceLock = std::unique_lock(trace->mutex);
+
+				while (tail != head)
+				{
+					const LogRecord& record = state.ring[tail & state.mask];
+					if (trace != nullptr)
+						append_to_trace(*trace, record, traceScratch, views, format);
+					else
+					{
+						// Blocks may overrun kBlockSize by one record (long names, binary definitions).
+						if (blocks[block].size() >= kBlockSize - Logger::max_line_length(0))
+						{
+							if (++block == kBlockCount)
+								break;
+						}
+						append_record(blocks[block], record, views, format);
+					}
+					++tail;
+					++batchRecords;
+					// Pick up records pushed while formatting, up to the staging capacity.
+					if (tail == head)
+						head = state.head.load();
+				}
+				// Free the ring slots before the (possibly slow) write.
+				state.tail.store(tail, std::memory_order_release);
+				if (traceLock.owns_lock())
+					traceLock.unlock();
+
+				iov.clear();
+				std::size_t batchBytes = 0;
+				for (auto& b : blocks)
+				{
+					if (b.empty())
+						break;
+					iov.push_back(iovec{.iov_base = b.data(), .iov_len = b.size()});
+					batchBytes += b.size();
+				}
+				// A broken stdout must not block the target: keep consuming, stop writing.
+				if (auto* compressor = g_compressor.load(std::memory_order_acquire))
+				{
+					for (const iovec& v : iov)
+						compressor->write(static_cast<const char*>(v.iov_base), v.iov_len);
+				}
+				else if (!failed)
+					failed = !write_all(iov);
+
+				state.written.fetch_add(batchRecords);
+				state.written.notify_all();
+#ifdef GWATCH_PROFILE
+				const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+				profiling::add_async_log_batch(batchRecords, batchBytes, static_cast<std::uint64_t>(elapsed));
+#endif
+			}
+		}
+
+		SpillFile::SpillFile(std::string path) :
+			m_path(std::move(path)),
+			m_file(std::fopen(m_path.c_str(), "w+b"))
+		{
+			if (m_file == nullptr)
+				throw std::runtime_error("Cannot open spill file '" + m_path + "': " + std::strerror(errno));
+		}
+
+		SpillFile::~SpillFile()
+		{
+			if (m_file != nullptr)
+				std::fclose(m_file);
+			std::remove(m_path.c_str());
+		}
+
+		bool SpillFile::append(const std::vector<char>& bytes)
+		{
+			if (m_file == nullptr || std::fseek(m_file, 0, SEEK_END) != 0)
+				return false;
+			const std::size_t n = std::fwrite(bytes.data(), 1, bytes.size(), m_file);
+			m_written += n;
+			return n == bytes.size();
+		}
+
+		void SpillFile::read(std::vector<char>& out, const std::size_t max)
+		{
+			const std::size_t used = out.size();
+			const auto wanted = static_cast<std::size_t>(std::min<std::uint64_t>(max, m_written - m_read));
+			out.resize(used + wanted);
+			std::size_t n = 0;
+			if (std::fflush(m_file) == 0 && std::fseek(m_file, static_cast<long>(m_read), SEEK_SET) == 0)
+				n = std::fread(out.data() + used, 1, wanted, m_file);
+			out.resize(used + n);
+			// A file that cannot be read back is given up on rather than retried forever.
+			m_read = n == 0 ? m_written : m_read + n;
+			if (m_read == m_written)
+			{
+				// Everything is back in memory: start over with an empty file.
+				std::fclose(m_file);
+				m_file = std::fopen(m_path.c_str(), "w+b");
+				m_read = m_written = 0;
+			}
+		}
+
+		OutputChannel::OutputChannel(const bool nonBlocking)
+		{
+#ifndef _WIN32
+			struct stat st{};
+			if (!nonBlocking || fstat(STDOUT_FILENO, &st) != 0)
+				return;
+			if (S_ISFIFO(st.st_mode))
+			{
+				const int fd = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+				if (fd >= 0)
+				{
+					m_fd = fd;
+					m_ownFd = true;
+				}
+			}
+			else if (S_ISSOCK(st.st_mode))
+			{
+				m_socket = true;
+			}
+#else
+			(void)nonBlocking;
+#endif
+		}
+
+		OutputChannel::~OutputChannel()
+		{
+#ifndef _WIN32
+			if (m_ownFd)
+				close(m_fd);
+#endif
+		}
+
+		std::ptrdiff_t OutputChannel::write_some(const char* data, const std::size_t size)
+		{
+			while (true)
+			{
+#ifdef _WIN32
+				const auto n = _write(m_fd, data, static_cast<unsigned>(std::min<std::size_t>(size, INT_MAX)));
+#else
+				const ssize_t n = m_socket ? send(m_fd, data, size, MSG_DONTWAIT) : write(m_fd, data, size);
+#endif
+				if (n >= 0)
+					return n;
+				if (errno == EINTR)
+					continue;
+				return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+			}
+		}
+
+		void OutputChannel::wait_writable(const std::chrono::milliseconds timeout)
+		{
+#ifdef _WIN32
+			std::this_thread::sleep_for(timeout);
+#else
+			pollfd fd{.fd = m_fd, .events = POLLOUT, .revents = 0};
+			poll(&fd, 1, static_cast<int>(timeout.count()));
+#endif
+		}
+
+		// Writer of every policy but Block: it never waits on stdout. Records the writer cannot
+		// format yet wait in pending, up to what the ring leaves of the capacity; past it the
+		// policy applies.
+		// Records are always formatted in output order (the binary encoding depends on it):
+		// once spilling, pending is emptied into the file and new records follow them there.
+		void overflow_writer_loop(AsyncState& state)
+		{
+			constexpr std::size_t kOutputSize = kBlockSize * kBlockCount;
+			OutputChannel channel(true);
+			std::deque<LogRecord> pending;
+			std::vector<char> out;
+			out.reserve(kOutputSize + kBlockSize);
+			std::vector<char> spillBuffer;
+			std::size_t sent = 0; // bytes of out already on stdout
+			SymbolViews views;
+			bool failed = false;
+			// pending + (head - tail) never exceeds the capacity: the ring holds the rest.
+			const std::size_t pendingLimit = state.capacity - state.ring.size();
+
+			while (true)
+			{
+				std::uint64_t tail = state.tail.load(std::memory_order_relaxed);
+				const std::uint64_t head = state.head.load();
+				const LogFormat format = g_format.load();
+				if (head - tail + pending.size() > state.peak.load(std::memory_order_relaxed))
+					state.peak.store(static_cast<std::size_t>(head - tail + pending.size()), std::memory_order_relaxed);
+
+				spillBuffer.clear();
+				std::uint64_t spilledRecords = 0;
+				for (; tail != head; ++tail)
+				{
+					const LogRecord& record = state.ring[tail & state.mask];
+					if (state.spill && state.spill->pending())
+					{
+						append_record(spillBuffer, record, views, format);
+						++spilledRecords;
+						continue;
+					}
+					if (pending.size() < pendingLimit)
+					{
+						pending.push_back(record);
+						continue;
+					}
+					switch (state.overflow)
+					{
+					case OverflowPolicy::DropNewest:
+						state.dropped.fetch_add(1, std::memory_order_relaxed);
+						break;
+					case OverflowPolicy::DropOldest:
+						pending.pop_front();
+						pending.push_back(record);
+						state.dropped.fetch_add(1, std::memory_order_relaxed);
+						break;
+					case OverflowPolicy::Spill:
+						for (const auto& queued : pending)
+							append_record(spillBuffer, queued, views, format);
+						spilledRecords += pending.size();
+						pending.clear();
+						append_record(spillBuffer, record, views, format);
+						++spilledRecords;
+						// Marks the spill as pending for the next records of this batch.
+						if (!state.spill->append(spillBuffer))
+							state.dropped.fetch_add(spilledRecords, std::memory_order_relaxed);
+						state.spilledBytes.fetch_add(spillBuffer.size(), std::memory_order_relaxed);
+						spillBuffer.clear();
+						spilledRecords = 0;
+						break;
+					default: // Block: start_async runs writer_loop instead
+						break;
+					}
+				}
+				if (!spillBuffer.empty())
+				{
+					if (!state.spill->append(spillBuffer))
+						state.dropped.fetch_add(spilledRecords, std::memory_order_relaxed);
+					state.spilledBytes.fetch_add(spillBuffer.size(), std::memory_order_relaxed);
+				}
+				state.tail.store(tail, std::memory_order_release);
+
+				// Refill in output order: pending records first, then the spilled bytes.
+				if (sent == out.size())
+				{
+					out.clear();
+					sent = 0;
+					while (!pending.empty() && out.size() < kOutputSize)
+					{
+						append_record(out, pending.front(), views, format);
+						pending.pop_front();
+					}
+					if (out.empty() && state.spill && state.spill->pending())
+						state.spill->read(out, kOutputSize);
+				}
+
+				bool full = false;
+				if (sent < out.size())
+				{
+					// A broken stdout must not block the target: keep consuming, stop writing.
+					const std::ptrdiff_t n = failed ? -1 : channel.write_some(out.data() + sent, out.size() - sent);
+					failed = n < 0;
+					sent = failed ? out.size() : sent + static_cast<std::size_t>(n);
+					full = n == 0;
+				}
+
+				const bool drained = sent == out.size() && pending.empty() && !(state.spill && state.spill->pending());
+				if (drained && state.written.load(std::memory_order_relaxed) != tail)
+				{
+					state.written.store(tail);
+					state.written.notify_all();
+				}
+
+				if (full)
+				{
+					channel.wait_writable(std::chrono::milliseconds(1));
+					continue;
+				}
+				if (!drained || state.head.load() != tail)
+					continue;
+				if (state.stopRequested.load())
+					break;
+				state.writerSleeping.store(1);
+				if (state.head.load() == tail && !state.stopRequested.load())
+					state.writerSleeping.wait(1);
+				state.writerSleeping.store(0);
+			}
+		}
+
+		QueueStats queue_stats_of(const AsyncState& state)
+		{
+			return QueueStats{
+				.capacity = state.capacity,
+				.peak = state.peak.load(std::memory_order_relaxed),
+				.dropped = state.dropped.load(std::memory_order_relaxed),
+				.spilledBytes = state.spilledBytes.load(std::memory_order_relaxed),
+			};
+		}
+
+		void log_async(AsyncState& state, const LogRecord& record)
+		{
+#ifdef GWATCH_PROFILE
+			const auto start = std::chrono::high_resolution_clock::now();
+#endif
+			push(state, record);
+#ifdef GWATCH_PROFILE
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			profiling::add_log_duration(static_cast<std::uint64_t>(elapsed));
+#endif
+		}
+
+		void log_encoded(const LogRecord& record, const LogFormat format)
+		{
+#ifdef GWATCH_PROFILE
+			const auto start = std::chrono::high_resolution_clock::now();
+#endif
+			thread_local SymbolViews views;
+			thread_local std::vector<char> buffer;
+			buffer.clear();
+			append_record(buffer, record, views, format);
+			if (!buffer.empty())
+				write_stdout(buffer.data(), buffer.size());
+#ifdef GWATCH_PROFILE
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			profiling::add_log_duration(static_cast<std::uint64_t>(elapsed));
+#endif
+		}
+
+		// Synchronous text output: the line is assembled in a per-thread buffer from the
+		// preformatted prefix and handed to stdout in one call. stdio batches the lines into
+		// large writes (main() gives stdout a 64 KiB buffer unless it is a terminal).
+		void write_line(const std::string_view prefix, const LogRecord& record)
+		{
+			thread_local std::vector<char> line;
+			if (line.size() < Logger::max_line_length(prefix.size()))
+				line.resize(Logger::max_line_length(prefix.size()));
+			const char* end = append_values(append(line.data(), prefix), record);
+			write_stdout(line.data(), static_cast<std::size_t>(end - line.data()));
+		}
+
+		void log_text(const LogRecord& record)
+		{
+#ifdef GWATCH_PROFILE
+			const auto start = std::chrono::high_resolution_clock::now();
+#endif
+			thread_local SymbolViews views;
+			views.covering(record.symbol);
+			write_line(views.prefix(record.symbol, record.kind), record);
+#ifdef GWATCH_PROFILE
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			profiling::add_log_duration(static_cast<std::uint64_t>(elapsed));
+#endif
+		}
+
+		void emit(const LogRecord& record)
+		{
+			const LogFormat format = g_format.load(std::memory_order_relaxed);
+			if (auto* state = g_async.load(std::memory_order_acquire))
+			{
+				log_async(*state, record);
+				return;
+			}
+			if (log_to_trace(record, format))
+				return;
+			if (format == LogFormat::Text)
+				log_text(record);
+			else
+				log_encoded(record, format);
+		}
+
+		bool same_access(const LogRecord& a, const LogRecord& b)
+		{
+			return a.symbol == b.symbol && a.kind == b.kind && a.tid == b.tid && a.exact == b.exact && a.old_value == b.old_value && a.new_value == b.new_value;
+		}
+
+		// Caller holds state.mutex.
+		void coalesce(CoalesceState& state, const LogRecord& record)
+		{
+			const auto run = state.coalescing == Coalescing::Global
+				? state.runs.begin()
+				: std::ranges::find(state.runs, record.tid, &LogRecord::tid);
+			if (run == state.runs.end())
+			{
+				if (state.runs.size() == CoalesceState::kMaxRuns)
+				{
+					emit(state.runs.front());
+					state.runs.erase(state.runs.begin());
+				}
+				state.runs.push_back(record);
+				return;
+			}
+
+			const bool expired = state.windowNs != 0 && record.timestamp_ns - run->timestamp_ns >= state.windowNs;
+			if (same_access(*run, record) && !expired && run->repeat != UINT32_MAX)
+			{
+				++run->repeat;
+				return;
+			}
+			emit(*run);
+			*run = record;
+		}
+
+		// Caller holds state.mutex. Prints the runs started before cutoff_ns (all of them by default).
+		void emit_runs(CoalesceState& state, const std::uint64_t cutoff_ns = UINT64_MAX)
+		{
+			std::erase_if(state.runs, [cutoff_ns](const LogRecord& run)
+			{
+				if (run.timestamp_ns >= cutoff_ns)
+					return false;
+				emit(run);
+				return true;
+			});
+		}
+
+		void flusher_loop(CoalesceState& state)
+		{
+			std::unique_lock lock(state.mutex);
+			const auto period = std::chrono::nanoseconds(state.windowNs / 2 + 1);
+			while (!state.stopRequested)
+			{
+				state.wake.wait_for(lock, period);
+				const std::uint64_t now = now_ns();
+				if (now > state.windowNs)
+					emit_runs(state, now - state.windowNs + 1);
+			}
+		}
+
+		PolicyState::Variable& policy_variable(PolicyState& state, const std::uint32_t id, const std::string_view symbol)
+		{
+			if (id >= state.variables.size())
+				state.variables.resize(id + 1);
+			PolicyState::Variable& v = state.variables[id];
+			if (!v.resolved)
+			{
+				v.resolved = true;
+				v.name = symbol;
+				v.policy = state.fallback;
+				if (const auto it = std::ranges::find(state.named, symbol, &std::pair<std::string, LogPolicy>::first); it != state.named.end())
+				{
+					if (it->second.ratePerSecond != 0)
+						v.policy.ratePerSecond = it->second.ratePerSecond;
+					if (it->second.sampleEvery != 0)
+						v.policy.sampleEvery = it->second.sampleEvery;
+				}
+				v.tokens = v.policy.ratePerSecond;
+			}
+			return v;
+		}
+
+		// Caller holds state.mutex.
+		void report_new_drops(PolicyState& state)
+		{
+			for (auto& v : state.variables)
+			{
+				if (v.dropped == v.reported)
+					continue;
+				std::fprintf(stderr, "drop: %s reads=%" PRIu64 " writes=%" PRIu64 "\n", v.name.c_str(), v.dropped[0] - v.reported[0], v.dropped[1] - v.reported[1]);
+				v.reported = v.dropped;
+			}
+		}
+
+		// Caller holds state.mutex.
+		LogDrops total_drops(const PolicyState& state)
+		{
+			LogDrops total;
+			for (const auto& v : state.variables)
+			{
+				total.reads += v.dropped[static_cast<std::size_t>(AccessKind::Read)];
+				total.writes += v.dropped[static_cast<std::size_t>(AccessKind::Write)];
+			}
+			return total;
+		}
+
+		// Returns false when the policy of the variable drops the access.
+		bool admit(PolicyState& state, const std::uint32_t id, const std::string_view symbol, const AccessKind kind, const std::uint64_t timestamp_ns)
+		{
+			const std::lock_guard lock(state.mutex);
+			PolicyState::Variable& v = policy_variable(state, id, symbol);
+			bool sampled = false;
+			bool keep = true;
+			if (v.policy.sampleEvery > 1 && v.seen++ % v.policy.sampleEvery != 0)
+			{
+				sampled = true;
+				keep = false;
+			}
+			else if (v.policy.ratePerSecond != 0)
+			{
+				const double rate = v.policy.ratePerSecond;
+				if (timestamp_ns > v.refillNs)
+				{
+					v.tokens = std::min(rate, v.tokens + static_cast<double>(timestamp_ns - v.refillNs) * rate / 1e9);
+					v.refillNs = timestamp_ns;
+				}
+				if (v.tokens >= 1)
+					v.tokens -= 1;
+				else
+					keep = false;
+			}
+
+			if (!keep)
+			{
+				++v.dropped[static_cast<std::size_t>(kind)];
+				profiling::add_log_drop(kind == AccessKind::Write, sampled);
+			}
+			if (state.summaryNs == 0)
+				state.summaryNs = timestamp_ns;
+			else if (timestamp_ns - state.summaryNs >= PolicyState::kSummaryPeriodNs)
+			{
+				report_new_drops(state);
+				state.summaryNs = timestamp_ns;
+			}
+			return keep;
+		}
+
+		// Returns true when the record was handled by the stats, coalescing, asynchronous, trace file or encoded path.
+		bool log_record(const std::string_view symbol, const AccessKind kind, const std::uint64_t old_value, const std::uint64_t new_value, const std::uint32_t tid, const std::uint64_t timestamp_ns, const std::uint64_t ip, const bool exact = true)
+		{
+			if (auto* stats = g_stats.load(std::memory_order_acquire))
+			{
+				stats->record(intern(symbol), symbol, kind, exact ? std::optional(new_value) : std::nullopt, tid, timestamp_ns);
+				return true;
+			}
+
+			auto* policies = g_policies.load(std::memory_order_acquire);
+			auto* coalesceState = g_coalesce.load(std::memory_order_acquire);
+			auto* state = g_async.load(std::memory_order_acquire);
+			const LogFormat format = g_format.load(std::memory_order_relaxed);
+			if (policies == nullptr && coalesceState == nullptr && state == nullptr && format == LogFormat::Text && g_trace.load(std::memory_order_relaxed) == nullptr)
+				return false;
+
+			LogRecord record{
+				.timestamp_ns = timestamp_ns,
+				.old_value = old_value,
+				.new_value = new_value,
+				.tid = tid,
+				.symbol = intern(symbol),
+				.kind = kind,
+				.exact = exact,
+				.ip = ip,
+			};
+			// Runs and buckets are timed even when the output does not show time.
+			if ((format != LogFormat::Text || coalesceState != nullptr || policies != nullptr) && record.timestamp_ns == 0)
+				record.timestamp_ns = now_ns();
+
+			if (policies != nullptr && !admit(*policies, record.symbol, symbol, kind, record.timestamp_ns))
+				return true;
+			if (coalesceState != nullptr)
+			{
+				const std::lock_guard lock(coalesceState->mutex);
+				coalesce(*coalesceState, record);
+			}
+			else
+				emit(record);
+			return true;
+		}
+	}
+
+	void Logger::log_read(const std::string_view symbol, const std::uint64_t value, const std::uint32_t tid, const std::uint64_t timestamp_ns, const std::uint64_t ip)
+	{
+		if (log_record(symbol, AccessKind::Read, value, value, tid, timestamp_ns, ip))
+			return;
 #ifdef GWATCH_PROFILE
 		const auto start = std::chrono::high_resolution_clock::now();
 #endif
-		std::printf("%.*s read %" PRIu64 "\n", static_cast<int>(symbol.size()), symbol.data(), static_cast<uint64_t>(value));
+		const auto entry = intern_recent(symbol);
+		write_line(entry.prefixes[static_cast<std::size_t>(AccessKind::Read)], LogRecord{.new_value = value, .kind = AccessKind::Read});
 #ifdef GWATCH_PROFILE
 		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
 		profiling::add_log_duration(static_cast<std::uint64_t>(elapsed));
 #endif
 	}
 
-	void Logger::log_write(const std::string_view symbol, const std::uint64_t old_value, const std::uint64_t new_value)
+	void Logger::log_write(const std::string_view symbol, const std::uint64_t old_value, const std::uint64_t new_value, const std::uint32_t tid, const std::uint64_t timestamp_ns, const std::uint64_t ip)
 	{
+		if (log_record(symbol, AccessKind::Write, old_value, new_value, tid, timestamp_ns, ip))
+			return;
 #ifdef GWATCH_PROFILE
 		const auto start = std::chrono::high_resolution_clock::now();
 #endif
-		std::printf("%.*s write %" PRIu64 " -> %" PRIu64 "\n", static_cast<int>(symbol.size()), symbol.data(), static_cast<uint64_t>(old_value), static_cast<uint64_t>(new_value));
+		const auto entry = intern_recent(symbol);
+		write_line(entry.prefixes[static_cast<std::size_t>(AccessKind::Write)], LogRecord{.old_value = old_value, .new_value = new_value, .kind = AccessKind::Write});
 #ifdef GWATCH_PROFILE
 		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
 		profiling::add_log_duration(static_cast<std::uint64_t>(elapsed));
 #endif
 	}
+
+	void Logger::log_access(const std::string_view symbol, const AccessKind kind, const std::uint32_t tid, const std::uint64_t timestamp_ns, const std::uint64_t ip)
+	{
+		if (log_record(symbol, kind, 0, 0, tid, timestamp_ns, ip, false))
+			return;
+		const auto entry = intern_recent(symbol);
+		write_line(entry.prefixes[static_cast<std::size_t>(kind)], LogRecord{.kind = kind, .exact = false});
+	}
+
+	std::uint32_t Logger::register_symbol(const std::string_view symbol, const std::uint32_t size)
+	{
+		const std::lock_guard lock(g_symbols.mutex);
+		const std::uint32_t id = find_or_add(symbol);
+		g_symbols.entries[id].size = size;
+		return id;
+	}
+
+	void Logger::set_format(const LogFormat format)
+	{
+		end_stream();
+		g_format.store(format);
+		g_encoder.reset();
+		g_columns.reset();
+#ifdef _WIN32
+		_setmode(_fileno(stdout), format == LogFormat::Text ? _O_TEXT : _O_BINARY);
+#endif
+	}
+
+	LogFormat Logger::output_format()
+	{
+		return g_format.load();
+	}
+
+	void Logger::set_row_group(const std::uint32_t rows)
+	{
+		g_groupRows = std::max<std::uint32_t>(rows, 1);
+		g_columns.set_rows(group_rows());
+	}
+
+	void Logger::end_stream()
+	{
+		flush();
+		if (g_columns.buffered() == 0)
+			return;
+		SymbolViews views;
+		const auto& symbols = views.covering(UINT32_MAX);
+#ifdef __linux__
+		if (TraceSink* sink = g_trace.load())
+		{
+			const std::lock_guard lock(sink->mutex);
+			append_group_to_trace(*sink, symbols, sink->scratch);
+			return;
+		}
+#endif
+		std::vector<char> buffer;
+		g_columns.render(symbols, buffer);
+		write_stdout(buffer.data(), buffer.size());
+		std::fflush(stdout);
+	}
+
+	void Logger::open_trace_file(const TraceFileOptions& options)
+	{
+#ifdef __linux__
+		close_trace_file();
+		auto sink = std::make_unique<TraceSink>(options);
+		end_stream();
+		// The first segment starts a new stream.
+		const std::lock_guard lock(sink->mutex);
+		g_encoder.reset();
+		g_columns.restart();
+		g_segmentBytes = options.segmentBytes;
+		g_columns.set_rows(group_rows());
+		g_trace.store(sink.release(), std::memory_order_release);
+#else
+		(void)options;
+		throw std::runtime_error("Trace files are only supported on Linux.");
+#endif
+	}
+
+	void Logger::close_trace_file()
+	{
+		TraceSink* sink = g_trace.load();
+		if (sink == nullptr)
+			return;
+		end_stream();
+		{
+			const std::lock_guard lock(sink->mutex);
+			g_trace.store(nullptr);
+			// stdout gets a stream of its own.
+			g_encoder.reset();
+			g_columns.restart();
+			g_segmentBytes = 0;
+			g_columns.set_rows(group_rows());
+		}
+#ifdef __linux__
+		delete sink;
+#endif
+	}
+
+	void Logger::start_compression(const CompressionOptions& options)
+	{
+		stop_compression();
+		auto compressor = std::make_unique<compress::StreamCompressor>(options.codec, options.blockBytes, [](const char* data, const std::size_t size)
+		{
+			return std::fwrite(data, 1, size, stdout) == size;
+		});
+		// Lines logged so far stay uncompressed, ahead of the stream.
+		flush();
+		g_compressor.store(compressor.release(), std::memory_order_release);
+	}
+
+	void Logger::stop_compression()
+	{
+		if (g_compressor.load() == nullptr)
+			return;
+		end_stream();
+		const std::unique_ptr<compress::StreamCompressor> compressor(g_compressor.exchange(nullptr));
+		compressor->close();
+		const auto stats = compressor->stats();
+		profiling::add_compression(stats.blocks, stats.rawBytes, stats.compressedBytes, stats.compressNs);
+		std::fflush(stdout);
+	}
+
+	void Logger::start_async(const std::size_t capacity)
+	{
+		start_async(AsyncOptions{.capacity = capacity, .overflow = OverflowPolicy::Block, .spillPath = {}});
+	}
+
+	void Logger::start_async(const AsyncOptions& options)
+	{
+		if (g_async.load() != nullptr)
+			return;
+
+		// Lines already buffered by stdio must come out before the writer's.
+		std::fflush(stdout);
+		// A trace file never stalls and the compression stage waits for its worker: the
+		// overflow policies are for plain stdout.
+		const bool overflowWriter = options.overflow != OverflowPolicy::Block && g_trace.load() == nullptr && g_compressor.load() == nullptr;
+		auto state = std::make_unique<AsyncState>(options, overflowWriter);
+		if (!overflowWriter)
+			state->writer = std::thread([s = state.get()] { writer_loop(*s); });
+		else
+			state->writer = std::thread([s = state.get()] { overflow_writer_loop(*s); });
+		g_async.store(state.release(), std::memory_order_release);
+	}
+
+	void Logger::stop_async()
+	{
+		AsyncState* state = g_async.load();
+		if (state == nullptr)
+			return;
+
+		flush();
+		g_async.store(nullptr);
+		state->stopRequested.store(true);
+		state->writerSleeping.store(0);
+		state->writerSleeping.notify_one();
+		if (state->writer.joinable())
+			state->writer.join();
+		g_lastQueueStats = queue_stats_of(*state);
+		profiling::add_output_queue(g_lastQueueStats.peak, g_lastQueueStats.dropped, g_lastQueueStats.spilledBytes);
+		delete state;
+	}
+
+	void Logger::flush()
+	{
+		if (auto* coalesceState = g_coalesce.load(std::memory_order_acquire))
+		{
+			const std::lock_guard lock(coalesceState->mutex);
+			emit_runs(*coalesceState);
+		}
+
+		AsyncState* state = g_async.load(std::memory_order_acquire);
+		if (state == nullptr)
+		{
+			std::fflush(stdout);
+			return;
+		}
+
+		const std::uint64_t target = state->head.load();
+		std::uint64_t done = state->written.load();
+		while (done < target)
+		{
+			wake_writer(*state);
+			state->written.wait(done);
+			done = state->written.load();
+		}
+	}
+
+	bool Logger::async_active()
+	{
+		return g_async.load(std::memory_order_acquire) != nullptr;
+	}
+
+	QueueStats Logger::queue_stats()
+	{
+		if (const AsyncState* state = g_async.load(std::memory_order_acquire))
+			return queue_stats_of(*state);
+		return g_lastQueueStats;
+	}
+
+	void Logger::set_coalescing(const Coalescing coalescing, const std::uint64_t window_ns)
+	{
+		if (CoalesceState* previous = g_coalesce.exchange(nullptr))
+		{
+			{
+				const std::lock_guard lock(previous->mutex);
+				emit_runs(*previous);
+				previous->stopRequested = true;
+			}
+			previous->wake.notify_one();
+			if (previous->flusher.joinable())
+				previous->flusher.join();
+			delete previous;
+		}
+		if (coalescing == Coalescing::Off)
+			return;
+
+		auto state = std::make_unique<CoalesceState>();
+		state->coalescing = coalescing;
+		state->windowNs = window_ns;
+		state->runs.reserve(coalescing == Coalescing::Global ? 1 : CoalesceState::kMaxRuns);
+		if (window_ns != 0)
+			state->flusher = std::thread([s = state.get()] { flusher_loop(*s); });
+		g_coalesce.store(state.release(), std::memory_order_release);
+	}
+
+	void Logger::set_policy(const std::string_view symbol, const LogPolicy& policy)
+	{
+		PolicyState& state = g_policyState;
+		{
+			const std::lock_guard lock(state.mutex);
+			if (symbol.empty())
+				state.fallback = policy;
+			else if (const auto it = std::ranges::find(state.named, symbol, &std::pair<std::string, LogPolicy>::first); it != state.named.end())
+				it->second = policy;
+			else
+				state.named.emplace_back(std::string(symbol), policy);
+			// Resolved again on their next access.
+			for (auto& v : state.variables)
+				v.resolved = false;
+		}
+		g_policies.store(&state, std::memory_order_release);
+	}
+
+	void Logger::clear_policies()
+	{
+		// Threads that loaded the pointer before it is cleared find no policy left: they admit
+		// their record and count nothing.
+		g_policies.store(nullptr, std::memory_order_release);
+		PolicyState& state = g_policyState;
+		const std::lock_guard lock(state.mutex);
+		state.fallback = {};
+		state.named.clear();
+		state.variables.clear();
+		state.summaryNs = 0;
+	}
+
+	void Logger::report_drops()
+	{
+		PolicyState* state = g_policies.load(std::memory_order_acquire);
+		if (state == nullptr)
+			return;
+
+		const std::lock_guard lock(state->mutex);
+		report_new_drops(*state);
+		const LogDrops total = total_drops(*state);
+		if (total.reads + total.writes > 0)
+			std::fprintf(stderr, "drop: total reads=%" PRIu64 " writes=%" PRIu64 "\n", total.reads, total.writes);
+	}
+
+	LogDrops Logger::dropped()
+	{
+		PolicyState* state = g_policies.load(std::memory_order_acquire);
+		if (state == nullptr)
+			return {};
+
+		const std::lock_guard lock(state->mutex);
+		return total_drops(*state);
+	}
+
+	void Logger::set_stats(AccessStats* stats)
+	{
+		flush();
+		g_stats.store(stats, std::memory_order_release);
+	}
+
+	std::size_t Logger::format_text(const LogRecord& record, const std::string_view symbol, char* out)
+	{
+		char* p = append(out, symbol);
+		p = append(p, record.kind == AccessKind::Read ? std::string_view(" read ") : std::string_view(" write "));
+		return static_cast<std::size_t>(append_values(p, record) - out);
+	}
 }
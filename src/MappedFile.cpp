@@ -0,0 +1,95 @@
+#include "../include/MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gwatch
+{
+	MappedFile::MappedFile(const std::string& path) :
+		m_path(path)
+	{
+#ifdef __linux__
+		const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			throw std::runtime_error("Cannot open '" + path + "': " + std::strerror(errno));
+		struct stat st{};
+		if (::fstat(fd, &st) != 0)
+		{
+			const int error = errno;
+			::close(fd);
+			throw std::runtime_error("Cannot stat '" + path + "': " + std::strerror(error));
+		}
+		m_size = static_cast<std::size_t>(st.st_size);
+		if (m_size > 0)
+		{
+			void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				const int error = errno;
+				::close(fd);
+				throw std::runtime_error("Cannot map '" + path + "': " + std::strerror(error));
+			}
+			m_data = static_cast<const char*>(data);
+			m_mapped = true;
+		}
+		::close(fd);
+#else
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("Cannot open '" + path + "'");
+		m_copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		m_data = m_copy.data();
+		m_size = m_copy.size();
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		release();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept :
+		m_path(std::move(other.m_path)),
+		m_data(std::exchange(other.m_data, nullptr)),
+		m_size(std::exchange(other.m_size, 0)),
+		m_copy(std::move(other.m_copy)),
+		m_mapped(std::exchange(other.m_mapped, false))
+	{
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			m_path = std::move(other.m_path);
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_copy = std::move(other.m_copy);
+			m_mapped = std::exchange(other.m_mapped, false);
+		}
+		return *this;
+	}
+
+	void MappedFile::release()
+	{
+#ifdef __linux__
+		if (m_mapped)
+			::munmap(const_cast<char*>(m_data), m_size);
+#endif
+		m_mapped = false;
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
@@ -8,6 +8,9 @@
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace
 {
@@ -22,6 +25,7 @@ namespace
 
 		// Program phases
 		std::atomic<long long> launch_ns{0};
+		std::atomic<long long> first_event_ns{0};
 		std::atomic<long long> resolve_ns{0};
 		std::atomic<long long> setup_ns{0};
 
@@ -29,6 +33,72 @@ namespace
 		std::atomic<std::uint64_t> loop_iters{0};
 		std::atomic<long long> loop_wait_ns{0};
 		std::atomic<long long> loop_handle_ns{0};
+
+		// Perf ring buffer drains
+		std::atomic<std::uint64_t> perf_drains{0};
+		std::atomic<std::uint64_t> perf_samples{0};
+		std::atomic<std::uint64_t> perf_lost{0};
+		std::atomic<long long> perf_drain_ns{0};
+
+		// Page-protection faults on watched objects and on their page neighbours
+		std::atomic<std::uint64_t> page_hits{0};
+		std::atomic<std::uint64_t> page_false_sharing{0};
+		std::atomic<long long> page_hit_ns{0};
+		std::atomic<long long> page_false_sharing_ns{0};
+
+		// Soft-dirty scans: pagemap read + clear, then fetch + diff of the dirty pages
+		std::atomic<std::uint64_t> dirty_scans{0};
+		std::atomic<std::uint64_t> dirty_pages_scanned{0};
+		std::atomic<std::uint64_t> dirty_pages{0};
+		std::atomic<long long> dirty_scan_ns{0};
+		std::atomic<long long> dirty_diff_ns{0};
+
+		// Polling watcher runs
+		std::atomic<std::uint64_t> poll_ticks{0};
+		std::atomic<std::uint64_t> poll_overruns{0};
+		std::atomic<long long> poll_ns{0};
+
+		// Asynchronous logger batches
+		std::atomic<std::uint64_t> log_batches{0};
+		std::atomic<std::uint64_t> log_batch_records{0};
+		std::atomic<std::uint64_t> log_batch_bytes{0};
+		std::atomic<long long> log_batch_ns{0};
+
+		// Accesses kept out of the output by the Logger policies
+		std::atomic<std::uint64_t> log_dropped_reads{0};
+		std::atomic<std::uint64_t> log_dropped_writes{0};
+		std::atomic<std::uint64_t> log_sampled_out{0};
+
+		// Asynchronous output queue
+		std::atomic<std::uint64_t> queue_peak{0};
+		std::atomic<std::uint64_t> queue_dropped{0};
+		std::atomic<std::uint64_t> queue_spilled_bytes{0};
+
+		// io_uring trace storage writes
+		std::atomic<std::uint64_t> trace_writes{0};
+		std::atomic<std::uint64_t> trace_write_bytes{0};
+		std::atomic<std::uint64_t> trace_in_flight_total{0};
+		std::atomic<std::uint64_t> trace_in_flight_max{0};
+		std::atomic<long long> trace_latency_ns{0};
+		std::atomic<long long> trace_latency_max_ns{0};
+		std::atomic<long long> trace_busy_ns{0};
+
+		// Compression stage
+		std::atomic<std::uint64_t> compress_blocks{0};
+		std::atomic<std::uint64_t> compress_raw_bytes{0};
+		std::atomic<std::uint64_t> compress_out_bytes{0};
+		std::atomic<long long> compress_ns{0};
+
+		// Watch rotation coverage, one entry per variable
+		struct Coverage
+		{
+			std::string name;
+			std::uint64_t armed_ns = 0;
+			std::uint64_t total_ns = 0;
+			std::uint64_t observed = 0;
+		};
+		std::mutex coverage_mutex;
+		std::vector<Coverage> coverage;
 	};
 
 	ProfilingStats& stats()
@@ -44,6 +114,8 @@ namespace
 	public:
 		Reporter()
 		{
+			// Constructed first so that it is destroyed after dump() ran.
+			stats();
 			std::atexit(&Reporter::dump);
 		}
 
@@ -77,12 +149,130 @@ namespace
 			const auto total_prog_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - g_program_start).count();
 			std::cerr << "[profiling] program total: " << to_ms(total_prog_ns) << " ms\n";
 
+			if (const auto drains = stats().perf_drains.load(std::memory_order_relaxed); drains > 0)
+			{
+				const auto drain_ns = stats().perf_drain_ns.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] perf samples: " << stats().perf_samples.load(std::memory_order_relaxed)
+					<< " lost=" << stats().perf_lost.load(std::memory_order_relaxed)
+					<< " drains=" << drains
+					<< " drain_total=" << to_ms(drain_ns) << " ms"
+					<< " drain_avg=" << safe_avg(drain_ns, drains) / 1'000.0 << " us\n";
+			}
+
+			const auto page_hits = stats().page_hits.load(std::memory_order_relaxed);
+			if (const auto false_sharing = stats().page_false_sharing.load(std::memory_order_relaxed); page_hits + false_sharing > 0)
+			{
+				const auto false_sharing_ns = stats().page_false_sharing_ns.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] page faults: watched=" << page_hits
+					<< " (" << to_ms(stats().page_hit_ns.load(std::memory_order_relaxed)) << " ms)"
+					<< " false-sharing=" << false_sharing
+					<< " (" << to_ms(false_sharing_ns) << " ms, "
+					<< 100.0 * static_cast<double>(false_sharing) / static_cast<double>(page_hits + false_sharing) << "% of faults)"
+					<< " false-sharing_avg=" << safe_avg(false_sharing_ns, false_sharing) / 1'000.0 << " us\n";
+			}
+
+			if (const auto scans = stats().dirty_scans.load(std::memory_order_relaxed); scans > 0)
+			{
+				const auto scan_ns = stats().dirty_scan_ns.load(std::memory_order_relaxed);
+				const auto diff_ns = stats().dirty_diff_ns.load(std::memory_order_relaxed);
+				const auto scanned = stats().dirty_pages_scanned.load(std::memory_order_relaxed);
+				const auto dirty = stats().dirty_pages.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] dirty scans: " << scans
+					<< " pages=" << scanned
+					<< " dirty=" << dirty
+					<< " (" << (scanned > 0 ? 100.0 * static_cast<double>(dirty) / static_cast<double>(scanned) : 0.0) << "%)"
+					<< " scan_total=" << to_ms(scan_ns) << " ms"
+					<< " scan_avg=" << safe_avg(scan_ns, scans) / 1'000.0 << " us"
+					<< " diff_total=" << to_ms(diff_ns) << " ms"
+					<< " diff_avg=" << safe_avg(diff_ns, scans) / 1'000.0 << " us\n";
+			}
+
+			if (const auto ticks = stats().poll_ticks.load(std::memory_order_relaxed); ticks > 0)
+			{
+				const auto overruns = stats().poll_overruns.load(std::memory_order_relaxed);
+				const auto run_ns = stats().poll_ns.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] polling: ticks=" << ticks
+					<< " overruns=" << overruns
+					<< " (" << 100.0 * static_cast<double>(overruns) / static_cast<double>(ticks) << "%)"
+					<< " rate=" << (run_ns > 0 ? static_cast<double>(ticks) * 1e9 / static_cast<double>(run_ns) : 0.0) << "/s"
+					<< " period_avg=" << safe_avg(run_ns, ticks) / 1'000.0 << " us\n";
+			}
+
+			if (const auto batches = stats().log_batches.load(std::memory_order_relaxed); batches > 0)
+			{
+				const auto batch_ns = stats().log_batch_ns.load(std::memory_order_relaxed);
+				const auto records = stats().log_batch_records.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] async log: records=" << records
+					<< " batches=" << batches
+					<< " bytes=" << stats().log_batch_bytes.load(std::memory_order_relaxed)
+					<< " records/batch=" << safe_avg(static_cast<long long>(records), batches)
+					<< " write_total=" << to_ms(batch_ns) << " ms\n";
+			}
+
+			const auto dropped_reads = stats().log_dropped_reads.load(std::memory_order_relaxed);
+			if (const auto dropped_writes = stats().log_dropped_writes.load(std::memory_order_relaxed); dropped_reads + dropped_writes > 0)
+			{
+				const auto sampled = stats().log_sampled_out.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] log drops: reads=" << dropped_reads
+					<< " writes=" << dropped_writes
+					<< " sampled=" << sampled
+					<< " rate-limited=" << dropped_reads + dropped_writes - sampled
+					<< " logged=" << logs << "\n";
+			}
+
+			if (const auto peak = stats().queue_peak.load(std::memory_order_relaxed); peak > 0)
+			{
+				std::cerr << "[profiling] output queue: peak=" << peak
+					<< " dropped=" << stats().queue_dropped.load(std::memory_order_relaxed)
+					<< " spilled=" << stats().queue_spilled_bytes.load(std::memory_order_relaxed) << " bytes\n";
+			}
+
+			if (const auto writes = stats().trace_writes.load(std::memory_order_relaxed); writes > 0)
+			{
+				const auto bytes = stats().trace_write_bytes.load(std::memory_order_relaxed);
+				const auto busy_ns = stats().trace_busy_ns.load(std::memory_order_relaxed);
+				const auto latency_ns = stats().trace_latency_ns.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] trace io: writes=" << writes
+					<< " bytes=" << bytes
+					<< " busy=" << to_ms(busy_ns) << " ms"
+					<< " throughput=" << (busy_ns > 0 ? static_cast<double>(bytes) * 1e3 / static_cast<double>(busy_ns) : 0.0) << " MB/s"
+					<< " in-flight_avg=" << safe_avg(static_cast<long long>(stats().trace_in_flight_total.load(std::memory_order_relaxed)), writes)
+					<< " in-flight_max=" << stats().trace_in_flight_max.load(std::memory_order_relaxed)
+					<< " latency_avg=" << safe_avg(latency_ns, writes) / 1'000.0 << " us"
+					<< " latency_max=" << static_cast<double>(stats().trace_latency_max_ns.load(std::memory_order_relaxed)) / 1'000.0 << " us\n";
+			}
+
+			if (const auto raw = stats().compress_raw_bytes.load(std::memory_order_relaxed); raw > 0)
+			{
+				const auto compressed = stats().compress_out_bytes.load(std::memory_order_relaxed);
+				const auto compress_ns = stats().compress_ns.load(std::memory_order_relaxed);
+				std::cerr << "[profiling] compression: blocks=" << stats().compress_blocks.load(std::memory_order_relaxed)
+					<< " raw=" << raw
+					<< " compressed=" << compressed
+					<< " ratio=" << (compressed > 0 ? static_cast<double>(raw) / static_cast<double>(compressed) : 0.0)
+					<< " cpu=" << to_ms(compress_ns) << " ms"
+					<< " throughput=" << (compress_ns > 0 ? static_cast<double>(raw) * 1e3 / static_cast<double>(compress_ns) : 0.0) << " MB/s\n";
+			}
+
+			{
+				const std::lock_guard lock(stats().coverage_mutex);
+				for (const auto& c : stats().coverage)
+				{
+					const double fraction = c.total_ns > 0 ? static_cast<double>(c.armed_ns) / static_cast<double>(c.total_ns) : 0.0;
+					std::cerr << "[profiling] watch coverage " << c.name << ": " << fraction * 100.0 << "%"
+						<< " armed=" << to_ms(static_cast<long long>(c.armed_ns)) << " ms"
+						<< " observed=" << c.observed << "\n";
+				}
+			}
+
 			if (events == 0)
 				return;
 			const auto total_launch_ns = stats().launch_ns.load(std::memory_order_relaxed);
 			const auto total_resolve_ns = stats().resolve_ns.load(std::memory_order_relaxed);
 			const auto total_setup_ns = stats().setup_ns.load(std::memory_order_relaxed);
+			const auto total_first_event_ns = stats().first_event_ns.load(std::memory_order_relaxed);
 			if (total_launch_ns > 0) std::cerr << "[profiling] launch total=" << to_ms(total_launch_ns) << " ms\n";
+			if (total_first_event_ns > 0) std::cerr << "[profiling] launch->first event=" << to_ms(total_first_event_ns) << " ms\n";
 			if (total_resolve_ns > 0) std::cerr << "[profiling] resolve total=" << to_ms(total_resolve_ns) << " ms\n";
 			if (total_setup_ns > 0) std::cerr << "[profiling] setup total=" << to_ms(total_setup_ns) << " ms\n";
 
@@ -155,6 +345,11 @@ namespace gwatch::profiling
 		stats().launch_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
 	}
 
+	void add_launch_to_first_event_duration(const std::uint64_t nanoseconds)
+	{
+		stats().first_event_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
 	void add_symbol_resolve_duration(const std::uint64_t nanoseconds)
 	{
 		stats().resolve_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
@@ -179,6 +374,99 @@ namespace gwatch::profiling
 	{
 		stats().loop_iters.fetch_add(1, std::memory_order_relaxed);
 	}
+
+	void add_perf_drain(const std::uint64_t samples, const std::uint64_t lost, const std::uint64_t nanoseconds)
+	{
+		stats().perf_drains.fetch_add(1, std::memory_order_relaxed);
+		stats().perf_samples.fetch_add(samples, std::memory_order_relaxed);
+		stats().perf_lost.fetch_add(lost, std::memory_order_relaxed);
+		stats().perf_drain_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_watch_coverage(const std::string_view name, const std::uint64_t armedNs, const std::uint64_t totalNs, const std::uint64_t observed)
+	{
+		const std::lock_guard lock(stats().coverage_mutex);
+		stats().coverage.push_back({.name = std::string(name), .armed_ns = armedNs, .total_ns = totalNs, .observed = observed});
+	}
+
+	void add_dirty_scan(const std::uint64_t pages, const std::uint64_t dirtyPages, const std::uint64_t scanNanoseconds, const std::uint64_t diffNanoseconds)
+	{
+		stats().dirty_scans.fetch_add(1, std::memory_order_relaxed);
+		stats().dirty_pages_scanned.fetch_add(pages, std::memory_order_relaxed);
+		stats().dirty_pages.fetch_add(dirtyPages, std::memory_order_relaxed);
+		stats().dirty_scan_ns.fetch_add(static_cast<long long>(scanNanoseconds), std::memory_order_relaxed);
+		stats().dirty_diff_ns.fetch_add(static_cast<long long>(diffNanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_poll_run(const std::uint64_t ticks, const std::uint64_t overruns, const std::uint64_t nanoseconds)
+	{
+		stats().poll_ticks.fetch_add(ticks, std::memory_order_relaxed);
+		stats().poll_overruns.fetch_add(overruns, std::memory_order_relaxed);
+		stats().poll_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_page_fault(const bool falseSharing, const std::uint64_t nanoseconds)
+	{
+		if (falseSharing)
+		{
+			stats().page_false_sharing.fetch_add(1, std::memory_order_relaxed);
+			stats().page_false_sharing_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+		}
+		else
+		{
+			stats().page_hits.fetch_add(1, std::memory_order_relaxed);
+			stats().page_hit_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+		}
+	}
+
+	void add_async_log_batch(const std::uint64_t records, const std::uint64_t bytes, const std::uint64_t nanoseconds)
+	{
+		stats().log_batches.fetch_add(1, std::memory_order_relaxed);
+		stats().log_batch_records.fetch_add(records, std::memory_order_relaxed);
+		stats().log_batch_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		stats().log_batch_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_output_queue(const std::uint64_t peak, const std::uint64_t dropped, const std::uint64_t spilledBytes)
+	{
+		if (peak > stats().queue_peak.load(std::memory_order_relaxed))
+			stats().queue_peak.store(peak, std::memory_order_relaxed);
+		stats().queue_dropped.fetch_add(dropped, std::memory_order_relaxed);
+		stats().queue_spilled_bytes.fetch_add(spilledBytes, std::memory_order_relaxed);
+	}
+
+	void add_trace_write(const std::uint64_t bytes, const std::uint64_t inFlight, const std::uint64_t latencyNs)
+	{
+		stats().trace_writes.fetch_add(1, std::memory_order_relaxed);
+		stats().trace_write_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		stats().trace_in_flight_total.fetch_add(inFlight, std::memory_order_relaxed);
+		if (inFlight > stats().trace_in_flight_max.load(std::memory_order_relaxed))
+			stats().trace_in_flight_max.store(inFlight, std::memory_order_relaxed);
+		const auto latency = static_cast<long long>(latencyNs);
+		stats().trace_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+		if (latency > stats().trace_latency_max_ns.load(std::memory_order_relaxed))
+			stats().trace_latency_max_ns.store(latency, std::memory_order_relaxed);
+	}
+
+	void add_trace_io_busy(const std::uint64_t nanoseconds)
+	{
+		stats().trace_busy_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_compression(const std::uint64_t blocks, const std::uint64_t rawBytes, const std::uint64_t compressedBytes, const std::uint64_t nanoseconds)
+	{
+		stats().compress_blocks.fetch_add(blocks, std::memory_order_relaxed);
+		stats().compress_raw_bytes.fetch_add(rawBytes, std::memory_order_relaxed);
+		stats().compress_out_bytes.fetch_add(compressedBytes, std::memory_order_relaxed);
+		stats().compress_ns.fetch_add(static_cast<long long>(nanoseconds), std::memory_order_relaxed);
+	}
+
+	void add_log_drop(const bool write, const bool sampled)
+	{
+		(write ? stats().log_dropped_writes : stats().log_dropped_reads).fetch_add(1, std::memory_order_relaxed);
+		if (sampled)
+			stats().log_sampled_out.fetch_add(1, std::memory_order_relaxed);
+	}
 }
 
 #endif
@@ -0,0 +1,207 @@
+#include "../include/Sketches.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+namespace gwatch
+{
+	namespace
+	{
+		// splitmix64 finalizer: neighbouring values (counters, indices) land far apart.
+		std::uint64_t mix(std::uint64_t x)
+		{
+			x += 0x9E3779B97F4A7C15ull;
+			x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+			x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+			return x ^ (x >> 31);
+		}
+	}
+
+	void Log2Histogram::add(const std::uint64_t value)
+	{
+		++m_buckets[static_cast<std::size_t>(std::bit_width(value))];
+		++m_count;
+	}
+
+	HyperLogLog::HyperLogLog(const unsigned precision) :
+		m_precision(precision)
+	{
+		if (precision < 4 || precision > 18)
+		{
+			throw std::invalid_argument("HyperLogLog: precision must be in [4, 18].");
+		}
+		m_registers.resize(std::size_t{1} << precision);
+	}
+
+	void HyperLogLog::add(const std::uint64_t value)
+	{
+		const std::uint64_t hash = mix(value);
+		const auto index = static_cast<std::size_t>(hash >> (64 - m_precision));
+		// Rank of the first set bit of the remaining bits; the sentinel bounds it.
+		const std::uint64_t rest = (hash << m_precision) | (1ull << (m_precision - 1));
+		const auto rank = static_cast<std::uint8_t>(std::countl_zero(rest) + 1);
+		m_registers[index] = std::max(m_registers[index], rank);
+	}
+
+	double HyperLogLog::estimate() const
+	{
+		const auto m = static_cast<double>(m_registers.size());
+		double sum = 0;
+		std::size_t zeros = 0;
+		for (const std::uint8_t r : m_registers)
+		{
+			sum += std::ldexp(1.0, -r);
+			zeros += r == 0;
+		}
+		const double alpha = 0.7213 / (1.0 + 1.079 / m);
+		const double raw = alpha * m * m / sum;
+		// Small cardinalities: linear counting of the empty registers is far more precise.
+		if (raw <= 2.5 * m && zeros > 0)
+			return m * std::log(m / static_cast<double>(zeros));
+		return raw;
+	}
+
+	SpaceSaving::SpaceSaving(const std::size_t capacity) :
+		m_capacity(std::max<std::size_t>(capacity, 1))
+	{
+		m_counters.reserve(m_capacity);
+	}
+
+	void SpaceSaving::add(const std::uint64_t value)
+	{
+		auto smallest = m_counters.begin();
+		for (auto it = m_counters.begin(); it != m_counters.end(); ++it)
+		{
+			if (it->value == value)
+			{
+				++it->count;
+				return;
+			}
+			if (it->count < smallest->count)
+				smallest = it;
+		}
+		if (m_counters.size() < m_capacity)
+		{
+			m_counters.push_back(Counter{.value = value, .count = 1, .error = 0});
+			return;
+		}
+		*smallest = Counter{.value = value, .count = smallest->count + 1, .error = smallest->count};
+	}
+
+	std::vector<SpaceSaving::Counter> SpaceSaving::top(const std::size_t n) const
+	{
+		std::vector<Counter> out = m_counters;
+		const std::size_t kept = std::min(n, out.size());
+		std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(kept), out.end(), [](const Counter& a, const Counter& b)
+		{
+			return a.count != b.count ? a.count > b.count : a.value < b.value;
+		});
+		out.resize(kept);
+		return out;
+	}
+
+	TDigest::TDigest(const double compression) :
+		m_compression(std::max(compression, 10.0))
+	{
+		m_buffer.reserve(static_cast<std::size_t>(m_compression) * 5);
+	}
+
+	void TDigest::add(const double value)
+	{
+		if (m_count == 0 || value < m_min)
+			m_min = value;
+		if (m_count == 0 || value > m_max)
+			m_max = value;
+		++m_count;
+		m_buffer.push_back(Centroid{.mean = value, .weight = 1});
+		// Sorting a few compressions' worth of values at once amortises the merge.
+		if (m_buffer.size() >= static_cast<std::size_t>(m_compression) * 5)
+			merge();
+	}
+
+	std::size_t TDigest::centroids() const
+	{
+		merge();
+		return m_centroids.size();
+	}
+
+	void TDigest::merge() const
+	{
+		if (m_buffer.empty())
+			return;
+		m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+		std::ranges::sort(m_buffer, {}, &Centroid::mean);
+
+		double total = 0;
+		for (const auto& c : m_buffer)
+			total += c.weight;
+
+		// k1 scale: k(q) = delta / (2 pi) * asin(2q - 1). A centroid may span one unit of k.
+		const double delta = m_compression;
+		const auto k_of = [delta](const double q) { return delta / (2 * std::numbers::pi) * std::asin(2 * q - 1); };
+		const auto q_of = [delta](const double k)
+		{
+			return k >= delta / 4 ? 1.0 : (std::sin(k * 2 * std::numbers::pi / delta) + 1) / 2;
+		};
+
+		m_centroids.clear();
+		Centroid current = m_buffer.front();
+		double before = 0;
+		double limit = q_of(k_of(0) + 1) * total;
+		for (std::size_t i = 1; i < m_buffer.size(); ++i)
+		{
+			const Centroid& next = m_buffer[i];
+			if (before + current.weight + next.weight <= limit)
+			{
+				current.weight += next.weight;
+				current.mean += (next.mean - current.mean) * next.weight / current.weight;
+				continue;
+			}
+			m_centroids.push_back(current);
+			before += current.weight;
+			limit = q_of(k_of(before / total) + 1) * total;
+			current = next;
+		}
+		m_centroids.push_back(current);
+		m_buffer.clear();
+	}
+
+	double TDigest::quantile(const double q) const
+	{
+		if (m_count == 0)
+			return 0;
+		merge();
+		if (q <= 0 || m_count == 1)
+			return q <= 0 ? m_min : m_centroids.front().mean;
+		if (q >= 1)
+			return m_max;
+
+		// Each centroid's mean sits at the middle of its weight; interpolate between the
+		// neighbouring centers, and towards min / max at both ends.
+		const double index = q * static_cast<double>(m_count);
+		const Centroid& first = m_centroids.front();
+		if (index < first.weight / 2)
+			return m_min + (first.mean - m_min) * index / (first.weight / 2);
+
+		double cumulative = 0;
+		for (std::size_t i = 0; i + 1 < m_centroids.size(); ++i)
+		{
+			const Centroid& a = m_centroids[i];
+			const Centroid& b = m_centroids[i + 1];
+			const double centerA = cumulative + a.weight / 2;
+			const double centerB = cumulative + a.weight + b.weight / 2;
+			if (index < centerB)
+				return a.mean + (b.mean - a.mean) * (index - centerA) / (centerB - centerA);
+			cumulative += a.weight;
+		}
+
+		const Centroid& last = m_centroids.back();
+		const double centerLast = static_cast<double>(m_count) - last.weight / 2;
+		if (index <= centerLast || last.weight <= 0)
+			return last.mean;
+		return last.mean + (m_max - last.mean) * (index - centerLast) / (last.weight / 2);
+	}
+}
@@ -0,0 +1,50 @@
+#include "../include/StringTable.h"
+
+#include <cstring>
+
+namespace gwatch
+{
+	StringTable::StringTable()
+	{
+		m_strings.emplace_back();
+		m_index.emplace(std::string_view{}, kEmptyString);
+	}
+
+	// Module paths only: an entry is never freed, so the table grows with every new string.
+	StringId StringTable::intern(const std::string_view s)
+	{
+		if (const auto it = m_index.find(s); it != m_index.end())
+			return it->second;
+
+		const std::string_view stored = store(s);
+		const auto id = static_cast<StringId>(m_strings.size());
+		m_strings.push_back(stored);
+		m_index.emplace(stored, id);
+		return id;
+	}
+
+	std::string_view StringTable::view(const StringId id) const
+	{
+		return id < m_strings.size() ? m_strings[id] : std::string_view{};
+	}
+
+	std::string_view StringTable::store(const std::string_view s)
+	{
+		// Oversized strings get a block of their own; the current chunk stays open.
+		if (s.size() > kChunkSize / 4)
+		{
+			const auto& block = m_large.emplace_back(std::make_unique<char[]>(s.size()));
+			std::memcpy(block.get(), s.data(), s.size());
+			return {block.get(), s.size()};
+		}
+		if (m_chunkUsed + s.size() > kChunkSize)
+		{
+			m_chunks.emplace_back(std::make_unique<char[]>(kChunkSize));
+			m_chunkUsed = 0;
+		}
+		char* dst = m_chunks.back().get() + m_chunkUsed;
+		std::memcpy(dst, s.data(), s.size());
+		m_chunkUsed += s.size();
+		return {dst, s.size()};
+	}
+}
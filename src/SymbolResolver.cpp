@@ -0,0 +1,39 @@
+#include "../include/SymbolResolver.h"
+
+#include <algorithm>
+
+namespace gwatch
+{
+	ElementSpan element_at(const ResolvedSymbol& object, const std::uint64_t offset, std::string& name, const std::uint32_t width)
+	{
+		name = object.name;
+		if (object.size <= 8)
+		{
+			return ElementSpan{.start = 0, .width = static_cast<std::uint32_t>(object.size)};
+		}
+
+		std::uint64_t base = 0;
+		std::uint64_t limit = object.size;
+		if (object.element > 0)
+		{
+			const std::uint64_t index = offset / object.element;
+			name += '[';
+			name += std::to_string(index);
+			name += ']';
+			base = index * object.element;
+			limit = std::min(object.size, base + object.element);
+			if (object.element <= 8)
+			{
+				return ElementSpan{.start = base, .width = static_cast<std::uint32_t>(limit - base)};
+			}
+		}
+
+		// Structs, large elements and objects without type information: the bytes the access
+		// touched when its width is known, aligned 8-byte words otherwise.
+		const std::uint64_t start = width > 0 ? offset : base + ((offset - base) & ~7ull);
+		const std::uint64_t bytes = width > 0 ? std::min<std::uint64_t>(width, 8) : 8;
+		name += '+';
+		name += std::to_string(start - base);
+		return ElementSpan{.start = start, .width = static_cast<std::uint32_t>(std::min(bytes, limit - start))};
+	}
+}
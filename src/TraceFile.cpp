@@ -0,0 +1,127 @@
+#include "../include/TraceFile.h"
+#include "../include/UringTraceFile.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace gwatch
+{
+	namespace
+	{
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+	}
+
+	std::string trace_segment_path(const std::string& path, const std::uint64_t index)
+	{
+		return path + "." + std::to_string(index);
+	}
+
+	void remove_expired_segment(const TraceFileOptions& options, const std::uint64_t started)
+	{
+		if (options.keep > 0 && started > options.keep)
+			::unlink(trace_segment_path(options.path, started - 1 - options.keep).c_str());
+	}
+
+	std::unique_ptr<ITraceStorage> open_trace_storage(const TraceFileOptions& options)
+	{
+		if (options.backend == TraceBackend::Uring)
+			return std::make_unique<UringTraceFile>(options);
+		return std::make_unique<TraceFile>(options);
+	}
+
+	TraceFile::TraceFile(TraceFileOptions options) :
+		m_options(std::move(options))
+	{
+		open_segment();
+	}
+
+	TraceFile::~TraceFile()
+	{
+		close_segment();
+	}
+
+	bool TraceFile::has_room(const std::size_t size) const
+	{
+		if (m_used + size > m_options.segmentBytes)
+			return false;
+		// An empty segment is never rotated for time: it would only leave an empty file behind.
+		return m_deadlineNs == 0 || m_used == 0 || now_ns() < m_deadlineNs;
+	}
+
+	void TraceFile::append(const char* data, const std::size_t size)
+	{
+		std::memcpy(m_base + m_used, data, size);
+		m_used += size;
+	}
+
+	void TraceFile::rotate()
+	{
+		close_segment();
+		++m_index;
+		open_segment();
+		remove_expired_segment(m_options, segments());
+	}
+
+	void TraceFile::open_segment()
+	{
+		const std::string path = segment_path(m_index);
+		const auto size = static_cast<std::size_t>(m_options.segmentBytes);
+		m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (m_fd < 0)
+			throw std::runtime_error("Cannot create trace file '" + path + "': " + std::strerror(errno));
+
+		// Reserve the blocks up front: a full disk fails here instead of as a SIGBUS on a store.
+		if (::fallocate(m_fd, 0, 0, static_cast<off_t>(size)) != 0)
+		{
+			const int error = errno;
+			if ((error != EOPNOTSUPP && error != ENOSYS) || ::ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+			{
+				::close(m_fd);
+				m_fd = -1;
+				throw std::runtime_error("Cannot allocate trace file '" + path + "': " + std::strerror(error));
+			}
+		}
+
+		void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (base == MAP_FAILED)
+		{
+			const int error = errno;
+			::close(m_fd);
+			m_fd = -1;
+			throw std::runtime_error("Cannot map trace file '" + path + "': " + std::strerror(error));
+		}
+		m_base = static_cast<char*>(base);
+		m_used = 0;
+		m_deadlineNs = m_options.rotateNs > 0 ? now_ns() + m_options.rotateNs : 0;
+	}
+
+	void TraceFile::close_segment()
+	{
+		if (m_fd < 0)
+			return;
+		const auto size = static_cast<std::size_t>(m_options.segmentBytes);
+		// Start the write-back, then drop the pages from this process: they stay in the page cache.
+		::msync(m_base, size, MS_ASYNC);
+		::madvise(m_base, size, MADV_DONTNEED);
+		::munmap(m_base, size);
+		if (::ftruncate(m_fd, static_cast<off_t>(m_used)) != 0)
+		{
+			// The segment keeps its zero padding, as after a crash.
+		}
+		::close(m_fd);
+		m_fd = -1;
+		m_base = nullptr;
+	}
+}
+#endif
@@ -0,0 +1,256 @@
+#include "../include/TraceFormat.h"
+
+#include <string>
+
+namespace gwatch::trace
+{
+	namespace
+	{
+		constexpr std::uint8_t kTagPadding = 0x00;
+		constexpr std::uint8_t kTagSymbol = 0x01;
+		constexpr std::uint8_t kTagThread = 0x02;
+		constexpr std::uint8_t kTagEvent = 0x80;
+
+		constexpr std::uint8_t kFlagWrite = 0x01;
+		constexpr std::uint8_t kFlagSymbol = 0x02;
+		constexpr std::uint8_t kFlagThread = 0x04;
+		constexpr std::uint8_t kFlagSameValue = 0x08;
+		constexpr std::uint8_t kFlagRepeat = 0x10;
+		constexpr std::uint8_t kFlagNoValue = 0x20;
+
+		void put_varint(std::vector<char>& out, std::uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				out.push_back(static_cast<char>(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back(static_cast<char>(v));
+		}
+
+		std::uint64_t zigzag(const std::int64_t v)
+		{
+			return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+		}
+
+		std::int64_t unzigzag(const std::uint64_t v)
+		{
+			return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+		}
+
+		void put_symbol(std::vector<char>& out, const SymbolView& symbol)
+		{
+			put_varint(out, symbol.size);
+			put_varint(out, symbol.name.size());
+			out.insert(out.end(), symbol.name.begin(), symbol.name.end());
+		}
+	}
+
+	void Encoder::encode(const LogRecord& record, const std::span<const SymbolView> symbols, std::vector<char>& out)
+	{
+		if (!m_headerWritten)
+		{
+			out.insert(out.end(), std::begin(kMagic), std::end(kMagic));
+			out.push_back(static_cast<char>(kVersion));
+			put_varint(out, symbols.size());
+			for (const auto& symbol : symbols)
+				put_symbol(out, symbol);
+			m_symbolsWritten = symbols.size();
+			m_headerWritten = true;
+		}
+		for (; m_symbolsWritten < symbols.size() && m_symbolsWritten <= record.symbol; ++m_symbolsWritten)
+		{
+			out.push_back(static_cast<char>(kTagSymbol));
+			put_varint(out, m_symbolsWritten);
+			put_symbol(out, symbols[m_symbolsWritten]);
+		}
+		if (record.symbol >= m_lastValues.size())
+			m_lastValues.resize(record.symbol + 1, 0);
+
+		auto [it, inserted] = m_threadIndex.try_emplace(record.tid, static_cast<std::uint32_t>(m_threadIndex.size()));
+		if (inserted)
+		{
+			out.push_back(static_cast<char>(kTagThread));
+			put_varint(out, record.tid);
+		}
+		const std::uint32_t thread = it->second;
+
+		std::uint64_t& previous = m_lastValues[record.symbol];
+		const bool write = record.kind == AccessKind::Write;
+		const std::uint64_t first = write ? record.old_value : record.new_value;
+
+		std::uint8_t tag = kTagEvent;
+		if (write)
+			tag |= kFlagWrite;
+		if (record.symbol != m_lastSymbol)
+			tag |= kFlagSymbol;
+		if (thread != m_lastThread)
+			tag |= kFlagThread;
+		if (!record.exact)
+			tag |= kFlagNoValue;
+		else if (first == previous)
+			tag |= kFlagSameValue;
+		if (record.repeat > 1)
+			tag |= kFlagRepeat;
+
+		out.push_back(static_cast<char>(tag));
+		put_varint(out, zigzag(static_cast<std::int64_t>(record.timestamp_ns - m_lastTime)));
+		if (tag & kFlagSymbol)
+			put_varint(out, record.symbol);
+		if (tag & kFlagThread)
+			put_varint(out, thread);
+		if (record.exact)
+		{
+			if (!(tag & kFlagSameValue))
+				put_varint(out, first ^ previous);
+			if (write)
+				put_varint(out, record.new_value ^ record.old_value);
+		}
+		if (tag & kFlagRepeat)
+			put_varint(out, record.repeat - 1);
+
+		if (record.exact)
+			previous = record.new_value;
+		m_lastTime = record.timestamp_ns;
+		m_lastSymbol = record.symbol;
+		m_lastThread = thread;
+	}
+
+	void Encoder::reset()
+	{
+		*this = Encoder{};
+	}
+
+	Decoder::Decoder(std::istream& in) :
+		m_in(in)
+	{
+	}
+
+	bool Decoder::next(Event& ev)
+	{
+		if (!m_headerRead)
+		{
+			const auto first = m_in.peek();
+			if (first == std::char_traits<char>::eof() || first == kTagPadding)
+				return false;
+			read_header();
+		}
+
+		while (true)
+		{
+			const auto c = m_in.rdbuf()->sbumpc();
+			if (c == std::char_traits<char>::eof())
+				return false;
+			const auto tag = static_cast<std::uint8_t>(c);
+
+			if (tag == kTagPadding)
+				return false;
+			if (tag == kTagSymbol)
+			{
+				read_symbol(static_cast<std::uint32_t>(read_varint()));
+				continue;
+			}
+			if (tag == kTagThread)
+			{
+				m_threads.push_back(static_cast<std::uint32_t>(read_varint()));
+				continue;
+			}
+			if (!(tag & kTagEvent) || (tag & 0x40) != 0)
+				throw TraceError("Unknown record tag " + std::to_string(tag) + " in trace.");
+
+			m_lastTime += static_cast<std::uint64_t>(unzigzag(read_varint()));
+			if (tag & kFlagSymbol)
+				m_lastSymbol = static_cast<std::uint32_t>(read_varint());
+			if (tag & kFlagThread)
+				m_lastThread = static_cast<std::uint32_t>(read_varint());
+			if (m_lastSymbol >= m_symbols.size())
+				throw TraceError("Event references undefined symbol " + std::to_string(m_lastSymbol) + ".");
+			if (m_lastThread >= m_threads.size())
+				throw TraceError("Event references undefined thread " + std::to_string(m_lastThread) + ".");
+
+			ev.timestamp_ns = m_lastTime;
+			ev.tid = m_threads[m_lastThread];
+			ev.symbol = m_lastSymbol;
+			ev.kind = (tag & kFlagWrite) ? AccessKind::Write : AccessKind::Read;
+			ev.exact = !(tag & kFlagNoValue);
+			ev.repeat = 1;
+			if (!ev.exact)
+			{
+				ev.old_value = 0;
+				ev.new_value = 0;
+				read_repeat(tag, ev);
+				return true;
+			}
+
+			std::uint64_t& previous = m_lastValues[m_lastSymbol];
+			const std::uint64_t first = (tag & kFlagSameValue) ? previous : previous ^ read_varint();
+			ev.old_value = first;
+			ev.new_value = (tag & kFlagWrite) ? first ^ read_varint() : first;
+			read_repeat(tag, ev);
+			previous = ev.new_value;
+			return true;
+		}
+	}
+
+	void Decoder::read_repeat(const std::uint8_t tag, Event& ev)
+	{
+		if (!(tag & kFlagRepeat))
+			return;
+		const std::uint64_t extra = read_varint();
+		if (extra >= UINT32_MAX)
+			throw TraceError("Event repeat count out of range.");
+		ev.repeat = static_cast<std::uint32_t>(extra + 1);
+	}
+
+	void Decoder::read_header()
+	{
+		char magic[sizeof(kMagic)]{};
+		if (!m_in.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != std::string_view(kMagic, sizeof(kMagic)))
+			throw TraceError("Not a gwatch binary trace (bad magic).");
+		if (const std::uint8_t version = read_byte(); version != kVersion)
+			throw TraceError("Unsupported trace version " + std::to_string(version) + ".");
+
+		const std::uint64_t count = read_varint();
+		for (std::uint64_t id = 0; id < count; ++id)
+			read_symbol(static_cast<std::uint32_t>(id));
+		m_headerRead = true;
+	}
+
+	void Decoder::read_symbol(const std::uint32_t id)
+	{
+		if (id != m_symbols.size())
+			throw TraceError("Out of order symbol definition " + std::to_string(id) + ".");
+
+		SymbolDef def;
+		def.size = static_cast<std::uint32_t>(read_varint());
+		const std::uint64_t length = read_varint();
+		if (length > 4096)
+			throw TraceError("Symbol name too long in trace.");
+		def.name.resize(static_cast<std::size_t>(length));
+		if (!m_in.read(def.name.data(), static_cast<std::streamsize>(length)))
+			throw TraceError("Truncated symbol definition.");
+		m_symbols.push_back(std::move(def));
+		m_lastValues.push_back(0);
+	}
+
+	std::uint64_t Decoder::read_varint()
+	{
+		std::uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			const std::uint8_t b = read_byte();
+			v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return v;
+		}
+		throw TraceError("Malformed varint in trace.");
+	}
+
+	std::uint8_t Decoder::read_byte()
+	{
+		const auto c = m_in.rdbuf()->sbumpc();
+		if (c == std::char_traits<char>::eof())
+			throw TraceError("Truncated trace.");
+		return static_cast<std::uint8_t>(c);
+	}
+}
@@ -0,0 +1,421 @@
+#include "../include/TraceIndex.h"
+#include "../include/MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace gwatch::query
+{
+	static_assert(std::endian::native == std::endian::little, "the index layout is little-endian");
+	static_assert(sizeof(Block) == 32 && sizeof(ThreadEntry) == 16 && sizeof(WriteKey) == 24);
+
+	namespace
+	{
+		constexpr std::size_t kHeaderSize = 64;
+		constexpr std::uint32_t kEmptySlot = UINT32_MAX;
+
+		template<typename T>
+		void store(char* p, const T v)
+		{
+			std::memcpy(p, &v, sizeof(v));
+		}
+
+		template<typename T>
+		T load(const char* p)
+		{
+			T v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		std::size_t align8(const std::size_t n)
+		{
+			return (n + 7) & ~std::size_t{7};
+		}
+
+		struct Write
+		{
+			std::uint32_t var;
+			std::uint32_t row;
+			std::uint64_t value;
+		};
+
+		bool matches(const columnar::RowGroup& group, const std::uint32_t row, const columnar::Filter& filter)
+		{
+			const std::uint64_t time = group.timestamps()[row];
+			return (!filter.var || group.vars()[row] == *filter.var)
+			       && (!filter.tid || group.tids()[row] == *filter.tid)
+			       && (!filter.kind || (group.kinds()[row] & columnar::kKindBits) == static_cast<std::uint8_t>(*filter.kind))
+			       && (!filter.value || (group.new_values()[row] == *filter.value && !(group.kinds()[row] & columnar::kUnknownValues)))
+			       && time >= filter.fromNs && time <= filter.toNs;
+		}
+
+		// Builds the index of trace unless a current one exists; returns whether it did.
+		bool ensure_index(const std::string& trace, const bool force)
+		{
+			const MappedFile file(trace);
+			const columnar::Reader reader(file.bytes());
+			const std::string path = index_path(trace);
+			if (!force && std::filesystem::exists(path))
+			{
+				try
+				{
+					const MappedFile existing(path);
+					if (TraceIndex(existing.bytes()).covers(reader, file.bytes().size()))
+						return false;
+				}
+				catch (const std::runtime_error&)
+				{
+					// Unreadable: rebuilt below.
+				}
+			}
+
+			const std::vector<char> index = build_index(reader, file.bytes().size());
+			// Readers never see a partial index.
+			const std::string temporary = path + ".tmp";
+			{
+				std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+				out.write(index.data(), static_cast<std::streamsize>(index.size()));
+				if (!out)
+					throw std::runtime_error("Cannot write index file '" + temporary + "'");
+			}
+			std::filesystem::rename(temporary, path);
+			return true;
+		}
+	}
+
+	std::uint64_t key_hash(const std::uint32_t var, std::uint64_t value)
+	{
+		// splitmix64 finalizer
+		value ^= var * 0x9E3779B97F4A7C15ull;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	std::string index_path(const std::string& trace)
+	{
+		return trace + ".gwqi";
+	}
+
+	std::vector<char> build_index(const columnar::Reader& trace, const std::uint64_t traceBytes)
+	{
+		if (trace.rows() > UINT32_MAX)
+			throw IndexError("Trace too large to index: more than 4G rows (record it with --trace-file segments)");
+
+		std::vector<Block> blocks;
+		std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> threadRows;
+		std::vector<Write> writes;
+		std::uint32_t base = 0;
+		for (std::size_t g = 0; g < trace.groups().size(); ++g)
+		{
+			const columnar::RowGroup& group = trace.groups()[g];
+			const auto timestamps = group.timestamps();
+			for (std::uint32_t first = 0; first < group.rows(); first += kBlockRows)
+			{
+				const std::uint32_t rows = std::min(kBlockRows, group.rows() - first);
+				const columnar::ColumnStats range = columnar::min_max(timestamps.subspan(first, rows));
+				blocks.push_back(Block{.group = static_cast<std::uint32_t>(g), .row = first, .rows = rows, .minNs = range.min, .maxNs = range.max});
+			}
+
+			const auto tids = group.tids();
+			const auto vars = group.vars();
+			const auto kinds = group.kinds();
+			const auto values = group.new_values();
+			std::uint32_t lastTid = 0;
+			std::vector<std::uint32_t>* rows = nullptr;
+			for (std::uint32_t i = 0; i < group.rows(); ++i)
+			{
+				// Threads come in runs: look the list up once per run.
+				if (rows == nullptr || tids[i] != lastTid)
+				{
+					lastTid = tids[i];
+					rows = &threadRows[lastTid];
+				}
+				rows->push_back(base + i);
+				// Writes of unknown values have no key.
+				if (kinds[i] == static_cast<std::uint8_t>(AccessKind::Write))
+					writes.push_back(Write{.var = vars[i], .row = base + i, .value = values[i]});
+			}
+			base += group.rows();
+		}
+
+		std::vector<std::uint32_t> tids;
+		tids.reserve(threadRows.size());
+		for (const auto& [tid, rows] : threadRows)
+			tids.push_back(tid);
+		std::sort(tids.begin(), tids.end());
+		std::sort(writes.begin(), writes.end(), [](const Write& a, const Write& b)
+		{
+			if (a.var != b.var)
+				return a.var < b.var;
+			return a.value != b.value ? a.value < b.value : a.row < b.row;
+		});
+		std::vector<WriteKey> keys;
+		for (std::size_t i = 0; i < writes.size(); ++i)
+		{
+			if (keys.empty() || keys.back().var != writes[i].var || keys.back().value != writes[i].value)
+				keys.push_back(WriteKey{.var = writes[i].var, .value = writes[i].value, .begin = trace.rows() + i});
+			++keys.back().count;
+		}
+		std::vector<std::uint32_t> slots(keys.empty() ? 0 : std::bit_ceil(keys.size() * 2), kEmptySlot);
+		for (std::size_t k = 0; k < keys.size(); ++k)
+		{
+			std::size_t slot = key_hash(keys[k].var, keys[k].value) & (slots.size() - 1);
+			while (slots[slot] != kEmptySlot)
+				slot = (slot + 1) & (slots.size() - 1);
+			slots[slot] = static_cast<std::uint32_t>(k);
+		}
+
+		const std::uint64_t postings = trace.rows() + writes.size();
+		const std::size_t threadsAt = kHeaderSize + blocks.size() * sizeof(Block);
+		const std::size_t keysAt = threadsAt + tids.size() * sizeof(ThreadEntry);
+		const std::size_t slotsAt = keysAt + keys.size() * sizeof(WriteKey);
+		const std::size_t postingsAt = align8(slotsAt + slots.size() * sizeof(std::uint32_t));
+		std::vector<char> out(postingsAt + postings * sizeof(std::uint32_t));
+
+		char* p = out.data();
+		std::memcpy(p, kMagic, sizeof(kMagic));
+		store<std::uint32_t>(p + 4, kVersion);
+		store<std::uint64_t>(p + 8, traceBytes);
+		store<std::uint64_t>(p + 16, trace.rows());
+		store<std::uint32_t>(p + 24, static_cast<std::uint32_t>(trace.groups().size()));
+		store<std::uint32_t>(p + 28, static_cast<std::uint32_t>(blocks.size()));
+		store<std::uint32_t>(p + 32, static_cast<std::uint32_t>(tids.size()));
+		store<std::uint32_t>(p + 36, static_cast<std::uint32_t>(keys.size()));
+		store<std::uint32_t>(p + 40, static_cast<std::uint32_t>(slots.size()));
+		store<std::uint32_t>(p + 44, kBlockRows);
+		store<std::uint64_t>(p + 48, postings);
+
+		if (!blocks.empty())
+			std::memcpy(p + kHeaderSize, blocks.data(), blocks.size() * sizeof(Block));
+		char* posting = p + postingsAt;
+		std::uint64_t next = 0;
+		for (std::size_t t = 0; t < tids.size(); ++t)
+		{
+			const std::vector<std::uint32_t>& rows = threadRows[tids[t]];
+			const ThreadEntry entry{.tid = tids[t], .count = static_cast<std::uint32_t>(rows.size()), .begin = next};
+			std::memcpy(p + threadsAt + t * sizeof(ThreadEntry), &entry, sizeof(entry));
+			std::memcpy(posting + next * sizeof(std::uint32_t), rows.data(), rows.size() * sizeof(std::uint32_t));
+			next += rows.size();
+		}
+		if (!keys.empty())
+			std::memcpy(p + keysAt, keys.data(), keys.size() * sizeof(WriteKey));
+		if (!slots.empty())
+			std::memcpy(p + slotsAt, slots.data(), slots.size() * sizeof(std::uint32_t));
+		for (const Write& write : writes)
+			store<std::uint32_t>(posting + next++ * sizeof(std::uint32_t), write.row);
+		return out;
+	}
+
+	TraceIndex::TraceIndex(const std::span<const char> data)
+	{
+		if (data.size() < kHeaderSize || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+			throw IndexError("Not a gwatch-query index");
+		if (reinterpret_cast<std::uintptr_t>(data.data()) % 8 != 0)
+			throw IndexError("Index data must be 8-byte aligned");
+		if (load<std::uint32_t>(data.data() + 4) != kVersion)
+			throw IndexError("Unsupported index version " + std::to_string(load<std::uint32_t>(data.data() + 4)));
+
+		const char* p = data.data();
+		m_traceBytes = load<std::uint64_t>(p + 8);
+		m_rows = load<std::uint64_t>(p + 16);
+		m_groups = load<std::uint32_t>(p + 24);
+		const std::size_t blocks = load<std::uint32_t>(p + 28);
+		const std::size_t threads = load<std::uint32_t>(p + 32);
+		const std::size_t keys = load<std::uint32_t>(p + 36);
+		const std::size_t slots = load<std::uint32_t>(p + 40);
+		const std::uint64_t postings = load<std::uint64_t>(p + 48);
+		if (!std::has_single_bit(slots) && slots != 0)
+			throw IndexError("Corrupt index: bad hash table size");
+
+		const std::size_t threadsAt = kHeaderSize + blocks * sizeof(Block);
+		const std::size_t keysAt = threadsAt + threads * sizeof(ThreadEntry);
+		const std::size_t slotsAt = keysAt + keys * sizeof(WriteKey);
+		const std::size_t postingsAt = align8(slotsAt + slots * sizeof(std::uint32_t));
+		if (postingsAt > data.size() || postings > (data.size() - postingsAt) / sizeof(std::uint32_t))
+			throw IndexError("Corrupt index: sections run past the end of the file");
+
+		m_blocks = {reinterpret_cast<const Block*>(p + kHeaderSize), blocks};
+		m_threads = {reinterpret_cast<const ThreadEntry*>(p + threadsAt), threads};
+		m_keys = {reinterpret_cast<const WriteKey*>(p + keysAt), keys};
+		m_slots = {reinterpret_cast<const std::uint32_t*>(p + slotsAt), slots};
+		m_postings = {reinterpret_cast<const std::uint32_t*>(p + postingsAt), postings};
+
+		// Row numbers in the postings are checked against the trace by run().
+		for (const Block& block : m_blocks)
+		{
+			if (block.group >= m_groups)
+				throw IndexError("Corrupt index: block of a missing row group");
+		}
+		for (const ThreadEntry& entry : m_threads)
+		{
+			if (entry.begin > postings || entry.count > postings - entry.begin)
+				throw IndexError("Corrupt index: thread postings out of range");
+		}
+		for (const WriteKey& key : m_keys)
+		{
+			if (key.begin > postings || key.count > postings - key.begin)
+				throw IndexError("Corrupt index: write postings out of range");
+		}
+		for (const std::uint32_t slot : m_slots)
+		{
+			if (slot != kEmptySlot && slot >= keys)
+				throw IndexError("Corrupt index: hash slot out of range");
+		}
+	}
+
+	bool TraceIndex::covers(const columnar::Reader& trace, const std::uint64_t traceBytes) const
+	{
+		return m_traceBytes == traceBytes && m_rows == trace.rows() && m_groups == trace.groups().size();
+	}
+
+	std::span<const std::uint32_t> TraceIndex::thread_rows(const std::uint32_t tid) const
+	{
+		const auto it = std::lower_bound(m_threads.begin(), m_threads.end(), tid, [](const ThreadEntry& entry, const std::uint32_t t) { return entry.tid < t; });
+		if (it == m_threads.end() || it->tid != tid)
+			return {};
+		return m_postings.subspan(it->begin, it->count);
+	}
+
+	std::span<const std::uint32_t> TraceIndex::write_rows(const std::uint32_t var, const std::uint64_t value) const
+	{
+		const std::size_t mask = m_slots.size() - 1;
+		std::size_t slot = key_hash(var, value) & mask;
+		for (std::size_t probe = 0; probe < m_slots.size(); ++probe, slot = (slot + 1) & mask)
+		{
+			if (m_slots[slot] == kEmptySlot)
+				break;
+			const WriteKey& key = m_keys[m_slots[slot]];
+			if (key.var == var && key.value == value)
+				return m_postings.subspan(key.begin, key.count);
+		}
+		return {};
+	}
+
+	std::size_t ensure_indexes(const std::span<const std::string> traces, const unsigned threads, const bool force)
+	{
+		std::atomic<std::size_t> next{0};
+		std::atomic<std::size_t> built{0};
+		std::exception_ptr error;
+		std::mutex errorMutex;
+		const auto work = [&]
+		{
+			for (std::size_t i = next++; i < traces.size(); i = next++)
+			{
+				try
+				{
+					built += ensure_index(traces[i], force) ? 1 : 0;
+				}
+				catch (...)
+				{
+					const std::lock_guard lock(errorMutex);
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < std::min<std::size_t>(std::max(threads, 1u), traces.size()); ++t)
+			workers.emplace_back(work);
+		work();
+		for (auto& worker : workers)
+			worker.join();
+		if (error)
+			std::rethrow_exception(error);
+		return built;
+	}
+
+	std::uint64_t run(const columnar::Reader& trace, const TraceIndex& index, const columnar::Filter& filter, const Visitor& visit)
+	{
+		if (index.rows() != trace.rows())
+			throw IndexError("The index was built from another trace");
+		const auto& groups = trace.groups();
+		if (filter.fromNs > filter.toNs)
+			return 0;
+
+		// Posting lists: the shortest one that applies.
+		std::vector<std::uint32_t> merged;
+		std::span<const std::uint32_t> candidates;
+		bool indexed = false;
+		const auto consider = [&](const std::span<const std::uint32_t> rows)
+		{
+			if (!indexed || rows.size() < candidates.size())
+				candidates = rows;
+			indexed = true;
+		};
+		if (filter.tid)
+			consider(index.thread_rows(*filter.tid));
+		if (filter.value && filter.kind == AccessKind::Write)
+		{
+			if (filter.var)
+				consider(index.write_rows(*filter.var, *filter.value));
+			else
+			{
+				for (std::uint32_t var = 0; var < trace.symbols().size(); ++var)
+				{
+					const auto rows = index.write_rows(var, *filter.value);
+					const std::size_t middle = merged.size();
+					merged.insert(merged.end(), rows.begin(), rows.end());
+					std::inplace_merge(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(middle), merged.end());
+				}
+				consider(merged);
+			}
+		}
+
+		// The sparse time index and the group statistics bound a scan.
+		const auto scanned = [&](const Block& block)
+		{
+			return block.minNs <= filter.toNs && filter.fromNs <= block.maxNs && block.group < groups.size() && columnar::may_match(groups[block.group], filter);
+		};
+		std::uint64_t scanRows = 0;
+		for (const Block& block : index.blocks())
+			scanRows += scanned(block) ? block.rows : 0;
+
+		std::uint64_t count = 0;
+		if (indexed && candidates.size() <= scanRows)
+		{
+			std::size_t g = 0;
+			std::uint64_t first = 0;
+			for (const std::uint32_t row : candidates)
+			{
+				if (row >= trace.rows())
+					throw IndexError("Corrupt index: row out of the trace");
+				while (row >= first + groups[g].rows())
+					first += groups[g++].rows();
+				const auto local = static_cast<std::uint32_t>(row - first);
+				if (!matches(groups[g], local, filter))
+					continue;
+				++count;
+				if (!visit(groups[g], local))
+					break;
+			}
+			return count;
+		}
+
+		std::vector<std::uint32_t> rows;
+		for (const Block& block : index.blocks())
+		{
+			if (!scanned(block))
+				continue;
+			const columnar::RowGroup& group = groups[block.group];
+			columnar::select(group.slice(block.row, block.rows), filter, rows);
+			for (const std::uint32_t row : rows)
+			{
+				++count;
+				if (!visit(group, block.row + row))
+					return count;
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,388 @@
+#include "../include/UringTraceFile.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define GWATCH_HAS_IO_URING 1
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "../include/Profiling.h"
+
+namespace gwatch
+{
+	namespace
+	{
+		constexpr std::size_t kDirectAlignment = 4096;
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+	}
+
+#ifdef GWATCH_HAS_IO_URING
+	// The submission and completion rings, driven through the raw system calls. Only one
+	// thread uses it and every submission is entered right away (no SQPOLL), so the
+	// submission ring never holds more than one entry.
+	struct UringTraceFile::Ring
+	{
+		int fd = -1;
+		void* sqRing = MAP_FAILED;
+		std::size_t sqRingSize = 0;
+		void* cqRing = MAP_FAILED;
+		std::size_t cqRingSize = 0;
+		io_uring_sqe* sqes = nullptr;
+		std::size_t sqesSize = 0;
+		unsigned* sqTail = nullptr;
+		unsigned* sqMask = nullptr;
+		unsigned* sqArray = nullptr;
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned* cqMask = nullptr;
+		io_uring_cqe* cqes = nullptr;
+		bool fixed = false; // blocks registered with IORING_REGISTER_BUFFERS
+
+		explicit Ring(const unsigned entries)
+		{
+			io_uring_params params{};
+			fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+			if (fd < 0)
+				throw std::runtime_error(std::string("Cannot set up io_uring: ") + std::strerror(errno));
+
+			sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single)
+				sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+			sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (sqRing == MAP_FAILED)
+				fail("map the io_uring submission ring");
+			if (single)
+				cqRing = sqRing;
+			else
+			{
+				cqRing = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				if (cqRing == MAP_FAILED)
+					fail("map the io_uring completion ring");
+			}
+			sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			void* entriesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+			if (entriesMap == MAP_FAILED)
+				fail("map the io_uring submission entries");
+			sqes = static_cast<io_uring_sqe*>(entriesMap);
+
+			auto* sq = static_cast<char*>(sqRing);
+			auto* cq = static_cast<char*>(cqRing);
+			sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		}
+
+		~Ring()
+		{
+			release();
+		}
+
+		Ring(const Ring&) = delete;
+		Ring& operator=(const Ring&) = delete;
+
+		void release()
+		{
+			if (sqes != nullptr)
+				::munmap(sqes, sqesSize);
+			if (cqRing != MAP_FAILED && cqRing != sqRing)
+				::munmap(cqRing, cqRingSize);
+			if (sqRing != MAP_FAILED)
+				::munmap(sqRing, sqRingSize);
+			if (fd >= 0)
+				::close(fd);
+			sqes = nullptr;
+			sqRing = cqRing = MAP_FAILED;
+			fd = -1;
+		}
+
+		// The constructor does not complete, so the destructor would not run.
+		[[noreturn]] void fail(const char* what)
+		{
+			const int error = errno;
+			release();
+			throw std::runtime_error(std::string("Cannot ") + what + ": " + std::strerror(error));
+		}
+
+		// Failing (memlock limit, old kernel) only costs a page pinning per write.
+		void register_buffers(const std::vector<Block>& blocks, const std::size_t blockBytes)
+		{
+			std::vector<iovec> buffers;
+			for (const Block& block : blocks)
+				buffers.push_back(iovec{block.data, blockBytes});
+			fixed = ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+		}
+
+		// Queues a write of block index; the caller enters it.
+		void prepare_write(const int file, const Block& block, const std::size_t index, const std::uint64_t offset)
+		{
+			const unsigned tail = *sqTail;
+			const unsigned slot = tail & *sqMask;
+			io_uring_sqe& sqe = sqes[slot];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+			sqe.fd = file;
+			sqe.off = offset;
+			sqe.addr = reinterpret_cast<std::uint64_t>(block.data);
+			sqe.len = block.length;
+			sqe.buf_index = fixed ? static_cast<std::uint16_t>(index) : 0;
+			sqe.user_data = index;
+			sqArray[slot] = slot;
+			std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+		}
+
+		int enter(const unsigned submit, const unsigned wait) const
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+		}
+	};
+#else
+	struct UringTraceFile::Ring
+	{
+		bool fixed = false;
+
+		explicit Ring(unsigned)
+		{
+			throw std::runtime_error("Cannot set up io_uring: not supported by this build");
+		}
+	};
+#endif
+
+	UringTraceFile::UringTraceFile(TraceFileOptions options) :
+		m_options(std::move(options))
+	{
+		if (m_options.blockBytes == 0 || m_options.blockBytes % kDirectAlignment != 0)
+			throw std::runtime_error("io_uring trace blocks must be a multiple of 4 KiB");
+		// A segment never needs more than one block.
+		const std::uint64_t segmentBlocks = (m_options.segmentBytes + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment;
+		m_options.blockBytes = static_cast<std::size_t>(std::min<std::uint64_t>(m_options.blockBytes, segmentBlocks));
+		if (m_options.queueDepth == 0)
+			throw std::runtime_error("io_uring trace queue depth must be at least 1");
+
+		m_ring = std::make_unique<Ring>(m_options.queueDepth);
+		// One block more than the queue depth: the caller fills it while the others are written.
+		m_blocks.resize(m_options.queueDepth + 1u);
+		for (Block& block : m_blocks)
+		{
+			block.data = static_cast<char*>(std::aligned_alloc(kDirectAlignment, m_options.blockBytes));
+			if (block.data == nullptr)
+			{
+				for (const Block& b : m_blocks)
+					std::free(b.data);
+				throw std::runtime_error("Cannot allocate io_uring trace blocks");
+			}
+		}
+#ifdef GWATCH_HAS_IO_URING
+		m_ring->register_buffers(m_blocks, m_options.blockBytes);
+#endif
+		m_fill = m_blocks[0].data;
+		m_fillEnd = m_fill + m_options.blockBytes;
+		try
+		{
+			open_segment();
+		}
+		catch (...)
+		{
+			for (const Block& block : m_blocks)
+				std::free(block.data);
+			throw;
+		}
+	}
+
+	UringTraceFile::~UringTraceFile()
+	{
+		close_segment();
+		profiling::add_trace_io_busy(m_busyNs);
+		if (m_error != 0)
+			std::fprintf(stderr, "trace: writes to '%s' failed, segments are incomplete: %s\n", m_options.path.c_str(), std::strerror(m_error));
+		// Unregistered with the ring.
+		m_ring.reset();
+		for (const Block& block : m_blocks)
+			std::free(block.data);
+	}
+
+	bool UringTraceFile::registered_buffers() const
+	{
+		return m_ring->fixed;
+	}
+
+	bool UringTraceFile::has_room(const std::size_t size) const
+	{
+		if (m_used + size > m_options.segmentBytes)
+			return false;
+		// An empty segment is never rotated for time: it would only leave an empty file behind.
+		return m_deadlineNs == 0 || m_used == 0 || now_ns() < m_deadlineNs;
+	}
+
+	void UringTraceFile::append(const char* data, std::size_t size)
+	{
+		m_used += size;
+		while (static_cast<std::size_t>(m_fillEnd - m_fill) <= size)
+		{
+			// Fills the block up to its end (records may straddle two blocks) and submits it.
+			const auto n = static_cast<std::size_t>(m_fillEnd - m_fill);
+			std::memcpy(m_fill, data, n);
+			m_fill += n;
+			data += n;
+			size -= n;
+			submit_current();
+		}
+		std::memcpy(m_fill, data, size);
+		m_fill += size;
+	}
+
+	void UringTraceFile::rotate()
+	{
+		close_segment();
+		++m_index;
+		open_segment();
+		remove_expired_segment(m_options, segments());
+	}
+
+	void UringTraceFile::open_segment()
+	{
+		const std::string path = segment_path(m_index);
+		const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (m_options.direct ? O_DIRECT : 0);
+		m_fd = ::open(path.c_str(), flags, 0644);
+		if (m_fd < 0)
+			throw std::runtime_error("Cannot create trace file '" + path + "': " + std::strerror(errno));
+
+		// Reserve the blocks up front: writes inside the file size never have to extend it,
+		// and a full disk fails here instead of in a completion.
+		if (::fallocate(m_fd, 0, 0, static_cast<off_t>(m_options.segmentBytes)) != 0 && errno != EOPNOTSUPP && errno != ENOSYS)
+		{
+			const int error = errno;
+			::close(m_fd);
+			m_fd = -1;
+			throw std::runtime_error("Cannot allocate trace file '" + path + "': " + std::strerror(error));
+		}
+		m_used = 0;
+		m_offset = 0;
+		m_deadlineNs = m_options.rotateNs > 0 ? now_ns() + m_options.rotateNs : 0;
+	}
+
+	void UringTraceFile::close_segment()
+	{
+		if (m_fd < 0)
+			return;
+		submit_current();
+		while (m_inFlight > 0)
+			reap(true);
+		if (::ftruncate(m_fd, static_cast<off_t>(m_used)) != 0)
+		{
+			// The segment keeps its zero padding, as after a crash.
+		}
+		::close(m_fd);
+		m_fd = -1;
+	}
+
+	void UringTraceFile::submit_current()
+	{
+		Block& block = m_blocks[m_current];
+		const auto used = static_cast<std::size_t>(m_fill - block.data);
+		if (used == 0)
+			return;
+#ifdef GWATCH_HAS_IO_URING
+		if (m_error == 0)
+		{
+			std::size_t length = used;
+			if (m_options.direct && length % kDirectAlignment != 0)
+			{
+				// O_DIRECT writes whole sectors: pad, the file is truncated to its data on close.
+				const std::size_t padded = (length + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment;
+				std::memset(block.data + length, 0, padded - length);
+				length = padded;
+			}
+			block.length = static_cast<std::uint32_t>(length);
+			block.busy = true;
+			block.inFlight = ++m_inFlight;
+			block.submittedNs = now_ns();
+			if (m_inFlight == 1)
+				m_busySinceNs = block.submittedNs;
+			m_ring->prepare_write(m_fd, block, m_current, m_offset);
+			int submitted;
+			while ((submitted = m_ring->enter(1, 0)) < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+				reap(false);
+			if (submitted < 0)
+			{
+				m_error = errno;
+				block.busy = false;
+				--m_inFlight;
+			}
+		}
+#endif
+		m_offset += m_options.blockBytes;
+
+		// Blocks are filled in turn: wait for the next one's write if it is still in flight.
+		m_current = (m_current + 1) % m_blocks.size();
+		while (m_blocks[m_current].busy)
+			reap(true);
+		m_fill = m_blocks[m_current].data;
+		m_fillEnd = m_fill + m_options.blockBytes;
+	}
+
+	void UringTraceFile::reap(const bool wait)
+	{
+#ifdef GWATCH_HAS_IO_URING
+		unsigned head = *m_ring->cqHead;
+		if (wait && head == std::atomic_ref(*m_ring->cqTail).load(std::memory_order_acquire))
+		{
+			if (m_ring->enter(0, 1) < 0 && errno != EINTR)
+			{
+				// The ring is unusable: give the blocks up rather than wait forever.
+				if (m_error == 0)
+					m_error = errno;
+				for (Block& block : m_blocks)
+					block.busy = false;
+				m_inFlight = 0;
+				return;
+			}
+		}
+
+		const unsigned tail = std::atomic_ref(*m_ring->cqTail).load(std::memory_order_acquire);
+		const std::uint64_t now = now_ns();
+		for (; head != tail; ++head)
+		{
+			const io_uring_cqe& cqe = m_ring->cqes[head & *m_ring->cqMask];
+			Block& block = m_blocks[static_cast<std::size_t>(cqe.user_data)];
+			if (cqe.res < 0 && m_error == 0)
+				m_error = -cqe.res;
+			else if (cqe.res >= 0 && static_cast<std::uint32_t>(cqe.res) != block.length && m_error == 0)
+				m_error = EIO;
+			profiling::add_trace_write(cqe.res > 0 ? static_cast<std::uint64_t>(cqe.res) : 0, block.inFlight, now - block.submittedNs);
+			block.busy = false;
+			if (--m_inFlight == 0)
+				m_busyNs += now - m_busySinceNs;
+		}
+		std::atomic_ref(*m_ring->cqHead).store(head, std::memory_order_release);
+#else
+		(void)wait;
+#endif
+	}
+}
+#endif
@@ -0,0 +1,150 @@
+#include "../include/WatchPlan.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace gwatch
+{
+	namespace
+	{
+		constexpr std::uint64_t kWord = 8;
+
+		// Part of a variable that lies in one aligned 8-byte word, as byte offsets in that word.
+		struct Piece
+		{
+			std::uint32_t variable = 0;
+			std::uint32_t lo = 0;
+			std::uint32_t hi = 0;
+		};
+
+		struct Word
+		{
+			std::uint64_t address = 0;
+			std::vector<Piece> pieces;
+		};
+
+		std::uint64_t first_word(const ResolvedSymbol& symbol)
+		{
+			return symbol.address & ~(kWord - 1);
+		}
+
+		std::uint64_t end_of(const ResolvedSymbol& symbol)
+		{
+			return symbol.address + std::max<std::uint64_t>(symbol.size, 1);
+		}
+
+		// Smallest naturally aligned window of 1, 2, 4 or 8 bytes covering [lo, hi) of a word.
+		std::pair<std::uint32_t, std::uint32_t> window(const std::uint32_t lo, const std::uint32_t hi)
+		{
+			for (std::uint32_t size = 1; size < kWord; size *= 2)
+			{
+				const std::uint32_t start = lo & ~(size - 1);
+				if (start + size >= hi)
+					return {start, size};
+			}
+			return {0, static_cast<std::uint32_t>(kWord)};
+		}
+	}
+
+	std::uint64_t WatchPlan::variables_of(const std::uint32_t slotMask) const
+	{
+		std::uint64_t mask = 0;
+		for (std::size_t i = 0; i < slots.size(); ++i)
+		{
+			if (slotMask & (1u << i))
+				mask |= slots[i].variables;
+		}
+		return mask;
+	}
+
+	std::uint64_t WatchPlan::covered_mask() const
+	{
+		std::uint64_t mask = 0;
+		for (const std::uint32_t v : covered)
+			mask |= 1ull << v;
+		return mask;
+	}
+
+	WatchPlan compile_watch_plan(const std::span<const ResolvedSymbol> symbols, const std::size_t slotBudget)
+	{
+		if (symbols.size() > kMaxPlannedVariables)
+			throw std::invalid_argument("A watch plan covers at most " + std::to_string(kMaxPlannedVariables) + " variables.");
+
+		WatchPlan plan;
+		std::vector<Word> words;
+
+		// Admission: a variable costs the words it touches that no admitted variable uses yet.
+		for (std::uint32_t v = 0; v < symbols.size(); ++v)
+		{
+			const ResolvedSymbol& symbol = symbols[v];
+			const std::uint64_t end = end_of(symbol);
+
+			std::size_t missing = 0;
+			for (std::uint64_t w = first_word(symbol); w < end; w += kWord)
+			{
+				if (std::ranges::find(words, w, &Word::address) == words.end())
+					++missing;
+			}
+			if (words.size() + missing > slotBudget)
+			{
+				plan.uncovered.push_back(v);
+				continue;
+			}
+
+			plan.covered.push_back(v);
+			for (std::uint64_t w = first_word(symbol); w < end; w += kWord)
+			{
+				auto it = std::ranges::find(words, w, &Word::address);
+				if (it == words.end())
+					it = words.insert(words.end(), Word{.address = w, .pieces = {}});
+				it->pieces.push_back(Piece{
+					.variable = v,
+					.lo = static_cast<std::uint32_t>(std::max(symbol.address, w) - w),
+					.hi = static_cast<std::uint32_t>(std::min(end, w + kWord) - w),
+				});
+			}
+		}
+
+		// Spare slots: give the variables of a shared word their own windows when those are disjoint.
+		std::size_t spare = slotBudget - words.size();
+		for (const Word& word : words)
+		{
+			bool split = word.pieces.size() > 1 && word.pieces.size() - 1 <= spare;
+			for (std::size_t i = 0; split && i < word.pieces.size(); ++i)
+			{
+				const auto [si, ni] = window(word.pieces[i].lo, word.pieces[i].hi);
+				for (std::size_t j = i + 1; split && j < word.pieces.size(); ++j)
+				{
+					const auto [sj, nj] = window(word.pieces[j].lo, word.pieces[j].hi);
+					split = si + ni <= sj || sj + nj <= si;
+				}
+			}
+
+			if (split)
+			{
+				spare -= word.pieces.size() - 1;
+				for (const Piece& piece : word.pieces)
+				{
+					const auto [start, size] = window(piece.lo, piece.hi);
+					plan.slots.push_back(PlannedSlot{.address = word.address + start, .size = size, .variables = 1ull << piece.variable});
+				}
+				continue;
+			}
+
+			std::uint32_t lo = static_cast<std::uint32_t>(kWord);
+			std::uint32_t hi = 0;
+			std::uint64_t variables = 0;
+			for (const Piece& piece : word.pieces)
+			{
+				lo = std::min(lo, piece.lo);
+				hi = std::max(hi, piece.hi);
+				variables |= 1ull << piece.variable;
+			}
+			const auto [start, size] = window(lo, hi);
+			plan.slots.push_back(PlannedSlot{.address = word.address + start, .size = size, .variables = variables});
+		}
+
+		return plan;
+	}
+}
@@ -0,0 +1,119 @@
+#include "../include/WatchRotation.h"
+
+#include <algorithm>
+
+#include "../include/Profiling.h"
+
+namespace gwatch
+{
+	WatchRotation::WatchRotation(const std::span<const ResolvedSymbol> symbols, const std::size_t slotBudget) :
+		m_observed(symbols.size(), 0),
+		m_armedNs(symbols.size(), 0)
+	{
+		for (const auto& symbol : symbols)
+			m_names.push_back(symbol.name);
+
+		// Each pass plans what the previous ones left over; a pass always admits its first variable.
+		std::vector<std::uint32_t> remaining(symbols.size());
+		for (std::uint32_t i = 0; i < remaining.size(); ++i)
+			remaining[i] = i;
+
+		while (!remaining.empty())
+		{
+			std::vector<ResolvedSymbol> subset;
+			for (const std::uint32_t v : remaining)
+				subset.push_back(symbols[v]);
+			const WatchPlan local = compile_watch_plan(subset, slotBudget);
+
+			// Back to indices into symbols.
+			WatchPlan group;
+			for (const auto& slot : local.slots)
+			{
+				PlannedSlot mapped = slot;
+				mapped.variables = 0;
+				for (std::size_t i = 0; i < remaining.size(); ++i)
+				{
+					if (slot.variables & (1ull << i))
+						mapped.variables |= 1ull << remaining[i];
+				}
+				group.slots.push_back(mapped);
+			}
+			for (const std::uint32_t i : local.covered)
+				group.covered.push_back(remaining[i]);
+			std::ranges::sort(group.covered);
+			for (std::uint32_t v = 0; v < symbols.size(); ++v)
+			{
+				if (!std::ranges::binary_search(group.covered, v))
+					group.uncovered.push_back(v);
+			}
+			m_groups.push_back(std::move(group));
+
+			std::vector<std::uint32_t> next;
+			for (const std::uint32_t i : local.uncovered)
+				next.push_back(remaining[i]);
+			remaining = std::move(next);
+		}
+	}
+
+	std::size_t WatchRotation::max_slots() const
+	{
+		std::size_t slots = 0;
+		for (const auto& group : m_groups)
+			slots = std::max(slots, group.slots.size());
+		return slots;
+	}
+
+	void WatchRotation::start(const std::uint64_t nowNs)
+	{
+		m_current = 0;
+		m_startNs = nowNs;
+		m_switchNs = nowNs;
+		m_running = true;
+	}
+
+	const WatchPlan& WatchRotation::advance(const std::uint64_t nowNs)
+	{
+		close_quantum(nowNs);
+		m_current = (m_current + 1) % m_groups.size();
+		return current();
+	}
+
+	void WatchRotation::stop(const std::uint64_t nowNs)
+	{
+		if (!m_running)
+			return;
+		close_quantum(nowNs);
+		m_stopNs = nowNs;
+		m_running = false;
+
+		const std::uint64_t total = m_stopNs - m_startNs;
+		for (std::uint32_t v = 0; v < m_names.size(); ++v)
+			profiling::add_watch_coverage(m_names[v], m_armedNs[v], total, m_observed[v]);
+	}
+
+	std::vector<WatchRotation::Estimate> WatchRotation::estimates() const
+	{
+		const std::uint64_t total = (m_running ? m_switchNs : m_stopNs) - m_startNs;
+		std::vector<Estimate> out;
+		for (std::uint32_t v = 0; v < m_names.size(); ++v)
+		{
+			Estimate e{.variable = v, .observed = m_observed[v], .armed_ns = m_armedNs[v]};
+			if (total > 0)
+				e.coverage = static_cast<double>(e.armed_ns) / static_cast<double>(total);
+			if (e.coverage > 0.0)
+				e.estimated = static_cast<double>(e.observed) / e.coverage;
+			if (e.armed_ns > 0)
+				e.rate_per_second = static_cast<double>(e.observed) * 1e9 / static_cast<double>(e.armed_ns);
+			out.push_back(e);
+		}
+		return out;
+	}
+
+	void WatchRotation::close_quantum(const std::uint64_t nowNs)
+	{
+		const std::uint64_t elapsed = nowNs > m_switchNs ? nowNs - m_switchNs : 0;
+		for (const std::uint32_t v : current().covered)
+			m_armedNs[v] += elapsed;
+		m_switchNs = nowNs;
+	}
+}
@@ -5,9 +5,19 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
 
+#include "DebugRegisters.h"
 #include "MemoryWatcher.h"
+#include "WatchPlan.h"
 #include "ProcessLauncher.h"
 #include "Logger.h"
 #include "Profiling.h"
@@ -15,32 +25,100 @@
 
 namespace gwatch
 {
-	WindowsMemoryWatcher::WindowsMemoryWatcher(void* hProcess, const ResolvedSymbol& resolvedSymbol, bool enableHardwareBreakpoints) :
+	namespace
+	{
+		// Larger spans are read variable by variable rather than copying the gap in between.
+		constexpr std::size_t kMaxBatchSpan = 4096;
+
+		std::uint64_t now_ns()
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+	}
+
+	WindowsMemoryWatcher::WindowsMemoryWatcher(void* hProcess, std::vector<ResolvedSymbol> resolvedSymbols, bool enableHardwareBreakpoints, const std::uint32_t rotateQuantumMs, const bool hotSites) :
 		IMemoryWatcher(),
 		m_hProcess(hProcess),
-		m_resolvedSymbol(resolvedSymbol),
-		m_enableHardwareBreakpoints(enableHardwareBreakpoints)
+		m_enableHardwareBreakpoints(enableHardwareBreakpoints),
+		m_rotateQuantumMs(rotateQuantumMs)
 	{
 		if (!m_hProcess)
 		{
 			throw MemoryWatchError("WindowsMemoryWatcher: null process handle.");
 		}
-		if (!(resolvedSymbol.size == 4 || resolvedSymbol.size == 8))
+		if (resolvedSymbols.empty() || resolvedSymbols.size() > kMaxPlannedVariables)
+		{
+			throw MemoryWatchError("WindowsMemoryWatcher: between 1 and " + std::to_string(kMaxPlannedVariables) + " variables can be watched.");
+		}
+
+		std::uint64_t end = 0;
+		m_spanBase = ~0ull;
+		for (auto& symbol : resolvedSymbols)
+		{
+			if (!(symbol.size == 4 || symbol.size == 8))
+			{
+				throw MemoryWatchError("WindowsMemoryWatcher: size must be 4 or 8 bytes.");
+			}
+			m_spanBase = std::min(m_spanBase, symbol.address);
+			end = std::max(end, symbol.address + symbol.size);
+			m_watched.push_back(Watched{.symbol = std::move(symbol)});
+		}
+		m_spanSize = static_cast<std::size_t>(end - m_spanBase);
+		if (m_watched.size() > 1 && m_spanSize <= kMaxBatchSpan)
+		{
+			m_spanBuffer.resize(m_spanSize);
+		}
+
+		std::vector<ResolvedSymbol> symbols;
+		for (const auto& w : m_watched)
+			symbols.push_back(w.symbol);
+		m_rotation = WatchRotation(symbols);
+		if (hotSites)
+			m_hotSites.emplace();
+	}
+
+	WindowsMemoryWatcher::WindowsMemoryWatcher(void* hProcess, const ResolvedSymbol& resolvedSymbol, const bool enableHardwareBreakpoints) :
+		WindowsMemoryWatcher(hProcess, std::vector<ResolvedSymbol>{resolvedSymbol}, enableHardwareBreakpoints)
+	{
+	}
+
+	WindowsMemoryWatcher::~WindowsMemoryWatcher()
+	{
+		stop_rotation();
+		for (const auto& [tid, thread] : m_armedThreads)
 		{
-			throw MemoryWatchError("WindowsMemoryWatcher: size must be 4 or 8 bytes.");
+			if (thread.handle)
+				CloseHandle(thread.handle);
 		}
 	}
 
 	ContinueStatus WindowsMemoryWatcher::on_event(const DebugEvent& ev)
 	{
 		using T = DebugEventType;
+		if (ev.type == T::ExitProcess)
+		{
+			stop_rotation();
+			return ContinueStatus::Default;
+		}
+
+		// The rotation thread re-arms the same threads.
+		const std::lock_guard lock(m_mutex);
 		switch (ev.type)
 		{
 			case T::_CreateProcess:
 				try { install_on_thread(ev.thread_id); }
 				catch (...) {}
-				try { m_lastValue = read_value(); }
-				catch (...) { m_lastValue.reset(); }
+				{
+					const bool ok = read_values();
+					for (auto& w : m_watched)
+						w.lastValue = ok ? std::optional(w.current) : std::nullopt;
+				}
+				m_rotation.start(now_ns());
+				if (rotating() && !m_rotationThread.joinable())
+				{
+					m_stopRotation = false;
+					m_rotationThread = std::thread([this] { rotation_loop(); });
+				}
 				return ContinueStatus::Default;
 
 			case T::CreateThread:
@@ -49,50 +127,71 @@ namespace gwatch
 				return ContinueStatus::Default;
 
 			case T::ExitThread:
-				m_armedThreads.erase(ev.thread_id);
+				release_thread(ev.thread_id);
 				return ContinueStatus::Default;
 
 			case T::Exception:
 				{
 					if (const auto& ex = std::get<ExceptionInfo>(ev.payload); ex.code == EXCEPTION_SINGLE_STEP)
 					{
-						return handle_single_step(ev.thread_id);
+						return handle_single_step(ev.thread_id, ex.address);
 					}
 					return ContinueStatus::Default;
 				}
 
-			case T::ExitProcess:
-				return ContinueStatus::Default;
-
 			default:
 				return ContinueStatus::Default;
 		}
 	}
 
-	std::uint64_t WindowsMemoryWatcher::mask_for_size(const std::uint32_t size)
+	void WindowsMemoryWatcher::rotation_loop()
 	{
-		switch (size)
+		std::unique_lock lock(m_mutex);
+		while (!m_rotationWake.wait_for(lock, std::chrono::milliseconds(m_rotateQuantumMs), [this] { return m_stopRotation; }))
 		{
-			case 4:
-				return 0xFFFFFFFFull;
-			case 8:
-				return 0xFFFFFFFFFFFFFFFFull;
-			default:
-				throw MemoryWatchError("mask_for_size: unsupported size (expected 4 or 8).");
+			const WatchPlan& next = m_rotation.advance(now_ns());
+			// One re-arm pass: each thread is only suspended for its own context update.
+			for (auto& [tid, thread] : m_armedThreads)
+			{
+				if (!thread.handle || SuspendThread(thread.handle) == static_cast<DWORD>(-1))
+					continue;
+				try { arm_thread(tid, thread, m_rotation.current_group()); }
+				catch (...) {}
+				ResumeThread(thread.handle);
+			}
+			// Fresh baselines: a change made while a variable was not armed is not an observed write.
+			if (read_values())
+			{
+				for (const std::uint32_t v : next.covered)
+					m_watched[v].lastValue = m_watched[v].current;
+			}
 		}
 	}
 
-	std::uint64_t WindowsMemoryWatcher::len_encoding_for_size(const std::uint32_t size)
+	void WindowsMemoryWatcher::stop_rotation()
+	{
+		{
+			const std::lock_guard lock(m_mutex);
+			m_stopRotation = true;
+		}
+		m_rotationWake.notify_all();
+		if (m_rotationThread.joinable())
+			m_rotationThread.join();
+
+		const std::lock_guard lock(m_mutex);
+		m_rotation.stop(now_ns());
+	}
+
+	std::uint64_t WindowsMemoryWatcher::mask_for_size(const std::uint32_t size)
 	{
-		// DR7 LEN encoding (x86/x64):
 		switch (size)
 		{
 			case 4:
-				return 0b11;
+				return 0xFFFFFFFFull;
 			case 8:
-				return 0b10;
+				return 0xFFFFFFFFFFFFFFFFull;
 			default:
-				throw MemoryWatchError("len_encoding_for_size: unsupported size (expected 4 or 8).");
+				throw MemoryWatchError("mask_for_size: unsupported size (expected 4 or 8).");
 		}
 	}
 
@@ -100,7 +199,7 @@ namespace gwatch
 	{
 		if (!m_enableHardwareBreakpoints)
 		{
-			m_armedThreads.insert(tid);
+			m_armedThreads.emplace(tid, ArmedThread{});
 			return;
 		}
 
@@ -113,117 +212,271 @@ namespace gwatch
 			throw MemoryWatchError("OpenThread failed for TID=" + std::to_string(tid) + ": " + win::last_error_string());
 		}
 
+		ArmedThread thread{.handle = hThread};
+		try
+		{
+			arm_thread(tid, thread, m_rotation.current_group());
+		}
+		catch (...)
+		{
+			CloseHandle(hThread);
+			throw;
+		}
+		m_armedThreads.emplace(tid, thread);
+	}
+
+	void WindowsMemoryWatcher::arm_thread(const std::uint32_t tid, ArmedThread& thread, const std::size_t group)
+	{
 		CONTEXT ctx{};
 		ctx.ContextFlags = CONTEXT_DEBUG_REGISTERS;
 
-		if (!GetThreadContext(hThread, &ctx))
+		if (!GetThreadContext(thread.handle, &ctx))
 		{
-			CloseHandle(hThread);
 			throw MemoryWatchError("GetThreadContext failed for TID=" + std::to_string(tid) + ": " + win::last_error_string());
 		}
 
+		// A trap taken under the group being replaced may not have been reported yet: DR6 only
+		// means something against the slots that were armed when it fired.
+		std::uint64_t fired = 0;
+		if (thread.group != ArmedThread::kNoGroup)
+		{
+			const WatchPlan& armed = m_rotation.group(thread.group);
+			fired = armed.variables_of(dr::triggered_slots(ctx.Dr6) & ((1u << armed.slots.size()) - 1));
+		}
+		const WatchPlan& plan = m_rotation.group(group);
+
+		// Slot i <-> plan.slots[i], read/write trigger.
+		dr::Slot slots[dr::kSlotCount]{};
 #ifdef _WIN64
-		ctx.Dr0 = m_resolvedSymbol.address;
+		using Reg = DWORD64;
 #else
-		ctx.Dr0 = static_cast<DWORD>(m_resolvedSymbol.address);
+		using Reg = DWORD;
 #endif
+		Reg* regs[dr::kSlotCount] = {&ctx.Dr0, &ctx.Dr1, &ctx.Dr2, &ctx.Dr3};
+		for (std::size_t i = 0; i < plan.slots.size(); ++i)
+		{
+			slots[i] = dr::Slot{
+				.address = plan.slots[i].address,
+				.size = plan.slots[i].size,
+				.trigger = dr::Trigger::ReadWrite,
+			};
+			*regs[i] = static_cast<Reg>(slots[i].address);
+		}
 
-		// Build DR7 config for slot 0:
-		// - L0 (bit 0) = 1 (local enable)
-		// - RW0 (bits 16..17) = 11b (read/write)
-		// - LEN0 (bits 18..19) = per size
-		constexpr std::uint64_t rw = 0b11ull;
-		const std::uint64_t len = len_encoding_for_size(static_cast<std::uint32_t>(m_resolvedSymbol.size));
-
-#ifdef _WIN64
-		DWORD64 dr7 = ctx.Dr7;
-		// Clear previous slot-0 config: L0, RW0, LEN0
-		dr7 &= ~(1ull << 0);
-		dr7 &= ~(0b11ull << 16);
-		dr7 &= ~(0b11ull << 18);
-		// Set new config
-		dr7 |= (1ull << 0);
-		dr7 |= (rw << 16);
-		dr7 |= (len << 18);
-		ctx.Dr7 = dr7;
-
+		ctx.Dr7 = static_cast<Reg>(dr::encode_dr7(ctx.Dr7, std::span(slots, plan.slots.size())));
 		// Clear DR6 to avoid stale status bits.
 		ctx.Dr6 = 0;
-#else
-		DWORD dr7 = ctx.Dr7;
-		dr7 &= ~(1u << 0);
-		dr7 &= ~(0b11u << 16);
-		dr7 &= ~(0b11u << 18);
-		dr7 |= (1u << 0);
-		dr7 |= (static_cast<DWORD>(rw) << 16);
-		dr7 |= (static_cast<DWORD>(len) << 18);
-		ctx.Dr7 = dr7;
-		ctx.Dr6 = 0;
-#endif
 
-		if (!SetThreadContext(hThread, &ctx))
+		if (!SetThreadContext(thread.handle, &ctx))
 		{
-			CloseHandle(hThread);
 			throw MemoryWatchError("SetThreadContext failed for TID=" + std::to_string(tid) + ": " + win::last_error_string());
 		}
+		thread.group = group;
+		thread.pending |= fired;
+	}
+
+	void WindowsMemoryWatcher::release_thread(const std::uint32_t tid)
+	{
+		const auto it = m_armedThreads.find(tid);
+		if (it == m_armedThreads.end())
+			return;
+		if (it->second.handle)
+			CloseHandle(it->second.handle);
+		m_armedThreads.erase(it);
+	}
+
+	std::uint64_t WindowsMemoryWatcher::take_triggered(const std::uint32_t tid)
+	{
+		const auto it = m_armedThreads.find(tid);
+		if (it == m_armedThreads.end() || !it->second.handle)
+			return m_rotation.current().variables_of((1u << m_rotation.current().slots.size()) - 1);
+
+		ArmedThread& thread = it->second;
+		std::uint64_t variables = std::exchange(thread.pending, 0);
+		if (thread.group == ArmedThread::kNoGroup)
+			return variables;
+		const WatchPlan& armed = m_rotation.group(thread.group);
+		const std::uint32_t all = (1u << armed.slots.size()) - 1;
+		CONTEXT ctx{};
+		ctx.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+		if (!GetThreadContext(thread.handle, &ctx))
+			return variables | armed.variables_of(all);
 
-		CloseHandle(hThread);
-		m_armedThreads.insert(tid);
+		const std::uint32_t hits = dr::triggered_slots(ctx.Dr6) & all;
+		if (hits != 0)
+		{
+			ctx.Dr6 = static_cast<decltype(ctx.Dr6)>(dr::clear_triggered(ctx.Dr6));
+			SetThreadContext(thread.handle, &ctx);
+			variables |= armed.variables_of(hits);
+		}
+		return variables;
 	}
 
-	std::uint64_t WindowsMemoryWatcher::read_value() const
+	std::optional<std::uint64_t> WindowsMemoryWatcher::trap_address(const std::uint32_t tid, const x86::Instruction& insn, const std::uint64_t ip) const
+	{
+		const auto it = m_armedThreads.find(tid);
+		if (!insn.address.known || it == m_armedThreads.end() || !it->second.handle)
+			return std::nullopt;
+		CONTEXT ctx{};
+		ctx.ContextFlags = CONTEXT_INTEGER | CONTEXT_CONTROL;
+		if (!GetThreadContext(it->second.handle, &ctx))
+			return std::nullopt;
+#ifdef _WIN64
+		const std::array<std::uint64_t, x86::kRegisters> registers = {
+			ctx.Rax, ctx.Rcx, ctx.Rdx, ctx.Rbx, ctx.Rsp, ctx.Rbp, ctx.Rsi, ctx.Rdi,
+			ctx.R8, ctx.R9, ctx.R10, ctx.R11, ctx.R12, ctx.R13, ctx.R14, ctx.R15,
+		};
+#else
+		const std::array<std::uint64_t, x86::kRegisters> registers = {ctx.Eax, ctx.Ecx, ctx.Edx, ctx.Ebx, ctx.Esp, ctx.Ebp, ctx.Esi, ctx.Edi};
+#endif
+		return x86::effective_address(insn, ip, registers);
+	}
+
+	bool WindowsMemoryWatcher::read_values()
 	{
 #ifdef GWATCH_PROFILE
 		const auto start = std::chrono::high_resolution_clock::now();
 #endif
-		std::uint64_t val = 0;
+		bool ok = true;
 		SIZE_T read = 0;
-		const BOOL ok = ReadProcessMemory(m_hProcess, reinterpret_cast<LPCVOID>(m_resolvedSymbol.address), &val, m_resolvedSymbol.size, &read);
+		if (!m_spanBuffer.empty())
+		{
+			// One remote read covers every watched variable.
+			ok = ReadProcessMemory(m_hProcess, reinterpret_cast<LPCVOID>(m_spanBase), m_spanBuffer.data(), m_spanSize, &read) && read == m_spanSize;
+			for (std::size_t i = 0; ok && i < m_watched.size(); ++i)
+			{
+				auto& w = m_watched[i];
+				std::uint64_t val = 0;
+				std::memcpy(&val, m_spanBuffer.data() + (w.symbol.address - m_spanBase), w.symbol.size);
+				w.current = val & mask_for_size(static_cast<std::uint32_t>(w.symbol.size));
+			}
+		}
+		else
+		{
+			for (std::size_t i = 0; ok && i < m_watched.size(); ++i)
+			{
+				auto& w = m_watched[i];
+				std::uint64_t val = 0;
+				ok = ReadProcessMemory(m_hProcess, reinterpret_cast<LPCVOID>(w.symbol.address), &val, w.symbol.size, &read) && read == w.symbol.size;
+				// Interpret as little-endian unsigned integer masked to 'size' bytes.
+				w.current = val & mask_for_size(static_cast<std::uint32_t>(w.symbol.size));
+			}
+		}
 #ifdef GWATCH_PROFILE
 		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
 		profiling::add_read_duration(static_cast<std::uint64_t>(elapsed));
 #endif
-		if (!ok || read != m_resolvedSymbol.size)
+		return ok;
+	}
+
+	std::optional<x86::CodeRange> WindowsMemoryWatcher::function_at(const std::uint64_t address)
+	{
+		MEMORY_BASIC_INFORMATION info{};
+		if (VirtualQueryEx(m_hProcess, reinterpret_cast<LPCVOID>(address), &info, sizeof(info)) == 0 || info.Type != MEM_IMAGE)
+			return std::nullopt;
+		const auto base = reinterpret_cast<std::uint64_t>(info.AllocationBase);
+		auto [table, inserted] = m_functionTables.try_emplace(base);
+		if (inserted)
 		{
-			throw MemoryWatchError("ReadProcessMemory failed: " + win::last_error_string());
+			// x64 images list every non-leaf function in .pdata; x86 images have none.
+			const auto read = [this](const std::uint64_t at, void* out, const std::size_t size)
+			{
+				SIZE_T copied = 0;
+				return ReadProcessMemory(m_hProcess, reinterpret_cast<LPCVOID>(at), out, size, &copied) && copied == size;
+			};
+			IMAGE_DOS_HEADER dos{};
+			IMAGE_NT_HEADERS64 nt{};
+			if (read(base, &dos, sizeof(dos)) && dos.e_magic == IMAGE_DOS_SIGNATURE && read(base + dos.e_lfanew, &nt, sizeof(nt)) &&
+				nt.Signature == IMAGE_NT_SIGNATURE && nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC &&
+				nt.OptionalHeader.NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_EXCEPTION)
+			{
+				const IMAGE_DATA_DIRECTORY& directory = nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+				std::vector<RUNTIME_FUNCTION> entries(directory.Size / sizeof(RUNTIME_FUNCTION));
+				if (!entries.empty() && read(base + directory.VirtualAddress, entries.data(), entries.size() * sizeof(RUNTIME_FUNCTION)))
+				{
+					table->second.reserve(entries.size());
+					for (const RUNTIME_FUNCTION& entry : entries)
+						table->second.push_back(x86::CodeRange{.begin = base + entry.BeginAddress, .size = entry.EndAddress - entry.BeginAddress});
+					std::ranges::sort(table->second, {}, &x86::CodeRange::begin);
+				}
+			}
 		}
-		// Interpret as little-endian unsigned integer masked to 'size' bytes.
-		return val & mask_for_size(static_cast<std::uint32_t>(m_resolvedSymbol.size));
+		const auto fn = std::ranges::upper_bound(table->second, address, {}, &x86::CodeRange::begin);
+		if (fn == table->second.begin() || address - std::prev(fn)->begin >= std::prev(fn)->size)
+			return std::nullopt;
+		return *std::prev(fn);
 	}
 
-	ContinueStatus WindowsMemoryWatcher::handle_single_step(const std::uint32_t tid)
+	x86::Instruction WindowsMemoryWatcher::classify(const std::uint64_t ip)
+	{
+		// Only the first trap in a function reads and decodes the target's code.
+		const auto read = [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+		{
+			SIZE_T copied = 0;
+			return ReadProcessMemory(m_hProcess, reinterpret_cast<LPCVOID>(address), out, size, &copied) && copied == size;
+		};
+		return m_decodeCache.classify(ip, [this](const std::uint64_t address) { return function_at(address); }, read);
+	}
+
+	ContinueStatus WindowsMemoryWatcher::handle_single_step(const std::uint32_t tid, const std::uint64_t ip)
 	{
 #ifdef GWATCH_PROFILE
 		const profiling::EventTimer eventTimer;
 #endif
-		std::uint64_t current = 0;
-		try
-		{
-			current = read_value();
-		}
-		catch (...)
-		{
+		// A single step none of our slots explains (e.g. the target tracing itself) is not ours to log.
+		// The slots are decoded against the group armed on tid when they fired, which the
+		// rotation thread may have replaced since.
+		const std::uint64_t candidates = take_triggered(tid);
+		if (candidates == 0)
+			return ContinueStatus::Default;
+
+		if (!read_values())
 			return ContinueStatus::NotHandled;
-		}
 
-		if (!m_lastValue.has_value())
+		// On a shared slot the address of the access names the variable. Without it, the
+		// variables that changed were written: every access traps.
+		const bool shared = !std::has_single_bit(candidates);
+		std::uint64_t changed = 0;
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
 		{
-			Logger::log_read(m_resolvedSymbol.name, current);
-			m_lastValue = current;
-			return ContinueStatus::Default;
+			const auto& w = m_watched[i];
+			if ((candidates & (1ull << i)) && w.lastValue.has_value() && w.current != *w.lastValue)
+				changed |= 1ull << i;
 		}
 
-		if (current != *m_lastValue)
+		// The trap fires after the access: the instruction that made it says what it was, so a
+		// store of the same value or a read-modify-write netting to zero is still a write.
+		const x86::Instruction insn = classify(ip);
+		const std::optional<std::uint64_t> address = shared ? trap_address(tid, insn, ip) : std::nullopt;
+		std::uint64_t targets = attribute_access(candidates, address, insn.width, [this](const std::size_t v) -> const ResolvedSymbol& { return m_watched[v].symbol; });
+		if (shared && !address)
+			targets = changed;
+		const x86::Access access = insn.access;
+		const bool write = access == x86::Access::Store || access == x86::Access::ReadModifyWrite || (access == x86::Access::Unknown && (changed & targets));
+		const std::uint64_t site = x86::access_site(insn, ip);
+		if (targets == 0 && !address)
+			++m_unattributed;
+		if (m_hotSites && targets != 0)
+			m_hotSites->record(site, write ? AccessKind::Write : AccessKind::Read, tid, targets);
+		for (std::size_t i = 0; i < m_watched.size(); ++i)
 		{
-			Logger::log_write(m_resolvedSymbol.name, *m_lastValue, current);
-			*m_lastValue = current;
-		}
-		else
-		{
-			Logger::log_read(m_resolvedSymbol.name, current);
+			if (!(targets & (1ull << i)))
+				continue;
+
+			auto& w = m_watched[i];
+			if (write)
+			{
+				Logger::log_write(w.symbol.name, w.lastValue.value_or(w.current), w.current, tid, 0, site);
+			}
+			else
+			{
+				Logger::log_read(w.symbol.name, w.current, tid, 0, site);
+			}
+			w.lastValue = w.current;
+			m_rotation.record_hit(static_cast<std::uint32_t>(i));
 		}
 
-		// Ensure DR0 remains armed for this thread. Normally DR state persists, but some debuggers refresh.
+		// Ensure the slots remain armed for this thread. Normally DR state persists, but some debuggers refresh.
 		if (!m_armedThreads.contains(tid))
 		{
 			try { install_on_thread(tid); }
@@ -24,6 +24,51 @@ namespace gwatch
 	namespace
 	{
 		constexpr DWORD kWaitMs = INFINITE;
+		constexpr DWORD kTrapFlag = 0x100;
+
+		// UTF-8 path of the image file a debug event carries a handle to, empty when unknown.
+		// The "\\?\" prefix GetFinalPathNameByHandle returns is dropped ("\\?\UNC\" -> "\\").
+		std::string final_path(const HANDLE hFile)
+		{
+			if (!hFile)
+				return {};
+			std::wstring path(MAX_PATH, L'\0');
+			DWORD n = GetFinalPathNameByHandleW(hFile, path.data(), static_cast<DWORD>(path.size()), FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+			if (n >= path.size())
+			{
+				path.resize(n);
+				n = GetFinalPathNameByHandleW(hFile, path.data(), static_cast<DWORD>(path.size()), FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+			}
+			if (n == 0 || n >= path.size())
+				return {};
+			path.resize(n);
+			if (path.starts_with(L"\\\\?\\UNC\\"))
+				path.replace(0, 8, L"\\\\");
+			else if (path.starts_with(L"\\\\?\\"))
+				path.erase(0, 4);
+
+			const int size = WideCharToMultiByte(CP_UTF8, 0, path.data(), static_cast<int>(path.size()), nullptr, 0, nullptr, nullptr);
+			std::string utf8(static_cast<std::size_t>(std::max(size, 0)), '\0');
+			if (size > 0)
+				WideCharToMultiByte(CP_UTF8, 0, path.data(), static_cast<int>(path.size()), utf8.data(), size, nullptr, nullptr);
+			return utf8;
+		}
+
+		// EFLAGS.TF: the thread raises EXCEPTION_SINGLE_STEP after its next instruction.
+		void set_trap_flag(const DWORD tid)
+		{
+			const HANDLE hThread = OpenThread(THREAD_GET_CONTEXT | THREAD_SET_CONTEXT, FALSE, tid);
+			if (!hThread)
+				return;
+			CONTEXT ctx{};
+			ctx.ContextFlags = CONTEXT_CONTROL;
+			if (GetThreadContext(hThread, &ctx))
+			{
+				ctx.EFlags |= kTrapFlag;
+				SetThreadContext(hThread, &ctx);
+			}
+			CloseHandle(hThread);
+		}
 	}
 
 	WindowsProcessLauncher::WindowsProcessLauncher() = default;
@@ -81,6 +126,11 @@ namespace gwatch
 	}
 
 	std::optional<std::uint32_t> WindowsProcessLauncher::run_debug_loop(IDebugEventSink& sink)
+	{
+		return drive_debug_loop(*this, sink);
+	}
+
+	bool WindowsProcessLauncher::next_event(DebugEvent& ev)
 	{
 		if (!m_launched)
 		{
@@ -88,9 +138,7 @@ namespace gwatch
 		}
 
 		DEBUG_EVENT de{};
-		std::optional<std::uint32_t> exitCode;
-
-		while (!m_requestStop)
+		while (!m_requestStop && m_running)
 		{
 			#ifdef GWATCH_PROFILE
 			const auto wait_start = std::chrono::high_resolution_clock::now();
@@ -102,17 +150,13 @@ namespace gwatch
 			#ifdef GWATCH_PROFILE
 			const auto wait_end = std::chrono::high_resolution_clock::now();
 			profiling::add_loop_wait_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(wait_end - wait_start).count());
+			m_handleStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(wait_end.time_since_epoch()).count();
 			#endif
 
-			DebugEvent ev{};
+			ev = DebugEvent{};
 			ev.process_id = de.dwProcessId;
 			ev.thread_id = de.dwThreadId;
 
-			auto sinkDecision = ContinueStatus::Default;
-			#ifdef GWATCH_PROFILE
-			const auto handle_start = std::chrono::high_resolution_clock::now();
-			#endif
-
 			switch (de.dwDebugEventCode)
 			{
 			case CREATE_PROCESS_DEBUG_EVENT:
@@ -122,14 +166,13 @@ namespace gwatch
 					CreateProcessInfo cp{};
 					cp.image_base = reinterpret_cast<std::uint64_t>(info.lpBaseOfImage);
 					cp.entry_point = reinterpret_cast<std::uint64_t>(info.lpStartAddress);
-					cp.image_path.clear();
+					// Read once, while the handle is open: the sink only sees the interned id.
+					cp.image_path = m_strings.intern(final_path(info.hFile));
 					ev.payload = cp;
 
 					if (info.hFile)
 						CloseHandle(info.hFile);
-
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
 			case EXIT_PROCESS_DEBUG_EVENT:
 				{
@@ -137,11 +180,8 @@ namespace gwatch
 					ExitProcessInfo xp{};
 					xp.exit_code = de.u.ExitProcess.dwExitCode;
 					ev.payload = xp;
-					sinkDecision = sink.on_event(ev);
-
-					exitCode = xp.exit_code;
-					m_running = false;
-					break;
+					m_exitCode = xp.exit_code;
+					return true;
 				}
 			case CREATE_THREAD_DEBUG_EVENT:
 				{
@@ -149,8 +189,7 @@ namespace gwatch
 					CreateThreadInfo ct{};
 					ct.start_address = reinterpret_cast<std::uint64_t>(de.u.CreateThread.lpStartAddress);
 					ev.payload = ct;
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
 			case EXIT_THREAD_DEBUG_EVENT:
 				{
@@ -158,8 +197,7 @@ namespace gwatch
 					ExitThreadInfo xt{};
 					xt.exit_code = de.u.ExitThread.dwExitCode;
 					ev.payload = xt;
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
 			case EXCEPTION_DEBUG_EVENT:
 				{
@@ -170,32 +208,34 @@ namespace gwatch
 					xi.address = reinterpret_cast<std::uint64_t>(ExceptionRecord.ExceptionAddress);
 					xi.first_chance = (dwFirstChance != 0);
 					ev.payload = xi;
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
             case LOAD_DLL_DEBUG_EVENT:
                 {
-                    ev.type = DebugEventType::LoadDll;
-                    ev.payload = LoadDllInfo{};
-                    // Close file handle if provided to avoid leaks
+                    // Not reported to the sink. Close file handle if provided to avoid leaks
+                    LoadDllInfo ld{};
+                    ld.base = reinterpret_cast<std::uint64_t>(de.u.LoadDll.lpBaseOfDll);
+                    ld.path = m_strings.intern(final_path(de.u.LoadDll.hFile));
                     if (de.u.LoadDll.hFile)
                         CloseHandle(de.u.LoadDll.hFile);
-                    sinkDecision = ContinueStatus::Default;
-                    break;
+                    ev.type = DebugEventType::LoadDll;
+                    ev.payload = ld;
+                    complete_event(ev, ContinueStatus::Default);
+                    continue;
                 }
             case UNLOAD_DLL_DEBUG_EVENT:
                 {
                     ev.type = DebugEventType::UnloadDll;
                     ev.payload = UnloadDllInfo{};
-                    sinkDecision = ContinueStatus::Default;
-                    break;
+                    complete_event(ev, ContinueStatus::Default);
+                    continue;
                 }
             case OUTPUT_DEBUG_STRING_EVENT:
                 {
                     ev.type = DebugEventType::_OutputDebugString;
                     ev.payload = OutputDebugStringInfo{};
-                    sinkDecision = ContinueStatus::Default;
-                    break;
+                    complete_event(ev, ContinueStatus::Default);
+                    continue;
                 }
 			case RIP_EVENT:
 				{
@@ -204,8 +244,7 @@ namespace gwatch
 					ri.error = de.u.RipInfo.dwError;
 					ri.type = de.u.RipInfo.dwType;
 					ev.payload = ri;
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
 			default:
 				{
@@ -215,27 +254,32 @@ namespace gwatch
 					ri.error = 0;
 					ri.type = de.dwDebugEventCode;
 					ev.payload = ri;
-					sinkDecision = sink.on_event(ev);
-					break;
+					return true;
 				}
 			}
+		}
+		return false;
+	}
 
-			const DWORD cont = map_continue_code(sinkDecision, ev);
-			ContinueDebugEvent(de.dwProcessId, de.dwThreadId, cont);
+	void WindowsProcessLauncher::complete_event(const DebugEvent& ev, const ContinueStatus sinkDecision)
+	{
+		const DWORD cont = map_continue_code(sinkDecision, ev);
+		if (sinkDecision == ContinueStatus::SingleStep)
+		{
+			set_trap_flag(ev.thread_id);
+		}
+		ContinueDebugEvent(ev.process_id, ev.thread_id, cont);
 
-			#ifdef GWATCH_PROFILE
-			const auto handle_end = std::chrono::high_resolution_clock::now();
-			profiling::add_loop_handle_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(handle_end - handle_start).count());
-			profiling::inc_loop_iteration();
-			#endif
+		#ifdef GWATCH_PROFILE
+		const auto handle_end = std::chrono::high_resolution_clock::now();
+		profiling::add_loop_handle_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(handle_end.time_since_epoch()).count() - m_handleStartNs);
+		profiling::inc_loop_iteration();
+		#endif
 
-			if (de.dwDebugEventCode == EXIT_PROCESS_DEBUG_EVENT)
-			{
-				break;
-			}
+		if (ev.type == DebugEventType::ExitProcess)
+		{
+			m_running = false;
 		}
-
-		return exitCode;
 	}
 
 	void WindowsProcessLauncher::stop()
@@ -349,7 +393,7 @@ namespace gwatch
 
 	std::uint32_t WindowsProcessLauncher::map_continue_code(const ContinueStatus sinkDecision, const DebugEvent& ev)
 	{
-		if (sinkDecision == ContinueStatus::Continue)
+		if (sinkDecision == ContinueStatus::Continue || sinkDecision == ContinueStatus::SingleStep)
 			return DBG_CONTINUE;
 		if (sinkDecision == ContinueStatus::NotHandled)
 			return DBG_EXCEPTION_NOT_HANDLED;
@@ -1,10 +1,21 @@
 #include "Application.h"
 #include "ArgumentsParser.h"
+#include <cstdio>
 #include <iostream>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
 int main(const int argc, const char* argv[])
 {
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__linux__)
+#ifdef __linux__
+	// Access lines are small: hand them to the kernel in large writes unless someone is
+	// watching a terminal. Must happen before anything is printed.
+	if (!isatty(STDOUT_FILENO))
+		std::setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+#endif
 	try
 	{
 		const gwatch::CliArgs args = gwatch::ArgumentsParser::parse(std::span(argv, argc));
@@ -23,7 +34,7 @@ int main(const int argc, const char* argv[])
 		return 2;
 	}
 #else
-	std::cerr << "This build currently supports Windows only.\n";
+	std::cerr << "This build currently supports Windows and Linux only.\n";
 	return 1;
 #endif
 }
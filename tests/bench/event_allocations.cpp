@@ -0,0 +1,180 @@
+// Heap allocations per debug event on the hot path (Exception stops), through the
+// statically bound loop (drive_debug_loop + concrete sink) and the virtual run_debug_loop.
+// Every operator new is counted; the first events (process/thread setup) are excluded.
+//
+// Usage: gwatch_bench_event_allocations [traps]
+#ifdef __linux__
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "ProcessLauncher.h"
+
+namespace
+{
+	std::atomic<std::uint64_t> g_allocations{0};
+}
+
+// Every replaceable form allocates with std::malloc and releases with std::free, so that no
+// pointer crosses between the replaced and the default allocator. The release stays out of
+// line: once inlined into library code, std::free would sit next to the operator new that
+// allocated the pointer and GCC would flag the pair (-Wmismatched-new-delete).
+namespace
+{
+	void* counted_malloc(const std::size_t size) noexcept
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size ? size : 1);
+	}
+
+	[[gnu::noinline]] void counted_free(void* p) noexcept
+	{
+		std::free(p);
+	}
+}
+
+void* operator new(const std::size_t size)
+{
+	if (void* p = counted_malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size)
+{
+	if (void* p = counted_malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	counted_free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	counted_free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	counted_free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	counted_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	counted_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	counted_free(p);
+}
+
+namespace
+{
+	constexpr int kWarmup = 8;
+
+	// Counts allocations between consecutive Exception events, i.e. one full loop iteration:
+	// wait, translate, dispatch, resume.
+	struct CountingSink final : gwatch::IDebugEventSink
+	{
+		int exceptions = 0;
+		std::uint64_t measured = 0;
+		std::uint64_t allocations = 0;
+		std::uint64_t last = 0;
+
+		gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev) override
+		{
+			if (ev.type != gwatch::DebugEventType::Exception)
+				return gwatch::ContinueStatus::Default;
+
+			const std::uint64_t now = g_allocations.load(std::memory_order_relaxed);
+			if (++exceptions > kWarmup)
+			{
+				allocations += now - last;
+				++measured;
+			}
+			last = now;
+			return gwatch::ContinueStatus::Default;
+		}
+	};
+
+	struct Result
+	{
+		std::uint64_t events = 0;
+		std::uint64_t allocations = 0;
+		double us_per_event = 0;
+	};
+
+	template <bool Static>
+	Result run(const std::string& traps)
+	{
+		gwatch::LinuxProcessLauncher launcher;
+		gwatch::LaunchConfig cfg;
+		cfg.exe_path = "./gwatch_debuggee_traps";
+		cfg.args = {traps};
+		launcher.launch(cfg);
+
+		CountingSink sink;
+		const auto start = std::chrono::steady_clock::now();
+		if constexpr (Static)
+			gwatch::drive_debug_loop(launcher, sink);
+		else
+			launcher.run_debug_loop(sink);
+		const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		return Result{
+			.events = sink.measured,
+			.allocations = sink.allocations,
+			.us_per_event = sink.exceptions > 0 ? elapsed / sink.exceptions : 0,
+		};
+	}
+
+	void report(const char* name, const Result& r)
+	{
+		std::printf("%-8s events=%llu allocations=%llu allocations/event=%.3f time/event=%.2f us\n",
+		            name, static_cast<unsigned long long>(r.events), static_cast<unsigned long long>(r.allocations),
+		            r.events ? static_cast<double>(r.allocations) / static_cast<double>(r.events) : 0.0, r.us_per_event);
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::string traps = argc > 1 ? argv[1] : "2000";
+	try
+	{
+		const Result bound = run<true>(traps);
+		const Result dynamic = run<false>(traps);
+		report("static", bound);
+		report("virtual", dynamic);
+		return bound.events > 0 && bound.allocations == 0 && dynamic.allocations == 0 ? 0 : 1;
+	}
+	catch (const gwatch::ProcessError& e)
+	{
+		std::printf("skipped: %s\n", e.what());
+		return 0;
+	}
+}
+#else
+int main() { return 0; }
+#endif
@@ -0,0 +1,201 @@
+// Slowdown of a read-heavy target under the hybrid engine versus a trap on every access:
+// gwatch_debuggee_reads reads g_reads_config 3 * iterations times and writes it 3 times.
+// "trap rw" arms a read/write breakpoint through ptrace and resumes after every stop, as the
+// breakpoints engine does; "hybrid" only stops on the writes and lets the kernel count reads.
+// Every store of the target changes the value: a logged write "N -> N" was made up by the
+// engine, and so is a write count other than the target's, both of which fail the bench.
+// The hybrid run must stop the target on its writes only and be at least kTargetSpeedup
+// faster. Counting a read still raises a debug exception in the kernel, just no stop: the
+// per-access costs printed bound the speedup (about 7 us against 16 us under KVM, where
+// debug exceptions exit to the hypervisor), so it stays near 2x there rather than 10x.
+//
+// Usage: gwatch_bench_hybrid_reads [iterations]
+#ifdef __linux__
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DebugRegisters.h"
+#include "MemoryWatcher.h"
+#include "ProcessLauncher.h"
+#include "SymbolResolver.h"
+
+namespace
+{
+	constexpr const char* kTarget = "./gwatch_debuggee_reads";
+	constexpr const char* kVariable = "g_reads_config";
+	constexpr std::uint64_t kWrites = 3; // stores of kVariable by the target
+	constexpr double kTargetSpeedup = 1.5;
+
+	enum class Mode { Native, TrapRw, Hybrid };
+
+	void* debugreg(const std::size_t index)
+	{
+		return reinterpret_cast<void*>(offsetof(struct user, u_debugreg) + index * sizeof(long));
+	}
+
+	struct BenchSink final : gwatch::IDebugEventSink
+	{
+		gwatch::LinuxProcessLauncher& launcher;
+		Mode mode;
+		std::uint64_t traps = 0;
+		gwatch::ResolvedSymbol symbol;
+		std::unique_ptr<gwatch::LinuxHybridMemoryWatcher> hybrid;
+
+		BenchSink(gwatch::LinuxProcessLauncher& l, const Mode m) : launcher(l), mode(m) {}
+
+		gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev) override
+		{
+			if (ev.type == gwatch::DebugEventType::_CreateProcess && mode != Mode::Native)
+			{
+				const auto& cp = std::get<gwatch::CreateProcessInfo>(ev.payload);
+				gwatch::ElfSymbolResolver resolver(std::string(launcher.strings().view(cp.image_path)), cp.image_base);
+				symbol = resolver.resolve(kVariable);
+				if (mode == Mode::Hybrid)
+					hybrid = std::make_unique<gwatch::LinuxHybridMemoryWatcher>(launcher.pid(), std::vector{symbol}, gwatch::HybridWatchOptions{.summary_interval_ms = 0});
+			}
+			if (hybrid)
+				return hybrid->on_event(ev);
+			if (mode == Mode::TrapRw && (ev.type == gwatch::DebugEventType::_CreateProcess || ev.type == gwatch::DebugEventType::CreateThread))
+				arm(ev.thread_id);
+			if (mode == Mode::TrapRw && ev.type == gwatch::DebugEventType::Exception && std::get<gwatch::ExceptionInfo>(ev.payload).code == SIGTRAP)
+			{
+				ptrace(PTRACE_POKEUSER, static_cast<pid_t>(ev.thread_id), debugreg(6), nullptr);
+				++traps;
+				return gwatch::ContinueStatus::Continue;
+			}
+			return gwatch::ContinueStatus::Default;
+		}
+
+		void arm(const std::uint32_t tid) const
+		{
+			const gwatch::dr::Slot slot{.address = symbol.address, .size = static_cast<std::uint32_t>(symbol.size), .trigger = gwatch::dr::Trigger::ReadWrite};
+			ptrace(PTRACE_POKEUSER, static_cast<pid_t>(tid), debugreg(0), reinterpret_cast<void*>(slot.address));
+			ptrace(PTRACE_POKEUSER, static_cast<pid_t>(tid), debugreg(7), reinterpret_cast<void*>(gwatch::dr::encode_dr7(0, std::span(&slot, 1))));
+		}
+	};
+
+	// Lines printed on stdout while fn runs (the Logger writes there).
+	template <typename Fn>
+	std::vector<std::string> capture_stdout(Fn&& fn)
+	{
+		std::fflush(stdout);
+		std::FILE* file = std::tmpfile();
+		const int saved = ::dup(STDOUT_FILENO);
+		if (file == nullptr || saved < 0)
+			throw std::runtime_error("cannot redirect stdout");
+		::dup2(::fileno(file), STDOUT_FILENO);
+		fn();
+		std::fflush(stdout);
+		::dup2(saved, STDOUT_FILENO);
+		::close(saved);
+
+		std::vector<std::string> lines;
+		std::rewind(file);
+		char buffer[256];
+		while (std::fgets(buffer, sizeof(buffer), file) != nullptr)
+		{
+			std::string line(buffer);
+			if (!line.empty() && line.back() == '\n')
+				line.pop_back();
+			lines.push_back(std::move(line));
+		}
+		std::fclose(file);
+		return lines;
+	}
+
+	double run_ms(const Mode mode, const std::string& iterations, std::uint64_t& stops, std::vector<std::string>& logged)
+	{
+		gwatch::LinuxProcessLauncher launcher;
+		launcher.launch(gwatch::LaunchConfig{.exe_path = kTarget, .args = {iterations}, .workdir = std::nullopt});
+		BenchSink sink(launcher, mode);
+		const auto start = std::chrono::steady_clock::now();
+		logged = capture_stdout([&] { gwatch::drive_debug_loop(launcher, sink); });
+		const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stops = sink.traps;
+		if (sink.hybrid)
+		{
+			for (const auto& thread : sink.hybrid->counts())
+				stops += thread.writes[0];
+		}
+		return elapsed;
+	}
+
+	// Why the writes the hybrid engine logged are not the target's, empty when they are.
+	std::string check_writes(const std::vector<std::string>& logged)
+	{
+		const std::string prefix = std::string(kVariable) + " write ";
+		std::uint64_t writes = 0;
+		for (const auto& line : logged)
+		{
+			if (line.rfind(prefix, 0) != 0)
+				continue;
+			++writes;
+			const std::size_t arrow = line.find(" -> ", prefix.size());
+			if (arrow == std::string::npos)
+				return "write without values: " + line;
+			if (line.compare(prefix.size(), arrow - prefix.size(), line, arrow + 4) == 0)
+				return "write that changed nothing: " + line;
+		}
+		if (writes != kWrites)
+			return std::to_string(writes) + " writes logged, the target made " + std::to_string(kWrites);
+		return {};
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::string iterations = argc > 1 ? argv[1] : "5000";
+	try
+	{
+		std::uint64_t stops = 0;
+		std::vector<std::string> logged;
+		const double native = run_ms(Mode::Native, iterations, stops, logged);
+		const double trap = run_ms(Mode::TrapRw, iterations, stops, logged);
+		const std::uint64_t trapStops = stops;
+		const double hybrid = run_ms(Mode::Hybrid, iterations, stops, logged);
+		for (const auto& line : logged)
+			std::printf("%s\n", line.c_str());
+		if (const std::string error = check_writes(logged); !error.empty())
+		{
+			std::printf("FAILED: %s\n", error.c_str());
+			return 1;
+		}
+
+		// Every access but the writes is a read the hybrid engine counted without a stop.
+		const double accesses = static_cast<double>(trapStops);
+		std::printf("iterations=%s\n", iterations.c_str());
+		std::printf("native   %9.2f ms\n", native);
+		std::printf("trap rw  %9.2f ms  stops=%llu  slowdown=%.1fx  %.2f us/access\n", trap, static_cast<unsigned long long>(trapStops), trap / native, (trap - native) * 1e3 / accesses);
+		std::printf("hybrid   %9.2f ms  stops=%llu  slowdown=%.1fx  %.2f us/access\n", hybrid, static_cast<unsigned long long>(stops), hybrid / native, (hybrid - native) * 1e3 / accesses);
+		std::printf("hybrid is %.1fx faster than trapping every access\n", trap / hybrid);
+		if (stops != kWrites)
+		{
+			std::printf("FAILED: the hybrid engine stopped the target %llu times, the target made %llu writes\n", static_cast<unsigned long long>(stops), static_cast<unsigned long long>(kWrites));
+			return 1;
+		}
+		if (trap / hybrid < kTargetSpeedup)
+		{
+			std::printf("FAILED: hybrid is %.1fx faster than trapping every access, the target is %.1fx\n", trap / hybrid, kTargetSpeedup);
+			return 1;
+		}
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::printf("skipped: %s\n", e.what());
+		return 0;
+	}
+}
+#else
+int main() { return 0; }
+#endif
@@ -0,0 +1,78 @@
+// Launch-to-first-event latency: fork + PTRACE_TRACEME versus LinuxProcessLauncher (vfork).
+// fork() has to copy the page tables of the debugger, so its cost grows with the parent RSS.
+//
+// Usage: gwatch_bench_launch_latency [rss_mb] [iterations]
+#ifdef __linux__
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ProcessLauncher.h"
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	double fork_exec_ms(const char* path)
+	{
+		const auto start = clock_type::now();
+		const pid_t child = fork();
+		if (child == 0)
+		{
+			ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+			execl(path, path, static_cast<char*>(nullptr));
+			_exit(127);
+		}
+		int status = 0;
+		waitpid(child, &status, 0);
+		const auto end = clock_type::now();
+		kill(child, SIGKILL);
+		waitpid(child, &status, 0);
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	double launcher_ms(const char* path)
+	{
+		gwatch::LinuxProcessLauncher launcher;
+		gwatch::LaunchConfig cfg;
+		cfg.exe_path = path;
+		const auto start = clock_type::now();
+		launcher.launch(cfg);
+		const auto end = clock_type::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::size_t rssMb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+	const int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+	const char* target = "/bin/true";
+
+	// Give the parent a large resident set, as a long-running debugger would have.
+	std::vector<char> ballast(rssMb << 20);
+	std::memset(ballast.data(), 1, ballast.size());
+
+	double forkTotal = 0;
+	double launcherTotal = 0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		forkTotal += fork_exec_ms(target);
+		launcherTotal += launcher_ms(target);
+	}
+
+	std::printf("rss=%zu MB iterations=%d\n", rssMb, iterations);
+	std::printf("fork+exec  first event avg: %.3f ms\n", forkTotal / iterations);
+	std::printf("launcher   first event avg: %.3f ms\n", launcherTotal / iterations);
+	return ballast[0] == 1 ? 0 : 1;
+}
+#else
+int main() { return 0; }
+#endif
@@ -0,0 +1,271 @@
+// Resolution time of an unsized global on a large image: the size then comes from DWARF.
+// A synthetic ELF carries <megabytes> of .debug_info in 1 MiB compile units of base types,
+// with the variable in the last unit and a .debug_names index naming that unit. The same
+// image is resolved again with the index hidden, which leaves walking every unit. Both are
+// timed as Application times them (resolver construction and lookup, reported through
+// profiling::add_symbol_resolve_duration); the indexed one must take under 10 ms.
+//
+// Usage: gwatch_bench_symbol_resolve [megabytes]
+#ifdef __linux__
+#include <elf.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Profiling.h"
+#include "SymbolResolver.h"
+
+namespace
+{
+	constexpr const char* kVariable = "g_target";
+	constexpr std::uint64_t kAddress = 0x404000;
+	constexpr std::size_t kUnitBytes = 1u << 20;
+	constexpr double kTargetMs = 10.0;
+
+	using Bytes = std::vector<std::uint8_t>;
+
+	template <typename T>
+	void put(Bytes& out, const T value)
+	{
+		const auto* p = reinterpret_cast<const std::uint8_t*>(&value);
+		out.insert(out.end(), p, p + sizeof(T));
+	}
+
+	void uleb(Bytes& out, std::uint64_t value)
+	{
+		do
+		{
+			std::uint8_t byte = value & 0x7f;
+			value >>= 7;
+			out.push_back(value != 0 ? byte | 0x80 : byte);
+		} while (value != 0);
+	}
+
+	template <typename T>
+	void patch(Bytes& out, const std::size_t offset, const T value)
+	{
+		std::memcpy(out.data() + offset, &value, sizeof(T));
+	}
+
+	// DWARF 5 compile unit header; returns where the unit starts, its length is patched by end_unit.
+	std::size_t begin_unit(Bytes& info)
+	{
+		const std::size_t start = info.size();
+		put<std::uint32_t>(info, 0);
+		put<std::uint16_t>(info, 5);
+		info.push_back(0x01); // DW_UT_compile
+		info.push_back(8);    // address size
+		put<std::uint32_t>(info, 0);
+		info.push_back(1);    // DW_TAG_compile_unit, with children
+		return start;
+	}
+
+	void end_unit(Bytes& info, const std::size_t start)
+	{
+		info.push_back(0);
+		patch<std::uint32_t>(info, start, static_cast<std::uint32_t>(info.size() - start - 4));
+	}
+
+	struct Image
+	{
+		Bytes bytes;
+		std::size_t namesName = 0; // file offset of ".debug_names" in .shstrtab
+	};
+
+	Image build_image(const std::size_t megabytes)
+	{
+		// 1: compile_unit (children); 2: base_type (byte_size data1); 3: variable (location exprloc, type ref4).
+		const Bytes abbrev = {1, 0x11, 1, 0, 0, 2, 0x24, 0, 0x0b, 0x0b, 0, 0, 3, 0x34, 0, 0x02, 0x18, 0x49, 0x13, 0, 0, 0};
+
+		Bytes info;
+		info.reserve(megabytes * kUnitBytes + 64);
+		std::vector<std::uint32_t> units;
+		for (std::size_t u = 0; u < megabytes; ++u)
+		{
+			units.push_back(static_cast<std::uint32_t>(info.size()));
+			const std::size_t start = begin_unit(info);
+			while (info.size() - start < kUnitBytes - 3)
+			{
+				info.push_back(2);
+				info.push_back(static_cast<std::uint8_t>(1u << (info.size() % 4)));
+			}
+			end_unit(info, start);
+		}
+		units.push_back(static_cast<std::uint32_t>(info.size()));
+		const std::size_t start = begin_unit(info);
+		const auto type = static_cast<std::uint32_t>(info.size() - start);
+		info.insert(info.end(), {2, 8});
+		const auto die = static_cast<std::uint32_t>(info.size() - start);
+		info.insert(info.end(), {3, 9, 0x03}); // DW_OP_addr
+		put<std::uint64_t>(info, kAddress);
+		put<std::uint32_t>(info, type);
+		end_unit(info, start);
+
+		const std::string_view name = kVariable;
+		Bytes str(name.begin(), name.end());
+		str.push_back(0);
+
+		// .debug_names: every unit listed, one bucket, one name whose entry gives its unit.
+		std::uint32_t hash = 5381;
+		for (const char c : name)
+			hash = hash * 33 + static_cast<std::uint8_t>(c);
+		const Bytes nameAbbrev = {1, 0x34, 1, 0x0f, 3, 0x13, 0, 0, 0}; // DW_IDX_compile_unit udata, DW_IDX_die_offset ref4
+		Bytes names;
+		put<std::uint32_t>(names, 0);
+		put<std::uint16_t>(names, 5);
+		put<std::uint16_t>(names, 0);
+		put<std::uint32_t>(names, static_cast<std::uint32_t>(units.size()));
+		put<std::uint32_t>(names, 0);
+		put<std::uint32_t>(names, 0);
+		put<std::uint32_t>(names, 1); // buckets
+		put<std::uint32_t>(names, 1); // names
+		put<std::uint32_t>(names, static_cast<std::uint32_t>(nameAbbrev.size()));
+		put<std::uint32_t>(names, 0);
+		for (const std::uint32_t unit : units)
+			put<std::uint32_t>(names, unit);
+		put<std::uint32_t>(names, 1);
+		put<std::uint32_t>(names, hash);
+		put<std::uint32_t>(names, 0); // string offset
+		put<std::uint32_t>(names, 0); // entry offset
+		names.insert(names.end(), nameAbbrev.begin(), nameAbbrev.end());
+		names.push_back(1);
+		uleb(names, units.size() - 1);
+		put<std::uint32_t>(names, die);
+		names.push_back(0);
+		patch<std::uint32_t>(names, 0, static_cast<std::uint32_t>(names.size() - 4));
+
+		const std::string_view strtab("\0g_target\0", 10);
+		const std::string_view shstrtab("\0.shstrtab\0.symtab\0.strtab\0.debug_info\0.debug_abbrev\0.debug_names\0.debug_str\0", 77);
+		Bytes symtab(sizeof(Elf64_Sym), 0);
+		Elf64_Sym sym{};
+		sym.st_name = 1;
+		sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+		sym.st_shndx = SHN_ABS;
+		sym.st_value = kAddress;
+		put(symtab, sym);
+
+		Image image;
+		Bytes& out = image.bytes;
+		out.resize(sizeof(Elf64_Ehdr));
+		struct Section
+		{
+			std::uint32_t name;
+			std::uint32_t type;
+			Bytes data;
+			std::uint32_t link = 0;
+			std::uint64_t entsize = 0;
+		};
+		std::vector<Section> sections;
+		sections.push_back({.name = 1, .type = SHT_STRTAB, .data = Bytes(shstrtab.begin(), shstrtab.end())});
+		sections.push_back({.name = 11, .type = SHT_SYMTAB, .data = std::move(symtab), .link = 3, .entsize = sizeof(Elf64_Sym)});
+		sections.push_back({.name = 19, .type = SHT_STRTAB, .data = Bytes(strtab.begin(), strtab.end())});
+		sections.push_back({.name = 27, .type = SHT_PROGBITS, .data = std::move(info)});
+		sections.push_back({.name = 39, .type = SHT_PROGBITS, .data = abbrev});
+		sections.push_back({.name = 53, .type = SHT_PROGBITS, .data = std::move(names)});
+		sections.push_back({.name = 66, .type = SHT_PROGBITS, .data = std::move(str)});
+
+		std::vector<Elf64_Shdr> headers(1);
+		for (auto& section : sections)
+		{
+			Elf64_Shdr sh{};
+			sh.sh_name = section.name;
+			sh.sh_type = section.type;
+			sh.sh_offset = out.size();
+			sh.sh_size = section.data.size();
+			sh.sh_link = section.link;
+			sh.sh_entsize = section.entsize;
+			headers.push_back(sh);
+			out.insert(out.end(), section.data.begin(), section.data.end());
+			section.data = {};
+		}
+		image.namesName = headers[1].sh_offset + 53;
+
+		Elf64_Ehdr ehdr{};
+		std::memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+		ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+		ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+		ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+		ehdr.e_type = ET_EXEC;
+		ehdr.e_machine = EM_X86_64;
+		ehdr.e_version = EV_CURRENT;
+		ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+		ehdr.e_shoff = out.size();
+		ehdr.e_shentsize = sizeof(Elf64_Shdr);
+		ehdr.e_shnum = static_cast<std::uint16_t>(headers.size());
+		ehdr.e_shstrndx = 1;
+		std::memcpy(out.data(), &ehdr, sizeof(ehdr));
+		for (const auto& sh : headers)
+			put(out, sh);
+		return image;
+	}
+
+	// Resolver construction and lookup, timed as Application times them; size 0 on failure.
+	double resolve_ms(const std::filesystem::path& path, std::uint64_t& size)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		gwatch::ElfSymbolResolver resolver(path.string());
+		size = resolver.resolve(kVariable).size;
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		gwatch::profiling::add_symbol_resolve_duration(static_cast<std::uint64_t>(elapsed));
+		return static_cast<double>(elapsed) / 1e6;
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+	const auto path = std::filesystem::temp_directory_path() / "gwatch_bench_symbol_resolve.elf";
+	try
+	{
+		const Image image = build_image(megabytes);
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(image.bytes.data()), static_cast<std::streamsize>(image.bytes.size()));
+		}
+
+		std::uint64_t indexedSize = 0;
+		const double indexed = resolve_ms(path, indexedSize);
+		{
+			// ".debug_names" -> ".debug_nameX": the same image without its index.
+			std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+			file.seekp(static_cast<std::streamoff>(image.namesName + 11));
+			file.put('X');
+		}
+		std::uint64_t scannedSize = 0;
+		const double scanned = resolve_ms(path, scannedSize);
+		std::filesystem::remove(path);
+
+		std::printf("debug_info=%zu MiB units=%zu\n", megabytes, megabytes + 1);
+		std::printf("indexed  %9.3f ms  size=%llu\n", indexed, static_cast<unsigned long long>(indexedSize));
+		std::printf("scanned  %9.3f ms  size=%llu\n", scanned, static_cast<unsigned long long>(scannedSize));
+		if (indexedSize != 8 || scannedSize != 8)
+		{
+			std::printf("FAILED: the size must come from the DWARF type (8 bytes)\n");
+			return 1;
+		}
+		if (indexed >= kTargetMs)
+		{
+			std::printf("FAILED: an indexed lookup took %.3f ms, the target is under %.0f ms\n", indexed, kTargetMs);
+			return 1;
+		}
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::filesystem::remove(path);
+		std::printf("FAILED: %s\n", e.what());
+		return 1;
+	}
+}
+#else
+int main() { return 0; }
+#endif
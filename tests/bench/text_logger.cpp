@@ -0,0 +1,121 @@
+// Cost of the synchronous text Logger per access versus the printf formatting it replaced,
+// on synthetic reads and writes of a few variables with values of every length. Timed runs
+// write to the null device; a shorter run of both into files must be byte-identical.
+//
+// Usage: gwatch_bench_text_logger [events]
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include "Logger.h"
+
+namespace
+{
+#ifdef _WIN32
+	constexpr const char* kNullDevice = "NUL";
+#else
+	constexpr const char* kNullDevice = "/dev/null";
+#endif
+	constexpr std::uint64_t kCompared = 200'000;
+	constexpr std::string_view kSymbols[] = {"g_counter", "g_flag", "g_reads_config", "state"};
+
+	struct Event
+	{
+		std::string_view symbol;
+		bool write = false;
+		std::uint64_t old_value = 0;
+		std::uint64_t new_value = 0;
+	};
+
+	// xorshift64; the value is cut to a random number of bits so every digit count shows up.
+	struct Events
+	{
+		std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+		Event next()
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			const std::uint64_t bits = state & 63;
+			const std::uint64_t value = (state >> 6) >> (63 - bits);
+			return Event{
+				.symbol = kSymbols[(state >> 8) % std::size(kSymbols)],
+				.write = (state & 0x300) == 0,
+				.old_value = value / 3,
+				.new_value = value,
+			};
+		}
+	};
+
+	void log_printf(const Event& e)
+	{
+		if (e.write)
+			std::printf("%.*s write %" PRIu64 " -> %" PRIu64 "\n", static_cast<int>(e.symbol.size()), e.symbol.data(), e.old_value, e.new_value);
+		else
+			std::printf("%.*s read %" PRIu64 "\n", static_cast<int>(e.symbol.size()), e.symbol.data(), e.new_value);
+	}
+
+	void log_logger(const Event& e)
+	{
+		if (e.write)
+			gwatch::Logger::log_write(e.symbol, e.old_value, e.new_value);
+		else
+			gwatch::Logger::log_read(e.symbol, e.new_value);
+	}
+
+	// Sends stdout to path with the buffer main() gives it, runs the events, returns the seconds.
+	template <typename Log>
+	double run(const char* path, const std::uint64_t count, Log log)
+	{
+		std::fflush(stdout);
+		if (std::freopen(path, "wb", stdout) == nullptr)
+			return -1;
+		std::setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+
+		Events events;
+		const auto start = std::chrono::steady_clock::now();
+		for (std::uint64_t i = 0; i < count; ++i)
+			log(events.next());
+		std::fflush(stdout);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string read_file(const std::filesystem::path& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	}
+
+	void report(const char* name, const std::uint64_t count, const double seconds)
+	{
+		std::fprintf(stderr, "%-7s events=%" PRIu64 " time=%.0f ms time/event=%.1f ns\n", name, count, seconds * 1e3, seconds * 1e9 / static_cast<double>(count));
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::uint64_t count = argc > 1 ? std::stoull(argv[1]) : 10'000'000;
+
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto expected = dir / "gwatch_bench_text_printf.txt";
+	const auto actual = dir / "gwatch_bench_text_logger.txt";
+	run(expected.string().c_str(), kCompared, log_printf);
+	run(actual.string().c_str(), kCompared, log_logger);
+	const bool identical = read_file(expected) == read_file(actual);
+	std::filesystem::remove(expected);
+	std::filesystem::remove(actual);
+
+	const double printfSeconds = run(kNullDevice, count, log_printf);
+	const double loggerSeconds = run(kNullDevice, count, log_logger);
+	report("printf", count, printfSeconds);
+	report("logger", count, loggerSeconds);
+	std::fprintf(stderr, "speedup=%.2fx output=%s\n", printfSeconds / loggerSeconds, identical ? "identical" : "DIFFERENT");
+	return identical && printfSeconds >= 0 && loggerSeconds >= 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Throughput of the trace file storage backends on binary-encoded events, appended one
+// record at a time the way the Logger does, then in 64 KiB blocks of the same bytes. The
+// mmap backend is timed first, then the io_uring one (buffered, then O_DIRECT when the file
+// system takes it). Times include the final flush and truncation. A shorter run through each
+// must produce identical segments. Records average 11 bytes, so the per-record rate is the
+// cost of the append calls (the same with a backend that drops the bytes) rather than of
+// the storage: Release builds require the io_uring backend to take blocks at 1 GB/s or more.
+//
+// Usage: gwatch_bench_trace_io [MiB] [directory]
+#ifdef __linux__
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TraceFile.h"
+#include "TraceFormat.h"
+#include "UringTraceFile.h"
+
+namespace
+{
+	constexpr std::uint64_t kCompared = 8ull << 20;
+	constexpr std::uint64_t kSegment = 256ull << 20;
+	constexpr std::size_t kBlock = 64 * 1024;
+	constexpr double kTargetGBps = 1.0;
+
+	// A few million encoded records, cycled through.
+	struct Records
+	{
+		std::vector<char> bytes;
+		std::vector<std::uint32_t> ends;
+	};
+
+	Records encode_records()
+	{
+		const gwatch::trace::SymbolView symbols[] = {{"g_counter", 8}, {"g_flag", 4}, {"g_reads_config", 8}, {"state", 8}};
+		gwatch::trace::Encoder encoder;
+		Records records;
+		std::uint64_t state = 0x9E3779B97F4A7C15ull;
+		std::uint64_t time = 1'000'000;
+		for (int i = 0; i < 2'000'000; ++i)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			time += 50 + (state & 1023);
+			const std::uint64_t value = (state >> 6) >> (63 - (state & 63));
+			const gwatch::LogRecord record{
+				.timestamp_ns = time,
+				.old_value = value / 3,
+				.new_value = value,
+				.tid = 100 + static_cast<std::uint32_t>((state >> 20) & 3),
+				.symbol = static_cast<std::uint32_t>((state >> 8) & 3),
+				.kind = (state & 0x300) == 0 ? gwatch::AccessKind::Write : gwatch::AccessKind::Read,
+			};
+			encoder.encode(record, symbols, records.bytes);
+			records.ends.push_back(static_cast<std::uint32_t>(records.bytes.size()));
+		}
+		return records;
+	}
+
+	// Appends records until bytes were written; returns the seconds, storage closed included.
+	double run(std::unique_ptr<gwatch::ITraceStorage> storage, const Records& records, const std::uint64_t bytes)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::uint64_t written = 0;
+		std::uint32_t begin = 0;
+		for (std::size_t i = 0; written < bytes; i = (i + 1) % records.ends.size())
+		{
+			const std::uint32_t end = records.ends[i];
+			const std::size_t size = end - begin;
+			if (!storage->has_room(size))
+				storage->rotate();
+			storage->append(records.bytes.data() + begin, size);
+			written += size;
+			begin = end % static_cast<std::uint32_t>(records.bytes.size());
+		}
+		storage.reset();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Appends the records' bytes in kBlock pieces until bytes were written; seconds as run().
+	double run_blocks(std::unique_ptr<gwatch::ITraceStorage> storage, const Records& records, const std::uint64_t bytes)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::size_t span = records.bytes.size() - kBlock;
+		for (std::uint64_t written = 0; written < bytes; written += kBlock)
+		{
+			if (!storage->has_room(kBlock))
+				storage->rotate();
+			storage->append(records.bytes.data() + written % span, kBlock);
+		}
+		storage.reset();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string read_file(const std::filesystem::path& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	}
+
+	// Prints the throughput and returns it in GB/s.
+	double report(const char* name, const std::uint64_t bytes, const double seconds)
+	{
+		const double gbps = static_cast<double>(bytes) / seconds / 1e9;
+		std::fprintf(stderr, "%-20s bytes=%llu time=%.0f ms throughput=%.2f GB/s\n", name, static_cast<unsigned long long>(bytes), seconds * 1e3, gbps);
+		return gbps;
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::uint64_t bytes = (argc > 1 ? std::stoull(argv[1]) : 512) << 20;
+	const std::filesystem::path dir = argc > 2 ? std::filesystem::path(argv[2]) : std::filesystem::temp_directory_path();
+	const std::string base = (dir / ("gwatch_bench_trace_io_" + std::to_string(getpid()))).string();
+	const Records records = encode_records();
+	std::fprintf(stderr, "records=%zu bytes/record=%.1f\n", records.ends.size(), static_cast<double>(records.bytes.size()) / static_cast<double>(records.ends.size()));
+
+	const auto options = [&](const char* name, const gwatch::TraceBackend backend, const bool direct, const std::uint64_t segment)
+	{
+		return gwatch::TraceFileOptions{.path = base + name, .segmentBytes = segment, .keep = 2, .backend = backend, .direct = direct};
+	};
+	const auto cleanup = [&](const char* name)
+	{
+		for (int i = 0; i < 64; ++i)
+			std::filesystem::remove(base + name + "." + std::to_string(i));
+	};
+
+	// The mmap segment is the reference.
+	run(std::make_unique<gwatch::TraceFile>(options(".mmap", gwatch::TraceBackend::Mmap, false, kCompared)), records, kCompared);
+	const std::string expected = read_file(base + ".mmap.0");
+	cleanup(".mmap");
+	bool identical = expected.size() > 0;
+
+	const double mmapSeconds = run(std::make_unique<gwatch::TraceFile>(options(".mmap", gwatch::TraceBackend::Mmap, false, kSegment)), records, bytes);
+	cleanup(".mmap");
+	report("mmap", bytes, mmapSeconds);
+	report("mmap blocks", bytes, run_blocks(std::make_unique<gwatch::TraceFile>(options(".mmap", gwatch::TraceBackend::Mmap, false, kSegment)), records, bytes));
+	cleanup(".mmap");
+
+	double uringBlocks = 0;
+
+	for (const bool direct : {false, true})
+	{
+		const char* name = direct ? "uring direct" : "uring";
+		const char* blocksName = direct ? "uring direct blocks" : "uring blocks";
+		try
+		{
+			run(std::make_unique<gwatch::UringTraceFile>(options(".uring", gwatch::TraceBackend::Uring, direct, kCompared)), records, kCompared);
+			identical = identical && read_file(base + ".uring.0") == expected;
+			cleanup(".uring");
+			const double seconds = run(std::make_unique<gwatch::UringTraceFile>(options(".uring", gwatch::TraceBackend::Uring, direct, kSegment)), records, bytes);
+			cleanup(".uring");
+			report(name, bytes, seconds);
+			const double blocks = run_blocks(std::make_unique<gwatch::UringTraceFile>(options(".uring", gwatch::TraceBackend::Uring, direct, kSegment)), records, bytes);
+			cleanup(".uring");
+			uringBlocks = std::max(uringBlocks, report(blocksName, bytes, blocks));
+		}
+		catch (const std::exception& e)
+		{
+			// No io_uring (seccomp, old kernel) or no O_DIRECT on this file system.
+			cleanup(".uring");
+			std::fprintf(stderr, "%-13s skipped: %s\n", name, e.what());
+		}
+	}
+
+	std::fprintf(stderr, "output=%s\n", identical ? "identical" : "DIFFERENT");
+	if (!identical)
+		return 1;
+#ifdef NDEBUG
+	// Skipped io_uring (both modes) is not a failure: there is nothing to measure.
+	if (uringBlocks > 0 && uringBlocks < kTargetGBps)
+	{
+		std::fprintf(stderr, "FAILED: io_uring took blocks at %.2f GB/s, the target is %.1f GB/s\n", uringBlocks, kTargetGBps);
+		return 1;
+	}
+#endif
+	return 0;
+}
+#else
+int main() { return 0; }
+#endif
@@ -0,0 +1,24 @@
+#include <cstdint>
+#include <thread>
+
+// Globals for the soft-dirty engine: a counter and flags sharing a page, changed one at a time
+// with pauses longer than the scan interval, and a large table that is never written.
+extern "C"
+{
+	alignas(4096) volatile std::uint64_t g_dirty_counter = 0;
+	volatile std::uint32_t g_dirty_flags[4] = {};
+	alignas(4096) volatile std::uint64_t g_dirty_table[4096] = {};
+}
+
+int main()
+{
+	const auto pause = [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); };
+	pause();
+	g_dirty_counter = 1;
+	pause();
+	g_dirty_counter = 2;
+	pause();
+	g_dirty_flags[2] = 5;
+	pause();
+	return static_cast<int>(g_dirty_counter + g_dirty_flags[2] + g_dirty_table[7]); // 2 + 5 + 0
+}
@@ -0,0 +1,30 @@
+#include <cstdint>
+
+// Objects for the page-protection engine: a ring buffer and a table of structs, with an
+// unrelated counter written on the ring's page.
+extern "C"
+{
+	struct GWatchTest_Entry
+	{
+		std::uint32_t key;
+		std::uint32_t value;
+		std::uint64_t stamp;
+	};
+
+	alignas(4096) volatile std::uint32_t g_ring[256] = {};
+	volatile std::uint64_t g_noise = 0;
+	volatile GWatchTest_Entry g_table[4] = {};
+}
+
+int main()
+{
+	for (std::uint32_t i = 0; i < 8; ++i)
+	{
+		g_ring[i * 3] = i + 1;
+		g_noise = g_noise + 1;
+	}
+	g_table[2].value = 7;
+	g_table[1].stamp = 9;
+	reinterpret_cast<volatile std::uint8_t*>(&g_table[3].stamp)[1] = 1;
+	return static_cast<int>(g_ring[21] + g_noise + g_table[2].value); // 8 + 8 + 7
+}
@@ -0,0 +1,28 @@
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Variables for the polling engine: one changed slowly enough for every value to be read, one
+// that shows its step slowly and is then incremented in a tight loop, so most values are missed.
+extern "C"
+{
+	volatile std::uint64_t g_poll_slow = 0;
+	volatile std::uint32_t g_poll_fast = 0;
+}
+
+int main()
+{
+	for (std::uint64_t i = 1; i <= 5; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(15));
+		g_poll_slow = i;
+	}
+	for (std::uint32_t i = 0; i < 2; ++i)
+	{
+		g_poll_fast = g_poll_fast + 1;
+		std::this_thread::sleep_for(std::chrono::milliseconds(15));
+	}
+	for (std::uint32_t i = 2; i < 1'000'000; ++i)
+		g_poll_fast = g_poll_fast + 1;
+	return static_cast<int>(g_poll_slow + (g_poll_fast == 1'000'000 ? 0 : 100)); // 5
+}
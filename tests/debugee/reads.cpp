@@ -0,0 +1,44 @@
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+
+// Read-heavy variables for the hybrid engine: a setting read on every iteration by two threads
+// and written three times, each time with a new value, and a counter written a few times and
+// read once per write.
+//
+// Usage: gwatch_debuggee_reads [iterations]
+extern "C"
+{
+	volatile std::uint64_t g_reads_config = 3;
+	volatile std::uint32_t g_reads_hits = 0;
+}
+
+namespace
+{
+	std::uint64_t read_config(const std::uint64_t iterations)
+	{
+		std::uint64_t sum = 0;
+		for (std::uint64_t i = 0; i < iterations; ++i)
+			sum += g_reads_config;
+		return sum;
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000;
+
+	std::uint64_t other = 0;
+	std::thread reader([&] { other = read_config(iterations); });
+	reader.join();
+
+	std::uint64_t sum = read_config(2 * iterations);
+	g_reads_config = 4;
+	g_reads_config = 5;
+	for (int i = 0; i < 3; ++i)
+		g_reads_hits = g_reads_hits + 1;
+	g_reads_config = 6;
+
+	const bool ok = sum == 6 * iterations && other == 3 * iterations;
+	return static_cast<int>(g_reads_hits + (ok ? 0 : 100)); // 3
+}
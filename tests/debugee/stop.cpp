@@ -0,0 +1,11 @@
+#include <chrono>
+#include <csignal>
+
+// Stops itself: exits with 0 only if it stayed stopped until someone sent SIGCONT.
+int main()
+{
+	const auto before = std::chrono::steady_clock::now();
+	std::raise(SIGSTOP);
+	const auto stopped = std::chrono::steady_clock::now() - before;
+	return stopped >= std::chrono::milliseconds(50) ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include <cstdint>
+
+// GCC emits top-level asm ahead of reordered variables, and GAS then copies the target's st_size onto
+// an alias set before it; pinning the aliased variable keeps the alias below truly unsized at any -O.
+#if defined(__GNUC__) && !defined(__clang__)
+#define GWATCH_TEST_NO_REORDER [[gnu::no_reorder]]
+#else
+#define GWATCH_TEST_NO_REORDER
+#endif
+
+// Globals consumed by the ELF resolver tests (the debuggees are built with debug info).
+extern "C"
+{
+	GWATCH_TEST_NO_REORDER volatile std::int64_t GWatchTest_Global64 = 42;
+	volatile std::int32_t GWatchTest_Global32 = -7;
+	volatile char GWatchTest_Small = 1;
+
+	struct GWatchTest_Big16
+	{
+		std::uint64_t a;
+		std::uint64_t b;
+	};
+
+	volatile GWatchTest_Big16 GWatchTest_Big = {1u, 2u};
+	volatile std::uint32_t GWatchTest_Array[16] = {};
+}
+
+namespace GWatchCppNS
+{
+	volatile long long CppGlobal = 77;
+}
+
+#if defined(__GNUC__) && defined(__ELF__)
+// Alias without an st_size: its size can only come from the DWARF type of GWatchTest_Global64.
+asm(".globl GWatchTest_Unsized\n"
+	".type GWatchTest_Unsized, @object\n"
+	".set GWatchTest_Unsized, GWatchTest_Global64\n"
+	".size GWatchTest_Unsized, 0");
+// Local alias that sorts first by name: objects_in() must still name the global GWatchTest_Global32.
+asm(".set GWatchTest_AliasLocal, GWatchTest_Global32\n"
+	".type GWatchTest_AliasLocal, @object\n"
+	".size GWatchTest_AliasLocal, 4");
+#endif
+
+int main()
+{
+	GWatchTest_Global32 = GWatchTest_Global32 + 1;
+	GWatchTest_Global64 = GWatchTest_Global64 + GWatchTest_Global32;
+	GWatchTest_Small = static_cast<char>(GWatchTest_Small + 1);
+	GWatchCppNS::CppGlobal = GWatchCppNS::CppGlobal + 1;
+	GWatchTest_Array[3] = 5;
+	return static_cast<int>(GWatchTest_Big.a + GWatchTest_Big.b);
+}
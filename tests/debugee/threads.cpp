@@ -0,0 +1,29 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+std::int64_t g_counter = 0;
+
+namespace
+{
+	constexpr int kThreads = 2;
+	constexpr int kIterations = 4;
+}
+
+// Spawns worker threads one after the other so every access to g_counter is sequential.
+int main()
+{
+	for (int t = 0; t < kThreads; ++t)
+	{
+		std::thread worker([]
+		{
+			for (int i = 0; i < kIterations; ++i)
+			{
+				const auto v = g_counter;
+				g_counter = v + 1;
+			}
+		});
+		worker.join();
+	}
+	return 42;
+}
@@ -0,0 +1,22 @@
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <csignal>
+#endif
+
+// Raises a breakpoint trap N times (default 1000): each one is an Exception debug event.
+int main(const int argc, char* argv[])
+{
+	const int traps = argc > 1 ? std::atoi(argv[1]) : 1000;
+	for (int i = 0; i < traps; ++i)
+	{
+#ifdef _WIN32
+		DebugBreak();
+#else
+		std::raise(SIGTRAP);
+#endif
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <signal.h>
+#endif
+
+#include "AccessStats.h"
+
+using gwatch::AccessKind;
+using gwatch::AccessStats;
+
+namespace
+{
+	bool contains(const std::string& text, const std::string& line)
+	{
+		return text.find(line) != std::string::npos;
+	}
+}
+
+TEST(AccessStatsTest, CountsPerVariableAndThread)
+{
+	AccessStats stats;
+	stats.record(0, "a", AccessKind::Write, 1, 10, 1'000);
+	stats.record(0, "a", AccessKind::Read, 1, 10, 1'005);
+	stats.record(0, "a", AccessKind::Write, 2, 11, 1'105);
+	stats.record(1, "b", AccessKind::Read, 9, 10, 2'000);
+
+	EXPECT_EQ(stats.accesses(), 4u);
+	const std::string report = stats.report();
+	EXPECT_TRUE(contains(report, "accesses=4 variables=2\n"));
+	EXPECT_TRUE(contains(report, "stats: a reads=1 writes=2\n"));
+	EXPECT_TRUE(contains(report, "stats: a tid=10 reads=1 writes=1\n"));
+	EXPECT_TRUE(contains(report, "stats: a tid=11 reads=0 writes=1\n"));
+	EXPECT_TRUE(contains(report, "stats: a intervals >=4ns:1 >=64ns:1\n"));
+	EXPECT_TRUE(contains(report, "stats: a distinct~2\n"));
+	EXPECT_TRUE(contains(report, "stats: a top 1=2 2=1\n"));
+	EXPECT_TRUE(contains(report, "stats: a quantiles p0=1 "));
+	EXPECT_TRUE(contains(report, "stats: b reads=1 writes=0\n"));
+	EXPECT_TRUE(contains(report, "stats: b quantiles p0=9 p50=9 p90=9 p99=9 p100=9\n"));
+	// A single access has no interval.
+	EXPECT_FALSE(contains(report, "stats: b intervals"));
+}
+
+TEST(AccessStatsTest, ThreadsBeyondTheLimitAreMerged)
+{
+	AccessStats stats;
+	for (std::uint32_t tid = 1; tid <= AccessStats::kMaxThreads + 3; ++tid)
+		stats.record(0, "v", AccessKind::Read, 0, tid, tid);
+
+	const std::string report = stats.report();
+	EXPECT_TRUE(contains(report, "stats: v tid=64 reads=1 writes=0\n"));
+	EXPECT_FALSE(contains(report, "stats: v tid=65 "));
+	EXPECT_TRUE(contains(report, "stats: v tid=other reads=3 writes=0\n"));
+}
+
+TEST(AccessStatsTest, VariablesBeyondTheLimitAreMerged)
+{
+	AccessStats stats;
+	const auto count = static_cast<std::uint32_t>(AccessStats::kMaxVariables + 2);
+	for (std::uint32_t id = 0; id < count; ++id)
+		stats.record(id, "v" + std::to_string(id), AccessKind::Write, id, 1, 1);
+
+	const std::string report = stats.report();
+	EXPECT_TRUE(contains(report, "variables=257\n"));
+	EXPECT_TRUE(contains(report, "stats: v255 reads=0 writes=1\n"));
+	EXPECT_FALSE(contains(report, "stats: v256 "));
+	EXPECT_TRUE(contains(report, "stats: <other> reads=0 writes=2\n"));
+}
+
+TEST(AccessStatsTest, LoggerRoutesAccessesToTheStats)
+{
+	AccessStats stats;
+	testing::internal::CaptureStdout();
+	gwatch::Logger::set_stats(&stats);
+	gwatch::Logger::log_read("x", 3);
+	gwatch::Logger::log_write("x", 3, 4);
+	gwatch::Logger::set_stats(nullptr);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(out, "");
+	EXPECT_EQ(stats.accesses(), 2u);
+	EXPECT_TRUE(contains(stats.report(), "stats: x reads=1 writes=1\n"));
+}
+
+#ifdef __linux__
+
+TEST(AccessStatsLinuxTest, DumpsOnSigusr1)
+{
+	AccessStats stats;
+	stats.record(0, "a", AccessKind::Write, 5, 1, 1);
+
+	testing::internal::CaptureStdout();
+	{
+		gwatch::StatsSignalDumper dumper(stats);
+		raise(SIGUSR1);
+		for (int i = 0; i < 200 && dumper.dumps() == 0; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		EXPECT_EQ(dumper.dumps(), 1u);
+	}
+	const std::string out = testing::internal::GetCapturedStdout();
+	EXPECT_TRUE(contains(out, "stats: a reads=0 writes=1\n"));
+
+	// The previous disposition is back once the dumper is gone.
+	struct sigaction current{};
+	sigaction(SIGUSR1, nullptr, &current);
+	EXPECT_EQ(current.sa_handler, SIG_DFL);
+}
+
+#endif
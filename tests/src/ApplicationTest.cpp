@@ -1,9 +1,13 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include "Application.h"
+#include "Logger.h"
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -13,6 +17,10 @@
 #include <Windows.h>
 #endif
 
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
 using namespace gwatch;
 
 #ifdef _WIN32
@@ -38,7 +46,7 @@ TEST(ApplicationTest, Execute_HappyPath_ReturnsExitCode_And_ProducesLogs)
 	testing::internal::CaptureStdout();
 
 	CliArgs args;
-	args.symbol = "g_counter";
+	args.symbols = {"g_counter"};
 	args.execPath = exe.string();
 	args.targetArgs.clear();
 
@@ -76,7 +84,7 @@ TEST(ApplicationTest, Execute_HappyPath_ReturnsExitCode_And_ProducesLogs)
 TEST(ApplicationTest, Execute_MissingExecutable_Returns1)
 {
 	CliArgs args;
-	args.symbol = "g_counter";
+	args.symbols = {"g_counter"};
 	args.execPath = R"(C:\definitely\not\there\nope.exe)";
 	args.targetArgs.clear();
 
@@ -93,7 +101,327 @@ TEST(ApplicationTest, Execute_BadSymbol_Returns1)
 	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
 
 	CliArgs args;
-	args.symbol = "ThisSymbolDoesNotExist_12345";
+	args.symbols = {"ThisSymbolDoesNotExist_12345"};
+	args.execPath = exe.string();
+
+	Application app(args);
+	testing::internal::CaptureStderr();
+	const int rc = app.execute();
+	testing::internal::GetCapturedStderr();
+	EXPECT_EQ(rc, 1);
+}
+
+#elif defined(__linux__)
+
+namespace
+{
+	std::filesystem::path CurrentBinDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	// The default engine stops the target on every access: the debuggee's first read and
+	// its four increments are logged with the values they saw.
+	void ExpectCounterSequence(const std::string& out)
+	{
+		std::istringstream iss(out);
+		std::string line;
+		std::vector<std::string> writes;
+		bool saw_initial_read0 = false;
+		while (std::getline(iss, line))
+		{
+			EXPECT_EQ(line.rfind("g_counter ", 0), 0u) << line;
+			if (line == "g_counter read 0")
+				saw_initial_read0 = true;
+			if (line.rfind("g_counter write ", 0) == 0)
+				writes.push_back(line);
+		}
+
+		EXPECT_TRUE(saw_initial_read0);
+		const std::vector<std::string> expected_writes = {
+			"g_counter write 0 -> 1",
+			"g_counter write 1 -> 2",
+			"g_counter write 2 -> 3",
+			"g_counter write 3 -> 4",
+		};
+		EXPECT_EQ(writes, expected_writes);
+	}
+}
+
+TEST(ApplicationTest, Execute_HappyPath_ReturnsExitCode_And_ProducesLogs)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	testing::internal::CaptureStdout();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+
+	Application app(args);
+	const int rc = app.execute();
+
+	EXPECT_EQ(rc, 123);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	ExpectCounterSequence(out);
+}
+
+TEST(ApplicationTest, Execute_AsyncLog_FlushesEverythingBeforeReturning)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	testing::internal::CaptureStdout();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.asyncLog = true;
+
+	Application app(args);
+	const int rc = app.execute();
+
+	EXPECT_EQ(rc, 123);
+	EXPECT_FALSE(Logger::async_active());
+	ExpectCounterSequence(testing::internal::GetCapturedStdout());
+}
+
+TEST(ApplicationTest, Execute_PerfEngine_LogsWithoutStoppingTheTarget)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	testing::internal::CaptureStdout();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.engine = WatchEngine::Perf;
+
+	Application app(args);
+	const int rc = app.execute();
+
+	EXPECT_EQ(rc, 123);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	// Samples are drained asynchronously: only the stream shape and the final value are stable.
+	std::istringstream iss(out);
+	std::string line;
+	std::string last;
+	while (std::getline(iss, line))
+	{
+		EXPECT_EQ(line.rfind("g_counter ", 0), 0u) << line;
+		last = line;
+	}
+	ASSERT_FALSE(last.empty()) << "No access was reported.";
+	EXPECT_EQ(last.back(), '4') << last;
+}
+
+TEST(ApplicationTest, Execute_MultipleVariables_AttributesEachAccess)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_symbols";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	testing::internal::CaptureStdout();
+
+	CliArgs args;
+	args.symbols = {"GWatchTest_Global32", "GWatchTest_Global64"};
+	args.execPath = exe.string();
+
+	Application app(args);
+	const int rc = app.execute();
+
+	EXPECT_EQ(rc, 3);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	std::istringstream iss(out);
+	std::string line;
+	std::string last32;
+	std::string last64;
+	while (std::getline(iss, line))
+	{
+		if (line.rfind("GWatchTest_Global32 ", 0) == 0)
+			last32 = line;
+		else if (line.rfind("GWatchTest_Global64 ", 0) == 0)
+			last64 = line;
+		else
+			ADD_FAILURE() << "Unexpected line: " << line;
+	}
+	// -7 + 1 as a 4-byte unsigned value, then 42 + (-6).
+	EXPECT_TRUE(last32.ends_with(" 4294967290")) << last32;
+	EXPECT_TRUE(last64.ends_with(" 36")) << last64;
+}
+
+TEST(ApplicationTest, Execute_HotSites_ReportsTheAccessingInstructions)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.hotSites = 5;
+
+	Application app(args);
+	testing::internal::CaptureStdout();
+	testing::internal::CaptureStderr();
+	const int rc = app.execute();
+	const std::string err = testing::internal::GetCapturedStderr();
+	testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(rc, 123);
+	// One load and one store in the loop of main, four times each.
+	EXPECT_NE(err.find("hot: sites=2 hits=8\n"), std::string::npos) << err;
+	std::istringstream iss(err);
+	std::string line;
+	int sites = 0;
+	while (std::getline(iss, line))
+	{
+		if (line.starts_with("hot: sites="))
+			continue;
+		++sites;
+		EXPECT_TRUE(line.starts_with("hot: 4 50.0% ")) << line;
+		EXPECT_NE(line.find(" main+0x"), std::string::npos) << line;
+		EXPECT_NE(line.find("(app.cpp:"), std::string::npos) << line;
+		EXPECT_NE(line.find(") g_counter tid="), std::string::npos) << line;
+	}
+	EXPECT_EQ(sites, 2);
+	EXPECT_NE(err.find("% read main+0x"), std::string::npos) << err;
+	EXPECT_NE(err.find("% write main+0x"), std::string::npos) << err;
+}
+
+TEST(ApplicationTest, Execute_StatsMode_PrintsASummaryInsteadOfAccesses)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.mode = gwatch::OutputMode::Stats;
+
+	Application app(args);
+	testing::internal::CaptureStdout();
+	const int rc = app.execute();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(rc, 123);
+	EXPECT_EQ(out.find("g_counter read "), std::string::npos) << out;
+	EXPECT_TRUE(out.starts_with("stats: elapsed=")) << out;
+	EXPECT_NE(out.find("accesses=8 variables=1\n"), std::string::npos) << out;
+	EXPECT_NE(out.find("stats: g_counter reads=4 writes=4\n"), std::string::npos) << out;
+	EXPECT_NE(out.find("stats: g_counter quantiles p0="), std::string::npos) << out;
+}
+
+TEST(ApplicationTest, Execute_Coalesce_MergesSpinReadsAndKeepsTheCount)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_reads";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	CliArgs args;
+	args.symbols = {"g_reads_config"};
+	args.execPath = exe.string();
+	args.targetArgs = {"1000"};
+	args.coalesce = gwatch::Coalescing::Global;
+
+	Application app(args);
+	testing::internal::CaptureStdout();
+	const int rc = app.execute();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(rc, 3);
+	// 3000 reads in two threads, then three writes.
+	std::istringstream iss(out);
+	std::string line;
+	std::uint64_t accesses = 0;
+	int lines = 0;
+	while (std::getline(iss, line))
+	{
+		++lines;
+		const auto x = line.rfind(" x");
+		accesses += x == std::string::npos ? 1 : std::stoull(line.substr(x + 2));
+	}
+	EXPECT_EQ(accesses, 3003u) << out;
+	EXPECT_LT(lines, 10) << out;
+	EXPECT_NE(out.find("g_reads_config read 3 x1000\n"), std::string::npos) << out;
+}
+
+TEST(ApplicationTest, Execute_Sample_ReportsWhatWasDropped)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.policies = {{"g_counter", {.sampleEvery = 3}}};
+
+	Application app(args);
+	testing::internal::CaptureStdout();
+	testing::internal::CaptureStderr();
+	const int rc = app.execute();
+	const std::string err = testing::internal::GetCapturedStderr();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(rc, 123);
+	// Accesses 1, 4 and 7 of 8 reach the output.
+	EXPECT_EQ(std::ranges::count(out, '\n'), 3) << out;
+	EXPECT_NE(err.find("drop: g_counter reads=2 writes=3\n"), std::string::npos) << err;
+	EXPECT_NE(err.find("drop: total reads=2 writes=3\n"), std::string::npos) << err;
+}
+
+TEST(ApplicationTest, Execute_TraceFile_WritesTheAccessesThereInsteadOfStdout)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+	const auto trace = std::filesystem::temp_directory_path() / ("gwatch_app_trace_" + std::to_string(getpid()));
+
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = exe.string();
+	args.traceFile = trace.string();
+
+	Application app(args);
+	testing::internal::CaptureStdout();
+	const int rc = app.execute();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	const std::string segment = trace.string() + ".0";
+	std::ifstream in(segment, std::ios::binary);
+	const std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	in.close();
+	std::filesystem::remove(segment);
+
+	EXPECT_EQ(rc, 123);
+	EXPECT_EQ(out, "");
+	EXPECT_EQ(std::ranges::count(text, '\n'), 8) << text;
+	EXPECT_TRUE(text.starts_with("g_counter ")) << text;
+}
+
+TEST(ApplicationTest, Execute_MissingExecutable_Returns1)
+{
+	CliArgs args;
+	args.symbols = {"g_counter"};
+	args.execPath = "/definitely/not/there/nope";
+
+	Application app(args);
+	testing::internal::CaptureStderr();
+	const int rc = app.execute();
+	testing::internal::GetCapturedStderr();
+	EXPECT_EQ(rc, 1);
+}
+
+TEST(ApplicationTest, Execute_BadSymbol_Returns1)
+{
+	const auto exe = CurrentBinDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	CliArgs args;
+	args.symbols = {"ThisSymbolDoesNotExist_12345"};
 	args.execPath = exe.string();
 
 	Application app(args);
@@ -107,7 +435,7 @@ TEST(ApplicationTest, Execute_BadSymbol_Returns1)
 
 TEST(ApplicationPortable, SkippedOnNonWindows)
 {
-	GTEST_SKIP() << "Application integration tests are Windows-only.";
+	GTEST_SKIP() << "Application integration tests require Windows or Linux.";
 }
 
 #endif
@@ -3,6 +3,7 @@
 #include <vector>
 #include <span>
 #include <stdexcept>
+#include <initializer_list>
 
 #include "ArgumentsParser.h"
 
@@ -60,11 +61,11 @@ TEST(ArgumentsParserTest, Parses_LongForms_WithSeparateValues)
 	ab.add("gwatch").add("--var").add("foo").add("--exec").add("/bin/echo");
 	const auto sp = ab.span();
 
-	const auto [symbol, execPath, targetArgs, showHelp] = ArgumentsParser::parse(sp);
-	EXPECT_FALSE(showHelp);
-	EXPECT_EQ(symbol, "foo");
-	EXPECT_EQ(execPath, "/bin/echo");
-	EXPECT_TRUE(targetArgs.empty());
+	const CliArgs args = ArgumentsParser::parse(sp);
+	EXPECT_FALSE(args.showHelp);
+	EXPECT_EQ(args.symbols, std::vector<std::string>{"foo"});
+	EXPECT_EQ(args.execPath, "/bin/echo");
+	EXPECT_TRUE(args.targetArgs.empty());
 }
 
 TEST(ArgumentsParserTest, Parses_LongForms_WithEquals)
@@ -73,11 +74,11 @@ TEST(ArgumentsParserTest, Parses_LongForms_WithEquals)
 	ab.add("gwatch").add("--var=foo").add("--exec=/usr/bin/true");
 	const auto sp = ab.span();
 
-	const auto [symbol, execPath, targetArgs, showHelp] = ArgumentsParser::parse(sp);
-	EXPECT_FALSE(showHelp);
-	EXPECT_EQ(symbol, "foo");
-	EXPECT_EQ(execPath, "/usr/bin/true");
-	EXPECT_TRUE(targetArgs.empty());
+	const CliArgs args = ArgumentsParser::parse(sp);
+	EXPECT_FALSE(args.showHelp);
+	EXPECT_EQ(args.symbols, std::vector<std::string>{"foo"});
+	EXPECT_EQ(args.execPath, "/usr/bin/true");
+	EXPECT_TRUE(args.targetArgs.empty());
 }
 
 TEST(ArgumentsParserTest, Parses_ShortAliases)
@@ -86,11 +87,11 @@ TEST(ArgumentsParserTest, Parses_ShortAliases)
 	ab.add("gwatch").add("-v").add("SYM").add("-e").add("/bin/false");
 	const auto sp = ab.span();
 
-	const auto [symbol, execPath, targetArgs, showHelp] = ArgumentsParser::parse(sp);
-	EXPECT_FALSE(showHelp);
-	EXPECT_EQ(symbol, "SYM");
-	EXPECT_EQ(execPath, "/bin/false");
-	EXPECT_TRUE(targetArgs.empty());
+	const CliArgs args = ArgumentsParser::parse(sp);
+	EXPECT_FALSE(args.showHelp);
+	EXPECT_EQ(args.symbols, std::vector<std::string>{"SYM"});
+	EXPECT_EQ(args.execPath, "/bin/false");
+	EXPECT_TRUE(args.targetArgs.empty());
 }
 
 TEST(ArgumentsParserTest, Collects_TargetArgs_AfterSeparator)
@@ -111,6 +112,44 @@ TEST(ArgumentsParserTest, Collects_TargetArgs_AfterSeparator)
 	EXPECT_EQ(args.targetArgs[2], "42");
 }
 
+TEST(ArgumentsParserTest, AsyncLog_DefaultsOff_AndFlagEnablesIt)
+{
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	EXPECT_FALSE(ArgumentsParser::parse(plain.span()).asyncLog);
+
+	ArgvBuilder ab;
+	ab.add("gwatch").add("--async-log").add("--var").add("X").add("--exec").add("/bin/echo").add("--").add("--async-log");
+	const CliArgs args = ArgumentsParser::parse(ab.span());
+	EXPECT_TRUE(args.asyncLog);
+	ASSERT_EQ(args.targetArgs.size(), 1u);
+	EXPECT_EQ(args.targetArgs[0], "--async-log");
+}
+
+TEST(ArgumentsParserTest, Format_AcceptsTextAndBinary)
+{
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	EXPECT_EQ(ArgumentsParser::parse(plain.span()).format, gwatch::LogFormat::Text);
+
+	ArgvBuilder equals;
+	equals.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--format=binary");
+	EXPECT_EQ(ArgumentsParser::parse(equals.span()).format, gwatch::LogFormat::Binary);
+
+	ArgvBuilder separate;
+	separate.add("gwatch").add("--format").add("text").add("--var").add("X").add("--exec").add("/bin/echo");
+	EXPECT_EQ(ArgumentsParser::parse(separate.span()).format, gwatch::LogFormat::Text);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidFormat)
+{
+	ArgvBuilder ab;
+	ab.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--format=xml");
+	const auto sp = ab.span();
+
+	expect_parse_error_contains(sp, "Invalid value for --format: 'xml'");
+}
+
 TEST(ArgumentsParserTest, Help_WhenNoArgs_ShowsHelp)
 {
 	ArgvBuilder ab;
@@ -206,6 +245,15 @@ TEST(ArgumentsParserTest, Error_DuplicateExec)
 	expect_parse_error_contains(sp, "Option specified more than once");
 }
 
+TEST(ArgumentsParserTest, Error_DuplicateAsyncLog)
+{
+	ArgvBuilder ab;
+	ab.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--async-log").add("--async-log");
+	const auto sp = ab.span();
+
+	expect_parse_error_contains(sp, "Option specified more than once: --async-log");
+}
+
 TEST(ArgumentsParserTest, Error_EmptyValue_VarEquals)
 {
 	ArgvBuilder ab;
@@ -223,3 +271,564 @@ TEST(ArgumentsParserTest, Error_EmptyValue_ExecEquals)
 
 	expect_parse_error_contains(sp, "Empty value for --exec");
 }
+
+TEST(ArgumentsParserTest, Parses_CommaSeparatedVariables)
+{
+	ArgvBuilder ab;
+	ab.add("gwatch").add("--var").add("a,b,c,d").add("--exec").add("/bin/echo");
+	const auto sp = ab.span();
+
+	const CliArgs args = ArgumentsParser::parse(sp);
+	EXPECT_EQ(args.symbols, (std::vector<std::string>{"a", "b", "c", "d"}));
+
+	ArgvBuilder equals;
+	equals.add("gwatch").add("--var=a,b").add("--exec").add("/bin/echo");
+	const auto eq = equals.span();
+	EXPECT_EQ(ArgumentsParser::parse(eq).symbols, (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(ArgumentsParserTest, Error_TooManyVariables)
+{
+	ArgvBuilder ab;
+	std::string list = "v0";
+	for (int i = 1; i <= 64; ++i)
+		list += ",v" + std::to_string(i);
+	ab.add("gwatch").add("--var").add(list).add("--exec").add("/bin/echo");
+	const auto sp = ab.span();
+
+	expect_parse_error_contains(sp, "Too many variables for --var: 65 (at most 64)");
+}
+
+TEST(ArgumentsParserTest, Error_EmptyOrRepeatedVariableInList)
+{
+	ArgvBuilder empty;
+	empty.add("gwatch").add("--var").add("a,,b").add("--exec").add("/bin/echo");
+	const auto sp = empty.span();
+	expect_parse_error_contains(sp, "Empty value for --var");
+
+	ArgvBuilder repeated;
+	repeated.add("gwatch").add("--var").add("a,b,a").add("--exec").add("/bin/echo");
+	const auto sp2 = repeated.span();
+	expect_parse_error_contains(sp2, "Variable listed more than once in --var: a");
+}
+
+TEST(ArgumentsParserTest, Parses_RotateQuantum)
+{
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto p = plain.span();
+	EXPECT_EQ(ArgumentsParser::parse(p).rotateMs, 0u);
+
+	ArgvBuilder equals;
+	equals.add("gwatch").add("--var").add("X").add("--engine=perf").add("--rotate=25").add("--exec").add("/bin/echo");
+	const auto eq = equals.span();
+	EXPECT_EQ(ArgumentsParser::parse(eq).rotateMs, 25u);
+
+	ArgvBuilder separate;
+	separate.add("gwatch").add("--rotate").add("100").add("--var").add("X").add("--engine=perf").add("--exec").add("/bin/echo");
+	const auto sep = separate.span();
+	EXPECT_EQ(ArgumentsParser::parse(sep).rotateMs, 100u);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidRotateQuantum)
+{
+	ArgvBuilder zero;
+	zero.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--rotate=0");
+	const auto z = zero.span();
+	expect_parse_error_contains(z, "Invalid value for --rotate: '0'");
+
+	ArgvBuilder text;
+	text.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--rotate=10ms");
+	const auto t = text.span();
+	expect_parse_error_contains(t, "Invalid value for --rotate: '10ms'");
+
+#ifdef __linux__
+	ArgvBuilder stopping;
+	stopping.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--rotate=10");
+	const auto st = stopping.span();
+	expect_parse_error_contains(st, "--rotate requires --engine perf on Linux");
+#endif
+}
+
+TEST(ArgumentsParserTest, Parses_Engine)
+{
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto p = plain.span();
+	EXPECT_EQ(ArgumentsParser::parse(p).engine, gwatch::WatchEngine::Breakpoints);
+
+	ArgvBuilder equals;
+	equals.add("gwatch").add("--var").add("X").add("--engine=pages").add("--exec").add("/bin/echo");
+	const auto eq = equals.span();
+	EXPECT_EQ(ArgumentsParser::parse(eq).engine, gwatch::WatchEngine::Pages);
+
+	ArgvBuilder separate;
+	separate.add("gwatch").add("--engine").add("breakpoints").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto sep = separate.span();
+	EXPECT_EQ(ArgumentsParser::parse(sep).engine, gwatch::WatchEngine::Breakpoints);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidEngine)
+{
+	ArgvBuilder ab;
+	ab.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--engine=mprotect");
+	const auto sp = ab.span();
+
+	expect_parse_error_contains(sp, "Invalid value for --engine: 'mprotect'");
+}
+
+TEST(ArgumentsParserTest, Parses_Interval)
+{
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add(".bss").add("--engine=dirty").add("--exec").add("/bin/echo");
+	const auto p = plain.span();
+	const CliArgs defaults = ArgumentsParser::parse(p);
+	EXPECT_EQ(defaults.engine, gwatch::WatchEngine::Dirty);
+	EXPECT_FALSE(defaults.intervalUs.has_value());
+
+	ArgvBuilder ms;
+	ms.add("gwatch").add("--var").add("X").add("--engine=dirty").add("--interval").add("25").add("--exec").add("/bin/echo");
+	const auto m = ms.span();
+	EXPECT_EQ(ArgumentsParser::parse(m).intervalUs, 25'000u);
+
+	ArgvBuilder us;
+	us.add("gwatch").add("--var").add("X").add("--engine=dirty").add("--interval=500us").add("--exec").add("/bin/echo");
+	const auto u = us.span();
+	EXPECT_EQ(ArgumentsParser::parse(u).intervalUs, 500u);
+
+	ArgvBuilder busy;
+	busy.add("gwatch").add("--var").add("X").add("--engine=poll").add("--interval=0").add("--exec").add("/bin/echo");
+	const auto b = busy.span();
+	const CliArgs poll = ArgumentsParser::parse(b);
+	EXPECT_EQ(poll.engine, gwatch::WatchEngine::Poll);
+	EXPECT_EQ(poll.intervalUs, 0u);
+
+	ArgvBuilder summaries;
+	summaries.add("gwatch").add("--var").add("X").add("--engine").add("hybrid").add("--interval=2s").add("--exec").add("/bin/echo");
+	const auto s = summaries.span();
+	const CliArgs hybrid = ArgumentsParser::parse(s);
+	EXPECT_EQ(hybrid.engine, gwatch::WatchEngine::Hybrid);
+	EXPECT_EQ(hybrid.intervalUs, 2'000'000u);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidInterval)
+{
+	ArgvBuilder unit;
+	unit.add("gwatch").add("--var").add("X").add("--engine=dirty").add("--exec").add("/bin/echo").add("--interval=10min");
+	const auto un = unit.span();
+	expect_parse_error_contains(un, "Invalid value for --interval: '10min'");
+
+	ArgvBuilder huge;
+	huge.add("gwatch").add("--var").add("X").add("--engine=dirty").add("--exec").add("/bin/echo").add("--interval=5000s");
+	const auto h = huge.span();
+	expect_parse_error_contains(h, "Invalid value for --interval: '5000s'");
+
+	ArgvBuilder engine;
+	engine.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--interval=10ms");
+	const auto e = engine.span();
+	expect_parse_error_contains(e, "--interval only applies to --engine dirty");
+}
+
+TEST(ArgumentsParserTest, Parses_HotSites)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	EXPECT_EQ(ArgumentsParser::parse(n).hotSites, 0u);
+
+	ArgvBuilder spaced;
+	spaced.add("gwatch").add("--var").add("X").add("--hot-sites").add("10").add("--exec").add("/bin/echo");
+	const auto s = spaced.span();
+	EXPECT_EQ(ArgumentsParser::parse(s).hotSites, 10u);
+
+	ArgvBuilder hybrid;
+	hybrid.add("gwatch").add("--var").add("X").add("--engine=hybrid").add("--hot-sites=3").add("--exec").add("/bin/echo");
+	const auto h = hybrid.span();
+	EXPECT_EQ(ArgumentsParser::parse(h).hotSites, 3u);
+
+	ArgvBuilder perf;
+	perf.add("gwatch").add("--var").add("X").add("--engine").add("perf").add("--hot-sites=4").add("--exec").add("/bin/echo");
+	const auto pf = perf.span();
+	const auto parsed = ArgumentsParser::parse(pf);
+	EXPECT_EQ(parsed.engine, gwatch::WatchEngine::Perf);
+	EXPECT_EQ(parsed.hotSites, 4u);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidHotSites)
+{
+	ArgvBuilder zero;
+	zero.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--hot-sites=0");
+	const auto z = zero.span();
+	expect_parse_error_contains(z, "Invalid value for --hot-sites: '0'");
+
+	ArgvBuilder engine;
+	engine.add("gwatch").add("--var").add("X").add("--engine=poll").add("--exec").add("/bin/echo").add("--hot-sites=5");
+	const auto e = engine.span();
+	expect_parse_error_contains(e, "--hot-sites only applies to --engine breakpoints, hybrid and perf");
+}
+
+TEST(ArgumentsParserTest, Parses_Mode)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	EXPECT_EQ(ArgumentsParser::parse(n).mode, gwatch::OutputMode::Log);
+
+	ArgvBuilder spaced;
+	spaced.add("gwatch").add("--var").add("X").add("--mode").add("stats").add("--exec").add("/bin/echo");
+	const auto s = spaced.span();
+	EXPECT_EQ(ArgumentsParser::parse(s).mode, gwatch::OutputMode::Stats);
+
+	ArgvBuilder equals;
+	equals.add("gwatch").add("--var").add("X").add("--mode=log").add("--format=binary").add("--exec").add("/bin/echo");
+	const auto e = equals.span();
+	EXPECT_EQ(ArgumentsParser::parse(e).mode, gwatch::OutputMode::Log);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidMode)
+{
+	ArgvBuilder unknown;
+	unknown.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--mode=quiet");
+	const auto u = unknown.span();
+	expect_parse_error_contains(u, "Invalid value for --mode: 'quiet'");
+
+	ArgvBuilder format;
+	format.add("gwatch").add("--var").add("X").add("--mode=stats").add("--format=binary").add("--exec").add("/bin/echo");
+	const auto f = format.span();
+	expect_parse_error_contains(f, "--format and --async-log only apply to --mode log");
+
+	ArgvBuilder async;
+	async.add("gwatch").add("--var").add("X").add("--async-log").add("--mode=stats").add("--exec").add("/bin/echo");
+	const auto a = async.span();
+	expect_parse_error_contains(a, "--format and --async-log only apply to --mode log");
+}
+
+TEST(ArgumentsParserTest, Parses_Coalesce)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	const CliArgs defaults = ArgumentsParser::parse(n);
+	EXPECT_EQ(defaults.coalesce, gwatch::Coalescing::Off);
+	EXPECT_FALSE(defaults.coalesceWindowUs.has_value());
+
+	ArgvBuilder spaced;
+	spaced.add("gwatch").add("--var").add("X").add("--coalesce").add("thread").add("--exec").add("/bin/echo");
+	const auto s = spaced.span();
+	EXPECT_EQ(ArgumentsParser::parse(s).coalesce, gwatch::Coalescing::PerThread);
+
+	ArgvBuilder window;
+	window.add("gwatch").add("--var").add("X").add("--coalesce=global").add("--coalesce-window=2s").add("--exec").add("/bin/echo");
+	const auto w = window.span();
+	const CliArgs parsed = ArgumentsParser::parse(w);
+	EXPECT_EQ(parsed.coalesce, gwatch::Coalescing::Global);
+	EXPECT_EQ(parsed.coalesceWindowUs, 2'000'000u);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidCoalesce)
+{
+	ArgvBuilder unknown;
+	unknown.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--coalesce=all");
+	const auto u = unknown.span();
+	expect_parse_error_contains(u, "Invalid value for --coalesce: 'all'");
+
+	ArgvBuilder window;
+	window.add("gwatch").add("--var").add("X").add("--coalesce=thread").add("--coalesce-window").add("5m").add("--exec").add("/bin/echo");
+	const auto w = window.span();
+	expect_parse_error_contains(w, "Invalid value for --coalesce-window: '5m'");
+
+	ArgvBuilder alone;
+	alone.add("gwatch").add("--var").add("X").add("--coalesce-window=5ms").add("--exec").add("/bin/echo");
+	const auto a = alone.span();
+	expect_parse_error_contains(a, "--coalesce-window requires --coalesce");
+
+	ArgvBuilder stats;
+	stats.add("gwatch").add("--var").add("X").add("--mode=stats").add("--coalesce=thread").add("--exec").add("/bin/echo");
+	const auto st = stats.span();
+	expect_parse_error_contains(st, "--coalesce only applies to --mode log");
+}
+
+TEST(ArgumentsParserTest, Parses_Policies)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	EXPECT_TRUE(ArgumentsParser::parse(n).policies.empty());
+
+	ArgvBuilder both;
+	both.add("gwatch").add("--var").add("X,Y").add("--rate-limit").add("1000,Y=50").add("--sample=X=10").add("--exec").add("/bin/echo");
+	const auto b = both.span();
+	const CliArgs args = ArgumentsParser::parse(b);
+	ASSERT_EQ(args.policies.size(), 3u);
+	EXPECT_EQ(args.policies[0].first, "");
+	EXPECT_EQ(args.policies[0].second.ratePerSecond, 1000u);
+	EXPECT_EQ(args.policies[1].first, "Y");
+	EXPECT_EQ(args.policies[1].second.ratePerSecond, 50u);
+	EXPECT_EQ(args.policies[2].first, "X");
+	EXPECT_EQ(args.policies[2].second.sampleEvery, 10u);
+	EXPECT_EQ(args.policies[2].second.ratePerSecond, 0u);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidPolicies)
+{
+	ArgvBuilder zero;
+	zero.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--sample=0");
+	const auto z = zero.span();
+	expect_parse_error_contains(z, "Invalid value for --sample: '0'");
+
+	ArgvBuilder unnamed;
+	unnamed.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--rate-limit==5");
+	const auto u = unnamed.span();
+	expect_parse_error_contains(u, "Invalid value for --rate-limit: '=5'");
+
+	ArgvBuilder twice;
+	twice.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--rate-limit=X=5,X=6");
+	const auto t = twice.span();
+	expect_parse_error_contains(t, "Variable listed more than once in --rate-limit: X");
+
+	ArgvBuilder unknown;
+	unknown.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--sample=Z=5");
+	const auto k = unknown.span();
+	expect_parse_error_contains(k, "Variable not listed in --var: Z");
+
+	ArgvBuilder stats;
+	stats.add("gwatch").add("--var").add("X").add("--mode=stats").add("--sample=5").add("--exec").add("/bin/echo");
+	const auto st = stats.span();
+	expect_parse_error_contains(st, "--rate-limit and --sample only apply to --mode log");
+}
+
+TEST(ArgumentsParserTest, Parses_Overflow)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	const CliArgs defaults = ArgumentsParser::parse(n);
+	EXPECT_FALSE(defaults.overflow.has_value());
+	EXPECT_FALSE(defaults.queueSize.has_value());
+	EXPECT_FALSE(defaults.asyncLog);
+
+	ArgvBuilder drop;
+	drop.add("gwatch").add("--var").add("X").add("--overflow").add("drop-oldest").add("--queue-size=1024").add("--exec").add("/bin/echo");
+	const auto d = drop.span();
+	const CliArgs dropArgs = ArgumentsParser::parse(d);
+	EXPECT_EQ(dropArgs.overflow, gwatch::OverflowPolicy::DropOldest);
+	EXPECT_EQ(dropArgs.queueSize, 1024u);
+	// The queue belongs to the asynchronous logger.
+	EXPECT_TRUE(dropArgs.asyncLog);
+
+	ArgvBuilder spill;
+	spill.add("gwatch").add("--var").add("X").add("--overflow=spill:/tmp/out.spill").add("--exec").add("/bin/echo");
+	const auto s = spill.span();
+	const CliArgs spillArgs = ArgumentsParser::parse(s);
+	EXPECT_EQ(spillArgs.overflow, gwatch::OverflowPolicy::Spill);
+	EXPECT_EQ(spillArgs.spillPath, "/tmp/out.spill");
+}
+
+TEST(ArgumentsParserTest, Error_InvalidOverflow)
+{
+	ArgvBuilder unknown;
+	unknown.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--overflow=drop");
+	const auto u = unknown.span();
+	expect_parse_error_contains(u, "Invalid value for --overflow: 'drop'");
+
+	ArgvBuilder noPath;
+	noPath.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--overflow=spill:");
+	const auto p = noPath.span();
+	expect_parse_error_contains(p, "Invalid value for --overflow: 'spill:'");
+
+	ArgvBuilder size;
+	size.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--queue-size=1");
+	const auto sz = size.span();
+	expect_parse_error_contains(sz, "Invalid value for --queue-size: '1'");
+
+	ArgvBuilder stats;
+	stats.add("gwatch").add("--var").add("X").add("--mode=stats").add("--overflow=drop-newest").add("--exec").add("/bin/echo");
+	const auto st = stats.span();
+	expect_parse_error_contains(st, "--overflow and --queue-size only apply to --mode log");
+}
+
+TEST(ArgumentsParserTest, Parses_TraceFile)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	const CliArgs defaults = ArgumentsParser::parse(n);
+	EXPECT_TRUE(defaults.traceFile.empty());
+	EXPECT_FALSE(defaults.traceSegmentBytes.has_value());
+
+	ArgvBuilder b;
+	b.add("gwatch").add("--var").add("X").add("--trace-file").add("/tmp/trace").add("--trace-segment=512K")
+		.add("--trace-rotate").add("10s").add("--trace-keep=4").add("--exec").add("/bin/echo");
+	const auto s = b.span();
+	const CliArgs args = ArgumentsParser::parse(s);
+	EXPECT_EQ(args.traceFile, "/tmp/trace");
+	EXPECT_EQ(args.traceSegmentBytes, 512u << 10);
+	EXPECT_EQ(args.traceRotateUs, 10'000'000u);
+	EXPECT_EQ(args.traceKeep, 4u);
+
+	ArgvBuilder gig;
+	gig.add("gwatch").add("--var").add("X").add("--trace-file=t").add("--trace-segment=2G").add("--exec").add("/bin/echo");
+	const auto g = gig.span();
+	EXPECT_EQ(ArgumentsParser::parse(g).traceSegmentBytes, std::uint64_t{2} << 30);
+}
+
+TEST(ArgumentsParserTest, Parses_TraceIo)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--trace-file=t").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	const CliArgs defaults = ArgumentsParser::parse(n);
+	EXPECT_EQ(defaults.traceIo, gwatch::TraceBackend::Mmap);
+	EXPECT_FALSE(defaults.traceBlockBytes.has_value());
+	EXPECT_FALSE(defaults.traceDepth.has_value());
+	EXPECT_FALSE(defaults.traceDirect);
+
+	ArgvBuilder b;
+	b.add("gwatch").add("--var").add("X").add("--trace-file=t").add("--trace-io").add("uring")
+		.add("--trace-block=256K").add("--trace-depth").add("8").add("--trace-direct").add("--exec").add("/bin/echo");
+	const auto s = b.span();
+	const CliArgs args = ArgumentsParser::parse(s);
+	EXPECT_EQ(args.traceIo, gwatch::TraceBackend::Uring);
+	EXPECT_EQ(args.traceBlockBytes, 256u << 10);
+	EXPECT_EQ(args.traceDepth, 8u);
+	EXPECT_TRUE(args.traceDirect);
+}
+
+TEST(ArgumentsParserTest, Error_InvalidTraceIo)
+{
+	const auto expect_error = [](const std::initializer_list<const char*> options, const std::string& message)
+	{
+		ArgvBuilder b;
+		b.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+		for (const char* option : options)
+			b.add(option);
+		const auto s = b.span();
+		expect_parse_error_contains(s, message);
+	};
+
+	expect_error({"--trace-file=t", "--trace-io=aio"}, "Invalid value for --trace-io: 'aio' (expected mmap or uring)");
+	expect_error({"--trace-io=uring"}, "--trace-io requires --trace-file");
+	expect_error({"--trace-file=t", "--trace-io=uring", "--trace-block=6K"}, "Invalid value for --trace-block: '6K'");
+	expect_error({"--trace-file=t", "--trace-io=uring", "--trace-block=128M"}, "Invalid value for --trace-block");
+	expect_error({"--trace-file=t", "--trace-io=uring", "--trace-depth=0"}, "Invalid value for --trace-depth: '0'");
+	expect_error({"--trace-file=t", "--trace-io=uring", "--trace-depth=257"}, "Invalid value for --trace-depth");
+	expect_error({"--trace-file=t", "--trace-direct"}, "--trace-block, --trace-depth and --trace-direct only apply to --trace-io uring");
+	expect_error({"--trace-file=t", "--trace-io=mmap", "--trace-depth=2"}, "only apply to --trace-io uring");
+}
+
+TEST(ArgumentsParserTest, Parses_Columnar)
+{
+	ArgvBuilder b;
+	b.add("gwatch").add("--var").add("X").add("--format=columnar").add("--row-group").add("4K").add("--exec").add("/bin/echo");
+	const auto s = b.span();
+	const CliArgs args = ArgumentsParser::parse(s);
+	EXPECT_EQ(args.format, gwatch::LogFormat::Columnar);
+	EXPECT_EQ(args.rowGroupRows, 4096u);
+
+	ArgvBuilder plain;
+	plain.add("gwatch").add("--var").add("X").add("--format").add("columnar").add("--exec").add("/bin/echo");
+	const auto p = plain.span();
+	EXPECT_FALSE(ArgumentsParser::parse(p).rowGroupRows.has_value());
+}
+
+TEST(ArgumentsParserTest, Error_InvalidRowGroup)
+{
+	const auto expect_error = [](const std::initializer_list<const char*> options, const std::string& message)
+	{
+		ArgvBuilder b;
+		b.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+		for (const char* option : options)
+			b.add(option);
+		const auto s = b.span();
+		expect_parse_error_contains(s, message);
+	};
+
+	expect_error({"--format=parquet"}, "Invalid value for --format: 'parquet' (expected text, binary or columnar)");
+	expect_error({"--row-group=64K"}, "--row-group requires --format=columnar");
+	expect_error({"--format=binary", "--row-group=64K"}, "--row-group requires --format=columnar");
+	expect_error({"--format=columnar", "--row-group=100"}, "Invalid value for --row-group: '100'");
+	expect_error({"--format=columnar", "--row-group=32M"}, "Invalid value for --row-group");
+}
+
+TEST(ArgumentsParserTest, Parses_Compress)
+{
+	ArgvBuilder none;
+	none.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+	const auto n = none.span();
+	const CliArgs defaults = ArgumentsParser::parse(n);
+	EXPECT_FALSE(defaults.compress.has_value());
+	EXPECT_FALSE(defaults.compressBlockBytes.has_value());
+
+	ArgvBuilder b;
+	b.add("gwatch").add("--var").add("X").add("--compress").add("lz").add("--compress-block=256K").add("--exec").add("/bin/echo");
+	const auto s = b.span();
+	const CliArgs args = ArgumentsParser::parse(s);
+	EXPECT_EQ(args.compress, gwatch::compress::Codec::Lz);
+	EXPECT_EQ(args.compressBlockBytes, 256u << 10);
+
+	ArgvBuilder a;
+	a.add("gwatch").add("--var").add("X").add("--compress=auto").add("--async-log").add("--exec").add("/bin/echo");
+	const auto t = a.span();
+	EXPECT_EQ(ArgumentsParser::parse(t).compress, gwatch::compress::default_codec());
+}
+
+TEST(ArgumentsParserTest, Error_InvalidCompress)
+{
+	const auto expect_error = [](const std::initializer_list<const char*> options, const std::string& message)
+	{
+		ArgvBuilder b;
+		b.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo");
+		for (const char* option : options)
+			b.add(option);
+		const auto s = b.span();
+		expect_parse_error_contains(s, message);
+	};
+
+	expect_error({"--compress=gzip"}, "Invalid value for --compress: 'gzip'");
+	expect_error({"--compress=lz", "--compress=lz"}, "Option specified more than once: --compress");
+	expect_error({"--compress-block=1M"}, "--compress-block requires --compress");
+	expect_error({"--compress=lz", "--compress-block=4K"}, "Invalid value for --compress-block: '4K'");
+	expect_error({"--compress=lz", "--compress-block=128M"}, "Invalid value for --compress-block");
+	expect_error({"--compress=lz", "--mode=stats"}, "--compress only applies to --mode log");
+	expect_error({"--compress=lz", "--trace-file=t"}, "--compress only applies to stdout, not to --trace-file");
+	expect_error({"--compress=lz", "--async-log", "--overflow=drop-newest"}, "--overflow does not apply to --compress");
+	if (!gwatch::compress::available(gwatch::compress::Codec::Zstd))
+		expect_error({"--compress=zstd"}, "this build has no zstd");
+}
+
+TEST(ArgumentsParserTest, Error_InvalidTraceFile)
+{
+	ArgvBuilder empty;
+	empty.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-file=");
+	const auto e = empty.span();
+	expect_parse_error_contains(e, "Empty value for --trace-file");
+
+	for (const char* size : {"--trace-segment=32K", "--trace-segment=17G", "--trace-segment=1T", "--trace-segment=M"})
+	{
+		SCOPED_TRACE(size);
+		ArgvBuilder b;
+		b.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-file=t").add(size);
+		const auto s = b.span();
+		expect_parse_error_contains(s, "Invalid value for --trace-segment");
+	}
+
+	ArgvBuilder keep;
+	keep.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-file=t").add("--trace-keep=0");
+	const auto k = keep.span();
+	expect_parse_error_contains(k, "Invalid value for --trace-keep: '0'");
+
+	ArgvBuilder alone;
+	alone.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-rotate=1s");
+	const auto a = alone.span();
+	expect_parse_error_contains(a, "--trace-segment, --trace-rotate and --trace-keep require --trace-file");
+
+	ArgvBuilder stats;
+	stats.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-file=t").add("--mode=stats");
+	const auto st = stats.span();
+	expect_parse_error_contains(st, "--trace-file only applies to --mode log");
+
+	ArgvBuilder overflow;
+	overflow.add("gwatch").add("--var").add("X").add("--exec").add("/bin/echo").add("--trace-file=t").add("--overflow=drop-newest");
+	const auto o = overflow.span();
+	expect_parse_error_contains(o, "--overflow only applies to stdout, not to --trace-file");
+}
@@ -0,0 +1,379 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "ColumnarTrace.h"
+#include "Logger.h"
+#include "MappedFile.h"
+
+using gwatch::AccessKind;
+using gwatch::LogRecord;
+using gwatch::Logger;
+namespace columnar = gwatch::columnar;
+
+namespace
+{
+	std::uint64_t next_random(std::uint64_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	LogRecord make_record(const std::uint64_t i)
+	{
+		return LogRecord{
+			.timestamp_ns = 1'000 + i * 10,
+			.old_value = i,
+			.new_value = i * 3,
+			.tid = 100 + static_cast<std::uint32_t>(i % 4),
+			.symbol = static_cast<std::uint32_t>(i % 3),
+			.kind = i % 5 == 0 ? AccessKind::Read : AccessKind::Write,
+			.repeat = 1 + static_cast<std::uint32_t>(i % 2),
+			.ip = 0x401000 + i % 7,
+		};
+	}
+
+	// Bytes of a columnar stream, in storage the reader accepts (8-byte aligned).
+	std::vector<char> to_buffer(const std::string& bytes)
+	{
+		return {bytes.begin(), bytes.end()};
+	}
+}
+
+TEST(ColumnarTraceTest, WriterGroupsRoundTripThroughTheReader)
+{
+	const std::string names[] = {"g_counter", "g_flag", "a_much_longer_variable_name"};
+	std::vector<gwatch::trace::SymbolView> symbols = {{names[0], 8}, {names[1], 4}};
+	columnar::Writer writer(1000);
+	std::vector<char> out;
+	for (std::uint64_t i = 0; i < 2500; ++i)
+	{
+		// The third symbol appears in the second group only.
+		if (i == 1500)
+			symbols.push_back({names[2], 8});
+		LogRecord record = make_record(i);
+		record.symbol %= static_cast<std::uint32_t>(symbols.size());
+		if (writer.add(record))
+		{
+			const std::size_t expected = writer.render_size(symbols);
+			const std::size_t before = out.size();
+			writer.render(symbols, out);
+			EXPECT_EQ(out.size() - before, expected);
+			EXPECT_EQ(out.size() % columnar::kAlignment, 0u);
+		}
+	}
+	EXPECT_EQ(writer.buffered(), 500u);
+	writer.render(symbols, out);
+
+	const columnar::Reader reader(out);
+	ASSERT_EQ(reader.groups().size(), 3u);
+	EXPECT_EQ(reader.rows(), 2500u);
+	ASSERT_EQ(reader.symbols().size(), 3u);
+	EXPECT_EQ(reader.symbols()[2].name, names[2]);
+	EXPECT_EQ(reader.symbols()[1].size, 4u);
+	EXPECT_EQ(reader.find_symbol("g_flag"), 1u);
+	EXPECT_FALSE(reader.find_symbol("missing").has_value());
+
+	std::uint64_t i = 0;
+	for (const columnar::RowGroup& group : reader.groups())
+	{
+		// Every column starts on a 64-byte boundary of the stream.
+		EXPECT_EQ((reinterpret_cast<const char*>(group.kinds().data()) - out.data()) % 64, 0);
+		EXPECT_EQ((reinterpret_cast<const char*>(group.ips().data()) - out.data()) % 64, 0);
+		EXPECT_EQ(group.stats(columnar::Column::Timestamp).min, 1'000 + i * 10);
+		EXPECT_EQ(group.stats(columnar::Column::Timestamp).max, 1'000 + (i + group.rows() - 1) * 10);
+		EXPECT_EQ(group.stats(columnar::Column::Tid).min, 100u);
+		EXPECT_EQ(group.stats(columnar::Column::Tid).max, 103u);
+		EXPECT_EQ(group.stats(columnar::Column::Kind).max, 1u);
+		for (std::uint32_t row = 0; row < group.rows(); ++row, ++i)
+		{
+			const LogRecord expected = make_record(i);
+			const LogRecord actual = group.record(row);
+			ASSERT_EQ(actual.timestamp_ns, expected.timestamp_ns);
+			EXPECT_EQ(actual.old_value, expected.old_value);
+			EXPECT_EQ(actual.new_value, expected.new_value);
+			EXPECT_EQ(actual.tid, expected.tid);
+			EXPECT_EQ(actual.kind, expected.kind);
+			EXPECT_EQ(actual.repeat, expected.repeat);
+			EXPECT_EQ(actual.ip, expected.ip);
+		}
+	}
+}
+
+TEST(ColumnarTraceTest, ScanKernelsMatchAPlainLoop)
+{
+	std::uint64_t state = 0x9E3779B97F4A7C15ull;
+	std::vector<std::uint64_t> wide(5000);
+	std::vector<std::uint32_t> narrow(5000);
+	std::vector<std::uint8_t> bytes(5000);
+	for (std::size_t i = 0; i < wide.size(); ++i)
+	{
+		wide[i] = next_random(state) % 1000;
+		narrow[i] = static_cast<std::uint32_t>(next_random(state) % 50);
+		bytes[i] = static_cast<std::uint8_t>(next_random(state));
+	}
+	wide[17] = std::numeric_limits<std::uint64_t>::max();
+
+	const auto check = [](const auto& values, const auto lo, const auto hi)
+	{
+		using T = std::remove_cvref_t<decltype(values[0])>;
+		const std::span<const T> column(values);
+		std::vector<std::uint32_t> expected;
+		for (std::size_t i = 0; i < values.size(); ++i)
+		{
+			if (values[i] >= lo && values[i] <= hi)
+				expected.push_back(static_cast<std::uint32_t>(i));
+		}
+		std::vector<std::uint32_t> rows = {7};
+		EXPECT_EQ(columnar::select_range<T>(column, lo, hi, rows), expected.size());
+		expected.insert(expected.begin(), 7);
+		EXPECT_EQ(rows, expected);
+		EXPECT_EQ(columnar::count_in_range<T>(column, lo, hi), expected.size() - 1);
+	};
+	check(wide, std::uint64_t{100}, std::uint64_t{199});
+	check(wide, std::uint64_t{0}, std::numeric_limits<std::uint64_t>::max());
+	check(wide, std::uint64_t{5000}, std::uint64_t{6000});
+	check(narrow, std::uint32_t{7}, std::uint32_t{7});
+	check(bytes, std::uint8_t{200}, std::uint8_t{255});
+
+	const columnar::ColumnStats stats = columnar::min_max(std::span<const std::uint64_t>(wide));
+	EXPECT_EQ(stats.max, std::numeric_limits<std::uint64_t>::max());
+	EXPECT_EQ(stats.min, *std::min_element(wide.begin(), wide.end()));
+
+	std::vector<std::uint32_t> rows;
+	columnar::select_range(std::span<const std::uint32_t>(narrow), 0u, 9u, rows);
+	columnar::refine_range(std::span<const std::uint8_t>(bytes), std::uint8_t{0}, std::uint8_t{127}, rows);
+	for (std::size_t i = 0, r = 0; i < narrow.size(); ++i)
+	{
+		if (narrow[i] <= 9 && bytes[i] <= 127)
+		{
+			ASSERT_LT(r, rows.size());
+			EXPECT_EQ(rows[r++], i);
+		}
+	}
+}
+
+TEST(ColumnarTraceTest, FiltersUseTheGroupStatistics)
+{
+	const std::string name = "v";
+	const gwatch::trace::SymbolView symbols[] = {{name, 8}, {name, 8}, {name, 8}};
+	columnar::Writer writer(100);
+	std::vector<char> out;
+	for (std::uint64_t i = 0; i < 300; ++i)
+	{
+		if (writer.add(make_record(i)))
+			writer.render(symbols, out);
+	}
+	const columnar::Reader reader(out);
+	ASSERT_EQ(reader.groups().size(), 3u);
+
+	// Rows 100..199 span 2000..2990 ns.
+	const columnar::Filter window{.fromNs = 2'000, .toNs = 2'990};
+	EXPECT_FALSE(columnar::may_match(reader.groups()[0], window));
+	EXPECT_TRUE(columnar::may_match(reader.groups()[1], window));
+	EXPECT_FALSE(columnar::may_match(reader.groups()[1], columnar::Filter{.tid = 99}));
+	EXPECT_FALSE(columnar::may_match(reader.groups()[2], columnar::Filter{.value = 3}));
+
+	std::vector<std::uint32_t> rows;
+	const columnar::Filter writes{.var = 1, .tid = 101, .kind = AccessKind::Write};
+	std::uint64_t matched = 0;
+	for (const columnar::RowGroup& group : reader.groups())
+	{
+		columnar::select(group, writes, rows);
+		for (const std::uint32_t row : rows)
+		{
+			const LogRecord record = group.record(row);
+			EXPECT_EQ(record.symbol, 1u);
+			EXPECT_EQ(record.tid, 101u);
+			EXPECT_EQ(record.kind, AccessKind::Write);
+		}
+		matched += rows.size();
+	}
+	std::uint64_t expected = 0;
+	for (std::uint64_t i = 0; i < 300; ++i)
+	{
+		const LogRecord record = make_record(i);
+		expected += record.symbol == 1 && record.tid == 101 && record.kind == AccessKind::Write;
+	}
+	EXPECT_EQ(matched, expected);
+
+	columnar::select(reader.groups()[0], columnar::Filter{.value = 30}, rows);
+	ASSERT_EQ(rows.size(), 1u);
+	EXPECT_EQ(rows[0], 10u);
+	columnar::select(reader.groups()[0], columnar::Filter{}, rows);
+	EXPECT_EQ(rows.size(), 100u);
+	columnar::select(reader.groups()[0], columnar::Filter{.fromNs = 5, .toNs = 4}, rows);
+	EXPECT_TRUE(rows.empty());
+}
+
+TEST(ColumnarTraceTest, UnknownValuesKeepTheirKindButMatchNoValue)
+{
+	const std::string name = "v";
+	const gwatch::trace::SymbolView symbols[] = {{name, 8}};
+	columnar::Writer writer(4);
+	std::vector<char> out;
+	for (const LogRecord& record : {
+		     LogRecord{.timestamp_ns = 1, .old_value = 0, .new_value = 0, .kind = AccessKind::Write},
+		     LogRecord{.timestamp_ns = 2, .kind = AccessKind::Write, .exact = false},
+		     LogRecord{.timestamp_ns = 3, .kind = AccessKind::Read, .exact = false},
+		     LogRecord{.timestamp_ns = 4, .old_value = 0, .new_value = 0, .kind = AccessKind::Read},
+	     })
+	{
+		if (writer.add(record))
+			writer.render(symbols, out);
+	}
+	const columnar::Reader reader(out);
+	ASSERT_EQ(reader.groups().size(), 1u);
+	const columnar::RowGroup& group = reader.groups()[0];
+	EXPECT_TRUE(group.record(0).exact);
+	EXPECT_FALSE(group.record(1).exact);
+	EXPECT_EQ(group.record(1).kind, AccessKind::Write);
+	EXPECT_EQ(group.record(2).kind, AccessKind::Read);
+
+	std::vector<std::uint32_t> rows;
+	columnar::select(group, columnar::Filter{.kind = AccessKind::Write}, rows);
+	EXPECT_EQ(rows, (std::vector<std::uint32_t>{0, 1}));
+	columnar::select(group, columnar::Filter{.kind = AccessKind::Read, .value = 0}, rows);
+	EXPECT_EQ(rows, (std::vector<std::uint32_t>{3}));
+	columnar::select(group, columnar::Filter{.value = 0}, rows);
+	EXPECT_EQ(rows, (std::vector<std::uint32_t>{0, 3}));
+}
+
+TEST(ColumnarTraceTest, Error_CorruptInput)
+{
+	const std::string name = "v";
+	const gwatch::trace::SymbolView symbols[] = {{name, 8}, {name, 8}, {name, 8}};
+	columnar::Writer writer(50);
+	std::vector<char> out;
+	for (std::uint64_t i = 0; i < 100; ++i)
+	{
+		if (writer.add(make_record(i)))
+			writer.render(symbols, out);
+	}
+
+	EXPECT_THROW(columnar::Reader(to_buffer("GWTR and more bytes than a header, really, quite a few of them.....")), columnar::ColumnarError);
+
+	// A group cut short ends the walk; zero padding too.
+	std::vector<char> cut(out.begin(), out.end() - 64);
+	EXPECT_EQ(columnar::Reader(cut).groups().size(), 1u);
+	std::vector<char> padded = out;
+	padded.resize(out.size() + 4096);
+	EXPECT_EQ(columnar::Reader(padded).rows(), 100u);
+
+	std::vector<char> badGroup = out;
+	badGroup[columnar::kAlignment] = 'X';
+	EXPECT_THROW(columnar::Reader{badGroup}, columnar::ColumnarError);
+	std::vector<char> badColumn = out;
+	badColumn[columnar::kAlignment + 24] = 1; // first column offset, no longer aligned
+	EXPECT_THROW(columnar::Reader{badColumn}, columnar::ColumnarError);
+}
+
+TEST(ColumnarTraceTest, LoggerWritesRowGroupsToStdout)
+{
+	testing::internal::CaptureStdout();
+	Logger::set_format(gwatch::LogFormat::Columnar);
+	Logger::set_row_group(1000);
+	for (std::uint64_t i = 0; i < 2500; ++i)
+		Logger::log_write(i % 2 ? "col_odd" : "col_even", i, i + 1, 7, 5'000 + i, 0x400000 + i);
+	Logger::log_read("col_odd", 42, 8, 99'999);
+	Logger::set_format(gwatch::LogFormat::Text);
+	Logger::set_row_group(columnar::kDefaultRows);
+	const std::vector<char> out = to_buffer(testing::internal::GetCapturedStdout());
+
+	const columnar::Reader reader(out);
+	ASSERT_EQ(reader.groups().size(), 3u);
+	EXPECT_EQ(reader.rows(), 2501u);
+	const auto odd = reader.find_symbol("col_odd");
+	const auto even = reader.find_symbol("col_even");
+	ASSERT_TRUE(odd.has_value() && even.has_value());
+	std::uint64_t i = 0;
+	for (const columnar::RowGroup& group : reader.groups())
+	{
+		for (std::uint32_t row = 0; row < group.rows(); ++row, ++i)
+		{
+			const LogRecord record = group.record(row);
+			if (i == 2500)
+			{
+				EXPECT_EQ(record.kind, AccessKind::Read);
+				EXPECT_EQ(record.new_value, 42u);
+				EXPECT_EQ(record.ip, 0u);
+				continue;
+			}
+			EXPECT_EQ(record.symbol, i % 2 ? *odd : *even);
+			EXPECT_EQ(record.old_value, i);
+			EXPECT_EQ(record.timestamp_ns, 5'000 + i);
+			EXPECT_EQ(record.ip, 0x400000 + i);
+		}
+	}
+}
+
+TEST(ColumnarTraceTest, AsyncOutputIsTheSame)
+{
+	const auto run = [](const bool async)
+	{
+		testing::internal::CaptureStdout();
+		Logger::set_format(gwatch::LogFormat::Columnar);
+		Logger::set_row_group(4096);
+		if (async)
+			Logger::start_async();
+		for (std::uint64_t i = 0; i < 10'000; ++i)
+			Logger::log_read(i % 3 ? "col_a" : "col_b", i, 1, 1 + i, 0x1000);
+		Logger::stop_async();
+		Logger::set_format(gwatch::LogFormat::Text);
+		Logger::set_row_group(columnar::kDefaultRows);
+		return testing::internal::GetCapturedStdout();
+	};
+	const std::string sync = run(false);
+	EXPECT_EQ(run(true), sync);
+	EXPECT_EQ(columnar::Reader(to_buffer(sync)).rows(), 10'000u);
+}
+
+#ifdef __linux__
+TEST(ColumnarTraceTest, EverySegmentIsAColumnarFileOfItsOwn)
+{
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("gwatch_columnar_" + std::to_string(getpid()));
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	const std::string path = (dir / "t").string();
+
+	Logger::set_format(gwatch::LogFormat::Columnar);
+	// Capped to fit twice in a 64K segment.
+	Logger::open_trace_file(gwatch::TraceFileOptions{.path = path, .segmentBytes = 64 << 10});
+	for (std::uint64_t i = 0; i < 5'000; ++i)
+		Logger::log_write("seg_var", i, i + 1, 3, 10 + i);
+	Logger::close_trace_file();
+	Logger::set_format(gwatch::LogFormat::Text);
+
+	std::uint64_t next = 0;
+	int segments = 0;
+	for (; std::filesystem::exists(path + "." + std::to_string(segments)); ++segments)
+	{
+		const gwatch::MappedFile file(path + "." + std::to_string(segments));
+		EXPECT_LE(file.bytes().size(), 64u << 10);
+		const columnar::Reader reader(file.bytes());
+		EXPECT_EQ(reader.symbols()[*reader.find_symbol("seg_var")].name, "seg_var");
+		for (const columnar::RowGroup& group : reader.groups())
+		{
+			EXPECT_LE(group.rows() * columnar::kRowBytes, 32u << 10);
+			for (const std::uint64_t old : group.old_values())
+				EXPECT_EQ(old, next++);
+		}
+	}
+	EXPECT_GT(segments, 2);
+	EXPECT_EQ(next, 5'000u);
+	std::filesystem::remove_all(dir);
+}
+#endif
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Compression.h"
+#include "Logger.h"
+
+using gwatch::Logger;
+namespace compress = gwatch::compress;
+
+namespace
+{
+	std::vector<char> round_trip(const compress::Codec codec, const std::string& text)
+	{
+		std::vector<char> packed;
+		compress::compress_block(codec, text, packed);
+		std::vector<char> out(text.size());
+		compress::decompress_block(codec, packed, out);
+		return out;
+	}
+
+	std::string random_bytes(const std::size_t size)
+	{
+		std::string bytes(size, '\0');
+		std::uint64_t state = 0x9E3779B97F4A7C15ull;
+		for (char& c : bytes)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			c = static_cast<char>(state);
+		}
+		return bytes;
+	}
+
+	std::string log_lines(const int count)
+	{
+		std::string text;
+		for (int i = 0; i < count; ++i)
+			text += (i % 3 ? "g_counter write " : "g_flag read ") + std::to_string(i) + (i % 3 ? " -> " + std::to_string(i + 1) : "") + "\n";
+		return text;
+	}
+
+	// Runs text through a StreamCompressor in writes of up to chunk bytes.
+	std::string compress_stream(const std::string& text, const std::size_t blockBytes, const std::size_t chunk, compress::StreamCompressor::Stats* stats = nullptr)
+	{
+		std::string stream;
+		compress::StreamCompressor compressor(compress::Codec::Lz, blockBytes, [&](const char* data, const std::size_t size)
+		{
+			stream.append(data, size);
+			return true;
+		});
+		for (std::size_t offset = 0; offset < text.size(); offset += chunk)
+			compressor.write(text.data() + offset, std::min(chunk, text.size() - offset));
+		compressor.close();
+		if (stats != nullptr)
+			*stats = compressor.stats();
+		return stream;
+	}
+
+	std::string decompress(const std::string& stream, const unsigned threads)
+	{
+		const std::vector<char> raw = compress::decompress(stream, threads);
+		return {raw.begin(), raw.end()};
+	}
+}
+
+TEST(CompressionTest, Lz_RoundTrips)
+{
+	std::string overlapping(5000, 'a');
+	overlapping += "abcabcabcabcabcabcabcabcabcabcab";
+	const std::string inputs[] = {"", "x", "short line\n", std::string(100'000, 'z'), overlapping, random_bytes(70'000), log_lines(5000), random_bytes(300) + log_lines(200) + random_bytes(300)};
+	for (const std::string& input : inputs)
+	{
+		SCOPED_TRACE(input.size());
+		const std::vector<char> out = round_trip(compress::Codec::Lz, input);
+		EXPECT_EQ(std::string(out.begin(), out.end()), input);
+	}
+}
+
+TEST(CompressionTest, Lz_ShrinksLogText)
+{
+	const std::string text = log_lines(20'000);
+	std::vector<char> packed;
+	compress::compress_block(compress::Codec::Lz, text, packed);
+	EXPECT_LT(packed.size() * 3, text.size());
+}
+
+TEST(CompressionTest, Lz_CorruptInputThrows)
+{
+	const std::string text = log_lines(500);
+	std::vector<char> packed;
+	compress::compress_block(compress::Codec::Lz, text, packed);
+	std::vector<char> out(text.size());
+
+	EXPECT_THROW(compress::decompress_block(compress::Codec::Lz, std::span(packed).first(packed.size() / 2), out), compress::CompressError);
+	std::vector<char> tooSmall(text.size() - 1);
+	EXPECT_THROW(compress::decompress_block(compress::Codec::Lz, packed, tooSmall), compress::CompressError);
+	// One literal, a match reaching five bytes back, the closing empty sequence.
+	const char farOffset[] = {0x10, 'a', 5, 0, 0};
+	std::vector<char> five(5);
+	EXPECT_THROW(compress::decompress_block(compress::Codec::Lz, farOffset, five), compress::CompressError);
+	const char nearOffset[] = {0x10, 'a', 1, 0, 0};
+	compress::decompress_block(compress::Codec::Lz, nearOffset, five);
+	EXPECT_EQ(std::string(five.begin(), five.end()), "aaaaa");
+}
+
+TEST(CompressionTest, Stream_BlocksHoldWholeWritesAndDecodeIndependently)
+{
+	const std::string text = log_lines(50'000);
+	compress::StreamCompressor::Stats stats;
+	// One write per line, the way the Logger writes.
+	std::string stream;
+	{
+		compress::StreamCompressor compressor(compress::Codec::Lz, 64 << 10, [&](const char* data, const std::size_t size)
+		{
+			stream.append(data, size);
+			return true;
+		});
+		for (std::size_t begin = 0; begin < text.size();)
+		{
+			const std::size_t end = text.find('\n', begin) + 1;
+			compressor.write(text.data() + begin, end - begin);
+			begin = end;
+		}
+		compressor.close();
+		stats = compressor.stats();
+	}
+
+	ASSERT_TRUE(compress::is_compressed(stream));
+	const compress::Index index = compress::read_index(stream);
+	EXPECT_EQ(index.codec, compress::Codec::Lz);
+	EXPECT_EQ(index.rawSize, text.size());
+	EXPECT_GT(index.blocks.size(), 4u);
+	EXPECT_EQ(stats.blocks, index.blocks.size());
+	EXPECT_EQ(stats.rawBytes, text.size());
+	EXPECT_EQ(stats.compressedBytes, stream.size());
+	EXPECT_GT(text.size(), stream.size() * 3);
+
+	// Any block alone decodes to whole lines at its place in the text.
+	for (const compress::Block& block : index.blocks)
+	{
+		std::vector<char> out(block.rawSize);
+		compress::decompress_block(index.codec, std::span(stream).subspan(block.offset, block.storedSize), out);
+		EXPECT_EQ(std::string_view(out.data(), out.size()), std::string_view(text).substr(block.rawOffset, block.rawSize));
+		EXPECT_EQ(out.back(), '\n');
+		EXPECT_TRUE(block.rawOffset == 0 || text[block.rawOffset - 1] == '\n');
+	}
+
+	EXPECT_EQ(decompress(stream, 1), text);
+	EXPECT_EQ(decompress(stream, 4), text);
+}
+
+TEST(CompressionTest, Stream_IncompressibleBlocksAreStored)
+{
+	const std::string bytes = random_bytes(200'000);
+	const std::string stream = compress_stream(bytes, 64 << 10, 4096);
+
+	const compress::Index index = compress::read_index(stream);
+	ASSERT_FALSE(index.blocks.empty());
+	for (const compress::Block& block : index.blocks)
+	{
+		EXPECT_TRUE(block.raw);
+		EXPECT_EQ(block.storedSize, block.rawSize);
+	}
+	EXPECT_EQ(decompress(stream, 2), bytes);
+}
+
+TEST(CompressionTest, Stream_WithoutIndexIsScanned)
+{
+	const std::string text = log_lines(20'000);
+	const std::string stream = compress_stream(text, 64 << 10, 1000);
+	const std::size_t blocks = compress::read_index(stream).blocks.size();
+
+	// A stream cut short by a crash: no end marker, no index, half of the last block.
+	const compress::Index complete = compress::read_index(stream);
+	const compress::Block& last = complete.blocks.back();
+	const std::string cut = stream.substr(0, last.offset + last.storedSize / 2);
+	const compress::Index scanned = compress::read_index(cut);
+	EXPECT_EQ(scanned.blocks.size(), blocks - 1);
+	EXPECT_EQ(decompress(cut, 2), text.substr(0, last.rawOffset));
+
+	// Other output inside a closed stream is an error, not a stream cut short.
+	std::string mixed = stream;
+	mixed.insert(8, "bye\n");
+	EXPECT_THROW(compress::read_index(mixed), compress::CompressError);
+
+	EXPECT_EQ(decompress(compress_stream("", 64 << 10, 1), 1), "");
+	EXPECT_THROW(compress::read_index(std::string("GWZ1\x09\x01\0\0", 8)), compress::CompressError);
+}
+
+TEST(CompressionTest, Error_InvalidArguments)
+{
+	const auto sink = [](const char*, std::size_t) { return true; };
+	EXPECT_THROW(compress::StreamCompressor(compress::Codec::Lz, 0, sink), std::invalid_argument);
+	if (!compress::available(compress::Codec::Zstd))
+	{
+		EXPECT_THROW(compress::StreamCompressor(compress::Codec::Zstd, 1 << 20, sink), std::invalid_argument);
+	}
+}
+
+TEST(CompressionTest, Logger_CompressesStdout)
+{
+	for (const bool async : {false, true})
+	{
+		SCOPED_TRACE(async);
+		testing::internal::CaptureStdout();
+		Logger::start_compression(gwatch::CompressionOptions{.codec = compress::Codec::Lz, .blockBytes = 64 << 10});
+		if (async)
+			Logger::start_async();
+		for (std::uint64_t i = 0; i < 30'000; ++i)
+			Logger::log_write(i % 2 ? "odd" : "even", i, i + 1);
+		if (async)
+			Logger::stop_async();
+		Logger::stop_compression();
+		Logger::log_read("after", 1);
+		const std::string out = testing::internal::GetCapturedStdout();
+
+		std::string expected;
+		for (std::uint64_t i = 0; i < 30'000; ++i)
+			expected += std::string(i % 2 ? "odd" : "even") + " write " + std::to_string(i) + " -> " + std::to_string(i + 1) + "\n";
+		const std::string plain = "after read 1\n";
+		ASSERT_GT(out.size(), plain.size());
+		ASSERT_EQ(out.substr(out.size() - plain.size()), plain);
+		EXPECT_EQ(decompress(out.substr(0, out.size() - plain.size()), 2), expected);
+	}
+}
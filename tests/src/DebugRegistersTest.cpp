@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <span>
+#include <vector>
+
+#include "DebugRegisters.h"
+
+using namespace gwatch;
+
+TEST(DebugRegistersTest, EncodesOneSlotPerVariable)
+{
+	const dr::Slot slots[] = {
+		{.address = 0x1000, .size = 4, .trigger = dr::Trigger::ReadWrite},
+		{.address = 0x2000, .size = 8, .trigger = dr::Trigger::Write},
+	};
+
+	const std::uint64_t dr7 = dr::encode_dr7(0, slots);
+
+	// L0 | L1, RW0 = 11b LEN0 = 11b, RW1 = 01b LEN1 = 10b
+	EXPECT_EQ(dr7, 0b1ull | 0b100ull | (0xFull << 16) | (0b1001ull << 20));
+}
+
+TEST(DebugRegistersTest, DisablesUnusedSlotsAndKeepsOtherBits)
+{
+	const std::uint64_t previous = dr::encode_dr7(0, std::vector<dr::Slot>(4, {.address = 0x10, .size = 8}));
+	const std::uint64_t foreign = 1ull << 8; // LE, not a slot field
+	const dr::Slot slot{.address = 0x10, .size = 4};
+
+	const std::uint64_t dr7 = dr::encode_dr7(previous | foreign, std::span(&slot, 1));
+
+	EXPECT_EQ(dr7, foreign | 0b1ull | (0xFull << 16));
+}
+
+TEST(DebugRegistersTest, RejectsBadSizesAndTooManySlots)
+{
+	EXPECT_THROW(dr::length_bits(3), std::invalid_argument);
+	EXPECT_THROW(dr::encode_dr7(0, std::vector<dr::Slot>(5, {.address = 0, .size = 4})), std::invalid_argument);
+}
+
+TEST(DebugRegistersTest, DecodesAndClearsStatusBits)
+{
+	const std::uint64_t dr6 = 0xFFFF0FF0ull | 0b1010;
+
+	EXPECT_EQ(dr::triggered_slots(dr6), 0b1010u);
+	EXPECT_EQ(dr::clear_triggered(dr6), 0xFFFF0FF0ull);
+}
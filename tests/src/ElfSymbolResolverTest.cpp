@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "SymbolResolver.h"
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	// Any shared object mapped into this process exposes a .gnu.hash table.
+	std::string MappedLibc()
+	{
+		std::ifstream maps("/proc/self/maps");
+		std::string line;
+		while (std::getline(maps, line))
+		{
+			if (const auto slash = line.find('/'); slash != std::string::npos && line.find("/libc.so") != std::string::npos)
+				return line.substr(slash);
+		}
+		return {};
+	}
+}
+
+class ElfSymbolResolverTest : public ::testing::Test
+{
+protected:
+	std::filesystem::path image;
+	std::unique_ptr<gwatch::ISymbolResolver> resolver;
+
+	void SetUp() override
+	{
+		image = CurrentModuleDir() / "gwatch_debuggee_symbols";
+		ASSERT_TRUE(std::filesystem::exists(image)) << "Debuggee not found at: " << image.string();
+		resolver = std::make_unique<gwatch::ElfSymbolResolver>(image.string());
+	}
+};
+
+TEST(ElfSymbolResolverCtor, MissingImageThrows)
+{
+	EXPECT_THROW({
+		gwatch::ElfSymbolResolver bad("/definitely/not/there/image");
+		}, gwatch::SymbolError);
+}
+
+TEST(ElfSymbolResolverCtor, NonElfImageThrows)
+{
+	EXPECT_THROW({
+		gwatch::ElfSymbolResolver bad("/proc/self/cmdline");
+		}, gwatch::SymbolError);
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_Int64_Global)
+{
+	const auto [name, module, address, size, element] = resolver->resolve("GWatchTest_Global64");
+	EXPECT_EQ(name, "GWatchTest_Global64");
+	EXPECT_EQ(size, 8u);
+	EXPECT_NE(address, 0u);
+	EXPECT_EQ(module.rfind("0x", 0), 0u) << "Module base is expected as hex string prefixed with 0x.";
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_Int32_Global)
+{
+	const auto s = resolver->resolve("GWatchTest_Global32");
+	EXPECT_EQ(s.name, "GWatchTest_Global32");
+	EXPECT_EQ(s.size, 4u);
+	EXPECT_NE(s.address, 0u);
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_Qualified_ModuleName)
+{
+	const auto s = resolver->resolve(image.stem().string() + "!GWatchTest_Global32");
+	EXPECT_EQ(s.name, "GWatchTest_Global32");
+	EXPECT_EQ(s.size, 4u);
+	EXPECT_THROW((void)resolver->resolve("other_module!GWatchTest_Global32"), gwatch::SymbolError);
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_Cpp_QualifiedName)
+{
+	const auto s = resolver->resolve("GWatchCppNS::CppGlobal");
+	EXPECT_EQ(s.size, 8u);
+	EXPECT_NE(s.address, 0u);
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_RepeatedLookupsUseIndex)
+{
+	const auto first = resolver->resolve("GWatchTest_Global32");
+	const auto second = resolver->resolve("GWatchTest_Global64");
+	const auto third = resolver->resolve("GWatchTest_Global32");
+	EXPECT_EQ(first.address, third.address);
+	EXPECT_EQ(second.size, 8u);
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_SizeFromDwarf_WhenSymbolIsUnsized)
+{
+	const auto sized = resolver->resolve("GWatchTest_Global64");
+	const auto unsized = resolver->resolve("GWatchTest_Unsized");
+	EXPECT_EQ(unsized.address, sized.address);
+	EXPECT_EQ(unsized.size, 8u) << "Size must come from the DWARF type of the aliased variable.";
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_AppliesLoadBias)
+{
+	constexpr std::uint64_t base = 0x555555554000ull;
+	gwatch::ElfSymbolResolver relocated(image.string(), base);
+	const auto linkTime = resolver->resolve("GWatchTest_Global64");
+	const auto runtime = relocated.resolve("GWatchTest_Global64");
+	EXPECT_EQ(runtime.address, linkTime.address + base);
+	EXPECT_EQ(runtime.module, "0x555555554000");
+}
+
+TEST_F(ElfSymbolResolverTest, Resolve_NonExisting_Symbol_Throws)
+{
+	EXPECT_THROW({
+		(void)resolver->resolve("DefinitelyNotExistingSymbol_12345");
+		}, gwatch::SymbolError);
+}
+
+TEST_F(ElfSymbolResolverTest, Rejects_Small_Size)
+{
+	EXPECT_THROW({
+		(void)resolver->resolve("GWatchTest_Small");
+		}, gwatch::SymbolError);
+}
+
+TEST_F(ElfSymbolResolverTest, Rejects_Big_Size)
+{
+	EXPECT_THROW({
+		(void)resolver->resolve("GWatchTest_Big");
+		}, gwatch::SymbolError);
+}
+
+TEST_F(ElfSymbolResolverTest, AnySize_AcceptsObjects_WithArrayElementSize)
+{
+	gwatch::ElfSymbolResolver objects(image.string(), 0, true);
+	const auto array = objects.resolve("GWatchTest_Array");
+	EXPECT_EQ(array.size, 64u);
+	EXPECT_EQ(array.element, 4u) << "Element size must come from the DWARF array type.";
+
+	const auto big = objects.resolve("GWatchTest_Big");
+	EXPECT_EQ(big.size, 16u);
+	EXPECT_EQ(big.element, 0u) << "A struct is not an array.";
+
+	EXPECT_EQ(objects.resolve("GWatchTest_Small").size, 1u);
+}
+
+TEST_F(ElfSymbolResolverTest, AnySize_ResolvesSections_AndListsTheirObjects)
+{
+	gwatch::ElfSymbolResolver objects(image.string(), 0, true);
+	const auto data = objects.resolve(".data");
+	EXPECT_GT(data.size, 0u);
+
+	const auto inside = objects.objects_in(data.address, data.size);
+	const auto named = [&inside](const std::string_view name)
+	{
+		return std::ranges::find(inside, name, &gwatch::ResolvedSymbol::name) != inside.end();
+	};
+	EXPECT_TRUE(named("GWatchTest_Global64"));
+	EXPECT_TRUE(named("GWatchTest_Big"));
+	EXPECT_FALSE(named("GWatchTest_Unsized")) << "Objects without a size cannot name a change.";
+	EXPECT_TRUE(named("GWatchTest_Global32"));
+	EXPECT_FALSE(named("GWatchTest_AliasLocal")) << "A global alias is preferred over a local one.";
+	EXPECT_TRUE(std::ranges::is_sorted(inside, {}, &gwatch::ResolvedSymbol::address));
+
+	const auto bss = objects.resolve(".bss");
+	const auto array = objects.resolve("GWatchTest_Array");
+	EXPECT_GE(array.address, bss.address);
+	EXPECT_LE(array.address + array.size, bss.address + bss.size);
+
+	EXPECT_THROW((void)objects.resolve(".gwatch_missing"), gwatch::SymbolError);
+	EXPECT_THROW((void)resolver->resolve(".data"), gwatch::SymbolError) << "Sections are only regions for the page engines.";
+}
+
+TEST_F(ElfSymbolResolverTest, Functions_AreSortedAndRelocated)
+{
+	constexpr std::uint64_t base = 0x555555554000ull;
+	const gwatch::ElfSymbolResolver linkTime(image.string());
+	const gwatch::ElfSymbolResolver relocated(image.string(), base);
+	const auto functions = linkTime.functions();
+	EXPECT_TRUE(std::ranges::is_sorted(functions, {}, &gwatch::CodeSymbol::address));
+
+	const auto main = std::ranges::find(functions, "main", &gwatch::CodeSymbol::name);
+	ASSERT_NE(main, functions.end());
+	EXPECT_GT(main->size, 0u);
+	const auto moved = relocated.functions();
+	const auto movedMain = std::ranges::find(moved, "main", &gwatch::CodeSymbol::name);
+	ASSERT_NE(movedMain, moved.end());
+	EXPECT_EQ(movedMain->address, main->address + base);
+}
+
+TEST_F(ElfSymbolResolverTest, LineTable_MapsCodeToTheSourceFile)
+{
+	const gwatch::ElfSymbolResolver elf(image.string());
+	const auto functions = elf.functions();
+	const auto main = std::ranges::find(functions, "main", &gwatch::CodeSymbol::name);
+	ASSERT_NE(main, functions.end());
+
+	const gwatch::LineTable lines = elf.line_table();
+	ASSERT_FALSE(lines.rows.empty()) << "The debuggees are built with -g.";
+	EXPECT_TRUE(std::ranges::is_sorted(lines.rows, {}, &gwatch::LineTable::Row::address));
+	const auto row = std::ranges::find_if(lines.rows, [&](const gwatch::LineTable::Row& r)
+	{
+		return r.address >= main->address && r.address < main->address + main->size && r.line != 0;
+	});
+	ASSERT_NE(row, lines.rows.end());
+	ASSERT_LT(row->file, lines.files.size());
+	EXPECT_EQ(lines.files[row->file], "symbols.cpp");
+	EXPECT_GT(row->line, 1u);
+}
+
+TEST(ElfSymbolResolverGnuHash, Resolve_DynamicSymbol)
+{
+	const std::string libc = MappedLibc();
+	if (libc.empty())
+		GTEST_SKIP() << "libc is not mapped from a file.";
+
+	gwatch::ElfSymbolResolver resolver(libc);
+	const auto s = resolver.resolve("stdout");
+	EXPECT_EQ(s.size, sizeof(void*));
+	EXPECT_NE(s.address, 0u);
+}
+
+#else
+
+TEST(ElfSymbolResolverPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "ElfSymbolResolver tests require Linux.";
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#endif
+
+#include "HotSites.h"
+
+using gwatch::AccessKind;
+using gwatch::HotSiteTable;
+using gwatch::SiteSymbolizer;
+namespace x86 = gwatch::x86;
+
+TEST(HotSiteTableTest, AggregatesPerInstructionAndKind)
+{
+	HotSiteTable table(64);
+	for (int i = 0; i < 5; ++i)
+		table.record(0x401000, AccessKind::Write, 10, 0b01);
+	table.record(0x401000, AccessKind::Read, 10, 0b01);
+	table.record(0x401000, AccessKind::Write, 11, 0b10);
+	table.record(0x401008, AccessKind::Read, 10, 0b01);
+
+	EXPECT_EQ(table.size(), 3u);
+	EXPECT_EQ(table.total(), 8u);
+	EXPECT_EQ(table.overflow(), 0u);
+
+	const auto top = table.top(10);
+	ASSERT_EQ(top.size(), 3u);
+	EXPECT_EQ(top[0].ip, 0x401000u);
+	EXPECT_EQ(top[0].kind, AccessKind::Write);
+	EXPECT_EQ(top[0].count, 6u);
+	EXPECT_EQ(top[0].variables, 0b11u);
+	EXPECT_EQ(top[0].tid, 10u);
+	EXPECT_TRUE(top[0].otherThreads);
+
+	// Ties are broken by address, then kind.
+	EXPECT_EQ(top[1].ip, 0x401000u);
+	EXPECT_EQ(top[1].kind, AccessKind::Read);
+	EXPECT_FALSE(top[1].otherThreads);
+	EXPECT_EQ(top[2].ip, 0x401008u);
+}
+
+TEST(HotSiteTableTest, TopKeepsTheMostHit)
+{
+	HotSiteTable table(64);
+	for (std::uint64_t site = 1; site <= 20; ++site)
+	{
+		for (std::uint64_t n = 0; n < site; ++n)
+			table.record(site * 16, AccessKind::Read, 1, 1);
+	}
+
+	const auto top = table.top(3);
+	ASSERT_EQ(top.size(), 3u);
+	EXPECT_EQ(top[0].ip, 320u);
+	EXPECT_EQ(top[1].ip, 304u);
+	EXPECT_EQ(top[2].ip, 288u);
+	EXPECT_EQ(table.top(100).size(), 20u);
+}
+
+TEST(HotSiteTableTest, StaysBoundedAndCountsWhatDidNotFit)
+{
+	HotSiteTable table(10); // 16 entries, 12 sites
+	EXPECT_EQ(table.capacity(), 16u);
+	for (std::uint64_t site = 0; site < 1000; ++site)
+		table.record(0x400000 + site * 4, AccessKind::Write, 1, 1);
+	// Sites already in the table keep counting.
+	table.record(0x400000, AccessKind::Write, 1, 1);
+
+	EXPECT_EQ(table.capacity(), 16u);
+	EXPECT_EQ(table.size(), 12u);
+	EXPECT_EQ(table.total(), 1001u);
+	EXPECT_EQ(table.overflow(), 988u);
+	EXPECT_EQ(table.top(1).front().count, 2u);
+}
+
+TEST(HotSiteTableTest, CountsUndecodedHitsWithoutASite)
+{
+	// A trap the forward decode found no instruction for has no site; its IP is not one.
+	const x86::Instruction undecoded{};
+	const x86::Instruction store{.length = 6, .access = x86::Access::Store, .width = 4, .locked = false, .address = {}, .value = {}};
+	HotSiteTable table;
+	table.record(x86::access_site(store, 0x401006), AccessKind::Write, 1, 1);
+	table.record(x86::access_site(undecoded, 0x401010), AccessKind::Write, 1, 1);
+
+	EXPECT_EQ(table.total(), 2u);
+	EXPECT_EQ(table.undecoded(), 1u);
+	ASSERT_EQ(table.size(), 1u);
+	EXPECT_EQ(table.top(1).front().ip, 0x401000u);
+}
+
+TEST(SiteSymbolizerTest, DescribesFunctionsLinesAndModules)
+{
+	gwatch::LineTable lines;
+	lines.files = {"a.cpp", "b.cpp"};
+	lines.rows = {
+		{.address = 0x1000, .line = 3, .file = 0},
+		{.address = 0x1010, .line = 4, .file = 0},
+		{.address = 0x1040, .line = 9, .file = 1},
+		{.address = 0x1060, .line = 0, .file = 0},
+	};
+	std::vector<gwatch::CodeSymbol> functions = {
+		{.address = 0x1000, .size = 0x40, .name = "_Z6workerv"},
+		{.address = 0x1040, .size = 0x20, .name = "main"},
+	};
+
+	SiteSymbolizer symbolizer;
+	symbolizer.add_module("/usr/bin/app", 0x1000, 0x2000, functions, lines);
+	symbolizer.add_module("/lib/libc.so.6", 0x7000, 0x8000, {}, {});
+
+	EXPECT_EQ(symbolizer.describe(0x1000), "worker()+0x0 (a.cpp:3)");
+	EXPECT_EQ(symbolizer.describe(0x1014), "worker()+0x14 (a.cpp:4)");
+	EXPECT_EQ(symbolizer.describe(0x104a), "main+0xa (b.cpp:9)");
+	// Past the last function and the end of its line sequence.
+	EXPECT_EQ(symbolizer.describe(0x1080), "app+0x80");
+	EXPECT_EQ(symbolizer.describe(0x7123), "libc.so.6+0x123");
+	EXPECT_EQ(symbolizer.describe(0x9000), "0x9000");
+}
+
+#ifdef __linux__
+
+TEST(HotSitesLinuxTest, ReadsTheExecutableImagesOfAProcess)
+{
+	std::error_code ec;
+	const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+	ASSERT_FALSE(ec);
+
+	const auto modules = gwatch::read_code_modules(static_cast<std::uint32_t>(getpid()));
+	const auto it = std::ranges::find(modules, self.string(), &gwatch::CodeModule::path);
+	ASSERT_NE(it, modules.end());
+	const auto here = reinterpret_cast<std::uint64_t>(&gwatch::read_code_modules);
+	EXPECT_LE(it->begin, here);
+	EXPECT_GT(it->end, here);
+	EXPECT_TRUE(std::ranges::is_sorted(modules, {}, &gwatch::CodeModule::begin));
+}
+
+#endif
@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "InstructionDecoder.h"
+
+using namespace gwatch;
+using x86::Access;
+
+namespace
+{
+	x86::Instruction decode(const std::vector<std::uint8_t>& code, const bool x64 = true)
+	{
+		return x86::decode(code, x64);
+	}
+
+	// One function of target code at base, read through the callbacks DecodeCache takes.
+	struct FakeTarget
+	{
+		static constexpr std::uint64_t base = 0x401000;
+		const std::vector<std::uint8_t>& code;
+		mutable int reads = 0;
+
+		explicit FakeTarget(const std::vector<std::uint8_t>& bytes) : code(bytes) {}
+
+		auto locate() const
+		{
+			return [this](const std::uint64_t address) -> std::optional<x86::CodeRange>
+			{
+				if (address < base || address >= base + code.size())
+					return std::nullopt;
+				return x86::CodeRange{.begin = base, .size = code.size()};
+			};
+		}
+
+		auto read() const
+		{
+			return [this](const std::uint64_t address, std::uint8_t* out, const std::size_t size)
+			{
+				++reads;
+				if (address < base || address + size > base + code.size())
+					return false;
+				std::copy_n(code.begin() + static_cast<std::ptrdiff_t>(address - base), size, out);
+				return true;
+			};
+		}
+	};
+
+	void expect(const x86::Instruction& insn, const std::uint8_t length, const Access access, const std::uint16_t width, const bool locked = false)
+	{
+		EXPECT_EQ(insn.length, length);
+		EXPECT_EQ(insn.access, access);
+		EXPECT_EQ(insn.width, width);
+		EXPECT_EQ(insn.locked, locked);
+	}
+}
+
+TEST(InstructionDecoderTest, ClassifiesLoadsStoresAndReadModifyWrites)
+{
+	expect(decode({0x8B, 0x05, 0x10, 0x20, 0x00, 0x00}), 6, Access::Load, 4);                     // mov eax, [rip+0x2010]
+	expect(decode({0x48, 0x89, 0x05, 0x10, 0x20, 0x00, 0x00}), 7, Access::Store, 8);              // mov [rip+0x2010], rax
+	expect(decode({0xC7, 0x05, 0x10, 0x20, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00}), 10, Access::Store, 4); // mov dword [rip+0x2010], 5
+	expect(decode({0x83, 0x05, 0x10, 0x20, 0x00, 0x00, 0x01}), 7, Access::ReadModifyWrite, 4);    // add dword [rip+0x2010], 1
+	expect(decode({0x83, 0x3D, 0x10, 0x20, 0x00, 0x00, 0x00}), 7, Access::Load, 4);               // cmp dword [rip+0x2010], 0
+	expect(decode({0x0F, 0x94, 0x05, 0x10, 0x20, 0x00, 0x00}), 7, Access::Store, 1);              // sete [rip+0x2010]
+	expect(decode({0x0F, 0xB7, 0x00}), 3, Access::Load, 2);                                       // movzx eax, word [rax]
+	expect(decode({0x66, 0x89, 0x4C, 0x98, 0x10}), 5, Access::Store, 2);                          // mov [rax+rbx*4+0x10], cx
+	expect(decode({0x8B, 0x04, 0x25, 0x00, 0x10, 0x60, 0x00}), 7, Access::Load, 4);               // mov eax, [0x601000]
+	expect(decode({0xA3, 1, 2, 3, 4, 5, 6, 7, 8}), 9, Access::Store, 4);                          // mov [moffs64], eax
+	expect(decode({0xF7, 0x05, 0x10, 0x20, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00}), 10, Access::Load, 4); // test dword [rip+0x2010], 0xff
+}
+
+TEST(InstructionDecoderTest, FlagsAtomics)
+{
+	expect(decode({0xF0, 0x48, 0x0F, 0xC1, 0x05, 0x10, 0x20, 0x00, 0x00}), 9, Access::ReadModifyWrite, 8, true); // lock xadd [rip+0x2010], rax
+	expect(decode({0xF0, 0x0F, 0xB1, 0x0D, 0x10, 0x20, 0x00, 0x00}), 8, Access::ReadModifyWrite, 4, true);       // lock cmpxchg [rip+0x2010], ecx
+	expect(decode({0x87, 0x05, 0x10, 0x20, 0x00, 0x00}), 6, Access::ReadModifyWrite, 4, true);                   // xchg [rip+0x2010], eax
+	expect(decode({0xF0, 0x48, 0x0F, 0xC7, 0x0F}), 5, Access::ReadModifyWrite, 16, true);                        // lock cmpxchg16b [rdi]
+
+	// lock on a load or a register operand is #UD.
+	EXPECT_EQ(decode({0xF0, 0x8B, 0x00}).length, 0);
+	EXPECT_EQ(decode({0xF0, 0x01, 0xC0}).length, 0);
+}
+
+TEST(InstructionDecoderTest, DecodesVectorEncodings)
+{
+	expect(decode({0x66, 0x0F, 0xD6, 0x05, 0x10, 0x20, 0x00, 0x00}), 8, Access::Store, 8);      // movq [rip+0x2010], xmm0
+	expect(decode({0xF3, 0x0F, 0x7E, 0x05, 0x10, 0x20, 0x00, 0x00}), 8, Access::Load, 8);       // movq xmm0, [rip+0x2010]
+	expect(decode({0xF2, 0x0F, 0x11, 0x07}), 4, Access::Store, 8);                               // movsd [rdi], xmm0
+	expect(decode({0xC5, 0xF9, 0x7F, 0x07}), 4, Access::Store, 16);                              // vmovdqa [rdi], xmm0
+	expect(decode({0xC5, 0xFD, 0x6F, 0x07}), 4, Access::Load, 32);                               // vmovdqa ymm0, [rdi]
+	expect(decode({0xC4, 0xE3, 0x79, 0x16, 0x07, 0x01}), 6, Access::Store, 4);                   // vpextrd [rdi], xmm0, 1
+	expect(decode({0x62, 0xF1, 0x7C, 0x48, 0x11, 0x07}), 6, Access::Store, 64);                  // vmovups [rdi], zmm0
+	expect(decode({0xC5, 0xF8, 0x77}), 3, Access::None, 0);                                      // vzeroupper
+}
+
+TEST(InstructionDecoderTest, RegisterFormsAndAddressComputationsTouchNoMemory)
+{
+	expect(decode({0x89, 0xC0}), 2, Access::None, 0);                                    // mov eax, eax
+	expect(decode({0x48, 0x8D, 0x05, 0x10, 0x20, 0x00, 0x00}), 7, Access::None, 0);     // lea rax, [rip+0x2010]
+	expect(decode({0x0F, 0x18, 0x0F}), 3, Access::None, 0);                              // prefetcht0 [rdi]
+	expect(decode({0xE8, 0x00, 0x00, 0x00, 0x00}), 5, Access::None, 0);                  // call rel32
+}
+
+TEST(InstructionDecoderTest, RejectsInvalidAndTruncatedCode)
+{
+	EXPECT_EQ(decode({0x0F, 0x04}).length, 0);
+	EXPECT_EQ(decode({0x8B, 0x05, 0x10}).length, 0);
+	EXPECT_EQ(decode({0x06}).length, 0);           // push es, 32-bit only
+	EXPECT_EQ(decode({0x48, 0x66, 0x90}).length, 0); // REX before a prefix
+	EXPECT_EQ(decode(std::vector<std::uint8_t>(16, 0x66)).length, 0);
+	EXPECT_EQ(decode({}).length, 0);
+}
+
+TEST(InstructionDecoderTest, Decodes32BitMode)
+{
+	expect(decode({0x40}, false), 1, Access::None, 0);                                             // inc eax
+	expect(decode({0xC7, 0x05, 0x00, 0x10, 0x60, 0x00, 0x05, 0x00, 0x00, 0x00}, false), 10, Access::Store, 4);
+	expect(decode({0xA1, 0x00, 0x10, 0x60, 0x00}, false), 5, Access::Load, 4);                     // mov eax, [moffs32]
+	expect(decode({0x67, 0x8B, 0x46, 0x10}, false), 4, Access::Load, 4);                           // mov eax, [bp+0x10]
+}
+
+TEST(InstructionDecoderTest, RebuildsTheAddressFromTheRegistersLeftBehind)
+{
+	std::array<std::uint64_t, x86::kRegisters> regs{};
+	regs[0] = 0x1000;   // rax
+	regs[1] = 3;        // rcx
+	regs[2] = 0x5000;   // rdx
+	regs[6] = 0x2000;   // rsi
+	regs[12] = 0x3000;  // r12
+	const auto address = [&](const std::vector<std::uint8_t>& code, const std::uint64_t ip, const bool x64 = true)
+	{
+		return x86::effective_address(decode(code, x64), ip, regs);
+	};
+
+	EXPECT_EQ(address({0x48, 0x8B, 0x05, 0x10, 0x20, 0x00, 0x00}, 0x401007), 0x403017u); // mov rax, [rip+0x2010]
+	EXPECT_EQ(address({0x89, 0x44, 0x8E, 0xF8}, 0), 0x2000u + 3 * 4 - 8);                 // mov [rsi+rcx*4-8], eax
+	EXPECT_EQ(address({0x41, 0x89, 0x04, 0x24}, 0), 0x3000u);                           // mov [r12], eax
+	EXPECT_EQ(address({0xF0, 0x0F, 0xB1, 0x0A}, 0), 0x5000u);                           // lock cmpxchg [rdx], ecx
+	EXPECT_EQ(address({0x89, 0x0D, 0x00, 0x10, 0x60, 0x00}, 0, false), 0x601000u);      // mov [0x601000], ecx
+
+	// Registers the instruction wrote no longer hold the address; FS/GS bases are not known.
+	EXPECT_FALSE(address({0x8B, 0x00}, 0));                                             // mov eax, [rax]
+	EXPECT_FALSE(address({0xF0, 0x0F, 0xB1, 0x08}, 0));                                 // lock cmpxchg [rax], ecx
+	EXPECT_FALSE(address({0x8A, 0x20}, 0));                                             // mov ah, [rax]
+	EXPECT_FALSE(address({0x64, 0x8B, 0x04, 0x25, 0x28, 0x00, 0x00, 0x00}, 0));         // mov eax, fs:[0x28]
+	EXPECT_FALSE(address({0xA1, 0x00, 0x10, 0x60, 0x00}, 0, false));                    // mov eax, [moffs32]
+}
+
+TEST(InstructionDecoderTest, ReadsTheValueAMoveLeftBehind)
+{
+	std::array<std::uint64_t, x86::kRegisters> regs{};
+	regs[0] = 0x1122334455667788; // rax
+	regs[1] = 0xFFFFFFFFFFFFFF85; // rcx, movsx of 0x85
+	regs[3] = 0xABCD;             // rbx
+	regs[9] = 42;                 // r9
+	const auto value = [&](const std::vector<std::uint8_t>& code, const bool x64 = true)
+	{
+		return x86::moved_value(decode(code, x64), regs);
+	};
+
+	EXPECT_EQ(value({0x48, 0x89, 0x05, 0x00, 0x10, 0x00, 0x00}), 0x1122334455667788u); // mov [rip+0x1000], rax
+	EXPECT_EQ(value({0x89, 0x03}), 0x55667788u);                                       // mov [rbx], eax
+	EXPECT_EQ(value({0x4C, 0x89, 0x0B}), 42u);                                         // mov [rbx], r9
+	EXPECT_EQ(value({0x88, 0x3B}), 0xABu);                                             // mov [rbx], bh
+	EXPECT_EQ(value({0x8B, 0x00}), 0x55667788u);                                       // mov eax, [rax]
+	EXPECT_EQ(value({0x0F, 0xBE, 0x0B}), 0x85u);                                       // movsx ecx, byte [rbx]
+	EXPECT_EQ(value({0xC7, 0x03, 0x04, 0x00, 0x00, 0x00}), 4u);                        // mov dword [rbx], 4
+	EXPECT_EQ(value({0x48, 0xC7, 0x03, 0xFF, 0xFF, 0xFF, 0xFF}), ~0ull);               // mov qword [rbx], -1
+	EXPECT_EQ(value({0x66, 0xC7, 0x03, 0x34, 0x12}), 0x1234u);                         // mov word [rbx], 0x1234
+	EXPECT_EQ(value({0xA3, 0x00, 0x10, 0x60, 0x00}, false), 0x55667788u);              // mov [moffs32], eax
+
+	// Anything but a plain move leaves no copy of the old or new value.
+	EXPECT_FALSE(value({0x01, 0x03}));             // add [rbx], eax
+	EXPECT_FALSE(value({0xF0, 0x0F, 0xC1, 0x03})); // lock xadd [rbx], eax
+	EXPECT_FALSE(value({0x87, 0x03}));             // xchg [rbx], eax
+	EXPECT_FALSE(value({0x3B, 0x03}));             // cmp eax, [rbx]
+	EXPECT_FALSE(value({0x0F, 0x11, 0x03}));       // movups [rbx], xmm0
+}
+
+TEST(InstructionDecoderTest, DecodesATrapForwardFromItsFunction)
+{
+	// push rbp; mov rbp, rsp; mov r12d, [rip+0x11FB8C]; mov [rbp-8], 0x40; mov [rbp-12], 0x40.
+	// "11 00" and "40 00 00 00" also decode as instructions ending at the same IPs.
+	const std::vector<std::uint8_t> code = {
+		0x55,
+		0x48, 0x89, 0xE5,
+		0x44, 0x8B, 0x25, 0x8C, 0xFB, 0x11, 0x00,
+		0xC7, 0x45, 0xF8, 0x40, 0x00, 0x00, 0x00,
+		0xC7, 0x45, 0xF4, 0x40, 0x00, 0x00, 0x00,
+	};
+	const FakeTarget target(code);
+
+	x86::DecodeCache cache(true);
+	expect(cache.classify(target.base + 11, target.locate(), target.read()), 7, Access::Load, 4);
+	expect(cache.classify(target.base + 18, target.locate(), target.read()), 7, Access::Store, 4);
+	expect(cache.classify(target.base + 25, target.locate(), target.read()), 7, Access::Store, 4);
+	// No instruction ends there: the trap stays unclassified rather than guessed.
+	EXPECT_EQ(cache.classify(target.base + 10, target.locate(), target.read()).access, Access::Unknown);
+	EXPECT_EQ(target.reads, 1);
+}
+
+TEST(InstructionDecoderTest, LeavesTrapsOutsideAnyFunctionUnclassified)
+{
+	const std::vector<std::uint8_t> code = {0x89, 0x05, 0x10, 0x20, 0x00, 0x00}; // mov [rip+0x2010], eax
+	const FakeTarget target(code);
+	const auto nowhere = [](std::uint64_t) -> std::optional<x86::CodeRange> { return std::nullopt; };
+
+	x86::DecodeCache cache(true);
+	const x86::Instruction insn = cache.classify(target.base + code.size(), nowhere, target.read());
+	EXPECT_EQ(insn.length, 0);
+	EXPECT_EQ(insn.access, Access::Unknown);
+	EXPECT_EQ(target.reads, 0);
+}
+
+TEST(InstructionDecoderTest, RetriesAFunctionWhoseCodeCouldNotBeRead)
+{
+	const std::vector<std::uint8_t> code = {0x90, 0xF0, 0x0F, 0xC1, 0x05, 0x10, 0x20, 0x00, 0x00};
+	const FakeTarget target(code);
+	bool readable = false;
+	const auto read = [&](const std::uint64_t address, std::uint8_t* out, const std::size_t size) { return readable && target.read()(address, out, size); };
+
+	x86::DecodeCache cache(true);
+	const std::uint64_t ip = target.base + code.size();
+	EXPECT_EQ(cache.classify(ip, target.locate(), read).access, Access::Unknown);
+	EXPECT_EQ(cache.size(), 0u);
+	readable = true;
+	expect(cache.classify(ip, target.locate(), read), 8, Access::ReadModifyWrite, 4, true);
+	expect(cache.classify(ip, target.locate(), read), 8, Access::ReadModifyWrite, 4, true);
+	EXPECT_EQ(cache.hits(), 1u);
+	EXPECT_EQ(target.reads, 1);
+}
+
+TEST(InstructionDecoderTest, ClassifiesFaultsAtTheInstructionItself)
+{
+	// mov word [rip+0x2010], 7, then nops so that a whole instruction length can be read.
+	std::vector<std::uint8_t> code = {0x66, 0xC7, 0x05, 0x10, 0x20, 0x00, 0x00, 0x07, 0x00};
+	code.resize(code.size() + x86::kMaxInstructionLength, 0x90);
+	const FakeTarget target(code);
+
+	x86::DecodeCache cache(true);
+	for (int i = 0; i < 2; ++i)
+		expect(cache.classify_fault(target.base, target.read()), 9, Access::Store, 2);
+	EXPECT_EQ(target.reads, 1);
+	// Unreadable code is not memoized: the next fault there reads again.
+	EXPECT_EQ(cache.classify_fault(target.base + code.size() - 1, target.read()).length, 0);
+	EXPECT_EQ(cache.classify_fault(target.base + code.size() - 1, target.read()).length, 0);
+	EXPECT_EQ(target.reads, 3);
+}
+
+TEST(InstructionDecoderTest, CachesOneDecodePerFunction)
+{
+	const std::vector<std::uint8_t> code = {0x90, 0xF0, 0x0F, 0xC1, 0x05, 0x10, 0x20, 0x00, 0x00};
+	const FakeTarget target(code);
+
+	x86::DecodeCache cache(true);
+	const std::uint64_t ip = target.base + code.size();
+	for (int i = 0; i < 3; ++i)
+		expect(cache.classify(ip, target.locate(), target.read()), 8, Access::ReadModifyWrite, 4, true);
+	// An IP the decode found no instruction ending at does not decode the function again.
+	EXPECT_EQ(cache.classify(target.base + 3, target.locate(), target.read()).access, Access::Unknown);
+	EXPECT_EQ(cache.size(), 2u);
+	EXPECT_EQ(cache.hits(), 2u);
+	EXPECT_EQ(target.reads, 1);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MemoryWatcher.h"
+#include "ProcessLauncher.h"
+#include "SymbolResolver.h"
+
+using namespace gwatch;
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	// Resolves the regions and the globals inside them once the image is mapped.
+	struct DirtySink final : IDebugEventSink
+	{
+		LinuxProcessLauncher& launcher;
+		std::vector<std::string> names;
+		std::unique_ptr<LinuxDirtyPageWatcher> watcher;
+
+		DirtySink(LinuxProcessLauncher& l, std::vector<std::string> n) : launcher(l), names(std::move(n)) {}
+
+		ContinueStatus on_event(const DebugEvent& ev) override
+		{
+			if (!watcher)
+			{
+				if (ev.type != DebugEventType::_CreateProcess)
+					return ContinueStatus::Default;
+				const auto& cp = std::get<CreateProcessInfo>(ev.payload);
+				ElfSymbolResolver resolver(std::string(launcher.strings().view(cp.image_path)), cp.image_base, true);
+				std::vector<ResolvedSymbol> regions;
+				std::vector<ResolvedSymbol> globals;
+				for (const auto& name : names)
+				{
+					regions.push_back(resolver.resolve(name));
+					for (auto& global : resolver.objects_in(regions.back().address, regions.back().size))
+						globals.push_back(std::move(global));
+				}
+				watcher = std::make_unique<LinuxDirtyPageWatcher>(launcher.pid(), regions, globals, DirtyWatchOptions{.interval_us = 1'000});
+			}
+			return watcher->on_event(ev);
+		}
+	};
+
+	struct DirtyRun
+	{
+		std::optional<std::uint32_t> exitCode;
+		std::vector<std::string> lines;
+		std::uint64_t scans = 0;
+		std::uint64_t pagesDiffed = 0;
+		std::size_t watchedPages = 0;
+		bool softDirty = false;
+	};
+
+	DirtyRun run_dirty(const std::vector<std::string>& names)
+	{
+		const auto exe = CurrentModuleDir() / "gwatch_debuggee_dirty";
+		LinuxProcessLauncher launcher;
+		launcher.launch(LaunchConfig{.exe_path = exe.string(), .args = {}, .workdir = std::nullopt});
+		DirtySink sink(launcher, names);
+
+		DirtyRun run;
+		testing::internal::CaptureStdout();
+		run.exitCode = drive_debug_loop(launcher, sink);
+		std::istringstream out(testing::internal::GetCapturedStdout());
+		for (std::string line; std::getline(out, line);)
+			run.lines.push_back(line);
+		if (sink.watcher)
+		{
+			run.scans = sink.watcher->scans();
+			run.pagesDiffed = sink.watcher->pages_diffed();
+			run.watchedPages = sink.watcher->watched_pages();
+			run.softDirty = sink.watcher->soft_dirty();
+		}
+		return run;
+	}
+
+	std::vector<std::string> lines_of(const DirtyRun& run, const std::string& name)
+	{
+		std::vector<std::string> out;
+		for (const auto& line : run.lines)
+		{
+			if (line.starts_with(name + " "))
+				out.push_back(line);
+		}
+		return out;
+	}
+
+	alignas(4096) std::uint64_t g_ownRegion[1024] = {};
+}
+
+TEST(LinuxDirtyPageWatcherTest, NamesChangesByGlobalThenByRegionOffset)
+{
+	// Our own process as the target; with a long interval only the final scan runs.
+	const auto base = reinterpret_cast<std::uint64_t>(&g_ownRegion[0]);
+	const ResolvedSymbol region{.name = "region", .module = {}, .address = base, .size = sizeof(g_ownRegion)};
+	const std::vector<ResolvedSymbol> globals = {
+		ResolvedSymbol{.name = "word", .module = {}, .address = base + 16, .size = 8},
+		ResolvedSymbol{.name = "table", .module = {}, .address = base + 4096, .size = 64},
+	};
+	LinuxDirtyPageWatcher watcher(static_cast<std::uint32_t>(getpid()), {region}, globals, DirtyWatchOptions{.interval_us = 60'000'000});
+	EXPECT_EQ(watcher.watched_pages(), 2u);
+
+	testing::internal::CaptureStdout();
+	watcher.start();
+	g_ownRegion[2] = 3;        // word
+	g_ownRegion[2] = 4;        // collapses with the store above
+	g_ownRegion[5] = 6;        // region+40
+	g_ownRegion[512 + 1] = 9;  // table+8, on the second page
+	watcher.stop();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(out,
+	          "word write 0 -> 4\n"
+	          "region+40 write 0 -> 6\n"
+	          "table+8 write 0 -> 9\n");
+	EXPECT_EQ(watcher.changes(), 3u);
+}
+
+TEST(LinuxDirtyPageWatcherTest, LogsChangesOfWatchedObjects)
+{
+	const DirtyRun run = run_dirty({"g_dirty_counter", "g_dirty_flags"});
+
+	EXPECT_EQ(run.exitCode, 7u);
+	EXPECT_GT(run.scans, 0u);
+	const auto counter = lines_of(run, "g_dirty_counter");
+	ASSERT_FALSE(counter.empty());
+	EXPECT_LE(counter.size(), 2u);
+	EXPECT_TRUE(counter.front().starts_with("g_dirty_counter write 0 -> ")) << counter.front();
+	EXPECT_TRUE(counter.back().ends_with("-> 2")) << counter.back();
+	EXPECT_EQ(lines_of(run, "g_dirty_flags[2]"), std::vector<std::string>{"g_dirty_flags[2] write 0 -> 5"});
+}
+
+TEST(LinuxDirtyPageWatcherTest, WatchesAWholeSection)
+{
+	const DirtyRun run = run_dirty({".bss"});
+
+	EXPECT_EQ(run.exitCode, 7u);
+	const auto counter = lines_of(run, "g_dirty_counter");
+	ASSERT_FALSE(counter.empty());
+	EXPECT_TRUE(counter.back().ends_with("-> 2")) << counter.back();
+	// Symbol table globals carry no element size: reported by 8-byte word.
+	EXPECT_EQ(lines_of(run, "g_dirty_flags+8"), std::vector<std::string>{"g_dirty_flags+8 write 0 -> 5"});
+	EXPECT_TRUE(lines_of(run, "g_dirty_table").empty());
+}
+
+TEST(LinuxDirtyPageWatcherTest, DiffsOnlyDirtyPages)
+{
+	const DirtyRun run = run_dirty({"g_dirty_table", "g_dirty_counter"});
+
+	EXPECT_EQ(run.exitCode, 7u);
+	EXPECT_EQ(run.watchedPages, 9u);
+	ASSERT_GT(run.scans, 1u);
+	if (run.softDirty)
+	{
+		// The table is never written: only the counter page shows up, the final scan diffs all.
+		EXPECT_LT(run.pagesDiffed, (run.scans - 1) * 2 + run.watchedPages);
+	}
+	else
+	{
+		EXPECT_EQ(run.softDirty, LinuxDirtyPageWatcher::soft_dirty_supported());
+		EXPECT_EQ(run.pagesDiffed, run.scans * run.watchedPages);
+	}
+}
+
+TEST(LinuxDirtyPageWatcherTest, RejectsEmptyRegion)
+{
+	EXPECT_THROW(LinuxDirtyPageWatcher(1, {ResolvedSymbol{.name = "x", .module = {}, .address = 0x1000, .size = 0}}), MemoryWatchError);
+	EXPECT_THROW(LinuxDirtyPageWatcher(1, std::vector<ResolvedSymbol>{}), MemoryWatchError);
+}
+
+#else
+
+TEST(LinuxDirtyPageWatcherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "LinuxDirtyPageWatcher tests require Linux.";
+}
+
+#endif
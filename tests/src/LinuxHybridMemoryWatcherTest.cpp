@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MemoryWatcher.h"
+#include "ProcessLauncher.h"
+#include "SymbolResolver.h"
+
+using namespace gwatch;
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	struct HybridSink final : IDebugEventSink
+	{
+		LinuxProcessLauncher& launcher;
+		std::vector<std::string> names;
+		HybridWatchOptions options;
+		std::unique_ptr<LinuxHybridMemoryWatcher> watcher;
+
+		HybridSink(LinuxProcessLauncher& l, std::vector<std::string> n, const HybridWatchOptions& o) : launcher(l), names(std::move(n)), options(o) {}
+
+		ContinueStatus on_event(const DebugEvent& ev) override
+		{
+			if (!watcher)
+			{
+				if (ev.type != DebugEventType::_CreateProcess)
+					return ContinueStatus::Default;
+				const auto& cp = std::get<CreateProcessInfo>(ev.payload);
+				ElfSymbolResolver resolver(std::string(launcher.strings().view(cp.image_path)), cp.image_base);
+				std::vector<ResolvedSymbol> symbols;
+				for (const auto& name : names)
+					symbols.push_back(resolver.resolve(name));
+				watcher = std::make_unique<LinuxHybridMemoryWatcher>(launcher.pid(), symbols, options);
+			}
+			return watcher->on_event(ev);
+		}
+	};
+
+	struct HybridRun
+	{
+		std::optional<std::uint32_t> exitCode;
+		std::vector<std::string> lines;
+		std::string summaries;
+		std::vector<LinuxHybridMemoryWatcher::ThreadCounts> counts;
+	};
+
+	HybridRun run_hybrid(const std::vector<std::string>& names, const std::string& iterations, const HybridWatchOptions& options = {})
+	{
+		const auto exe = CurrentModuleDir() / "gwatch_debuggee_reads";
+		LinuxProcessLauncher launcher;
+		launcher.launch(LaunchConfig{.exe_path = exe.string(), .args = {iterations}, .workdir = std::nullopt});
+		HybridSink sink(launcher, names, options);
+
+		HybridRun run;
+		testing::internal::CaptureStdout();
+		testing::internal::CaptureStderr();
+		run.exitCode = drive_debug_loop(launcher, sink);
+		run.summaries = testing::internal::GetCapturedStderr();
+		std::istringstream out(testing::internal::GetCapturedStdout());
+		for (std::string line; std::getline(out, line);)
+			run.lines.push_back(line);
+		if (sink.watcher)
+			run.counts = sink.watcher->counts();
+		return run;
+	}
+}
+
+TEST(LinuxHybridMemoryWatcherTest, LogsEveryWriteAndCountsReadsPerThread)
+{
+	const HybridRun run = run_hybrid({"g_reads_config", "g_reads_hits"}, "1000");
+
+	EXPECT_EQ(run.exitCode, 3u);
+	EXPECT_EQ(run.lines, (std::vector<std::string>{
+		"g_reads_config write 3 -> 4",
+		"g_reads_config write 4 -> 5",
+		"g_reads_hits write 0 -> 1",
+		"g_reads_hits write 1 -> 2",
+		"g_reads_hits write 2 -> 3",
+		"g_reads_config write 5 -> 6",
+	}));
+
+	// Main thread, then the reader thread.
+	ASSERT_EQ(run.counts.size(), 2u);
+	const auto& main = run.counts[0];
+	const auto& reader = run.counts[1];
+	EXPECT_EQ(main.writes, (std::array<std::uint64_t, 2>{3, 3}));
+	EXPECT_EQ(main.reads[0], 2'000u);
+	EXPECT_EQ(main.reads[1], 4u); // one per increment, one for the exit code
+	EXPECT_EQ(reader.writes, (std::array<std::uint64_t, 2>{0, 0}));
+	EXPECT_EQ(reader.reads[0], 1'000u);
+	EXPECT_EQ(reader.reads[1], 0u);
+
+	std::ostringstream total;
+	total << "reads: total tid=" << main.tid << " g_reads_config=2000 g_reads_hits=4\n";
+	EXPECT_NE(run.summaries.find(total.str()), std::string::npos) << run.summaries;
+}
+
+TEST(LinuxHybridMemoryWatcherTest, ZeroIntervalOnlySummarizesAtExit)
+{
+	const HybridRun run = run_hybrid({"g_reads_hits", "g_reads_config"}, "10", HybridWatchOptions{.summary_interval_ms = 0});
+
+	EXPECT_EQ(run.exitCode, 3u);
+	ASSERT_EQ(run.counts.size(), 2u);
+	EXPECT_EQ(run.counts[0].reads, (std::array<std::uint64_t, 2>{4, 20}));
+	EXPECT_EQ(run.summaries.find("reads: t="), std::string::npos) << run.summaries;
+	EXPECT_NE(run.summaries.find(" g_reads_hits=4 g_reads_config=20\n"), std::string::npos) << run.summaries;
+}
+
+TEST(LinuxHybridMemoryWatcherTest, RejectsInvalidVariables)
+{
+	EXPECT_THROW(LinuxHybridMemoryWatcher(1, std::vector<ResolvedSymbol>{}), MemoryWatchError);
+	EXPECT_THROW(LinuxHybridMemoryWatcher(1, {ResolvedSymbol{.name = "x", .module = {}, .address = 0x1000, .size = 2}}), MemoryWatchError);
+	EXPECT_THROW(LinuxHybridMemoryWatcher(0, {ResolvedSymbol{.name = "x", .module = {}, .address = 0x1000, .size = 8}}), MemoryWatchError);
+}
+
+#else
+
+TEST(LinuxHybridMemoryWatcherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "LinuxHybridMemoryWatcher tests require Linux.";
+}
+
+#endif
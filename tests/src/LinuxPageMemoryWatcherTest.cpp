@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MemoryWatcher.h"
+#include "ProcessLauncher.h"
+#include "SymbolResolver.h"
+
+using namespace gwatch;
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	// Resolves the objects once the image is mapped and forwards everything to the watcher.
+	struct PagesSink final : IDebugEventSink
+	{
+		LinuxProcessLauncher& launcher;
+		std::vector<std::string> names;
+		std::vector<ResolvedSymbol> symbols;
+		std::unique_ptr<LinuxPageMemoryWatcher> watcher;
+
+		PagesSink(LinuxProcessLauncher& l, std::vector<std::string> n) : launcher(l), names(std::move(n)) {}
+
+		ContinueStatus on_event(const DebugEvent& ev) override
+		{
+			if (!watcher)
+			{
+				if (ev.type != DebugEventType::_CreateProcess)
+					return ContinueStatus::Default;
+				const auto& cp = std::get<CreateProcessInfo>(ev.payload);
+				ElfSymbolResolver resolver(std::string(launcher.strings().view(cp.image_path)), cp.image_base, true);
+				for (const auto& name : names)
+					symbols.push_back(resolver.resolve(name));
+				watcher = std::make_unique<LinuxPageMemoryWatcher>(launcher.pid(), symbols);
+			}
+			return watcher->on_event(ev);
+		}
+	};
+
+	struct PagesRun
+	{
+		std::optional<std::uint32_t> exitCode;
+		std::string out;
+		std::uint64_t hits = 0;
+		std::uint64_t falseSharing = 0;
+		std::vector<ResolvedSymbol> symbols;
+	};
+
+	PagesRun run_pages(const std::vector<std::string>& names)
+	{
+		const auto exe = CurrentModuleDir() / "gwatch_debuggee_pages";
+		LinuxProcessLauncher launcher;
+		launcher.launch(LaunchConfig{.exe_path = exe.string(), .args = {}, .workdir = std::nullopt});
+		PagesSink sink(launcher, names);
+
+		PagesRun run;
+		testing::internal::CaptureStdout();
+		run.exitCode = drive_debug_loop(launcher, sink);
+		run.out = testing::internal::GetCapturedStdout();
+		run.hits = sink.watcher ? sink.watcher->hits() : 0;
+		run.falseSharing = sink.watcher ? sink.watcher->false_sharing() : 0;
+		run.symbols = sink.symbols;
+		return run;
+	}
+}
+
+TEST(LinuxPageMemoryWatcherTest, LogsEachElementWrittenInARingBuffer)
+{
+	const PagesRun run = run_pages({"g_ring"});
+
+	EXPECT_EQ(run.exitCode, 23u);
+	std::ostringstream expected;
+	for (std::uint32_t i = 0; i < 8; ++i)
+		expected << "g_ring[" << i * 3 << "] write 0 -> " << i + 1 << "\n";
+	EXPECT_EQ(run.out, expected.str());
+	EXPECT_EQ(run.hits, 8u);
+}
+
+TEST(LinuxPageMemoryWatcherTest, CountsNeighbourStoresAsFalseSharing)
+{
+	const PagesRun run = run_pages({"g_ring", "g_noise"});
+	ASSERT_EQ(run.symbols.size(), 2u);
+	const ResolvedSymbol& ring = run.symbols[0];
+
+	const PagesRun ringOnly = run_pages({"g_ring"});
+	const auto page = [](const std::uint64_t address) { return address & ~0xFFFull; };
+	if (page(ring.address) != page(run.symbols[1].address))
+	{
+		GTEST_SKIP() << "g_noise was not laid out on the page of g_ring.";
+	}
+	// Watching g_noise too turns its 8 stores from false sharing into hits.
+	EXPECT_EQ(run.hits, 16u);
+	EXPECT_EQ(ringOnly.hits, 8u);
+	EXPECT_EQ(ringOnly.falseSharing, run.falseSharing + 8);
+	EXPECT_EQ(ringOnly.exitCode, 23u);
+}
+
+TEST(LinuxPageMemoryWatcherTest, ReportsTheStoredFieldOfStructElements)
+{
+	const PagesRun run = run_pages({"g_table"});
+
+	// value is at +4 and neither key nor the other fields show up; a byte store is one byte.
+	EXPECT_EQ(run.exitCode, 23u);
+	EXPECT_EQ(run.out,
+	          "g_table[2]+4 write 0 -> 7\n"
+	          "g_table[1]+8 write 0 -> 9\n"
+	          "g_table[3]+9 write 0 -> 1\n");
+	EXPECT_EQ(run.hits, 3u);
+}
+
+TEST(LinuxPageMemoryWatcherTest, RejectsEmptyObject)
+{
+	EXPECT_THROW(LinuxPageMemoryWatcher(1, {ResolvedSymbol{.name = "x", .module = {}, .address = 0x1000, .size = 0}}), MemoryWatchError);
+	EXPECT_THROW(LinuxPageMemoryWatcher(1, std::vector<ResolvedSymbol>{}), MemoryWatchError);
+}
+
+#else
+
+TEST(LinuxPageMemoryWatcherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "LinuxPageMemoryWatcher tests require Linux.";
+}
+
+#endif
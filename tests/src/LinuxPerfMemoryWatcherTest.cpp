@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "MemoryWatcher.h"
+#include "Logger.h"
+
+using namespace gwatch;
+
+#ifdef __linux__
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	ResolvedSymbol create_resolve_symbol(const std::uint64_t address, const std::uint64_t size, const std::string& name)
+	{
+		return ResolvedSymbol{
+				.name = name,
+				.module = {},
+				.address = address,
+				.size = size,
+			};
+	}
+
+	// Global storage watched through perf breakpoints armed on this very process.
+	alignas(8) volatile std::uint64_t g_perf64 = 0;
+	alignas(4) volatile std::uint32_t g_perf32 = 0;
+	alignas(8) volatile std::uint32_t g_packed[6] = {};
+	// One variable per 64 bytes: no two share a word, so five need two rotation groups.
+	alignas(64) volatile std::uint64_t g_spread[5][8] = {};
+
+	PerfWatchOptions eager_options()
+	{
+		// Wake the drain thread on every sample so each write is drained before the next one.
+		PerfWatchOptions opts;
+		opts.wakeup_events = 1;
+		opts.poll_timeout_ms = 1;
+		return opts;
+	}
+
+	void settle()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	}
+}
+
+TEST(LinuxPerfMemoryWatcherTest, SamplesWritesWithoutStopping)
+{
+	g_perf64 = 0;
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()), create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "perf64"), eager_options());
+
+	try
+	{
+		mw.on_event(DebugEvent{.type = DebugEventType::_CreateProcess, .payload = CreateProcessInfo{}});
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	testing::internal::CaptureStdout();
+	for (std::uint64_t i = 1; i <= 3; ++i)
+	{
+		g_perf64 = i;
+		settle();
+	}
+	mw.on_event(DebugEvent{.type = DebugEventType::ExitProcess, .payload = ExitProcessInfo{}});
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(mw.samples(), 3u);
+	EXPECT_EQ(mw.lost(), 0u);
+	EXPECT_EQ(out,
+	          "perf64 write 0 -> 1\n"
+	          "perf64 write 1 -> 2\n"
+	          "perf64 write 2 -> 3\n");
+}
+
+TEST(LinuxPerfMemoryWatcherTest, UnchangedValueIsRead)
+{
+	g_perf64 = 9;
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()), create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "perf64"), eager_options());
+
+	try
+	{
+		mw.start();
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	testing::internal::CaptureStdout();
+	const std::uint64_t seen = g_perf64;
+	settle();
+	mw.stop();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(seen, 9u);
+	EXPECT_EQ(out, "perf64 read 9\n");
+}
+
+TEST(LinuxPerfMemoryWatcherTest, ClassifiesByInstructionNotByValue)
+{
+	g_perf64 = 4;
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()), create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "perf64"), eager_options());
+
+	try
+	{
+		mw.on_event(DebugEvent{.type = DebugEventType::_CreateProcess, .payload = CreateProcessInfo{}});
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	testing::internal::CaptureStdout();
+	g_perf64 = 4;                                            // store of the same value
+	settle();
+	__atomic_fetch_add(&g_perf64, 0, __ATOMIC_SEQ_CST);      // locked read-modify-write netting to zero
+	settle();
+	const std::uint64_t seen = g_perf64;
+	settle();
+	mw.on_event(DebugEvent{.type = DebugEventType::ExitProcess, .payload = ExitProcessInfo{}});
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	// The store left its value in a register; the read-modify-write left none, so it is a
+	// write of unknown values and not "4 -> 4" read back after the fact.
+	EXPECT_EQ(seen, 4u);
+	EXPECT_EQ(out,
+	          "perf64 write 4 -> 4\n"
+	          "perf64 write ?\n"
+	          "perf64 read 4\n");
+}
+
+TEST(LinuxPerfMemoryWatcherTest, AttributesSamplesToEachVariable)
+{
+	g_perf64 = 0;
+	g_perf32 = 0;
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()),
+	                          std::vector{
+		                          create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "perf64"),
+		                          create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf32), 4, "perf32"),
+	                          },
+	                          eager_options());
+
+	try
+	{
+		mw.on_event(DebugEvent{.type = DebugEventType::_CreateProcess, .payload = CreateProcessInfo{}});
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	testing::internal::CaptureStdout();
+	g_perf32 = 7;
+	settle();
+	g_perf64 = 1;
+	settle();
+	g_perf32 = 8;
+	settle();
+	mw.on_event(DebugEvent{.type = DebugEventType::ExitProcess, .payload = ExitProcessInfo{}});
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(mw.samples(), 3u);
+	EXPECT_EQ(out,
+	          "perf32 write 0 -> 7\n"
+	          "perf64 write 0 -> 1\n"
+	          "perf32 write 7 -> 8\n");
+}
+
+TEST(LinuxPerfMemoryWatcherTest, DemultiplexesVariablesSharingASlot)
+{
+	std::vector<ResolvedSymbol> symbols;
+	for (std::size_t i = 0; i < 6; ++i)
+	{
+		g_packed[i] = 0;
+		symbols.push_back(create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_packed[i]), 4, "packed" + std::to_string(i)));
+	}
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()), symbols, eager_options());
+	// Three words for four slots: only the first word can be split, the other two are shared.
+	ASSERT_EQ(mw.plan().slots.size(), 4u);
+	ASSERT_TRUE(mw.plan().uncovered.empty());
+
+	try
+	{
+		mw.on_event(DebugEvent{.type = DebugEventType::_CreateProcess, .payload = CreateProcessInfo{}});
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	// The address each instruction accessed names the variable, even when no value changed.
+	testing::internal::CaptureStdout();
+	g_packed[3] = 5;
+	settle();
+	const std::uint32_t seen = g_packed[2];
+	settle();
+	g_packed[5] = 0;
+	settle();
+	mw.on_event(DebugEvent{.type = DebugEventType::ExitProcess, .payload = ExitProcessInfo{}});
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(seen, 0u);
+	EXPECT_EQ(mw.unattributed(), 0u);
+	EXPECT_EQ(out,
+	          "packed3 write 0 -> 5\n"
+	          "packed2 read 0\n"
+	          "packed5 write 0 -> 0\n");
+}
+
+TEST(LinuxPerfMemoryWatcherTest, RotatesGroupsAndEstimatesEveryVariable)
+{
+	std::vector<ResolvedSymbol> symbols;
+	for (std::size_t i = 0; i < 5; ++i)
+		symbols.push_back(create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_spread[i][0]), 8, "spread" + std::to_string(i)));
+	PerfWatchOptions opts = eager_options();
+	opts.rotate_quantum_ms = 20;
+	LinuxPerfMemoryWatcher mw(static_cast<std::uint32_t>(::getpid()), symbols, opts);
+	ASSERT_TRUE(mw.rotating());
+
+	try
+	{
+		mw.on_event(DebugEvent{.type = DebugEventType::_CreateProcess, .payload = CreateProcessInfo{}});
+	}
+	catch (const MemoryWatchError& e)
+	{
+		GTEST_SKIP() << "perf hardware breakpoints unavailable: " << e.what();
+	}
+
+	testing::internal::CaptureStdout();
+	const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+	for (std::uint64_t n = 1; std::chrono::steady_clock::now() < until; ++n)
+	{
+		for (auto& v : g_spread)
+			v[0] = n;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	mw.on_event(DebugEvent{.type = DebugEventType::ExitProcess, .payload = ExitProcessInfo{}});
+	testing::internal::GetCapturedStdout();
+
+	for (const auto& e : mw.rotation().estimates())
+	{
+		EXPECT_GT(e.observed, 0u) << symbols[e.variable].name;
+		EXPECT_GT(e.coverage, 0.2) << symbols[e.variable].name;
+		EXPECT_LT(e.coverage, 0.8) << symbols[e.variable].name;
+		EXPECT_GE(e.estimated, static_cast<double>(e.observed));
+	}
+}
+
+TEST(LinuxPerfMemoryWatcherTest, RejectsMoreVariablesThanAPlanHolds)
+{
+	const auto symbol = create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "perf64");
+	EXPECT_THROW(
+		LinuxPerfMemoryWatcher(static_cast<std::uint32_t>(::getpid()), std::vector(kMaxPlannedVariables + 1, symbol)),
+		MemoryWatchError
+	);
+}
+
+TEST(LinuxPerfMemoryWatcherTest, RejectsUnsupportedSize)
+{
+	EXPECT_THROW(
+		LinuxPerfMemoryWatcher(static_cast<std::uint32_t>(::getpid()), create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 2, "badSize")),
+		MemoryWatchError
+	);
+}
+
+TEST(LinuxPerfMemoryWatcherTest, RejectsNonPowerOfTwoRing)
+{
+	PerfWatchOptions opts;
+	opts.ring_pages = 3;
+	EXPECT_THROW(
+		LinuxPerfMemoryWatcher(static_cast<std::uint32_t>(::getpid()), create_resolve_symbol(reinterpret_cast<std::uint64_t>(&g_perf64), 8, "ring"), opts),
+		MemoryWatchError
+	);
+}
+
+#else
+
+TEST(LinuxPerfMemoryWatcherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "LinuxPerfMemoryWatcher tests require Linux.";
+}
+
+#endif
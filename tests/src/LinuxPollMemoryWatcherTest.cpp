@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MemoryWatcher.h"
+#include "ProcessLauncher.h"
+#include "SymbolResolver.h"
+
+using namespace gwatch;
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+
+	struct PollSink final : IDebugEventSink
+	{
+		LinuxProcessLauncher& launcher;
+		std::vector<std::string> names;
+		PollWatchOptions options;
+		std::unique_ptr<LinuxPollMemoryWatcher> watcher;
+
+		PollSink(LinuxProcessLauncher& l, std::vector<std::string> n, const PollWatchOptions& o) : launcher(l), names(std::move(n)), options(o) {}
+
+		ContinueStatus on_event(const DebugEvent& ev) override
+		{
+			if (!watcher)
+			{
+				if (ev.type != DebugEventType::_CreateProcess)
+					return ContinueStatus::Default;
+				const auto& cp = std::get<CreateProcessInfo>(ev.payload);
+				ElfSymbolResolver resolver(std::string(launcher.strings().view(cp.image_path)), cp.image_base);
+				std::vector<ResolvedSymbol> symbols;
+				for (const auto& name : names)
+					symbols.push_back(resolver.resolve(name));
+				watcher = std::make_unique<LinuxPollMemoryWatcher>(launcher.pid(), symbols, options);
+			}
+			return watcher->on_event(ev);
+		}
+	};
+
+	struct PollRun
+	{
+		std::optional<std::uint32_t> exitCode;
+		std::vector<std::string> lines;
+		std::vector<PollStats> stats;
+		std::uint64_t ticks = 0;
+	};
+
+	PollRun run_poll(const std::vector<std::string>& names, const PollWatchOptions& options)
+	{
+		const auto exe = CurrentModuleDir() / "gwatch_debuggee_poll";
+		LinuxProcessLauncher launcher;
+		launcher.launch(LaunchConfig{.exe_path = exe.string(), .args = {}, .workdir = std::nullopt});
+		PollSink sink(launcher, names, options);
+
+		PollRun run;
+		testing::internal::CaptureStdout();
+		run.exitCode = drive_debug_loop(launcher, sink);
+		std::istringstream out(testing::internal::GetCapturedStdout());
+		for (std::string line; std::getline(out, line);)
+			run.lines.push_back(line);
+		if (sink.watcher)
+		{
+			run.stats = sink.watcher->poll_stats();
+			run.ticks = sink.watcher->ticks();
+		}
+		return run;
+	}
+}
+
+TEST(LinuxPollMemoryWatcherTest, LogsEveryValueOfASlowVariable)
+{
+	const PollRun run = run_poll({"g_poll_slow"}, PollWatchOptions{.interval_us = 1'000});
+
+	EXPECT_EQ(run.exitCode, 5u);
+	std::vector<std::string> expected;
+	for (int i = 1; i <= 5; ++i)
+		expected.push_back("g_poll_slow write " + std::to_string(i - 1) + " -> " + std::to_string(i));
+	EXPECT_EQ(run.lines, expected);
+	ASSERT_EQ(run.stats.size(), 1u);
+	EXPECT_EQ(run.stats[0].changes, 5u);
+	EXPECT_EQ(run.stats[0].missed, 0u);
+	EXPECT_GT(run.ticks, 5u);
+}
+
+TEST(LinuxPollMemoryWatcherTest, BusyPollCountsMissedIncrements)
+{
+	const PollRun run = run_poll({"g_poll_slow", "g_poll_fast"}, PollWatchOptions{.interval_us = 0});
+
+	EXPECT_EQ(run.exitCode, 5u);
+	ASSERT_FALSE(run.lines.empty());
+	EXPECT_EQ(run.lines.back().substr(run.lines.back().find(" -> ")), " -> 1000000");
+	ASSERT_EQ(run.stats.size(), 2u);
+	// The first slow increments give away the step: every skipped increment is then counted.
+	const PollStats& fast = run.stats[1];
+	EXPECT_EQ(fast.step, 1u);
+	EXPECT_GE(fast.changes, 3u);
+	EXPECT_EQ(fast.changes + fast.missed, 1'000'000u);
+}
+
+TEST(LinuxPollMemoryWatcherTest, RejectsInvalidVariables)
+{
+	EXPECT_THROW(LinuxPollMemoryWatcher(1, std::vector<ResolvedSymbol>{}), MemoryWatchError);
+	EXPECT_THROW(LinuxPollMemoryWatcher(1, {ResolvedSymbol{.name = "x", .module = {}, .address = 0x1000, .size = 16}}), MemoryWatchError);
+}
+
+#else
+
+TEST(LinuxPollMemoryWatcherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "LinuxPollMemoryWatcher tests require Linux.";
+}
+
+#endif
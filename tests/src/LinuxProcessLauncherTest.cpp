@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <unistd.h>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <optional>
+#include <thread>
+
+#include "ProcessLauncher.h"
+
+namespace
+{
+	std::filesystem::path CurrentModuleDir()
+	{
+		std::error_code ec;
+		const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+		return ec ? std::filesystem::path{} : self.parent_path();
+	}
+}
+
+struct RecordingSink final : gwatch::IDebugEventSink
+{
+	int create_process = 0;
+	int create_thread = 0;
+	int exit_thread = 0;
+	std::optional<std::uint32_t> exit_code;
+	gwatch::StringId image_path = gwatch::kEmptyString;
+	std::uint64_t entry_point = 0;
+
+	gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev) override
+	{
+		using T = gwatch::DebugEventType;
+		switch (ev.type)
+		{
+			case T::_CreateProcess:
+			{
+				const auto& cp = std::get<gwatch::CreateProcessInfo>(ev.payload);
+				++create_process;
+				image_path = cp.image_path;
+				entry_point = cp.entry_point;
+				break;
+			}
+			case T::CreateThread:
+				++create_thread;
+				break;
+			case T::ExitThread:
+				++exit_thread;
+				break;
+			case T::ExitProcess:
+			{
+				const auto& [code] = std::get<gwatch::ExitProcessInfo>(ev.payload);
+				exit_code = code;
+				break;
+			}
+			default:
+				break;
+		}
+		return gwatch::ContinueStatus::Default;
+	}
+};
+
+TEST(LinuxProcessLauncherTest, LaunchesAndReceivesEvents)
+{
+	using namespace gwatch;
+
+	const auto exe = CurrentModuleDir() / "gwatch_debuggee_app";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	LinuxProcessLauncher launcher;
+
+	LaunchConfig cfg;
+	cfg.exe_path = exe.string();
+
+	ASSERT_NO_THROW(launcher.launch(cfg));
+	EXPECT_TRUE(launcher.running());
+	EXPECT_NE(launcher.pid(), 0u);
+
+	RecordingSink sink;
+	const auto result = launcher.run_debug_loop(sink);
+
+	ASSERT_TRUE(result.has_value()) << "Exit code should be available.";
+	EXPECT_EQ(result.value(), 123u) << "Debuggee must return 123.";
+	EXPECT_EQ(sink.create_process, 1);
+	EXPECT_EQ(std::filesystem::path(launcher.strings().view(sink.image_path)).filename(), exe.filename());
+	EXPECT_NE(sink.entry_point, 0u);
+	EXPECT_FALSE(launcher.running());
+}
+
+TEST(LinuxProcessLauncherTest, ReportsThreadLifecycle)
+{
+	using namespace gwatch;
+
+	const auto exe = CurrentModuleDir() / "gwatch_debuggee_threads";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	LinuxProcessLauncher launcher;
+	LaunchConfig cfg;
+	cfg.exe_path = exe.string();
+	ASSERT_NO_THROW(launcher.launch(cfg));
+
+	RecordingSink sink;
+	const auto result = launcher.run_debug_loop(sink);
+
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result.value(), 42u);
+	EXPECT_EQ(sink.create_thread, 2);
+	EXPECT_EQ(sink.exit_thread, 2);
+}
+
+// Not an IDebugEventSink: bound to the loop at compile time through drive_debug_loop.
+struct StaticSink
+{
+	int events = 0;
+	int exceptions = 0;
+
+	gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev)
+	{
+		++events;
+		if (ev.type == gwatch::DebugEventType::Exception)
+			++exceptions;
+		return gwatch::ContinueStatus::Default;
+	}
+};
+
+TEST(LinuxProcessLauncherTest, DriveDebugLoopWithStaticSink)
+{
+	using namespace gwatch;
+
+	const auto exe = CurrentModuleDir() / "gwatch_debuggee_threads";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	LinuxProcessLauncher launcher;
+	LaunchConfig cfg;
+	cfg.exe_path = exe.string();
+	ASSERT_NO_THROW(launcher.launch(cfg));
+
+	StaticSink sink;
+	const auto result = drive_debug_loop(launcher, sink);
+
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result.value(), 42u);
+	// _CreateProcess, 2x CreateThread, 2x ExitThread, ExitProcess at least.
+	EXPECT_GE(sink.events, 6);
+	EXPECT_FALSE(launcher.running());
+}
+
+// Continues the target from another thread some time after it raised SIGSTOP.
+struct JobControlSink
+{
+	std::uint32_t pid = 0;
+	int stops = 0;
+	std::thread continuer;
+
+	gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev)
+	{
+		if (ev.type != gwatch::DebugEventType::Exception || std::get<gwatch::ExceptionInfo>(ev.payload).code != SIGSTOP)
+			return gwatch::ContinueStatus::Default;
+		++stops;
+		continuer = std::thread([pid = pid]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			kill(static_cast<pid_t>(pid), SIGCONT);
+		});
+		return gwatch::ContinueStatus::Default;
+	}
+};
+
+TEST(LinuxProcessLauncherTest, DeliversSIGSTOPAndWaitsForSIGCONT)
+{
+	using namespace gwatch;
+
+	const auto exe = CurrentModuleDir() / "gwatch_debuggee_stop";
+	ASSERT_TRUE(std::filesystem::exists(exe)) << "Debuggee not found at: " << exe.string();
+
+	LinuxProcessLauncher launcher;
+	LaunchConfig cfg;
+	cfg.exe_path = exe.string();
+	ASSERT_NO_THROW(launcher.launch(cfg));
+
+	JobControlSink sink;
+	sink.pid = launcher.pid();
+	const auto result = drive_debug_loop(launcher, sink);
+	if (sink.continuer.joinable())
+		sink.continuer.join();
+
+	EXPECT_EQ(sink.stops, 1);
+	ASSERT_TRUE(result.has_value());
+	// 1: the target was not stopped, or not until SIGCONT.
+	EXPECT_EQ(result.value(), 0u);
+}
+
+TEST(LinuxProcessLauncherTest, LaunchFailsForMissingExe)
+{
+	using namespace gwatch;
+
+	LinuxProcessLauncher launcher;
+
+	LaunchConfig cfg;
+	cfg.exe_path = "/definitely/not/there/nope_debuggee";
+
+	EXPECT_THROW(launcher.launch(cfg), ProcessError);
+	EXPECT_FALSE(launcher.running());
+}
+
+TEST(LinuxProcessLauncherTest, DebugLoopBeforeLaunchThrows)
+{
+	using namespace gwatch;
+
+	LinuxProcessLauncher launcher;
+	RecordingSink sink;
+	EXPECT_THROW(launcher.run_debug_loop(sink), ProcessError);
+}
+
+#else
+
+TEST(LinuxProcessLauncherPortable, SkippedOnNonLinux)
+{
+	GTEST_SKIP() << "Linux-only test suite.";
+}
+
+#endif
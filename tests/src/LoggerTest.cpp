@@ -1,6 +1,16 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <limits>
+#include <sstream>
 #include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #include "Logger.h"
 
@@ -22,6 +32,15 @@ TEST(LoggerTest, LogWrite_ExactFormat)
 	EXPECT_EQ(out, std::string("counter write 50 -> 100\n"));
 }
 
+TEST(LoggerTest, LogAccess_PrintsTheKindWithoutValues)
+{
+	testing::internal::CaptureStdout();
+	Logger::log_access("counter", gwatch::AccessKind::Write);
+	Logger::log_access("counter", gwatch::AccessKind::Read);
+	const std::string out = testing::internal::GetCapturedStdout();
+	EXPECT_EQ(out, std::string("counter write ?\ncounter read ?\n"));
+}
+
 TEST(LoggerTest, NoLeadingZeros)
 {
 	testing::internal::CaptureStdout();
@@ -61,3 +80,422 @@ TEST(LoggerTest, MultipleCallsAppendWithNewlines)
 		"a read 2\n";
 	EXPECT_EQ(out, expected);
 }
+
+namespace
+{
+	// Runs body in asynchronous mode and returns everything it wrote to stdout.
+	template<typename F>
+	std::string capture_async(const std::size_t capacity, F&& body)
+	{
+		testing::internal::CaptureStdout();
+		Logger::start_async(capacity);
+		body();
+		Logger::stop_async();
+		return testing::internal::GetCapturedStdout();
+	}
+}
+
+TEST(LoggerTest, Async_ByteIdenticalToSynchronous)
+{
+	const auto sequence = []
+	{
+		Logger::log_read("x", 0);
+		Logger::log_write("x", 7, 13);
+		Logger::log_read("big", std::numeric_limits<std::uint64_t>::max());
+		Logger::log_write("counter", 50, 100);
+		Logger::log_read("x", 13);
+	};
+
+	testing::internal::CaptureStdout();
+	sequence();
+	const std::string sync = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(capture_async(1024, sequence), sync);
+	EXPECT_FALSE(Logger::async_active());
+}
+
+TEST(LoggerTest, Async_SmallRingKeepsOrderAndLosesNothing)
+{
+	constexpr std::uint64_t count = 20000;
+	const std::string out = capture_async(8, []
+	{
+		for (std::uint64_t i = 0; i < count; ++i)
+			Logger::log_write(i % 2 ? "odd" : "even", i, i + 1);
+	});
+
+	std::string expected;
+	for (std::uint64_t i = 0; i < count; ++i)
+		expected += std::string(i % 2 ? "odd" : "even") + " write " + std::to_string(i) + " -> " + std::to_string(i + 1) + "\n";
+	EXPECT_EQ(out, expected);
+}
+
+TEST(LoggerTest, Async_FlushMakesRecordsVisible)
+{
+	testing::internal::CaptureStdout();
+	Logger::start_async();
+	Logger::log_read("flushed", 1);
+	Logger::flush();
+	const std::string out = testing::internal::GetCapturedStdout();
+	Logger::stop_async();
+
+	EXPECT_EQ(out, "flushed read 1\n");
+}
+
+TEST(LoggerTest, Async_PreviousSynchronousLinesComeFirst)
+{
+	testing::internal::CaptureStdout();
+	Logger::log_read("before", 1);
+	Logger::start_async();
+	Logger::log_read("after", 2);
+	Logger::stop_async();
+	Logger::log_read("sync", 3);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(out, "before read 1\nafter read 2\nsync read 3\n");
+}
+
+namespace
+{
+	// Runs body with coalescing on and returns everything it wrote to stdout.
+	template<typename F>
+	std::string capture_coalesced(const gwatch::Coalescing coalescing, const std::uint64_t window_ns, F&& body)
+	{
+		testing::internal::CaptureStdout();
+		Logger::set_coalescing(coalescing, window_ns);
+		body();
+		Logger::set_coalescing(gwatch::Coalescing::Off);
+		return testing::internal::GetCapturedStdout();
+	}
+}
+
+TEST(LoggerTest, Coalesce_RunsEndOnAValueChange)
+{
+	const std::string out = capture_coalesced(gwatch::Coalescing::Global, 0, []
+	{
+		for (int i = 0; i < 1'000'000; ++i)
+			Logger::log_read("flag", 0);
+		Logger::log_write("flag", 0, 1);
+		Logger::log_read("flag", 1);
+		Logger::log_read("flag", 1);
+		Logger::log_write("flag", 1, 1);
+		Logger::log_write("flag", 1, 1);
+	});
+
+	EXPECT_EQ(out, "flag read 0 x1000000\nflag write 0 -> 1\nflag read 1 x2\nflag write 1 -> 1 x2\n");
+}
+
+TEST(LoggerTest, Coalesce_UnknownValuesNeverJoinKnownOnes)
+{
+	const std::string out = capture_coalesced(gwatch::Coalescing::Global, 0, []
+	{
+		Logger::log_access("flag", gwatch::AccessKind::Write);
+		Logger::log_access("flag", gwatch::AccessKind::Write);
+		Logger::log_write("flag", 0, 0);
+	});
+
+	EXPECT_EQ(out, "flag write ? x2\nflag write 0 -> 0\n");
+}
+
+TEST(LoggerTest, Coalesce_GlobalRunsEndOnAThreadSwitch)
+{
+	const std::string out = capture_coalesced(gwatch::Coalescing::Global, 0, []
+	{
+		Logger::log_read("flag", 0, 1);
+		Logger::log_read("flag", 0, 1);
+		Logger::log_read("flag", 0, 2);
+		Logger::log_read("flag", 0, 1);
+	});
+
+	EXPECT_EQ(out, "flag read 0 x2\nflag read 0\nflag read 0\n");
+}
+
+TEST(LoggerTest, Coalesce_PerThreadRunsSurviveOtherThreads)
+{
+	const std::string out = capture_coalesced(gwatch::Coalescing::PerThread, 0, []
+	{
+		for (int i = 0; i < 10; ++i)
+		{
+			Logger::log_read("flag", 0, 1);
+			Logger::log_read("flag", 0, 2);
+		}
+		// Ends the run of thread 1 only.
+		Logger::log_write("flag", 0, 1, 1);
+		Logger::log_read("flag", 1, 2);
+	});
+
+	EXPECT_EQ(out, "flag read 0 x10\nflag read 0 x10\nflag write 0 -> 1\nflag read 1\n");
+}
+
+TEST(LoggerTest, Coalesce_RunsEndAfterTheWindow)
+{
+	// Steady clock timestamps, so that the background flush does not see the runs as idle.
+	const auto base = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	constexpr std::uint64_t window = 1'000'000'000;
+	const std::string out = capture_coalesced(gwatch::Coalescing::Global, window, [base]
+	{
+		Logger::log_read("flag", 0, 1, base);
+		Logger::log_read("flag", 0, 1, base + window - 1);
+		Logger::log_read("flag", 0, 1, base + window);
+		Logger::log_read("flag", 0, 1, base + window + window / 2);
+	});
+
+	EXPECT_EQ(out, "flag read 0 x2\nflag read 0 x2\n");
+}
+
+TEST(LoggerTest, Coalesce_IdleRunsAreFlushedInTheBackground)
+{
+	testing::internal::CaptureStdout();
+	Logger::set_coalescing(gwatch::Coalescing::PerThread, 1'000'000);
+	Logger::log_read("idle", 4);
+	Logger::log_read("idle", 4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	std::fflush(stdout);
+	const std::string out = testing::internal::GetCapturedStdout();
+	Logger::set_coalescing(gwatch::Coalescing::Off);
+
+	EXPECT_EQ(out, "idle read 4 x2\n");
+}
+
+TEST(LoggerTest, Coalesce_AsyncOutputIsTheSame)
+{
+	const auto sequence = []
+	{
+		for (int i = 0; i < 5000; ++i)
+			Logger::log_read("spin", static_cast<std::uint64_t>(i / 1000));
+	};
+
+	const std::string sync = capture_coalesced(gwatch::Coalescing::Global, 0, sequence);
+	const std::string async = capture_async(16, []
+	{
+		Logger::set_coalescing(gwatch::Coalescing::Global, 0);
+		for (int i = 0; i < 5000; ++i)
+			Logger::log_read("spin", static_cast<std::uint64_t>(i / 1000));
+		Logger::set_coalescing(gwatch::Coalescing::Off);
+	});
+
+	EXPECT_EQ(sync, "spin read 0 x1000\nspin read 1 x1000\nspin read 2 x1000\nspin read 3 x1000\nspin read 4 x1000\n");
+	EXPECT_EQ(async, sync);
+}
+
+namespace
+{
+	// Runs body with the given policies and returns {stdout, stderr}.
+	template<typename F>
+	std::pair<std::string, std::string> capture_with_policies(const std::vector<std::pair<std::string, gwatch::LogPolicy>>& policies, F&& body)
+	{
+		testing::internal::CaptureStdout();
+		testing::internal::CaptureStderr();
+		for (const auto& [symbol, policy] : policies)
+			Logger::set_policy(symbol, policy);
+		body();
+		Logger::report_drops();
+		Logger::clear_policies();
+		std::string err = testing::internal::GetCapturedStderr();
+		return {testing::internal::GetCapturedStdout(), std::move(err)};
+	}
+}
+
+TEST(LoggerTest, Policy_SampleKeepsOneAccessInN)
+{
+	gwatch::LogDrops drops;
+	const auto [out, err] = capture_with_policies({{"", {.sampleEvery = 4}}}, [&drops]
+	{
+		for (std::uint64_t i = 0; i < 10; ++i)
+			Logger::log_read("s", i, 1, 1'000 + i);
+		Logger::log_write("s", 9, 10, 1, 2'000);
+		Logger::log_write("s", 10, 11, 1, 2'001);
+		Logger::log_write("s", 11, 12, 1, 2'002);
+		drops = Logger::dropped();
+	});
+
+	// The third write is access number 12 of the variable: kept, with its true old value.
+	EXPECT_EQ(out, "s read 0\ns read 4\ns read 8\ns write 11 -> 12\n");
+	EXPECT_EQ(drops.reads, 7u);
+	EXPECT_EQ(drops.writes, 2u);
+	EXPECT_EQ(err, "drop: s reads=7 writes=2\ndrop: total reads=7 writes=2\n");
+}
+
+TEST(LoggerTest, Policy_RateLimitRefillsWithTime)
+{
+	const auto [out, err] = capture_with_policies({{"", {.ratePerSecond = 2}}}, []
+	{
+		// A full bucket of two, then one token every 500ms.
+		for (std::uint64_t i = 0; i < 5; ++i)
+			Logger::log_read("r", i, 1, 10 + i);
+		Logger::log_read("r", 5, 1, 500'000'020);
+		Logger::log_read("r", 6, 1, 500'000'021);
+	});
+
+	EXPECT_EQ(out, "r read 0\nr read 1\nr read 5\n");
+	EXPECT_EQ(err, "drop: r reads=4 writes=0\ndrop: total reads=4 writes=0\n");
+}
+
+TEST(LoggerTest, Policy_PerVariableOverridesTheDefault)
+{
+	const auto [out, err] = capture_with_policies({{"", {.sampleEvery = 100}}, {"loud", {.sampleEvery = 2}}}, []
+	{
+		for (std::uint64_t i = 0; i < 4; ++i)
+		{
+			Logger::log_read("loud", i, 1, 1 + i);
+			Logger::log_read("quiet", i, 1, 1 + i);
+		}
+	});
+
+	EXPECT_EQ(out, "loud read 0\nquiet read 0\nloud read 2\n");
+	EXPECT_EQ(err, "drop: loud reads=2 writes=0\ndrop: quiet reads=3 writes=0\ndrop: total reads=5 writes=0\n");
+}
+
+TEST(LoggerTest, Policy_ClearWhileAnotherThreadLogs)
+{
+	std::atomic<bool> logging{false};
+	std::atomic<bool> cleared{false};
+	testing::internal::CaptureStdout();
+	Logger::set_policy("", {.sampleEvery = 2});
+	std::thread logger([&logging, &cleared]
+	{
+		for (std::uint64_t i = 0; !cleared; ++i)
+		{
+			Logger::log_read("c", i, 2, 1 + i);
+			logging = true;
+		}
+		Logger::log_read("c", 1, 2);
+		Logger::log_read("c", 2, 2);
+	});
+	while (!logging)
+		std::this_thread::yield();
+	Logger::clear_policies();
+	cleared = true;
+	logger.join();
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	// Nothing is sampled out after the clear, and no drop is left counted.
+	EXPECT_TRUE(out.ends_with("c read 1\nc read 2\n"));
+	EXPECT_EQ(Logger::dropped().reads, 0u);
+}
+
+TEST(LoggerTest, Policy_DropsAreReportedEverySecond)
+{
+	const auto [out, err] = capture_with_policies({{"", {.sampleEvery = 2}}}, []
+	{
+		constexpr std::uint64_t second = 1'000'000'000;
+		for (std::uint64_t i = 0; i < 6; ++i)
+			Logger::log_read("p", 0, 1, 1 + i * second / 2);
+	});
+
+	// Lines at 1s and 2s, each with the drops since the previous one.
+	EXPECT_EQ(err, "drop: p reads=1 writes=0\ndrop: p reads=1 writes=0\ndrop: p reads=1 writes=0\ndrop: total reads=3 writes=0\n");
+	EXPECT_EQ(out, "p read 0\np read 0\np read 0\n");
+}
+
+#ifdef __linux__
+
+namespace
+{
+	// Logs `count` writes through an asynchronous logger whose stdout is a pipe nobody reads
+	// until the logging is over. Returns everything that reached the pipe.
+	std::string log_into_stalled_pipe(const gwatch::AsyncOptions& options, const std::uint64_t count)
+	{
+		int fds[2];
+		if (pipe(fds) != 0)
+			return {};
+		std::fflush(stdout);
+		const int saved = dup(STDOUT_FILENO);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+
+		Logger::start_async(options);
+		for (std::uint64_t i = 0; i < count; ++i)
+			Logger::log_write("v", i, i + 1);
+
+		std::string out;
+		std::thread reader([&out, fd = fds[0]]
+		{
+			char buffer[4096];
+			ssize_t n = 0;
+			while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+				out.append(buffer, static_cast<std::size_t>(n));
+		});
+		Logger::stop_async();
+		dup2(saved, STDOUT_FILENO);
+		close(saved);
+		reader.join();
+		close(fds[0]);
+		return out;
+	}
+
+	// The i of every "v write i -> i+1" line, checking the format on the way.
+	std::vector<std::uint64_t> written_indices(const std::string& out)
+	{
+		std::vector<std::uint64_t> indices;
+		std::istringstream iss(out);
+		std::string line;
+		while (std::getline(iss, line))
+		{
+			std::uint64_t i = 0;
+			std::uint64_t next = 0;
+			char arrow[3] = {};
+			if (std::sscanf(line.c_str(), "v write %lu %2s %lu", &i, arrow, &next) == 3 && std::string(arrow) == "->" && next == i + 1)
+				indices.push_back(i);
+			else
+				indices.push_back(UINT64_MAX);
+		}
+		return indices;
+	}
+}
+
+TEST(LoggerTest, Overflow_DropNewestNeverWaitsForAStalledReader)
+{
+	constexpr std::uint64_t count = 50'000;
+	const std::string out = log_into_stalled_pipe({.capacity = 64, .overflow = gwatch::OverflowPolicy::DropNewest, .spillPath = {}}, count);
+	const gwatch::QueueStats queue = Logger::queue_stats();
+	const auto indices = written_indices(out);
+
+	EXPECT_EQ(queue.capacity, 64u);
+	EXPECT_LE(queue.peak, queue.capacity);
+	EXPECT_GT(queue.dropped, 0u);
+	EXPECT_EQ(indices.size() + queue.dropped, count);
+	// What got through is the beginning of the stream, in order.
+	ASSERT_FALSE(indices.empty());
+	EXPECT_EQ(indices.front(), 0u);
+	EXPECT_TRUE(std::ranges::is_sorted(indices));
+	EXPECT_EQ(std::ranges::adjacent_find(indices), indices.end());
+}
+
+TEST(LoggerTest, Overflow_DropOldestKeepsTheLatestRecords)
+{
+	constexpr std::uint64_t count = 50'000;
+	const std::string out = log_into_stalled_pipe({.capacity = 64, .overflow = gwatch::OverflowPolicy::DropOldest, .spillPath = {}}, count);
+	const gwatch::QueueStats queue = Logger::queue_stats();
+	const auto indices = written_indices(out);
+
+	EXPECT_LE(queue.peak, queue.capacity);
+	EXPECT_GT(queue.dropped, 0u);
+	EXPECT_EQ(indices.size() + queue.dropped, count);
+	ASSERT_FALSE(indices.empty());
+	EXPECT_EQ(indices.back(), count - 1);
+	EXPECT_TRUE(std::ranges::is_sorted(indices));
+}
+
+TEST(LoggerTest, Overflow_SpillLosesNothing)
+{
+	const auto path = std::filesystem::temp_directory_path() / ("gwatch_spill_test_" + std::to_string(getpid()));
+	constexpr std::uint64_t count = 50'000;
+	const std::string out = log_into_stalled_pipe({.capacity = 64, .overflow = gwatch::OverflowPolicy::Spill, .spillPath = path.string()}, count);
+	const gwatch::QueueStats queue = Logger::queue_stats();
+	const auto indices = written_indices(out);
+
+	EXPECT_EQ(queue.dropped, 0u);
+	EXPECT_GT(queue.spilledBytes, 0u);
+	ASSERT_EQ(indices.size(), count);
+	for (std::uint64_t i = 0; i < count; ++i)
+		ASSERT_EQ(indices[i], i);
+	EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(LoggerTest, Overflow_UnwritableSpillFileIsAnError)
+{
+	EXPECT_THROW(Logger::start_async({.overflow = gwatch::OverflowPolicy::Spill, .spillPath = "/nonexistent-dir/spill"}), std::runtime_error);
+	EXPECT_FALSE(Logger::async_active());
+}
+
+#endif
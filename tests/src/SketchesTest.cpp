@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "Sketches.h"
+
+using gwatch::HyperLogLog;
+using gwatch::Log2Histogram;
+using gwatch::SpaceSaving;
+using gwatch::TDigest;
+
+TEST(Log2HistogramTest, BucketsByPowerOfTwo)
+{
+	Log2Histogram histogram;
+	for (const std::uint64_t value : {0ull, 1ull, 2ull, 3ull, 4ull, 1000ull, ~0ull})
+		histogram.add(value);
+
+	EXPECT_EQ(histogram.count(), 7u);
+	EXPECT_EQ(histogram.bucket(0), 1u);
+	EXPECT_EQ(histogram.bucket(1), 1u);
+	EXPECT_EQ(histogram.bucket(2), 2u);
+	EXPECT_EQ(histogram.bucket(3), 1u);
+	EXPECT_EQ(histogram.bucket(10), 1u);
+	EXPECT_EQ(histogram.bucket(64), 1u);
+	EXPECT_EQ(Log2Histogram::lower_bound(0), 0u);
+	EXPECT_EQ(Log2Histogram::lower_bound(10), 512u);
+}
+
+TEST(HyperLogLogTest, EstimatesWithinTheStandardError)
+{
+	HyperLogLog exact;
+	for (std::uint64_t v = 0; v < 100; ++v)
+	{
+		exact.add(v);
+		exact.add(v);
+	}
+	EXPECT_NEAR(exact.estimate(), 100.0, 5.0);
+
+	HyperLogLog large;
+	for (std::uint64_t v = 0; v < 200'000; ++v)
+		large.add(v * 8);
+	// 1.6% standard error; allow three of them.
+	EXPECT_NEAR(large.estimate(), 200'000.0, 200'000.0 * 0.05);
+}
+
+TEST(HyperLogLogTest, Error_InvalidPrecision)
+{
+	EXPECT_THROW(HyperLogLog(3), std::invalid_argument);
+	EXPECT_THROW(HyperLogLog(19), std::invalid_argument);
+}
+
+TEST(SpaceSavingTest, KeepsTheHeavyHitters)
+{
+	// 12'500 values: everything above 12'500 / 8 is guaranteed to be kept.
+	SpaceSaving sketch(8);
+	for (std::uint64_t i = 0; i < 10'000; ++i)
+	{
+		sketch.add(i % 3 == 0 ? 7 : 1'000 + i);
+		if (i % 4 == 0)
+			sketch.add(42);
+	}
+
+	const auto top = sketch.top(2);
+	ASSERT_EQ(top.size(), 2u);
+	EXPECT_EQ(top[0].value, 7u);
+	EXPECT_GE(top[0].count, 3'334u);
+	EXPECT_LE(top[0].count - top[0].error, 3'334u);
+	EXPECT_EQ(top[1].value, 42u);
+	EXPECT_LE(top[1].count - top[1].error, 2'500u);
+	EXPECT_EQ(sketch.top(100).size(), 8u);
+}
+
+TEST(SpaceSavingTest, ExactWhileUnderCapacity)
+{
+	SpaceSaving sketch(4);
+	for (const std::uint64_t v : {5, 5, 5, 9, 9, 1})
+		sketch.add(v);
+
+	const auto top = sketch.top(5);
+	ASSERT_EQ(top.size(), 3u);
+	EXPECT_EQ(top[0].value, 5u);
+	EXPECT_EQ(top[0].count, 3u);
+	EXPECT_EQ(top[0].error, 0u);
+	EXPECT_EQ(top[1].value, 9u);
+	EXPECT_EQ(top[2].value, 1u);
+}
+
+TEST(TDigestTest, QuantilesOfAUniformStream)
+{
+	TDigest digest;
+	constexpr int n = 100'000;
+	// Interleaved so the buffer never sees sorted input.
+	for (int i = 0; i < n; ++i)
+		digest.add(static_cast<double>((i * 7919) % n + 1));
+
+	EXPECT_EQ(digest.count(), static_cast<std::uint64_t>(n));
+	EXPECT_EQ(digest.quantile(0), 1.0);
+	EXPECT_EQ(digest.quantile(1), static_cast<double>(n));
+	EXPECT_NEAR(digest.quantile(0.5), n * 0.5, n * 0.01);
+	EXPECT_NEAR(digest.quantile(0.9), n * 0.9, n * 0.01);
+	EXPECT_NEAR(digest.quantile(0.99), n * 0.99, n * 0.002);
+	EXPECT_NEAR(digest.quantile(0.001), n * 0.001, n * 0.001);
+	EXPECT_LE(digest.centroids(), 100u);
+}
+
+TEST(TDigestTest, SmallInputs)
+{
+	TDigest digest;
+	EXPECT_EQ(digest.quantile(0.5), 0.0);
+	digest.add(4);
+	EXPECT_EQ(digest.quantile(0.5), 4.0);
+	digest.add(4);
+	digest.add(4);
+	EXPECT_EQ(digest.quantile(0.9), 4.0);
+}
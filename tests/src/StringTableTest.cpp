@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "StringTable.h"
+
+using gwatch::StringTable;
+using gwatch::kEmptyString;
+
+TEST(StringTableTest, EmptyStringIsPreinterned)
+{
+	StringTable table;
+	EXPECT_EQ(table.intern(""), kEmptyString);
+	EXPECT_EQ(table.view(kEmptyString), "");
+	EXPECT_EQ(table.size(), 1u);
+}
+
+TEST(StringTableTest, EqualStringsShareOneId)
+{
+	StringTable table;
+	const auto a = table.intern("/usr/bin/target");
+	const auto b = table.intern("/usr/lib/libc.so.6");
+	const std::string copy = "/usr/bin/target";
+
+	EXPECT_NE(a, b);
+	EXPECT_EQ(table.intern(copy), a);
+	EXPECT_EQ(table.view(a), "/usr/bin/target");
+	EXPECT_EQ(table.view(b), "/usr/lib/libc.so.6");
+	EXPECT_EQ(table.size(), 3u);
+}
+
+TEST(StringTableTest, ViewsStayValidAcrossChunksAndLargeStrings)
+{
+	StringTable table;
+	const auto first = table.intern("first");
+	const std::string_view firstView = table.view(first);
+
+	for (int i = 0; i < 5000; ++i)
+		table.intern("module_" + std::to_string(i));
+	const std::string large(64 * 1024, 'x');
+	const auto big = table.intern(large);
+
+	EXPECT_EQ(firstView.data(), table.view(first).data());
+	EXPECT_EQ(table.view(first), "first");
+	EXPECT_EQ(table.view(big), large);
+	EXPECT_EQ(table.view(table.intern("module_4999")), "module_4999");
+}
+
+TEST(StringTableTest, UnknownIdIsEmpty)
+{
+	const StringTable table;
+	EXPECT_EQ(table.view(12345), "");
+}
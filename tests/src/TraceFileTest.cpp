@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+#include "TraceFile.h"
+#include "TraceFormat.h"
+
+using gwatch::Logger;
+using gwatch::TraceFile;
+using gwatch::TraceFileOptions;
+
+namespace
+{
+	// A fresh directory per test, removed with everything in it.
+	struct TempDir
+	{
+		std::filesystem::path path;
+
+		explicit TempDir(const std::string& name) :
+			path(std::filesystem::temp_directory_path() / ("gwatch_" + name + "_" + std::to_string(getpid())))
+		{
+			std::filesystem::remove_all(path);
+			std::filesystem::create_directories(path);
+		}
+		~TempDir() { std::filesystem::remove_all(path); }
+
+		std::string file(const std::string& name) const { return (path / name).string(); }
+	};
+
+	std::string read_file(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	}
+
+	std::string line(const int i)
+	{
+		return "v write " + std::to_string(i) + " -> " + std::to_string(i + 1) + "\n";
+	}
+}
+
+TEST(TraceFileTest, RecordsAreNeverSplitAcrossSegments)
+{
+	const TempDir dir("trace_split");
+	std::string expected;
+	{
+		TraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10});
+		for (int i = 0; i < 10'000; ++i)
+		{
+			const std::string text = line(i);
+			if (!file.has_room(text.size()))
+				file.rotate();
+			file.append(text.data(), text.size());
+			expected += text;
+		}
+		EXPECT_GT(file.segments(), 2u);
+	}
+
+	std::string joined;
+	for (int index = 0; std::filesystem::exists(dir.file("t." + std::to_string(index))); ++index)
+	{
+		const std::string segment = read_file(dir.file("t." + std::to_string(index)));
+		// Closed segments are truncated to their data and end on a record.
+		EXPECT_LE(segment.size(), 64u << 10);
+		EXPECT_EQ(segment.back(), '\n');
+		joined += segment;
+	}
+	EXPECT_EQ(joined, expected);
+}
+
+TEST(TraceFileTest, RetainsOnlyTheNewestSegments)
+{
+	const TempDir dir("trace_keep");
+	TraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10, .keep = 2});
+	for (int i = 0; i < 5; ++i)
+		file.rotate();
+
+	EXPECT_EQ(file.segments(), 6u);
+	EXPECT_FALSE(std::filesystem::exists(file.segment_path(3)));
+	EXPECT_TRUE(std::filesystem::exists(file.segment_path(4)));
+	EXPECT_TRUE(std::filesystem::exists(file.segment_path(5)));
+}
+
+TEST(TraceFileTest, RotatesAfterTheTimeLimit)
+{
+	const TempDir dir("trace_time");
+	TraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10, .rotateNs = 1'000'000});
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	// An empty segment is kept whatever its age.
+	EXPECT_TRUE(file.has_room(1));
+	file.append("x", 1);
+	EXPECT_FALSE(file.has_room(1));
+	file.rotate();
+	EXPECT_TRUE(file.has_room(1));
+}
+
+TEST(TraceFileTest, AppendedBytesAreInTheFileBeforeItIsClosed)
+{
+	const TempDir dir("trace_open");
+	TraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10});
+	file.append("a read 1\n", 9);
+
+	// As a crash would leave it: preallocated, zero-padded after the data.
+	const std::string segment = read_file(file.segment_path(0));
+	ASSERT_EQ(segment.size(), 64u << 10);
+	EXPECT_EQ(segment.substr(0, 9), "a read 1\n");
+	EXPECT_EQ(segment.find_first_not_of('\0', 9), std::string::npos);
+}
+
+TEST(TraceFileTest, Error_UncreatableFile)
+{
+	EXPECT_THROW(TraceFile(TraceFileOptions{.path = "/nonexistent-dir/t"}), std::runtime_error);
+	EXPECT_THROW(Logger::open_trace_file(TraceFileOptions{.path = "/nonexistent-dir/t"}), std::runtime_error);
+}
+
+TEST(TraceFileTest, LoggerWritesTextSegmentsInsteadOfStdout)
+{
+	const TempDir dir("trace_logger");
+	std::string expected;
+	testing::internal::CaptureStdout();
+	Logger::open_trace_file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10});
+	for (int i = 0; i < 10'000; ++i)
+	{
+		Logger::log_write("v", static_cast<std::uint64_t>(i), static_cast<std::uint64_t>(i + 1));
+		expected += line(i);
+	}
+	Logger::close_trace_file();
+	Logger::log_read("v", 7);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(out, "v read 7\n");
+	std::string joined;
+	for (int index = 0; std::filesystem::exists(dir.file("t." + std::to_string(index))); ++index)
+		joined += read_file(dir.file("t." + std::to_string(index)));
+	EXPECT_EQ(joined, expected);
+}
+
+TEST(TraceFileTest, EveryBinarySegmentIsATraceOfItsOwn)
+{
+	const TempDir dir("trace_binary");
+	for (const bool async : {false, true})
+	{
+		SCOPED_TRACE(async);
+		const std::string path = dir.file(async ? "async" : "sync");
+		Logger::set_format(gwatch::LogFormat::Binary);
+		Logger::open_trace_file(TraceFileOptions{.path = path, .segmentBytes = 64 << 10});
+		if (async)
+			Logger::start_async();
+		for (std::uint64_t i = 0; i < 100'000; ++i)
+			Logger::log_write(i % 2 ? "seg_a" : "seg_b", i, i * 977, static_cast<std::uint32_t>(i % 3), 1'000 + i);
+		Logger::stop_async();
+		Logger::close_trace_file();
+		Logger::set_format(gwatch::LogFormat::Text);
+
+		std::uint64_t next = 0;
+		int segments = 0;
+		for (; std::filesystem::exists(path + "." + std::to_string(segments)); ++segments)
+		{
+			std::istringstream in(read_file(path + "." + std::to_string(segments)));
+			gwatch::trace::Decoder decoder(in);
+			gwatch::trace::Event ev;
+			while (decoder.next(ev))
+			{
+				ASSERT_EQ(ev.old_value, next);
+				EXPECT_EQ(ev.new_value, next * 977);
+				EXPECT_EQ(ev.timestamp_ns, 1'000 + next);
+				EXPECT_EQ(decoder.symbols()[ev.symbol].name, next % 2 ? "seg_a" : "seg_b");
+				++next;
+			}
+		}
+		EXPECT_GT(segments, 1);
+		EXPECT_EQ(next, 100'000u);
+	}
+}
+
+#endif
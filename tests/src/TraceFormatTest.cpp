@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Logger.h"
+#include "TraceFormat.h"
+
+using namespace gwatch;
+using namespace gwatch::trace;
+
+namespace
+{
+	std::string encode_all(const std::vector<LogRecord>& records, const std::vector<SymbolView>& symbols)
+	{
+		Encoder encoder;
+		std::vector<char> out;
+		for (const auto& r : records)
+			encoder.encode(r, symbols, out);
+		return {out.begin(), out.end()};
+	}
+
+	std::vector<Event> decode_all(const std::string& bytes)
+	{
+		std::istringstream in(bytes);
+		Decoder decoder(in);
+		std::vector<Event> events;
+		Event ev;
+		while (decoder.next(ev))
+			events.push_back(ev);
+		return events;
+	}
+
+	// Decodes a trace and renders it with the Logger text format, like gwatch-dump does.
+	std::string to_text(const std::string& bytes)
+	{
+		std::istringstream in(bytes);
+		Decoder decoder(in);
+		std::string text;
+		Event ev;
+		while (decoder.next(ev))
+		{
+			const std::string& name = decoder.symbols()[ev.symbol].name;
+			std::string line(Logger::max_line_length(name.size()), '\0');
+			line.resize(Logger::format_text(LogRecord{.old_value = ev.old_value, .new_value = ev.new_value, .symbol = ev.symbol, .kind = ev.kind, .exact = ev.exact, .repeat = ev.repeat}, name, line.data()));
+			text += line;
+		}
+		return text;
+	}
+}
+
+TEST(TraceFormatTest, RoundTripPreservesEveryField)
+{
+	constexpr auto maxv = std::numeric_limits<std::uint64_t>::max();
+	const std::vector<SymbolView> symbols = {{"g_counter", 4}, {"g_big", 8}};
+	const std::vector<LogRecord> records = {
+		{.timestamp_ns = 1'000'000, .old_value = 0, .new_value = 0, .tid = 100, .symbol = 0, .kind = AccessKind::Read},
+		{.timestamp_ns = 1'000'500, .old_value = 0, .new_value = 1, .tid = 100, .symbol = 0, .kind = AccessKind::Write},
+		{.timestamp_ns = 1'000'400, .old_value = maxv, .new_value = maxv, .tid = 101, .symbol = 1, .kind = AccessKind::Read},
+		{.timestamp_ns = 1'002'000, .old_value = maxv, .new_value = 7, .tid = 101, .symbol = 1, .kind = AccessKind::Write},
+		{.timestamp_ns = 1'002'001, .old_value = 5, .new_value = 6, .tid = 100, .symbol = 0, .kind = AccessKind::Write},
+		{.timestamp_ns = 1'002'002, .old_value = 6, .new_value = 6, .tid = 100, .symbol = 0, .kind = AccessKind::Read, .repeat = 1'000'000},
+		{.timestamp_ns = 1'900'000, .old_value = 6, .new_value = 6, .tid = 100, .symbol = 0, .kind = AccessKind::Write, .repeat = 2},
+	};
+
+	const std::vector<Event> events = decode_all(encode_all(records, symbols));
+
+	ASSERT_EQ(events.size(), records.size());
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		SCOPED_TRACE(i);
+		EXPECT_EQ(events[i].timestamp_ns, records[i].timestamp_ns);
+		EXPECT_EQ(events[i].tid, records[i].tid);
+		EXPECT_EQ(events[i].symbol, records[i].symbol);
+		EXPECT_EQ(events[i].kind, records[i].kind);
+		EXPECT_EQ(events[i].old_value, records[i].old_value);
+		EXPECT_EQ(events[i].new_value, records[i].new_value);
+		EXPECT_EQ(events[i].repeat, records[i].repeat);
+	}
+}
+
+TEST(TraceFormatTest, HeaderDescribesSymbolsAndLateSymbolsAreDefinedInline)
+{
+	std::vector<SymbolView> symbols = {{"first", 4}};
+	Encoder encoder;
+	std::vector<char> out;
+	encoder.encode(LogRecord{.timestamp_ns = 1, .symbol = 0}, symbols, out);
+	symbols.push_back({"second", 8});
+	encoder.encode(LogRecord{.timestamp_ns = 2, .new_value = 3, .symbol = 1}, symbols, out);
+
+	std::istringstream in(std::string(out.begin(), out.end()));
+	Decoder decoder(in);
+	Event ev;
+	ASSERT_TRUE(decoder.next(ev));
+	ASSERT_EQ(decoder.symbols().size(), 1u);
+	EXPECT_EQ(decoder.symbols()[0].name, "first");
+	EXPECT_EQ(decoder.symbols()[0].size, 4u);
+
+	ASSERT_TRUE(decoder.next(ev));
+	ASSERT_EQ(decoder.symbols().size(), 2u);
+	EXPECT_EQ(decoder.symbols()[1].name, "second");
+	EXPECT_EQ(decoder.symbols()[1].size, 8u);
+	EXPECT_EQ(ev.new_value, 3u);
+	EXPECT_FALSE(decoder.next(ev));
+}
+
+TEST(TraceFormatTest, AtLeastFiveTimesSmallerThanText)
+{
+	const std::vector<SymbolView> symbols = {{"g_counter", 4}};
+	std::vector<LogRecord> records;
+	std::uint64_t value = 0;
+	std::uint64_t time = 5'000'000'000;
+	for (int i = 0; i < 10000; ++i)
+	{
+		time += 1500 + (i % 7) * 100;
+		records.push_back({.timestamp_ns = time, .old_value = value, .new_value = value, .tid = 4242, .symbol = 0, .kind = AccessKind::Read});
+		time += 900;
+		records.push_back({.timestamp_ns = time, .old_value = value, .new_value = value + 1, .tid = 4242, .symbol = 0, .kind = AccessKind::Write});
+		++value;
+	}
+
+	const std::string binary = encode_all(records, symbols);
+	const std::string text = to_text(binary);
+
+	EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), static_cast<long>(records.size()));
+	EXPECT_GE(text.size(), binary.size() * 5) << "text=" << text.size() << " binary=" << binary.size();
+}
+
+TEST(TraceFormatTest, UnknownValuesCarryNoneAndKeepThePreviousOne)
+{
+	const std::string bytes = encode_all({
+		LogRecord{.timestamp_ns = 1, .old_value = 0, .new_value = 7, .symbol = 0, .kind = AccessKind::Write},
+		LogRecord{.timestamp_ns = 2, .symbol = 0, .kind = AccessKind::Write, .exact = false, .repeat = 3},
+		LogRecord{.timestamp_ns = 3, .old_value = 7, .new_value = 7, .symbol = 0, .kind = AccessKind::Read},
+	}, {{"x", 4}});
+
+	EXPECT_EQ(to_text(bytes), "x write 0 -> 7\nx write ? x3\nx read 7\n");
+	const std::vector<Event> events = decode_all(bytes);
+	ASSERT_EQ(events.size(), 3u);
+	EXPECT_FALSE(events[1].exact);
+	EXPECT_EQ(events[1].repeat, 3u);
+	EXPECT_TRUE(events[2].exact);
+}
+
+TEST(TraceFormatTest, EmptyStreamHasNoEvents)
+{
+	EXPECT_TRUE(decode_all("").empty());
+}
+
+TEST(TraceFormatTest, ZeroPaddingEndsTheStream)
+{
+	const std::string bytes = encode_all({LogRecord{.timestamp_ns = 1'000'000, .old_value = 1, .new_value = 300, .symbol = 0, .kind = AccessKind::Write}}, {{"x", 4}});
+	// What a trace file segment looks like after a crash.
+	EXPECT_EQ(decode_all(bytes + std::string(4096, '\0')).size(), 1u);
+	EXPECT_TRUE(decode_all(std::string(4096, '\0')).empty());
+}
+
+TEST(TraceFormatTest, RejectsBadMagicAndTruncatedInput)
+{
+	EXPECT_THROW(decode_all("nope"), TraceError);
+
+	const std::string bytes = encode_all({LogRecord{.timestamp_ns = 1'000'000, .old_value = 1, .new_value = 300, .symbol = 0, .kind = AccessKind::Write}}, {{"x", 4}});
+	EXPECT_THROW(decode_all(bytes.substr(0, bytes.size() - 1)), TraceError);
+}
+
+TEST(TraceFormatTest, LoggerBinaryOutputDecodesToTheTextFormat)
+{
+	const auto sequence = []
+	{
+		Logger::log_read("bin_a", 0, 1, 10);
+		Logger::log_write("bin_a", 0, 41, 1, 20);
+		Logger::log_write("bin_b", 41, 42, 2, 30);
+		Logger::log_read("bin_a", 41);
+	};
+	const std::string expected =
+		"bin_a read 0\n"
+		"bin_a write 0 -> 41\n"
+		"bin_b write 41 -> 42\n"
+		"bin_a read 41\n";
+
+	for (const bool async : {false, true})
+	{
+		SCOPED_TRACE(async);
+		testing::internal::CaptureStdout();
+		Logger::set_format(LogFormat::Binary);
+		if (async)
+			Logger::start_async();
+		sequence();
+		Logger::stop_async();
+		Logger::flush();
+		Logger::set_format(LogFormat::Text);
+		const std::string out = testing::internal::GetCapturedStdout();
+
+		EXPECT_EQ(to_text(out), expected);
+		const std::vector<Event> events = decode_all(out);
+		ASSERT_EQ(events.size(), 4u);
+		EXPECT_EQ(events[2].tid, 2u);
+		EXPECT_EQ(events[2].timestamp_ns, 30u);
+		EXPECT_GT(events[3].timestamp_ns, 0u);
+	}
+}
+
+TEST(TraceFormatTest, LoggerCoalescedRunsDecodeWithTheirCount)
+{
+	testing::internal::CaptureStdout();
+	Logger::set_format(LogFormat::Binary);
+	Logger::set_coalescing(Coalescing::Global, 0);
+	for (int i = 0; i < 1000; ++i)
+		Logger::log_read("bin_spin", 0, 1, 100 + i);
+	Logger::log_write("bin_spin", 0, 1, 1, 2000);
+	Logger::set_coalescing(Coalescing::Off);
+	Logger::set_format(LogFormat::Text);
+	const std::string out = testing::internal::GetCapturedStdout();
+
+	EXPECT_EQ(to_text(out), "bin_spin read 0 x1000\nbin_spin write 0 -> 1\n");
+	const std::vector<Event> events = decode_all(out);
+	ASSERT_EQ(events.size(), 2u);
+	EXPECT_EQ(events[0].repeat, 1000u);
+	EXPECT_EQ(events[0].timestamp_ns, 100u);
+	EXPECT_EQ(events[1].repeat, 1u);
+}
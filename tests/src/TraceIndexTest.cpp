@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ColumnarTrace.h"
+#include "MappedFile.h"
+#include "TraceIndex.h"
+
+using gwatch::AccessKind;
+using gwatch::LogRecord;
+namespace columnar = gwatch::columnar;
+namespace query = gwatch::query;
+
+namespace
+{
+	// Two threads writing a few distinct values in turn, with a read every third access.
+	// Timestamps step back a little every 1000 rows, like coalesced runs written late.
+	LogRecord make_record(const std::uint64_t i)
+	{
+		return LogRecord{
+			.timestamp_ns = 1'000'000 + i * 10 - (i % 1000 == 999 ? 5'000 : 0),
+			.old_value = i % 7,
+			.new_value = (i * 13) % 11,
+			.tid = i % 5 < 3 ? 100u : 200u,
+			.symbol = static_cast<std::uint32_t>(i % 2),
+			.kind = i % 3 == 0 ? AccessKind::Read : AccessKind::Write,
+			.repeat = 1,
+		};
+	}
+
+	std::vector<char> make_trace(const std::uint64_t first, const std::uint64_t rows, const std::uint32_t groupRows)
+	{
+		static const std::string names[] = {"g_state", "g_flag"};
+		const gwatch::trace::SymbolView symbols[] = {{names[0], 8}, {names[1], 4}};
+		columnar::Writer writer(groupRows);
+		std::vector<char> out;
+		for (std::uint64_t i = first; i < first + rows; ++i)
+		{
+			if (writer.add(make_record(i)))
+				writer.render(symbols, out);
+		}
+		if (writer.buffered() != 0)
+			writer.render(symbols, out);
+		return out;
+	}
+
+	void write_file(const std::filesystem::path& path, const std::vector<char>& bytes)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	bool matches(const LogRecord& record, const columnar::Filter& filter)
+	{
+		return (!filter.var || record.symbol == *filter.var) && (!filter.tid || record.tid == *filter.tid)
+		       && (!filter.kind || record.kind == *filter.kind) && (!filter.value || record.new_value == *filter.value)
+		       && record.timestamp_ns >= filter.fromNs && record.timestamp_ns <= filter.toNs;
+	}
+
+	// Timestamps of the rows run() visits, and of the rows a plain loop keeps, in row order.
+	std::pair<std::vector<std::uint64_t>, std::vector<std::uint64_t>> run_both(const columnar::Reader& trace, const query::TraceIndex& index, const columnar::Filter& filter)
+	{
+		std::vector<std::uint64_t> found;
+		const std::uint64_t count = query::run(trace, index, filter, [&](const columnar::RowGroup& group, const std::uint32_t row)
+		{
+			found.push_back(group.timestamps()[row]);
+			return true;
+		});
+		EXPECT_EQ(count, found.size());
+		std::vector<std::uint64_t> expected;
+		for (const columnar::RowGroup& group : trace.groups())
+		{
+			for (std::uint32_t row = 0; row < group.rows(); ++row)
+			{
+				if (matches(group.record(row), filter))
+					expected.push_back(group.timestamps()[row]);
+			}
+		}
+		return {found, expected};
+	}
+
+	class TraceIndexTest : public testing::Test
+	{
+	protected:
+		std::filesystem::path m_dir;
+
+		void SetUp() override
+		{
+			m_dir = std::filesystem::temp_directory_path() / ("gwatch_index_" + std::string(testing::UnitTest::GetInstance()->current_test_info()->name()));
+			std::filesystem::remove_all(m_dir);
+			std::filesystem::create_directories(m_dir);
+		}
+
+		void TearDown() override
+		{
+			std::filesystem::remove_all(m_dir);
+		}
+	};
+}
+
+TEST_F(TraceIndexTest, LooksUpThreadsAndWrittenValues)
+{
+	const std::vector<char> bytes = make_trace(0, 20'000, 3000);
+	const columnar::Reader trace(bytes);
+	const std::vector<char> data = query::build_index(trace, bytes.size());
+	const query::TraceIndex index(data);
+	EXPECT_TRUE(index.covers(trace, bytes.size()));
+	EXPECT_FALSE(index.covers(trace, bytes.size() + 64));
+	EXPECT_EQ(index.rows(), 20'000u);
+	ASSERT_EQ(index.threads().size(), 2u);
+	EXPECT_EQ(index.threads()[0].tid, 100u);
+
+	// Blocks stay within their group: 3000-row groups give blocks of 3000 rows.
+	std::uint64_t blockRows = 0;
+	for (const query::Block& block : index.blocks())
+	{
+		EXPECT_LE(block.rows, query::kBlockRows);
+		EXPECT_LE(block.row + block.rows, trace.groups()[block.group].rows());
+		blockRows += block.rows;
+	}
+	EXPECT_EQ(blockRows, 20'000u);
+
+	std::vector<std::uint32_t> tid200;
+	std::vector<std::uint32_t> wrote5;
+	for (std::uint32_t i = 0; i < 20'000; ++i)
+	{
+		const LogRecord record = make_record(i);
+		if (record.tid == 200)
+			tid200.push_back(i);
+		if (record.kind == AccessKind::Write && record.symbol == 1 && record.new_value == 5)
+			wrote5.push_back(i);
+	}
+	const auto rows = index.thread_rows(200);
+	EXPECT_EQ(std::vector<std::uint32_t>(rows.begin(), rows.end()), tid200);
+	const auto writes = index.write_rows(1, 5);
+	EXPECT_EQ(std::vector<std::uint32_t>(writes.begin(), writes.end()), wrote5);
+	EXPECT_TRUE(index.thread_rows(300).empty());
+	EXPECT_TRUE(index.write_rows(1, 12).empty());
+	EXPECT_TRUE(index.write_rows(7, 5).empty());
+}
+
+TEST_F(TraceIndexTest, QueriesMatchAPlainScan)
+{
+	const std::vector<char> bytes = make_trace(0, 50'000, 10'000);
+	const columnar::Reader trace(bytes);
+	const std::vector<char> data = query::build_index(trace, bytes.size());
+	const query::TraceIndex index(data);
+
+	const columnar::Filter filters[] = {
+		{},
+		{.var = 0},
+		{.tid = 200},
+		{.tid = 200, .fromNs = 1'100'000, .toNs = 1'200'000},
+		{.var = 1, .kind = AccessKind::Write, .value = 0},
+		{.kind = AccessKind::Write, .value = 3},
+		{.var = 0, .tid = 100, .kind = AccessKind::Write, .value = 4, .fromNs = 1'200'000},
+		{.kind = AccessKind::Read, .value = 3, .toNs = 1'050'000},
+		{.fromNs = 1'009'990, .toNs = 1'010'000},
+		{.tid = 999},
+		{.var = 1, .kind = AccessKind::Write, .value = 1'000},
+		{.fromNs = 2'000'000},
+	};
+	for (const columnar::Filter& filter : filters)
+	{
+		const auto [found, expected] = run_both(trace, index, filter);
+		EXPECT_EQ(found, expected);
+	}
+
+	std::uint64_t visited = 0;
+	EXPECT_EQ(query::run(trace, index, columnar::Filter{.tid = 100}, [&](const columnar::RowGroup&, std::uint32_t) { return ++visited < 3; }), 3u);
+}
+
+TEST_F(TraceIndexTest, EnsureIndexesBuildsOnlyStaleIndexes)
+{
+	std::vector<std::string> traces;
+	for (std::uint64_t s = 0; s < 4; ++s)
+	{
+		traces.push_back((m_dir / ("t." + std::to_string(s))).string());
+		write_file(traces.back(), make_trace(s * 5'000, 5'000, 2'000));
+	}
+
+	EXPECT_EQ(query::ensure_indexes(traces, 4), 4u);
+	EXPECT_EQ(query::ensure_indexes(traces, 4), 0u);
+	EXPECT_EQ(query::ensure_indexes(traces, 1, true), 4u);
+
+	// A segment that grew and an index that was damaged are rebuilt.
+	write_file(traces[1], make_trace(5'000, 6'000, 2'000));
+	write_file(query::index_path(traces[2]), std::vector<char>(100, 'x'));
+	EXPECT_EQ(query::ensure_indexes(traces, 2), 2u);
+
+	std::uint64_t total = 0;
+	for (const std::string& path : traces)
+	{
+		const gwatch::MappedFile file(path);
+		const gwatch::MappedFile indexFile(query::index_path(path));
+		const columnar::Reader trace(file.bytes());
+		const query::TraceIndex index(indexFile.bytes());
+		EXPECT_TRUE(index.covers(trace, file.bytes().size()));
+		const auto [found, expected] = run_both(trace, index, columnar::Filter{.var = 0, .kind = AccessKind::Write, .value = 7});
+		EXPECT_EQ(found, expected);
+		total += index.rows();
+	}
+	EXPECT_EQ(total, 21'000u);
+	EXPECT_FALSE(std::filesystem::exists(query::index_path(traces[0]) + ".tmp"));
+
+	write_file(traces[3], std::vector<char>(64, '\0'));
+	EXPECT_THROW(query::ensure_indexes(traces, 2), columnar::ColumnarError);
+}
+
+TEST_F(TraceIndexTest, Error_CorruptIndex)
+{
+	const std::vector<char> bytes = make_trace(0, 5'000, 1'000);
+	const columnar::Reader trace(bytes);
+	const std::vector<char> data = query::build_index(trace, bytes.size());
+
+	EXPECT_THROW(query::TraceIndex(std::vector<char>(64, 'x')), query::IndexError);
+	const std::vector<char> cut(data.begin(), data.end() - 8);
+	EXPECT_THROW(query::TraceIndex{cut}, query::IndexError);
+	std::vector<char> badSlots = data;
+	badSlots[40] = 3; // not a power of two
+	EXPECT_THROW(query::TraceIndex{badSlots}, query::IndexError);
+
+	// An index of another trace is refused by run().
+	const std::vector<char> other = make_trace(0, 4'000, 1'000);
+	const columnar::Reader otherTrace(other);
+	const query::TraceIndex index(data);
+	EXPECT_FALSE(index.covers(otherTrace, other.size()));
+	EXPECT_THROW(query::run(otherTrace, index, columnar::Filter{}, [](const columnar::RowGroup&, std::uint32_t) { return true; }), query::IndexError);
+}
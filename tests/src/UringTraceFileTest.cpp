@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "Logger.h"
+#include "TraceFormat.h"
+#include "UringTraceFile.h"
+
+using gwatch::Logger;
+using gwatch::TraceBackend;
+using gwatch::TraceFileOptions;
+using gwatch::UringTraceFile;
+
+namespace
+{
+	// A fresh directory per test, removed with everything in it.
+	struct TempDir
+	{
+		std::filesystem::path path;
+
+		explicit TempDir(const std::string& name) :
+			path(std::filesystem::temp_directory_path() / ("gwatch_" + name + "_" + std::to_string(getpid())))
+		{
+			std::filesystem::remove_all(path);
+			std::filesystem::create_directories(path);
+		}
+		~TempDir() { std::filesystem::remove_all(path); }
+
+		std::string file(const std::string& name) const { return (path / name).string(); }
+	};
+
+	std::string read_file(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	}
+
+	std::string line(const int i)
+	{
+		return "v write " + std::to_string(i) + " -> " + std::to_string(i + 1) + "\n";
+	}
+
+	// Containers and hardened kernels may refuse io_uring_setup (or O_DIRECT on the temp
+	// file system); the tests that need them are skipped there.
+	bool available(const TempDir& dir, const bool direct = false)
+	{
+		try
+		{
+			UringTraceFile probe(TraceFileOptions{.path = dir.file("probe"), .segmentBytes = 64 << 10, .backend = TraceBackend::Uring, .direct = direct});
+			return true;
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+	}
+}
+
+TEST(UringTraceFileTest, RecordsStraddleBlocksButNeverSegments)
+{
+	const TempDir dir("uring_split");
+	if (!available(dir))
+		GTEST_SKIP() << "io_uring is not available";
+
+	std::string expected;
+	{
+		UringTraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10, .backend = TraceBackend::Uring, .blockBytes = 4 << 10, .queueDepth = 2});
+		for (int i = 0; i < 10'000; ++i)
+		{
+			const std::string text = line(i);
+			if (!file.has_room(text.size()))
+				file.rotate();
+			file.append(text.data(), text.size());
+			expected += text;
+		}
+		EXPECT_GT(file.segments(), 2u);
+		EXPECT_EQ(file.error(), 0);
+	}
+
+	std::string joined;
+	for (int index = 0; std::filesystem::exists(dir.file("t." + std::to_string(index))); ++index)
+	{
+		const std::string segment = read_file(dir.file("t." + std::to_string(index)));
+		EXPECT_LE(segment.size(), 64u << 10);
+		EXPECT_EQ(segment.back(), '\n');
+		joined += segment;
+	}
+	EXPECT_EQ(joined, expected);
+}
+
+TEST(UringTraceFileTest, DirectSegmentsAreTruncatedToTheirData)
+{
+	const TempDir dir("uring_direct");
+	if (!available(dir, true))
+		GTEST_SKIP() << "io_uring or O_DIRECT is not available";
+
+	std::string expected;
+	{
+		UringTraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10, .backend = TraceBackend::Uring, .blockBytes = 8 << 10, .direct = true});
+		for (int i = 0; i < 1'000; ++i)
+		{
+			const std::string text = line(i);
+			file.append(text.data(), text.size());
+			expected += text;
+		}
+		EXPECT_EQ(file.error(), 0);
+	}
+	// The last block went out padded to 4 KiB.
+	EXPECT_NE(expected.size() % 4096, 0u);
+	EXPECT_EQ(read_file(dir.file("t.0")), expected);
+}
+
+TEST(UringTraceFileTest, RetainsOnlyTheNewestSegments)
+{
+	const TempDir dir("uring_keep");
+	if (!available(dir))
+		GTEST_SKIP() << "io_uring is not available";
+
+	UringTraceFile file(TraceFileOptions{.path = dir.file("t"), .segmentBytes = 64 << 10, .keep = 2, .backend = TraceBackend::Uring});
+	for (int i = 0; i < 5; ++i)
+	{
+		file.append("x\n", 2);
+		file.rotate();
+	}
+
+	EXPECT_EQ(file.segments(), 6u);
+	EXPECT_FALSE(std::filesystem::exists(file.segment_path(3)));
+	EXPECT_EQ(read_file(file.segment_path(4)), "x\n");
+	EXPECT_TRUE(std::filesystem::exists(file.segment_path(5)));
+}
+
+TEST(UringTraceFileTest, Error_InvalidBlockSize)
+{
+	const TempDir dir("uring_block");
+	EXPECT_THROW(UringTraceFile(TraceFileOptions{.path = dir.file("t"), .backend = TraceBackend::Uring, .blockBytes = 1000}), std::runtime_error);
+}
+
+TEST(UringTraceFileTest, LoggerWritesBinarySegmentsThroughTheRing)
+{
+	const TempDir dir("uring_logger");
+	if (!available(dir))
+		GTEST_SKIP() << "io_uring is not available";
+
+	const std::string path = dir.file("t");
+	Logger::set_format(gwatch::LogFormat::Binary);
+	Logger::open_trace_file(TraceFileOptions{.path = path, .segmentBytes = 64 << 10, .backend = TraceBackend::Uring, .blockBytes = 16 << 10, .queueDepth = 3});
+	Logger::start_async();
+	for (std::uint64_t i = 0; i < 100'000; ++i)
+		Logger::log_write(i % 2 ? "ring_a" : "ring_b", i, i * 977, static_cast<std::uint32_t>(i % 3), 1'000 + i);
+	Logger::stop_async();
+	Logger::close_trace_file();
+	Logger::set_format(gwatch::LogFormat::Text);
+
+	std::uint64_t next = 0;
+	int segments = 0;
+	for (; std::filesystem::exists(path + "." + std::to_string(segments)); ++segments)
+	{
+		std::istringstream in(read_file(path + "." + std::to_string(segments)));
+		gwatch::trace::Decoder decoder(in);
+		gwatch::trace::Event ev;
+		while (decoder.next(ev))
+		{
+			ASSERT_EQ(ev.old_value, next);
+			EXPECT_EQ(ev.new_value, next * 977);
+			EXPECT_EQ(decoder.symbols()[ev.symbol].name, next % 2 ? "ring_a" : "ring_b");
+			++next;
+		}
+	}
+	EXPECT_GT(segments, 1);
+	EXPECT_EQ(next, 100'000u);
+}
+
+#endif
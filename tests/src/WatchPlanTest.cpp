@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+#include "WatchPlan.h"
+
+using namespace gwatch;
+
+namespace
+{
+	ResolvedSymbol var(const std::uint64_t address, const std::uint64_t size)
+	{
+		return ResolvedSymbol{.name = "v", .module = {}, .address = address, .size = size};
+	}
+}
+
+TEST(WatchPlanTest, AlignedVariableGetsAnExactSlot)
+{
+	const std::vector symbols{var(0x1000, 8), var(0x2004, 4)};
+
+	const WatchPlan plan = compile_watch_plan(symbols);
+
+	ASSERT_EQ(plan.slots.size(), 2u);
+	EXPECT_EQ(plan.slots[0].address, 0x1000u);
+	EXPECT_EQ(plan.slots[0].size, 8u);
+	EXPECT_EQ(plan.slots[0].variables, 0b01u);
+	EXPECT_EQ(plan.slots[1].address, 0x2004u);
+	EXPECT_EQ(plan.slots[1].size, 4u);
+	EXPECT_EQ(plan.slots[1].variables, 0b10u);
+	EXPECT_EQ(plan.covered, (std::vector<std::uint32_t>{0, 1}));
+	EXPECT_TRUE(plan.uncovered.empty());
+}
+
+TEST(WatchPlanTest, NeighboursShareAWordOnlyWhenTheBudgetRequiresIt)
+{
+	const std::vector symbols{var(0x1000, 4), var(0x1004, 4)};
+
+	const WatchPlan roomy = compile_watch_plan(symbols, 4);
+	ASSERT_EQ(roomy.slots.size(), 2u);
+	EXPECT_EQ(roomy.slots[0].size, 4u);
+	EXPECT_EQ(roomy.slots[1].address, 0x1004u);
+
+	const WatchPlan tight = compile_watch_plan(symbols, 1);
+	ASSERT_EQ(tight.slots.size(), 1u);
+	EXPECT_EQ(tight.slots[0].address, 0x1000u);
+	EXPECT_EQ(tight.slots[0].size, 8u);
+	EXPECT_EQ(tight.slots[0].variables, 0b11u);
+	EXPECT_TRUE(tight.uncovered.empty());
+}
+
+TEST(WatchPlanTest, UnalignedVariableIsSplitAcrossTwoSlots)
+{
+	const std::vector symbols{var(0x1004, 8)};
+
+	const WatchPlan plan = compile_watch_plan(symbols);
+
+	ASSERT_EQ(plan.slots.size(), 2u);
+	EXPECT_EQ(plan.slots[0].address, 0x1004u);
+	EXPECT_EQ(plan.slots[0].size, 4u);
+	EXPECT_EQ(plan.slots[1].address, 0x1008u);
+	EXPECT_EQ(plan.slots[1].size, 4u);
+	EXPECT_EQ(plan.variables_of(0b10), 0b1u);
+}
+
+TEST(WatchPlanTest, PacksEightIntsIntoFourSlots)
+{
+	std::vector<ResolvedSymbol> symbols;
+	for (std::uint64_t i = 0; i < 8; ++i)
+		symbols.push_back(var(0x1000 + 4 * i, 4));
+
+	const WatchPlan plan = compile_watch_plan(symbols);
+
+	ASSERT_EQ(plan.slots.size(), 4u);
+	EXPECT_EQ(plan.covered.size(), 8u);
+	for (const auto& slot : plan.slots)
+		EXPECT_EQ(slot.size, 8u);
+	EXPECT_EQ(plan.variables_of(0b1111), 0xFFu);
+}
+
+TEST(WatchPlanTest, ReportsWhatDoesNotFit)
+{
+	const std::vector symbols{var(0x1000, 4), var(0x2000, 8), var(0x3004, 8), var(0x4000, 4), var(0x1004, 4)};
+
+	const WatchPlan plan = compile_watch_plan(symbols);
+
+	// The third variable takes two words and exhausts the budget: the fourth is left out,
+	// the fifth still fits in the first one's word.
+	EXPECT_EQ(plan.covered, (std::vector<std::uint32_t>{0, 1, 2, 4}));
+	EXPECT_EQ(plan.uncovered, (std::vector<std::uint32_t>{3}));
+	EXPECT_EQ(plan.covered_mask(), 0b10111u);
+	ASSERT_EQ(plan.slots.size(), 4u);
+	EXPECT_EQ(plan.slots[0].size, 8u);
+	EXPECT_EQ(plan.slots[0].variables, 0b10001u);
+}
+
+TEST(WatchPlanTest, RejectsTooManyVariables)
+{
+	const std::vector symbols(kMaxPlannedVariables + 1, var(0x1000, 4));
+	EXPECT_THROW(compile_watch_plan(symbols), std::invalid_argument);
+}
+
+TEST(WatchPlanTest, AttributesAnAccessByTheBytesItTouched)
+{
+	const std::vector symbols{var(0x1000, 2), var(0x1002, 2), var(0x1004, 4)};
+	const auto symbol_of = [&](const std::size_t v) -> const ResolvedSymbol& { return symbols[v]; };
+
+	EXPECT_EQ(attribute_access(0b111, 0x1002, 2, symbol_of), 0b010u);
+	EXPECT_EQ(attribute_access(0b111, 0x1000, 4, symbol_of), 0b011u);
+	EXPECT_EQ(attribute_access(0b110, 0x1000, 2, symbol_of), 0u);    // bytes of the window no candidate owns
+	EXPECT_EQ(attribute_access(0b111, 0x1006, 0, symbol_of), 0b100u); // unknown width: the first byte
+
+	// A lone candidate needs no address; shared ones are never all reported.
+	EXPECT_EQ(attribute_access(0b100, std::nullopt, 4, symbol_of), 0b100u);
+	EXPECT_EQ(attribute_access(0b011, std::nullopt, 4, symbol_of), 0u);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "WatchRotation.h"
+
+using namespace gwatch;
+
+namespace
+{
+	std::vector<ResolvedSymbol> spread_variables(const std::size_t count)
+	{
+		std::vector<ResolvedSymbol> symbols;
+		for (std::size_t i = 0; i < count; ++i)
+			symbols.push_back(ResolvedSymbol{.name = "v" + std::to_string(i), .module = {}, .address = 0x1000 + 0x40 * i, .size = 8});
+		return symbols;
+	}
+}
+
+TEST(WatchRotationTest, SingleGroupWhenEverythingFits)
+{
+	const auto symbols = spread_variables(4);
+	const WatchRotation rotation(symbols);
+
+	EXPECT_EQ(rotation.group_count(), 1u);
+	EXPECT_EQ(rotation.current().covered.size(), 4u);
+	EXPECT_TRUE(rotation.current().uncovered.empty());
+}
+
+TEST(WatchRotationTest, CyclesThroughGroupsCoveringEveryVariable)
+{
+	const auto symbols = spread_variables(10);
+	WatchRotation rotation(symbols);
+
+	ASSERT_EQ(rotation.group_count(), 3u);
+	EXPECT_EQ(rotation.max_slots(), 4u);
+
+	rotation.start(0);
+	EXPECT_EQ(rotation.current().covered, (std::vector<std::uint32_t>{0, 1, 2, 3}));
+	EXPECT_EQ(rotation.current().uncovered.size(), 6u);
+	// Slot masks use indices into the full list.
+	EXPECT_EQ(rotation.advance(100).covered, (std::vector<std::uint32_t>{4, 5, 6, 7}));
+	EXPECT_EQ(rotation.current().slots[0].variables, 1ull << 4);
+	EXPECT_EQ(rotation.advance(200).covered, (std::vector<std::uint32_t>{8, 9}));
+	EXPECT_EQ(rotation.advance(300).covered, (std::vector<std::uint32_t>{0, 1, 2, 3}));
+}
+
+TEST(WatchRotationTest, KeepsThePlanOfEveryGroupAfterAdvancing)
+{
+	const auto symbols = spread_variables(10);
+	WatchRotation rotation(symbols);
+
+	rotation.start(0);
+	const std::size_t armed = rotation.current_group();
+	rotation.advance(100);
+	// A trap on slot 1 taken before the switch still names variable 1, not 5.
+	EXPECT_EQ(rotation.current_group(), 1u);
+	EXPECT_EQ(rotation.group(armed).variables_of(0b10), 1ull << 1);
+	EXPECT_EQ(rotation.current().variables_of(0b10), 1ull << 5);
+}
+
+TEST(WatchRotationTest, ScalesObservedAccessesByCoverage)
+{
+	const auto symbols = spread_variables(5);
+	WatchRotation rotation(symbols);
+	ASSERT_EQ(rotation.group_count(), 2u);
+
+	rotation.start(1'000'000'000);
+	for (int i = 0; i < 10; ++i)
+		rotation.record_hit(0);
+	rotation.advance(1'250'000'000);
+	for (int i = 0; i < 30; ++i)
+		rotation.record_hit(4);
+	rotation.stop(2'000'000'000);
+
+	const auto estimates = rotation.estimates();
+	ASSERT_EQ(estimates.size(), 5u);
+	EXPECT_EQ(estimates[0].observed, 10u);
+	EXPECT_DOUBLE_EQ(estimates[0].coverage, 0.25);
+	EXPECT_DOUBLE_EQ(estimates[0].estimated, 40.0);
+	EXPECT_DOUBLE_EQ(estimates[0].rate_per_second, 40.0);
+	EXPECT_DOUBLE_EQ(estimates[4].coverage, 0.75);
+	EXPECT_DOUBLE_EQ(estimates[4].estimated, 40.0);
+	EXPECT_EQ(estimates[1].observed, 0u);
+	EXPECT_DOUBLE_EQ(estimates[1].estimated, 0.0);
+}
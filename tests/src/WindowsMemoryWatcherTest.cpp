@@ -49,7 +49,7 @@ namespace
 		CreateProcessInfo cp{};
 		cp.image_base = 0;
 		cp.entry_point = 0;
-		cp.image_path = "";
+		cp.image_path = kEmptyString;
 		ev.payload = cp;
 		return ev;
 	}
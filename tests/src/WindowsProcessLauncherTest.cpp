@@ -28,6 +28,7 @@ namespace
 struct RecordingSink final : gwatch::IDebugEventSink
 {
     bool saw_create_process = false;
+    gwatch::StringId image_path = gwatch::kEmptyString;
     std::optional<std::uint32_t> exit_code;
 
     gwatch::ContinueStatus on_event(const gwatch::DebugEvent& ev) override
@@ -37,6 +38,7 @@ struct RecordingSink final : gwatch::IDebugEventSink
         {
             case T::_CreateProcess:
                 saw_create_process = true;
+                image_path = std::get<gwatch::CreateProcessInfo>(ev.payload).image_path;
                 break;
             case T::ExitProcess:
             {
@@ -75,6 +77,8 @@ TEST(WindowsProcessLauncherTest, LaunchesAndReceivesEvents)
 	ASSERT_TRUE(result.has_value()) << "Exit code should be available.";
 	EXPECT_EQ(result.value(), 123u) << "Debuggee must return 123.";
     EXPECT_TRUE(sink.saw_create_process) << "CREATE_PROCESS event should have been observed.";
+	// Read from the image file handle of the event, without the "\\?\" prefix.
+	EXPECT_EQ(std::filesystem::path(launcher.strings().view(sink.image_path)), std::filesystem::canonical(exe));
 }
 
 TEST(WindowsProcessLauncherTest, LaunchFailsForMissingExe)
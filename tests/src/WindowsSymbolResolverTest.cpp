@@ -87,7 +87,7 @@ TEST(SymbolResolverCtor, NullHandleThrows)
 
 TEST_F(WindowsSymbolResolverTest, Resolve_Int64_Global)
 {
-	const auto [name, module, address, size] = resolver->resolve("GWatchTest_Global64");
+	const auto [name, module, address, size, element] = resolver->resolve("GWatchTest_Global64");
 	EXPECT_EQ(name, "GWatchTest_Global64") << "Name should match the undecorated C symbol.";
 	EXPECT_EQ(size, 8u) << "Expect 8 bytes for long long on Windows.";
 	EXPECT_NE(address, 0u) << "Virtual address must be non-zero.";
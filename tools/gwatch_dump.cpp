@@ -0,0 +1,229 @@
+#include "ColumnarTrace.h"
+#include "Compression.h"
+#include "Logger.h"
+#include "TraceFormat.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Converts a trace written with `gwatch --format=binary` or `--format=columnar` back to the
+// Logger text format or to CSV. Input compressed with `gwatch --compress` is decompressed
+// first, its blocks in parallel.
+namespace
+{
+	void print_record(const gwatch::LogRecord& record, const std::string_view symbol, const bool csv, std::vector<char>& line)
+	{
+		if (csv && !record.exact) // values unknown: empty fields
+		{
+			std::printf("%" PRIu64 ",%" PRIu32 ",%.*s,%s,,,%" PRIu32 "\n",
+			            record.timestamp_ns, record.tid, static_cast<int>(symbol.size()), symbol.data(),
+			            record.kind == gwatch::AccessKind::Write ? "write" : "read", record.repeat);
+			return;
+		}
+		if (csv)
+		{
+			std::printf("%" PRIu64 ",%" PRIu32 ",%.*s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu32 "\n",
+			            record.timestamp_ns, record.tid, static_cast<int>(symbol.size()), symbol.data(),
+			            record.kind == gwatch::AccessKind::Write ? "write" : "read", record.old_value, record.new_value, record.repeat);
+			return;
+		}
+		line.resize(gwatch::Logger::max_line_length(symbol.size()));
+		const std::size_t n = gwatch::Logger::format_text(record, symbol, line.data());
+		std::fwrite(line.data(), 1, n, stdout);
+	}
+
+	// data must be 8-byte aligned.
+	void print_columnar(const std::span<const char> data, const bool csv, std::vector<char>& line)
+	{
+		const gwatch::columnar::Reader reader(data);
+		for (const auto& group : reader.groups())
+		{
+			for (std::uint32_t i = 0; i < group.rows(); ++i)
+			{
+				const gwatch::LogRecord record = group.record(i);
+				print_record(record, record.symbol < reader.symbols().size() ? std::string_view(reader.symbols()[record.symbol].name) : std::string_view("?"), csv, line);
+			}
+		}
+	}
+
+	// The bytes read to sniff the format, then the rest of the stream.
+	class PrefixedBuf final : public std::streambuf
+	{
+	public:
+		PrefixedBuf(std::string prefix, std::streambuf* rest) :
+			m_prefix(std::move(prefix)),
+			m_rest(rest)
+		{
+			setg(m_prefix.data(), m_prefix.data(), m_prefix.data() + m_prefix.size());
+		}
+
+	protected:
+		int_type underflow() override
+		{
+			if (m_rest == nullptr)
+				return traits_type::eof();
+			const std::streamsize n = m_rest->sgetn(m_buffer, sizeof(m_buffer));
+			if (n <= 0)
+				return traits_type::eof();
+			setg(m_buffer, m_buffer, m_buffer + n);
+			return traits_type::to_int_type(m_buffer[0]);
+		}
+
+	private:
+		std::string m_prefix;
+		std::streambuf* m_rest;
+		char m_buffer[1 << 16];
+	};
+
+	void print_usage(std::ostream& os, const std::string_view programName)
+	{
+		os <<
+			"Usage:\n"
+			"  " << programName << " [--csv] [<trace-file>... | -]\n\n"
+			"Options:\n"
+			"      --csv              Print timestamp_ns,tid,symbol,access,old_value,new_value,count rows\n"
+			"  -h, --help             Show this help and exit\n\n"
+			"Notes:\n"
+			"  - Reads stdin when no file (or `-`) is given.\n"
+			"  - Several files are decoded one after the other, e.g. the segments of a --trace-file.\n"
+			"  - Binary and columnar traces are told apart by their header.\n"
+			"  - --compress output is decompressed first; compressed text is printed as is.\n"
+			"  - Without --csv the output is identical to gwatch's text output.\n";
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::string_view programName = argc > 0 ? argv[0] : "gwatch-dump";
+	bool csv = false;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view tok = argv[i];
+		if (tok == "-h" || tok == "--help")
+		{
+			print_usage(std::cout, programName);
+			return 0;
+		}
+		if (tok == "--csv")
+		{
+			csv = true;
+			continue;
+		}
+		if ((tok.starts_with("-") && tok != "-") || (tok == "-" && !paths.empty()) || (!paths.empty() && paths.front() == "-"))
+		{
+			std::cerr << "Error: Unexpected argument: " << tok << "\n\n";
+			print_usage(std::cerr, programName);
+			return 2;
+		}
+		paths.emplace_back(tok);
+	}
+	if (paths.empty())
+		paths.emplace_back("-");
+
+	if (csv)
+		std::fputs("timestamp_ns,tid,symbol,access,old_value,new_value,count\n", stdout);
+	std::vector<char> line;
+	for (const std::string& path : paths)
+	{
+		std::ifstream file;
+		std::istream* in = &std::cin;
+		if (path != "-")
+		{
+			file.open(path, std::ios::binary);
+			if (!file)
+			{
+				std::fflush(stdout);
+				std::cerr << "Error: cannot open '" << path << "'.\n";
+				return 1;
+			}
+			in = &file;
+		}
+		else
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			std::ios::sync_with_stdio(false);
+		}
+
+		std::string head(sizeof(gwatch::compress::kMagic), '\0');
+		head.resize(static_cast<std::size_t>(in->rdbuf()->sgetn(head.data(), static_cast<std::streamsize>(head.size()))));
+		std::istringstream decompressedIn;
+		PrefixedBuf prefixed(head, in->rdbuf());
+		std::istream sniffed(&prefixed);
+		in = &sniffed;
+
+		try
+		{
+			if (gwatch::compress::is_compressed(head) || head == std::string_view(gwatch::columnar::kMagic, sizeof(gwatch::columnar::kMagic)))
+			{
+				// Read whole: std::vector storage is aligned for the columnar reader.
+				std::vector<char> data{std::istreambuf_iterator<char>(in->rdbuf()), std::istreambuf_iterator<char>{}};
+				if (gwatch::compress::is_compressed(data))
+					data = gwatch::compress::decompress(data, std::max(1u, std::thread::hardware_concurrency()));
+				const auto starts_with = [&data](const char (&magic)[4])
+				{
+					return data.size() >= sizeof(magic) && std::memcmp(data.data(), magic, sizeof(magic)) == 0;
+				};
+				if (starts_with(gwatch::columnar::kMagic))
+				{
+					print_columnar(data, csv, line);
+					continue;
+				}
+				if (!starts_with(gwatch::trace::kMagic))
+				{
+					if (csv)
+						throw gwatch::trace::TraceError("--csv needs a binary or columnar trace, the compressed stream holds text");
+					std::fwrite(data.data(), 1, data.size(), stdout);
+					continue;
+				}
+				decompressedIn.str(std::string(data.begin(), data.end()));
+				in = &decompressedIn;
+			}
+
+			gwatch::trace::Decoder decoder(*in);
+			gwatch::trace::Event ev;
+			while (decoder.next(ev))
+			{
+				const gwatch::LogRecord record{
+					.timestamp_ns = ev.timestamp_ns,
+					.old_value = ev.old_value,
+					.new_value = ev.new_value,
+					.tid = ev.tid,
+					.symbol = ev.symbol,
+					.kind = ev.kind,
+					.exact = ev.exact,
+					.repeat = ev.repeat,
+				};
+				print_record(record, decoder.symbols()[ev.symbol].name, csv, line);
+			}
+		}
+		// Malformed input: TraceError, CompressError or ColumnarError.
+		catch (const std::runtime_error& e)
+		{
+			std::fflush(stdout);
+			std::cerr << "Error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,272 @@
+#include "ColumnarTrace.h"
+#include "Logger.h"
+#include "MappedFile.h"
+#include "TraceIndex.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Answers questions such as "which thread wrote 0 into g_state between t1 and t2" over
+// columnar traces (`gwatch --format=columnar`), e.g. the segments of a --trace-file. Each
+// trace gets a sidecar index (TraceIndex.h), built on first use, in parallel across traces.
+namespace
+{
+	struct Options
+	{
+		std::optional<std::string> var;
+		gwatch::columnar::Filter filter;
+		std::optional<std::uint64_t> limit;
+		bool count = false;
+		bool csv = false;
+		bool indexOnly = false;
+		bool rebuild = false;
+		unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::string> paths;
+	};
+
+	class UsageError final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	// Decimal, or hexadecimal after 0x.
+	std::uint64_t parse_number(const std::string_view option, const std::string_view text)
+	{
+		const bool hex = text.starts_with("0x") || text.starts_with("0X");
+		const std::string_view digits = hex ? text.substr(2) : text;
+		std::uint64_t value = 0;
+		const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value, hex ? 16 : 10);
+		if (digits.empty() || ec != std::errc{} || end != digits.data() + digits.size())
+			throw UsageError("Invalid value for " + std::string(option) + ": '" + std::string(text) + "' (expected a number)");
+		return value;
+	}
+
+	Options parse_options(const int argc, const char* argv[])
+	{
+		Options options;
+		std::vector<std::string_view> seen;
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string_view tok = argv[i];
+			if (!tok.starts_with("--"))
+			{
+				options.paths.emplace_back(tok);
+				continue;
+			}
+			std::optional<std::string_view> inlineValue;
+			if (const std::size_t eq = tok.find('='); eq != std::string_view::npos)
+			{
+				inlineValue = tok.substr(eq + 1);
+				tok = tok.substr(0, eq);
+			}
+			if (std::find(seen.begin(), seen.end(), tok) != seen.end())
+				throw UsageError("Option specified more than once: " + std::string(tok));
+			seen.push_back(tok);
+
+			const auto flag = [&](bool& target)
+			{
+				if (inlineValue)
+					throw UsageError(std::string(tok) + " takes no value");
+				target = true;
+			};
+			const auto value = [&]() -> std::string_view
+			{
+				if (inlineValue)
+					return *inlineValue;
+				if (i + 1 >= argc)
+					throw UsageError("Missing value for " + std::string(tok));
+				return argv[++i];
+			};
+
+			if (tok == "--count")
+				flag(options.count);
+			else if (tok == "--csv")
+				flag(options.csv);
+			else if (tok == "--index-only")
+				flag(options.indexOnly);
+			else if (tok == "--rebuild")
+				flag(options.rebuild);
+			else if (tok == "--var")
+				options.var = std::string(value());
+			else if (tok == "--tid")
+			{
+				const std::uint64_t tid = parse_number(tok, value());
+				if (tid > UINT32_MAX)
+					throw UsageError("Invalid value for --tid: '" + std::to_string(tid) + "' (expected a 32-bit thread id)");
+				options.filter.tid = static_cast<std::uint32_t>(tid);
+			}
+			else if (tok == "--kind")
+			{
+				const std::string_view kind = value();
+				if (kind != "read" && kind != "write")
+					throw UsageError("Invalid value for --kind: '" + std::string(kind) + "' (expected read or write)");
+				options.filter.kind = kind == "write" ? gwatch::AccessKind::Write : gwatch::AccessKind::Read;
+			}
+			else if (tok == "--value")
+				options.filter.value = parse_number(tok, value());
+			else if (tok == "--from")
+				options.filter.fromNs = parse_number(tok, value());
+			else if (tok == "--to")
+				options.filter.toNs = parse_number(tok, value());
+			else if (tok == "--limit")
+				options.limit = parse_number(tok, value());
+			else if (tok == "--threads")
+			{
+				const std::uint64_t threads = parse_number(tok, value());
+				if (threads == 0 || threads > 1024)
+					throw UsageError("Invalid value for --threads: '" + std::to_string(threads) + "' (expected 1 to 1024)");
+				options.threads = static_cast<unsigned>(threads);
+			}
+			else
+				throw UsageError("Unexpected argument: " + std::string(tok));
+		}
+		if (options.paths.empty())
+			throw UsageError("No trace file given");
+		if (options.filter.fromNs > options.filter.toNs)
+			throw UsageError("--from is after --to");
+		if (options.count && options.csv)
+			throw UsageError("--count and --csv cannot be combined");
+		return options;
+	}
+
+	void print_usage(std::ostream& os, const std::string_view programName)
+	{
+		os <<
+			"Usage:\n"
+			"  " << programName << " [filters] [--count | --csv] [--limit <n>] <trace-file>...\n"
+			"  " << programName << " --index-only [--rebuild] <trace-file>...\n\n"
+			"Filters (all must hold):\n"
+			"      --var <symbol>     Accesses to this variable\n"
+			"      --tid <n>          Accesses made by this thread\n"
+			"      --kind read|write  Reads or writes only\n"
+			"      --value <n>        Accesses whose new value (the value read, for a read) is n\n"
+			"      --from <ns>        Accesses at or after this timestamp\n"
+			"      --to <ns>          Accesses at or before this timestamp\n\n"
+			"Options:\n"
+			"      --count            Print the number of matches only\n"
+			"      --csv              Print timestamp_ns,tid,symbol,access,old_value,new_value,count,ip rows\n"
+			"      --limit <n>        Stop after n matches\n"
+			"      --index-only       Build the missing or stale indexes and exit\n"
+			"      --rebuild          Rebuild every index\n"
+			"      --threads <n>      Threads building indexes (default: one per CPU)\n"
+			"  -h, --help             Show this help and exit\n\n"
+			"Notes:\n"
+			"  - Traces must be columnar (gwatch --format=columnar); pass every segment of a\n"
+			"    --trace-file in order, e.g. $(ls trace.* | grep -v gwqi | sort -t. -k2 -n).\n"
+			"  - Each trace gets an index next to it, <trace-file>.gwqi, built on first use and\n"
+			"    rebuilt when the trace changes.\n"
+			"  - Numbers may be given in hexadecimal, e.g. --value 0xdeadbeef. Timestamps are the\n"
+			"    trace's, as printed by --csv or gwatch-dump --csv.\n";
+	}
+
+	void print_match(const gwatch::columnar::Reader& trace, const gwatch::columnar::RowGroup& group, const std::uint32_t row, const bool csv, std::vector<char>& line)
+	{
+		const gwatch::LogRecord record = group.record(row);
+		const std::string_view symbol = record.symbol < trace.symbols().size() ? std::string_view(trace.symbols()[record.symbol].name) : std::string_view("?");
+		if (csv && !record.exact) // values unknown: empty fields
+		{
+			std::printf("%" PRIu64 ",%" PRIu32 ",%.*s,%s,,,%" PRIu32 ",0x%" PRIx64 "\n",
+			            record.timestamp_ns, record.tid, static_cast<int>(symbol.size()), symbol.data(),
+			            record.kind == gwatch::AccessKind::Write ? "write" : "read", record.repeat, record.ip);
+			return;
+		}
+		if (csv)
+		{
+			std::printf("%" PRIu64 ",%" PRIu32 ",%.*s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu32 ",0x%" PRIx64 "\n",
+			            record.timestamp_ns, record.tid, static_cast<int>(symbol.size()), symbol.data(),
+			            record.kind == gwatch::AccessKind::Write ? "write" : "read", record.old_value, record.new_value, record.repeat, record.ip);
+			return;
+		}
+		line.resize(gwatch::Logger::max_line_length(symbol.size()));
+		const std::size_t n = gwatch::Logger::format_text(record, symbol, line.data());
+		std::printf("%" PRIu64 " tid %" PRIu32 " ", record.timestamp_ns, record.tid);
+		if (record.ip != 0)
+			std::printf("ip 0x%" PRIx64 " ", record.ip);
+		std::fwrite(line.data(), 1, n, stdout);
+	}
+}
+
+int main(const int argc, const char* argv[])
+{
+	const std::string_view programName = argc > 0 ? argv[0] : "gwatch-query";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string_view(argv[i]) == "-h" || std::string_view(argv[i]) == "--help")
+		{
+			print_usage(std::cout, programName);
+			return 0;
+		}
+	}
+
+	Options options;
+	try
+	{
+		options = parse_options(argc, argv);
+	}
+	catch (const UsageError& e)
+	{
+		std::cerr << "Error: " << e.what() << "\n\n";
+		print_usage(std::cerr, programName);
+		return 2;
+	}
+
+	try
+	{
+		const std::size_t built = gwatch::query::ensure_indexes(options.paths, options.threads, options.rebuild);
+		if (options.indexOnly)
+		{
+			std::printf("Indexed %zu of %zu trace files\n", built, options.paths.size());
+			return 0;
+		}
+
+		if (options.csv)
+			std::fputs("timestamp_ns,tid,symbol,access,old_value,new_value,count,ip\n", stdout);
+		std::uint64_t matches = 0;
+		std::vector<char> line;
+		for (const std::string& path : options.paths)
+		{
+			if (options.limit && matches >= *options.limit)
+				break;
+			const gwatch::MappedFile file(path);
+			const gwatch::MappedFile indexFile(gwatch::query::index_path(path));
+			const gwatch::columnar::Reader trace(file.bytes());
+			const gwatch::query::TraceIndex index(indexFile.bytes());
+
+			// Variable ids are per trace file.
+			gwatch::columnar::Filter filter = options.filter;
+			if (options.var)
+			{
+				filter.var = trace.find_symbol(*options.var);
+				if (!filter.var)
+					continue;
+			}
+			gwatch::query::run(trace, index, filter, [&](const gwatch::columnar::RowGroup& group, const std::uint32_t row)
+			{
+				if (!options.count)
+					print_match(trace, group, row, options.csv, line);
+				++matches;
+				return !options.limit || matches < *options.limit;
+			});
+		}
+		if (options.count)
+			std::printf("%" PRIu64 "\n", matches);
+	}
+	// Unreadable traces or indexes: ColumnarError, IndexError, or a file error.
+	catch (const std::exception& e)
+	{
+		std::fflush(stdout);
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}